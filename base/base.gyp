@@ -416,6 +416,7 @@
         'files/file_unittest.cc',
         'files/file_util_proxy_unittest.cc',
         'files/file_util_unittest.cc',
+        'files/important_file_write_batcher_unittest.cc',
         'files/important_file_writer_unittest.cc',
         'files/memory_mapped_file_unittest.cc',
         'files/scoped_temp_dir_unittest.cc',
@@ -438,6 +439,7 @@
         'ios/crb_protocol_observers_unittest.mm',
         'ios/device_util_unittest.mm',
         'ios/weak_nsobject_unittest.mm',
+        'json/json_event_reader_unittest.cc',
         'json/json_parser_unittest.cc',
         'json/json_reader_unittest.cc',
         'json/json_value_converter_unittest.cc',
@@ -472,6 +474,7 @@
         'memory/shared_memory_unittest.cc',
         'memory/shared_memory_win_unittest.cc',
         'memory/singleton_unittest.cc',
+        'memory/small_object_pool_unittest.cc',
         'memory/weak_ptr_unittest.cc',
         'memory/weak_ptr_unittest.nc',
         'message_loop/message_loop_task_runner_unittest.cc',
@@ -479,6 +482,7 @@
         'message_loop/message_pump_glib_unittest.cc',
         'message_loop/message_pump_io_ios_unittest.cc',
         'message_loop/message_pump_libevent_unittest.cc',
+        'message_loop/timing_wheel_unittest.cc',
         'metrics/bucket_ranges_unittest.cc',
         'metrics/field_trial_unittest.cc',
         'metrics/histogram_base_unittest.cc',
@@ -512,6 +516,7 @@
         'process/process_unittest.cc',
         'process/process_util_unittest.cc',
         'profiler/stack_sampling_profiler_unittest.cc',
+        'profiler/task_profiler_unittest.cc',
         'profiler/tracked_time_unittest.cc',
         'rand_util_unittest.cc',
         'run_loop_unittest.cc',
@@ -555,6 +560,7 @@
         'task_scheduler/priority_queue_unittest.cc',
         'task_scheduler/scheduler_lock_unittest.cc',
         'task_scheduler/scheduler_service_thread_unittest.cc',
+        'task_scheduler/scheduler_worker_deque_unittest.cc',
         'task_scheduler/scheduler_worker_pool_impl_unittest.cc',
         'task_scheduler/scheduler_worker_stack_unittest.cc',
         'task_scheduler/scheduler_worker_unittest.cc',
@@ -798,9 +804,19 @@
         '../testing/gtest.gyp:gtest',
       ],
       'sources': [
+        'containers/mru_cache_perftest.cc',
+        'files/file_path_watcher_perftest.cc',
+        'files/memory_mapped_file_perftest.cc',
+        'json/json_parser_perftest.cc',
         'message_loop/message_pump_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'metrics/statistics_recorder_perftest.cc',
+        'strings/utf_string_conversions_perftest.cc',
+        'task_scheduler/scheduler_worker_pool_impl_perftest.cc',
         'test/run_all_unittests.cc',
         'threading/thread_perftest.cc',
+        'timer/timer_perftest.cc',
+        'trace_event/trace_event_perftest.cc',
         '../testing/perf/perf_test.cc'
       ],
       'conditions': [
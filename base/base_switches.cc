@@ -24,9 +24,19 @@ const char kEnableHeapProfiling[]           = "enable-heap-profiling";
 // derived from trace events are reported.
 const char kEnableHeapProfilingModeNative[] = "native";
 
+// Record only a sample of the allocations, with native stacks where they are
+// supported, and report estimates scaled from the sample. This is cheap enough
+// to leave heap profiling enabled in production.
+const char kEnableHeapProfilingModeSampled[] = "sampled";
+
 // Generates full memory crash dump.
 const char kFullMemoryCrashReport[]         = "full-memory-crash-report";
 
+// The mean number of allocated bytes between two samples when heap profiling
+// in the sampled mode. Defaults to 128 KB.
+const char kHeapProfilingSamplingInterval[] =
+    "heap-profiling-sampling-interval";
+
 // Force low-end device mode when set.
 const char kEnableLowEndDeviceMode[]        = "enable-low-end-device-mode";
 
@@ -104,6 +114,12 @@ const char kProfilingFile[] = "profiling-file";
 const char kDisableUsbKeyboardDetect[]      = "disable-usb-keyboard-detect";
 #endif
 
+#if defined(OS_LINUX)
+// Makes IO threads wait for I/O readiness through io_uring instead of
+// libevent, when the kernel supports it.
+const char kEnableIOUringMessagePump[]      = "enable-io-uring-message-pump";
+#endif
+
 #if defined(OS_POSIX)
 // Used for turning on Breakpad crash reporting in a debug environment where
 // crash reporting is typically compiled but disabled.
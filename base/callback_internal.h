@@ -13,6 +13,7 @@
 #include "base/callback_forward.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/small_object_pool.h"
 
 namespace base {
 namespace internal {
@@ -30,7 +31,9 @@ class CallbackBase;
 // Creating a vtable for every BindState template instantiation results in a lot
 // of bloat. Its only task is to call the destructor which can be done with a
 // function pointer.
-class BindStateBase {
+// BindStates are allocated from SmallObjectPool, since one is allocated for
+// every posted task and is often freed on another thread.
+class BindStateBase : public SmallObjectPoolAllocated {
  protected:
   explicit BindStateBase(void (*destructor)(BindStateBase*))
       : ref_count_(0), destructor_(destructor) {}
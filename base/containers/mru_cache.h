@@ -10,20 +10,23 @@
 // The key object will be stored twice, so it should support efficient copying.
 //
 // NOTE: While all operations are O(1), this code is written for
-// legibility rather than optimality. If future profiling identifies this as
-// a bottleneck, there is room for smaller values of 1 in the O(1). :]
+// legibility rather than optimality. FlatHashingMRUCache below trades some of
+// that legibility for smaller values of 1 in the O(1). :]
 
 #ifndef BASE_CONTAINERS_MRU_CACHE_H_
 #define BASE_CONTAINERS_MRU_CACHE_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include <list>
 #include <map>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/macros.h"
@@ -251,6 +254,360 @@ class HashingMRUCache
   DISALLOW_COPY_AND_ASSIGN(HashingMRUCache);
 };
 
+// FlatHashingMRUCache --------------------------------------------------------
+
+// This class has the API of HashingMRUCache, but allocates nothing per entry.
+// The entries live in one vector and carry their recency links as indices, and
+// an open-addressing table indexes them by key. A lookup touches the table and
+// the entry, where HashingMRUCache chases a hash node and then a list node.
+//
+// Because entries move, it differs from MRUCacheBase in that:
+//  - Put() invalidates pointers and references to entries, but not iterators.
+//  - Erase() fills the hole with the last entry, invalidating iterators to it
+//    except for the one it returns.
+//  - Iterators stay with the cache, not with the entries, on Swap().
+// KeyType must be equality-comparable.
+template <class KeyType, class PayloadType, class HashType = std::hash<KeyType>>
+class FlatHashingMRUCache {
+ public:
+  typedef std::pair<KeyType, PayloadType> value_type;
+  typedef size_t size_type;
+
+ private:
+  // Marks the ends of the recency list and empty table slots.
+  enum : uint32_t { kInvalidIndex = 0xffffffff };
+
+  template <class CacheType, class ValueType>
+  class IteratorImpl {
+   public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef ValueType value_type;
+    typedef ptrdiff_t difference_type;
+    typedef ValueType* pointer;
+    typedef ValueType& reference;
+
+    IteratorImpl() : cache_(nullptr), index_(kInvalidIndex) {}
+    IteratorImpl(CacheType* cache, uint32_t index)
+        : cache_(cache), index_(index) {}
+    // Converts an iterator to a const_iterator.
+    template <class OtherCacheType, class OtherValueType>
+    IteratorImpl(const IteratorImpl<OtherCacheType, OtherValueType>& other)
+        : cache_(other.cache_), index_(other.index_) {}
+
+    reference operator*() const { return cache_->entries_[index_].value; }
+    pointer operator->() const { return &cache_->entries_[index_].value; }
+
+    // Forward iteration goes from the most recent entry to the oldest.
+    IteratorImpl& operator++() {
+      index_ = cache_->entries_[index_].next;
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      IteratorImpl result = *this;
+      ++*this;
+      return result;
+    }
+    IteratorImpl& operator--() {
+      index_ = index_ == kInvalidIndex ? cache_->tail_
+                                       : cache_->entries_[index_].prev;
+      return *this;
+    }
+    IteratorImpl operator--(int) {
+      IteratorImpl result = *this;
+      --*this;
+      return result;
+    }
+
+    bool operator==(const IteratorImpl& other) const {
+      return cache_ == other.cache_ && index_ == other.index_;
+    }
+    bool operator!=(const IteratorImpl& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class FlatHashingMRUCache;
+    template <class, class>
+    friend class IteratorImpl;
+
+    CacheType* cache_;
+    uint32_t index_;
+  };
+
+ public:
+  typedef IteratorImpl<FlatHashingMRUCache, value_type> iterator;
+  typedef IteratorImpl<const FlatHashingMRUCache, const value_type>
+      const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  enum { NO_AUTO_EVICT = 0 };
+
+  // See MRUCacheBase.
+  explicit FlatHashingMRUCache(size_type max_size)
+      : head_(kInvalidIndex), tail_(kInvalidIndex), max_size_(max_size) {}
+
+  ~FlatHashingMRUCache() {}
+
+  size_type max_size() const { return max_size_; }
+
+  // See MRUCacheBase::Put().
+  template <typename Payload>
+  iterator Put(const KeyType& key, Payload&& payload) {
+    const uint32_t hash = HashKey(key);
+    const uint32_t slot = FindSlot(key, hash);
+    if (slot != kInvalidIndex) {
+      Erase(iterator(this, slots_[slot].entry));
+    } else if (max_size_ != NO_AUTO_EVICT && size() >= max_size_) {
+      // Reuse the oldest entry in place rather than erasing it, which would
+      // move another entry into its place.
+      ShrinkToSize(max_size_);
+      const uint32_t index = tail_;
+      RemoveSlot(FindEntrySlot(index));
+      Unlink(index);
+      entries_[index].value =
+          value_type(key, std::forward<Payload>(payload));
+      entries_[index].hash = hash;
+      InsertSlot(hash, index);
+      LinkAtFront(index);
+      return iterator(this, index);
+    }
+
+    DCHECK_LT(entries_.size(), static_cast<size_t>(kInvalidIndex) / 2);
+    // Keep the table at most 3/4 full, so that probe sequences stay short.
+    if ((entries_.size() + 1) * 4 > slots_.size() * 3)
+      Rehash(std::max<size_t>(16, slots_.size() * 2));
+
+    const uint32_t index = static_cast<uint32_t>(entries_.size());
+    entries_.push_back(Entry(key, std::forward<Payload>(payload), hash));
+    InsertSlot(hash, index);
+    LinkAtFront(index);
+    return iterator(this, index);
+  }
+
+  // See MRUCacheBase::Get().
+  iterator Get(const KeyType& key) {
+    const uint32_t slot = FindSlot(key, HashKey(key));
+    if (slot == kInvalidIndex)
+      return end();
+    const uint32_t index = slots_[slot].entry;
+    if (index != head_) {
+      Unlink(index);
+      LinkAtFront(index);
+    }
+    return iterator(this, index);
+  }
+
+  // See MRUCacheBase::Peek().
+  iterator Peek(const KeyType& key) {
+    const uint32_t slot = FindSlot(key, HashKey(key));
+    return iterator(this,
+                    slot == kInvalidIndex ? kInvalidIndex : slots_[slot].entry);
+  }
+
+  const_iterator Peek(const KeyType& key) const {
+    const uint32_t slot = FindSlot(key, HashKey(key));
+    return const_iterator(
+        this, slot == kInvalidIndex ? kInvalidIndex : slots_[slot].entry);
+  }
+
+  // Exchanges the contents of |this| by the contents of the |other|.
+  void Swap(FlatHashingMRUCache& other) {
+    entries_.swap(other.entries_);
+    slots_.swap(other.slots_);
+    std::swap(head_, other.head_);
+    std::swap(tail_, other.tail_);
+    std::swap(max_size_, other.max_size_);
+  }
+
+  // Erases the item referenced by the given iterator. An iterator to the item
+  // following it will be returned. The iterator must be valid.
+  iterator Erase(iterator pos) {
+    const uint32_t index = pos.index_;
+    uint32_t next = entries_[index].next;
+    RemoveSlot(FindEntrySlot(index));
+    Unlink(index);
+
+    // Keep the entries dense by moving the last one into the hole.
+    const uint32_t last = static_cast<uint32_t>(entries_.size() - 1);
+    if (index != last) {
+      slots_[FindEntrySlot(last)].entry = index;
+      entries_[index] = std::move(entries_[last]);
+      const Entry& moved = entries_[index];
+      if (moved.prev == kInvalidIndex)
+        head_ = index;
+      else
+        entries_[moved.prev].next = index;
+      if (moved.next == kInvalidIndex)
+        tail_ = index;
+      else
+        entries_[moved.next].prev = index;
+      if (next == last)
+        next = index;
+    }
+    entries_.pop_back();
+    return iterator(this, next);
+  }
+
+  // See MRUCacheBase::Erase().
+  reverse_iterator Erase(reverse_iterator pos) {
+    return reverse_iterator(Erase((++pos).base()));
+  }
+
+  // Shrinks the cache so it only holds |new_size| items. If |new_size| is
+  // bigger or equal to the current number of items, this will do nothing.
+  void ShrinkToSize(size_type new_size) {
+    for (size_type i = size(); i > new_size; i--)
+      Erase(rbegin());
+  }
+
+  // Deletes everything from the cache.
+  void Clear() {
+    entries_.clear();
+    slots_.clear();
+    head_ = kInvalidIndex;
+    tail_ = kInvalidIndex;
+  }
+
+  // Returns the number of elements in the cache.
+  size_type size() const { return entries_.size(); }
+
+  // Allows iteration over the cache. Forward iteration starts with the most
+  // recent item and works backwards.
+  iterator begin() { return iterator(this, head_); }
+  const_iterator begin() const { return const_iterator(this, head_); }
+  iterator end() { return iterator(this, kInvalidIndex); }
+  const_iterator end() const { return const_iterator(this, kInvalidIndex); }
+
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  bool empty() const { return entries_.empty(); }
+
+ private:
+  struct Entry {
+    template <typename Payload>
+    Entry(const KeyType& key, Payload&& payload, uint32_t hash)
+        : value(key, std::forward<Payload>(payload)),
+          hash(hash),
+          prev(kInvalidIndex),
+          next(kInvalidIndex) {}
+
+    value_type value;
+    uint32_t hash;
+    uint32_t prev;  // The next more recent entry.
+    uint32_t next;  // The next older entry.
+  };
+
+  // A slot of the table is empty when |entry| is kInvalidIndex. It repeats the
+  // hash of its entry so that most mismatches are rejected without loading the
+  // entry.
+  struct Slot {
+    uint32_t hash;
+    uint32_t entry;
+  };
+
+  uint32_t HashKey(const KeyType& key) const {
+    // Multiplicative hashing spreads hashes that are poor in the low bits,
+    // such as the identity hash of integers, over the table.
+    return static_cast<uint32_t>(
+        (static_cast<uint64_t>(HashType()(key)) * UINT64_C(0x9E3779B97F4A7C15))
+        >> 32);
+  }
+
+  uint32_t mask() const { return static_cast<uint32_t>(slots_.size() - 1); }
+
+  // Returns the slot of the entry with |key|, or kInvalidIndex.
+  uint32_t FindSlot(const KeyType& key, uint32_t hash) const {
+    if (slots_.empty())
+      return kInvalidIndex;
+    for (uint32_t i = hash & mask();; i = (i + 1) & mask()) {
+      const Slot& slot = slots_[i];
+      if (slot.entry == kInvalidIndex)
+        return kInvalidIndex;
+      if (slot.hash == hash && entries_[slot.entry].value.first == key)
+        return i;
+    }
+  }
+
+  // Returns the slot of the entry at |index|, which must be in the table.
+  uint32_t FindEntrySlot(uint32_t index) const {
+    uint32_t i = entries_[index].hash & mask();
+    while (slots_[i].entry != index)
+      i = (i + 1) & mask();
+    return i;
+  }
+
+  void InsertSlot(uint32_t hash, uint32_t index) {
+    uint32_t i = hash & mask();
+    while (slots_[i].entry != kInvalidIndex)
+      i = (i + 1) & mask();
+    slots_[i].hash = hash;
+    slots_[i].entry = index;
+  }
+
+  // Empties slot |i| by shifting back the entries probed past it, so that no
+  // tombstones are needed.
+  void RemoveSlot(uint32_t i) {
+    for (uint32_t j = (i + 1) & mask(); slots_[j].entry != kInvalidIndex;
+         j = (j + 1) & mask()) {
+      // Entry j can move to i unless its home slot lies cyclically in (i, j].
+      const uint32_t home = slots_[j].hash & mask();
+      if (((j - home) & mask()) >= ((j - i) & mask())) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i].entry = kInvalidIndex;
+  }
+
+  void Rehash(size_t slot_count) {
+    Slot empty_slot = {0, kInvalidIndex};
+    slots_.assign(slot_count, empty_slot);
+    for (uint32_t index = 0; index < entries_.size(); ++index)
+      InsertSlot(entries_[index].hash, index);
+  }
+
+  void Unlink(uint32_t index) {
+    Entry& entry = entries_[index];
+    if (entry.prev == kInvalidIndex)
+      head_ = entry.next;
+    else
+      entries_[entry.prev].next = entry.next;
+    if (entry.next == kInvalidIndex)
+      tail_ = entry.prev;
+    else
+      entries_[entry.next].prev = entry.prev;
+  }
+
+  void LinkAtFront(uint32_t index) {
+    Entry& entry = entries_[index];
+    entry.prev = kInvalidIndex;
+    entry.next = head_;
+    if (head_ == kInvalidIndex)
+      tail_ = index;
+    else
+      entries_[head_].prev = index;
+    head_ = index;
+  }
+
+  std::vector<Entry> entries_;
+  // A power of two in size, or empty.
+  std::vector<Slot> slots_;
+  uint32_t head_;  // The most recent entry.
+  uint32_t tail_;  // The oldest entry.
+
+  size_type max_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlatHashingMRUCache);
+};
+
 }  // namespace base
 
 #endif  // BASE_CONTAINERS_MRU_CACHE_H_
@@ -0,0 +1,124 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/mru_cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/format_macros.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Each operation is repeated at least this many times, so that small caches
+// are not dominated by timer resolution.
+const size_t kMinOperations = 4 * 1000 * 1000;
+
+// Returns |count| pseudo-random keys below |limit|.
+std::vector<int> MakeKeys(size_t count, size_t limit) {
+  std::vector<int> keys(count);
+  uint32_t state = 1;
+  for (size_t i = 0; i < count; ++i) {
+    state = state * 1103515245u + 12345u;
+    keys[i] = static_cast<int>(((static_cast<uint64_t>(state) << 16) ^
+                                (state >> 8)) % limit);
+  }
+  return keys;
+}
+
+void PrintNanosecondsPerOperation(const std::string& operation,
+                                  size_t entries,
+                                  const char* cache_name,
+                                  TimeDelta elapsed,
+                                  size_t operations) {
+  perf_test::PrintResult(
+      "mru_cache_" + operation, StringPrintf("_%" PRIuS "_entries", entries),
+      cache_name, elapsed.InMicroseconds() * 1000.0 / operations, "ns/op",
+      true);
+}
+
+template <class Cache>
+void RunCachePerfTest(const char* cache_name, size_t entries) {
+  const size_t rounds = kMinOperations / entries + 1;
+
+  // Filling an empty cache.
+  TimeDelta elapsed;
+  for (size_t round = 0; round < rounds; ++round) {
+    Cache cache(entries);
+    TimeTicks start = TimeTicks::Now();
+    for (size_t i = 0; i < entries; ++i)
+      cache.Put(static_cast<int>(i), static_cast<int>(i));
+    elapsed += TimeTicks::Now() - start;
+  }
+  PrintNanosecondsPerOperation("put", entries, cache_name, elapsed,
+                               rounds * entries);
+
+  Cache cache(entries);
+  for (size_t i = 0; i < entries; ++i)
+    cache.Put(static_cast<int>(i), static_cast<int>(i));
+
+  // Hits in random order, which reorder the recency list.
+  const std::vector<int> hit_keys = MakeKeys(entries, entries);
+  int sum = 0;
+  TimeTicks start = TimeTicks::Now();
+  for (size_t round = 0; round < rounds; ++round) {
+    for (int key : hit_keys)
+      sum += cache.Get(key)->second;
+  }
+  PrintNanosecondsPerOperation("get_hit", entries, cache_name,
+                               TimeTicks::Now() - start, rounds * entries);
+
+  // Misses.
+  start = TimeTicks::Now();
+  for (size_t round = 0; round < rounds; ++round) {
+    for (int key : hit_keys)
+      sum += cache.Peek(-1 - key) == cache.end();
+  }
+  PrintNanosecondsPerOperation("peek_miss", entries, cache_name,
+                               TimeTicks::Now() - start, rounds * entries);
+
+  // New keys into a full cache, each evicting the oldest item.
+  int next_key = static_cast<int>(entries);
+  start = TimeTicks::Now();
+  for (size_t round = 0; round < rounds; ++round) {
+    for (size_t i = 0; i < entries; ++i, ++next_key)
+      cache.Put(next_key, next_key);
+  }
+  PrintNanosecondsPerOperation("put_evict", entries, cache_name,
+                               TimeTicks::Now() - start, rounds * entries);
+
+  // Keeps the loops above from being optimized away.
+  EXPECT_NE(0, sum);
+  EXPECT_EQ(entries, cache.size());
+}
+
+void RunCachePerfTests(size_t entries) {
+  RunCachePerfTest<HashingMRUCache<int, int>>("hashing", entries);
+  RunCachePerfTest<FlatHashingMRUCache<int, int>>("flat_hashing", entries);
+}
+
+}  // namespace
+
+TEST(MRUCachePerfTest, Entries1K) {
+  RunCachePerfTests(1000);
+}
+
+TEST(MRUCachePerfTest, Entries100K) {
+  RunCachePerfTests(100 * 1000);
+}
+
+TEST(MRUCachePerfTest, Entries1M) {
+  RunCachePerfTests(1000 * 1000);
+}
+
+}  // namespace base
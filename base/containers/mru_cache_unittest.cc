@@ -5,9 +5,12 @@
 #include "base/containers/mru_cache.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <memory>
+#include <string>
 
+#include "base/macros.h"
 #include "base/memory/ptr_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -381,4 +384,136 @@ TEST(MRUCacheTest, Swap) {
   }
 }
 
+TEST(MRUCacheTest, FlatHashingMRUCache) {
+  typedef base::FlatHashingMRUCache<std::string, CachedItem> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+
+  CachedItem one(1);
+  cache.Put("First", one);
+
+  CachedItem two(2);
+  cache.Put("Second", two);
+
+  EXPECT_EQ(one.value, cache.Get("First")->second.value);
+  EXPECT_EQ(two.value, cache.Get("Second")->second.value);
+  EXPECT_EQ(one.value, cache.rbegin()->second.value);
+  cache.ShrinkToSize(1);
+  EXPECT_EQ(two.value, cache.Get("Second")->second.value);
+  EXPECT_TRUE(cache.Get("First") == cache.end());
+  EXPECT_TRUE(cache.Peek("First") == cache.end());
+}
+
+namespace {
+
+// Sends every key to one of a few buckets, so that tables probe and shift.
+struct CollidingHash {
+  size_t operator()(int key) const { return key % 4; }
+};
+
+template <class CacheA, class CacheB>
+void ExpectSameOrder(const CacheA& a, const CacheB& b) {
+  ASSERT_EQ(a.size(), b.size());
+  typename CacheB::const_iterator b_iter = b.begin();
+  for (typename CacheA::const_iterator a_iter = a.begin(); a_iter != a.end();
+       ++a_iter, ++b_iter) {
+    EXPECT_EQ(a_iter->first, b_iter->first);
+    EXPECT_EQ(a_iter->second, b_iter->second);
+  }
+  EXPECT_TRUE(b_iter == b.end());
+}
+
+}  // namespace
+
+// Runs the same operations on FlatHashingMRUCache and HashingMRUCache and
+// checks that they hold the same items in the same order.
+TEST(MRUCacheTest, FlatHashingMRUCacheMatchesHashingMRUCache) {
+  typedef base::HashingMRUCache<int, int, CollidingHash> Cache;
+  typedef base::FlatHashingMRUCache<int, int, CollidingHash> FlatCache;
+  Cache cache(50);
+  FlatCache flat_cache(50);
+
+  uint32_t state = 1;
+  for (int i = 0; i < 5000; ++i) {
+    state = state * 1103515245u + 12345u;
+    const int key = (state >> 8) % 80;
+    switch ((state >> 24) % 5) {
+      case 0:
+      case 1:
+        cache.Put(key, i);
+        flat_cache.Put(key, i);
+        break;
+      case 2:
+        EXPECT_EQ(cache.Get(key) == cache.end(),
+                  flat_cache.Get(key) == flat_cache.end());
+        break;
+      case 3: {
+        Cache::iterator iter = cache.Peek(key);
+        FlatCache::iterator flat_iter = flat_cache.Peek(key);
+        ASSERT_EQ(iter == cache.end(), flat_iter == flat_cache.end());
+        if (iter != cache.end()) {
+          cache.Erase(iter);
+          flat_cache.Erase(flat_iter);
+        }
+        break;
+      }
+      case 4:
+        cache.ShrinkToSize(key % 60);
+        flat_cache.ShrinkToSize(key % 60);
+        break;
+    }
+    ExpectSameOrder(cache, flat_cache);
+  }
+}
+
+TEST(MRUCacheTest, FlatHashingMRUCacheEraseWhileIterating) {
+  typedef base::FlatHashingMRUCache<int, int> Cache;
+  Cache cache(Cache::NO_AUTO_EVICT);
+  for (int i = 0; i < 10; ++i)
+    cache.Put(i, i);
+
+  // Erase the odd items, oldest first.
+  for (Cache::reverse_iterator iter = cache.rbegin(); iter != cache.rend();) {
+    if (iter->first % 2)
+      iter = cache.Erase(iter);
+    else
+      ++iter;
+  }
+
+  // The rest, newest first.
+  const int kExpected[] = {8, 6, 4, 2, 0};
+  ASSERT_EQ(arraysize(kExpected), cache.size());
+  Cache::const_iterator iter = cache.begin();
+  for (int expected : kExpected) {
+    EXPECT_EQ(expected, iter->first);
+    ++iter;
+  }
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(i % 2 == 0, cache.Peek(i) != cache.end());
+}
+
+TEST(MRUCacheTest, FlatHashingMRUCacheOwning) {
+  using Cache = base::FlatHashingMRUCache<int, std::unique_ptr<CachedItem>>;
+  static const Cache::size_type kMaxSize = 3;
+
+  int initial_count = cached_item_live_count;
+  {
+    Cache cache(kMaxSize);
+    for (int i = 0; i < 10; ++i)
+      cache.Put(i, WrapUnique(new CachedItem(i)));
+    cache.Put(9, WrapUnique(new CachedItem(90)));
+
+    EXPECT_EQ(kMaxSize, cache.size());
+    EXPECT_EQ(initial_count + static_cast<int>(kMaxSize),
+              cached_item_live_count);
+    EXPECT_EQ(90, cache.begin()->second->value);
+
+    cache.Erase(cache.begin());
+    EXPECT_EQ(initial_count + static_cast<int>(kMaxSize) - 1,
+              cached_item_live_count);
+  }
+
+  // There should be no objects leaked.
+  EXPECT_EQ(initial_count, cached_item_live_count);
+}
+
 }  // namespace base
@@ -6,6 +6,7 @@
 
 #include "base/debug/alias.h"
 #include "base/pending_task.h"
+#include "base/profiler/task_profiler.h"
 #include "base/trace_event/trace_event.h"
 #include "base/tracked_objects.h"
 
@@ -48,7 +49,11 @@ void TaskAnnotator::RunTask(const char* queue_function,
   const void* program_counter = pending_task.posted_from.program_counter();
   debug::Alias(&program_counter);
 
-  pending_task.task.Run();
+  {
+    TaskProfiler::ScopedTaskRun task_run(pending_task.posted_from,
+                                         pending_task);
+    pending_task.task.Run();
+  }
 
   stopwatch.Stop();
   tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(
@@ -48,4 +48,9 @@ bool FilePathWatcher::Watch(const FilePath& path,
   return impl_->Watch(path, recursive, callback);
 }
 
+void FilePathWatcher::SetDebounceDelay(TimeDelta delay) {
+  DCHECK_GE(delay, TimeDelta());
+  impl_->set_debounce_delay(delay);
+}
+
 }  // namespace base
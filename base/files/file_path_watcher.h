@@ -13,6 +13,7 @@
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
 #include "base/single_thread_task_runner.h"
+#include "base/time/time.h"
 
 namespace base {
 
@@ -75,9 +76,18 @@ class BASE_EXPORT FilePathWatcher {
       return cancelled_;
     }
 
+    TimeDelta debounce_delay() const {
+      return debounce_delay_;
+    }
+
+    void set_debounce_delay(TimeDelta delay) {
+      debounce_delay_ = delay;
+    }
+
    private:
     scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
     bool cancelled_;
+    TimeDelta debounce_delay_;
   };
 
   FilePathWatcher();
@@ -98,8 +108,25 @@ class BASE_EXPORT FilePathWatcher {
   //
   // Recursive watch is not supported on all platforms and file systems.
   // Watch() will return false in the case of failure.
+  //
+  // On Linux, each directory watched uses an inotify watch, of which there is
+  // a limited number. Watch() returns false if |path| needs more, and the
+  // callback reports an error if it comes to need more. The watches of the
+  // sub-directories of a large tree are added in the background, so Watch()
+  // may return before they all are. Changes in the directories which are not
+  // watched yet cannot be told apart, so the callback is run once they all
+  // are, to let the caller rescan; running out of watches then is reported
+  // through the callback.
   bool Watch(const FilePath& path, bool recursive, const Callback& callback);
 
+  // Coalesces the changes detected within |delay| of a first one into a
+  // single invocation of the callback, |delay| after that first change. This
+  // bounds the rate of the callbacks during bursts of changes, such as when a
+  // large directory is copied into a recursively watched one. Must be called
+  // before Watch(). Only implemented on Linux, where the changes detected at
+  // once are coalesced even without a delay.
+  void SetDebounceDelay(TimeDelta delay);
+
  private:
   scoped_refptr<PlatformDelegate> impl_;
 
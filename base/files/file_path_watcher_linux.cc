@@ -2,14 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#include "base/files/file_path_watcher.h"
+#include "base/files/file_path_watcher_linux.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <stddef.h>
 #include <string.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -19,10 +21,11 @@
 #include <utility>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/containers/hash_tables.h"
-#include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/files/file_path_watcher.h"
 #include "base/files/file_util.h"
 #include "base/lazy_instance.h"
 #include "base/location.h"
@@ -31,16 +34,38 @@
 #include "base/posix/eintr_wrapper.h"
 #include "base/single_thread_task_runner.h"
 #include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
+#include "base/sys_info.h"
 #include "base/threading/thread.h"
+#include "base/threading/thread_restrictions.h"
 #include "base/threading/thread_task_runner_handle.h"
+#include "base/threading/worker_pool.h"
 #include "base/trace_event/trace_event.h"
 
 namespace base {
 
 namespace {
 
+// The limit of inotify watches per user when it can't be read. This is the
+// default of the kernel.
+const size_t kDefaultInotifyMaxUserWatches = 8192;
+
+// Overrides GetMaxNumberOfInotifyWatches() when not 0.
+size_t g_override_max_inotify_watches = 0;
+
+// The number of RecursiveWatchAdders of all the watchers which are still
+// adding watches on WorkerPool threads.
+subtle::Atomic32 g_pending_recursive_watch_adders = 0;
+
+// The maximum number of worker threads helping to add the watches of a
+// recursive watch, on top of the thread of the watch.
+const int kMaxRecursiveWatchHelpers = 7;
+
 class FilePathWatcherImpl;
+class RecursiveWatchAdder;
 
 // Singleton to manage all inotify watches.
 // TODO(tony): It would be nice if this wasn't a singleton.
@@ -50,15 +75,38 @@ class InotifyReader {
   typedef int Watch;  // Watch descriptor used by AddWatch and RemoveWatch.
   static const Watch kInvalidWatch = -1;
 
+  // A change in a watched directory. |watch| is kInvalidWatch if the queue of
+  // inotify events overflowed, in which case changes were lost. See
+  // FilePathWatcherImpl::OnFilePathsChanged() for the other members.
+  struct Event {
+    Event(Watch watch,
+          const FilePath::StringType& child,
+          bool created,
+          bool deleted,
+          bool is_dir);
+    Event(const Event& other);
+    ~Event();
+
+    Watch watch;
+    FilePath::StringType child;
+    bool created;
+    bool deleted;
+    bool is_dir;
+  };
+
   // Watch directory |path| for changes. |watcher| will be notified on each
-  // change. Returns kInvalidWatch on failure.
+  // change. Returns kInvalidWatch on failure, with errno set. errno is ENOSPC
+  // if the limit on the number of watches is reached.
   Watch AddWatch(const FilePath& path, FilePathWatcherImpl* watcher);
 
   // Remove |watch| if it's valid.
   void RemoveWatch(Watch watch, FilePathWatcherImpl* watcher);
 
-  // Callback for InotifyReaderTask.
-  void OnInotifyEvent(const inotify_event* event);
+  // Callback for InotifyReaderTask. Notifies each watcher once of all its
+  // changes among |events|, which were read together.
+  void OnInotifyEvents(const std::vector<const inotify_event*>& events);
+
+  size_t max_watches() const { return max_watches_; }
 
  private:
   friend struct DefaultLazyInstanceTraits<InotifyReader>;
@@ -71,6 +119,9 @@ class InotifyReader {
   // We keep track of which delegates want to be notified on which watches.
   hash_map<Watch, WatcherSet> watchers_;
 
+  // See GetMaxNumberOfInotifyWatches().
+  const size_t max_watches_;
+
   // Lock to protect watchers_.
   Lock lock_;
 
@@ -94,18 +145,22 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate,
  public:
   FilePathWatcherImpl();
 
-  // Called for each event coming from the watch. |fired_watch| identifies the
-  // watch that fired, |child| indicates what has changed, and is relative to
-  // the currently watched path for |fired_watch|.
+  // Called with the events coming from the watches, on the inotify reader
+  // thread. For each of |events|, |watch| identifies the watch that fired,
+  // |child| indicates what has changed, and is relative to the currently
+  // watched path for |watch|.
   //
   // |created| is true if the object appears.
   // |deleted| is true if the object disappears.
   // |is_dir| is true if the object is a directory.
-  void OnFilePathChanged(InotifyReader::Watch fired_watch,
-                         const FilePath::StringType& child,
-                         bool created,
-                         bool deleted,
-                         bool is_dir);
+  //
+  // The events are processed together on the message_loop() thread, along
+  // with the ones which come within debounce_delay().
+  void OnFilePathsChanged(const std::vector<InotifyReader::Event>& events);
+
+  // Called on the message_loop() thread once |adder| has added the watches
+  // which RecursiveWatchAdder::Run() left to its helpers.
+  void OnRecursiveWatchesAdded(const scoped_refptr<RecursiveWatchAdder>& adder);
 
  protected:
   ~FilePathWatcherImpl() override {}
@@ -146,26 +201,61 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate,
   };
   typedef std::vector<WatchEntry> WatchVector;
 
+  // Processes the events passed to OnFilePathsChanged() since the last call,
+  // and runs |callback_| once if any of them is relevant. Does nothing while
+  // recursive watches are being added: the events are processed once their
+  // watches are tracked, and |callback_| is run once they are all added.
+  void ProcessPendingEvents();
+
+  // Returns whether |event| is relevant to |target_|. Sets |*update_watches|
+  // if the watches for the components of |target_| need to be updated, and
+  // adds the directories whose recursive watches need to be updated to
+  // |*recursive_dirs|.
+  bool ProcessEvent(const InotifyReader::Event& event,
+                    bool* update_watches,
+                    std::set<FilePath>* recursive_dirs);
+
   // Reconfigure to watch for the most specific parent directory of |target_|
-  // that exists. Also calls UpdateRecursiveWatches() below.
-  void UpdateWatches();
+  // that exists. Also calls UpdateRecursiveWatches() below. Returns false if
+  // the limit on the number of watches is reached.
+  bool UpdateWatches() WARN_UNUSED_RESULT;
 
   // Reconfigure to recursively watch |target_| and all its sub-directories.
   // - This is a no-op if the watch is not recursive.
   // - If |target_| does not exist, then clear all the recursive watches.
-  // - Assuming |target_| exists, passing kInvalidWatch as |fired_watch| forces
-  //   addition of recursive watches for |target_|.
-  // - Otherwise, only the directory associated with |fired_watch| and its
-  //   sub-directories will be reconfigured.
-  void UpdateRecursiveWatches(InotifyReader::Watch fired_watch, bool is_dir);
-
-  // Enumerate recursively through |path| and add / update watches.
-  void UpdateRecursiveWatchesForPath(const FilePath& path);
+  // - Otherwise, only the directories of |dirs|, which are |target_| or below
+  //   it, and their sub-directories will be reconfigured.
+  // Returns false if the limit on the number of watches is reached.
+  bool UpdateRecursiveWatches(const std::set<FilePath>& dirs)
+      WARN_UNUSED_RESULT;
+
+  // Adds to |recursive_dirs| the directory whose recursive watches need to be
+  // updated after |event|, if any.
+  void AddRecursiveDirToUpdate(const InotifyReader::Event& event,
+                               std::set<FilePath>* recursive_dirs) const;
+
+  // Enumerate recursively through |path| and add / update watches, including
+  // the watch for |path| itself if it is below |target_|. Returns false if the
+  // limit on the number of watches is reached. The watches which are still
+  // being added when this returns are tracked by OnRecursiveWatchesAdded(),
+  // which reports an error instead if the limit is reached.
+  bool UpdateRecursiveWatchesForPath(const FilePath& path) WARN_UNUSED_RESULT;
+
+  // Replaces the recursive watches for the sub-directories found by |adder|
+  // with the watches it added.
+  void UpdateRecursiveWatchesFromAdder(RecursiveWatchAdder* adder);
+
+  // Replaces the recursive watch for |path|, if any, with |watch|.
+  void UpdateRecursiveWatch(const FilePath& path, InotifyReader::Watch watch);
 
   // Do internal bookkeeping to update mappings between |watch| and its
   // associated full path |path|.
   void TrackWatchForRecursion(InotifyReader::Watch watch, const FilePath& path);
 
+  // Remove the recursive watches for |dir| and the directories below it which
+  // no longer exist.
+  void RemoveRecursiveWatchesOfMissingDirectories(const FilePath& dir);
+
   // Remove all the recursive watches.
   void RemoveRecursiveWatches();
 
@@ -175,6 +265,9 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate,
 
   bool HasValidWatchVector() const;
 
+  // Cancels the watch, and reports an error to |callback_|.
+  void ReportErrorAndCancel();
+
   // Callback to notify upon changes.
   FilePathWatcher::Callback callback_;
 
@@ -191,9 +284,166 @@ class FilePathWatcherImpl : public FilePathWatcher::PlatformDelegate,
   hash_map<InotifyReader::Watch, FilePath> recursive_paths_by_watch_;
   std::map<FilePath, InotifyReader::Watch> recursive_watches_by_path_;
 
+  // Protects |pending_events_|, which is filled on the inotify reader thread.
+  Lock pending_events_lock_;
+
+  // The events to process. A task is posted to process them whenever events
+  // are added to an empty vector.
+  std::vector<InotifyReader::Event> pending_events_;
+
+  // The number of RecursiveWatchAdders still adding watches on WorkerPool
+  // threads.
+  int pending_recursive_watch_adders_;
+
+  // Whether |callback_| is to be run once the recursive watches being added
+  // are all added: set when ProcessPendingEvents() finds relevant events
+  // meanwhile, or when an adder finishes in the background, since changes in
+  // the directories it had not watched yet were missed.
+  bool notify_after_recursive_watches_added_;
+
   DISALLOW_COPY_AND_ASSIGN(FilePathWatcherImpl);
 };
 
+// Adds the watches for the sub-directories of a directory, recursively. The
+// directories left to list are shared by the thread which calls Run() and up
+// to kMaxRecursiveWatchHelpers WorkerPool threads, which are only asked for
+// help once there are several directories left. Listing a large tree is
+// mostly spent in getdents() and, on a cold cache, in waiting for the disk,
+// both of which go faster on several threads. The thread which calls Run()
+// posts the helpers, and never waits for them: it leaves the last directories
+// to them, and continues from the reply of the first one to return.
+class RecursiveWatchAdder : public RefCountedThreadSafe<RecursiveWatchAdder> {
+ public:
+  typedef std::vector<std::pair<FilePath, InotifyReader::Watch>> Watches;
+  typedef Callback<void(const scoped_refptr<RecursiveWatchAdder>&)>
+      DoneCallback;
+
+  // Adds the watches for the sub-directories of |root| on behalf of
+  // |watcher|, which must outlive this. |done_callback| is run if Run()
+  // returns before the watches are all added.
+  RecursiveWatchAdder(const FilePath& root,
+                      FilePathWatcherImpl* watcher,
+                      const DoneCallback& done_callback);
+
+  // Adds the watches. Returns true if they are all added, or if the limit on
+  // the number of watches is reached. Otherwise returns false as soon as the
+  // directories left are all being listed by helpers, and |done_callback| is
+  // run on the current thread once they are done.
+  bool Run() WARN_UNUSED_RESULT;
+
+  // Returns the sub-directories found by Run(), with their watches, which the
+  // caller now owns. The watch is kInvalidWatch for the sub-directories which
+  // could not be watched. The watches which are not taken are removed when
+  // this is destroyed, since the watcher may be gone by then.
+  Watches TakeWatches();
+
+  bool watch_limit_reached() const { return watch_limit_reached_; }
+
+ private:
+  friend class RefCountedThreadSafe<RecursiveWatchAdder>;
+
+  ~RecursiveWatchAdder();
+
+  // Runs on a WorkerPool thread. Returns once the watches are all added.
+  void Help();
+
+  // The reply to Help(), on the thread of Run().
+  void OnHelperDone();
+
+  // Lists the directories of |pending_dirs_|, and then the ones found in
+  // them, until none are left. Helpers wait for the directories that the
+  // other threads may still find; the thread of Run() returns instead, and is
+  // the only one to post helpers. Must be called with |lock_| held.
+  void ProcessPendingDirectories(bool is_helper);
+
+  const FilePath root_;
+  FilePathWatcherImpl* const watcher_;
+  const DoneCallback done_callback_;
+  const int max_helpers_;
+
+  // Whether Run() returned before the watches were all added. Only accessed
+  // on the thread of Run().
+  bool waiting_for_helpers_;
+
+  // Protects the members below.
+  Lock lock_;
+
+  // Signaled when directories are added to |pending_dirs_|, and once they are
+  // all processed. Only helpers wait on it.
+  ConditionVariable cv_;
+
+  // The directories to list.
+  std::vector<FilePath> pending_dirs_;
+
+  // The number of threads listing a directory.
+  int busy_threads_;
+
+  // The number of helpers posted to the WorkerPool.
+  int helpers_;
+
+  bool done_;
+  bool watch_limit_reached_;
+  Watches watches_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecursiveWatchAdder);
+};
+
+// Appends the sub-directories of |dir| to |subdirs|. Symlinks are ignored
+// rather than followed: following symlinks can easily lead to the undesirable
+// situation where the entire file system is being watched. Unlike
+// FileEnumerator, relies on the file type returned by readdir() rather than
+// calling lstat() for every file, which matters in large trees.
+void ListSubdirectories(const FilePath& dir, std::vector<FilePath>* subdirs) {
+  DIR* dir_stream = opendir(dir.value().c_str());
+  if (!dir_stream)
+    return;
+
+  struct dirent dent_buf;
+  struct dirent* dent;
+  while (readdir_r(dir_stream, &dent_buf, &dent) == 0 && dent) {
+    if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
+      continue;
+
+    if (dent->d_type == DT_DIR) {
+      subdirs->push_back(dir.Append(dent->d_name));
+    } else if (dent->d_type == DT_UNKNOWN) {
+      // Not all file systems report the file type.
+      FilePath path = dir.Append(dent->d_name);
+      struct stat file_info;
+      if (lstat(path.value().c_str(), &file_info) == 0 &&
+          S_ISDIR(file_info.st_mode)) {
+        subdirs->push_back(path);
+      }
+    }
+  }
+  closedir(dir_stream);
+}
+
+// Returns whether |dirs| contains a parent of |path|.
+bool ContainsParentOf(const std::set<FilePath>& dirs, const FilePath& path) {
+  for (FilePath current = path, parent = path.DirName(); parent != current;
+       current = parent, parent = parent.DirName()) {
+    if (ContainsKey(dirs, parent))
+      return true;
+  }
+  return false;
+}
+
+// Returns the limit of inotify watches of the user.
+size_t GetInotifyMaxUserWatches() {
+  // Reading from /proc does not block.
+  ThreadRestrictions::ScopedAllowIO allow_io;
+  std::string max_user_watches_string;
+  size_t max_user_watches;
+  if (!ReadFileToString(FilePath("/proc/sys/fs/inotify/max_user_watches"),
+                        &max_user_watches_string) ||
+      !StringToSizeT(TrimWhitespaceASCII(max_user_watches_string, TRIM_ALL),
+                     &max_user_watches)) {
+    return kDefaultInotifyMaxUserWatches;
+  }
+  return max_user_watches;
+}
+
 void InotifyReaderCallback(InotifyReader* reader, int inotify_fd,
                            int shutdown_fd) {
   // Make sure the file descriptors are good for use with select().
@@ -242,22 +492,40 @@ void InotifyReaderCallback(InotifyReader* reader, int inotify_fd,
       return;
     }
 
+    std::vector<const inotify_event*> events;
     ssize_t i = 0;
     while (i < bytes_read) {
       inotify_event* event = reinterpret_cast<inotify_event*>(&buffer[i]);
       size_t event_size = sizeof(inotify_event) + event->len;
       DCHECK(i + event_size <= static_cast<size_t>(bytes_read));
-      reader->OnInotifyEvent(event);
+      events.push_back(event);
       i += event_size;
     }
+    reader->OnInotifyEvents(events);
   }
 }
 
 static LazyInstance<InotifyReader>::Leaky g_inotify_reader =
     LAZY_INSTANCE_INITIALIZER;
 
+InotifyReader::Event::Event(Watch watch,
+                            const FilePath::StringType& child,
+                            bool created,
+                            bool deleted,
+                            bool is_dir)
+    : watch(watch),
+      child(child),
+      created(created),
+      deleted(deleted),
+      is_dir(is_dir) {}
+
+InotifyReader::Event::Event(const Event& other) = default;
+
+InotifyReader::Event::~Event() {}
+
 InotifyReader::InotifyReader()
-    : thread_("inotify_reader"),
+    : max_watches_(GetInotifyMaxUserWatches() / 2),
+      thread_("inotify_reader"),
       inotify_fd_(inotify_init()),
       valid_(false) {
   if (inotify_fd_ < 0)
@@ -305,6 +573,13 @@ InotifyReader::Watch InotifyReader::AddWatch(
   if (watch == kInvalidWatch)
     return kInvalidWatch;
 
+  if (!ContainsKey(watchers_, watch) &&
+      watchers_.size() >= GetMaxNumberOfInotifyWatches()) {
+    inotify_rm_watch(inotify_fd_, watch);
+    errno = ENOSPC;
+    return kInvalidWatch;
+  }
+
   watchers_[watch].insert(watcher);
 
   return watch;
@@ -324,43 +599,215 @@ void InotifyReader::RemoveWatch(Watch watch, FilePathWatcherImpl* watcher) {
   }
 }
 
-void InotifyReader::OnInotifyEvent(const inotify_event* event) {
-  if (event->mask & IN_IGNORED)
-    return;
+void InotifyReader::OnInotifyEvents(
+    const std::vector<const inotify_event*>& events) {
+  std::map<FilePathWatcherImpl*, std::vector<Event>> events_by_watcher;
+  AutoLock auto_lock(lock_);
 
-  FilePath::StringType child(event->len ? event->name : FILE_PATH_LITERAL(""));
+  for (const inotify_event* event : events) {
+    if (event->mask & IN_Q_OVERFLOW) {
+      // Events were dropped, so any watcher may have missed changes.
+      std::set<FilePathWatcherImpl*> all_watchers;
+      for (const auto& watch_and_watchers : watchers_) {
+        all_watchers.insert(watch_and_watchers.second.begin(),
+                            watch_and_watchers.second.end());
+      }
+      for (FilePathWatcherImpl* watcher : all_watchers) {
+        events_by_watcher[watcher].push_back(Event(
+            kInvalidWatch, FilePath::StringType(), false, false, false));
+      }
+      continue;
+    }
+
+    if (event->mask & IN_IGNORED)
+      continue;
+
+    hash_map<Watch, WatcherSet>::const_iterator watchers =
+        watchers_.find(event->wd);
+    if (watchers == watchers_.end())
+      continue;
+
+    const Event watcher_event(
+        event->wd, event->len ? event->name : FILE_PATH_LITERAL(""),
+        event->mask & (IN_CREATE | IN_MOVED_TO),
+        event->mask & (IN_DELETE | IN_MOVED_FROM), event->mask & IN_ISDIR);
+    for (FilePathWatcherImpl* watcher : watchers->second)
+      events_by_watcher[watcher].push_back(watcher_event);
+  }
+
+  for (const auto& watcher_and_events : events_by_watcher)
+    watcher_and_events.first->OnFilePathsChanged(watcher_and_events.second);
+}
+
+RecursiveWatchAdder::RecursiveWatchAdder(const FilePath& root,
+                                         FilePathWatcherImpl* watcher,
+                                         const DoneCallback& done_callback)
+    : root_(root),
+      watcher_(watcher),
+      done_callback_(done_callback),
+      max_helpers_(std::min(SysInfo::NumberOfProcessors() - 1,
+                            kMaxRecursiveWatchHelpers)),
+      waiting_for_helpers_(false),
+      cv_(&lock_),
+      busy_threads_(0),
+      helpers_(0),
+      done_(false),
+      watch_limit_reached_(false) {}
+
+RecursiveWatchAdder::~RecursiveWatchAdder() {
+  for (const auto& path_and_watch : watches_)
+    g_inotify_reader.Get().RemoveWatch(path_and_watch.second, watcher_);
+}
+
+RecursiveWatchAdder::Watches RecursiveWatchAdder::TakeWatches() {
   AutoLock auto_lock(lock_);
+  DCHECK(done_);
+  Watches watches;
+  watches.swap(watches_);
+  return watches;
+}
+
+bool RecursiveWatchAdder::Run() {
+  AutoLock auto_lock(lock_);
+  DCHECK(!done_);
+  pending_dirs_.push_back(root_);
+  ProcessPendingDirectories(false /* is_helper */);
+  waiting_for_helpers_ = !done_;
+  return done_;
+}
 
-  for (WatcherSet::iterator watcher = watchers_[event->wd].begin();
-       watcher != watchers_[event->wd].end();
-       ++watcher) {
-    (*watcher)->OnFilePathChanged(event->wd,
-                                  child,
-                                  event->mask & (IN_CREATE | IN_MOVED_TO),
-                                  event->mask & (IN_DELETE | IN_MOVED_FROM),
-                                  event->mask & IN_ISDIR);
+void RecursiveWatchAdder::Help() {
+  AutoLock auto_lock(lock_);
+  ProcessPendingDirectories(true /* is_helper */);
+}
+
+void RecursiveWatchAdder::OnHelperDone() {
+  // Helpers only return once the watches are all added.
+  if (!waiting_for_helpers_)
+    return;
+  waiting_for_helpers_ = false;
+  done_callback_.Run(this);
+}
+
+void RecursiveWatchAdder::ProcessPendingDirectories(bool is_helper) {
+  lock_.AssertAcquired();
+  while (!done_) {
+    if (pending_dirs_.empty()) {
+      if (busy_threads_ == 0) {
+        // No other thread may find more directories.
+        done_ = true;
+        cv_.Broadcast();
+      } else if (is_helper) {
+        cv_.Wait();
+      } else {
+        // The busy helpers list the directories they find themselves.
+        return;
+      }
+      continue;
+    }
+
+    const FilePath dir = pending_dirs_.back();
+    pending_dirs_.pop_back();
+    ++busy_threads_;
+    std::vector<FilePath> subdirs;
+    Watches watches;
+    bool watch_limit_reached = false;
+    {
+      AutoUnlock auto_unlock(lock_);
+      ListSubdirectories(dir, &subdirs);
+      // The sub-directories are watched before they are listed, so that no
+      // change in them is missed.
+      for (const FilePath& subdir : subdirs) {
+        InotifyReader::Watch watch =
+            g_inotify_reader.Get().AddWatch(subdir, watcher_);
+        if (watch == InotifyReader::kInvalidWatch && errno == ENOSPC) {
+          watch_limit_reached = true;
+          break;
+        }
+        watches.push_back(std::make_pair(subdir, watch));
+      }
+    }
+    --busy_threads_;
+
+    watches_.insert(watches_.end(), watches.begin(), watches.end());
+    if (watch_limit_reached) {
+      watch_limit_reached_ = true;
+      pending_dirs_.clear();
+      continue;
+    }
+    if (subdirs.empty())
+      continue;
+
+    pending_dirs_.insert(pending_dirs_.end(), subdirs.begin(), subdirs.end());
+    if (!is_helper && pending_dirs_.size() > 1 && helpers_ < max_helpers_) {
+      ++helpers_;
+      WorkerPool::PostTaskAndReply(
+          FROM_HERE, Bind(&RecursiveWatchAdder::Help, this),
+          Bind(&RecursiveWatchAdder::OnHelperDone, this),
+          true /* task_is_slow */);
+    }
+    cv_.Broadcast();
   }
 }
 
 FilePathWatcherImpl::FilePathWatcherImpl()
-    : recursive_(false) {
+    : recursive_(false),
+      pending_recursive_watch_adders_(0),
+      notify_after_recursive_watches_added_(false) {
 }
 
-void FilePathWatcherImpl::OnFilePathChanged(InotifyReader::Watch fired_watch,
-                                            const FilePath::StringType& child,
-                                            bool created,
-                                            bool deleted,
-                                            bool is_dir) {
-  if (!task_runner()->BelongsToCurrentThread()) {
+void FilePathWatcherImpl::OnFilePathsChanged(
+    const std::vector<InotifyReader::Event>& events) {
+  DCHECK(!events.empty());
+  AutoLock auto_lock(pending_events_lock_);
+  if (pending_events_.empty()) {
     // Switch to task_runner() to access |watches_| safely.
-    task_runner()->PostTask(FROM_HERE,
-                            Bind(&FilePathWatcherImpl::OnFilePathChanged, this,
-                                 fired_watch, child, created, deleted, is_dir));
+    task_runner()->PostDelayedTask(
+        FROM_HERE, Bind(&FilePathWatcherImpl::ProcessPendingEvents, this),
+        debounce_delay());
+  }
+  pending_events_.insert(pending_events_.end(), events.begin(), events.end());
+}
+
+void FilePathWatcherImpl::OnRecursiveWatchesAdded(
+    const scoped_refptr<RecursiveWatchAdder>& adder) {
+  DCHECK(task_runner()->BelongsToCurrentThread());
+  DCHECK_GT(pending_recursive_watch_adders_, 0);
+  --pending_recursive_watch_adders_;
+
+  // The watches are removed with |adder| if CancelOnMessageLoopThread() was
+  // called meanwhile.
+  if (!watches_.empty()) {
+    UpdateRecursiveWatchesFromAdder(adder.get());
+    if (adder->watch_limit_reached()) {
+      ReportErrorAndCancel();
+    } else {
+      // Report a possible change so that the caller rescans the directories
+      // which were not watched yet.
+      notify_after_recursive_watches_added_ = true;
+      if (!pending_recursive_watch_adders_)
+        ProcessPendingEvents();
+    }
+  }
+  subtle::Barrier_AtomicIncrement(&g_pending_recursive_watch_adders, -1);
+}
+
+void FilePathWatcherImpl::ProcessPendingEvents() {
+  DCHECK(task_runner()->BelongsToCurrentThread());
+  // The events in the directories whose watches are not tracked yet would be
+  // ignored. OnRecursiveWatchesAdded() calls this again.
+  if (pending_recursive_watch_adders_)
     return;
+
+  std::vector<InotifyReader::Event> events;
+  {
+    AutoLock auto_lock(pending_events_lock_);
+    events.swap(pending_events_);
   }
 
   // Check to see if CancelOnMessageLoopThread() has already been called.
-  // May happen when code flow reaches here from the PostTask() above.
+  // May happen when code flow reaches here from the PostDelayedTask() in
+  // OnFilePathsChanged().
   if (watches_.empty()) {
     DCHECK(target_.empty());
     return;
@@ -369,8 +816,44 @@ void FilePathWatcherImpl::OnFilePathChanged(InotifyReader::Watch fired_watch,
   DCHECK(MessageLoopForIO::current());
   DCHECK(HasValidWatchVector());
 
-  // Used below to avoid multiple recursive updates.
-  bool did_update = false;
+  bool update_watches = false;
+  std::set<FilePath> recursive_dirs;
+  bool notify = notify_after_recursive_watches_added_;
+  notify_after_recursive_watches_added_ = false;
+  for (const InotifyReader::Event& event : events) {
+    if (ProcessEvent(event, &update_watches, &recursive_dirs))
+      notify = true;
+  }
+
+  // UpdateWatches() updates all the recursive watches too.
+  if (update_watches ? !UpdateWatches()
+                     : !UpdateRecursiveWatches(recursive_dirs)) {
+    ReportErrorAndCancel();
+    return;
+  }
+
+  if (!notify)
+    return;
+  // Report the change once the watches of the directories which appeared are
+  // all added, so that no change in them made after the callback is missed.
+  if (pending_recursive_watch_adders_)
+    notify_after_recursive_watches_added_ = true;
+  else
+    callback_.Run(target_, false /* error */);
+}
+
+bool FilePathWatcherImpl::ProcessEvent(const InotifyReader::Event& event,
+                                       bool* update_watches,
+                                       std::set<FilePath>* recursive_dirs) {
+  if (event.watch == InotifyReader::kInvalidWatch) {
+    // Changes were lost. Check everything again, and report a change in case
+    // one of them was relevant.
+    *update_watches = true;
+    return true;
+  }
+
+  const InotifyReader::Watch fired_watch = event.watch;
+  const FilePath::StringType& child = event.child;
 
   // Find the entry in |watches_| that corresponds to |fired_watch|.
   for (size_t i = 0; i < watches_.size(); ++i) {
@@ -416,10 +899,8 @@ void FilePathWatcherImpl::OnFilePathChanged(InotifyReader::Watch fired_watch,
     // checking the event mask to see if it is for a directory here as changes
     // to symlinks on the target path will not have IN_ISDIR set in the event
     // masks. As a result we may sometimes call UpdateWatches() unnecessarily.
-    if (change_on_target_path && (created || deleted) && !did_update) {
-      UpdateWatches();
-      did_update = true;
-    }
+    if (change_on_target_path && (event.created || event.deleted))
+      *update_watches = true;
 
     // Report the following events:
     //  - The target or a direct child of the target got changed (in case the
@@ -429,22 +910,18 @@ void FilePathWatcherImpl::OnFilePathChanged(InotifyReader::Watch fired_watch,
     //  - One of the parent directories appears. The event corresponding to
     //    the target appearing might have been missed in this case, so recheck.
     if (target_changed ||
-        (change_on_target_path && deleted) ||
-        (change_on_target_path && created && PathExists(target_))) {
-      if (!did_update) {
-        UpdateRecursiveWatches(fired_watch, is_dir);
-        did_update = true;
-      }
-      callback_.Run(target_, false /* error */);
-      return;
+        (change_on_target_path && event.deleted) ||
+        (change_on_target_path && event.created && PathExists(target_))) {
+      AddRecursiveDirToUpdate(event, recursive_dirs);
+      return true;
     }
   }
 
   if (ContainsKey(recursive_paths_by_watch_, fired_watch)) {
-    if (!did_update)
-      UpdateRecursiveWatches(fired_watch, is_dir);
-    callback_.Run(target_, false /* error */);
+    AddRecursiveDirToUpdate(event, recursive_dirs);
+    return true;
   }
+  return false;
 }
 
 bool FilePathWatcherImpl::Watch(const FilePath& path,
@@ -465,7 +942,10 @@ bool FilePathWatcherImpl::Watch(const FilePath& path,
   for (size_t i = 1; i < comps.size(); ++i)
     watches_.push_back(WatchEntry(comps[i]));
   watches_.push_back(WatchEntry(FilePath::StringType()));
-  UpdateWatches();
+  if (!UpdateWatches()) {
+    CancelOnMessageLoopThread();
+    return false;
+  }
   return true;
 }
 
@@ -507,7 +987,7 @@ void FilePathWatcherImpl::WillDestroyCurrentMessageLoop() {
   CancelOnMessageLoopThread();
 }
 
-void FilePathWatcherImpl::UpdateWatches() {
+bool FilePathWatcherImpl::UpdateWatches() {
   // Ensure this runs on the message_loop() exclusively in order to avoid
   // concurrency issues.
   DCHECK(task_runner()->BelongsToCurrentThread());
@@ -522,6 +1002,10 @@ void FilePathWatcherImpl::UpdateWatches() {
     watch_entry.linkname.clear();
     watch_entry.watch = g_inotify_reader.Get().AddWatch(path, this);
     if (watch_entry.watch == InotifyReader::kInvalidWatch) {
+      if (errno == ENOSPC) {
+        g_inotify_reader.Get().RemoveWatch(old_watch, this);
+        return false;
+      }
       // Ignore the error code (beyond symlink handling) to attempt to add
       // watches on accessible children of unreadable directories. Note that
       // this is a best-effort attempt; we may not catch events in this
@@ -534,84 +1018,108 @@ void FilePathWatcherImpl::UpdateWatches() {
     path = path.Append(watch_entry.subdir);
   }
 
-  UpdateRecursiveWatches(InotifyReader::kInvalidWatch,
-                         false /* is directory? */);
+  return UpdateRecursiveWatches(std::set<FilePath>{target_});
 }
 
-void FilePathWatcherImpl::UpdateRecursiveWatches(
-    InotifyReader::Watch fired_watch,
-    bool is_dir) {
-  if (!recursive_)
-    return;
+bool FilePathWatcherImpl::UpdateRecursiveWatches(
+    const std::set<FilePath>& dirs) {
+  if (!recursive_ || dirs.empty())
+    return true;
 
   if (!DirectoryExists(target_)) {
     RemoveRecursiveWatches();
-    return;
+    return true;
   }
 
-  // Check to see if this is a forced update or if some component of |target_|
-  // has changed. For these cases, redo the watches for |target_| and below.
-  if (!ContainsKey(recursive_paths_by_watch_, fired_watch)) {
-    UpdateRecursiveWatchesForPath(target_);
-    return;
+  // Remove the watches of the directories which disappeared first: the
+  // directories which moved within |target_| keep their watches, which must
+  // not be tracked for both their old and new paths.
+  for (const FilePath& dir : dirs) {
+    if (!ContainsParentOf(dirs, dir))
+      RemoveRecursiveWatchesOfMissingDirectories(dir);
   }
 
-  // Underneath |target_|, only directory changes trigger watch updates.
-  if (!is_dir)
-    return;
+  for (const FilePath& dir : dirs) {
+    if (!ContainsParentOf(dirs, dir) && !UpdateRecursiveWatchesForPath(dir))
+      return false;
+  }
+  return true;
+}
 
-  const FilePath& changed_dir = recursive_paths_by_watch_[fired_watch];
+void FilePathWatcherImpl::AddRecursiveDirToUpdate(
+    const InotifyReader::Event& event,
+    std::set<FilePath>* recursive_dirs) const {
+  if (!recursive_)
+    return;
 
-  std::map<FilePath, InotifyReader::Watch>::iterator start_it =
-      recursive_watches_by_path_.lower_bound(changed_dir);
-  std::map<FilePath, InotifyReader::Watch>::iterator end_it = start_it;
-  for (; end_it != recursive_watches_by_path_.end(); ++end_it) {
-    const FilePath& cur_path = end_it->first;
-    if (!changed_dir.IsParent(cur_path))
-      break;
-    if (!DirectoryExists(cur_path))
-      g_inotify_reader.Get().RemoveWatch(end_it->second, this);
+  // The directory in which the change happened.
+  FilePath changed_dir;
+  hash_map<InotifyReader::Watch, FilePath>::const_iterator it =
+      recursive_paths_by_watch_.find(event.watch);
+  if (it != recursive_paths_by_watch_.end()) {
+    changed_dir = it->second;
+  } else if (event.watch == watches_.back().watch &&
+             watches_.back().linkname.empty()) {
+    changed_dir = target_;
+  } else {
+    // Some component of |target_| has changed. Redo the watches for |target_|
+    // and below.
+    recursive_dirs->insert(target_);
+    return;
   }
-  recursive_watches_by_path_.erase(start_it, end_it);
-  UpdateRecursiveWatchesForPath(changed_dir);
+
+  // Underneath |target_|, only the directories which appear or disappear
+  // trigger watch updates, for them and below.
+  if (event.is_dir && !event.child.empty() && (event.created || event.deleted))
+    recursive_dirs->insert(changed_dir.Append(event.child));
 }
 
-void FilePathWatcherImpl::UpdateRecursiveWatchesForPath(const FilePath& path) {
+bool FilePathWatcherImpl::UpdateRecursiveWatchesForPath(const FilePath& path) {
   DCHECK(recursive_);
   DCHECK(!path.empty());
-  DCHECK(DirectoryExists(path));
-
-  // Note: SHOW_SYM_LINKS exposes symlinks as symlinks, so they are ignored
-  // rather than followed. Following symlinks can easily lead to the undesirable
-  // situation where the entire file system is being watched.
-  FileEnumerator enumerator(
-      path,
-      true /* recursive enumeration */,
-      FileEnumerator::DIRECTORIES | FileEnumerator::SHOW_SYM_LINKS);
-  for (FilePath current = enumerator.Next();
-       !current.empty();
-       current = enumerator.Next()) {
-    DCHECK(enumerator.GetInfo().IsDirectory());
-
-    if (!ContainsKey(recursive_watches_by_path_, current)) {
-      // Add new watches.
-      InotifyReader::Watch watch =
-          g_inotify_reader.Get().AddWatch(current, this);
-      TrackWatchForRecursion(watch, current);
-    } else {
-      // Update existing watches.
-      InotifyReader::Watch old_watch = recursive_watches_by_path_[current];
-      DCHECK_NE(InotifyReader::kInvalidWatch, old_watch);
-      InotifyReader::Watch watch =
-          g_inotify_reader.Get().AddWatch(current, this);
-      if (watch != old_watch) {
-        g_inotify_reader.Get().RemoveWatch(old_watch, this);
-        recursive_paths_by_watch_.erase(old_watch);
-        recursive_watches_by_path_.erase(current);
-        TrackWatchForRecursion(watch, current);
-      }
-    }
+
+  if (path != target_) {
+    // Like the sub-directories found by RecursiveWatchAdder, |path| is only
+    // watched if it is a directory, and not a symlink.
+    if (IsLink(path) || !DirectoryExists(path))
+      return true;
+    InotifyReader::Watch watch = g_inotify_reader.Get().AddWatch(path, this);
+    if (watch == InotifyReader::kInvalidWatch && errno == ENOSPC)
+      return false;
+    UpdateRecursiveWatch(path, watch);
+  }
+
+  scoped_refptr<RecursiveWatchAdder> adder(new RecursiveWatchAdder(
+      path, this, Bind(&FilePathWatcherImpl::OnRecursiveWatchesAdded, this)));
+  if (!adder->Run()) {
+    ++pending_recursive_watch_adders_;
+    subtle::Barrier_AtomicIncrement(&g_pending_recursive_watch_adders, 1);
+    return true;
+  }
+  UpdateRecursiveWatchesFromAdder(adder.get());
+  return !adder->watch_limit_reached();
+}
+
+void FilePathWatcherImpl::UpdateRecursiveWatchesFromAdder(
+    RecursiveWatchAdder* adder) {
+  for (const auto& path_and_watch : adder->TakeWatches())
+    UpdateRecursiveWatch(path_and_watch.first, path_and_watch.second);
+}
+
+void FilePathWatcherImpl::UpdateRecursiveWatch(const FilePath& path,
+                                               InotifyReader::Watch watch) {
+  std::map<FilePath, InotifyReader::Watch>::iterator it =
+      recursive_watches_by_path_.find(path);
+  if (it != recursive_watches_by_path_.end()) {
+    InotifyReader::Watch old_watch = it->second;
+    DCHECK_NE(InotifyReader::kInvalidWatch, old_watch);
+    if (watch == old_watch)
+      return;
+    g_inotify_reader.Get().RemoveWatch(old_watch, this);
+    recursive_paths_by_watch_.erase(old_watch);
+    recursive_watches_by_path_.erase(it);
   }
+  TrackWatchForRecursion(watch, path);
 }
 
 void FilePathWatcherImpl::TrackWatchForRecursion(InotifyReader::Watch watch,
@@ -629,6 +1137,29 @@ void FilePathWatcherImpl::TrackWatchForRecursion(InotifyReader::Watch watch,
   recursive_watches_by_path_[path] = watch;
 }
 
+void FilePathWatcherImpl::RemoveRecursiveWatchesOfMissingDirectories(
+    const FilePath& dir) {
+  std::vector<FilePath> missing_dirs;
+  if (ContainsKey(recursive_watches_by_path_, dir) && !DirectoryExists(dir))
+    missing_dirs.push_back(dir);
+  // The paths below |dir| start with |dir| and a separator, so they are
+  // contiguous in |recursive_watches_by_path_|.
+  for (std::map<FilePath, InotifyReader::Watch>::const_iterator it =
+           recursive_watches_by_path_.lower_bound(dir.AsEndingWithSeparator());
+       it != recursive_watches_by_path_.end() && dir.IsParent(it->first);
+       ++it) {
+    if (!DirectoryExists(it->first))
+      missing_dirs.push_back(it->first);
+  }
+
+  for (const FilePath& missing_dir : missing_dirs) {
+    InotifyReader::Watch watch = recursive_watches_by_path_[missing_dir];
+    g_inotify_reader.Get().RemoveWatch(watch, this);
+    recursive_paths_by_watch_.erase(watch);
+    recursive_watches_by_path_.erase(missing_dir);
+  }
+}
+
 void FilePathWatcherImpl::RemoveRecursiveWatches() {
   if (!recursive_)
     return;
@@ -680,10 +1211,41 @@ bool FilePathWatcherImpl::HasValidWatchVector() const {
   return watches_.back().subdir.empty();
 }
 
+void FilePathWatcherImpl::ReportErrorAndCancel() {
+  DLOG(WARNING) << "Too many inotify watches to watch " << target_.value();
+  // Cancel first, since the callback may delete the FilePathWatcher. It is not
+  // invoked again.
+  FilePathWatcher::Callback callback = callback_;
+  FilePath target = target_;
+  CancelOnMessageLoopThread();
+  callback.Run(target, true /* error */);
+}
+
 }  // namespace
 
 FilePathWatcher::FilePathWatcher() {
   impl_ = new FilePathWatcherImpl();
 }
 
+size_t GetMaxNumberOfInotifyWatches() {
+  if (g_override_max_inotify_watches)
+    return g_override_max_inotify_watches;
+  return g_inotify_reader.Get().max_watches();
+}
+
+bool HasPendingRecursiveWatchesForTest() {
+  return subtle::Acquire_Load(&g_pending_recursive_watch_adders) != 0;
+}
+
+ScopedMaxNumberOfInotifyWatchesOverrideForTest::
+    ScopedMaxNumberOfInotifyWatchesOverrideForTest(size_t override_max) {
+  DCHECK(!g_override_max_inotify_watches);
+  g_override_max_inotify_watches = override_max;
+}
+
+ScopedMaxNumberOfInotifyWatchesOverrideForTest::
+    ~ScopedMaxNumberOfInotifyWatchesOverrideForTest() {
+  g_override_max_inotify_watches = 0;
+}
+
 }  // namespace base
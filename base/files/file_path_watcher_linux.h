@@ -0,0 +1,37 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_FILE_PATH_WATCHER_LINUX_H_
+#define BASE_FILES_FILE_PATH_WATCHER_LINUX_H_
+
+#include <stddef.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+
+namespace base {
+
+// Returns the maximum number of inotify watches the FilePathWatchers of the
+// process may use together. This is half of the limit of the user, which is
+// shared with the other processes of the user, such as file managers.
+BASE_EXPORT size_t GetMaxNumberOfInotifyWatches();
+
+// Returns whether some FilePathWatcher is still adding the watches of a
+// recursive watch in the background.
+BASE_EXPORT bool HasPendingRecursiveWatchesForTest();
+
+// Overrides the limit returned by GetMaxNumberOfInotifyWatches() during its
+// lifetime.
+class BASE_EXPORT ScopedMaxNumberOfInotifyWatchesOverrideForTest {
+ public:
+  explicit ScopedMaxNumberOfInotifyWatchesOverrideForTest(size_t override_max);
+  ~ScopedMaxNumberOfInotifyWatchesOverrideForTest();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedMaxNumberOfInotifyWatchesOverrideForTest);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_FILE_PATH_WATCHER_LINUX_H_
@@ -0,0 +1,144 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_path_watcher.h"
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/location.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#if defined(OS_LINUX)
+#include "base/files/file_path_watcher_linux.h"
+#endif  // defined(OS_LINUX)
+
+namespace base {
+
+namespace {
+
+// A tree of 100K files, in 1000 directories of 100 files each.
+const int kNumDirs = 100;
+const int kNumSubdirsPerDir = 10;
+const int kNumFilesPerSubdir = 100;
+
+// How long without notifications before the changes are considered to have
+// all been reported.
+const int kQuietPeriodMs = 500;
+
+// Watches a large tree recursively, and then rewrites all its files at once,
+// which also overflows the inotify event queue on Linux.
+class FilePathWatcherPerfTest : public testing::Test {
+ public:
+  FilePathWatcherPerfTest()
+      : loop_(MessageLoop::TYPE_IO), num_notifications_(0) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    root_ = temp_dir_.path().AppendASCII("root");
+    for (int i = 0; i < kNumDirs; ++i) {
+      for (int j = 0; j < kNumSubdirsPerDir; ++j) {
+        FilePath subdir = root_.AppendASCII(StringPrintf("dir%d", i))
+                              .AppendASCII(StringPrintf("subdir%d", j));
+        ASSERT_TRUE(CreateDirectory(subdir));
+        for (int k = 0; k < kNumFilesPerSubdir; ++k) {
+          files_.push_back(subdir.AppendASCII(StringPrintf("file%d", k)));
+          ASSERT_EQ(1, WriteFile(files_.back(), "a", 1));
+        }
+      }
+    }
+  }
+
+  void Run(TimeDelta debounce_delay, const std::string& trace) {
+    FilePathWatcher watcher;
+    watcher.SetDebounceDelay(debounce_delay);
+    TimeTicks start = TimeTicks::Now();
+    ASSERT_TRUE(watcher.Watch(
+        root_, true /* recursive */,
+        Bind(&FilePathWatcherPerfTest::OnFileChanged, Unretained(this))));
+#if defined(OS_LINUX)
+    // The watches of the sub-directories are added in the background, after
+    // which a possible change is reported.
+    while (HasPendingRecursiveWatchesForTest()) {
+      RunLoop().RunUntilIdle();
+      PlatformThread::Sleep(TimeDelta::FromMilliseconds(1));
+    }
+    RunLoop().RunUntilIdle();
+    num_notifications_ = 0;
+#endif  // defined(OS_LINUX)
+    perf_test::PrintResult("watch_setup", "", trace,
+                           (TimeTicks::Now() - start).InMillisecondsF(), "ms",
+                           true);
+
+    start = TimeTicks::Now();
+    for (const FilePath& file : files_)
+      ASSERT_EQ(1, WriteFile(file, "b", 1));
+    RunUntilQuiet();
+    EXPECT_LT(0u, num_notifications_);
+    perf_test::PrintResult("notifications", "", trace, num_notifications_,
+                           "count", true);
+    perf_test::PrintResult("notification_time", "", trace,
+                           (last_notification_time_ - start).InMillisecondsF(),
+                           "ms", true);
+
+    // The deepest directories are still watched.
+    num_notifications_ = 0;
+    ASSERT_EQ(1, WriteFile(files_.back(), "c", 1));
+    RunUntilQuiet();
+    EXPECT_EQ(1u, num_notifications_);
+  }
+
+ private:
+  void OnFileChanged(const FilePath& path, bool error) {
+    EXPECT_FALSE(error);
+    ++num_notifications_;
+    last_notification_time_ = TimeTicks::Now();
+    if (quiet_timer_.IsRunning())
+      quiet_timer_.Reset();
+  }
+
+  // Runs the message loop until no notification came for a while.
+  void RunUntilQuiet() {
+    RunLoop run_loop;
+    quiet_timer_.Start(FROM_HERE,
+                       TimeDelta::FromMilliseconds(kQuietPeriodMs),
+                       run_loop.QuitClosure());
+    run_loop.Run();
+  }
+
+  MessageLoop loop_;
+  ScopedTempDir temp_dir_;
+  FilePath root_;
+  std::vector<FilePath> files_;
+  size_t num_notifications_;
+  TimeTicks last_notification_time_;
+  OneShotTimer quiet_timer_;
+};
+
+}  // namespace
+
+TEST_F(FilePathWatcherPerfTest, LargeTree) {
+  Run(TimeDelta(), "large_tree");
+}
+
+TEST_F(FilePathWatcherPerfTest, LargeTreeWithDebounceDelay) {
+  Run(TimeDelta::FromMilliseconds(100), "large_tree_debounced");
+}
+
+}  // namespace base
@@ -13,6 +13,7 @@
 
 #include <set>
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/compiler_specific.h"
@@ -28,7 +29,9 @@
 #include "base/synchronization/waitable_event.h"
 #include "base/test/test_file_util.h"
 #include "base/test/test_timeouts.h"
+#include "base/threading/platform_thread.h"
 #include "base/threading/thread.h"
+#include "base/threading/thread_restrictions.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -37,6 +40,10 @@
 #include "base/android/path_utils.h"
 #endif  // defined(OS_ANDROID)
 
+#if defined(OS_LINUX)
+#include "base/files/file_path_watcher_linux.h"
+#endif  // defined(OS_LINUX)
+
 namespace base {
 
 namespace {
@@ -131,6 +138,31 @@ class TestDelegate : public TestDelegateBase {
   DISALLOW_COPY_AND_ASSIGN(TestDelegate);
 };
 
+// Like TestDelegate, but also counts the notifications, and those which report
+// an error.
+class CountingDelegate : public TestDelegate {
+ public:
+  explicit CountingDelegate(NotificationCollector* collector)
+      : TestDelegate(collector), count_(0), error_count_(0) {}
+  ~CountingDelegate() override {}
+
+  void OnFileChanged(const FilePath& path, bool error) override {
+    subtle::NoBarrier_AtomicIncrement(&count_, 1);
+    if (error)
+      subtle::NoBarrier_AtomicIncrement(&error_count_, 1);
+    TestDelegate::OnFileChanged(path, false);
+  }
+
+  int count() const { return subtle::NoBarrier_Load(&count_); }
+  int error_count() const { return subtle::NoBarrier_Load(&error_count_); }
+
+ private:
+  subtle::Atomic32 count_;
+  subtle::Atomic32 error_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingDelegate);
+};
+
 void SetupWatchCallback(const FilePath& target,
                         FilePathWatcher* watcher,
                         TestDelegateBase* delegate,
@@ -226,6 +258,13 @@ bool FilePathWatcherTest::SetupWatch(const FilePath& target,
       FROM_HERE, base::Bind(SetupWatchCallback, target, watcher, delegate,
                             recursive_watch, &result, &completion));
   completion.Wait();
+#if defined(OS_LINUX)
+  // Don't miss the changes made in the sub-directories which are not watched
+  // yet, and drop the possible change reported once they all are.
+  while (HasPendingRecursiveWatchesForTest())
+    PlatformThread::Sleep(TestTimeouts::tiny_timeout());
+  RunLoop().RunUntilIdle();
+#endif  // defined(OS_LINUX)
   return result;
 }
 
@@ -831,6 +870,116 @@ TEST_F(FilePathWatcherTest, LinkedDirectoryPart3) {
   DeleteDelegateOnFileThread(delegate.release());
 }
 
+// Verify that the watches of a recursive watch are set up for a whole tree,
+// without waiting on the thread of the watch, and follow the directories which
+// move within it.
+TEST_F(FilePathWatcherTest, RecursiveWatchOfTree) {
+  FilePath dir(temp_dir_.path().AppendASCII("dir"));
+  std::vector<FilePath> leaf_dirs;
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      leaf_dirs.push_back(dir.AppendASCII(StringPrintf("dir%d", i))
+                             .AppendASCII(StringPrintf("subdir%d", j)));
+      ASSERT_TRUE(base::CreateDirectory(leaf_dirs.back()));
+    }
+  }
+
+  file_thread_.task_runner()->PostTask(
+      FROM_HERE, Bind(&ThreadRestrictions::DisallowWaiting));
+  FilePathWatcher watcher;
+  std::unique_ptr<TestDelegate> delegate(new TestDelegate(collector()));
+  ASSERT_TRUE(SetupWatch(dir, &watcher, delegate.get(), true));
+  for (const FilePath& leaf_dir : leaf_dirs) {
+    ASSERT_TRUE(WriteFile(leaf_dir.AppendASCII("file"), "content"));
+    ASSERT_TRUE(WaitForEvents());
+  }
+
+  // Move "$dir/dir0" to "$dir/moved".
+  FilePath moved_dir(dir.AppendASCII("moved"));
+  ASSERT_TRUE(base::Move(dir.AppendASCII("dir0"), moved_dir));
+  ASSERT_TRUE(WaitForEvents());
+
+  // Write into "$dir/moved/subdir0/file".
+  ASSERT_TRUE(
+      WriteFile(moved_dir.AppendASCII("subdir0").AppendASCII("file"), "v2"));
+  ASSERT_TRUE(WaitForEvents());
+
+  // Delete "$dir/moved", and write into "$dir/dir1/subdir0/file".
+  ASSERT_TRUE(base::DeleteFile(moved_dir, true));
+  ASSERT_TRUE(WaitForEvents());
+  ASSERT_TRUE(WriteFile(leaf_dirs[8].AppendASCII("file"), "v2"));
+  ASSERT_TRUE(WaitForEvents());
+  DeleteDelegateOnFileThread(delegate.release());
+}
+
+// Verify that the changes within the debounce delay are reported once.
+TEST_F(FilePathWatcherTest, DebounceDelay) {
+  FilePath dir(temp_dir_.path().AppendASCII("dir"));
+  ASSERT_TRUE(base::CreateDirectory(dir));
+
+  FilePathWatcher watcher;
+  watcher.SetDebounceDelay(TestTimeouts::tiny_timeout() * 5);
+  std::unique_ptr<CountingDelegate> delegate(new CountingDelegate(collector()));
+  ASSERT_TRUE(SetupWatch(dir, &watcher, delegate.get(), false));
+
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(
+        WriteFile(dir.AppendASCII(StringPrintf("file%d", i)), "content"));
+  }
+  ASSERT_TRUE(WaitForEvents());
+  EXPECT_EQ(1, delegate->count());
+  EXPECT_EQ(0, delegate->error_count());
+  DeleteDelegateOnFileThread(delegate.release());
+}
+
+// Verify that a recursive watch which needs more inotify watches than allowed
+// fails, or reports an error.
+TEST_F(FilePathWatcherTest, RecursiveWatchOverWatchLimit) {
+  FilePath dir(temp_dir_.path().AppendASCII("dir"));
+  ASSERT_TRUE(base::CreateDirectory(dir.AppendASCII("subdir1")));
+  ASSERT_TRUE(base::CreateDirectory(dir.AppendASCII("subdir2")));
+  // A watch is needed for each component of |dir|, and each sub-directory.
+  std::vector<FilePath::StringType> components;
+  dir.GetComponents(&components);
+
+  {
+    ScopedMaxNumberOfInotifyWatchesOverrideForTest max_watches(
+        components.size() + 1);
+    FilePathWatcher watcher;
+    // Not registered with collector(), since it is never notified.
+    scoped_refptr<NotificationCollector> unused_collector(
+        new NotificationCollector());
+    std::unique_ptr<CountingDelegate> delegate(
+        new CountingDelegate(unused_collector.get()));
+    EXPECT_FALSE(SetupWatch(dir, &watcher, delegate.get(), true));
+    EXPECT_EQ(0, delegate->count());
+    DeleteDelegateOnFileThread(delegate.release());
+  }
+
+  ScopedMaxNumberOfInotifyWatchesOverrideForTest max_watches(
+      components.size() + 2);
+  FilePathWatcher watcher;
+  std::unique_ptr<CountingDelegate> delegate(new CountingDelegate(collector()));
+  ASSERT_TRUE(SetupWatch(dir, &watcher, delegate.get(), true));
+  // A change is reported if the watches were added in the background.
+  const int setup_count = delegate->count();
+  EXPECT_EQ(0, delegate->error_count());
+
+  ASSERT_TRUE(base::CreateDirectory(dir.AppendASCII("subdir3")));
+  ASSERT_TRUE(WaitForEvents());
+  EXPECT_EQ(setup_count + 1, delegate->count());
+  EXPECT_EQ(1, delegate->error_count());
+
+  // The callback is not invoked after an error.
+  ASSERT_TRUE(WriteFile(dir.AppendASCII("file"), "content"));
+  loop_.task_runner()->PostDelayedTask(FROM_HERE,
+                                       MessageLoop::QuitWhenIdleClosure(),
+                                       TestTimeouts::tiny_timeout());
+  ASSERT_FALSE(WaitForEvents());
+  EXPECT_EQ(setup_count + 1, delegate->count());
+  DeleteDelegateOnFileThread(delegate.release());
+}
+
 #endif  // OS_LINUX
 
 enum Permission {
@@ -0,0 +1,127 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/important_file_write_batcher.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/critical_closure.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/numerics/safe_conversions.h"
+#include "base/sequenced_task_runner.h"
+#include "base/strings/string_piece.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+
+namespace base {
+
+ImportantFileWriteBatcher::PendingWrite::PendingWrite() {}
+
+ImportantFileWriteBatcher::PendingWrite::PendingWrite(
+    const PendingWrite& other) = default;
+
+ImportantFileWriteBatcher::PendingWrite::~PendingWrite() {}
+
+ImportantFileWriteBatcher::ImportantFileWriteBatcher(
+    scoped_refptr<SequencedTaskRunner> task_runner,
+    TimeDelta flush_window)
+    : task_runner_(std::move(task_runner)),
+      flush_window_(flush_window),
+      commit_scheduled_(false) {
+  DCHECK(task_runner_);
+}
+
+ImportantFileWriteBatcher::~ImportantFileWriteBatcher() {
+  DLOG_IF(WARNING, !pending_writes_.empty())
+      << pending_writes_.size() << " important file writes were lost";
+}
+
+void ImportantFileWriteBatcher::AddWrite(const FilePath& path,
+                                         const DataProducer& producer,
+                                         const WriteCallback& callback) {
+  DCHECK(!producer.is_null());
+  scoped_refptr<SequencedTaskRunner> callback_task_runner;
+  if (!callback.is_null())
+    callback_task_runner = SequencedTaskRunnerHandle::Get();
+
+  AutoLock auto_lock(lock_);
+  PendingWrite* write = nullptr;
+  for (PendingWrite& pending_write : pending_writes_) {
+    if (pending_write.path == path) {
+      write = &pending_write;
+      break;
+    }
+  }
+  if (!write) {
+    pending_writes_.push_back(PendingWrite());
+    write = &pending_writes_.back();
+    write->path = path;
+  }
+  write->producer = producer;
+  if (!callback.is_null())
+    write->callbacks.push_back(std::make_pair(callback_task_runner, callback));
+
+  if (!commit_scheduled_) {
+    commit_scheduled_ = true;
+    task_runner_->PostDelayedTask(
+        FROM_HERE, Bind(&ImportantFileWriteBatcher::Commit, this),
+        flush_window_);
+  }
+}
+
+void ImportantFileWriteBatcher::CommitPendingWrites() {
+  // The delayed task posted by AddWrite() finds nothing to commit, or commits
+  // the writes added since.
+  bool posted = task_runner_->PostTask(
+      FROM_HERE,
+      MakeCriticalClosure(Bind(&ImportantFileWriteBatcher::Commit, this)));
+  DCHECK(posted);
+}
+
+void ImportantFileWriteBatcher::Commit() {
+  DCHECK(task_runner_->RunsTasksOnCurrentThread());
+  std::vector<PendingWrite> writes;
+  {
+    AutoLock auto_lock(lock_);
+    writes.swap(pending_writes_);
+    commit_scheduled_ = false;
+  }
+  if (writes.empty())
+    return;
+
+  std::vector<std::string> data(writes.size());
+  std::vector<std::pair<FilePath, StringPiece>> files;
+  // The index in |writes| of each of |files|.
+  std::vector<size_t> write_indices;
+  for (size_t i = 0; i < writes.size(); ++i) {
+    const bool produced = writes[i].producer.Run(&data[i]);
+    // Releases the snapshot of the data, which may be large.
+    writes[i].producer.Reset();
+    if (!produced || !IsValueInRangeForNumericType<int32_t>(data[i].size())) {
+      DLOG(WARNING) << "failed to serialize data to be saved in "
+                    << writes[i].path.value();
+      continue;
+    }
+    files.push_back(std::make_pair(writes[i].path, StringPiece(data[i])));
+    write_indices.push_back(i);
+  }
+
+  const std::vector<bool> saved =
+      ImportantFileWriter::WriteFilesAtomically(files);
+
+  std::vector<bool> results(writes.size(), false);
+  for (size_t i = 0; i < saved.size(); ++i)
+    results[write_indices[i]] = saved[i];
+  for (size_t i = 0; i < writes.size(); ++i) {
+    const bool success = results[i];
+    for (const auto& callback : writes[i].callbacks)
+      callback.first->PostTask(FROM_HERE, Bind(callback.second, success));
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,107 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_IMPORTANT_FILE_WRITE_BATCHER_H_
+#define BASE_FILES_IMPORTANT_FILE_WRITE_BATCHER_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/files/important_file_writer.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace base {
+
+class SequencedTaskRunner;
+
+// Commits the writes of several important files together, on a shared task
+// runner. Each file is still written atomically, as with
+// ImportantFileWriter::WriteFileAtomically(), but the writes added within a
+// flush window are flushed to disk together (see
+// ImportantFileWriter::WriteFilesAtomically()), rather than each paying for
+// a synchronous flush of its own. The data of a write is produced on the task
+// runner, which lets ImportantFileWriters serialize in the background.
+//
+// Writes which wait for the end of the flush window are lost if the task
+// runner skips delayed tasks at shutdown, as SequencedWorkerPool does: call
+// CommitPendingWrites() before shutting down. ImportantFileWriter does so
+// in WriteNow() and DoScheduledWrite(), and reports the writes it hands off
+// as pending until they are committed.
+//
+// Can be used from any thread.
+class BASE_EXPORT ImportantFileWriteBatcher
+    : public RefCountedThreadSafe<ImportantFileWriteBatcher> {
+ public:
+  using DataProducer = ImportantFileWriter::DataProducer;
+  // Called with whether the file was saved.
+  using WriteCallback = Callback<void(bool success)>;
+
+  // |task_runner| is where the data is produced and the files are written.
+  // |flush_window| is how long the first write of a batch waits for others.
+  ImportantFileWriteBatcher(scoped_refptr<SequencedTaskRunner> task_runner,
+                            TimeDelta flush_window);
+
+  const scoped_refptr<SequencedTaskRunner>& task_runner() const {
+    return task_runner_;
+  }
+
+  // Saves the data produced by |producer| to |path| at the end of the flush
+  // window. Replaces the write of a previous call for the same |path| which is
+  // not committed yet. If not null, |callback| is run on the current sequence
+  // once the file is saved or failed to be, including when the write is
+  // replaced.
+  void AddWrite(const FilePath& path,
+                const DataProducer& producer,
+                const WriteCallback& callback);
+
+  // Commits the pending writes without waiting for the end of the flush
+  // window. Does not block.
+  void CommitPendingWrites();
+
+ private:
+  friend class RefCountedThreadSafe<ImportantFileWriteBatcher>;
+
+  struct PendingWrite {
+    PendingWrite();
+    PendingWrite(const PendingWrite& other);
+    ~PendingWrite();
+
+    FilePath path;
+    DataProducer producer;
+    // The callbacks to run with the result, with the sequences to run them on.
+    std::vector<std::pair<scoped_refptr<SequencedTaskRunner>, WriteCallback>>
+        callbacks;
+  };
+
+  ~ImportantFileWriteBatcher();
+
+  // Produces the data of the pending writes and saves them. Runs on
+  // |task_runner_|.
+  void Commit();
+
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+  const TimeDelta flush_window_;
+
+  // Protects the members below.
+  Lock lock_;
+
+  // The writes to commit, at most one per path.
+  std::vector<PendingWrite> pending_writes_;
+
+  // Whether a task is posted to commit |pending_writes_| at the end of the
+  // flush window.
+  bool commit_scheduled_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImportantFileWriteBatcher);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_IMPORTANT_FILE_WRITE_BATCHER_H_
@@ -0,0 +1,209 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/important_file_write_batcher.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/test/histogram_tester.h"
+#include "base/test/test_mock_time_task_runner.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+std::string GetFileContent(const FilePath& path) {
+  std::string content;
+  if (!ReadFileToString(path, &content))
+    return "<missing>";
+  return content;
+}
+
+bool Produce(const std::string& data, std::string* output) {
+  output->assign(data);
+  return true;
+}
+
+bool FailToProduce(std::string* output) {
+  return false;
+}
+
+ImportantFileWriter::DataProducer Producer(const std::string& data) {
+  return Bind(&Produce, data);
+}
+
+void AppendResult(std::vector<bool>* results, bool success) {
+  results->push_back(success);
+}
+
+void SetTrue(bool* value) {
+  *value = true;
+}
+
+class DataSerializer : public ImportantFileWriter::DataSerializer {
+ public:
+  explicit DataSerializer(const std::string& data) : data_(data) {}
+
+  bool SerializeData(std::string* output) override {
+    output->assign(data_);
+    return true;
+  }
+
+ private:
+  const std::string data_;
+};
+
+}  // namespace
+
+// The file I/O is done on |file_task_runner_|, which runs its tasks on the
+// main thread, at mock times. The callbacks are run by |loop_|.
+class ImportantFileWriteBatcherTest : public testing::Test {
+ public:
+  ImportantFileWriteBatcherTest()
+      : file_task_runner_(new TestMockTimeTaskRunner) {}
+
+  void SetUp() override { ASSERT_TRUE(temp_dir_.CreateUniqueTempDir()); }
+
+ protected:
+  FilePath GetPath(const std::string& name) const {
+    return temp_dir_.path().AppendASCII(name);
+  }
+
+  scoped_refptr<ImportantFileWriteBatcher> CreateBatcher(
+      TimeDelta flush_window) {
+    return make_scoped_refptr(
+        new ImportantFileWriteBatcher(file_task_runner_, flush_window));
+  }
+
+  // Runs the file tasks which are due after |delta|, and then the callbacks
+  // they posted.
+  void FastForwardBy(TimeDelta delta) {
+    file_task_runner_->FastForwardBy(delta);
+    RunLoop().RunUntilIdle();
+  }
+
+  MessageLoop loop_;
+  scoped_refptr<TestMockTimeTaskRunner> file_task_runner_;
+
+ private:
+  ScopedTempDir temp_dir_;
+};
+
+TEST_F(ImportantFileWriteBatcherTest, CommitsAtTheEndOfTheFlushWindow) {
+  scoped_refptr<ImportantFileWriteBatcher> batcher =
+      CreateBatcher(TimeDelta::FromMilliseconds(50));
+  std::vector<bool> results;
+  batcher->AddWrite(GetPath("a"), Producer("foo"),
+                    Bind(&AppendResult, &results));
+  batcher->AddWrite(GetPath("b"), Producer("bar"),
+                    Bind(&AppendResult, &results));
+  FastForwardBy(TimeDelta::FromMilliseconds(49));
+  EXPECT_TRUE(results.empty());
+  EXPECT_FALSE(PathExists(GetPath("a")));
+  EXPECT_FALSE(PathExists(GetPath("b")));
+
+  FastForwardBy(TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(std::vector<bool>({true, true}), results);
+  EXPECT_EQ("foo", GetFileContent(GetPath("a")));
+  EXPECT_EQ("bar", GetFileContent(GetPath("b")));
+}
+
+TEST_F(ImportantFileWriteBatcherTest, CommitPendingWrites) {
+  scoped_refptr<ImportantFileWriteBatcher> batcher =
+      CreateBatcher(TimeDelta::FromHours(1));
+  std::vector<bool> results;
+  batcher->AddWrite(GetPath("a"), Producer("foo"),
+                    Bind(&AppendResult, &results));
+  batcher->AddWrite(GetPath("b"), Bind(&FailToProduce),
+                    Bind(&AppendResult, &results));
+  batcher->CommitPendingWrites();
+  FastForwardBy(TimeDelta());
+  EXPECT_EQ(std::vector<bool>({true, false}), results);
+  EXPECT_EQ("foo", GetFileContent(GetPath("a")));
+  EXPECT_FALSE(PathExists(GetPath("b")));
+}
+
+TEST_F(ImportantFileWriteBatcherTest, CoalescesWritesToTheSameFile) {
+  scoped_refptr<ImportantFileWriteBatcher> batcher =
+      CreateBatcher(TimeDelta::FromHours(1));
+  std::vector<bool> results;
+  batcher->AddWrite(GetPath("a"), Producer("foo"),
+                    Bind(&AppendResult, &results));
+  // The replaced data is never produced.
+  batcher->AddWrite(GetPath("a"), Bind(&FailToProduce),
+                    ImportantFileWriteBatcher::WriteCallback());
+  batcher->AddWrite(GetPath("a"), Producer("bar"),
+                    Bind(&AppendResult, &results));
+  batcher->CommitPendingWrites();
+  FastForwardBy(TimeDelta());
+  EXPECT_EQ(std::vector<bool>({true, true}), results);
+  EXPECT_EQ("bar", GetFileContent(GetPath("a")));
+}
+
+TEST_F(ImportantFileWriteBatcherTest, ScheduledWritesOfWritersAreBatched) {
+  scoped_refptr<ImportantFileWriteBatcher> batcher =
+      CreateBatcher(TimeDelta::FromHours(1));
+  ImportantFileWriter writer_a(GetPath("a"), batcher, TimeDelta());
+  ImportantFileWriter writer_b(GetPath("b"), batcher, TimeDelta());
+  HistogramTester histogram_tester;
+  DataSerializer foo("foo");
+  DataSerializer bar("bar");
+  writer_a.ScheduleWrite(&foo);
+  writer_b.ScheduleWrite(&bar);
+  RunLoop().RunUntilIdle();
+  EXPECT_TRUE(writer_a.HasPendingWrite());
+  EXPECT_TRUE(writer_b.HasPendingWrite());
+
+  // The writes wait for the end of the flush window.
+  FastForwardBy(TimeDelta::FromMinutes(1));
+  EXPECT_FALSE(PathExists(GetPath("a")));
+
+  // Until a writer writes right away, which commits the batch.
+  bool written = false;
+  writer_a.RegisterOnNextSuccessfulWriteCallback(Bind(&SetTrue, &written));
+  writer_a.WriteNow(WrapUnique(new std::string("baz")));
+  FastForwardBy(TimeDelta());
+  EXPECT_TRUE(written);
+  EXPECT_EQ("baz", GetFileContent(GetPath("a")));
+  EXPECT_EQ("bar", GetFileContent(GetPath("b")));
+  EXPECT_FALSE(writer_a.HasPendingWrite());
+  EXPECT_FALSE(writer_b.HasPendingWrite());
+  // None of the data was serialized on the file task runner.
+  histogram_tester.ExpectTotalCount(
+      "ImportantFile.BackgroundSerializationDuration", 0);
+}
+
+TEST_F(ImportantFileWriteBatcherTest, ScheduledWriteIsCommittedAtShutdown) {
+  scoped_refptr<ImportantFileWriteBatcher> batcher =
+      CreateBatcher(TimeDelta::FromHours(1));
+  ImportantFileWriter writer(GetPath("a"), batcher, TimeDelta());
+  DataSerializer foo("foo");
+  writer.ScheduleWrite(&foo);
+  RunLoop().RunUntilIdle();
+  FastForwardBy(TimeDelta::FromMinutes(1));
+
+  // Shut down within the flush window, as a JsonPrefStore does: the delayed
+  // commit of the batch would be skipped.
+  ASSERT_TRUE(writer.HasPendingWrite());
+  writer.DoScheduledWrite();
+  EXPECT_FALSE(writer.HasPendingWrite());
+  file_task_runner_->RunUntilIdle();
+  EXPECT_EQ("foo", GetFileContent(GetPath("a")));
+}
+
+}  // namespace base
@@ -16,6 +16,7 @@
 #include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/files/important_file_write_batcher.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/metrics/histogram.h"
@@ -28,6 +29,10 @@
 #include "base/time/time.h"
 #include "build/build_config.h"
 
+#if defined(OS_LINUX)
+#include <fcntl.h>
+#endif
+
 namespace base {
 
 namespace {
@@ -62,54 +67,90 @@ bool WriteScopedStringToFileAtomically(const FilePath& path,
   return ImportantFileWriter::WriteFileAtomically(path, *data);
 }
 
-}  // namespace
+// A DataProducer which runs |producer|, the serialization of a
+// BackgroundDataSerializer, and records how long it takes.
+bool SerializeInBackground(const ImportantFileWriter::DataProducer& producer,
+                           std::string* data) {
+  const TimeTicks start_time = TimeTicks::Now();
+  const bool produced = producer.Run(data);
+  UMA_HISTOGRAM_TIMES("ImportantFile.BackgroundSerializationDuration",
+                      TimeTicks::Now() - start_time);
+  return produced;
+}
 
-// static
-bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
-                                              StringPiece data) {
-#if defined(OS_CHROMEOS)
-  // On Chrome OS, chrome gets killed when it cannot finish shutdown quickly,
-  // and this function seems to be one of the slowest shutdown steps.
-  // Include some info to the report for investigation. crbug.com/418627
-  // TODO(hashimoto): Remove this.
-  struct {
-    size_t data_size;
-    char path[128];
-  } file_info;
-  file_info.data_size = data.size();
-  strlcpy(file_info.path, path.value().c_str(), arraysize(file_info.path));
-  debug::Alias(&file_info);
-#endif
+// Helper function to call WriteFileAtomically() with the data of |producer|,
+// which is produced on the task runner of the writer.
+bool WriteProducedDataToFileAtomically(
+    const FilePath& path,
+    const ImportantFileWriter::DataProducer& producer) {
+  std::string data;
+  const bool produced = producer.Run(&data);
+  if (!produced || !IsValueInRangeForNumericType<int32_t>(data.length())) {
+    DLOG(WARNING) << "failed to serialize data to be saved in "
+                  << path.value();
+    return false;
+  }
+  return ImportantFileWriter::WriteFileAtomically(path, data);
+}
 
-  // Write the data to a temp file then rename to avoid data loss if we crash
-  // while writing the file. Ensure that the temp file is on the same volume
-  // as target file, so it can be moved in one step, and that the temp file
-  // is securely created.
-  FilePath tmp_file_path;
-  if (!CreateTemporaryFileInDir(path.DirName(), &tmp_file_path)) {
+// A DataProducer which hands out |data|.
+bool ProduceScopedString(std::unique_ptr<std::string> data,
+                         std::string* output) {
+  output->swap(*data);
+  return true;
+}
+
+// Writes |data| to a new temporary file in the directory of |path|, and
+// leaves it open in |tmp_file|. Returns false, after deleting the temporary
+// file, on failure.
+bool WriteTempFile(const FilePath& path,
+                   StringPiece data,
+                   FilePath* tmp_file_path,
+                   File* tmp_file) {
+  // Ensure that the temp file is on the same volume as target file, so it can
+  // be moved in one step, and that the temp file is securely created.
+  if (!CreateTemporaryFileInDir(path.DirName(), tmp_file_path)) {
     LogFailure(path, FAILED_CREATING, "could not create temporary file");
     return false;
   }
 
-  File tmp_file(tmp_file_path, File::FLAG_OPEN | File::FLAG_WRITE);
-  if (!tmp_file.IsValid()) {
+  tmp_file->Initialize(*tmp_file_path, File::FLAG_OPEN | File::FLAG_WRITE);
+  if (!tmp_file->IsValid()) {
     LogFailure(path, FAILED_OPENING, "could not open temporary file");
     return false;
   }
 
   // If this fails in the wild, something really bad is going on.
   const int data_length = checked_cast<int32_t>(data.length());
-  int bytes_written = tmp_file.Write(0, data.data(), data_length);
-  bool flush_success = tmp_file.Flush();
-  tmp_file.Close();
-
+  int bytes_written = tmp_file->Write(0, data.data(), data_length);
   if (bytes_written < data_length) {
+    tmp_file->Close();
     LogFailure(path, FAILED_WRITING, "error writing, bytes_written=" +
                IntToString(bytes_written));
-    DeleteFile(tmp_file_path, false);
+    DeleteFile(*tmp_file_path, false);
     return false;
   }
 
+  return true;
+}
+
+// Starts writing back the data of |tmp_file| without waiting for it, so that
+// the flushes of several files overlap.
+void StartWriteback(File* tmp_file) {
+#if defined(OS_LINUX)
+  // Failures are ignored: Flush() reports them.
+  sync_file_range(tmp_file->GetPlatformFile(), 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+// Flushes and closes |tmp_file|, and renames it to |path|. Returns false,
+// after deleting the temporary file, on failure.
+bool FlushAndReplaceFile(const FilePath& path,
+                         const FilePath& tmp_file_path,
+                         File* tmp_file) {
+  bool flush_success = tmp_file->Flush();
+  tmp_file->Close();
+
   if (!flush_success) {
     LogFailure(path, FAILED_FLUSHING, "error flushing");
     DeleteFile(tmp_file_path, false);
@@ -125,6 +166,65 @@ bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
   return true;
 }
 
+}  // namespace
+
+// static
+bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
+                                              StringPiece data) {
+#if defined(OS_CHROMEOS)
+  // On Chrome OS, chrome gets killed when it cannot finish shutdown quickly,
+  // and this function seems to be one of the slowest shutdown steps.
+  // Include some info to the report for investigation. crbug.com/418627
+  // TODO(hashimoto): Remove this.
+  struct {
+    size_t data_size;
+    char path[128];
+  } file_info;
+  file_info.data_size = data.size();
+  strlcpy(file_info.path, path.value().c_str(), arraysize(file_info.path));
+  debug::Alias(&file_info);
+#endif
+
+  // Write the data to a temp file then rename to avoid data loss if we crash
+  // while writing the file.
+  const TimeTicks start_time = TimeTicks::Now();
+  FilePath tmp_file_path;
+  File tmp_file;
+  if (!WriteTempFile(path, data, &tmp_file_path, &tmp_file) ||
+      !FlushAndReplaceFile(path, tmp_file_path, &tmp_file)) {
+    return false;
+  }
+  UMA_HISTOGRAM_TIMES("ImportantFile.WriteDuration",
+                      TimeTicks::Now() - start_time);
+  return true;
+}
+
+// static
+std::vector<bool> ImportantFileWriter::WriteFilesAtomically(
+    const std::vector<std::pair<FilePath, StringPiece>>& files) {
+  const TimeTicks start_time = TimeTicks::Now();
+  std::vector<bool> saved(files.size(), false);
+  std::vector<FilePath> tmp_file_paths(files.size());
+  std::vector<File> tmp_files(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    saved[i] = WriteTempFile(files[i].first, files[i].second,
+                             &tmp_file_paths[i], &tmp_files[i]);
+    if (saved[i])
+      StartWriteback(&tmp_files[i]);
+  }
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (saved[i]) {
+      saved[i] = FlushAndReplaceFile(files[i].first, tmp_file_paths[i],
+                                     &tmp_files[i]);
+    }
+  }
+  UMA_HISTOGRAM_TIMES("ImportantFile.BatchWriteDuration",
+                      TimeTicks::Now() - start_time);
+  UMA_HISTOGRAM_COUNTS_100("ImportantFile.BatchSize",
+                           static_cast<int>(files.size()));
+  return saved;
+}
+
 ImportantFileWriter::ImportantFileWriter(
     const FilePath& path,
     scoped_refptr<SequencedTaskRunner> task_runner)
@@ -139,13 +239,32 @@ ImportantFileWriter::ImportantFileWriter(
     TimeDelta interval)
     : path_(path),
       task_runner_(std::move(task_runner)),
+      last_batched_write_id_(0),
+      batched_write_pending_(false),
       serializer_(nullptr),
+      background_serializer_(nullptr),
       commit_interval_(interval),
       weak_factory_(this) {
   DCHECK(CalledOnValidThread());
   DCHECK(task_runner_);
 }
 
+ImportantFileWriter::ImportantFileWriter(
+    const FilePath& path,
+    scoped_refptr<ImportantFileWriteBatcher> batcher)
+    : ImportantFileWriter(
+          path,
+          std::move(batcher),
+          TimeDelta::FromMilliseconds(kDefaultCommitIntervalMs)) {}
+
+ImportantFileWriter::ImportantFileWriter(
+    const FilePath& path,
+    scoped_refptr<ImportantFileWriteBatcher> batcher,
+    TimeDelta interval)
+    : ImportantFileWriter(path, batcher->task_runner(), interval) {
+  batcher_ = std::move(batcher);
+}
+
 ImportantFileWriter::~ImportantFileWriter() {
   // We're usually a member variable of some other object, which also tends
   // to be our serializer. It may not be safe to call back to the parent object
@@ -155,19 +274,96 @@ ImportantFileWriter::~ImportantFileWriter() {
 
 bool ImportantFileWriter::HasPendingWrite() const {
   DCHECK(CalledOnValidThread());
-  return timer_.IsRunning();
+  return timer_.IsRunning() || batched_write_pending_;
 }
 
 void ImportantFileWriter::WriteNow(std::unique_ptr<std::string> data) {
+  WriteData(std::move(data), true);
+}
+
+void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
+  DCHECK(CalledOnValidThread());
+
+  DCHECK(serializer);
+  serializer_ = serializer;
+  background_serializer_ = nullptr;
+
+  if (!timer_.IsRunning()) {
+    timer_.Start(FROM_HERE, commit_interval_,
+                 Bind(&ImportantFileWriter::DoScheduledWriteInternal,
+                      Unretained(this), false));
+  }
+}
+
+void ImportantFileWriter::ScheduleWriteWithBackgroundDataSerializer(
+    BackgroundDataSerializer* serializer) {
+  DCHECK(CalledOnValidThread());
+
+  DCHECK(serializer);
+  background_serializer_ = serializer;
+  serializer_ = nullptr;
+
+  if (!timer_.IsRunning()) {
+    timer_.Start(FROM_HERE, commit_interval_,
+                 Bind(&ImportantFileWriter::DoScheduledWriteInternal,
+                      Unretained(this), false));
+  }
+}
+
+void ImportantFileWriter::DoScheduledWrite() {
+  if (serializer_ || background_serializer_) {
+    DoScheduledWriteInternal(true);
+    return;
+  }
+
+  // The data was handed off to the batcher already.
+  DCHECK(batched_write_pending_);
+  batched_write_pending_ = false;
+  batcher_->CommitPendingWrites();
+}
+
+void ImportantFileWriter::DoScheduledWriteInternal(bool commit_now) {
+  DCHECK(serializer_ || background_serializer_);
+  if (background_serializer_) {
+    BackgroundDataSerializer* serializer = background_serializer_;
+    background_serializer_ = nullptr;
+    WriteProducedData(
+        Bind(&SerializeInBackground,
+             serializer->GetSerializedDataProducerForBackgroundSequence()),
+        commit_now);
+    return;
+  }
+
+  std::unique_ptr<std::string> data(new std::string);
+  const TimeTicks start_time = TimeTicks::Now();
+  const bool serialized = serializer_->SerializeData(data.get());
+  UMA_HISTOGRAM_TIMES("ImportantFile.SerializationDuration",
+                      TimeTicks::Now() - start_time);
+  if (serialized) {
+    WriteData(std::move(data), commit_now);
+  } else {
+    DLOG(WARNING) << "failed to serialize data to be saved in "
+                  << path_.value();
+  }
+  serializer_ = nullptr;
+}
+
+void ImportantFileWriter::WriteData(std::unique_ptr<std::string> data,
+                                    bool commit_now) {
   DCHECK(CalledOnValidThread());
   if (!IsValueInRangeForNumericType<int32_t>(data->length())) {
     NOTREACHED();
     return;
   }
 
-  if (HasPendingWrite())
+  if (timer_.IsRunning())
     timer_.Stop();
 
+  if (batcher_) {
+    AddWriteToBatch(Bind(&ProduceScopedString, Passed(&data)), commit_now);
+    return;
+  }
+
   auto task = Bind(&WriteScopedStringToFileAtomically, path_, Passed(&data));
   if (!PostWriteTask(task)) {
     // Posting the task to background message loop is not expected
@@ -179,28 +375,34 @@ void ImportantFileWriter::WriteNow(std::unique_ptr<std::string> data) {
   }
 }
 
-void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
+void ImportantFileWriter::WriteProducedData(const DataProducer& producer,
+                                            bool commit_now) {
   DCHECK(CalledOnValidThread());
+  if (timer_.IsRunning())
+    timer_.Stop();
 
-  DCHECK(serializer);
-  serializer_ = serializer;
+  if (batcher_) {
+    AddWriteToBatch(producer, commit_now);
+    return;
+  }
 
-  if (!timer_.IsRunning()) {
-    timer_.Start(FROM_HERE, commit_interval_, this,
-                 &ImportantFileWriter::DoScheduledWrite);
+  auto task = Bind(&WriteProducedDataToFileAtomically, path_, producer);
+  if (!PostWriteTask(task)) {
+    // See WriteData().
+    NOTREACHED();
+
+    task.Run();
   }
 }
 
-void ImportantFileWriter::DoScheduledWrite() {
-  DCHECK(serializer_);
-  std::unique_ptr<std::string> data(new std::string);
-  if (serializer_->SerializeData(data.get())) {
-    WriteNow(std::move(data));
-  } else {
-    DLOG(WARNING) << "failed to serialize data to be saved in "
-                  << path_.value();
-  }
-  serializer_ = nullptr;
+void ImportantFileWriter::AddWriteToBatch(const DataProducer& producer,
+                                          bool commit_now) {
+  batcher_->AddWrite(path_, producer,
+                     Bind(&ImportantFileWriter::OnBatchedWriteDone,
+                          weak_factory_.GetWeakPtr(), ++last_batched_write_id_));
+  batched_write_pending_ = !commit_now;
+  if (commit_now)
+    batcher_->CommitPendingWrites();
 }
 
 void ImportantFileWriter::RegisterOnNextSuccessfulWriteCallback(
@@ -236,4 +438,12 @@ void ImportantFileWriter::ForwardSuccessfulWrite(bool result) {
   }
 }
 
+void ImportantFileWriter::OnBatchedWriteDone(int batched_write_id,
+                                             bool result) {
+  // A write handed off since then is still pending.
+  if (batched_write_id == last_batched_write_id_)
+    batched_write_pending_ = false;
+  ForwardSuccessfulWrite(result);
+}
+
 }  // namespace base
@@ -6,6 +6,8 @@
 #define BASE_FILES_IMPORTANT_FILE_WRITER_H_
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/callback.h"
@@ -19,6 +21,7 @@
 
 namespace base {
 
+class ImportantFileWriteBatcher;
 class SequencedTaskRunner;
 class Thread;
 
@@ -38,8 +41,14 @@ class Thread;
 //
 // If you want to know more about this approach and ext3/ext4 fsync issues, see
 // http://blog.valerieaurora.org/2009/04/16/dont-panic-fsync-ext34-and-your-data/
+//
+// Writers of several files can share an ImportantFileWriteBatcher, which
+// commits the writes made within a short window together.
 class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
  public:
+  // Puts the serialized data in its argument, and returns true on success.
+  using DataProducer = Callback<bool(std::string* data)>;
+
   // Used by ScheduleSave to lazily provide the data to be saved. Allows us
   // to also batch data serializations.
   class BASE_EXPORT DataSerializer {
@@ -53,10 +62,33 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
     virtual ~DataSerializer() {}
   };
 
+  // Used by ScheduleWriteWithBackgroundDataSerializer to provide the data to
+  // be saved, which is then serialized on the task runner which does the file
+  // I/O rather than on the thread of the ImportantFileWriter.
+  class BASE_EXPORT BackgroundDataSerializer {
+   public:
+    // Will be called on the thread on which ImportantFileWriter has been
+    // created. Should return a producer which owns a snapshot of the data to
+    // be saved, as it is run later on the task runner of the writer.
+    virtual DataProducer GetSerializedDataProducerForBackgroundSequence() = 0;
+
+   protected:
+    virtual ~BackgroundDataSerializer() {}
+  };
+
   // Save |data| to |path| in an atomic manner (see the class comment above).
   // Blocks and writes data on the current thread.
   static bool WriteFileAtomically(const FilePath& path, StringPiece data);
 
+  // Save each of |files|, given as pairs of a path and its data, in an atomic
+  // manner. The temporary files are all written before any of them is
+  // flushed, so that the file system can commit them in fewer journal
+  // transactions, and each is renamed to its target as soon as it is flushed.
+  // Returns whether each file was saved: a failure to save a file leaves the
+  // others unaffected. Blocks and writes data on the current thread.
+  static std::vector<bool> WriteFilesAtomically(
+      const std::vector<std::pair<FilePath, StringPiece>>& files);
+
   // Initialize the writer.
   // |path| is the name of file to write.
   // |task_runner| is the SequencedTaskRunner instance where on which we will
@@ -70,6 +102,17 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
                       scoped_refptr<SequencedTaskRunner> task_runner,
                       TimeDelta interval);
 
+  // Same as the first constructor, but hands the writes off to |batcher|,
+  // which commits them together with the writes of other files on its task
+  // runner.
+  ImportantFileWriter(const FilePath& path,
+                      scoped_refptr<ImportantFileWriteBatcher> batcher);
+
+  // Same as above, but with a custom commit interval.
+  ImportantFileWriter(const FilePath& path,
+                      scoped_refptr<ImportantFileWriteBatcher> batcher,
+                      TimeDelta interval);
+
   // You have to ensure that there are no pending writes at the moment
   // of destruction.
   ~ImportantFileWriter();
@@ -77,11 +120,13 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   const FilePath& path() const { return path_; }
 
   // Returns true if there is a scheduled write pending which has not yet
-  // been started.
+  // been started, including one which a batcher holds until the end of its
+  // flush window.
   bool HasPendingWrite() const;
 
   // Save |data| to target filename. Does not block. If there is a pending write
-  // scheduled by ScheduleWrite(), it is cancelled.
+  // scheduled by ScheduleWrite(), it is cancelled. A batcher commits the write
+  // right away, without waiting for other files.
   void WriteNow(std::unique_ptr<std::string> data);
 
   // Schedule a save to target filename. Data will be serialized and saved
@@ -92,7 +137,15 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   // ImportantFileWriter.
   void ScheduleWrite(DataSerializer* serializer);
 
+  // Same as ScheduleWrite(), but the data is serialized on the task runner
+  // rather than on the current thread. |serializer| should remain valid
+  // through the lifetime of ImportantFileWriter.
+  void ScheduleWriteWithBackgroundDataSerializer(
+      BackgroundDataSerializer* serializer);
+
   // Serialize data pending to be saved and execute write on backend thread.
+  // Like WriteNow(), this does not wait for the flush window of a batcher, and
+  // also commits a write which the batcher holds.
   void DoScheduledWrite();
 
   // Registers |on_next_successful_write| to be called once, on the next
@@ -105,6 +158,16 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   }
 
  private:
+  // Serializes the data of the scheduled write, or gets a producer for it,
+  // and hands it off. Unless |commit_now|, a batcher holds the write until the
+  // end of its flush window.
+  void DoScheduledWriteInternal(bool commit_now);
+
+  // Helpers for DoScheduledWriteInternal() and WriteNow().
+  void WriteData(std::unique_ptr<std::string> data, bool commit_now);
+  void WriteProducedData(const DataProducer& producer, bool commit_now);
+  void AddWriteToBatch(const DataProducer& producer, bool commit_now);
+
   // Helper method for WriteNow().
   bool PostWriteTask(const Callback<bool()>& task);
 
@@ -112,6 +175,10 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   // |on_successful_write_| and then resets it; no-ops otherwise.
   void ForwardSuccessfulWrite(bool result);
 
+  // Called with the result of the write handed off to |batcher_| as
+  // |batched_write_id|.
+  void OnBatchedWriteDone(int batched_write_id, bool result);
+
   // Invoked once and then reset on the next successful write event.
   Closure on_next_successful_write_;
 
@@ -121,11 +188,23 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   // TaskRunner for the thread on which file I/O can be done.
   const scoped_refptr<SequencedTaskRunner> task_runner_;
 
+  // Batcher which commits the writes, if any. Writes are posted to
+  // |task_runner_| otherwise.
+  scoped_refptr<ImportantFileWriteBatcher> batcher_;
+
+  // Identifies the last write handed off to |batcher_|.
+  int last_batched_write_id_;
+
+  // Whether |batcher_| holds a write until the end of its flush window.
+  bool batched_write_pending_;
+
   // Timer used to schedule commit after ScheduleWrite.
   OneShotTimer timer_;
 
-  // Serializer which will provide the data to be saved.
+  // Serializer which will provide the data to be saved. At most one of
+  // |serializer_| and |background_serializer_| is set.
   DataSerializer* serializer_;
+  BackgroundDataSerializer* background_serializer_;
 
   // Time delta after which scheduled data will be written to disk.
   const TimeDelta commit_interval_;
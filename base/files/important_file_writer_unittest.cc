@@ -4,6 +4,9 @@
 
 #include "base/files/important_file_writer.h"
 
+#include <utility>
+#include <vector>
+
 #include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/files/file_path.h"
@@ -15,6 +18,8 @@
 #include "base/memory/ptr_util.h"
 #include "base/run_loop.h"
 #include "base/single_thread_task_runner.h"
+#include "base/strings/string_piece.h"
+#include "base/test/histogram_tester.h"
 #include "base/threading/thread.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/time/time.h"
@@ -46,6 +51,32 @@ class DataSerializer : public ImportantFileWriter::DataSerializer {
   const std::string data_;
 };
 
+// Serializes on |task_runner|, which must be where the file I/O is done.
+class BackgroundDataSerializer
+    : public ImportantFileWriter::BackgroundDataSerializer {
+ public:
+  BackgroundDataSerializer(const std::string& data,
+                           scoped_refptr<SequencedTaskRunner> task_runner)
+      : data_(data), task_runner_(std::move(task_runner)) {}
+
+  ImportantFileWriter::DataProducer
+  GetSerializedDataProducerForBackgroundSequence() override {
+    return Bind(&BackgroundDataSerializer::Produce, data_, task_runner_);
+  }
+
+ private:
+  static bool Produce(const std::string& data,
+                      scoped_refptr<SequencedTaskRunner> task_runner,
+                      std::string* output) {
+    EXPECT_TRUE(task_runner->RunsTasksOnCurrentThread());
+    output->assign(data);
+    return true;
+  }
+
+  const std::string data_;
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+};
+
 class SuccessfulWriteObserver {
  public:
   SuccessfulWriteObserver() : successful_write_observed_(false) {}
@@ -195,4 +226,44 @@ TEST_F(ImportantFileWriterTest, BatchingWrites) {
   EXPECT_EQ("baz", GetFileContent(writer.path()));
 }
 
+TEST_F(ImportantFileWriterTest, ScheduleWriteWithBackgroundDataSerializer) {
+  Thread file_thread("ImportantFileWriterTest file thread");
+  ASSERT_TRUE(file_thread.Start());
+  ImportantFileWriter writer(file_, file_thread.task_runner(),
+                             TimeDelta::FromMilliseconds(25));
+  successful_write_observer_.ObserveNextSuccessfulWrite(&writer);
+  HistogramTester histogram_tester;
+  BackgroundDataSerializer serializer("foo", file_thread.task_runner());
+  writer.ScheduleWriteWithBackgroundDataSerializer(&serializer);
+  EXPECT_TRUE(writer.HasPendingWrite());
+  ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+      FROM_HERE, MessageLoop::QuitWhenIdleClosure(),
+      TimeDelta::FromMilliseconds(100));
+  RunLoop().Run();
+  file_thread.Stop();
+  RunLoop().RunUntilIdle();
+  EXPECT_FALSE(writer.HasPendingWrite());
+  EXPECT_TRUE(successful_write_observer_.GetAndResetObservationState());
+  ASSERT_TRUE(PathExists(writer.path()));
+  EXPECT_EQ("foo", GetFileContent(writer.path()));
+  histogram_tester.ExpectTotalCount(
+      "ImportantFile.BackgroundSerializationDuration", 1);
+}
+
+TEST_F(ImportantFileWriterTest, WriteFilesAtomically) {
+  const FilePath other_file = file_.DirName().AppendASCII("other-file");
+  const FilePath missing_dir_file =
+      file_.DirName().AppendASCII("missing-dir").AppendASCII("file");
+  std::vector<std::pair<FilePath, StringPiece>> files;
+  files.push_back(std::make_pair(file_, StringPiece("foo")));
+  files.push_back(std::make_pair(missing_dir_file, StringPiece("bar")));
+  files.push_back(std::make_pair(other_file, StringPiece("baz")));
+
+  EXPECT_EQ(std::vector<bool>({true, false, true}),
+            ImportantFileWriter::WriteFilesAtomically(files));
+  EXPECT_EQ("foo", GetFileContent(file_));
+  EXPECT_FALSE(PathExists(missing_dir_file));
+  EXPECT_EQ("baz", GetFileContent(other_file));
+}
+
 }  // namespace base
@@ -4,17 +4,30 @@
 
 #include "base/files/memory_mapped_file.h"
 
+#include <algorithm>
+#include <memory>
 #include <utility>
 
+#include "base/bind.h"
 #include "base/files/file_path.h"
+#include "base/location.h"
 #include "base/logging.h"
 #include "base/sys_info.h"
+#include "base/task_scheduler/post_task.h"
+#include "base/task_scheduler/task_traits.h"
+#include "base/threading/thread_restrictions.h"
 #include "build/build_config.h"
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <fcntl.h>
+#endif
+
 namespace base {
 
 const MemoryMappedFile::Region MemoryMappedFile::Region::kWholeFile = {0, 0};
 
+const size_t MemoryMappedFile::kHugePageSize = 2 * 1024 * 1024;
+
 bool MemoryMappedFile::Region::operator==(
     const MemoryMappedFile::Region& other) const {
   return other.offset == offset && other.size == size;
@@ -25,6 +38,9 @@ bool MemoryMappedFile::Region::operator!=(
   return other.offset != offset || other.size != size;
 }
 
+MemoryMappedFile::Hints::Hints()
+    : access_pattern(ACCESS_NORMAL), populate(false), huge_pages(false) {}
+
 MemoryMappedFile::~MemoryMappedFile() {
   CloseHandles();
 }
@@ -53,7 +69,7 @@ bool MemoryMappedFile::Initialize(const FilePath& file_name, Access access) {
     return false;
   }
 
-  if (!MapFileRegionToMemory(Region::kWholeFile, access)) {
+  if (!MapFileRegionToMemory(Region::kWholeFile, access, Hints())) {
     CloseHandles();
     return false;
   }
@@ -69,6 +85,34 @@ bool MemoryMappedFile::Initialize(File file, Access access) {
 bool MemoryMappedFile::Initialize(File file,
                                   const Region& region,
                                   Access access) {
+  return InitializeRegion(std::move(file), region, access, Hints());
+}
+
+bool MemoryMappedFile::Initialize(File file,
+                                  const Region& region,
+                                  const Hints& hints) {
+  return InitializeRegion(std::move(file), region, READ_ONLY, hints);
+}
+
+void MemoryMappedFile::PrefetchAsync() const {
+  DCHECK(IsValid());
+  File file = file_.Duplicate();
+  if (!file.IsValid())
+    return;
+  PostTaskWithTraits(
+      FROM_HERE,
+      TaskTraits()
+          .WithFileIO()
+          .WithPriority(TaskPriority::BACKGROUND)
+          .WithShutdownBehavior(TaskShutdownBehavior::CONTINUE_ON_SHUTDOWN),
+      Bind(&MemoryMappedFile::PrefetchFileRegion, Passed(&file), file_offset_,
+           static_cast<int64_t>(length_)));
+}
+
+bool MemoryMappedFile::InitializeRegion(File file,
+                                        const Region& region,
+                                        Access access,
+                                        const Hints& hints) {
   switch (access) {
     case READ_WRITE_EXTEND:
       // Ensure that the extended size is within limits of File.
@@ -97,11 +141,12 @@ bool MemoryMappedFile::Initialize(File file,
 
   file_ = std::move(file);
 
-  if (!MapFileRegionToMemory(region, access)) {
+  if (!MapFileRegionToMemory(region, access, hints)) {
     CloseHandles();
     return false;
   }
 
+  file_offset_ = region.offset;
   return true;
 }
 
@@ -123,6 +168,31 @@ void MemoryMappedFile::CalculateVMAlignedBoundaries(int64_t start,
   *aligned_start = start & ~mask;
   *aligned_size = (size + *offset + mask) & ~mask;
 }
+
+// static
+void MemoryMappedFile::PrefetchFileRegion(File file,
+                                          int64_t offset,
+                                          int64_t size) {
+  ThreadRestrictions::AssertIOAllowed();
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Reads into the page cache without copying the data.
+  if (!posix_fadvise(file.GetPlatformFile(), offset, size,
+                     POSIX_FADV_WILLNEED)) {
+    return;
+  }
+#endif
+  const int kChunkSize = 1024 * 1024;
+  std::unique_ptr<char[]> buffer(new char[kChunkSize]);
+  const int64_t end = offset + size;
+  while (offset < end) {
+    const int bytes_read = file.Read(
+        offset, buffer.get(),
+        static_cast<int>(std::min<int64_t>(kChunkSize, end - offset)));
+    if (bytes_read <= 0)
+      return;
+    offset += bytes_read;
+  }
+}
 #endif
 
 }  // namespace base
@@ -46,6 +46,19 @@ class BASE_EXPORT MemoryMappedFile {
     READ_WRITE_EXTEND,
   };
 
+  // How the mapped memory is going to be accessed, which tells the OS how
+  // much to read ahead of page faults.
+  enum AccessPattern {
+    // The OS default.
+    ACCESS_NORMAL,
+    // Front to back: read far ahead, and drop the pages once accessed.
+    ACCESS_SEQUENTIAL,
+    // Scattered: read only the pages which are accessed.
+    ACCESS_RANDOM,
+    // Everywhere, soon: start reading the whole region in without waiting.
+    ACCESS_WILL_NEED,
+  };
+
   // The default constructor sets all members to invalid/null values.
   MemoryMappedFile();
   ~MemoryMappedFile();
@@ -64,6 +77,29 @@ class BASE_EXPORT MemoryMappedFile {
     int64_t size;
   };
 
+  // Hints about the use of a read-only mapping. They change how and when the
+  // file is read in, never the contents of the mapping, and the OS may
+  // ignore them. They are all ignored on Windows.
+  struct BASE_EXPORT Hints {
+    Hints();
+
+    AccessPattern access_pattern;
+
+    // Whether to read the whole region in while mapping it, so that accessing
+    // it never waits for the disk. Mapping blocks for as long as it takes.
+    // Only on Linux and Android; ACCESS_WILL_NEED is used elsewhere.
+    bool populate;
+
+    // Whether to place a region of at least kHugePageSize at a huge page
+    // boundary, and ask for it to be backed by huge pages, which saves TLB
+    // misses and page faults on large read-mostly files (e.g. data packs),
+    // where the file system supports it. Only on Linux and Android.
+    bool huge_pages;
+  };
+
+  // The size of a huge page on the platforms which support them.
+  static const size_t kHugePageSize;
+
   // Opens an existing file and maps it into memory. |access| can be read-only
   // or read/write but not read/write+extend. If this object already points
   // to a valid memory mapped file then this method will fail and return
@@ -93,6 +129,16 @@ class BASE_EXPORT MemoryMappedFile {
     return Initialize(std::move(file), region, READ_ONLY);
   }
 
+  // As above, but maps |region| read-only, following |hints|.
+  bool Initialize(File file, const Region& region, const Hints& hints);
+
+  // Starts reading the mapped region into memory on a TaskScheduler worker
+  // and returns without waiting, so that the first accesses to data() are
+  // less likely to wait for the disk (e.g. ahead of a burst of accesses at
+  // startup). A TaskScheduler must be registered for the process (see
+  // base/task_scheduler/post_task.h). Must only be called on a valid mapping.
+  void PrefetchAsync() const;
+
   const uint8_t* data() const { return data_; }
   uint8_t* data() { return data_; }
   size_t length() const { return length_; }
@@ -113,9 +159,22 @@ class BASE_EXPORT MemoryMappedFile {
                                            int64_t* aligned_size,
                                            int32_t* offset);
 
+  // Helper for the Initialize() overloads which take a region.
+  bool InitializeRegion(File file,
+                        const Region& region,
+                        Access access,
+                        const Hints& hints);
+
   // Map the file to memory, set data_ to that memory address. Return true on
   // success, false on any kind of failure. This is a helper for Initialize().
-  bool MapFileRegionToMemory(const Region& region, Access access);
+  // |hints| must be the default Hints unless |access| is READ_ONLY.
+  bool MapFileRegionToMemory(const Region& region,
+                             Access access,
+                             const Hints& hints);
+
+  // Reads [|offset|, |offset| + |size|) of |file| into memory. Runs on a
+  // TaskScheduler worker.
+  static void PrefetchFileRegion(File file, int64_t offset, int64_t size);
 
   // Closes all open handles.
   void CloseHandles();
@@ -124,6 +183,16 @@ class BASE_EXPORT MemoryMappedFile {
   uint8_t* data_;
   size_t length_;
 
+  // The offset of data() in the file.
+  int64_t file_offset_;
+
+#if defined(OS_POSIX)
+  // The whole mapping, which starts before data() if the mapped region is not
+  // aligned.
+  void* mapping_address_;
+  size_t mapping_size_;
+#endif
+
 #if defined(OS_WIN)
   win::ScopedHandle file_mapping_;
 #endif
@@ -0,0 +1,178 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/memory_mapped_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/task_scheduler/scheduler_worker_pool_params.h"
+#include "base/task_scheduler/task_scheduler.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <fcntl.h>
+#endif
+
+namespace base {
+
+namespace {
+
+// About the size of the resource packs and ICU data mapped at startup.
+const size_t kFileSize = 32 * 1024 * 1024;
+const size_t kPageSize = 4096;
+
+enum Mode {
+  DEFAULT,
+  SEQUENTIAL,
+  RANDOM,
+  WILL_NEED,
+  POPULATE,
+  PREFETCH_ASYNC,
+};
+
+const char* const kModeNames[] = {
+    "_default",  "_sequential", "_random",
+    "_will_need", "_populate",  "_prefetch_async",
+};
+
+size_t ReturnZero(const TaskTraits& traits) {
+  return 0;
+}
+
+// Measures the time it takes to access every page of a file mapped right after
+// it was evicted from the page cache, as at a cold start, with each hint. The
+// eviction only works on Linux and Android, and not on tmpfs, where the file
+// stays in memory.
+class MemoryMappedFilePerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("data.pak");
+    std::string data(kFileSize, '\0');
+    for (size_t i = 0; i < kFileSize; i += kPageSize)
+      data[i] = static_cast<char>(i / kPageSize);
+    ASSERT_EQ(static_cast<int>(kFileSize),
+              WriteFile(path_, data.data(), static_cast<int>(kFileSize)));
+
+    if (!TaskScheduler::GetInstance()) {
+      std::vector<SchedulerWorkerPoolParams> params;
+      params.push_back(SchedulerWorkerPoolParams(
+          "MemoryMappedFilePerfTest", ThreadPriority::NORMAL,
+          SchedulerWorkerPoolParams::IORestriction::ALLOWED, 1,
+          TimeDelta::Max()));
+      TaskScheduler::CreateAndSetDefaultTaskScheduler(params,
+                                                      Bind(&ReturnZero));
+    }
+  }
+
+  // Accesses the pages in |order|.
+  void Run(Mode mode, const std::vector<size_t>& order, const char* trace) {
+    EvictFromPageCache();
+
+    const TimeTicks start = TimeTicks::Now();
+    MemoryMappedFile map;
+    MemoryMappedFile::Hints hints;
+    switch (mode) {
+      case DEFAULT:
+      case PREFETCH_ASYNC:
+        break;
+      case SEQUENTIAL:
+        hints.access_pattern = MemoryMappedFile::ACCESS_SEQUENTIAL;
+        break;
+      case RANDOM:
+        hints.access_pattern = MemoryMappedFile::ACCESS_RANDOM;
+        break;
+      case WILL_NEED:
+        hints.access_pattern = MemoryMappedFile::ACCESS_WILL_NEED;
+        break;
+      case POPULATE:
+        hints.populate = true;
+        break;
+    }
+    ASSERT_TRUE(map.Initialize(File(path_, File::FLAG_OPEN | File::FLAG_READ),
+                               MemoryMappedFile::Region::kWholeFile, hints));
+    if (mode == PREFETCH_ASYNC)
+      map.PrefetchAsync();
+    const TimeTicks mapped = TimeTicks::Now();
+
+    uint32_t sum = 0;
+    for (size_t page : order)
+      sum += map.data()[page * kPageSize];
+    const TimeTicks end = TimeTicks::Now();
+    EXPECT_EQ(ExpectedSum(), sum);
+
+    perf_test::PrintResult("map", kModeNames[mode], trace,
+                           (mapped - start).InMillisecondsF(), "ms", true);
+    perf_test::PrintResult("first_access", kModeNames[mode], trace,
+                           (end - mapped).InMillisecondsF(), "ms", true);
+    perf_test::PrintResult("total", kModeNames[mode], trace,
+                           (end - start).InMillisecondsF(), "ms", true);
+  }
+
+  void RunAllModes(const std::vector<size_t>& order, const char* trace) {
+    for (Mode mode : {DEFAULT, SEQUENTIAL, RANDOM, WILL_NEED, POPULATE,
+                      PREFETCH_ASYNC}) {
+      Run(mode, order, trace);
+    }
+  }
+
+  static size_t num_pages() { return kFileSize / kPageSize; }
+
+ private:
+  void EvictFromPageCache() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    File file(path_, File::FLAG_OPEN | File::FLAG_READ);
+    ASSERT_TRUE(file.IsValid());
+    // Only clean pages can be evicted.
+    ASSERT_TRUE(file.Flush());
+    posix_fadvise(file.GetPlatformFile(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  }
+
+  static uint32_t ExpectedSum() {
+    uint32_t sum = 0;
+    for (size_t page = 0; page < num_pages(); ++page)
+      sum += static_cast<uint8_t>(page);
+    return sum;
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+}  // namespace
+
+TEST_F(MemoryMappedFilePerfTest, SequentialAccess) {
+  std::vector<size_t> order;
+  for (size_t page = 0; page < num_pages(); ++page)
+    order.push_back(page);
+  RunAllModes(order, "sequential_access");
+}
+
+TEST_F(MemoryMappedFilePerfTest, RandomAccess) {
+  // Visits every page once, in a scattered order: the stride is odd, so it is
+  // coprime with the number of pages, which is a power of 2.
+  const size_t kStride = (2654435761u % num_pages()) | 1;
+  std::vector<size_t> order;
+  for (size_t i = 0, page = 0; i < num_pages(); ++i) {
+    order.push_back(page);
+    page = (page + kStride) % num_pages();
+  }
+  RunAllModes(order, "random_access");
+}
+
+}  // namespace base
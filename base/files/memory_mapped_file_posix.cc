@@ -16,13 +16,65 @@
 
 namespace base {
 
-MemoryMappedFile::MemoryMappedFile() : data_(NULL), length_(0) {
+namespace {
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+// Maps |size| bytes of |fd| from |offset| like mmap(), but at an address
+// which is at the same offset from a huge page boundary as |offset| is in the
+// file, as huge pages of the page cache can only back such mappings. Returns
+// MAP_FAILED on failure.
+void* MapForHugePages(size_t size, int prot, int flags, int fd, off_t offset) {
+  const uintptr_t kHugePageMask = MemoryMappedFile::kHugePageSize - 1;
+  const size_t page_size = static_cast<size_t>(getpagesize());
+  const size_t mapped_size = (size + page_size - 1) & ~(page_size - 1);
+
+  // Reserves enough address space to find such an address, and then maps the
+  // file over the reservation and releases the rest of it.
+  const size_t reserved_size = mapped_size + MemoryMappedFile::kHugePageSize;
+  void* reservation = mmap(NULL, reserved_size, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reservation == MAP_FAILED)
+    return MAP_FAILED;
+  const uintptr_t reserved_start = reinterpret_cast<uintptr_t>(reservation);
+  const uintptr_t start =
+      reserved_start +
+      ((static_cast<uintptr_t>(offset) - reserved_start) & kHugePageMask);
+  void* address = mmap(reinterpret_cast<void*>(start), size, prot,
+                       flags | MAP_FIXED, fd, offset);
+  if (address == MAP_FAILED) {
+    munmap(reservation, reserved_size);
+    return MAP_FAILED;
+  }
+  if (start > reserved_start)
+    munmap(reservation, start - reserved_start);
+  const uintptr_t end = start + mapped_size;
+  if (end < reserved_start + reserved_size) {
+    munmap(reinterpret_cast<void*>(end),
+           reserved_start + reserved_size - end);
+  }
+
+#if defined(MADV_HUGEPAGE)
+  madvise(address, size, MADV_HUGEPAGE);
+#endif
+  return address;
+}
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+}  // namespace
+
+MemoryMappedFile::MemoryMappedFile()
+    : data_(NULL),
+      length_(0),
+      file_offset_(0),
+      mapping_address_(NULL),
+      mapping_size_(0) {
 }
 
 #if !defined(OS_NACL)
 bool MemoryMappedFile::MapFileRegionToMemory(
     const MemoryMappedFile::Region& region,
-    Access access) {
+    Access access,
+    const Hints& hints) {
   ThreadRestrictions::AssertIOAllowed();
 
   off_t map_start = 0;
@@ -82,14 +134,54 @@ bool MemoryMappedFile::MapFileRegionToMemory(
       flags |= PROT_READ | PROT_WRITE;
       break;
   }
-  data_ = static_cast<uint8_t*>(mmap(NULL, map_size, flags, MAP_SHARED,
-                                     file_.GetPlatformFile(), map_start));
-  if (data_ == MAP_FAILED) {
+
+  int map_flags = MAP_SHARED;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  if (hints.populate)
+    map_flags |= MAP_POPULATE;
+#endif
+
+  void* address = MAP_FAILED;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  if (hints.huge_pages && map_size >= kHugePageSize) {
+    address = MapForHugePages(map_size, flags, map_flags,
+                              file_.GetPlatformFile(), map_start);
+  }
+#endif
+  if (address == MAP_FAILED) {
+    address = mmap(NULL, map_size, flags, map_flags, file_.GetPlatformFile(),
+                   map_start);
+  }
+  if (address == MAP_FAILED) {
     DPLOG(ERROR) << "mmap " << file_.GetPlatformFile();
     return false;
   }
+  mapping_address_ = address;
+  mapping_size_ = map_size;
+
+  int advice = MADV_NORMAL;
+  switch (hints.access_pattern) {
+    case ACCESS_NORMAL:
+      break;
+    case ACCESS_SEQUENTIAL:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case ACCESS_RANDOM:
+      advice = MADV_RANDOM;
+      break;
+    case ACCESS_WILL_NEED:
+      advice = MADV_WILLNEED;
+      break;
+  }
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
+  if (hints.populate)
+    advice = MADV_WILLNEED;
+#endif
+  // The advice is only a hint, so failures are ignored.
+  if (advice != MADV_NORMAL && map_size)
+    madvise(address, map_size, advice);
 
-  data_ += data_offset;
+  data_ = static_cast<uint8_t*>(address) + data_offset;
   return true;
 }
 #endif
@@ -97,12 +189,15 @@ bool MemoryMappedFile::MapFileRegionToMemory(
 void MemoryMappedFile::CloseHandles() {
   ThreadRestrictions::AssertIOAllowed();
 
-  if (data_ != NULL)
-    munmap(data_, length_);
+  if (mapping_address_ != NULL)
+    munmap(mapping_address_, mapping_size_);
   file_.Close();
 
   data_ = NULL;
   length_ = 0;
+  file_offset_ = 0;
+  mapping_address_ = NULL;
+  mapping_size_ = 0;
 }
 
 }  // namespace base
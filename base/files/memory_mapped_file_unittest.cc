@@ -8,9 +8,16 @@
 #include <stdint.h>
 
 #include <utility>
+#include <vector>
 
+#include "base/callback.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/task_scheduler/task_scheduler.h"
+#include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -32,6 +39,40 @@ bool CheckBufferContents(const uint8_t* data, size_t size, size_t offset) {
   return memcmp(test_data.get(), data, size) == 0;
 }
 
+// Holds the tasks posted to it until they are run by RunTasks().
+class TestTaskScheduler : public TaskScheduler {
+ public:
+  TestTaskScheduler() {}
+
+  // TaskScheduler:
+  void PostTaskWithTraits(const tracked_objects::Location& from_here,
+                          const TaskTraits& traits,
+                          const Closure& task) override {
+    tasks_.push_back(task);
+  }
+  scoped_refptr<TaskRunner> CreateTaskRunnerWithTraits(
+      const TaskTraits& traits,
+      ExecutionMode execution_mode) override {
+    ADD_FAILURE();
+    return nullptr;
+  }
+  void Shutdown() override {}
+
+  size_t num_tasks() const { return tasks_.size(); }
+
+  void RunTasks() {
+    std::vector<Closure> tasks;
+    tasks.swap(tasks_);
+    for (const Closure& task : tasks)
+      task.Run();
+  }
+
+ private:
+  std::vector<Closure> tasks_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestTaskScheduler);
+};
+
 class MemoryMappedFileTest : public PlatformTest {
  protected:
   void SetUp() override {
@@ -240,4 +281,94 @@ TEST_F(MemoryMappedFileTest, ExtendableFile) {
 
 }  // namespace
 
+TEST_F(MemoryMappedFileTest, MapWithAccessPatternHints) {
+  const size_t kFileSize = 157 * 1024;
+  const size_t kOffset = 1024 * 5 + 32;
+  const size_t kPartialSize = 64 * 1024 - 32;
+  CreateTemporaryTestFile(kFileSize);
+
+  for (MemoryMappedFile::AccessPattern access_pattern :
+       {MemoryMappedFile::ACCESS_NORMAL, MemoryMappedFile::ACCESS_SEQUENTIAL,
+        MemoryMappedFile::ACCESS_RANDOM, MemoryMappedFile::ACCESS_WILL_NEED}) {
+    MemoryMappedFile map;
+    File file(temp_file_path(), File::FLAG_OPEN | File::FLAG_READ);
+    MemoryMappedFile::Region region = {kOffset, kPartialSize};
+    MemoryMappedFile::Hints hints;
+    hints.access_pattern = access_pattern;
+    ASSERT_TRUE(map.Initialize(std::move(file), region, hints));
+    ASSERT_EQ(kPartialSize, map.length());
+    EXPECT_TRUE(map.IsValid());
+    ASSERT_TRUE(CheckBufferContents(map.data(), kPartialSize, kOffset));
+  }
+}
+
+TEST_F(MemoryMappedFileTest, MapPopulated) {
+  const size_t kFileSize = 157 * 1024;
+  CreateTemporaryTestFile(kFileSize);
+  MemoryMappedFile map;
+
+  File file(temp_file_path(), File::FLAG_OPEN | File::FLAG_READ);
+  MemoryMappedFile::Hints hints;
+  hints.access_pattern = MemoryMappedFile::ACCESS_SEQUENTIAL;
+  hints.populate = true;
+  ASSERT_TRUE(
+      map.Initialize(std::move(file), MemoryMappedFile::Region::kWholeFile,
+                     hints));
+  ASSERT_EQ(kFileSize, map.length());
+  ASSERT_TRUE(CheckBufferContents(map.data(), kFileSize, 0));
+}
+
+TEST_F(MemoryMappedFileTest, MapForHugePages) {
+  const size_t kFileSize = 3 * MemoryMappedFile::kHugePageSize + 4321;
+  const size_t kOffset = 4096 * 3 + 32;
+  const size_t kPartialSize = 2 * MemoryMappedFile::kHugePageSize + 5;
+  CreateTemporaryTestFile(kFileSize);
+
+  // The smaller region is mapped as usual.
+  for (size_t size : {kPartialSize, static_cast<size_t>(1000)}) {
+    MemoryMappedFile map;
+    File file(temp_file_path(), File::FLAG_OPEN | File::FLAG_READ);
+    MemoryMappedFile::Region region = {kOffset, size};
+    MemoryMappedFile::Hints hints;
+    hints.huge_pages = true;
+    ASSERT_TRUE(map.Initialize(std::move(file), region, hints));
+    ASSERT_EQ(size, map.length());
+    ASSERT_TRUE(CheckBufferContents(map.data(), size, kOffset));
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    if (size >= MemoryMappedFile::kHugePageSize) {
+      // The data is at the same offset from a huge page boundary in memory as
+      // in the file.
+      EXPECT_EQ(kOffset % MemoryMappedFile::kHugePageSize,
+                reinterpret_cast<uintptr_t>(map.data()) %
+                    MemoryMappedFile::kHugePageSize);
+    }
+#endif
+  }
+}
+
+TEST_F(MemoryMappedFileTest, PrefetchAsync) {
+  const size_t kFileSize = 157 * 1024;
+  const size_t kOffset = 1024 * 5 + 32;
+  const size_t kPartialSize = 64 * 1024 - 32;
+  CreateTemporaryTestFile(kFileSize);
+
+  TestTaskScheduler* task_scheduler = new TestTaskScheduler;
+  TaskScheduler::SetInstance(WrapUnique(task_scheduler));
+  {
+    MemoryMappedFile map;
+    File file(temp_file_path(), File::FLAG_OPEN | File::FLAG_READ);
+    MemoryMappedFile::Region region = {kOffset, kPartialSize};
+    ASSERT_TRUE(map.Initialize(std::move(file), region));
+    map.PrefetchAsync();
+    EXPECT_EQ(1u, task_scheduler->num_tasks());
+    task_scheduler->RunTasks();
+    ASSERT_TRUE(CheckBufferContents(map.data(), kPartialSize, kOffset));
+
+    // The prefetch does not depend on the mapping.
+    map.PrefetchAsync();
+  }
+  task_scheduler->RunTasks();
+  TaskScheduler::SetInstance(nullptr);
+}
+
 }  // namespace base
@@ -15,12 +15,14 @@
 
 namespace base {
 
-MemoryMappedFile::MemoryMappedFile() : data_(NULL), length_(0) {
+MemoryMappedFile::MemoryMappedFile()
+    : data_(NULL), length_(0), file_offset_(0) {
 }
 
 bool MemoryMappedFile::MapFileRegionToMemory(
     const MemoryMappedFile::Region& region,
-    Access access) {
+    Access access,
+    const Hints& hints) {
   ThreadRestrictions::AssertIOAllowed();
 
   if (!file_.IsValid())
@@ -103,6 +105,7 @@ void MemoryMappedFile::CloseHandles() {
 
   data_ = NULL;
   length_ = 0;
+  file_offset_ = 0;
 }
 
 }  // namespace base
@@ -0,0 +1,30 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_event_reader.h"
+
+#include "base/json/json_parser.h"
+#include "base/logging.h"
+
+namespace base {
+
+JSONEventReader::JSONEventReader(int options)
+    : parser_(new internal::JSONParser(options)) {}
+
+JSONEventReader::~JSONEventReader() {}
+
+bool JSONEventReader::Read(StringPiece json, JSONEventHandler* handler) {
+  DCHECK(handler);
+  return parser_->ParseWithHandler(json, handler);
+}
+
+JSONReader::JsonParseError JSONEventReader::error_code() const {
+  return parser_->error_code();
+}
+
+std::string JSONEventReader::GetErrorMessage() const {
+  return parser_->GetErrorMessage();
+}
+
+}  // namespace base
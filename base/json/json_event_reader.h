@@ -0,0 +1,96 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// JSONEventReader parses JSON with the same grammar and options as JSONReader,
+// but instead of building a Value tree it reports the document to a
+// JSONEventHandler as a sequence of events, in document order. For example,
+//
+//   {"a": [1, true]}
+//
+// produces OnStartDictionary(), OnKey("a"), OnStartList(), OnInteger(1),
+// OnBoolean(true), OnEndList(), OnEndDictionary().
+//
+// This lets code that reads large documents decode them straight into its own
+// data structures. Memory use is bounded by the nesting depth of the input
+// rather than by its size.
+
+#ifndef BASE_JSON_JSON_EVENT_READER_H_
+#define BASE_JSON_JSON_EVENT_READER_H_
+
+#include <memory>
+#include <string>
+
+#include "base/base_export.h"
+#include "base/json/json_reader.h"
+#include "base/macros.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+
+namespace internal {
+class JSONParser;
+}
+
+// Receives the events produced by JSONEventReader. Every method returns
+// whether parsing should continue; returning false stops the parse.
+//
+// StringPiece arguments are only valid for the duration of the call. They
+// may point into the input or into a temporary buffer holding the unescaped
+// string.
+class BASE_EXPORT JSONEventHandler {
+ public:
+  virtual ~JSONEventHandler() {}
+
+  // A dictionary was opened. It is followed by zero or more pairs of OnKey()
+  // and a value, then by OnEndDictionary().
+  virtual bool OnStartDictionary() = 0;
+  virtual bool OnKey(StringPiece key) = 0;
+  virtual bool OnEndDictionary() = 0;
+
+  // A list was opened. It is followed by zero or more values, then by
+  // OnEndList().
+  virtual bool OnStartList() = 0;
+  virtual bool OnEndList() = 0;
+
+  // Scalar values. Numbers are reported as integers when they fit in an int
+  // and have no fraction or exponent, and as doubles otherwise, matching the
+  // FundamentalValue types JSONReader would produce.
+  virtual bool OnString(StringPiece value) = 0;
+  virtual bool OnInteger(int value) = 0;
+  virtual bool OnDouble(double value) = 0;
+  virtual bool OnBoolean(bool value) = 0;
+  virtual bool OnNull() = 0;
+};
+
+class BASE_EXPORT JSONEventReader {
+ public:
+  // |options| is a bitmask of JSONParserOptions. Options that only affect how
+  // Values are built, such as JSON_DETACHABLE_CHILDREN, have no effect.
+  explicit JSONEventReader(int options);
+  ~JSONEventReader();
+
+  // Parses |json| and reports its contents to |handler|. Returns true if
+  // the whole document was read. Returns false if |json| is malformed, in
+  // which case error_code() describes the problem, or if |handler| stopped
+  // the parse, in which case error_code() is JSON_NO_ERROR. Events already
+  // delivered before an error are not retracted.
+  bool Read(StringPiece json, JSONEventHandler* handler);
+
+  // Returns the error code if the last call to Read() failed.
+  // Returns JSON_NO_ERROR otherwise.
+  JSONReader::JsonParseError error_code() const;
+
+  // Converts error_code() to a human-readable string, including line and
+  // column numbers if appropriate.
+  std::string GetErrorMessage() const;
+
+ private:
+  std::unique_ptr<internal::JSONParser> parser_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONEventReader);
+};
+
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_EVENT_READER_H_
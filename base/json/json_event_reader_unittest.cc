@@ -0,0 +1,239 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_event_reader.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/json/json_reader.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Records every event as a short string, and stops the parse after
+// |stop_after| events if it is non-negative.
+class RecordingHandler : public JSONEventHandler {
+ public:
+  explicit RecordingHandler(int stop_after = -1) : stop_after_(stop_after) {}
+
+  const std::vector<std::string>& events() const { return events_; }
+
+  // JSONEventHandler:
+  bool OnStartDictionary() override { return Record("{"); }
+  bool OnKey(StringPiece key) override {
+    return Record("key:" + key.as_string());
+  }
+  bool OnEndDictionary() override { return Record("}"); }
+  bool OnStartList() override { return Record("["); }
+  bool OnEndList() override { return Record("]"); }
+  bool OnString(StringPiece value) override {
+    return Record("string:" + value.as_string());
+  }
+  bool OnInteger(int value) override {
+    return Record("int:" + IntToString(value));
+  }
+  bool OnDouble(double value) override {
+    return Record("double:" + DoubleToString(value));
+  }
+  bool OnBoolean(bool value) override {
+    return Record(value ? "true" : "false");
+  }
+  bool OnNull() override { return Record("null"); }
+
+ private:
+  bool Record(const std::string& event) {
+    events_.push_back(event);
+    return stop_after_ < 0 ||
+           events_.size() < static_cast<size_t>(stop_after_);
+  }
+
+  const int stop_after_;
+  std::vector<std::string> events_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingHandler);
+};
+
+// Rebuilds a Value tree from the events, to check the event stream against
+// JSONReader.
+class ValueBuildingHandler : public JSONEventHandler {
+ public:
+  ValueBuildingHandler() {}
+
+  std::unique_ptr<Value> TakeRoot() { return std::move(root_); }
+
+  // JSONEventHandler:
+  bool OnStartDictionary() override {
+    return Open(MakeUnique<DictionaryValue>());
+  }
+  bool OnKey(StringPiece key) override {
+    key_ = key.as_string();
+    return true;
+  }
+  bool OnEndDictionary() override { return Close(); }
+  bool OnStartList() override { return Open(MakeUnique<ListValue>()); }
+  bool OnEndList() override { return Close(); }
+  bool OnString(StringPiece value) override {
+    return Add(MakeUnique<StringValue>(value.as_string()));
+  }
+  bool OnInteger(int value) override {
+    return Add(MakeUnique<FundamentalValue>(value));
+  }
+  bool OnDouble(double value) override {
+    return Add(MakeUnique<FundamentalValue>(value));
+  }
+  bool OnBoolean(bool value) override {
+    return Add(MakeUnique<FundamentalValue>(value));
+  }
+  bool OnNull() override { return Add(Value::CreateNullValue()); }
+
+ private:
+  // Attaches |value| to the innermost open container, or makes it the root.
+  Value* Attach(std::unique_ptr<Value> value) {
+    Value* raw = value.get();
+    if (open_.empty()) {
+      root_ = std::move(value);
+    } else if (open_.back()->IsType(Value::TYPE_DICTIONARY)) {
+      static_cast<DictionaryValue*>(open_.back())
+          ->SetWithoutPathExpansion(key_, std::move(value));
+    } else {
+      static_cast<ListValue*>(open_.back())->Append(std::move(value));
+    }
+    return raw;
+  }
+
+  bool Add(std::unique_ptr<Value> value) {
+    Attach(std::move(value));
+    return true;
+  }
+
+  bool Open(std::unique_ptr<Value> container) {
+    open_.push_back(Attach(std::move(container)));
+    return true;
+  }
+
+  bool Close() {
+    open_.pop_back();
+    return true;
+  }
+
+  std::unique_ptr<Value> root_;
+  std::vector<Value*> open_;
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuildingHandler);
+};
+
+}  // namespace
+
+TEST(JSONEventReaderTest, Events) {
+  JSONEventReader reader(JSON_PARSE_RFC);
+  RecordingHandler handler;
+  ASSERT_TRUE(reader.Read(
+      "{\"a\": [1, -2.5, true, false, null], \"b\": {\"c\": \"d\"}, \"e\": []}",
+      &handler));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+
+  const char* const kExpected[] = {
+      "{",     "key:a", "[",     "int:1", "double:-2.5", "true",     "false",
+      "null",  "]",     "key:b", "{",     "key:c",       "string:d", "}",
+      "key:e", "[",     "]",     "}",
+  };
+  ASSERT_EQ(arraysize(kExpected), handler.events().size());
+  for (size_t i = 0; i < arraysize(kExpected); ++i)
+    EXPECT_EQ(kExpected[i], handler.events()[i]);
+}
+
+TEST(JSONEventReaderTest, Scalars) {
+  JSONEventReader reader(JSON_PARSE_RFC);
+  {
+    RecordingHandler handler;
+    ASSERT_TRUE(reader.Read("  42  ", &handler));
+    ASSERT_EQ(1U, handler.events().size());
+    EXPECT_EQ("int:42", handler.events()[0]);
+  }
+  {
+    // Escapes are decoded before the string is reported.
+    RecordingHandler handler;
+    ASSERT_TRUE(reader.Read("\"a\\\"b\\u00e9\"", &handler));
+    ASSERT_EQ(1U, handler.events().size());
+    EXPECT_EQ("string:a\"b\xC3\xA9", handler.events()[0]);
+  }
+  {
+    // A leading byte-order mark is skipped.
+    RecordingHandler handler;
+    ASSERT_TRUE(reader.Read("\xEF\xBB\xBFnull", &handler));
+    ASSERT_EQ(1U, handler.events().size());
+    EXPECT_EQ("null", handler.events()[0]);
+  }
+}
+
+TEST(JSONEventReaderTest, MatchesJSONReader) {
+  const char kJson[] =
+      "{\"list\": [1, 2.5, \"three\", {\"four\": [4]}, [], {}],"
+      " \"escaped\\tkey\": \"\\ud83d\\ude00\", \"dup\": 1, \"dup\": 2,"
+      " \"big\": 3000000000, \"nested\": {\"a\": {\"b\": {\"c\": null}}}}";
+
+  JSONEventReader reader(JSON_PARSE_RFC);
+  ValueBuildingHandler handler;
+  ASSERT_TRUE(reader.Read(kJson, &handler));
+  std::unique_ptr<Value> from_events = handler.TakeRoot();
+  std::unique_ptr<Value> from_reader = JSONReader::Read(kJson);
+  ASSERT_TRUE(from_events);
+  ASSERT_TRUE(from_reader);
+  EXPECT_TRUE(from_events->Equals(from_reader.get()));
+}
+
+TEST(JSONEventReaderTest, HandlerStops) {
+  JSONEventReader reader(JSON_PARSE_RFC);
+  RecordingHandler handler(3);
+  EXPECT_FALSE(reader.Read("[1, 2, 3, 4]", &handler));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+  ASSERT_EQ(3U, handler.events().size());
+  EXPECT_EQ("int:2", handler.events()[2]);
+}
+
+TEST(JSONEventReaderTest, Errors) {
+  const struct {
+    const char* json;
+    int options;
+    JSONReader::JsonParseError error;
+  } kCases[] = {
+      {"[1, 2,]", JSON_PARSE_RFC, JSONReader::JSON_TRAILING_COMMA},
+      {"{foo: 1}", JSON_PARSE_RFC, JSONReader::JSON_UNQUOTED_DICTIONARY_KEY},
+      {"{\"a\" 1}", JSON_PARSE_RFC, JSONReader::JSON_SYNTAX_ERROR},
+      {"[1] [2]", JSON_PARSE_RFC, JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT},
+      {"\"\\q\"", JSON_PARSE_RFC, JSONReader::JSON_INVALID_ESCAPE},
+      {"[tru]", JSON_PARSE_RFC, JSONReader::JSON_SYNTAX_ERROR},
+  };
+
+  for (const auto& test_case : kCases) {
+    JSONEventReader reader(test_case.options);
+    RecordingHandler handler;
+    EXPECT_FALSE(reader.Read(test_case.json, &handler)) << test_case.json;
+    EXPECT_EQ(test_case.error, reader.error_code()) << test_case.json;
+    EXPECT_NE("", reader.GetErrorMessage());
+  }
+
+  // Trailing commas are accepted when the option allows them.
+  JSONEventReader reader(JSON_ALLOW_TRAILING_COMMAS);
+  RecordingHandler handler;
+  EXPECT_TRUE(reader.Read("[1, 2,]", &handler));
+
+  // Nesting is limited as for JSONReader.
+  std::string deep(200, '[');
+  deep.append(200, ']');
+  RecordingHandler deep_handler;
+  EXPECT_FALSE(reader.Read(deep, &deep_handler));
+  EXPECT_EQ(JSONReader::JSON_TOO_MUCH_NESTING, reader.error_code());
+}
+
+}  // namespace base
@@ -7,6 +7,9 @@
 #include <cmath>
 #include <utility>
 
+#include "base/cpu.h"
+#include "base/json/json_event_reader.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/memory/ptr_util.h"
@@ -18,6 +21,11 @@
 #include "base/strings/utf_string_conversions.h"
 #include "base/third_party/icu/icu_utf.h"
 #include "base/values.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#endif
 
 namespace base {
 namespace internal {
@@ -167,6 +175,71 @@ class JSONStringValue : public Value {
   DISALLOW_COPY_AND_ASSIGN(JSONStringValue);
 };
 
+// Returns whether |c| can be copied verbatim from the input into a string
+// value, i.e. whether it is an ASCII character other than a quote or the
+// start of an escape sequence. Multi-byte UTF-8 sequences need validation.
+inline bool IsPlainStringChar(char c) {
+  return static_cast<unsigned char>(c) < kExtendedASCIIStart && c != '"' &&
+         c != '\\';
+}
+
+// Returns the number of bytes at the start of [begin, end) for which
+// IsPlainStringChar() holds.
+size_t CountPlainStringCharsScalar(const char* begin, const char* end) {
+  const char* pos = begin;
+  while (pos < end && IsPlainStringChar(*pos))
+    ++pos;
+  return pos - begin;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY)
+// Same as above, but examines 16 bytes per iteration.
+size_t CountPlainStringCharsSSE2(const char* begin, const char* end) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const char* pos = begin;
+  while (end - pos >= 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+    // Matching bytes become 0xFF. Non-ASCII bytes already have their top bit
+    // set, so OR-ing in |chunk| flags them as well.
+    const __m128i special =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                  _mm_cmpeq_epi8(chunk, backslash)),
+                     chunk);
+    if (_mm_movemask_epi8(special))
+      break;
+    pos += 16;
+  }
+  // Finish the tail, or locate the special byte within the last chunk.
+  return (pos - begin) + CountPlainStringCharsScalar(pos, end);
+}
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
+// Picks the fastest string scanner supported by the current CPU once per
+// process.
+class PlainStringCharsCounter {
+ public:
+  using CountFunction = size_t (*)(const char* begin, const char* end);
+
+  PlainStringCharsCounter() : count_(&CountPlainStringCharsScalar) {
+#if defined(ARCH_CPU_X86_FAMILY)
+    if (CPU().has_sse2())
+      count_ = &CountPlainStringCharsSSE2;
+#endif
+  }
+
+  CountFunction count() const { return count_; }
+
+ private:
+  CountFunction count_;
+
+  DISALLOW_COPY_AND_ASSIGN(PlainStringCharsCounter);
+};
+
+LazyInstance<PlainStringCharsCounter>::Leaky g_plain_string_chars_counter =
+    LAZY_INSTANCE_INITIALIZER;
+
 // Simple class that checks for maximum recursion/"stack overflow."
 class StackMarker {
  public:
@@ -214,28 +287,9 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
   // be used anywhere.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     input_copy = MakeUnique<std::string>(input.as_string());
-    start_pos_ = input_copy->data();
+    ResetState(input_copy->data(), input_copy->length());
   } else {
-    start_pos_ = input.data();
-  }
-  pos_ = start_pos_;
-  end_pos_ = start_pos_ + input.length();
-  index_ = 0;
-  line_number_ = 1;
-  index_last_line_ = 0;
-
-  error_code_ = JSONReader::JSON_NO_ERROR;
-  error_line_ = 0;
-  error_column_ = 0;
-
-  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
-  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // ParseNextToken function mis-treating a Unicode BOM as an invalid
-  // character and returning NULL.
-  if (CanConsume(3) && static_cast<uint8_t>(*pos_) == 0xEF &&
-      static_cast<uint8_t>(*(pos_ + 1)) == 0xBB &&
-      static_cast<uint8_t>(*(pos_ + 2)) == 0xBF) {
-    NextNChars(3);
+    ResetState(input.data(), input.length());
   }
 
   // Parse the first and any nested tokens.
@@ -244,12 +298,8 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
     return nullptr;
 
   // Make sure the input stream is at an end.
-  if (GetNextToken() != T_END_OF_INPUT) {
-    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
-      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
-      return nullptr;
-    }
-  }
+  if (!ConsumeEndOfInput())
+    return nullptr;
 
   // Dictionaries and lists can contain JSONStringValues, so wrap them in a
   // hidden root.
@@ -274,6 +324,19 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
   return root;
 }
 
+bool JSONParser::ParseWithHandler(StringPiece input,
+                                  JSONEventHandler* handler) {
+  DCHECK(handler);
+  // Strings are only handed to |handler| for the duration of a call, so they
+  // can point straight into |input|.
+  ResetState(input.data(), input.length());
+
+  if (!ParseTokenWithHandler(GetNextToken(), handler))
+    return false;
+
+  return ConsumeEndOfInput();
+}
+
 JSONReader::JsonParseError JSONParser::error_code() const {
   return error_code_;
 }
@@ -326,6 +389,16 @@ void JSONParser::StringBuilder::AppendString(const std::string& str) {
   string_->append(str);
 }
 
+void JSONParser::StringBuilder::AppendPlainChars(const char* str,
+                                                 size_t length) {
+  if (string_) {
+    string_->append(str, length);
+  } else {
+    DCHECK_EQ(pos_ + length_, str);
+    length_ += length;
+  }
+}
+
 void JSONParser::StringBuilder::Convert() {
   if (string_)
     return;
@@ -350,6 +423,39 @@ const std::string& JSONParser::StringBuilder::AsString() {
 
 // JSONParser private //////////////////////////////////////////////////////////
 
+void JSONParser::ResetState(const char* start, size_t length) {
+  start_pos_ = start;
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + length;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+
+  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
+  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
+  // ParseNextToken function mis-treating a Unicode BOM as an invalid
+  // character and returning NULL.
+  if (CanConsume(3) && static_cast<uint8_t>(*pos_) == 0xEF &&
+      static_cast<uint8_t>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8_t>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+}
+
+bool JSONParser::ConsumeEndOfInput() {
+  if (GetNextToken() != T_END_OF_INPUT) {
+    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
 inline bool JSONParser::CanConsume(int length) {
   return pos_ + length <= end_pos_;
 }
@@ -503,7 +609,13 @@ Value* JSONParser::ConsumeDictionary() {
     return nullptr;
   }
 
-  std::unique_ptr<DictionaryValue> dict(new DictionaryValue);
+  // With JSON_FLAT_DICTIONARIES the entries are collected here and adopted
+  // by a flat dictionary in one step once the object is complete.
+  const bool flat = (options_ & JSON_FLAT_DICTIONARIES) != 0;
+  std::unique_ptr<DictionaryValue> dict;
+  DictionaryValue::FlatStorage flat_entries;
+  if (!flat)
+    dict.reset(new DictionaryValue);
 
   NextChar();
   Token token = GetNextToken();
@@ -535,7 +647,10 @@ Value* JSONParser::ConsumeDictionary() {
       return nullptr;
     }
 
-    dict->SetWithoutPathExpansion(key.AsString(), value);
+    if (flat)
+      flat_entries.emplace_back(key.AsString(), WrapUnique(value));
+    else
+      dict->SetWithoutPathExpansion(key.AsString(), value);
 
     NextChar();
     token = GetNextToken();
@@ -552,6 +667,8 @@ Value* JSONParser::ConsumeDictionary() {
     }
   }
 
+  if (flat)
+    dict = DictionaryValue::CreateFlat(std::move(flat_entries));
   return dict.release();
 }
 
@@ -613,6 +730,140 @@ Value* JSONParser::ConsumeString() {
   return new StringValue(string.AsString());
 }
 
+bool JSONParser::ParseTokenWithHandler(Token token,
+                                       JSONEventHandler* handler) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return ConsumeDictionaryWithHandler(handler);
+    case T_ARRAY_BEGIN:
+      return ConsumeListWithHandler(handler);
+    case T_STRING: {
+      StringBuilder string;
+      if (!ConsumeStringRaw(&string))
+        return false;
+      return string.CanBeStringPiece()
+                 ? handler->OnString(string.AsStringPiece())
+                 : handler->OnString(string.AsString());
+    }
+    case T_NUMBER: {
+      int int_value;
+      double double_value;
+      switch (ConsumeNumberRaw(&int_value, &double_value)) {
+        case NUMBER_INTEGER:
+          return handler->OnInteger(int_value);
+        case NUMBER_DOUBLE:
+          return handler->OnDouble(double_value);
+        case NUMBER_INVALID:
+          break;
+      }
+      return false;
+    }
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL:
+      if (!ConsumeLiteralRaw())
+        return false;
+      return token == T_NULL ? handler->OnNull()
+                             : handler->OnBoolean(token == T_BOOL_TRUE);
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::ConsumeDictionaryWithHandler(JSONEventHandler* handler) {
+  DCHECK_EQ('{', *pos_);
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!handler->OnStartDictionary())
+    return false;
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+
+    StringBuilder key;
+    if (!ConsumeStringRaw(&key))
+      return false;
+    if (!(key.CanBeStringPiece() ? handler->OnKey(key.AsStringPiece())
+                                 : handler->OnKey(key.AsString()))) {
+      return false;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    NextChar();
+    if (!ParseTokenWithHandler(GetNextToken(), handler))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+
+  return handler->OnEndDictionary();
+}
+
+bool JSONParser::ConsumeListWithHandler(JSONEventHandler* handler) {
+  DCHECK_EQ('[', *pos_);
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!handler->OnStartList())
+    return false;
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!ParseTokenWithHandler(token, handler))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+
+  return handler->OnEndList();
+}
+
 bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
   if (*pos_ != '"') {
     ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
@@ -626,8 +877,24 @@ bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
 
   int length = end_pos_ - start_pos_;
   int32_t next_char = 0;
+  const PlainStringCharsCounter::CountFunction count_plain_chars =
+      g_plain_string_chars_counter.Get().count();
 
   while (CanConsume(1)) {
+    // Most string content needs neither unescaping nor UTF-8 decoding, so
+    // consume runs of such characters in bulk.
+    const char* run_start = start_pos_ + index_;
+    if (run_start < end_pos_) {
+      size_t run_length = count_plain_chars(run_start, end_pos_);
+      if (run_length) {
+        string.AppendPlainChars(run_start, run_length);
+        index_ += static_cast<int>(run_length);
+        // Leave |pos_| on the last consumed character, as CBU8_NEXT does.
+        pos_ = start_pos_ + index_ - 1;
+        continue;
+      }
+    }
+
     pos_ = start_pos_ + index_;  // CBU8_NEXT is postcrement.
     CBU8_NEXT(start_pos_, index_, length, next_char);
     if (next_char < 0 || !IsValidCharacter(next_char)) {
@@ -828,6 +1095,21 @@ void JSONParser::DecodeUTF8(const int32_t& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  int int_value;
+  double double_value;
+  switch (ConsumeNumberRaw(&int_value, &double_value)) {
+    case NUMBER_INTEGER:
+      return new FundamentalValue(int_value);
+    case NUMBER_DOUBLE:
+      return new FundamentalValue(double_value);
+    case NUMBER_INVALID:
+      break;
+  }
+  return nullptr;
+}
+
+JSONParser::NumberType JSONParser::ConsumeNumberRaw(int* int_value,
+                                                    double* double_value) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -837,7 +1119,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return nullptr;
+    return NUMBER_INVALID;
   }
   end_index = index_;
 
@@ -845,12 +1127,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return NUMBER_INVALID;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return NUMBER_INVALID;
     }
     end_index = index_;
   }
@@ -862,7 +1144,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return NUMBER_INVALID;
     }
     end_index = index_;
   }
@@ -882,7 +1164,7 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return NUMBER_INVALID;
   }
 
   pos_ = exit_pos;
@@ -890,17 +1172,15 @@ Value* JSONParser::ConsumeNumber() {
 
   StringPiece num_string(num_start, end_index - start_index);
 
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
+  if (StringToInt(num_string, int_value))
+    return NUMBER_INTEGER;
 
-  double num_double;
-  if (StringToDouble(num_string.as_string(), &num_double) &&
-      std::isfinite(num_double)) {
-    return new FundamentalValue(num_double);
+  if (StringToDouble(num_string.as_string(), double_value) &&
+      std::isfinite(*double_value)) {
+    return NUMBER_DOUBLE;
   }
 
-  return nullptr;
+  return NUMBER_INVALID;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -923,6 +1203,21 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 }
 
 Value* JSONParser::ConsumeLiteral() {
+  const char first_char = *pos_;
+  if (!ConsumeLiteralRaw())
+    return nullptr;
+
+  switch (first_char) {
+    case 't':
+      return new FundamentalValue(true);
+    case 'f':
+      return new FundamentalValue(false);
+    default:
+      return Value::CreateNullValue().release();
+  }
+}
+
+bool JSONParser::ConsumeLiteralRaw() {
   switch (*pos_) {
     case 't': {
       const char kTrueLiteral[] = "true";
@@ -930,10 +1225,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kTrueLen - 1) ||
           !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kTrueLen - 1);
-      return new FundamentalValue(true);
+      return true;
     }
     case 'f': {
       const char kFalseLiteral[] = "false";
@@ -941,10 +1236,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kFalseLen - 1) ||
           !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kFalseLen - 1);
-      return new FundamentalValue(false);
+      return true;
     }
     case 'n': {
       const char kNullLiteral[] = "null";
@@ -952,14 +1247,14 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kNullLen - 1) ||
           !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kNullLen - 1);
-      return Value::CreateNullValue().release();
+      return true;
     }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
-      return nullptr;
+      return false;
   }
 }
 
@@ -20,6 +20,7 @@
 
 namespace base {
 
+class JSONEventHandler;
 class Value;
 
 namespace internal {
@@ -55,6 +56,14 @@ class BASE_EXPORT JSONParser {
   // convert to a FooValue at the same time.
   std::unique_ptr<Value> Parse(StringPiece input);
 
+  // Parses the input string like Parse(), but reports each element to
+  // |handler| as it is encountered instead of building a Value tree. Memory
+  // use is bounded by the nesting depth rather than the size of the input.
+  // Returns true if the whole input was consumed. Returns false if the input
+  // is invalid, with the error information set, or if |handler| stopped the
+  // parse, in which case error_code() is JSON_NO_ERROR.
+  bool ParseWithHandler(StringPiece input, JSONEventHandler* handler);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
@@ -113,6 +122,11 @@ class BASE_EXPORT JSONParser {
     // Appends a string to the std::string. Must be Convert()ed to use.
     void AppendString(const std::string& str);
 
+    // Appends |length| ASCII characters starting at |str|. Unless the builder
+    // has been converted, |str| must directly follow the characters already
+    // in the builder, in which case only |length_| grows.
+    void AppendPlainChars(const char* str, size_t length);
+
     // Converts the builder from its default StringPiece to a full std::string,
     // performing a copy. Once a builder is converted, it cannot be made a
     // StringPiece again.
@@ -140,6 +154,21 @@ class BASE_EXPORT JSONParser {
     std::string* string_;
   };
 
+  // The kind of number produced by ConsumeNumberRaw().
+  enum NumberType {
+    NUMBER_INVALID,
+    NUMBER_INTEGER,
+    NUMBER_DOUBLE,
+  };
+
+  // Points the parser at the beginning of |length| bytes at |start|, skipping
+  // a UTF-8 byte-order mark, and clears the error information.
+  void ResetState(const char* start, size_t length);
+
+  // Called once the root value has been consumed. Returns true if only
+  // whitespace and comments remain; otherwise reports an error.
+  bool ConsumeEndOfInput();
+
   // Quick check that the stream has capacity to consume |length| more bytes.
   bool CanConsume(int length);
 
@@ -180,6 +209,14 @@ class BASE_EXPORT JSONParser {
   // Calls through ConsumeStringRaw and wraps it in a value.
   Value* ConsumeString();
 
+  // Counterparts of ParseToken(), ConsumeDictionary() and ConsumeList() used
+  // by ParseWithHandler(). They follow the same invariants, but report what
+  // they consume to |handler|. Return false on error or if |handler| stopped
+  // the parse.
+  bool ParseTokenWithHandler(Token token, JSONEventHandler* handler);
+  bool ConsumeDictionaryWithHandler(JSONEventHandler* handler);
+  bool ConsumeListWithHandler(JSONEventHandler* handler);
+
   // Assuming that the parser is wound to a double quote, this parses a string,
   // decoding any escape sequences and converts UTF-16 to UTF-8. Returns true on
   // success and Swap()s the result into |out|. Returns false on failure with
@@ -199,6 +236,9 @@ class BASE_EXPORT JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+  // Same as ConsumeNumber(), but stores the result in |int_value| or
+  // |double_value| according to the returned type.
+  NumberType ConsumeNumberRaw(int* int_value, double* double_value);
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -206,6 +246,9 @@ class BASE_EXPORT JSONParser {
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Same as ConsumeLiteral(), but only validates and skips the literal.
+  // Returns false with error information set if it is malformed.
+  bool ConsumeLiteralRaw();
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
@@ -255,6 +298,7 @@ class BASE_EXPORT JSONParser {
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeDictionary);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeList);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeString);
+  FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeLongStrings);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeLiterals);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeNumbers);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ErrorMessages);
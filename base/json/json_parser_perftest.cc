@@ -0,0 +1,167 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Each document is parsed until at least this much input has been consumed,
+// so that small documents are not dominated by timer resolution.
+const size_t kMinBytesParsed = 64 * 1024 * 1024;
+
+// Returns a pseudo-random lower-case hex string of |length| characters.
+std::string MakeHexString(size_t seed, size_t length) {
+  std::string result;
+  result.reserve(length);
+  uint32_t state = static_cast<uint32_t>(seed) * 2654435761u + 1;
+  for (size_t i = 0; i < length; ++i) {
+    state = state * 1103515245u + 12345u;
+    result.push_back("0123456789abcdef"[(state >> 16) & 0xf]);
+  }
+  return result;
+}
+
+// Shaped like a large Preferences file: nested dictionaries keyed by
+// extension ids and origins, short keys, mixed scalars, a few escapes.
+std::string MakePreferencesJSON() {
+  DictionaryValue root;
+  for (int i = 0; i < 400; ++i) {
+    std::unique_ptr<DictionaryValue> extension(new DictionaryValue);
+    extension->SetString("manifest.name",
+                         StringPrintf("Extension \"%d\" \xC3\xA9t\xC3\xA9", i));
+    extension->SetString("manifest.version", StringPrintf("1.%d.0", i));
+    extension->SetString("path", MakeHexString(i, 32) + "/1.0_0");
+    extension->SetInteger("location", i % 10);
+    extension->SetBoolean("was_installed_by_default", i % 3 == 0);
+    extension->SetDouble("install_time", 13100000000000000.0 + i);
+    std::unique_ptr<ListValue> permissions(new ListValue);
+    for (int j = 0; j < 8; ++j)
+      permissions->AppendString(StringPrintf("permission_%d", j));
+    extension->Set("active_permissions.api", std::move(permissions));
+    root.SetWithoutPathExpansion("extensions.settings." + MakeHexString(i, 32),
+                                 std::move(extension));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    root.SetInteger(StringPrintf("profile.content_settings.exceptions."
+                                 "site_engagement.https://www.site%d.com:443",
+                                 i),
+                    i);
+  }
+
+  std::string json;
+  CHECK(JSONWriter::WriteWithOptions(root, JSONWriter::OPTIONS_PRETTY_PRINT,
+                                     &json));
+  return json;
+}
+
+// Shaped like a policy file: long lists of URL patterns and extension ids.
+std::string MakePolicyJSON() {
+  DictionaryValue root;
+  std::unique_ptr<ListValue> url_blacklist(new ListValue);
+  std::unique_ptr<ListValue> url_whitelist(new ListValue);
+  std::unique_ptr<ListValue> extension_whitelist(new ListValue);
+  for (int i = 0; i < 20000; ++i) {
+    url_blacklist->AppendString(
+        StringPrintf("https://blocked%d.example.com/path/to/resource/*", i));
+    url_whitelist->AppendString(
+        StringPrintf("*://allowed%d.example.org:8080/*", i));
+    if (i % 4 == 0)
+      extension_whitelist->AppendString(MakeHexString(i, 32));
+  }
+  root.Set("URLBlacklist", std::move(url_blacklist));
+  root.Set("URLWhitelist", std::move(url_whitelist));
+  root.Set("ExtensionInstallWhitelist", std::move(extension_whitelist));
+  root.SetString("HomepageLocation", "https://intranet.example.com/");
+  root.SetBoolean("DefaultBrowserSettingEnabled", false);
+
+  std::string json;
+  CHECK(JSONWriter::WriteWithOptions(root, JSONWriter::OPTIONS_PRETTY_PRINT,
+                                     &json));
+  return json;
+}
+
+// Shaped like Safe Browsing metadata: a compact array of records carrying
+// long hashes, which is dominated by string scanning.
+std::string MakeSafeBrowsingMetadataJSON() {
+  ListValue root;
+  for (int i = 0; i < 20000; ++i) {
+    std::unique_ptr<DictionaryValue> entry(new DictionaryValue);
+    entry->SetString("hash", MakeHexString(i, 64));
+    entry->SetString("threat_type", "SOCIAL_ENGINEERING");
+    entry->SetString("platform", "ANY_PLATFORM");
+    entry->SetInteger("cache_duration", 300 + i % 60);
+    std::unique_ptr<DictionaryValue> metadata(new DictionaryValue);
+    metadata->SetString("malware_threat_type", "LANDING");
+    metadata->SetString("population_id", MakeHexString(i * 7, 40));
+    entry->Set("metadata", std::move(metadata));
+    root.Append(std::move(entry));
+  }
+
+  std::string json;
+  CHECK(JSONWriter::Write(root, &json));
+  return json;
+}
+
+void RunParsePerfTest(const std::string& document_name,
+                      const std::string& json) {
+  const struct {
+    int options;
+    const char* name;
+  } kConfigurations[] = {
+      {JSON_PARSE_RFC, "default"},
+      {JSON_DETACHABLE_CHILDREN, "detachable"},
+      {JSON_FLAT_DICTIONARIES, "flat_dictionaries"},
+  };
+
+  const size_t iterations = kMinBytesParsed / json.size() + 1;
+  for (const auto& configuration : kConfigurations) {
+    // Parse once untimed to warm up caches and the allocator.
+    CHECK(JSONReader::Read(json, configuration.options));
+
+    TimeTicks start = TimeTicks::Now();
+    for (size_t i = 0; i < iterations; ++i) {
+      std::unique_ptr<Value> root =
+          JSONReader::Read(json, configuration.options);
+      CHECK(root);
+    }
+    TimeDelta elapsed = TimeTicks::Now() - start;
+
+    const double megabytes =
+        static_cast<double>(json.size()) * iterations / (1024 * 1024);
+    perf_test::PrintResult("json_parse", "_" + document_name,
+                           configuration.name,
+                           megabytes / elapsed.InSecondsF(), "MB/s", true);
+  }
+}
+
+}  // namespace
+
+TEST(JSONParserPerfTest, Preferences) {
+  RunParsePerfTest("preferences", MakePreferencesJSON());
+}
+
+TEST(JSONParserPerfTest, Policy) {
+  RunParsePerfTest("policy", MakePolicyJSON());
+}
+
+TEST(JSONParserPerfTest, SafeBrowsingMetadata) {
+  RunParsePerfTest("safe_browsing_metadata", MakeSafeBrowsingMetadataJSON());
+}
+
+}  // namespace base
@@ -58,6 +58,40 @@ TEST_F(JSONParserTest, ConsumeString) {
   EXPECT_EQ("test", str);
 }
 
+// Strings long enough to be scanned in bulk, with quotes, escapes and
+// multi-byte characters at and around the 16-byte chunk boundaries.
+TEST_F(JSONParserTest, ConsumeLongStrings) {
+  const struct {
+    const char* input;
+    const char* expected;
+  } kCases[] = {
+      {"\"0123456789abcdefghijklmnopqrstuvwxyz\",|",
+       "0123456789abcdefghijklmnopqrstuvwxyz"},
+      {"\"0123456789abcde\\\"ghijklmnopqrstuv\",|",
+       "0123456789abcde\"ghijklmnopqrstuv"},
+      {"\"0123456789abcdef\\n0123456789abcdef0123456789\",|",
+       "0123456789abcdef\n0123456789abcdef0123456789"},
+      {"\"0123456789abcd\xC3\xA9" "f0123456789abcdef\",|",
+       "0123456789abcd\xC3\xA9" "f0123456789abcdef"},
+      {"\"0123456789abcdef0123456789abcdef\",|",
+       "0123456789abcdef0123456789abcdef"},
+  };
+
+  for (const auto& test_case : kCases) {
+    std::string input(test_case.input);
+    std::unique_ptr<JSONParser> parser(NewTestParser(input));
+    std::unique_ptr<Value> value(parser->ConsumeString());
+    EXPECT_EQ('"', *parser->pos_) << test_case.input;
+
+    TestLastThree(parser.get());
+
+    ASSERT_TRUE(value.get()) << test_case.input;
+    std::string str;
+    EXPECT_TRUE(value->GetAsString(&str));
+    EXPECT_EQ(test_case.expected, str);
+  }
+}
+
 TEST_F(JSONParserTest, ConsumeList) {
   std::string input("[true, false],|");
   std::unique_ptr<JSONParser> parser(NewTestParser(input));
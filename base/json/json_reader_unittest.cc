@@ -675,4 +675,35 @@ TEST(JSONReaderTest, IllegalTrailingNull) {
   EXPECT_EQ(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, reader.error_code());
 }
 
+TEST(JSONReaderTest, FlatDictionaries) {
+  const char kJson[] =
+      "{\"z\": [1, {\"y\": true, \"x\": null}], \"a\": \"s\", \"z\": 2}";
+
+  std::unique_ptr<Value> flat_root =
+      JSONReader::Read(kJson, JSON_FLAT_DICTIONARIES);
+  std::unique_ptr<Value> map_root = JSONReader::Read(kJson);
+  ASSERT_TRUE(flat_root);
+  ASSERT_TRUE(map_root);
+  EXPECT_TRUE(flat_root->Equals(map_root.get()));
+
+  DictionaryValue* dict = nullptr;
+  ASSERT_TRUE(flat_root->GetAsDictionary(&dict));
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, dict->storage_mode());
+  EXPECT_EQ(2U, dict->size());
+  int z = 0;
+  EXPECT_TRUE(dict->GetInteger("z", &z));
+  EXPECT_EQ(2, z);
+
+  std::unique_ptr<Value> nested_root =
+      JSONReader::Read("[{\"y\": true, \"x\": null}]",
+                       JSON_FLAT_DICTIONARIES | JSON_DETACHABLE_CHILDREN);
+  ASSERT_TRUE(nested_root);
+  ListValue* list = nullptr;
+  ASSERT_TRUE(nested_root->GetAsList(&list));
+  ASSERT_TRUE(list->GetDictionary(0, &dict));
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, dict->storage_mode());
+  EXPECT_TRUE(dict->HasKey("x"));
+  EXPECT_TRUE(dict->HasKey("y"));
+}
+
 }  // namespace base
@@ -0,0 +1,300 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/small_object_pool.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace base {
+
+namespace {
+
+// Sizes are rounded up to a multiple of 16 bytes up to 256 bytes, and to a
+// multiple of 64 bytes above.
+const size_t kNumSmallSizeClasses = 16;
+const size_t kSmallSizeClassStep = 16;
+const size_t kLargeSizeClassStep = 64;
+const size_t kMaxSmallSize = kNumSmallSizeClasses * kSmallSizeClassStep;
+const size_t kNumSizeClasses =
+    kNumSmallSizeClasses +
+    (SmallObjectPool::kMaxSize - kMaxSmallSize) / kLargeSizeClassStep;
+
+// The number of objects in a magazine, which is what a thread takes from or
+// gives back to the depot at a time.
+const size_t kMagazineSize = 32;
+
+// Size classes take address space in slabs of this size.
+const size_t kSlabSize = 64 * 1024;
+
+const size_t kReservationSize =
+    sizeof(void*) == 8 ? 256 * 1024 * 1024 : 32 * 1024 * 1024;
+
+size_t GetSizeClass(size_t size) {
+  DCHECK_LE(size, SmallObjectPool::kMaxSize);
+  if (size <= kMaxSmallSize)
+    return size ? (size - 1) / kSmallSizeClassStep : 0;
+  return kNumSmallSizeClasses +
+         (size - kMaxSmallSize - 1) / kLargeSizeClassStep;
+}
+
+size_t GetSizeClassSize(size_t size_class) {
+  if (size_class < kNumSmallSizeClasses)
+    return (size_class + 1) * kSmallSizeClassStep;
+  return kMaxSmallSize +
+         (size_class - kNumSmallSizeClasses + 1) * kLargeSizeClassStep;
+}
+
+struct Magazine {
+  size_t count;
+  void* objects[kMagazineSize];
+};
+
+// The magazines of a thread. For each size class, the thread allocates from
+// and frees to |loaded|, and keeps |previous| so that it only goes to the depot
+// when both are empty or both are full. Otherwise a thread which allocates and
+// frees around a magazine boundary would go to the depot every time.
+struct ThreadCache {
+  Magazine* loaded[kNumSizeClasses];
+  Magazine* previous[kNumSizeClasses];
+};
+
+// The state of a size class which is shared by all threads.
+struct SizeClass {
+  Lock lock;
+  // Magazines which hold objects, and empty ones.
+  std::vector<Magazine*> full_magazines;
+  std::vector<Magazine*> empty_magazines;
+  // The part of the current slab which was not handed out yet.
+  char* slab_next = nullptr;
+  char* slab_end = nullptr;
+};
+
+// The bounds of the reserved address range, read without a lock by
+// SmallObjectPool::Contains(). Only set once.
+subtle::AtomicWord g_reservation_begin = 0;
+
+// The sanitizers neither see objects in the pool nor scan them for pointers.
+subtle::Atomic32 g_enabled =
+#if defined(ADDRESS_SANITIZER) || defined(LEAK_SANITIZER)
+    0;
+#else
+    1;
+#endif
+
+void DestroyThreadCache(void* value);
+
+class Pool {
+ public:
+  Pool()
+      : thread_cache_slot_(&DestroyThreadCache),
+        reservation_next_(nullptr),
+        reservation_end_(nullptr) {
+    char* reservation = static_cast<char*>(
+        internal::ReserveSmallObjectPoolMemory(kReservationSize));
+    if (!reservation)
+      return;
+    reservation_next_ = reservation;
+    reservation_end_ = reservation + kReservationSize;
+    subtle::Release_Store(&g_reservation_begin,
+                          reinterpret_cast<subtle::AtomicWord>(reservation));
+  }
+
+  void* Allocate(size_t size_class) {
+    ThreadCache* cache = GetThreadCache();
+    Magazine*& loaded = cache->loaded[size_class];
+    if (!loaded || !loaded->count) {
+      Magazine*& previous = cache->previous[size_class];
+      if (previous && previous->count) {
+        std::swap(loaded, previous);
+      } else {
+        if (!previous)
+          std::swap(loaded, previous);
+        loaded = Refill(size_class, loaded);
+      }
+      if (!loaded->count)
+        return nullptr;
+    }
+    return loaded->objects[--loaded->count];
+  }
+
+  void Free(void* ptr, size_t size_class) {
+    ThreadCache* cache = GetThreadCache();
+    Magazine*& loaded = cache->loaded[size_class];
+    if (!loaded || loaded->count == kMagazineSize) {
+      Magazine*& previous = cache->previous[size_class];
+      if (previous && previous->count < kMagazineSize) {
+        std::swap(loaded, previous);
+      } else {
+        if (!previous)
+          std::swap(loaded, previous);
+        loaded = Exchange(size_class, loaded);
+      }
+    }
+    loaded->objects[loaded->count++] = ptr;
+  }
+
+  // Returns the magazines of a thread which exits to the depot.
+  void ReturnThreadCache(ThreadCache* cache) {
+    for (size_t size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+      SizeClass& central = size_classes_[size_class];
+      AutoLock lock(central.lock);
+      for (Magazine* magazine :
+           {cache->loaded[size_class], cache->previous[size_class]}) {
+        if (!magazine)
+          continue;
+        if (magazine->count)
+          central.full_magazines.push_back(magazine);
+        else
+          central.empty_magazines.push_back(magazine);
+      }
+    }
+    delete cache;
+  }
+
+ private:
+  // Returns the cache of the current thread. If an object is freed by a TLS
+  // destructor after the cache was destroyed at thread exit, a new cache is
+  // created, which is returned to the depot in the next round of destructors.
+  ThreadCache* GetThreadCache() {
+    ThreadCache* cache = static_cast<ThreadCache*>(thread_cache_slot_.Get());
+    if (!cache) {
+      cache = new ThreadCache();
+      thread_cache_slot_.Set(cache);
+    }
+    return cache;
+  }
+
+  // Returns a magazine with objects in exchange for the empty |magazine|,
+  // which may be null. The returned magazine is empty only if the reservation
+  // is exhausted.
+  Magazine* Refill(size_t size_class, Magazine* magazine) {
+    SizeClass& central = size_classes_[size_class];
+    AutoLock lock(central.lock);
+    if (!central.full_magazines.empty()) {
+      if (magazine)
+        central.empty_magazines.push_back(magazine);
+      magazine = central.full_magazines.back();
+      central.full_magazines.pop_back();
+      return magazine;
+    }
+
+    if (!magazine)
+      magazine = TakeEmptyMagazineWhileLocked(&central);
+    const size_t object_size = GetSizeClassSize(size_class);
+    while (magazine->count < kMagazineSize) {
+      if (static_cast<size_t>(central.slab_end - central.slab_next) <
+              object_size &&
+          !TakeSlab(&central)) {
+        break;
+      }
+      magazine->objects[magazine->count++] = central.slab_next;
+      central.slab_next += object_size;
+    }
+    return magazine;
+  }
+
+  // Returns an empty magazine in exchange for the full |magazine|, which may
+  // be null.
+  Magazine* Exchange(size_t size_class, Magazine* magazine) {
+    SizeClass& central = size_classes_[size_class];
+    AutoLock lock(central.lock);
+    if (magazine)
+      central.full_magazines.push_back(magazine);
+    return TakeEmptyMagazineWhileLocked(&central);
+  }
+
+  Magazine* TakeEmptyMagazineWhileLocked(SizeClass* central) {
+    central->lock.AssertAcquired();
+    if (central->empty_magazines.empty()) {
+      Magazine* magazine = new Magazine;
+      magazine->count = 0;
+      return magazine;
+    }
+    Magazine* magazine = central->empty_magazines.back();
+    central->empty_magazines.pop_back();
+    return magazine;
+  }
+
+  // Gives a new slab to |central|. Returns false if the reservation is
+  // exhausted.
+  bool TakeSlab(SizeClass* central) {
+    central->lock.AssertAcquired();
+    char* slab;
+    {
+      AutoLock lock(reservation_lock_);
+      if (reservation_next_ == reservation_end_)
+        return false;
+      slab = reservation_next_;
+      if (!internal::CommitSmallObjectPoolMemory(slab, kSlabSize))
+        return false;
+      reservation_next_ += kSlabSize;
+    }
+    central->slab_next = slab;
+    central->slab_end = slab + kSlabSize;
+    return true;
+  }
+
+  ThreadLocalStorage::Slot thread_cache_slot_;
+  SizeClass size_classes_[kNumSizeClasses];
+
+  Lock reservation_lock_;
+  char* reservation_next_;
+  char* reservation_end_;
+
+  DISALLOW_COPY_AND_ASSIGN(Pool);
+};
+
+LazyInstance<Pool>::Leaky g_pool = LAZY_INSTANCE_INITIALIZER;
+
+void DestroyThreadCache(void* value) {
+  g_pool.Get().ReturnThreadCache(static_cast<ThreadCache*>(value));
+}
+
+}  // namespace
+
+const size_t SmallObjectPool::kMaxSize;
+
+// static
+void* SmallObjectPool::Allocate(size_t size) {
+  if (size <= kMaxSize && subtle::NoBarrier_Load(&g_enabled)) {
+    Pool& pool = g_pool.Get();
+    if (subtle::NoBarrier_Load(&g_reservation_begin)) {
+      void* ptr = pool.Allocate(GetSizeClass(size));
+      if (ptr)
+        return ptr;
+    }
+  }
+  return ::operator new(size);
+}
+
+// static
+void SmallObjectPool::Free(void* ptr, size_t size) {
+  if (!Contains(ptr)) {
+    ::operator delete(ptr);
+    return;
+  }
+  g_pool.Get().Free(ptr, GetSizeClass(size));
+}
+
+// static
+bool SmallObjectPool::Contains(const void* ptr) {
+  uintptr_t begin = subtle::NoBarrier_Load(&g_reservation_begin);
+  return begin && reinterpret_cast<uintptr_t>(ptr) - begin < kReservationSize;
+}
+
+// static
+bool SmallObjectPool::SetEnabled(bool enabled) {
+  return !!subtle::NoBarrier_AtomicExchange(&g_enabled, enabled);
+}
+
+}  // namespace base
@@ -0,0 +1,128 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_SMALL_OBJECT_POOL_H_
+#define BASE_MEMORY_SMALL_OBJECT_POOL_H_
+
+#include <stddef.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+
+namespace base {
+
+namespace internal {
+
+// Reserves |size| bytes of address space for the pool, without committing
+// them. Returns null on failure.
+void* ReserveSmallObjectPoolMemory(size_t size);
+
+// Commits |size| bytes at |address|, in memory returned by
+// ReserveSmallObjectPoolMemory(). Returns false on failure.
+bool CommitSmallObjectPoolMemory(void* address, size_t size);
+
+}  // namespace internal
+
+// SmallObjectPool is a size-class allocator for small objects that are
+// allocated and freed at a high rate, often on different threads, like tasks
+// and the BindStates of their callbacks.
+//
+// Objects are carved out of slabs in a reserved address range. Each thread
+// caches a magazine of free objects per size class, so that most allocations
+// and frees are a push or pop on a thread-local array. When a magazine runs
+// empty or full, it is exchanged for another one in a depot shared by all
+// threads, which is how objects freed on one thread flow back to the threads
+// that allocate them.
+//
+// Memory taken by the pool is never returned to the system. Allocations which
+// are larger than kMaxSize, or which are made while the pool is disabled or
+// out of address space, are forwarded to operator new; Free() tells them apart
+// by address, so it is always safe to call.
+//
+// Allocations from the pool are not seen by the heap profiler, and the pool is
+// disabled by default under AddressSanitizer and LeakSanitizer.
+class BASE_EXPORT SmallObjectPool {
+ public:
+  // The largest allocation served from the pool.
+  static const size_t kMaxSize = 512;
+
+  // Returns memory for |size| bytes, aligned like memory from operator new.
+  static void* Allocate(size_t size);
+
+  // Frees |ptr|, which was returned by Allocate(size). |size| must be the
+  // size that was passed to Allocate().
+  static void Free(void* ptr, size_t size);
+
+  // Returns whether |ptr| was allocated from the pool.
+  static bool Contains(const void* ptr);
+
+  // Sets whether new allocations are served from the pool. Meant to compare
+  // the pool with the system allocator; objects which are already allocated
+  // keep working either way. Returns the previous value.
+  static bool SetEnabled(bool enabled);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SmallObjectPool);
+};
+
+// Deriving from SmallObjectPoolAllocated makes new and delete of a class use
+// SmallObjectPool. Objects must be deleted through a pointer to their most
+// derived type, since the size passed to operator delete selects the size
+// class.
+class BASE_EXPORT SmallObjectPoolAllocated {
+ public:
+  static void* operator new(size_t size) {
+    return SmallObjectPool::Allocate(size);
+  }
+  static void operator delete(void* ptr, size_t size) {
+    SmallObjectPool::Free(ptr, size);
+  }
+
+ protected:
+  SmallObjectPoolAllocated() = default;
+  ~SmallObjectPoolAllocated() = default;
+};
+
+// An STL allocator which allocates from SmallObjectPool, for containers whose
+// allocations are small, like the blocks of a std::deque.
+template <typename T>
+class SmallObjectPoolAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  template <typename U>
+  struct rebind {
+    using other = SmallObjectPoolAllocator<U>;
+  };
+
+  SmallObjectPoolAllocator() = default;
+  template <typename U>
+  SmallObjectPoolAllocator(const SmallObjectPoolAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(SmallObjectPool::Allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, size_t n) {
+    SmallObjectPool::Free(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const SmallObjectPoolAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const SmallObjectPoolAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace base
+
+#endif  // BASE_MEMORY_SMALL_OBJECT_POOL_H_
@@ -0,0 +1,158 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/small_object_pool.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class SmallObjectPoolTest : public testing::Test {
+ public:
+  SmallObjectPoolTest() : pool_was_enabled_(false) {}
+
+  void SetUp() override {
+    pool_was_enabled_ = SmallObjectPool::SetEnabled(true);
+  }
+
+  void TearDown() override { SmallObjectPool::SetEnabled(pool_was_enabled_); }
+
+ private:
+  bool pool_was_enabled_;
+};
+
+void FreeAll(const std::vector<void*>& objects, size_t size) {
+  for (void* object : objects)
+    SmallObjectPool::Free(object, size);
+}
+
+struct PooledObject : public SmallObjectPoolAllocated {
+  explicit PooledObject(int value) : value(value) {}
+
+  int value;
+  char padding[100];
+};
+
+}  // namespace
+
+TEST_F(SmallObjectPoolTest, AllocateAndFree) {
+  for (size_t size = 1; size <= SmallObjectPool::kMaxSize; size++) {
+    void* object = SmallObjectPool::Allocate(size);
+    ASSERT_TRUE(object);
+    EXPECT_TRUE(SmallObjectPool::Contains(object));
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(object) % 16);
+    memset(object, 0xAB, size);
+    SmallObjectPool::Free(object, size);
+  }
+}
+
+TEST_F(SmallObjectPoolTest, ObjectsDoNotOverlap) {
+  const size_t kSize = 48;
+  std::vector<void*> objects;
+  std::set<uintptr_t> addresses;
+  for (int i = 0; i < 1000; i++) {
+    objects.push_back(SmallObjectPool::Allocate(kSize));
+    addresses.insert(reinterpret_cast<uintptr_t>(objects.back()));
+  }
+  EXPECT_EQ(objects.size(), addresses.size());
+
+  uintptr_t previous = 0;
+  for (uintptr_t address : addresses) {
+    EXPECT_GE(address - previous, kSize);
+    previous = address;
+  }
+  FreeAll(objects, kSize);
+}
+
+TEST_F(SmallObjectPoolTest, ReusesFreedObjects) {
+  void* object = SmallObjectPool::Allocate(64);
+  SmallObjectPool::Free(object, 64);
+  // Sizes of the same size class share objects.
+  void* reused = SmallObjectPool::Allocate(50);
+  EXPECT_EQ(object, reused);
+  SmallObjectPool::Free(reused, 50);
+}
+
+TEST_F(SmallObjectPoolTest, LargeObjectsAreNotPooled) {
+  void* object = SmallObjectPool::Allocate(SmallObjectPool::kMaxSize + 1);
+  EXPECT_FALSE(SmallObjectPool::Contains(object));
+  SmallObjectPool::Free(object, SmallObjectPool::kMaxSize + 1);
+}
+
+TEST_F(SmallObjectPoolTest, Disable) {
+  void* pooled = SmallObjectPool::Allocate(32);
+  SmallObjectPool::SetEnabled(false);
+  void* not_pooled = SmallObjectPool::Allocate(32);
+  EXPECT_TRUE(SmallObjectPool::Contains(pooled));
+  EXPECT_FALSE(SmallObjectPool::Contains(not_pooled));
+
+  // Objects are freed correctly whether or not the pool is enabled.
+  SmallObjectPool::Free(pooled, 32);
+  SmallObjectPool::SetEnabled(true);
+  SmallObjectPool::Free(not_pooled, 32);
+}
+
+// Objects allocated on one thread and freed on another go back through the
+// depot to the allocating thread.
+TEST_F(SmallObjectPoolTest, FreeOnOtherThread) {
+  const size_t kSize = 128;
+  const int kRounds = 10;
+  const size_t kObjectsPerRound = 1000;
+  Thread thread("SmallObjectPoolTest");
+  thread.Start();
+
+  WaitableEvent freed(WaitableEvent::ResetPolicy::AUTOMATIC,
+                     WaitableEvent::InitialState::NOT_SIGNALED);
+  std::set<void*> addresses;
+  for (int round = 0; round < kRounds; round++) {
+    std::vector<void*> objects;
+    for (size_t i = 0; i < kObjectsPerRound; i++) {
+      objects.push_back(SmallObjectPool::Allocate(kSize));
+      memset(objects.back(), round, kSize);
+    }
+    addresses.insert(objects.begin(), objects.end());
+    thread.task_runner()->PostTask(FROM_HERE,
+                                   Bind(&FreeAll, objects, kSize));
+    thread.task_runner()->PostTask(
+        FROM_HERE, Bind(&WaitableEvent::Signal, Unretained(&freed)));
+    freed.Wait();
+  }
+  thread.Stop();
+
+  // Only the objects cached by |thread| are not reused.
+  EXPECT_LT(addresses.size(), 2 * kObjectsPerRound);
+}
+
+TEST_F(SmallObjectPoolTest, PooledClass) {
+  std::unique_ptr<PooledObject> object(new PooledObject(42));
+  EXPECT_TRUE(SmallObjectPool::Contains(object.get()));
+  EXPECT_EQ(42, object->value);
+}
+
+TEST_F(SmallObjectPoolTest, Allocator) {
+  std::deque<int, SmallObjectPoolAllocator<int>> queue;
+  for (int i = 0; i < 10000; i++)
+    queue.push_back(i);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(i, queue.front());
+    queue.pop_front();
+  }
+}
+
+}  // namespace base
@@ -5,8 +5,10 @@
 #include "base/message_loop/incoming_task_queue.h"
 
 #include <limits>
+#include <utility>
 
 #include "base/location.h"
+#include "base/memory/small_object_pool.h"
 #include "base/message_loop/message_loop.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/time/time.h"
@@ -48,13 +50,27 @@ TimeTicks CalculateDelayedRuntime(TimeDelta delay) {
 
 }  // namespace
 
+// Allocated from SmallObjectPool, since one is allocated for every post and
+// freed on the thread of the message loop.
+struct IncomingTaskQueue::IncomingTask : public SmallObjectPoolAllocated {
+  explicit IncomingTask(PendingTask* pending_task)
+      : pending_task(std::move(*pending_task)) {}
+
+  PendingTask pending_task;
+
+  // The next IncomingTask in the list, in |incoming_queue_| (towards older
+  // tasks) or in a list returned by TakeIncomingTasks() (towards newer tasks).
+  IncomingTask* next = nullptr;
+};
+
 IncomingTaskQueue::IncomingTaskQueue(MessageLoop* message_loop)
     : high_res_task_count_(0),
+      incoming_queue_(0),
       message_loop_(message_loop),
       next_sequence_num_(0),
-      message_loop_scheduled_(false),
+      message_loop_scheduled_(0),
       always_schedule_work_(AlwaysNotifyPump(message_loop_->type())),
-      is_ready_for_scheduling_(false) {
+      is_ready_for_scheduling_(0) {
 }
 
 bool IncomingTaskQueue::AddToIncomingQueue(
@@ -83,33 +99,42 @@ bool IncomingTaskQueue::AddToIncomingQueue(
 }
 
 bool IncomingTaskQueue::HasHighResolutionTasks() {
-  AutoLock lock(incoming_queue_lock_);
-  return high_res_task_count_ > 0;
+  return subtle::Acquire_Load(&high_res_task_count_) > 0;
 }
 
 bool IncomingTaskQueue::IsIdleForTesting() {
-  AutoLock lock(incoming_queue_lock_);
-  return incoming_queue_.empty();
+  return subtle::Acquire_Load(&incoming_queue_) == 0;
 }
 
 int IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  AutoLock lock(incoming_queue_lock_);
-  if (incoming_queue_.empty()) {
+  // Acquire all we can from the inter-thread queue with one atomic operation.
+  IncomingTask* incoming_tasks = TakeIncomingTasks();
+  if (!incoming_tasks) {
     // If the loop attempts to reload but there are no tasks in the incoming
     // queue, that means it will go to sleep waiting for more work. If the
     // incoming queue becomes nonempty we need to schedule it again.
-    message_loop_scheduled_ = false;
-  } else {
-    incoming_queue_.swap(*work_queue);
+    subtle::NoBarrier_Store(&message_loop_scheduled_, 0);
+
+    // A task posted before |message_loop_scheduled_| was cleared didn't
+    // schedule work: look for it again. The barrier pairs with the one in
+    // PostPendingTask(): either the posting thread sees the cleared flag and
+    // schedules work, or its task is seen here.
+    subtle::MemoryBarrier();
+    incoming_tasks = TakeIncomingTasks();
+  }
+
+  while (incoming_tasks) {
+    IncomingTask* const next = incoming_tasks->next;
+    work_queue->push(std::move(incoming_tasks->pending_task));
+    delete incoming_tasks;
+    incoming_tasks = next;
   }
+
   // Reset the count of high resolution tasks since our queue is now empty.
-  int high_res_tasks = high_res_task_count_;
-  high_res_task_count_ = 0;
-  return high_res_tasks;
+  return subtle::NoBarrier_AtomicExchange(&high_res_task_count_, 0);
 }
 
 void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
@@ -118,15 +143,14 @@ void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
 }
 
 void IncomingTaskQueue::StartScheduling() {
-  bool schedule_work;
-  {
-    AutoLock lock(incoming_queue_lock_);
-    DCHECK(!is_ready_for_scheduling_);
-    DCHECK(!message_loop_scheduled_);
-    is_ready_for_scheduling_ = true;
-    schedule_work = !incoming_queue_.empty();
-  }
-  if (schedule_work) {
+  DCHECK(!subtle::NoBarrier_Load(&is_ready_for_scheduling_));
+  DCHECK(!subtle::NoBarrier_Load(&message_loop_scheduled_));
+  subtle::NoBarrier_Store(&is_ready_for_scheduling_, 1);
+
+  // Pairs with the barrier in PostPendingTask(): either the posting thread sees
+  // that scheduling is allowed, or its task is seen here.
+  subtle::MemoryBarrier();
+  if (subtle::NoBarrier_Load(&incoming_queue_) != 0) {
     DCHECK(message_loop_);
     // Don't need to lock |message_loop_lock_| here because this function is
     // called by MessageLoop on its thread.
@@ -137,6 +161,13 @@ void IncomingTaskQueue::StartScheduling() {
 IncomingTaskQueue::~IncomingTaskQueue() {
   // Verify that WillDestroyCurrentMessageLoop() has been called.
   DCHECK(!message_loop_);
+
+  IncomingTask* incoming_tasks = TakeIncomingTasks();
+  while (incoming_tasks) {
+    IncomingTask* const next = incoming_tasks->next;
+    delete incoming_tasks;
+    incoming_tasks = next;
+  }
 }
 
 bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
@@ -152,48 +183,86 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
     return false;
   }
 
-  bool schedule_work = false;
-  {
-    AutoLock hold(incoming_queue_lock_);
-
 #if defined(OS_WIN)
-    if (pending_task->is_high_res)
-      ++high_res_task_count_;
+  if (pending_task->is_high_res)
+    subtle::NoBarrier_AtomicIncrement(&high_res_task_count_, 1);
 #endif
 
-    // Initialize the sequence number. The sequence number is used for delayed
-    // tasks (to facilitate FIFO sorting when two tasks have the same
-    // delayed_run_time value) and for identifying the task in about:tracing.
-    pending_task->sequence_num = next_sequence_num_++;
+  // Initialize the sequence number. The sequence number is used for delayed
+  // tasks (to facilitate FIFO sorting when two tasks have the same
+  // delayed_run_time value) and for identifying the task in about:tracing.
+  pending_task->sequence_num =
+      subtle::NoBarrier_AtomicIncrement(&next_sequence_num_, 1) - 1;
 
-    message_loop_->task_annotator()->DidQueueTask("MessageLoop::PostTask",
-                                                  *pending_task);
+  message_loop_->task_annotator()->DidQueueTask("MessageLoop::PostTask",
+                                                *pending_task);
 
-    bool was_empty = incoming_queue_.empty();
-    incoming_queue_.push(std::move(*pending_task));
+  const bool was_empty = PushIncomingTask(new IncomingTask(pending_task));
 
-    if (is_ready_for_scheduling_ &&
-        (always_schedule_work_ || (!message_loop_scheduled_ && was_empty))) {
-      schedule_work = true;
+  bool schedule_work = false;
+  if (always_schedule_work_ || was_empty) {
+    // Pairs with the barriers in StartScheduling() and ReloadWorkQueue(), which
+    // look at |incoming_queue_| after changing the flags read below.
+    subtle::MemoryBarrier();
+    if (subtle::NoBarrier_Load(&is_ready_for_scheduling_)) {
       // After we've scheduled the message loop, we do not need to do so again
       // until we know it has processed all of the work in our queue and is
       // waiting for more work again. The message loop will always attempt to
       // reload from the incoming queue before waiting again so we clear this
       // flag in ReloadWorkQueue().
-      message_loop_scheduled_ = true;
+      schedule_work =
+          subtle::NoBarrier_CompareAndSwap(&message_loop_scheduled_, 0, 1) ==
+              0 ||
+          always_schedule_work_;
     }
   }
 
-  // Wake up the message loop and schedule work. This is done outside
-  // |incoming_queue_lock_| because signaling the message loop may cause this
-  // thread to be switched. If |incoming_queue_lock_| is held, any other thread
-  // that wants to post a task will be blocked until this thread switches back
-  // in and releases |incoming_queue_lock_|.
+  // Wake up the message loop and schedule work. This is done once the task is
+  // in |incoming_queue_|, so that the message loop finds it when it wakes up.
   if (schedule_work)
     message_loop_->ScheduleWork();
 
   return true;
 }
 
+bool IncomingTaskQueue::PushIncomingTask(IncomingTask* incoming_task) {
+  subtle::AtomicWord head = subtle::NoBarrier_Load(&incoming_queue_);
+  for (;;) {
+    incoming_task->next = reinterpret_cast<IncomingTask*>(head);
+    // The release barrier publishes |incoming_task| to TakeIncomingTasks().
+    const subtle::AtomicWord previous_head = subtle::Release_CompareAndSwap(
+        &incoming_queue_, head, reinterpret_cast<subtle::AtomicWord>(
+                                    incoming_task));
+    if (previous_head == head)
+      return head == 0;
+    head = previous_head;
+  }
+}
+
+IncomingTaskQueue::IncomingTask* IncomingTaskQueue::TakeIncomingTasks() {
+  subtle::AtomicWord head = subtle::NoBarrier_Load(&incoming_queue_);
+  for (;;) {
+    if (!head)
+      return nullptr;
+    const subtle::AtomicWord previous_head =
+        subtle::Acquire_CompareAndSwap(&incoming_queue_, head, 0);
+    if (previous_head == head)
+      break;
+    head = previous_head;
+  }
+
+  // |incoming_queue_| is a stack: reverse it to get the tasks in the order in
+  // which they were posted.
+  IncomingTask* newest_first = reinterpret_cast<IncomingTask*>(head);
+  IncomingTask* oldest_first = nullptr;
+  while (newest_first) {
+    IncomingTask* const next = newest_first->next;
+    newest_first->next = oldest_first;
+    oldest_first = newest_first;
+    newest_first = next;
+  }
+  return oldest_first;
+}
+
 }  // namespace internal
 }  // namespace base
@@ -5,11 +5,11 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
 #include "base/pending_task.h"
-#include "base/synchronization/lock.h"
 #include "base/synchronization/read_write_lock.h"
 #include "base/time/time.h"
 
@@ -23,6 +23,11 @@ namespace internal {
 // Implements a queue of tasks posted to the message loop running on the current
 // thread. This class takes care of synchronizing posting tasks from different
 // threads and together with MessageLoop ensures clean shutdown.
+//
+// Posted tasks are pushed to a lock-free multi-producer single-consumer list:
+// posting threads never wait for each other or for the message loop thread,
+// and ReloadWorkQueue() takes all the tasks posted since the previous reload
+// with a single atomic operation.
 class BASE_EXPORT IncomingTaskQueue
     : public RefCountedThreadSafe<IncomingTaskQueue> {
  public:
@@ -47,9 +52,9 @@ class BASE_EXPORT IncomingTaskQueue
   // Returns true if the message loop is "idle". Provided for testing.
   bool IsIdleForTesting();
 
-  // Loads tasks from the |incoming_queue_| into |*work_queue|. Must be called
-  // from the thread that is running the loop. Returns the number of tasks that
-  // require high resolution timers.
+  // Loads tasks from the |incoming_queue_| into |*work_queue|, in the order in
+  // which they were posted. Must be called from the thread that is running the
+  // loop. Returns the number of tasks that require high resolution timers.
   int ReloadWorkQueue(TaskQueue* work_queue);
 
   // Disconnects |this| from the parent message loop.
@@ -60,6 +65,9 @@ class BASE_EXPORT IncomingTaskQueue
   void StartScheduling();
 
  private:
+  // A PendingTask linked in |incoming_queue_|.
+  struct IncomingTask;
+
   friend class RefCountedThreadSafe<IncomingTaskQueue>;
   virtual ~IncomingTaskQueue();
 
@@ -69,42 +77,50 @@ class BASE_EXPORT IncomingTaskQueue
   // does not retain |pending_task->task| beyond this function call.
   bool PostPendingTask(PendingTask* pending_task);
 
-  // Wakes up the message loop and schedules work.
-  void ScheduleWork();
+  // Pushes |incoming_task| on |incoming_queue_|. Returns true if
+  // |incoming_queue_| was empty before the push. Can be called from any
+  // thread.
+  bool PushIncomingTask(IncomingTask* incoming_task);
 
-  // Number of tasks that require high resolution timing. This value is kept
-  // so that ReloadWorkQueue() completes in constant time.
-  int high_res_task_count_;
+  // Removes all IncomingTasks from |incoming_queue_| and returns them as a
+  // list in the order in which they were posted, or nullptr if
+  // |incoming_queue_| is empty. Must be called from the thread that is running
+  // the loop, or after the loop is gone.
+  IncomingTask* TakeIncomingTasks();
 
-  // The lock that protects access to the members of this class, except
-  // |message_loop_|.
-  base::Lock incoming_queue_lock_;
+  // Number of tasks that require high resolution timing. This value is kept
+  // so that ReloadWorkQueue() doesn't have to go through the tasks it loads.
+  // Incremented before the task is pushed to |incoming_queue_| so that it
+  // never reports less tasks than the ones that were loaded.
+  subtle::Atomic32 high_res_task_count_;
 
   // Lock that protects |message_loop_| to prevent it from being deleted while a
-  // task is being posted.
+  // task is being posted. Posting threads only acquire it for reading, which
+  // doesn't make them wait for each other.
   base::subtle::ReadWriteLock message_loop_lock_;
 
-  // An incoming queue of tasks that are acquired under a mutex for processing
-  // on this instance's thread. These tasks have not yet been been pushed to
-  // |message_loop_|.
-  TaskQueue incoming_queue_;
+  // Head of a lock-free stack of IncomingTasks (stored as an IncomingTask*)
+  // that have not yet been pushed to |message_loop_|. Posting threads push with
+  // a compare-and-swap and TakeIncomingTasks() detaches the whole stack at
+  // once, which avoids the ABA problem of popping individual entries.
+  subtle::AtomicWord incoming_queue_;
 
   // Points to the message loop that owns |this|.
   MessageLoop* message_loop_;
 
   // The next sequence number to use for delayed tasks.
-  int next_sequence_num_;
+  subtle::Atomic32 next_sequence_num_;
 
-  // True if our message loop has already been scheduled and does not need to be
-  // scheduled again until an empty reload occurs.
-  bool message_loop_scheduled_;
+  // Non-zero if our message loop has already been scheduled and does not need
+  // to be scheduled again until an empty reload occurs.
+  subtle::Atomic32 message_loop_scheduled_;
 
   // True if we always need to call ScheduleWork when receiving a new task, even
   // if the incoming queue was not empty.
   const bool always_schedule_work_;
 
-  // False until StartScheduling() is called.
-  bool is_ready_for_scheduling_;
+  // Zero until StartScheduling() is called.
+  subtle::Atomic32 is_ready_for_scheduling_;
 
   DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
 };
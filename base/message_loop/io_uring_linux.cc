@@ -0,0 +1,334 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/io_uring_linux.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "build/build_config.h"
+
+// The system headers which Chrome builds against predate io_uring, so its
+// system calls and the parts of <linux/io_uring.h> used here are defined
+// locally. Their numbers are the same on every architecture since Linux 5.1,
+// but for the offsets of the MIPS ABIs.
+#if !defined(__NR_io_uring_setup)
+#if defined(ARCH_CPU_MIPS_FAMILY)
+#define __NR_io_uring_setup 4425
+#define __NR_io_uring_enter 4426
+#elif defined(ARCH_CPU_MIPS64_FAMILY)
+#define __NR_io_uring_setup 5425
+#define __NR_io_uring_enter 5426
+#else
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#endif
+#endif  // !defined(__NR_io_uring_setup)
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// From <linux/io_uring.h>, as of Linux 5.11.
+struct IOSQRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct IOCQRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct IOURingParams {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  IOSQRingOffsets sq_off;
+  IOCQRingOffsets cq_off;
+};
+
+// Only the fields of a submission queue entry which a poll uses are named.
+struct IOURingSQE {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t poll32_events;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct IOURingCQE {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct IOURingGeteventsArg {
+  uint64_t sigmask;
+  uint32_t sigmask_sz;
+  uint32_t pad;
+  uint64_t ts;
+};
+
+struct KernelTimespec {
+  int64_t tv_sec;
+  int64_t tv_nsec;
+};
+
+static_assert(sizeof(IOURingParams) == 120, "io_uring_params size");
+static_assert(sizeof(IOURingSQE) == 64, "io_uring_sqe size");
+static_assert(sizeof(IOURingCQE) == 16, "io_uring_cqe size");
+static_assert(sizeof(IOURingGeteventsArg) == 24,
+              "io_uring_getevents_arg size");
+
+const uint64_t kOffSQRing = 0;
+const uint64_t kOffSQEs = 0x10000000;
+
+const uint32_t kFeatSingleMmap = 1U << 0;
+const uint32_t kFeatNoDrop = 1U << 1;
+const uint32_t kFeatExtArg = 1U << 8;
+
+const uint32_t kEnterGetEvents = 1U << 0;
+const uint32_t kEnterExtArg = 1U << 3;
+
+const uint8_t kOpPollAdd = 6;
+const uint8_t kOpPollRemove = 7;
+
+// The ring indices are shared with the kernel, which reads the submission
+// queue tail and writes its head, and the other way around for the completion
+// queue.
+uint32_t LoadAcquire(const uint32_t* index) {
+  return static_cast<uint32_t>(subtle::Acquire_Load(
+      reinterpret_cast<const volatile subtle::Atomic32*>(index)));
+}
+
+void StoreRelease(uint32_t* index, uint32_t value) {
+  subtle::Release_Store(reinterpret_cast<volatile subtle::Atomic32*>(index),
+                        static_cast<subtle::Atomic32>(value));
+}
+
+template <typename T>
+T* Offset(void* base, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<IOUring> IOUring::Create(uint32_t entries) {
+  std::unique_ptr<IOUring> io_uring(new IOUring);
+  if (!io_uring->Init(entries))
+    return nullptr;
+  return io_uring;
+}
+
+IOUring::IOUring()
+    : ring_fd_(-1),
+      rings_(MAP_FAILED),
+      rings_size_(0),
+      sqes_(MAP_FAILED),
+      sqes_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_array_(nullptr),
+      sq_mask_(0),
+      sq_entries_(0),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(0),
+      cqes_(nullptr) {}
+
+IOUring::~IOUring() {
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (rings_ != MAP_FAILED)
+    munmap(rings_, rings_size_);
+  // Closing the ring cancels the operations which are still in flight.
+  if (ring_fd_ >= 0 && IGNORE_EINTR(close(ring_fd_)) < 0)
+    DPLOG(ERROR) << "close";
+}
+
+void IOUring::QueuePollAdd(int fd, uint32_t events, uint64_t user_data) {
+  queued_operations_.push_back(
+      {kOpPollAdd, fd, events, 0, user_data});
+}
+
+void IOUring::QueuePollRemove(uint64_t target_user_data, uint64_t user_data) {
+  queued_operations_.push_back(
+      {kOpPollRemove, -1, 0, target_user_data, user_data});
+}
+
+void IOUring::SubmitAndWait(TimeDelta timeout,
+                            std::vector<Completion>* completions) {
+  // Operations which do not fit in the submission queue are submitted in
+  // several rounds. Reaping in between makes room in the completion queue,
+  // without which the kernel may refuse new submissions.
+  uint32_t to_submit = FillSubmissionQueue();
+  while (!queued_operations_.empty()) {
+    if (!Enter(to_submit, TimeDelta()))
+      break;
+    ReapCompletions(completions);
+    to_submit = FillSubmissionQueue();
+  }
+
+  if (HasCompletions())
+    timeout = TimeDelta();
+  if (to_submit || !timeout.is_zero())
+    Enter(to_submit, timeout);
+  ReapCompletions(completions);
+}
+
+bool IOUring::Init(uint32_t entries) {
+  IOURingParams params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring_fd_ < 0) {
+    DVPLOG(1) << "io_uring_setup";
+    return false;
+  }
+
+  // EXT_ARG, for timeouts in io_uring_enter(), implies the other features
+  // used here: a single mapping for both rings, 32 bit poll events and
+  // completions which are not dropped when the completion queue overflows.
+  const uint32_t kRequiredFeatures =
+      kFeatSingleMmap | kFeatNoDrop | kFeatExtArg;
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    DVLOG(1) << "io_uring lacks features: " << params.features;
+    return false;
+  }
+
+  rings_size_ = std::max(
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+      params.cq_off.cqes + params.cq_entries * sizeof(IOURingCQE));
+  rings_ = mmap(nullptr, rings_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd_, kOffSQRing);
+  if (rings_ == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap";
+    return false;
+  }
+  sqes_size_ = params.sq_entries * sizeof(IOURingSQE);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, kOffSQEs);
+  if (sqes_ == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap";
+    return false;
+  }
+
+  sq_head_ = Offset<uint32_t>(rings_, params.sq_off.head);
+  sq_tail_ = Offset<uint32_t>(rings_, params.sq_off.tail);
+  sq_array_ = Offset<uint32_t>(rings_, params.sq_off.array);
+  sq_mask_ = *Offset<uint32_t>(rings_, params.sq_off.ring_mask);
+  sq_entries_ = *Offset<uint32_t>(rings_, params.sq_off.ring_entries);
+  cq_head_ = Offset<uint32_t>(rings_, params.cq_off.head);
+  cq_tail_ = Offset<uint32_t>(rings_, params.cq_off.tail);
+  cq_mask_ = *Offset<uint32_t>(rings_, params.cq_off.ring_mask);
+  cqes_ = Offset<void>(rings_, params.cq_off.cqes);
+
+  // Submission queue entries are always used in order.
+  for (uint32_t i = 0; i < sq_entries_; ++i)
+    sq_array_[i] = i;
+  return true;
+}
+
+uint32_t IOUring::FillSubmissionQueue() {
+  const uint32_t head = LoadAcquire(sq_head_);
+  uint32_t tail = *sq_tail_;
+  const size_t count = std::min<size_t>(queued_operations_.size(),
+                                        sq_entries_ - (tail - head));
+  IOURingSQE* sqes = static_cast<IOURingSQE*>(sqes_);
+  for (size_t i = 0; i < count; ++i, ++tail) {
+    const Operation& operation = queued_operations_[i];
+    IOURingSQE* sqe = &sqes[tail & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = operation.opcode;
+    sqe->fd = operation.fd;
+    sqe->poll32_events = operation.poll_events;
+    sqe->addr = operation.addr;
+    sqe->user_data = operation.user_data;
+  }
+  queued_operations_.erase(queued_operations_.begin(),
+                           queued_operations_.begin() + count);
+  StoreRelease(sq_tail_, tail);
+  return tail - head;
+}
+
+bool IOUring::Enter(uint32_t to_submit, TimeDelta timeout) {
+  unsigned flags = 0;
+  unsigned min_complete = 0;
+  IOURingGeteventsArg arg;
+  KernelTimespec ts;
+  memset(&arg, 0, sizeof(arg));
+  if (!timeout.is_zero()) {
+    flags |= kEnterGetEvents | kEnterExtArg;
+    min_complete = 1;
+    if (!timeout.is_max()) {
+      ts.tv_sec = timeout.InSeconds();
+      ts.tv_nsec = timeout.InMicroseconds() % Time::kMicrosecondsPerSecond *
+                   Time::kNanosecondsPerMicrosecond;
+      arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+  }
+
+  if (syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags,
+              flags ? &arg : nullptr, flags ? sizeof(arg) : 0) >= 0) {
+    return true;
+  }
+  // ETIME is a timeout, and EBUSY and EAGAIN mean that completions must be
+  // reaped before more operations can be submitted.
+  if (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN)
+    return true;
+  DPLOG(ERROR) << "io_uring_enter";
+  return false;
+}
+
+bool IOUring::HasCompletions() const {
+  return *cq_head_ != LoadAcquire(cq_tail_);
+}
+
+void IOUring::ReapCompletions(std::vector<Completion>* completions) {
+  const uint32_t tail = LoadAcquire(cq_tail_);
+  uint32_t head = *cq_head_;
+  const IOURingCQE* cqes = static_cast<const IOURingCQE*>(cqes_);
+  for (; head != tail; ++head) {
+    const IOURingCQE& cqe = cqes[head & cq_mask_];
+    completions->push_back({cqe.user_data, cqe.res});
+  }
+  StoreRelease(cq_head_, head);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,113 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_IO_URING_LINUX_H_
+#define BASE_MESSAGE_LOOP_IO_URING_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+namespace internal {
+
+// A minimal wrapper around a Linux io_uring, as used by MessagePumpLibevent to
+// watch file descriptors. Operations are queued in user space and submitted
+// together by the next call to SubmitAndWait(), which also reaps completions,
+// so that a round of the message loop costs at most one system call no matter
+// how many file descriptors it starts or stops watching.
+//
+// Not thread safe.
+class BASE_EXPORT IOUring {
+ public:
+  struct Completion {
+    uint64_t user_data;
+    // The result of the operation: the poll events for a poll, or a negative
+    // errno value on failure.
+    int32_t result;
+  };
+
+  // Returns null if the kernel does not support io_uring, or lacks features
+  // which are needed (Linux 5.11 or later is required), or if io_uring is
+  // blocked, e.g. by a seccomp policy.
+  static std::unique_ptr<IOUring> Create(uint32_t entries);
+
+  ~IOUring();
+
+  // Queues a one-shot poll of |fd| for |events| (POLLIN, POLLOUT, ...). Its
+  // completion carries |user_data|.
+  void QueuePollAdd(int fd, uint32_t events, uint64_t user_data);
+
+  // Queues the cancelation of the poll with |target_user_data|. If the poll
+  // was not yet completed, it completes with -ECANCELED. The cancelation
+  // itself completes with |user_data|.
+  void QueuePollRemove(uint64_t target_user_data, uint64_t user_data);
+
+  // Submits the queued operations, then waits until at least one operation is
+  // completed or |timeout| expires, and appends the completions to
+  // |completions|. Does not wait if |timeout| is zero, or if there already are
+  // completions, and waits indefinitely if |timeout| is TimeDelta::Max().
+  // Without queued operations and without waiting, no system call is made.
+  void SubmitAndWait(TimeDelta timeout, std::vector<Completion>* completions);
+
+ private:
+  struct Operation {
+    uint8_t opcode;
+    int fd;
+    uint32_t poll_events;
+    uint64_t addr;
+    uint64_t user_data;
+  };
+
+  IOUring();
+
+  bool Init(uint32_t entries);
+
+  // Moves as many queued operations to the submission queue as fit, and
+  // returns the number of operations in it that the kernel did not consume.
+  uint32_t FillSubmissionQueue();
+
+  // Calls io_uring_enter(). Returns false on errors other than the transient
+  // ones.
+  bool Enter(uint32_t to_submit, TimeDelta timeout);
+
+  bool HasCompletions() const;
+  void ReapCompletions(std::vector<Completion>* completions);
+
+  int ring_fd_;
+
+  // The mapping of the submission and completion queue rings, and the
+  // submission queue entries.
+  void* rings_;
+  size_t rings_size_;
+  void* sqes_;
+  size_t sqes_size_;
+
+  // Pointers into |rings_|.
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t* sq_array_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t cq_mask_;
+  void* cqes_;
+
+  // Operations which were not moved to the submission queue yet.
+  std::vector<Operation> queued_operations_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOUring);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_IO_URING_LINUX_H_
@@ -8,11 +8,14 @@
 #include <memory>
 #include <utility>
 
+#include "base/base_switches.h"
 #include "base/bind.h"
+#include "base/command_line.h"
 #include "base/compiler_specific.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
+#include "base/memory/small_object_pool.h"
 #include "base/message_loop/message_pump_default.h"
 #include "base/metrics/histogram.h"
 #include "base/metrics/statistics_recorder.h"
@@ -43,6 +46,29 @@ namespace base {
 
 namespace {
 
+// A task posted with a delay, while it waits in the delayed work queue.
+class DelayedPendingTask : public TimingWheel::Entry,
+                           public SmallObjectPoolAllocated {
+ public:
+  explicit DelayedPendingTask(PendingTask pending_task)
+      : pending_task_(std::move(pending_task)) {}
+
+  // TimingWheel::Entry:
+  PendingTask TakeTask() override {
+    PendingTask pending_task = std::move(pending_task_);
+    delete this;
+    return pending_task;
+  }
+
+ private:
+  PendingTask pending_task_;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedPendingTask);
+};
+
+// With TIMER_SLACK_MAXIMUM, delayed work is aligned on multiples of this.
+const int64_t kMaximumTimerSlackMs = 4;
+
 // A lazily created thread local storage for quick access to a thread's message
 // loop, if one exists.  This should be safe and free of static constructors.
 LazyInstance<base::ThreadLocalPointer<MessageLoop> >::Leaky lazy_tls_ptr =
@@ -170,6 +196,10 @@ MessageLoop::~MessageLoop() {
   }
   DCHECK(!did_work);
 
+  // Timers started from now on post their tasks, which the incoming queue
+  // drops, rather than adding to delayed_work_queue_.
+  own_task_runner_ = nullptr;
+
   // Let interested parties have one last shot at accessing this.
   FOR_EACH_OBSERVER(DestructionObserver, destruction_observers_,
                     WillDestroyCurrentMessageLoop());
@@ -242,8 +272,17 @@ std::unique_ptr<MessagePump> MessageLoop::CreateMessagePumpForType(Type type) {
       return message_pump_for_ui_factory_();
     return MESSAGE_PUMP_UI;
   }
-  if (type == MessageLoop::TYPE_IO)
+  if (type == MessageLoop::TYPE_IO) {
+#if defined(OS_LINUX)
+    if (CommandLine::InitializedForCurrentProcess() &&
+        CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kEnableIOUringMessagePump)) {
+      return std::unique_ptr<MessagePump>(
+          new MessagePumpLibevent(MessagePumpLibevent::Backend::IO_URING));
+    }
+#endif
     return std::unique_ptr<MessagePump>(new MessagePumpForIO());
+  }
 
 #if defined(OS_ANDROID)
   if (type == MessageLoop::TYPE_JAVA)
@@ -391,6 +430,7 @@ MessageLoop::MessageLoop(Type type, MessagePumpFactoryCallback pump_factory)
       pending_high_res_tasks_(0),
       in_high_res_mode_(false),
 #endif
+      timer_slack_(TIMER_SLACK_NONE),
       nestable_tasks_allowed_(true),
       pump_factory_(pump_factory),
       message_histogram_(NULL),
@@ -399,6 +439,7 @@ MessageLoop::MessageLoop(Type type, MessagePumpFactoryCallback pump_factory)
       unbound_task_runner_(
           new internal::MessageLoopTaskRunner(incoming_task_queue_)),
       task_runner_(unbound_task_runner_),
+      own_task_runner_(unbound_task_runner_),
       thread_id_(kInvalidThreadId) {
   // If type is TYPE_CUSTOM non-null pump_factory must be given.
   DCHECK(type_ != TYPE_CUSTOM || !pump_factory_.is_null());
@@ -445,6 +486,17 @@ void MessageLoop::SetTaskRunner(
   SetThreadTaskRunnerHandle();
 }
 
+bool MessageLoop::ScheduleDelayedWorkEntry(TimingWheel::Entry* entry,
+                                           TimeTicks run_time) {
+  DCHECK_EQ(this, current());
+  if (task_runner_ != own_task_runner_ || !ThreadTaskRunnerHandle::IsSet() ||
+      ThreadTaskRunnerHandle::Get() != task_runner_) {
+    return false;
+  }
+  AddToDelayedWorkQueue(entry, run_time);
+  return true;
+}
+
 void MessageLoop::SetThreadTaskRunnerHandle() {
   DCHECK_EQ(this, current());
   // Clear the previous thread task runner first, because only one can exist at
@@ -514,9 +566,29 @@ bool MessageLoop::DeferOrRunPendingTask(PendingTask pending_task) {
   return false;
 }
 
-void MessageLoop::AddToDelayedWorkQueue(PendingTask pending_task) {
-  // Move to the delayed work queue.
-  delayed_work_queue_.push(std::move(pending_task));
+void MessageLoop::AddToDelayedWorkQueue(TimingWheel::Entry* entry,
+                                        TimeTicks run_time) {
+  TimeTicks next_run_time = delayed_work_queue_.NextRunTime();
+  delayed_work_queue_.Schedule(entry, run_time);
+  // If we changed the topmost task, then it is time to reschedule.
+  if (next_run_time.is_null() || run_time < next_run_time)
+    pump_->ScheduleDelayedWork(GetNextDelayedWorkTime());
+}
+
+TimeTicks MessageLoop::GetNextDelayedWorkTime() const {
+  TimeTicks next_run_time = delayed_work_queue_.NextRunTime();
+  if (timer_slack_ == TIMER_SLACK_NONE || next_run_time.is_null() ||
+      next_run_time.is_max()) {
+    return next_run_time;
+  }
+  // Round up to the next multiple of the slack, so that the tasks which are
+  // due within the same interval run together.
+  const int64_t slack =
+      kMaximumTimerSlackMs * Time::kMicrosecondsPerMillisecond;
+  const int64_t remainder = next_run_time.ToInternalValue() % slack;
+  if (!remainder)
+    return next_run_time;
+  return next_run_time + TimeDelta::FromInternalValue(slack - remainder);
 }
 
 bool MessageLoop::DeletePendingTasks() {
@@ -528,7 +600,9 @@ bool MessageLoop::DeletePendingTasks() {
       // We want to delete delayed tasks in the same order in which they would
       // normally be deleted in case of any funny dependencies between delayed
       // tasks.
-      AddToDelayedWorkQueue(std::move(pending_task));
+      TimeTicks delayed_run_time = pending_task.delayed_run_time;
+      delayed_work_queue_.Schedule(
+          new DelayedPendingTask(std::move(pending_task)), delayed_run_time);
     }
   }
   did_work |= !deferred_non_nestable_work_queue_.empty();
@@ -542,8 +616,9 @@ bool MessageLoop::DeletePendingTasks() {
   // code is replicating legacy behavior, and should not be considered
   // absolutely "correct" behavior.  See TODO above about deleting all tasks
   // when it's safe.
-  while (!delayed_work_queue_.empty()) {
-    delayed_work_queue_.pop();
+  while (TimingWheel::Entry* entry =
+             delayed_work_queue_.TakeDueEntry(TimeTicks::Max())) {
+    entry->TakeTask();
   }
   return did_work;
 }
@@ -619,12 +694,9 @@ bool MessageLoop::DoWork() {
       PendingTask pending_task = std::move(work_queue_.front());
       work_queue_.pop();
       if (!pending_task.delayed_run_time.is_null()) {
-        int sequence_num = pending_task.sequence_num;
         TimeTicks delayed_run_time = pending_task.delayed_run_time;
-        AddToDelayedWorkQueue(std::move(pending_task));
-        // If we changed the topmost task, then it is time to reschedule.
-        if (delayed_work_queue_.top().sequence_num == sequence_num)
-          pump_->ScheduleDelayedWork(delayed_run_time);
+        AddToDelayedWorkQueue(new DelayedPendingTask(std::move(pending_task)),
+                              delayed_run_time);
       } else {
         if (DeferOrRunPendingTask(std::move(pending_task)))
           return true;
@@ -649,23 +721,28 @@ bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
   // fall behind (and have a lot of ready-to-run delayed tasks), the more
   // efficient we'll be at handling the tasks.
 
-  TimeTicks next_run_time = delayed_work_queue_.top().delayed_run_time;
+  TimeTicks next_run_time = delayed_work_queue_.NextRunTime();
   if (next_run_time > recent_time_) {
     recent_time_ = TimeTicks::Now();  // Get a better view of Now();
     if (next_run_time > recent_time_) {
-      *next_delayed_work_time = next_run_time;
+      *next_delayed_work_time = GetNextDelayedWorkTime();
       return false;
     }
   }
 
-  PendingTask pending_task =
-      std::move(const_cast<PendingTask&>(delayed_work_queue_.top()));
-  delayed_work_queue_.pop();
+  // |next_run_time| may only be the start of the slot of the wheel which
+  // holds the next task, in which case the wheel only moves the task to a
+  // finer slot.
+  TimingWheel::Entry* entry = delayed_work_queue_.TakeDueEntry(recent_time_);
+  if (!entry) {
+    *next_delayed_work_time = GetNextDelayedWorkTime();
+    return false;
+  }
 
   if (!delayed_work_queue_.empty())
-    *next_delayed_work_time = delayed_work_queue_.top().delayed_run_time;
+    *next_delayed_work_time = GetNextDelayedWorkTime();
 
-  return DeferOrRunPendingTask(std::move(pending_task));
+  return DeferOrRunPendingTask(entry->TakeTask());
 }
 
 bool MessageLoop::DoIdleWork() {
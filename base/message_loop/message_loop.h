@@ -20,6 +20,7 @@
 #include "base/message_loop/message_loop_task_runner.h"
 #include "base/message_loop/message_pump.h"
 #include "base/message_loop/timer_slack.h"
+#include "base/message_loop/timing_wheel.h"
 #include "base/observer_list.h"
 #include "base/pending_task.h"
 #include "base/sequenced_task_runner_helpers.h"
@@ -289,8 +290,11 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   // arbitrary MessageLoop to QuitWhenIdle.
   static Closure QuitWhenIdleClosure();
 
-  // Set the timer slack for this message loop.
+  // Set the timer slack for this message loop. With TIMER_SLACK_MAXIMUM, the
+  // delayed tasks which are due within a few milliseconds of each other run
+  // in a single wake-up.
   void SetTimerSlack(TimerSlack timer_slack) {
+    timer_slack_ = timer_slack;
     pump_->SetTimerSlack(timer_slack);
   }
 
@@ -318,6 +322,15 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   // thread to which the message loop is bound.
   void SetTaskRunner(scoped_refptr<SingleThreadTaskRunner> task_runner);
 
+  // Schedules |entry| to run at |run_time| in the queue of delayed tasks,
+  // where it can be canceled or rescheduled in constant time, rather than
+  // abandoned in the queue like a posted task. Returns false, without
+  // scheduling |entry|, if the tasks of this thread are not run by this loop's
+  // own task runner (e.g. it was replaced by a mock time task runner), in
+  // which case a delayed task should be posted instead. Used by base::Timer.
+  // Must be called on the thread to which the message loop is bound.
+  bool ScheduleDelayedWorkEntry(TimingWheel::Entry* entry, TimeTicks run_time);
+
   // Enables or disables the recursive task processing. This happens in the case
   // of recursive message loops. Some unwanted message loops may occur when
   // using common controls or printer functions. By default, recursive task
@@ -462,8 +475,13 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   // cannot be run right now.  Returns true if the task was run.
   bool DeferOrRunPendingTask(PendingTask pending_task);
 
-  // Adds the pending task to delayed_work_queue_.
-  void AddToDelayedWorkQueue(PendingTask pending_task);
+  // Schedules |entry| in delayed_work_queue_, and the pump's delayed work if
+  // the entry runs before the delayed tasks which were already queued.
+  void AddToDelayedWorkQueue(TimingWheel::Entry* entry, TimeTicks run_time);
+
+  // Returns when the pump should call DoDelayedWork() next, given the timer
+  // slack, or a null TimeTicks if there is no delayed work.
+  TimeTicks GetNextDelayedWorkTime() const;
 
   // Delete tasks that haven't run yet without running them.  Used in the
   // destructor to make sure all the task's destructors get called.  Returns
@@ -511,8 +529,11 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   bool in_high_res_mode_;
 #endif
 
-  // Contains delayed tasks, sorted by their 'delayed_run_time' property.
-  DelayedTaskQueue delayed_work_queue_;
+  // Contains delayed tasks, and base::Timers scheduled through
+  // ScheduleDelayedWorkEntry(), sorted by their run time.
+  TimingWheel delayed_work_queue_;
+
+  TimerSlack timer_slack_;
 
   // A recent snapshot of Time::Now(), used to check delayed_work_queue_.
   TimeTicks recent_time_;
@@ -550,6 +571,8 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
 
   // The task runner associated with this message loop.
   scoped_refptr<SingleThreadTaskRunner> task_runner_;
+  // The task runner created with the loop, which |task_runner_| may replace.
+  scoped_refptr<SingleThreadTaskRunner> own_task_runner_;
   std::unique_ptr<ThreadTaskRunnerHandle> thread_task_runner_handle_;
 
   // Id of the thread this message loop is bound to.
@@ -12,6 +12,7 @@
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/macros.h"
+#include "base/memory/ptr_util.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_loop_test.h"
@@ -849,6 +850,52 @@ TEST(MessageLoopTest, ThreadMainTaskRunner) {
   EXPECT_EQ(foo->result(), "a");
 }
 
+namespace {
+
+void RecordTaskIndex(std::vector<int>* task_indexes, int task_index) {
+  task_indexes->push_back(task_index);
+}
+
+void PostNumberedTasks(scoped_refptr<SingleThreadTaskRunner> task_runner,
+                       std::vector<int>* task_indexes,
+                       int num_tasks) {
+  for (int i = 0; i < num_tasks; ++i) {
+    task_runner->PostTask(FROM_HERE,
+                          Bind(&RecordTaskIndex, Unretained(task_indexes), i));
+  }
+}
+
+}  // namespace
+
+// Verify that tasks posted concurrently from multiple threads all run, in the
+// order in which each thread posted them.
+TEST(MessageLoopTest, PostTasksFromMultipleThreads) {
+  const int kNumPostingThreads = 4;
+  const int kNumTasksPerThread = 1000;
+
+  MessageLoop loop;
+  std::vector<int> task_indexes[kNumPostingThreads];
+  std::vector<std::unique_ptr<Thread>> posting_threads;
+  for (int i = 0; i < kNumPostingThreads; ++i) {
+    posting_threads.push_back(WrapUnique(new Thread("PostingThread")));
+    ASSERT_TRUE(posting_threads.back()->Start());
+    posting_threads.back()->task_runner()->PostTask(
+        FROM_HERE, Bind(&PostNumberedTasks, loop.task_runner(),
+                        Unretained(&task_indexes[i]), kNumTasksPerThread));
+  }
+  for (const auto& posting_thread : posting_threads)
+    posting_thread->Stop();
+
+  RunLoop().RunUntilIdle();
+
+  for (int i = 0; i < kNumPostingThreads; ++i) {
+    ASSERT_EQ(static_cast<size_t>(kNumTasksPerThread),
+              task_indexes[i].size());
+    for (int j = 0; j < kNumTasksPerThread; ++j)
+      EXPECT_EQ(j, task_indexes[i][j]);
+  }
+}
+
 TEST(MessageLoopTest, IsType) {
   MessageLoop loop(MessageLoop::TYPE_UI);
   EXPECT_TRUE(loop.IsType(MessageLoop::TYPE_UI));
@@ -8,6 +8,7 @@
 #include <unistd.h>
 
 #include <memory>
+#include <vector>
 
 #include "base/auto_reset.h"
 #include "base/compiler_specific.h"
@@ -23,6 +24,12 @@
 #include "base/mac/scoped_nsautorelease_pool.h"
 #endif
 
+#if defined(OS_LINUX)
+#include <poll.h>
+
+#include "base/message_loop/io_uring_linux.h"
+#endif
+
 // Lifecycle of struct event
 // Libevent uses two main data structures:
 // struct event_base (of which there is one per message pump), and
@@ -43,8 +50,29 @@
 
 namespace base {
 
+#if defined(OS_LINUX)
+namespace {
+
+// Large enough that a round of the message loop rarely submits its changes in
+// more than one batch.
+const uint32_t kIOUringEntries = 256;
+
+// The user data of the completions of poll removals, which are ignored, and of
+// the poll of the wakeup pipe. Watched FDs get IDs above these.
+const uint64_t kIOUringIgnoredId = 0;
+const uint64_t kIOUringWakeupId = 1;
+
+}  // namespace
+#endif
+
 MessagePumpLibevent::FileDescriptorWatcher::FileDescriptorWatcher()
     : event_(NULL),
+#if defined(OS_LINUX)
+      io_uring_fd_(-1),
+      io_uring_events_(0),
+      io_uring_persistent_(false),
+      io_uring_poll_id_(0),
+#endif
       pump_(NULL),
       watcher_(NULL),
       was_destroyed_(NULL) {
@@ -54,6 +82,10 @@ MessagePumpLibevent::FileDescriptorWatcher::~FileDescriptorWatcher() {
   if (event_) {
     StopWatchingFileDescriptor();
   }
+#if defined(OS_LINUX)
+  if (io_uring_fd_ >= 0)
+    StopWatchingFileDescriptor();
+#endif
   if (was_destroyed_) {
     DCHECK(!*was_destroyed_);
     *was_destroyed_ = true;
@@ -61,6 +93,20 @@ MessagePumpLibevent::FileDescriptorWatcher::~FileDescriptorWatcher() {
 }
 
 bool MessagePumpLibevent::FileDescriptorWatcher::StopWatchingFileDescriptor() {
+#if defined(OS_LINUX)
+  if (io_uring_fd_ >= 0) {
+    if (io_uring_poll_id_)
+      pump_->CancelIOUringPoll(io_uring_poll_id_);
+    io_uring_fd_ = -1;
+    io_uring_events_ = 0;
+    io_uring_persistent_ = false;
+    io_uring_poll_id_ = 0;
+    pump_ = NULL;
+    watcher_ = NULL;
+    return true;
+  }
+#endif
+
   event* e = ReleaseEvent();
   if (e == NULL)
     return true;
@@ -102,21 +148,42 @@ void MessagePumpLibevent::FileDescriptorWatcher::OnFileCanWriteWithoutBlocking(
 }
 
 MessagePumpLibevent::MessagePumpLibevent()
+    : MessagePumpLibevent(Backend::LIBEVENT) {}
+
+MessagePumpLibevent::MessagePumpLibevent(Backend backend)
     : keep_running_(true),
       in_run_(false),
       processed_io_events_(false),
-      event_base_(event_base_new()),
+      event_base_(NULL),
       wakeup_pipe_in_(-1),
-      wakeup_pipe_out_(-1) {
+      wakeup_pipe_out_(-1),
+      wakeup_event_(NULL) {
+#if defined(OS_LINUX)
+  next_io_uring_poll_id_ = kIOUringWakeupId + 1;
+  if (backend == Backend::IO_URING) {
+    io_uring_ = internal::IOUring::Create(kIOUringEntries);
+    DVLOG_IF(1, !io_uring_) << "io_uring unavailable, using libevent";
+  }
+#endif
+  if (this->backend() == Backend::LIBEVENT)
+    event_base_ = event_base_new();
   if (!Init())
      NOTREACHED();
 }
 
 MessagePumpLibevent::~MessagePumpLibevent() {
-  DCHECK(wakeup_event_);
-  DCHECK(event_base_);
-  event_del(wakeup_event_);
-  delete wakeup_event_;
+#if defined(OS_LINUX)
+  // Controllers which outlive the pump must not cancel their polls through it
+  // when they stop watching.
+  for (const auto& poll : io_uring_polls_)
+    poll.second->io_uring_poll_id_ = 0;
+#endif
+  if (backend() == Backend::LIBEVENT) {
+    DCHECK(wakeup_event_);
+    DCHECK(event_base_);
+    event_del(wakeup_event_);
+    delete wakeup_event_;
+  }
   if (wakeup_pipe_in_ >= 0) {
     if (IGNORE_EINTR(close(wakeup_pipe_in_)) < 0)
       DPLOG(ERROR) << "close";
@@ -125,7 +192,25 @@ MessagePumpLibevent::~MessagePumpLibevent() {
     if (IGNORE_EINTR(close(wakeup_pipe_out_)) < 0)
       DPLOG(ERROR) << "close";
   }
-  event_base_free(event_base_);
+  if (event_base_)
+    event_base_free(event_base_);
+}
+
+// static
+bool MessagePumpLibevent::IsIOUringSupported() {
+#if defined(OS_LINUX)
+  return !!internal::IOUring::Create(1);
+#else
+  return false;
+#endif
+}
+
+MessagePumpLibevent::Backend MessagePumpLibevent::backend() const {
+#if defined(OS_LINUX)
+  if (io_uring_)
+    return Backend::IO_URING;
+#endif
+  return Backend::LIBEVENT;
 }
 
 bool MessagePumpLibevent::WatchFileDescriptor(int fd,
@@ -141,6 +226,13 @@ bool MessagePumpLibevent::WatchFileDescriptor(int fd,
   // threadsafe, and your watcher may never be registered.
   DCHECK(watch_file_descriptor_caller_checker_.CalledOnValidThread());
 
+#if defined(OS_LINUX)
+  if (io_uring_) {
+    return WatchFileDescriptorWithIOUring(fd, persistent, mode, controller,
+                                          delegate);
+  }
+#endif
+
   int event_mask = persistent ? EV_PERSIST : 0;
   if (mode & WATCH_READ) {
     event_mask |= EV_READ;
@@ -202,6 +294,13 @@ static void timer_callback(int fd, short events, void *context)
 
 // Reentrant!
 void MessagePumpLibevent::Run(Delegate* delegate) {
+#if defined(OS_LINUX)
+  if (io_uring_) {
+    RunWithIOUring(delegate);
+    return;
+  }
+#endif
+
   AutoReset<bool> auto_reset_keep_running(&keep_running_, true);
   AutoReset<bool> auto_reset_in_run(&in_run_, true);
 
@@ -305,6 +404,13 @@ bool MessagePumpLibevent::Init() {
   wakeup_pipe_out_ = fds[0];
   wakeup_pipe_in_ = fds[1];
 
+#if defined(OS_LINUX)
+  if (io_uring_) {
+    io_uring_->QueuePollAdd(wakeup_pipe_out_, POLLIN, kIOUringWakeupId);
+    return true;
+  }
+#endif
+
   wakeup_event_ = new event;
   event_set(wakeup_event_, wakeup_pipe_out_, EV_READ | EV_PERSIST,
             OnWakeup, this);
@@ -324,11 +430,19 @@ void MessagePumpLibevent::OnLibeventNotification(int fd,
   DCHECK(controller);
   TRACE_EVENT1("toplevel", "MessagePumpLibevent::OnLibeventNotification",
                "fd", fd);
+  NotifyWatcher(controller, fd, (flags & EV_READ) != 0,
+                (flags & EV_WRITE) != 0);
+}
 
+// static
+void MessagePumpLibevent::NotifyWatcher(FileDescriptorWatcher* controller,
+                                        int fd,
+                                        bool can_read,
+                                        bool can_write) {
   MessagePumpLibevent* pump = controller->pump();
   pump->processed_io_events_ = true;
 
-  if ((flags & (EV_READ | EV_WRITE)) == (EV_READ | EV_WRITE)) {
+  if (can_read && can_write) {
     // Both callbacks will be called. It is necessary to check that |controller|
     // is not destroyed.
     bool controller_was_destroyed = false;
@@ -338,9 +452,9 @@ void MessagePumpLibevent::OnLibeventNotification(int fd,
       controller->OnFileCanReadWithoutBlocking(fd, pump);
     if (!controller_was_destroyed)
       controller->was_destroyed_ = nullptr;
-  } else if (flags & EV_WRITE) {
+  } else if (can_write) {
     controller->OnFileCanWriteWithoutBlocking(fd, pump);
-  } else if (flags & EV_READ) {
+  } else if (can_read) {
     controller->OnFileCanReadWithoutBlocking(fd, pump);
   }
 }
@@ -360,4 +474,152 @@ void MessagePumpLibevent::OnWakeup(int socket, short flags, void* context) {
   event_base_loopbreak(that->event_base_);
 }
 
+#if defined(OS_LINUX)
+bool MessagePumpLibevent::WatchFileDescriptorWithIOUring(
+    int fd,
+    bool persistent,
+    int mode,
+    FileDescriptorWatcher* controller,
+    Watcher* delegate) {
+  uint32_t events = 0;
+  if (mode & WATCH_READ)
+    events |= POLLIN;
+  if (mode & WATCH_WRITE)
+    events |= POLLOUT;
+
+  if (controller->io_uring_fd_ >= 0) {
+    // It's illegal to use this function to listen on 2 separate fds with the
+    // same |controller|.
+    if (controller->io_uring_fd_ != fd) {
+      NOTREACHED() << "FDs don't match" << controller->io_uring_fd_
+                   << "!=" << fd;
+      return false;
+    }
+    // Combine the old and new interests, like libevent does.
+    events |= controller->io_uring_events_;
+    persistent |= controller->io_uring_persistent_;
+    if (controller->io_uring_poll_id_)
+      CancelIOUringPoll(controller->io_uring_poll_id_);
+  }
+
+  controller->io_uring_fd_ = fd;
+  controller->io_uring_events_ = events;
+  controller->io_uring_persistent_ = persistent;
+  ArmIOUringPoll(controller);
+
+  controller->set_watcher(delegate);
+  controller->set_pump(this);
+  return true;
+}
+
+void MessagePumpLibevent::RunWithIOUring(Delegate* delegate) {
+  AutoReset<bool> auto_reset_keep_running(&keep_running_, true);
+  AutoReset<bool> auto_reset_in_run(&in_run_, true);
+
+  for (;;) {
+    bool did_work = delegate->DoWork();
+    if (!keep_running_)
+      break;
+
+    // Submits the changes made by the tasks, but only makes a system call if
+    // there are any.
+    ProcessIOUringEvents(TimeDelta());
+    did_work |= processed_io_events_;
+    processed_io_events_ = false;
+    if (!keep_running_)
+      break;
+
+    did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    did_work = delegate->DoIdleWork();
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    if (delayed_work_time_.is_null()) {
+      ProcessIOUringEvents(TimeDelta::Max());
+    } else {
+      TimeDelta delay = delayed_work_time_ - TimeTicks::Now();
+      if (delay > TimeDelta()) {
+        ProcessIOUringEvents(delay);
+      } else {
+        // It looks like delayed_work_time_ indicates a time in the past, so we
+        // need to call DoDelayedWork now.
+        delayed_work_time_ = TimeTicks();
+      }
+    }
+
+    if (!keep_running_)
+      break;
+  }
+}
+
+void MessagePumpLibevent::ArmIOUringPoll(FileDescriptorWatcher* controller) {
+  const uint64_t poll_id = next_io_uring_poll_id_++;
+  io_uring_->QueuePollAdd(controller->io_uring_fd_,
+                          controller->io_uring_events_, poll_id);
+  io_uring_polls_[poll_id] = controller;
+  controller->io_uring_poll_id_ = poll_id;
+}
+
+void MessagePumpLibevent::CancelIOUringPoll(uint64_t poll_id) {
+  io_uring_polls_.erase(poll_id);
+  io_uring_->QueuePollRemove(poll_id, kIOUringIgnoredId);
+}
+
+void MessagePumpLibevent::ProcessIOUringEvents(TimeDelta timeout) {
+  std::vector<internal::IOUring::Completion> completions;
+  io_uring_->SubmitAndWait(timeout, &completions);
+
+  for (const internal::IOUring::Completion& completion : completions) {
+    if (completion.user_data == kIOUringWakeupId) {
+      // Remove and discard the wakeup bytes, and poll for the next ones.
+      char buf[64];
+      ignore_result(HANDLE_EINTR(read(wakeup_pipe_out_, buf, sizeof(buf))));
+      io_uring_->QueuePollAdd(wakeup_pipe_out_, POLLIN, kIOUringWakeupId);
+      processed_io_events_ = true;
+      continue;
+    }
+
+    // Polls which were canceled, or replaced by a new one after the
+    // controller changed what it watches, are no longer in the map. Earlier
+    // callbacks of this batch may have done so.
+    auto it = io_uring_polls_.find(completion.user_data);
+    if (it == io_uring_polls_.end())
+      continue;
+    FileDescriptorWatcher* controller = it->second;
+    io_uring_polls_.erase(it);
+    controller->io_uring_poll_id_ = 0;
+
+    const int fd = controller->io_uring_fd_;
+    TRACE_EVENT1("toplevel", "MessagePumpLibevent::OnIOUringEvent", "fd", fd);
+
+    // A failed poll is reported like an error on the FD, so that the watcher
+    // finds out when it reads or writes.
+    const uint32_t revents = completion.result < 0 ? POLLERR
+                                                   : completion.result;
+    const uint32_t events = controller->io_uring_events_;
+    const uint32_t kErrorEvents = POLLHUP | POLLERR | POLLNVAL;
+    const bool can_read =
+        (events & POLLIN) && (revents & (POLLIN | kErrorEvents));
+    const bool can_write =
+        (events & POLLOUT) && (revents & (POLLOUT | kErrorEvents));
+
+    // Polls fire once, so persistent ones are armed again. The new poll is
+    // submitted before any cancelation by the callbacks below.
+    if (controller->io_uring_persistent_ && completion.result >= 0)
+      ArmIOUringPoll(controller);
+
+    NotifyWatcher(controller, fd, can_read, can_write);
+  }
+}
+#endif  // defined(OS_LINUX)
+
 }  // namespace base
@@ -5,11 +5,17 @@
 #ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_LIBEVENT_H_
 #define BASE_MESSAGE_LOOP_MESSAGE_PUMP_LIBEVENT_H_
 
+#include <stdint.h>
+
+#include <memory>
+
 #include "base/compiler_specific.h"
+#include "base/containers/hash_tables.h"
 #include "base/macros.h"
 #include "base/message_loop/message_pump.h"
 #include "base/threading/thread_checker.h"
 #include "base/time/time.h"
+#include "build/build_config.h"
 
 // Declare structs we need from libevent.h rather than including it
 struct event_base;
@@ -17,6 +23,12 @@ struct event;
 
 namespace base {
 
+#if defined(OS_LINUX)
+namespace internal {
+class IOUring;
+}  // namespace internal
+#endif
+
 // Class to monitor sockets and issue callbacks when sockets are ready for I/O
 // TODO(dkegel): add support for background file IO somehow
 class BASE_EXPORT MessagePumpLibevent : public MessagePump {
@@ -67,6 +79,15 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump {
     void OnFileCanWriteWithoutBlocking(int fd, MessagePumpLibevent* pump);
 
     event* event_;
+#if defined(OS_LINUX)
+    // Used instead of |event_| when the pump uses io_uring. |io_uring_fd_| is
+    // -1 unless an FD is watched, and |io_uring_poll_id_| is 0 unless a poll
+    // is armed, which is not the case after a non-persistent poll fired.
+    int io_uring_fd_;
+    uint32_t io_uring_events_;
+    bool io_uring_persistent_;
+    uint64_t io_uring_poll_id_;
+#endif
     MessagePumpLibevent* pump_;
     Watcher* watcher_;
     // If this pointer is non-NULL, the pointee is set to true in the
@@ -82,9 +103,28 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump {
     WATCH_READ_WRITE = WATCH_READ | WATCH_WRITE
   };
 
+  // The mechanism used to wait for I/O readiness.
+  enum class Backend {
+    LIBEVENT,
+    // Polls FDs through an io_uring (Linux only). The changes to the watched
+    // FDs made in a round of the message loop are submitted together with the
+    // wait for events, in a single system call. This saves an epoll_ctl() for
+    // every FD that is watched, which adds up on threads like the network IO
+    // thread that watch an FD again after every read or write that would
+    // block.
+    IO_URING,
+  };
+
   MessagePumpLibevent();
+  // Uses |backend| if the system supports it, and libevent otherwise.
+  explicit MessagePumpLibevent(Backend backend);
   ~MessagePumpLibevent() override;
 
+  // Returns whether the system supports the IO_URING backend.
+  static bool IsIOUringSupported();
+
+  Backend backend() const;
+
   // Have the current thread's message loop watch for a a situation in which
   // reading/writing to the FD can be performed without blocking.
   // Callers must provide a preallocated FileDescriptorWatcher object which
@@ -122,6 +162,33 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump {
   static void OnLibeventNotification(int fd, short flags,
                                      void* context);
 
+  // Calls the watcher of |controller| for the directions that are ready.
+  static void NotifyWatcher(FileDescriptorWatcher* controller,
+                            int fd,
+                            bool can_read,
+                            bool can_write);
+
+#if defined(OS_LINUX)
+  // Counterparts of WatchFileDescriptor() and Run() for the IO_URING
+  // backend.
+  bool WatchFileDescriptorWithIOUring(int fd,
+                                      bool persistent,
+                                      int mode,
+                                      FileDescriptorWatcher* controller,
+                                      Watcher* delegate);
+  void RunWithIOUring(Delegate* delegate);
+
+  // Arms a poll for |controller| as configured by its io_uring_* members.
+  void ArmIOUringPoll(FileDescriptorWatcher* controller);
+
+  // Disarms the poll with |poll_id|, if it did not fire yet.
+  void CancelIOUringPoll(uint64_t poll_id);
+
+  // Submits the pending changes, waits up to |timeout| for events and
+  // dispatches them.
+  void ProcessIOUringEvents(TimeDelta timeout);
+#endif
+
   // Unix pipe used to implement ScheduleWork()
   // ... callback; called by libevent inside Run() when pipe is ready to read
   static void OnWakeup(int socket, short flags, void* context);
@@ -149,6 +216,17 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump {
   // ... libevent wrapper for read end
   event* wakeup_event_;
 
+#if defined(OS_LINUX)
+  // Replaces |event_base_| with the IO_URING backend.
+  std::unique_ptr<internal::IOUring> io_uring_;
+
+  // The controllers of the armed polls, by poll ID. A poll's completion is
+  // ignored if its ID is no longer in the map. IDs are never reused, since
+  // completions may arrive after a controller stopped watching.
+  hash_map<uint64_t, FileDescriptorWatcher*> io_uring_polls_;
+  uint64_t next_io_uring_poll_id_;
+#endif
+
   ThreadChecker watch_file_descriptor_caller_checker_;
   DISALLOW_COPY_AND_ASSIGN(MessagePumpLibevent);
 };
@@ -4,6 +4,7 @@
 
 #include "base/message_loop/message_pump_libevent.h"
 
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <memory>
@@ -21,6 +22,7 @@
 #include "base/test/gtest_util.h"
 #include "base/third_party/libevent/event.h"
 #include "base/threading/thread.h"
+#include "base/time/time.h"
 #include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -280,6 +282,174 @@ TEST_F(MessagePumpLibeventTest, QuitWatcher) {
       Bind(&WaitableEventWatcher::StopWatching, Owned(watcher.release())));
 }
 
+// The tests below run a MessageLoop on a pump which was asked for the
+// IO_URING backend, so they exercise io_uring where the kernel supports it and
+// libevent elsewhere.
+class MessagePumpLibeventIOUringTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    pump_ = new MessagePumpLibevent(MessagePumpLibevent::Backend::IO_URING);
+    loop_.reset(new MessageLoop(WrapUnique(pump_)));
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_));
+  }
+
+  void TearDown() override {
+    loop_.reset();
+    if (IGNORE_EINTR(close(sockets_[0])) < 0)
+      PLOG(ERROR) << "close";
+    if (IGNORE_EINTR(close(sockets_[1])) < 0)
+      PLOG(ERROR) << "close";
+  }
+
+  void WriteBytes(int count) {
+    for (int i = 0; i < count; ++i)
+      ASSERT_TRUE(WriteFileDescriptor(sockets_[1], "x", 1));
+  }
+
+  MessagePumpLibevent* pump_;  // Owned by |loop_|.
+  std::unique_ptr<MessageLoop> loop_;
+  int sockets_[2];
+};
+
+// Reads one byte whenever the FD is readable, and quits after |quit_after|
+// reads.
+class ReadingWatcher : public MessagePumpLibevent::Watcher {
+ public:
+  ReadingWatcher(int quit_after, const Closure& quit_closure)
+      : reads_(0), quit_after_(quit_after), quit_closure_(quit_closure) {}
+  ~ReadingWatcher() override {}
+
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    char buf;
+    ASSERT_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    if (++reads_ == quit_after_)
+      quit_closure_.Run();
+  }
+
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+
+  int reads() const { return reads_; }
+
+ private:
+  int reads_;
+  const int quit_after_;
+  const Closure quit_closure_;
+};
+
+TEST_F(MessagePumpLibeventIOUringTest, Backend) {
+  EXPECT_EQ(MessagePumpLibevent::IsIOUringSupported(),
+            pump_->backend() == MessagePumpLibevent::Backend::IO_URING);
+  EXPECT_EQ(MessagePumpLibevent::Backend::LIBEVENT,
+            MessagePumpLibevent().backend());
+}
+
+TEST_F(MessagePumpLibeventIOUringTest, WatchOnce) {
+  RunLoop run_loop;
+  ReadingWatcher delegate(1, run_loop.QuitClosure());
+  MessagePumpLibevent::FileDescriptorWatcher controller;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[0], false,
+                                         MessagePumpLibevent::WATCH_READ,
+                                         &controller, &delegate));
+  WriteBytes(2);
+  run_loop.Run();
+
+  // The watch ended after the first notification.
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, delegate.reads());
+}
+
+TEST_F(MessagePumpLibeventIOUringTest, WatchPersistently) {
+  RunLoop run_loop;
+  ReadingWatcher delegate(3, run_loop.QuitClosure());
+  MessagePumpLibevent::FileDescriptorWatcher controller;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[0], true,
+                                         MessagePumpLibevent::WATCH_READ,
+                                         &controller, &delegate));
+  WriteBytes(3);
+  run_loop.Run();
+  EXPECT_EQ(3, delegate.reads());
+}
+
+TEST_F(MessagePumpLibeventIOUringTest, StopWatching) {
+  ReadingWatcher delegate(1, Closure());
+  MessagePumpLibevent::FileDescriptorWatcher controller;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[0], true,
+                                         MessagePumpLibevent::WATCH_READ,
+                                         &controller, &delegate));
+  WriteBytes(1);
+  EXPECT_TRUE(controller.StopWatchingFileDescriptor());
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, delegate.reads());
+}
+
+// Waiting for I/O must not delay delayed tasks.
+TEST_F(MessagePumpLibeventIOUringTest, DelayedTask) {
+  ReadingWatcher delegate(1, Closure());
+  MessagePumpLibevent::FileDescriptorWatcher controller;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[0], false,
+                                         MessagePumpLibevent::WATCH_READ,
+                                         &controller, &delegate));
+  RunLoop run_loop;
+  const TimeDelta kDelay = TimeDelta::FromMilliseconds(20);
+  const TimeTicks start = TimeTicks::Now();
+  loop_->task_runner()->PostDelayedTask(FROM_HERE, run_loop.QuitClosure(),
+                                        kDelay);
+  run_loop.Run();
+  EXPECT_GE(TimeTicks::Now() - start, kDelay);
+  EXPECT_EQ(0, delegate.reads());
+}
+
+// Deletes the controller when the FD is writable, so that the read callback of
+// the same event must not run.
+class DeleteOnWriteWatcher : public MessagePumpLibevent::Watcher {
+ public:
+  DeleteOnWriteWatcher(MessagePumpLibevent::FileDescriptorWatcher* controller,
+                       const Closure& quit_closure)
+      : controller_(controller), quit_closure_(quit_closure) {}
+  ~DeleteOnWriteWatcher() override {}
+
+  void OnFileCanReadWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override {
+    delete controller_;
+    controller_ = nullptr;
+    quit_closure_.Run();
+  }
+
+ private:
+  MessagePumpLibevent::FileDescriptorWatcher* controller_;
+  const Closure quit_closure_;
+};
+
+TEST_F(MessagePumpLibeventIOUringTest, DeleteControllerInCallback) {
+  RunLoop run_loop;
+  MessagePumpLibevent::FileDescriptorWatcher* controller =
+      new MessagePumpLibevent::FileDescriptorWatcher;
+  DeleteOnWriteWatcher delegate(controller, run_loop.QuitClosure());
+  WriteBytes(1);
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[0], true,
+                                         MessagePumpLibevent::WATCH_READ_WRITE,
+                                         controller, &delegate));
+  run_loop.Run();
+  RunLoop().RunUntilIdle();
+}
+
+// Watching in two steps with the same controller watches both directions.
+TEST_F(MessagePumpLibeventIOUringTest, CumulativeWatch) {
+  RunLoop run_loop;
+  MessagePumpLibevent::FileDescriptorWatcher* controller =
+      new MessagePumpLibevent::FileDescriptorWatcher;
+  DeleteOnWriteWatcher delegate(controller, run_loop.QuitClosure());
+  StupidWatcher stupid_delegate;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[1], true,
+                                         MessagePumpLibevent::WATCH_READ,
+                                         controller, &stupid_delegate));
+  ASSERT_TRUE(pump_->WatchFileDescriptor(sockets_[1], true,
+                                         MessagePumpLibevent::WATCH_WRITE,
+                                         controller, &delegate));
+  run_loop.Run();
+}
+
 }  // namespace
 
 }  // namespace base
@@ -24,6 +24,16 @@
 #include "base/android/java_handler_thread.h"
 #endif
 
+#if defined(OS_LINUX)
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/files/file_util.h"
+#include "base/message_loop/message_pump_libevent.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/run_loop.h"
+#endif
+
 namespace base {
 
 class ScheduleWorkTest : public testing::Test {
@@ -302,4 +312,249 @@ TEST_F(PostTaskTest, OneHundredTasksPerReload) {
   Run(1000, 100);
 }
 
+// Measures the latency of AddToIncomingQueue() when several threads post to the
+// same IncomingTaskQueue while its owning thread keeps reloading it.
+class ContendedPostTaskTest : public testing::Test {
+ public:
+  ContendedPostTaskTest() : num_ran_(0) {}
+
+  void PostTasks(internal::IncomingTaskQueue* queue, int index) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    base::TimeDelta maximum = base::TimeDelta();
+    base::TimeTicks now, lastnow = start;
+    for (size_t i = 0; i < kNumBatchesPerThread; ++i) {
+      for (size_t j = 0; j < kBatchSize; ++j) {
+        queue->AddToIncomingQueue(FROM_HERE, base::Bind(&DoNothing),
+                                  base::TimeDelta(), false);
+      }
+      now = base::TimeTicks::Now();
+      maximum = std::max(maximum, now - lastnow);
+      lastnow = now;
+    }
+    posting_times_[index] = now - start;
+    max_batch_times_[index] = maximum;
+  }
+
+  void Run(int num_posting_threads) {
+    MessageLoop loop(std::unique_ptr<MessagePump>(new FakeMessagePump));
+    scoped_refptr<internal::IncomingTaskQueue> queue(
+        new internal::IncomingTaskQueue(&loop));
+    posting_times_.reset(new base::TimeDelta[num_posting_threads]);
+    max_batch_times_.reset(new base::TimeDelta[num_posting_threads]);
+
+    std::vector<std::unique_ptr<Thread>> posting_threads;
+    for (int i = 0; i < num_posting_threads; ++i) {
+      posting_threads.push_back(WrapUnique(new Thread("posting thread")));
+      posting_threads[i]->Start();
+    }
+    for (int i = 0; i < num_posting_threads; ++i) {
+      posting_threads[i]->task_runner()->PostTask(
+          FROM_HERE,
+          base::Bind(&ContendedPostTaskTest::PostTasks, base::Unretained(this),
+                     base::RetainedRef(queue), i));
+    }
+
+    // Act as the message loop thread until all tasks have run.
+    const uint64_t num_tasks =
+        num_posting_threads * kNumBatchesPerThread * kBatchSize;
+    while (num_ran_ < num_tasks) {
+      TaskQueue loop_local_queue;
+      queue->ReloadWorkQueue(&loop_local_queue);
+      while (!loop_local_queue.empty()) {
+        PendingTask t = std::move(loop_local_queue.front());
+        loop_local_queue.pop();
+        loop.RunTask(t);
+        ++num_ran_;
+      }
+    }
+
+    for (int i = 0; i < num_posting_threads; ++i)
+      posting_threads[i]->Stop();
+    queue->WillDestroyCurrentMessageLoop();
+
+    base::TimeDelta total_time;
+    base::TimeDelta max_batch_time;
+    for (int i = 0; i < num_posting_threads; ++i) {
+      total_time += posting_times_[i];
+      max_batch_time = std::max(max_batch_time, max_batch_times_[i]);
+    }
+    std::string trace =
+        StringPrintf("%d_threads_posting_to_one_queue", num_posting_threads);
+    perf_test::PrintResult(
+        "post",
+        "",
+        trace,
+        total_time.InMicroseconds() / static_cast<double>(num_tasks),
+        "us/task",
+        true);
+    perf_test::PrintResult(
+        "post",
+        "_max_batch_time",
+        trace,
+        max_batch_time.InMicroseconds() / static_cast<double>(kBatchSize),
+        "us/task",
+        false);
+  }
+
+ private:
+  std::unique_ptr<base::TimeDelta[]> posting_times_;
+  std::unique_ptr<base::TimeDelta[]> max_batch_times_;
+  uint64_t num_ran_;
+
+  static const size_t kNumBatchesPerThread = 200;
+  static const size_t kBatchSize = 1000;
+};
+
+TEST_F(ContendedPostTaskTest, OnePostingThread) {
+  Run(1);
+}
+
+TEST_F(ContendedPostTaskTest, FourPostingThreads) {
+  Run(4);
+}
+
+TEST_F(ContendedPostTaskTest, SixteenPostingThreads) {
+  Run(16);
+}
+
+#if defined(OS_LINUX)
+// A socket which is watched for reading, like an idle network connection. If
+// |remaining_events| is given, it becomes readable again whenever it was read,
+// and it is watched again, like a busy connection which the network stack
+// reads from until the read would block.
+class WatchedSocket : public MessagePumpLibevent::Watcher {
+ public:
+  WatchedSocket(MessagePumpLibevent* pump,
+                int* remaining_events,
+                const Closure& quit_closure)
+      : pump_(pump),
+        remaining_events_(remaining_events),
+        quit_closure_(quit_closure) {
+    CHECK_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_));
+  }
+
+  ~WatchedSocket() override {
+    controller_.StopWatchingFileDescriptor();
+    IGNORE_EINTR(close(sockets_[0]));
+    IGNORE_EINTR(close(sockets_[1]));
+  }
+
+  void Start() {
+    if (remaining_events_)
+      CHECK(WriteFileDescriptor(sockets_[1], "x", 1));
+    Watch();
+  }
+
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    CHECK(remaining_events_);
+    char buf;
+    CHECK_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    if (--*remaining_events_ == 0) {
+      quit_closure_.Run();
+      return;
+    }
+    CHECK(WriteFileDescriptor(sockets_[1], "x", 1));
+    Watch();
+  }
+
+  void OnFileCanWriteWithoutBlocking(int fd) override { NOTREACHED(); }
+
+ private:
+  void Watch() {
+    CHECK(pump_->WatchFileDescriptor(sockets_[0], false,
+                                     MessagePumpLibevent::WATCH_READ,
+                                     &controller_, this));
+  }
+
+  MessagePumpLibevent* const pump_;
+  int* const remaining_events_;
+  const Closure quit_closure_;
+  int sockets_[2];
+  MessagePumpLibevent::FileDescriptorWatcher controller_;
+};
+
+// Measures the cost of dispatching I/O events on busy sockets, with and
+// without many idle sockets watched next to them, and the cost of starting to
+// watch the idle sockets.
+class FileDescriptorWatcherPerfTest : public testing::Test {
+ public:
+  void Run(MessagePumpLibevent::Backend backend, int num_idle, int num_busy) {
+    MessagePumpLibevent* pump = new MessagePumpLibevent(backend);
+    if (pump->backend() != backend) {
+      LOG(WARNING) << "io_uring is not supported, skipping.";
+      delete pump;
+      return;
+    }
+    MessageLoop loop(WrapUnique(pump));
+    const std::string suffix =
+        backend == MessagePumpLibevent::Backend::IO_URING ? "_io_uring"
+                                                          : "_libevent";
+    const std::string trace =
+        StringPrintf("%d_idle_%d_busy_sockets", num_idle, num_busy);
+
+    std::vector<std::unique_ptr<WatchedSocket>> idle_sockets;
+    for (int i = 0; i < num_idle; ++i)
+      idle_sockets.push_back(WrapUnique(new WatchedSocket(pump, nullptr,
+                                                          Closure())));
+    TimeTicks start = TimeTicks::Now();
+    for (const auto& socket : idle_sockets)
+      socket->Start();
+    RunLoop().RunUntilIdle();
+    TimeDelta elapsed = TimeTicks::Now() - start;
+    if (num_idle) {
+      perf_test::PrintResult(
+          "watch", suffix, trace,
+          elapsed.InMicroseconds() / static_cast<double>(num_idle),
+          "us/socket", true);
+    }
+
+    RunLoop run_loop;
+    int remaining_events = kNumEvents;
+    std::vector<std::unique_ptr<WatchedSocket>> busy_sockets;
+    for (int i = 0; i < num_busy; ++i) {
+      busy_sockets.push_back(WrapUnique(
+          new WatchedSocket(pump, &remaining_events, run_loop.QuitClosure())));
+    }
+    start = TimeTicks::Now();
+    for (const auto& socket : busy_sockets)
+      socket->Start();
+    run_loop.Run();
+    elapsed = TimeTicks::Now() - start;
+    perf_test::PrintResult(
+        "io_event", suffix, trace,
+        elapsed.InMicroseconds() / static_cast<double>(kNumEvents),
+        "us/event", true);
+  }
+
+ private:
+  static const int kNumEvents = 200000;
+};
+
+TEST_F(FileDescriptorWatcherPerfTest, OneBusySocketLibevent) {
+  Run(MessagePumpLibevent::Backend::LIBEVENT, 0, 1);
+}
+
+TEST_F(FileDescriptorWatcherPerfTest, OneBusySocketIOUring) {
+  Run(MessagePumpLibevent::Backend::IO_URING, 0, 1);
+}
+
+TEST_F(FileDescriptorWatcherPerfTest, FewBusySocketsLibevent) {
+  Run(MessagePumpLibevent::Backend::LIBEVENT, 0, 16);
+}
+
+TEST_F(FileDescriptorWatcherPerfTest, FewBusySocketsIOUring) {
+  Run(MessagePumpLibevent::Backend::IO_URING, 0, 16);
+}
+
+// The number of idle sockets is bounded by the default limit of 1024 open
+// files, since each takes two.
+TEST_F(FileDescriptorWatcherPerfTest, ManyIdleSocketsLibevent) {
+  Run(MessagePumpLibevent::Backend::LIBEVENT, 400, 16);
+}
+
+TEST_F(FileDescriptorWatcherPerfTest, ManyIdleSocketsIOUring) {
+  Run(MessagePumpLibevent::Backend::IO_URING, 400, 16);
+}
+#endif  // defined(OS_LINUX)
+
 }  // namespace base
@@ -0,0 +1,324 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/timing_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base/logging.h"
+#include "base/pending_task.h"
+#include "build/build_config.h"
+
+namespace base {
+
+namespace {
+
+const uint64_t kSlotMask = TimingWheel::kSlotsPerLevel - 1;
+
+// The number of low bits of a tick which select a slot at |level| or below.
+int LevelShift(int level) {
+  return TimingWheel::kBitsPerLevel * level;
+}
+
+uint64_t ToTick(TimeTicks time) {
+  return static_cast<uint64_t>(std::max<int64_t>(time.ToInternalValue(), 0)) /
+         Time::kMicrosecondsPerMillisecond;
+}
+
+TimeTicks FromTick(uint64_t tick) {
+  return TimeTicks::FromInternalValue(
+      static_cast<int64_t>(tick * Time::kMicrosecondsPerMillisecond));
+}
+
+// Returns the index of the lowest bit set in |bits|, which must not be 0.
+int LowestBit(uint64_t bits) {
+  DCHECK(bits);
+#if defined(COMPILER_GCC)
+  return __builtin_ctzll(bits);
+#else
+  int index = 0;
+  for (; !(bits & 1); bits >>= 1)
+    ++index;
+  return index;
+#endif
+}
+
+}  // namespace
+
+const int TimingWheel::kBitsPerLevel;
+const int TimingWheel::kSlotsPerLevel;
+const int TimingWheel::kNumLevels;
+
+TimingWheel::Entry::Entry()
+    : wheel_(nullptr),
+      previous_(nullptr),
+      next_(nullptr),
+      sequence_num_(0),
+      level_(kNotScheduled),
+      slot_(0) {}
+
+TimingWheel::Entry::~Entry() {
+  DCHECK(!is_scheduled());
+}
+
+void TimingWheel::Entry::Cancel() {
+  DCHECK(is_scheduled());
+  wheel_->Cancel(this);
+}
+
+TimingWheel::TimingWheel()
+    : due_list_head_(nullptr),
+      due_list_tail_(nullptr),
+      overflow_list_head_(nullptr),
+      current_tick_(0),
+      next_sequence_num_(0),
+      size_(0) {
+  std::fill(&slots_[0][0], &slots_[0][0] + kNumLevels * kSlotsPerLevel,
+            nullptr);
+  std::fill(occupied_, occupied_ + kNumLevels, 0);
+}
+
+TimingWheel::~TimingWheel() {
+  DCHECK(empty());
+}
+
+void TimingWheel::Schedule(Entry* entry, TimeTicks run_time) {
+  DCHECK(!entry->is_scheduled());
+  entry->wheel_ = this;
+  entry->run_time_ = run_time;
+  entry->sequence_num_ = next_sequence_num_++;
+  ++size_;
+  Place(entry);
+}
+
+void TimingWheel::Cancel(Entry* entry) {
+  DCHECK_EQ(this, entry->wheel_);
+  Unlink(entry);
+  entry->wheel_ = nullptr;
+  --size_;
+}
+
+TimingWheel::Entry* TimingWheel::TakeDueEntry(TimeTicks now) {
+  AdvanceTo(ToTick(now) + 1);
+  if (!due_list_head_ || due_list_head_->run_time_ > now)
+    return nullptr;
+  Entry* entry = due_list_head_;
+  Cancel(entry);
+  return entry;
+}
+
+TimeTicks TimingWheel::NextRunTime() const {
+  if (due_list_head_)
+    return due_list_head_->run_time_;
+
+  // The run time is exact if the next occupied slot spans a single tick. Its
+  // entries are not sorted yet, but there are few of them.
+  uint64_t next_tick = current_tick_;
+  if (!(occupied_[0] & (uint64_t{1} << (current_tick_ & kSlotMask)))) {
+    next_tick = NextOccupiedTick();
+    if (next_tick == std::numeric_limits<uint64_t>::max())
+      return TimeTicks();
+    if ((next_tick >> kBitsPerLevel) != (current_tick_ >> kBitsPerLevel) ||
+        !(occupied_[0] & (uint64_t{1} << (next_tick & kSlotMask)))) {
+      return FromTick(next_tick);
+    }
+  }
+  TimeTicks next_run_time = TimeTicks::Max();
+  for (const Entry* entry = slots_[0][next_tick & kSlotMask]; entry;
+       entry = entry->next_) {
+    next_run_time = std::min(next_run_time, entry->run_time_);
+  }
+  return next_run_time;
+}
+
+// static
+bool TimingWheel::RunsBefore(const Entry* a, const Entry* b) {
+  return a->run_time_ < b->run_time_ ||
+         (a->run_time_ == b->run_time_ && a->sequence_num_ < b->sequence_num_);
+}
+
+TimingWheel::Entry** TimingWheel::ListHead(const Entry* entry) {
+  switch (entry->level_) {
+    case kDueList:
+      return &due_list_head_;
+    case kOverflowList:
+      return &overflow_list_head_;
+    default:
+      DCHECK_GE(entry->level_, 0);
+      DCHECK_LT(entry->level_, kNumLevels);
+      return &slots_[entry->level_][entry->slot_];
+  }
+}
+
+void TimingWheel::Place(Entry* entry) {
+  const uint64_t tick = ToTick(entry->run_time_);
+  if (tick < current_tick_) {
+    InsertInDueList(entry);
+    return;
+  }
+  // The lowest level at which the entry is in the same slot of the level
+  // above as the wheel's position.
+  for (int level = 0; level < kNumLevels; ++level) {
+    const int shift = LevelShift(level + 1);
+    if ((tick >> shift) == (current_tick_ >> shift)) {
+      LinkInSlot(entry, level,
+                 static_cast<int>((tick >> LevelShift(level)) & kSlotMask));
+      return;
+    }
+  }
+  LinkInOverflowList(entry);
+}
+
+void TimingWheel::LinkInSlot(Entry* entry, int level, int slot) {
+  entry->level_ = static_cast<int8_t>(level);
+  entry->slot_ = static_cast<uint8_t>(slot);
+  Entry*& head = slots_[level][slot];
+  entry->previous_ = nullptr;
+  entry->next_ = head;
+  if (head)
+    head->previous_ = entry;
+  head = entry;
+  occupied_[level] |= uint64_t{1} << slot;
+}
+
+void TimingWheel::LinkInOverflowList(Entry* entry) {
+  entry->level_ = kOverflowList;
+  entry->previous_ = nullptr;
+  entry->next_ = overflow_list_head_;
+  if (overflow_list_head_)
+    overflow_list_head_->previous_ = entry;
+  overflow_list_head_ = entry;
+}
+
+void TimingWheel::InsertInDueList(Entry* entry) {
+  entry->level_ = kDueList;
+  // Entries usually become due in order, so look for the insertion point
+  // from the back.
+  Entry* previous = due_list_tail_;
+  while (previous && RunsBefore(entry, previous))
+    previous = previous->previous_;
+  entry->previous_ = previous;
+  entry->next_ = previous ? previous->next_ : due_list_head_;
+  if (entry->next_)
+    entry->next_->previous_ = entry;
+  else
+    due_list_tail_ = entry;
+  if (previous)
+    previous->next_ = entry;
+  else
+    due_list_head_ = entry;
+}
+
+void TimingWheel::Unlink(Entry* entry) {
+  DCHECK_NE(kNotScheduled, entry->level_);
+  if (entry->previous_)
+    entry->previous_->next_ = entry->next_;
+  else
+    *ListHead(entry) = entry->next_;
+  if (entry->next_)
+    entry->next_->previous_ = entry->previous_;
+  else if (entry->level_ == kDueList)
+    due_list_tail_ = entry->previous_;
+
+  if (entry->level_ < kNumLevels && !slots_[entry->level_][entry->slot_])
+    occupied_[entry->level_] &= ~(uint64_t{1} << entry->slot_);
+
+  entry->previous_ = nullptr;
+  entry->next_ = nullptr;
+  entry->level_ = kNotScheduled;
+}
+
+void TimingWheel::AdvanceTo(uint64_t target_tick) {
+  while (current_tick_ < target_tick) {
+    MoveCurrentSlotToDueList();
+    MoveTo(std::min(NextOccupiedTick(), target_tick));
+  }
+}
+
+void TimingWheel::MoveTo(uint64_t tick) {
+  DCHECK_GT(tick, current_tick_);
+  const uint64_t previous_tick = current_tick_;
+  current_tick_ = tick;
+
+  // Going down the levels, so that the entries of an upper slot end up in
+  // the lower slots the wheel enters as well.
+  if ((previous_tick >> LevelShift(kNumLevels)) !=
+      (tick >> LevelShift(kNumLevels))) {
+    Cascade(&overflow_list_head_);
+  }
+  for (int level = kNumLevels - 1; level > 0; --level) {
+    const int shift = LevelShift(level);
+    if ((previous_tick >> shift) != (tick >> shift))
+      Cascade(&slots_[level][(tick >> shift) & kSlotMask]);
+  }
+}
+
+uint64_t TimingWheel::NextOccupiedTick() const {
+  // The slots of a level all come after the occupied slots of the levels
+  // below, which are within the current slot of the level.
+  for (int level = 0; level < kNumLevels; ++level) {
+    const int shift = LevelShift(level);
+    const uint64_t current_slot = (current_tick_ >> shift) & kSlotMask;
+    // The slots after the current one. Shifting a 64-bit value by 64 is
+    // undefined, hence the two steps.
+    const uint64_t later_slots = ~((uint64_t{2} << current_slot) - 1);
+    const uint64_t bits = occupied_[level] & later_slots;
+    if (!bits)
+      continue;
+    const int upper_shift = LevelShift(level + 1);
+    return ((current_tick_ >> upper_shift) << upper_shift) |
+           (static_cast<uint64_t>(LowestBit(bits)) << shift);
+  }
+
+  uint64_t next_tick = std::numeric_limits<uint64_t>::max();
+  const int top_shift = LevelShift(kNumLevels);
+  for (const Entry* entry = overflow_list_head_; entry; entry = entry->next_) {
+    next_tick = std::min(next_tick,
+                         (ToTick(entry->run_time_) >> top_shift) << top_shift);
+  }
+  return next_tick;
+}
+
+void TimingWheel::Cascade(Entry** head) {
+  Entry* entry = *head;
+  if (!entry)
+    return;
+  if (entry->level_ < kNumLevels)
+    occupied_[entry->level_] &= ~(uint64_t{1} << entry->slot_);
+  *head = nullptr;
+  while (entry) {
+    Entry* next = entry->next_;
+    Place(entry);
+    entry = next;
+  }
+}
+
+void TimingWheel::MoveCurrentSlotToDueList() {
+  const uint64_t slot = current_tick_ & kSlotMask;
+  Entry* entry = slots_[0][slot];
+  if (!entry)
+    return;
+  slots_[0][slot] = nullptr;
+  occupied_[0] &= ~(uint64_t{1} << slot);
+
+  // The slot holds the entries of a single tick, which is after the ticks of
+  // the entries in the due list, so they go at its end once sorted.
+  scratch_.clear();
+  for (; entry; entry = entry->next_)
+    scratch_.push_back(entry);
+  std::sort(scratch_.begin(), scratch_.end(), &RunsBefore);
+  for (Entry* due_entry : scratch_) {
+    due_entry->level_ = kDueList;
+    due_entry->previous_ = due_list_tail_;
+    due_entry->next_ = nullptr;
+    if (due_list_tail_)
+      due_list_tail_->next_ = due_entry;
+    else
+      due_list_head_ = due_entry;
+    due_list_tail_ = due_entry;
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,165 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_TIMING_WHEEL_H_
+#define BASE_MESSAGE_LOOP_TIMING_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+
+struct PendingTask;
+
+// The queue of delayed work of a MessageLoop: a hierarchical timing wheel, in
+// which scheduling and canceling an entry take constant time, so that timers
+// which are constantly reset (e.g. idle and keepalive timers) neither pay a
+// heap operation nor leave an abandoned task behind on every reset.
+//
+// The wheel has kNumLevels levels of kSlotsPerLevel slots. A slot of level 0
+// spans one millisecond, and a slot of level L spans kSlotsPerLevel^L
+// milliseconds. An entry goes to the lowest level whose slots can tell its
+// run time apart from the current position of the wheel, and moves down a
+// level each time the wheel reaches its slot, until it is due. Due entries
+// are kept sorted by run time, and then by the order in which they were
+// scheduled, so the wheel runs entries in the same order as a priority queue.
+//
+// Entries are intrusive: the wheel does not own them.
+//
+// Not thread safe.
+class BASE_EXPORT TimingWheel {
+ public:
+  class BASE_EXPORT Entry {
+   public:
+    Entry();
+    // The entry must not be scheduled.
+    virtual ~Entry();
+
+    // Returns the task to run when the entry is due, or to delete without
+    // running it when the MessageLoop is destroyed. The entry was removed from
+    // the wheel, and may delete itself.
+    virtual PendingTask TakeTask() = 0;
+
+    // Removes the entry from the wheel it is scheduled in.
+    void Cancel();
+
+    bool is_scheduled() const { return wheel_ != nullptr; }
+    TimeTicks run_time() const { return run_time_; }
+
+   private:
+    friend class TimingWheel;
+
+    TimingWheel* wheel_;
+    Entry* previous_;
+    Entry* next_;
+    TimeTicks run_time_;
+    uint64_t sequence_num_;
+    // The level and slot the entry is in, or one of the lists of TimingWheel.
+    int8_t level_;
+    uint8_t slot_;
+
+    DISALLOW_COPY_AND_ASSIGN(Entry);
+  };
+
+  static const int kBitsPerLevel = 6;
+  static const int kSlotsPerLevel = 1 << kBitsPerLevel;
+  // Enough for the wheel to span 139 years.
+  static const int kNumLevels = 7;
+
+  TimingWheel();
+  // The wheel must be empty.
+  ~TimingWheel();
+
+  // Schedules |entry|, which must not be scheduled, to run at |run_time|.
+  void Schedule(Entry* entry, TimeTicks run_time);
+
+  // Removes |entry|, which must be scheduled in this wheel.
+  void Cancel(Entry* entry);
+
+  // Removes and returns the entry with the earliest run time if it is due at
+  // |now|, and null otherwise. Entries with the same run time are returned in
+  // the order in which they were scheduled. Pass TimeTicks::Max() to take all
+  // entries in order.
+  Entry* TakeDueEntry(TimeTicks now);
+
+  // Returns the run time of the earliest entry, or the start of the slot it
+  // sits in if the slot spans more than a millisecond: when the wheel reaches
+  // that time, the entry moves to a finer slot. Returns a null TimeTicks if
+  // the wheel is empty.
+  TimeTicks NextRunTime() const;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+ private:
+  // Values of Entry::level_ for entries which are not in a slot.
+  enum : int8_t {
+    kNotScheduled = -1,
+    // The entries whose tick the wheel went past, sorted by run time.
+    kDueList = kNumLevels,
+    // The entries too far in the future to have a slot, in no order.
+    kOverflowList,
+  };
+
+  // Whether |a| runs before |b|.
+  static bool RunsBefore(const Entry* a, const Entry* b);
+
+  // Returns the list that |entry| is linked in.
+  Entry** ListHead(const Entry* entry);
+
+  // Links |entry| in the appropriate slot or list for its run time.
+  void Place(Entry* entry);
+  void LinkInSlot(Entry* entry, int level, int slot);
+  void LinkInOverflowList(Entry* entry);
+  void InsertInDueList(Entry* entry);
+  void Unlink(Entry* entry);
+
+  // Makes all entries which run before |target_tick| due.
+  void AdvanceTo(uint64_t target_tick);
+
+  // Moves the wheel to |tick|, and the entries of the slots it enters down to
+  // the lower levels. There must be no entry before |tick| in the slots.
+  void MoveTo(uint64_t tick);
+
+  // Returns the first tick after |current_tick_| at which the wheel enters an
+  // occupied slot, or UINT64_MAX if there is none.
+  uint64_t NextOccupiedTick() const;
+
+  // Takes the entries out of a slot or the overflow list and places them
+  // again.
+  void Cascade(Entry** head);
+
+  // Moves the entries of the level 0 slot of |current_tick_| to the due list.
+  void MoveCurrentSlotToDueList();
+
+  Entry* slots_[kNumLevels][kSlotsPerLevel];
+  // Bit N of |occupied_[L]| is set iff |slots_[L][N]| is not empty.
+  uint64_t occupied_[kNumLevels];
+
+  Entry* due_list_head_;
+  Entry* due_list_tail_;
+  Entry* overflow_list_head_;
+
+  // The wheel's position, in milliseconds. The entries which run before it
+  // are in the due list, and the others in the slots and the overflow list.
+  uint64_t current_tick_;
+
+  uint64_t next_sequence_num_;
+  size_t size_;
+
+  // Used to sort the entries of a slot which becomes due.
+  std::vector<Entry*> scratch_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimingWheel);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_TIMING_WHEEL_H_
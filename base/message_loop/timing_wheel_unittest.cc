@@ -0,0 +1,261 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/timing_wheel.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/pending_task.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class TestEntry : public TimingWheel::Entry {
+ public:
+  explicit TestEntry(int id) : id_(id) {}
+
+  // TimingWheel::Entry:
+  PendingTask TakeTask() override { return PendingTask(FROM_HERE, Closure()); }
+
+  int id() const { return id_; }
+
+ private:
+  const int id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestEntry);
+};
+
+std::vector<std::unique_ptr<TestEntry>> CreateEntries(int count) {
+  std::vector<std::unique_ptr<TestEntry>> entries;
+  for (int i = 0; i < count; ++i)
+    entries.push_back(std::unique_ptr<TestEntry>(new TestEntry(i)));
+  return entries;
+}
+
+// Far from the zero TimeTicks, so that the wheel starts with entries in its
+// upper levels.
+const TimeTicks kStart = TimeTicks() + TimeDelta::FromDays(12);
+
+TimeTicks At(int64_t milliseconds) {
+  return kStart + TimeDelta::FromMilliseconds(milliseconds);
+}
+
+// Takes the entries of |wheel| which are due at |now|, and returns their IDs.
+std::vector<int> TakeDueEntries(TimingWheel* wheel, TimeTicks now) {
+  std::vector<int> ids;
+  while (TimingWheel::Entry* entry = wheel->TakeDueEntry(now))
+    ids.push_back(static_cast<TestEntry*>(entry)->id());
+  return ids;
+}
+
+// A deterministic pseudo-random sequence, so that failures reproduce.
+class Random {
+ public:
+  Random() : state_(0x2545F4914F6CDD1DULL) {}
+
+  uint64_t Next(uint64_t range) {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_ % range;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+}  // namespace
+
+TEST(TimingWheelTest, Empty) {
+  TimingWheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_TRUE(wheel.NextRunTime().is_null());
+  EXPECT_FALSE(wheel.TakeDueEntry(TimeTicks::Max()));
+}
+
+TEST(TimingWheelTest, TakesEntriesInOrderOfRunTime) {
+  const int64_t kRunTimes[] = {70000, 3, 64, 4096, 1, 262143, 65, 4095, 2};
+  std::vector<std::unique_ptr<TestEntry>> entries;
+  TimingWheel wheel;
+  for (int64_t run_time : kRunTimes) {
+    entries.push_back(
+        std::unique_ptr<TestEntry>(new TestEntry(static_cast<int>(run_time))));
+    wheel.Schedule(entries.back().get(), At(run_time));
+  }
+  EXPECT_EQ(arraysize(kRunTimes), wheel.size());
+
+  std::vector<int> expected_ids(kRunTimes, kRunTimes + arraysize(kRunTimes));
+  std::sort(expected_ids.begin(), expected_ids.end());
+  EXPECT_EQ(expected_ids, TakeDueEntries(&wheel, TimeTicks::Max()));
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, EntriesWithTheSameRunTimeAreFifo) {
+  std::vector<std::unique_ptr<TestEntry>> entries = CreateEntries(4);
+  TimingWheel wheel;
+  // One of the entries is scheduled after the wheel reached its slot.
+  wheel.Schedule(entries[0].get(), At(100));
+  wheel.Schedule(entries[1].get(), At(100));
+  wheel.Schedule(entries[2].get(), At(100));
+  EXPECT_TRUE(TakeDueEntries(&wheel, At(99)).empty());
+  wheel.Schedule(entries[3].get(), At(100));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), TakeDueEntries(&wheel, At(100)));
+}
+
+TEST(TimingWheelTest, TakesOnlyDueEntries) {
+  TestEntry soon(0);
+  TestEntry later(1);
+  TestEntry much_later(2);
+  TimingWheel wheel;
+  wheel.Schedule(&much_later, At(3600 * 1000));
+  wheel.Schedule(&later, At(5000));
+  wheel.Schedule(&soon, kStart + TimeDelta::FromMicroseconds(10500));
+
+  EXPECT_TRUE(TakeDueEntries(&wheel, At(10)).empty());
+  EXPECT_TRUE(soon.is_scheduled());
+  // Same tick, but not due yet.
+  EXPECT_TRUE(
+      TakeDueEntries(&wheel, kStart + TimeDelta::FromMicroseconds(10499))
+          .empty());
+  EXPECT_EQ(kStart + TimeDelta::FromMicroseconds(10500), wheel.NextRunTime());
+  EXPECT_EQ(std::vector<int>({0}), TakeDueEntries(&wheel, At(11)));
+  EXPECT_FALSE(soon.is_scheduled());
+
+  EXPECT_TRUE(TakeDueEntries(&wheel, At(4999)).empty());
+  EXPECT_EQ(std::vector<int>({1}), TakeDueEntries(&wheel, At(5000)));
+  EXPECT_EQ(std::vector<int>({2}), TakeDueEntries(&wheel, At(7200 * 1000)));
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, NextRunTimeIsALowerBound) {
+  // Following NextRunTime() gets to the run time of the entry within a wake-up
+  // per level.
+  for (int64_t run_time : {1, 100, 10000, 1000000, 100000000}) {
+    TestEntry entry(0);
+    TimingWheel wheel;
+    wheel.Schedule(&entry, At(run_time) + TimeDelta::FromMicroseconds(1));
+    int wake_ups = 0;
+    for (;;) {
+      TimeTicks now = wheel.NextRunTime();
+      ASSERT_LE(now, entry.run_time());
+      ++wake_ups;
+      if (wheel.TakeDueEntry(now))
+        break;
+    }
+    EXPECT_LE(wake_ups, TimingWheel::kNumLevels + 1);
+  }
+}
+
+TEST(TimingWheelTest, Cancel) {
+  TestEntry due(0);
+  TestEntry in_slot(1);
+  TestEntry in_upper_slot(2);
+  TestEntry too_far(3);
+  TestEntry kept(4);
+  TimingWheel wheel;
+  wheel.Schedule(&due, At(1) + TimeDelta::FromMicroseconds(500));
+  wheel.Schedule(&kept, At(2));
+  wheel.Schedule(&in_slot, At(20));
+  wheel.Schedule(&in_upper_slot, At(200000));
+  wheel.Schedule(&too_far, TimeTicks::Max());
+  // Moves |due| to the list of due entries, without taking it.
+  EXPECT_TRUE(TakeDueEntries(&wheel, At(1)).empty());
+
+  for (TestEntry* entry : {&due, &in_slot, &in_upper_slot, &too_far}) {
+    entry->Cancel();
+    EXPECT_FALSE(entry->is_scheduled());
+  }
+  EXPECT_EQ(1u, wheel.size());
+  EXPECT_EQ(std::vector<int>({4}), TakeDueEntries(&wheel, TimeTicks::Max()));
+
+  // A canceled entry can be scheduled again.
+  wheel.Schedule(&in_slot, At(3));
+  EXPECT_EQ(std::vector<int>({1}), TakeDueEntries(&wheel, At(3)));
+}
+
+TEST(TimingWheelTest, EntriesInThePastAreDue) {
+  std::vector<std::unique_ptr<TestEntry>> entries = CreateEntries(3);
+  TimingWheel wheel;
+  wheel.Schedule(entries[0].get(), At(1000));
+  EXPECT_TRUE(TakeDueEntries(&wheel, At(500)).empty());
+  wheel.Schedule(entries[1].get(), At(100));
+  wheel.Schedule(entries[2].get(), At(50));
+  EXPECT_EQ(At(50), wheel.NextRunTime());
+  EXPECT_EQ(std::vector<int>({2, 1}), TakeDueEntries(&wheel, At(500)));
+  EXPECT_EQ(std::vector<int>({0}), TakeDueEntries(&wheel, At(1000)));
+}
+
+// Checks the wheel against the state of its entries, while they are scheduled,
+// canceled and taken with random run times.
+TEST(TimingWheelTest, RandomOperations) {
+  const int kNumEntries = 1000;
+  std::vector<std::unique_ptr<TestEntry>> entries = CreateEntries(kNumEntries);
+
+  Random random;
+  TimingWheel wheel;
+  TimeTicks now = kStart;
+  for (int round = 0; round < 100000; ++round) {
+    bool took_due_entries = false;
+    TestEntry* entry = entries[random.Next(kNumEntries)].get();
+    switch (random.Next(4)) {
+      case 0:
+      case 1:
+        if (entry->is_scheduled())
+          entry->Cancel();
+        // Mostly near, sometimes far in the future, and sometimes late.
+        wheel.Schedule(entry, now + TimeDelta::FromMicroseconds(
+                                        random.Next(3) == 0
+                                            ? random.Next(1ULL << 40)
+                                            : random.Next(1000000)) -
+                                  TimeDelta::FromMicroseconds(1000));
+        break;
+      case 2:
+        if (entry->is_scheduled())
+          entry->Cancel();
+        break;
+      case 3: {
+        now += TimeDelta::FromMicroseconds(random.Next(100000));
+        TimeTicks previous_run_time;
+        while (TimingWheel::Entry* due = wheel.TakeDueEntry(now)) {
+          ASSERT_LE(due->run_time(), now);
+          ASSERT_LE(previous_run_time, due->run_time());
+          previous_run_time = due->run_time();
+        }
+        took_due_entries = true;
+        break;
+      }
+    }
+
+    size_t scheduled = 0;
+    TimeTicks next_run_time = TimeTicks::Max();
+    for (const auto& e : entries) {
+      if (e->is_scheduled()) {
+        ++scheduled;
+        next_run_time = std::min(next_run_time, e->run_time());
+      }
+    }
+    ASSERT_EQ(scheduled, wheel.size());
+    if (scheduled)
+      ASSERT_LE(wheel.NextRunTime(), next_run_time);
+    // Nothing due is left behind.
+    if (scheduled && took_due_entries)
+      ASSERT_GT(next_run_time, now);
+  }
+
+  for (const auto& e : entries) {
+    if (e->is_scheduled())
+      e->Cancel();
+  }
+}
+
+}  // namespace base
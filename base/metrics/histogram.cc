@@ -25,6 +25,7 @@
 #include "base/metrics/persistent_memory_allocator.h"
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/metrics/thread_sample_buffers.h"
 #include "base/pickle.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
@@ -428,7 +429,10 @@ void Histogram::AddCount(int value, int count) {
     NOTREACHED();
     return;
   }
-  samples_->Accumulate(value, count);
+  if (flags() & kThreadBufferedFlag)
+    ThreadSampleBuffers::Accumulate(this, bucket_ranges(), value, count);
+  else
+    samples_->Accumulate(value, count);
 
   FindAndRunCallback(value);
 }
@@ -530,6 +534,8 @@ Histogram::Histogram(const std::string& name,
 }
 
 Histogram::~Histogram() {
+  if (flags() & kThreadBufferedFlag)
+    ThreadSampleBuffers::Forget(this);
 }
 
 bool Histogram::PrintEmptyBucket(uint32_t index) const {
@@ -583,6 +589,9 @@ HistogramBase* Histogram::DeserializeInfoImpl(PickleIterator* iter) {
 }
 
 std::unique_ptr<SampleVector> Histogram::SnapshotSampleVector() const {
+  if (flags() & kThreadBufferedFlag)
+    ThreadSampleBuffers::Fold(this, samples_.get());
+
   std::unique_ptr<SampleVector> samples(
       new SampleVector(samples_->id(), bucket_ranges()));
   samples->Add(*samples_);
@@ -122,6 +122,13 @@ class BASE_EXPORT HistogramBase {
     // histogram is created.
     kIsPersistent = 0x40,
 
+    // Indicates that samples are collected in per-thread buffers and folded
+    // into the histogram when it is snapshotted. This avoids contention on the
+    // shared counts of histograms that many threads add to. Only Histogram,
+    // its subclasses and SparseHistogram support it, and it must be given at
+    // creation.
+    kThreadBufferedFlag = 0x80,
+
     // Only for Histogram and its sub classes: fancy bucket-naming support.
     kHexRangePrintingFlag = 0x8000,
   };
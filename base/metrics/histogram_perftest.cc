@@ -0,0 +1,115 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/sparse_histogram.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kSamplesPerThread = 1000 * 1000;
+
+// Adds kSamplesPerThread samples to |histogram|.
+class AddingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  explicit AddingDelegate(HistogramBase* histogram) : histogram_(histogram) {}
+
+  // DelegateSimpleThread::Delegate:
+  void Run() override {
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      histogram_->Add(i & 63);
+  }
+
+ private:
+  HistogramBase* const histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddingDelegate);
+};
+
+// Has |thread_count| threads add to |histogram| at once, and reports the
+// time per sample of each thread.
+void RunContentionTest(const std::string& trace,
+                       HistogramBase* histogram,
+                       int thread_count) {
+  std::vector<std::unique_ptr<AddingDelegate>> delegates;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    delegates.push_back(WrapUnique(new AddingDelegate(histogram)));
+    threads.push_back(WrapUnique(
+        new DelegateSimpleThread(delegates.back().get(), "AddingThread")));
+  }
+
+  TimeTicks start = TimeTicks::Now();
+  for (const auto& thread : threads)
+    thread->Start();
+  for (const auto& thread : threads)
+    thread->Join();
+  TimeDelta elapsed = TimeTicks::Now() - start;
+
+  // Every sample must be accounted for, whether or not it was buffered.
+  EXPECT_EQ(kSamplesPerThread * thread_count,
+            histogram->SnapshotSamples()->TotalCount());
+
+  perf_test::PrintResult(
+      "histogram_add", StringPrintf("_%d_threads", thread_count), trace,
+      elapsed.InMicroseconds() * 1000.0 / kSamplesPerThread, "ns/sample",
+      true);
+}
+
+void RunContentionTests(int thread_count) {
+  const struct {
+    const char* name;
+    bool sparse;
+    int32_t flags;
+  } kConfigurations[] = {
+      {"shared", false, HistogramBase::kNoFlags},
+      {"thread_buffered", false, HistogramBase::kThreadBufferedFlag},
+      {"sparse_shared", true, HistogramBase::kNoFlags},
+      {"sparse_thread_buffered", true, HistogramBase::kThreadBufferedFlag},
+  };
+
+  for (const auto& configuration : kConfigurations) {
+    std::unique_ptr<StatisticsRecorder> statistics_recorder =
+        StatisticsRecorder::CreateTemporaryForTesting();
+    HistogramBase* histogram =
+        configuration.sparse
+            ? SparseHistogram::FactoryGet("Perf.Contended",
+                                          configuration.flags)
+            : Histogram::FactoryGet("Perf.Contended", 1, 64, 20,
+                                    configuration.flags);
+    RunContentionTest(configuration.name, histogram, thread_count);
+  }
+}
+
+}  // namespace
+
+TEST(HistogramPerfTest, Contention1Thread) {
+  RunContentionTests(1);
+}
+
+TEST(HistogramPerfTest, Contention4Threads) {
+  RunContentionTests(4);
+}
+
+TEST(HistogramPerfTest, Contention16Threads) {
+  RunContentionTests(16);
+}
+
+}  // namespace base
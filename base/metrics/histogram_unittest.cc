@@ -14,15 +14,18 @@
 #include <vector>
 
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/metrics/bucket_ranges.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/persistent_histogram_allocator.h"
 #include "base/metrics/persistent_memory_allocator.h"
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/metrics/thread_sample_buffers.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
 #include "base/test/gtest_util.h"
+#include "base/threading/simple_thread.h"
 #include "base/time/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -203,6 +206,107 @@ TEST_P(HistogramTest, FinalDeltaTest) {
   EXPECT_EQ(samples->TotalCount(), samples->redundant_count());
 }
 
+namespace {
+
+// Adds |count| samples of |value| to |histogram|, one at a time.
+class AddingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  AddingDelegate(HistogramBase* histogram, int value, int count)
+      : histogram_(histogram), value_(value), count_(count) {}
+
+  // DelegateSimpleThread::Delegate:
+  void Run() override {
+    for (int i = 0; i < count_; ++i)
+      histogram_->Add(value_);
+  }
+
+ private:
+  HistogramBase* const histogram_;
+  const int value_;
+  const int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddingDelegate);
+};
+
+}  // namespace
+
+// Check that samples buffered by the adding thread show up in snapshots.
+TEST_P(HistogramTest, ThreadBufferedTest) {
+  HistogramBase* histogram =
+      Histogram::FactoryGet("ThreadBufferedHistogram", 1, 64, 8,
+                            HistogramBase::kThreadBufferedFlag);
+  histogram->Add(1);
+  histogram->Add(10);
+  histogram->AddCount(50, 3);
+
+  std::unique_ptr<HistogramSamples> samples = histogram->SnapshotSamples();
+  EXPECT_EQ(5, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(1));
+  EXPECT_EQ(1, samples->GetCount(10));
+  EXPECT_EQ(3, samples->GetCount(50));
+  EXPECT_EQ(161, samples->sum());
+  EXPECT_EQ(samples->TotalCount(), samples->redundant_count());
+
+  samples = histogram->SnapshotDelta();
+  EXPECT_EQ(5, samples->TotalCount());
+  samples = histogram->SnapshotDelta();
+  EXPECT_EQ(0, samples->TotalCount());
+
+  // A full buffer is folded without a snapshot, and the rest on snapshot.
+  const int kCount = ThreadSampleBuffers::kMaxBufferedSamples + 10;
+  for (int i = 0; i < kCount; ++i)
+    histogram->Add(2);
+  samples = histogram->SnapshotDelta();
+  EXPECT_EQ(kCount, samples->TotalCount());
+  EXPECT_EQ(kCount, samples->GetCount(2));
+  EXPECT_EQ(2 * kCount, samples->sum());
+
+  histogram->Add(20);
+  samples = histogram->SnapshotFinalDelta();
+  EXPECT_EQ(1, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(20));
+}
+
+// Check that samples of many threads are all counted, both while the threads
+// run and once they have exited.
+TEST_P(HistogramTest, ThreadBufferedManyThreads) {
+  // One bucket per value, so that each thread's samples can be told apart.
+  HistogramBase* histogram =
+      LinearHistogram::FactoryGet("ThreadBufferedThreads", 1, 10, 11,
+                                  HistogramBase::kThreadBufferedFlag);
+  const int kThreadCount = 8;
+  const int kCountPerThread = 1000;
+
+  std::vector<std::unique_ptr<AddingDelegate>> delegates;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    delegates.push_back(
+        WrapUnique(new AddingDelegate(histogram, i + 1, kCountPerThread)));
+    threads.push_back(WrapUnique(
+        new DelegateSimpleThread(delegates.back().get(), "AddingThread")));
+  }
+  for (const auto& thread : threads)
+    thread->Start();
+
+  // Snapshots taken while threads add must not lose or repeat samples.
+  int64_t delta_count = histogram->SnapshotDelta()->TotalCount();
+  for (const auto& thread : threads)
+    thread->Join();
+  std::unique_ptr<HistogramSamples> samples = histogram->SnapshotDelta();
+  delta_count += samples->TotalCount();
+  EXPECT_EQ(kThreadCount * kCountPerThread, delta_count);
+
+  samples = histogram->SnapshotSamples();
+  EXPECT_EQ(kThreadCount * kCountPerThread, samples->TotalCount());
+  EXPECT_EQ(samples->TotalCount(), samples->redundant_count());
+  int64_t expected_sum = 0;
+  for (int i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(kCountPerThread, samples->GetCount(i + 1));
+    expected_sum += (i + 1) * kCountPerThread;
+  }
+  EXPECT_EQ(expected_sum, samples->sum());
+}
+
 TEST_P(HistogramTest, ExponentialRangesTest) {
   // Check that we got a nice exponential when there was enough room.
   BucketRanges ranges(9);
@@ -19,6 +19,7 @@
 #include "base/metrics/persistent_sample_map.h"
 #include "base/metrics/sparse_histogram.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/metrics/thread_sample_buffers.h"
 #include "base/pickle.h"
 #include "base/synchronization/lock.h"
 
@@ -825,6 +826,9 @@ bool GlobalHistogramAllocator::WriteToPersistentLocation() {
     return false;
   }
 
+  // Samples that threads still buffer are not in the memory yet.
+  ThreadSampleBuffers::FoldAll();
+
   StringPiece contents(static_cast<const char*>(data()), used());
   if (!ImportantFileWriter::WriteFileAtomically(persistent_location_,
                                                 contents)) {
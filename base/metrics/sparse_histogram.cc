@@ -12,6 +12,7 @@
 #include "base/metrics/persistent_sample_map.h"
 #include "base/metrics/sample_map.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/metrics/thread_sample_buffers.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/lock.h"
@@ -82,7 +83,10 @@ std::unique_ptr<HistogramBase> SparseHistogram::PersistentCreate(
       new SparseHistogram(allocator, name, meta, logged_meta));
 }
 
-SparseHistogram::~SparseHistogram() {}
+SparseHistogram::~SparseHistogram() {
+  if (flags() & kThreadBufferedFlag)
+    ThreadSampleBuffers::Forget(this);
+}
 
 uint64_t SparseHistogram::name_hash() const {
   return samples_->id();
@@ -109,7 +113,9 @@ void SparseHistogram::AddCount(Sample value, int count) {
     NOTREACHED();
     return;
   }
-  {
+  if (flags() & kThreadBufferedFlag) {
+    ThreadSampleBuffers::Accumulate(this, nullptr, value, count);
+  } else {
     base::AutoLock auto_lock(lock_);
     samples_->Accumulate(value, count);
   }
@@ -121,6 +127,7 @@ std::unique_ptr<HistogramSamples> SparseHistogram::SnapshotSamples() const {
   std::unique_ptr<SampleMap> snapshot(new SampleMap(name_hash()));
 
   base::AutoLock auto_lock(lock_);
+  FoldThreadBuffersLocked();
   snapshot->Add(*samples_);
   return std::move(snapshot);
 }
@@ -130,6 +137,7 @@ std::unique_ptr<HistogramSamples> SparseHistogram::SnapshotDelta() {
 
   std::unique_ptr<SampleMap> snapshot(new SampleMap(name_hash()));
   base::AutoLock auto_lock(lock_);
+  FoldThreadBuffersLocked();
   snapshot->Add(*samples_);
 
   // Subtract what was previously logged and update that information.
@@ -144,6 +152,7 @@ std::unique_ptr<HistogramSamples> SparseHistogram::SnapshotFinalDelta() const {
 
   std::unique_ptr<SampleMap> snapshot(new SampleMap(name_hash()));
   base::AutoLock auto_lock(lock_);
+  FoldThreadBuffersLocked();
   snapshot->Add(*samples_);
 
   // Subtract what was previously logged and then return.
@@ -223,6 +232,12 @@ void SparseHistogram::GetCountAndBucketData(Count* count,
   // TODO(kaiwang): Implement. (See HistogramBase::WriteJSON.)
 }
 
+void SparseHistogram::FoldThreadBuffersLocked() const {
+  lock_.AssertAcquired();
+  if (flags() & kThreadBufferedFlag)
+    ThreadSampleBuffers::Fold(this, samples_.get());
+}
+
 void SparseHistogram::WriteAsciiImpl(bool graph_it,
                                      const std::string& newline,
                                      std::string* output) const {
@@ -107,6 +107,9 @@ class BASE_EXPORT SparseHistogram : public HistogramBase {
                              int64_t* sum,
                              ListValue* buckets) const override;
 
+  // Moves the samples buffered by threads into |samples_|. Requires |lock_|.
+  void FoldThreadBuffersLocked() const;
+
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
   void WriteAsciiImpl(bool graph_it,
                       const std::string& newline,
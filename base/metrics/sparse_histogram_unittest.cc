@@ -6,7 +6,10 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
 #include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_samples.h"
 #include "base/metrics/persistent_histogram_allocator.h"
@@ -15,6 +18,7 @@
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -217,6 +221,72 @@ TEST_P(SparseHistogramTest, Serialize) {
   EXPECT_FALSE(iter.SkipBytes(1));
 }
 
+namespace {
+
+// Adds |count| samples of each of |values| to |histogram|.
+class SparseAddingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  SparseAddingDelegate(HistogramBase* histogram,
+                       const std::vector<int>& values,
+                       int count)
+      : histogram_(histogram), values_(values), count_(count) {}
+
+  // DelegateSimpleThread::Delegate:
+  void Run() override {
+    for (int i = 0; i < count_; ++i) {
+      for (int value : values_)
+        histogram_->Add(value);
+    }
+  }
+
+ private:
+  HistogramBase* const histogram_;
+  const std::vector<int> values_;
+  const int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(SparseAddingDelegate);
+};
+
+}  // namespace
+
+// Buffered samples must end up in the histogram's samples, which are held in
+// a PersistentSampleMap when a persistent allocator is used.
+TEST_P(SparseHistogramTest, ThreadBuffered) {
+  HistogramBase* histogram = SparseHistogram::FactoryGet(
+      "SparseThreadBuffered", HistogramBase::kThreadBufferedFlag);
+  histogram->AddCount(7, 3);
+  std::unique_ptr<HistogramSamples> snapshot = histogram->SnapshotDelta();
+  EXPECT_EQ(3, snapshot->TotalCount());
+  EXPECT_EQ(3, snapshot->GetCount(7));
+  EXPECT_EQ(21, snapshot->sum());
+
+  const int kThreadCount = 4;
+  const int kCount = 500;
+  std::vector<std::unique_ptr<SparseAddingDelegate>> delegates;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    std::vector<int> values = {1000, 2000 + i};
+    delegates.push_back(
+        WrapUnique(new SparseAddingDelegate(histogram, values, kCount)));
+    threads.push_back(WrapUnique(
+        new DelegateSimpleThread(delegates.back().get(), "AddingThread")));
+  }
+  for (const auto& thread : threads)
+    thread->Start();
+  for (const auto& thread : threads)
+    thread->Join();
+
+  snapshot = histogram->SnapshotDelta();
+  EXPECT_EQ(2 * kThreadCount * kCount, snapshot->TotalCount());
+  EXPECT_EQ(snapshot->TotalCount(), snapshot->redundant_count());
+  EXPECT_EQ(kThreadCount * kCount, snapshot->GetCount(1000));
+  for (int i = 0; i < kThreadCount; ++i)
+    EXPECT_EQ(kCount, snapshot->GetCount(2000 + i));
+
+  snapshot = histogram->SnapshotSamples();
+  EXPECT_EQ(2 * kThreadCount * kCount + 3, snapshot->TotalCount());
+}
+
 // Ensure that race conditions that cause multiple, identical sparse histograms
 // to be created will safely resolve to a single one.
 TEST_P(SparseHistogramTest, DuplicationSafety) {
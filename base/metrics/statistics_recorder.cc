@@ -4,10 +4,14 @@
 
 #include "base/metrics/statistics_recorder.h"
 
+#include <string.h>
+
 #include <memory>
 
 #include "base/at_exit.h"
+#include "base/atomicops.h"
 #include "base/debug/leak_annotations.h"
+#include "base/hash.h"
 #include "base/json/string_escape.h"
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
@@ -34,6 +38,126 @@ bool HistogramNameLesser(const base::HistogramBase* a,
 
 namespace base {
 
+// The index is split by name hash into shards, each an open-addressing table
+// with linear probing whose slots are published with release stores. Readers
+// probe without locking; writers are serialized by |lock_|. A shard that
+// fills up is replaced by a copy twice its size, and the old table is kept
+// until the index is destroyed since readers may still be probing it. Hashing
+// uses base::Hash() rather than HashMetricName(), whose MD5 would cost more
+// than the lookup itself.
+class StatisticsRecorder::HistogramIndex {
+ public:
+  HistogramIndex() { memset(shards_, 0, sizeof(shards_)); }
+  ~HistogramIndex() {}
+
+  // Returns the histogram named |name|, or null. Safe to call from any thread
+  // at any time.
+  HistogramBase* Find(StringPiece name) const {
+    const uint32_t hash = Hash(name.data(), name.size());
+    const Table* table = reinterpret_cast<const Table*>(
+        subtle::Acquire_Load(&shards_[ShardOf(hash)]));
+    if (!table)
+      return nullptr;
+    for (uint32_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+      const Slot& slot = table->slots[i];
+      HistogramBase* histogram = reinterpret_cast<HistogramBase*>(
+          subtle::Acquire_Load(&slot.histogram));
+      if (!histogram)
+        return nullptr;
+      if (slot.hash == hash && name == histogram->histogram_name())
+        return histogram;
+    }
+  }
+
+  // Adds |histogram|, whose name must not be in the index yet. The caller must
+  // hold |lock_|.
+  void Insert(HistogramBase* histogram) {
+    const uint32_t hash = Hash(histogram->histogram_name());
+    subtle::AtomicWord* shard = &shards_[ShardOf(hash)];
+    Table* table = reinterpret_cast<Table*>(subtle::NoBarrier_Load(shard));
+    // Keep tables at most 3/4 full, so that probe sequences stay short.
+    if (!table)
+      table = ReplaceTable(shard, kInitialTableSize, nullptr);
+    else if ((table->count + 1) * 4 > (table->mask + 1) * 3)
+      table = ReplaceTable(shard, (table->mask + 1) * 2, nullptr);
+    AddToTable(table, hash, histogram);
+  }
+
+  // Removes |histogram|, which must be in the index. The caller must hold
+  // |lock_|.
+  void Remove(HistogramBase* histogram) {
+    const uint32_t hash = Hash(histogram->histogram_name());
+    subtle::AtomicWord* shard = &shards_[ShardOf(hash)];
+    const Table* table =
+        reinterpret_cast<const Table*>(subtle::NoBarrier_Load(shard));
+    // Published slots never change, so rebuild the table without it.
+    ReplaceTable(shard, table->mask + 1, histogram);
+  }
+
+ private:
+  struct Slot {
+    uint32_t hash;
+    // The HistogramBase*, or 0 for an empty slot. |hash| is written first.
+    subtle::AtomicWord histogram;
+  };
+
+  struct Table {
+    explicit Table(uint32_t size)
+        : mask(size - 1), count(0), slots(new Slot[size]()) {}
+
+    const uint32_t mask;
+    uint32_t count;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  static const size_t kShardCount = 64;
+  static const uint32_t kInitialTableSize = 16;
+
+  // Shards by the high bits of the hash; tables probe from the low bits.
+  static size_t ShardOf(uint32_t hash) { return hash >> 26; }
+
+  static void AddToTable(Table* table,
+                         uint32_t hash,
+                         HistogramBase* histogram) {
+    uint32_t i = hash & table->mask;
+    while (subtle::NoBarrier_Load(&table->slots[i].histogram))
+      i = (i + 1) & table->mask;
+    table->slots[i].hash = hash;
+    subtle::Release_Store(&table->slots[i].histogram,
+                          reinterpret_cast<subtle::AtomicWord>(histogram));
+    ++table->count;
+  }
+
+  // Publishes a table of |size| slots holding the histograms of |shard|
+  // except |skip|, and returns it.
+  Table* ReplaceTable(subtle::AtomicWord* shard,
+                      uint32_t size,
+                      const HistogramBase* skip) {
+    const Table* old_table =
+        reinterpret_cast<const Table*>(subtle::NoBarrier_Load(shard));
+    Table* table = new Table(size);
+    if (old_table) {
+      for (uint32_t i = 0; i <= old_table->mask; ++i) {
+        const Slot& slot = old_table->slots[i];
+        HistogramBase* histogram = reinterpret_cast<HistogramBase*>(
+            subtle::NoBarrier_Load(&slot.histogram));
+        if (histogram && histogram != skip)
+          AddToTable(table, slot.hash, histogram);
+      }
+    }
+    tables_.push_back(WrapUnique(table));
+    subtle::Release_Store(shard, reinterpret_cast<subtle::AtomicWord>(table));
+    return table;
+  }
+
+  subtle::AtomicWord shards_[kShardCount];
+
+  // Every table ever published, including replaced ones.
+  std::vector<std::unique_ptr<Table>> tables_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramIndex);
+};
+
 StatisticsRecorder::HistogramIterator::HistogramIterator(
     const HistogramMap::iterator& iter, bool include_persistent)
     : iter_(iter),
@@ -87,6 +211,7 @@ StatisticsRecorder::~StatisticsRecorder() {
   Reset();
   base::AutoLock auto_lock(*lock_);
   histograms_ = existing_histograms_.release();
+  SetHistogramIndex(existing_histogram_index_);
   callbacks_ = existing_callbacks_.release();
   ranges_ = existing_ranges_.release();
 }
@@ -118,6 +243,19 @@ HistogramBase* StatisticsRecorder::RegisterOrDeleteDuplicate(
     return histogram;
   }
 
+  // Most duplicates, such as those of threads racing to create the same
+  // histogram, are found without taking the lock.
+  HistogramIndex* histogram_index = GetHistogramIndex();
+  if (histogram_index) {
+    HistogramBase* existing =
+        histogram_index->Find(histogram->histogram_name());
+    if (existing) {
+      if (existing != histogram)
+        delete histogram;
+      return existing;
+    }
+  }
+
   HistogramBase* histogram_to_delete = NULL;
   HistogramBase* histogram_to_return = NULL;
   {
@@ -131,6 +269,7 @@ HistogramBase* StatisticsRecorder::RegisterOrDeleteDuplicate(
         // The StringKey references the name within |histogram| rather than
         // making a copy.
         (*histograms_)[name] = histogram;
+        GetHistogramIndex()->Insert(histogram);
         ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
         // If there are callbacks for this histogram, we set the kCallbackExists
         // flag.
@@ -301,16 +440,10 @@ HistogramBase* StatisticsRecorder::FindHistogram(base::StringPiece name) {
   // will acquire the lock at that time.
   ImportGlobalPersistentHistograms();
 
-  if (lock_ == NULL)
-    return NULL;
-  base::AutoLock auto_lock(*lock_);
-  if (histograms_ == NULL)
-    return NULL;
-
-  HistogramMap::iterator it = histograms_->find(name);
-  if (histograms_->end() == it)
+  const HistogramIndex* histogram_index = GetHistogramIndex();
+  if (histogram_index == NULL)
     return NULL;
-  return it->second;
+  return histogram_index->Find(name);
 }
 
 // static
@@ -425,8 +558,14 @@ size_t StatisticsRecorder::GetHistogramCount() {
 
 // static
 void StatisticsRecorder::ForgetHistogramForTesting(base::StringPiece name) {
-  if (histograms_)
-    histograms_->erase(name);
+  if (!histograms_)
+    return;
+  base::AutoLock auto_lock(*lock_);
+  HistogramMap::iterator it = histograms_->find(name);
+  if (it == histograms_->end())
+    return;
+  GetHistogramIndex()->Remove(it->second);
+  histograms_->erase(it);
 }
 
 // static
@@ -483,10 +622,12 @@ StatisticsRecorder::StatisticsRecorder() {
   base::AutoLock auto_lock(*lock_);
 
   existing_histograms_.reset(histograms_);
+  existing_histogram_index_ = GetHistogramIndex();
   existing_callbacks_.reset(callbacks_);
   existing_ranges_.reset(ranges_);
 
   histograms_ = new HistogramMap;
+  SetHistogramIndex(new HistogramIndex);
   callbacks_ = new CallbackMap;
   ranges_ = new RangesMap;
 
@@ -519,8 +660,26 @@ void StatisticsRecorder::Reset() {
     histograms_ = NULL;
     callbacks_ = NULL;
     ranges_ = NULL;
+    // The index may still be used by readers, which don't take the lock.
+    HistogramIndex* histogram_index = GetHistogramIndex();
+    if (histogram_index)
+      ANNOTATE_LEAKING_OBJECT_PTR(histogram_index);
+    SetHistogramIndex(NULL);
   }
-  // We are going to leak the histograms and the ranges.
+  // We are going to leak the histograms, their index and the ranges.
+}
+
+// static
+StatisticsRecorder::HistogramIndex* StatisticsRecorder::GetHistogramIndex() {
+  return reinterpret_cast<HistogramIndex*>(
+      subtle::Acquire_Load(&histogram_index_));
+}
+
+// static
+void StatisticsRecorder::SetHistogramIndex(HistogramIndex* histogram_index) {
+  lock_->AssertAcquired();
+  subtle::Release_Store(&histogram_index_,
+                        reinterpret_cast<subtle::AtomicWord>(histogram_index));
 }
 
 // static
@@ -539,5 +698,7 @@ StatisticsRecorder::CallbackMap* StatisticsRecorder::callbacks_ = NULL;
 StatisticsRecorder::RangesMap* StatisticsRecorder::ranges_ = NULL;
 // static
 base::Lock* StatisticsRecorder::lock_ = NULL;
+// static
+subtle::AtomicWord StatisticsRecorder::histogram_index_ = 0;
 
 }  // namespace base
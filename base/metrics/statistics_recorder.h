@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/gtest_prod_util.h"
@@ -133,7 +134,8 @@ class BASE_EXPORT StatisticsRecorder {
   static void GetBucketRanges(std::vector<const BucketRanges*>* output);
 
   // Find a histogram by name. It matches the exact name. This method is thread
-  // safe.  It returns NULL if a matching histogram is not found.
+  // safe and takes no lock.  It returns NULL if a matching histogram is not
+  // found.
   static HistogramBase* FindHistogram(base::StringPiece name);
 
   // Support for iterating over known histograms.
@@ -200,6 +202,9 @@ class BASE_EXPORT StatisticsRecorder {
   // |bucket_ranges_|.
   typedef std::map<uint32_t, std::list<const BucketRanges*>*> RangesMap;
 
+  // Indexes |histograms_| by name for lookups that take no lock.
+  class HistogramIndex;
+
   friend struct DefaultLazyInstanceTraits<StatisticsRecorder>;
   friend class StatisticsRecorderTest;
 
@@ -207,6 +212,13 @@ class BASE_EXPORT StatisticsRecorder {
   // not be held during this call.
   static void ImportGlobalPersistentHistograms();
 
+  // Returns the current index, or null. Safe to call without the lock.
+  static HistogramIndex* GetHistogramIndex();
+
+  // Publishes |histogram_index| as the current index. The caller must hold the
+  // lock.
+  static void SetHistogramIndex(HistogramIndex* histogram_index);
+
   // The constructor just initializes static members. Usually client code should
   // use Initialize to do this. But in test code, you can friend this class and
   // call the constructor to get a clean StatisticsRecorder.
@@ -220,6 +232,7 @@ class BASE_EXPORT StatisticsRecorder {
   // Recorder was created. The global ones have to be moved aside to create a
   // clean environment.
   std::unique_ptr<HistogramMap> existing_histograms_;
+  HistogramIndex* existing_histogram_index_ = nullptr;
   std::unique_ptr<CallbackMap> existing_callbacks_;
   std::unique_ptr<RangesMap> existing_ranges_;
 
@@ -232,8 +245,12 @@ class BASE_EXPORT StatisticsRecorder {
   static CallbackMap* callbacks_;
   static RangesMap* ranges_;
 
-  // Lock protects access to above maps.
+  // Lock protects access to above maps, and serializes changes to
+  // |histogram_index_|, the HistogramIndex* which is read without it. The index
+  // is only replaced while a StatisticsRecorder is created or destroyed, and
+  // is never deleted since a reader may still be using it.
   static base::Lock* lock_;
+  static subtle::AtomicWord histogram_index_;
 
   DISALLOW_COPY_AND_ASSIGN(StatisticsRecorder);
 };
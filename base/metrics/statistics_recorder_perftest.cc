@@ -0,0 +1,108 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/format_macros.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kThreadCount = 32;
+
+// Gets every histogram of |names| through Histogram::FactoryGet(), the way
+// code that builds histogram names at runtime does, |rounds| times. Each
+// thread starts at a different name, so the first round races to create the
+// histograms and later rounds only look them up.
+class FactoryGetDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  FactoryGetDelegate(const std::vector<std::string>* names,
+                     size_t first,
+                     int rounds)
+      : names_(names), first_(first), rounds_(rounds) {}
+
+  // DelegateSimpleThread::Delegate:
+  void Run() override {
+    const size_t count = names_->size();
+    for (int round = 0; round < rounds_; ++round) {
+      for (size_t i = 0; i < count; ++i) {
+        HistogramBase* histogram = Histogram::FactoryGet(
+            (*names_)[(first_ + i) % count], 1, 1000, 50,
+            HistogramBase::kNoFlags);
+        histogram->Add(static_cast<int>(i));
+      }
+    }
+  }
+
+ private:
+  const std::vector<std::string>* const names_;
+  const size_t first_;
+  const int rounds_;
+
+  DISALLOW_COPY_AND_ASSIGN(FactoryGetDelegate);
+};
+
+void RunFactoryGetPerfTest(const std::string& trace,
+                           size_t histogram_count,
+                           int rounds) {
+  std::unique_ptr<StatisticsRecorder> statistics_recorder =
+      StatisticsRecorder::CreateTemporaryForTesting();
+
+  std::vector<std::string> names;
+  for (size_t i = 0; i < histogram_count; ++i)
+    names.push_back(StringPrintf("Perf.Dynamic.Histogram%" PRIuS, i));
+
+  std::vector<std::unique_ptr<FactoryGetDelegate>> delegates;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    delegates.push_back(WrapUnique(new FactoryGetDelegate(
+        &names, histogram_count * i / kThreadCount, rounds)));
+    threads.push_back(WrapUnique(
+        new DelegateSimpleThread(delegates.back().get(), "FactoryGetThread")));
+  }
+
+  TimeTicks start = TimeTicks::Now();
+  for (const auto& thread : threads)
+    thread->Start();
+  for (const auto& thread : threads)
+    thread->Join();
+  TimeDelta elapsed = TimeTicks::Now() - start;
+
+  EXPECT_EQ(histogram_count, StatisticsRecorder::GetHistogramCount());
+
+  // The calls of all threads overlap, so report the throughput.
+  const double calls =
+      static_cast<double>(histogram_count) * rounds * kThreadCount;
+  perf_test::PrintResult("statistics_recorder_factory_get", "", trace,
+                         elapsed.InMicroseconds() * 1000.0 / calls,
+                         "ns/call", true);
+}
+
+}  // namespace
+
+// Mostly creation: each thread gets every histogram once.
+TEST(StatisticsRecorderPerfTest, CreateFromManyThreads) {
+  RunFactoryGetPerfTest("create_4000x1", 4000, 1);
+}
+
+// Mostly lookups of histograms that already exist.
+TEST(StatisticsRecorderPerfTest, LookUpFromManyThreads) {
+  RunFactoryGetPerfTest("lookup_4000x20", 4000, 20);
+}
+
+}  // namespace base
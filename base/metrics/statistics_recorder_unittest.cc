@@ -12,9 +12,12 @@
 #include "base/bind.h"
 #include "base/json/json_reader.h"
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/persistent_histogram_allocator.h"
 #include "base/metrics/sparse_histogram.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "base/values.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -246,6 +249,95 @@ TEST_P(StatisticsRecorderTest, FindHistogram) {
   EXPECT_FALSE(StatisticsRecorder::FindHistogram("TestHistogram"));
 }
 
+TEST_P(StatisticsRecorderTest, FindAmongManyHistograms) {
+  const int kHistogramCount = 1000;
+  std::vector<HistogramBase*> histograms;
+  for (int i = 0; i < kHistogramCount; ++i) {
+    histograms.push_back(StatisticsRecorder::RegisterOrDeleteDuplicate(
+        CreateHistogram(StringPrintf("TestHistogram.%d", i), 1, 1000, 10)));
+  }
+  for (int i = 0; i < kHistogramCount; ++i) {
+    EXPECT_EQ(histograms[i], StatisticsRecorder::FindHistogram(
+                                 StringPrintf("TestHistogram.%d", i)));
+  }
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("TestHistogram."));
+
+  // A duplicate resolves to the registered histogram.
+  HistogramBase* duplicate = CreateHistogram("TestHistogram.7", 1, 1000, 10);
+  EXPECT_EQ(histograms[7],
+            StatisticsRecorder::RegisterOrDeleteDuplicate(duplicate));
+
+  // Forgotten histograms are no longer found, and the others still are.
+  for (int i = 0; i < kHistogramCount; i += 3) {
+    StatisticsRecorder::ForgetHistogramForTesting(
+        StringPrintf("TestHistogram.%d", i));
+  }
+  for (int i = 0; i < kHistogramCount; ++i) {
+    EXPECT_EQ(i % 3 ? histograms[i] : nullptr,
+              StatisticsRecorder::FindHistogram(
+                  StringPrintf("TestHistogram.%d", i)));
+  }
+  EXPECT_EQ(static_cast<size_t>(kHistogramCount - (kHistogramCount + 2) / 3),
+            StatisticsRecorder::GetHistogramCount());
+}
+
+namespace {
+
+// Registers histograms with shared names, and records what it got back.
+class RegisteringDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  explicit RegisteringDelegate(int histogram_count)
+      : histogram_count_(histogram_count) {}
+
+  const std::vector<HistogramBase*>& histograms() const { return histograms_; }
+
+  // DelegateSimpleThread::Delegate:
+  void Run() override {
+    for (int i = 0; i < histogram_count_; ++i) {
+      histograms_.push_back(Histogram::FactoryGet(
+          StringPrintf("TestHistogram.%d", i), 1, 1000, 10,
+          HistogramBase::kNoFlags));
+    }
+  }
+
+ private:
+  const int histogram_count_;
+  std::vector<HistogramBase*> histograms_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegisteringDelegate);
+};
+
+}  // namespace
+
+TEST_P(StatisticsRecorderTest, RegisterConcurrently) {
+  // Few enough for the persistent allocator's memory.
+  const int kHistogramCount = 50;
+  const int kThreadCount = 8;
+
+  std::vector<std::unique_ptr<RegisteringDelegate>> delegates;
+  for (int i = 0; i < kThreadCount; ++i)
+    delegates.push_back(WrapUnique(new RegisteringDelegate(kHistogramCount)));
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (const auto& delegate : delegates) {
+    threads.push_back(WrapUnique(
+        new DelegateSimpleThread(delegate.get(), "RegisteringThread")));
+    threads.back()->Start();
+  }
+  for (const auto& thread : threads)
+    thread->Join();
+
+  // Every thread got the same histogram for each name.
+  for (int i = 0; i < kHistogramCount; ++i) {
+    HistogramBase* histogram =
+        StatisticsRecorder::FindHistogram(StringPrintf("TestHistogram.%d", i));
+    ASSERT_TRUE(histogram);
+    for (const auto& delegate : delegates)
+      EXPECT_EQ(histogram, delegate->histograms()[i]);
+  }
+  EXPECT_EQ(static_cast<size_t>(kHistogramCount),
+            StatisticsRecorder::GetHistogramCount());
+}
+
 TEST_P(StatisticsRecorderTest, GetSnapshot) {
   Histogram::FactoryGet("TestHistogram1", 1, 1000, 10, Histogram::kNoFlags);
   Histogram::FactoryGet("TestHistogram2", 1, 1000, 10, Histogram::kNoFlags);
@@ -0,0 +1,410 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/thread_sample_buffers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace base {
+
+typedef HistogramBase::Count Count;
+typedef HistogramBase::Sample Sample;
+
+namespace {
+
+// A count that only its thread changes, with plain loads and stores, and that
+// other threads read. |folded| is the part already moved into the histogram;
+// it is guarded by the lock of the thread's buffers.
+struct BufferedCount {
+  BufferedCount() : count(0), folded(0) {}
+
+  // Adds |delta| from the owning thread.
+  void Add(Count delta) {
+    subtle::NoBarrier_Store(&count, subtle::NoBarrier_Load(&count) + delta);
+  }
+
+  // Returns what was added since the previous call.
+  Count TakeDelta() {
+    Count current = subtle::Acquire_Load(&count);
+    Count delta = current - folded;
+    folded = current;
+    return delta;
+  }
+
+  HistogramBase::AtomicCount count;
+  Count folded;
+};
+
+// The samples one thread buffered for one histogram.
+struct Buffer {
+  explicit Buffer(const BucketRanges* bucket_ranges)
+      : bucket_ranges(bucket_ranges),
+        bucket_counts(bucket_ranges ? bucket_ranges->bucket_count() : 0),
+        sum(0),
+        folded_sum(0),
+        unfolded(0),
+        forgotten(0) {}
+
+  // The buckets of a Histogram, or null if every value is its own bucket, as
+  // in a SparseHistogram.
+  const BucketRanges* const bucket_ranges;
+
+  // Indexed like |bucket_ranges|, or keyed by value when there are none. New
+  // values are only inserted under the lock of the thread's buffers.
+  std::vector<BufferedCount> bucket_counts;
+  std::map<Sample, BufferedCount> value_counts;
+
+  // Only the owning thread writes these.
+  BufferedCount total;
+#ifdef ARCH_CPU_64_BITS
+  subtle::Atomic64 sum;
+#else
+  // As in HistogramSamples::Metadata, a torn read is accepted. It is made up
+  // for by the next fold.
+  int64_t sum;
+#endif
+  int64_t folded_sum;  // Guarded like BufferedCount::folded.
+  Count unfolded;      // Samples added since the owner last folded.
+
+  // Set when the histogram is destroyed. The buffer is then never folded,
+  // and is replaced if a new histogram reuses the address.
+  subtle::Atomic32 forgotten;
+};
+
+// The buffers of one thread. The thread looks them up and adds to them
+// without locking; |lock| serializes changes to the maps with other threads
+// reading them, and guards everything that is only used for folding.
+struct ThreadBuffers {
+  Lock lock;
+  std::unordered_map<const HistogramBase*, std::unique_ptr<Buffer>> buffers;
+};
+
+// Samples that were taken out of buffers, in the form HistogramSamples::Add()
+// expects: sorted (min, max, count) entries plus the sum and total count.
+class SampleDelta : public HistogramSamples {
+ public:
+  struct Entry {
+    Sample min;
+    Sample max;
+    Count count;
+  };
+
+  SampleDelta() : HistogramSamples(0) {}
+  ~SampleDelta() override {}
+
+  // Takes what was added to |buffer| since it was last folded. Requires the
+  // lock of the thread owning |buffer|.
+  void TakeFrom(Buffer* buffer) {
+    // The total is read before the counts, so that it is never ahead of them.
+    IncreaseRedundantCount(buffer->total.TakeDelta());
+#ifdef ARCH_CPU_64_BITS
+    int64_t sum = subtle::NoBarrier_Load(&buffer->sum);
+#else
+    int64_t sum = buffer->sum;
+#endif
+    IncreaseSum(sum - buffer->folded_sum);
+    buffer->folded_sum = sum;
+
+    if (buffer->bucket_ranges) {
+      for (size_t i = 0; i < buffer->bucket_counts.size(); ++i) {
+        Count count = buffer->bucket_counts[i].TakeDelta();
+        if (count) {
+          entries_.push_back({buffer->bucket_ranges->range(i),
+                              buffer->bucket_ranges->range(i + 1), count});
+        }
+      }
+    } else {
+      for (auto& value_and_count : buffer->value_counts) {
+        Count count = value_and_count.second.TakeDelta();
+        if (count) {
+          entries_.push_back(
+              {value_and_count.first, value_and_count.first + 1, count});
+        }
+      }
+    }
+  }
+
+  bool empty() const {
+    return entries_.empty() && !sum() && !redundant_count();
+  }
+
+  // HistogramSamples:
+  void Accumulate(Sample value, Count count) override { NOTREACHED(); }
+  Count GetCount(Sample value) const override {
+    NOTREACHED();
+    return 0;
+  }
+  Count TotalCount() const override {
+    Count total = 0;
+    for (const Entry& entry : entries_)
+      total += entry.count;
+    return total;
+  }
+  std::unique_ptr<SampleCountIterator> Iterator() const override {
+    return WrapUnique(new EntryIterator(&entries_));
+  }
+
+ protected:
+  bool AddSubtractImpl(SampleCountIterator* iter, Operator op) override {
+    NOTREACHED();
+    return false;
+  }
+
+ private:
+  class EntryIterator : public SampleCountIterator {
+   public:
+    explicit EntryIterator(const std::vector<Entry>* entries)
+        : entries_(entries), index_(0) {}
+
+    // SampleCountIterator:
+    bool Done() const override { return index_ >= entries_->size(); }
+    void Next() override { ++index_; }
+    void Get(Sample* min, Sample* max, Count* count) const override {
+      const Entry& entry = (*entries_)[index_];
+      if (min)
+        *min = entry.min;
+      if (max)
+        *max = entry.max;
+      if (count)
+        *count = entry.count;
+    }
+
+   private:
+    const std::vector<Entry>* const entries_;
+    size_t index_;
+  };
+
+  std::vector<Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleDelta);
+};
+
+typedef std::vector<std::pair<HistogramBase*, std::unique_ptr<SampleDelta>>>
+    TakenDeltas;
+
+void OnThreadExit(void* value);
+
+struct Registry {
+  Registry() : slot(&OnThreadExit) {}
+
+  // Protects |threads|, and must be held to reach the buffers of threads
+  // other than the current one.
+  Lock lock;
+  std::vector<ThreadBuffers*> threads;
+
+  ThreadLocalStorage::Slot slot;
+};
+
+LazyInstance<Registry>::Leaky g_registry = LAZY_INSTANCE_INITIALIZER;
+
+// Takes the deltas of all live buffers of |thread_buffers|, whose lock must
+// be held.
+void TakeAllDeltas(ThreadBuffers* thread_buffers, TakenDeltas* taken) {
+  for (const auto& entry : thread_buffers->buffers) {
+    Buffer* buffer = entry.second.get();
+    if (subtle::NoBarrier_Load(&buffer->forgotten))
+      continue;
+    std::unique_ptr<SampleDelta> delta(new SampleDelta);
+    delta->TakeFrom(buffer);
+    if (!delta->empty()) {
+      taken->push_back(std::make_pair(
+          const_cast<HistogramBase*>(entry.first), std::move(delta)));
+    }
+  }
+}
+
+// Adds each delta to its histogram. No buffer lock may be held, since
+// HistogramBase::AddSamples() may take the histogram's lock.
+void AddToHistograms(const TakenDeltas& taken) {
+  for (const auto& histogram_and_delta : taken)
+    histogram_and_delta.first->AddSamples(*histogram_and_delta.second);
+}
+
+void OnThreadExit(void* value) {
+  std::unique_ptr<ThreadBuffers> thread_buffers(
+      static_cast<ThreadBuffers*>(value));
+  Registry* registry = g_registry.Pointer();
+  TakenDeltas taken;
+  {
+    AutoLock registry_lock(registry->lock);
+    registry->threads.erase(std::find(registry->threads.begin(),
+                                      registry->threads.end(),
+                                      thread_buffers.get()));
+    AutoLock lock(thread_buffers->lock);
+    TakeAllDeltas(thread_buffers.get(), &taken);
+  }
+  AddToHistograms(taken);
+}
+
+ThreadBuffers* GetThreadBuffers() {
+  Registry* registry = g_registry.Pointer();
+  ThreadBuffers* thread_buffers =
+      static_cast<ThreadBuffers*>(registry->slot.Get());
+  if (!thread_buffers) {
+    thread_buffers = new ThreadBuffers;
+    {
+      AutoLock registry_lock(registry->lock);
+      registry->threads.push_back(thread_buffers);
+    }
+    registry->slot.Set(thread_buffers);
+  }
+  return thread_buffers;
+}
+
+// Returns the calling thread's buffer for |histogram|, creating it if needed.
+Buffer* GetBuffer(ThreadBuffers* thread_buffers,
+                  const HistogramBase* histogram,
+                  const BucketRanges* bucket_ranges) {
+  // Only this thread changes the map, so it can read it without the lock.
+  auto it = thread_buffers->buffers.find(histogram);
+  if (it != thread_buffers->buffers.end() &&
+      !subtle::NoBarrier_Load(&it->second->forgotten)) {
+    return it->second.get();
+  }
+
+  std::unique_ptr<Buffer> buffer(new Buffer(bucket_ranges));
+  Buffer* raw_buffer = buffer.get();
+  AutoLock lock(thread_buffers->lock);
+  thread_buffers->buffers[histogram] = std::move(buffer);
+  return raw_buffer;
+}
+
+// Returns the count of the bucket holding |value| in |buffer|.
+BufferedCount* GetBufferedCount(ThreadBuffers* thread_buffers,
+                                Buffer* buffer,
+                                Sample value) {
+  const BucketRanges* bucket_ranges = buffer->bucket_ranges;
+  if (bucket_ranges) {
+    // Find the last bucket whose minimum is not above |value|.
+    size_t under = 0;
+    size_t over = bucket_ranges->bucket_count();
+    while (over - under > 1) {
+      size_t mid = under + (over - under) / 2;
+      if (bucket_ranges->range(mid) <= value)
+        under = mid;
+      else
+        over = mid;
+    }
+    return &buffer->bucket_counts[under];
+  }
+
+  auto it = buffer->value_counts.find(value);
+  if (it != buffer->value_counts.end())
+    return &it->second;
+  AutoLock lock(thread_buffers->lock);
+  return &buffer->value_counts[value];
+}
+
+}  // namespace
+
+// static
+const Count ThreadSampleBuffers::kMaxBufferedSamples = 256;
+
+// static
+void ThreadSampleBuffers::Accumulate(HistogramBase* histogram,
+                                     const BucketRanges* bucket_ranges,
+                                     Sample value,
+                                     Count count) {
+  ThreadBuffers* thread_buffers = GetThreadBuffers();
+  Buffer* buffer = GetBuffer(thread_buffers, histogram, bucket_ranges);
+  DCHECK_EQ(bucket_ranges, buffer->bucket_ranges);
+
+  // The bucket count is updated before the total, which other threads read
+  // first.
+  GetBufferedCount(thread_buffers, buffer, value)->Add(count);
+#ifdef ARCH_CPU_64_BITS
+  subtle::NoBarrier_Store(&buffer->sum,
+                          subtle::NoBarrier_Load(&buffer->sum) +
+                              static_cast<int64_t>(count) * value);
+  subtle::Release_Store(&buffer->total.count,
+                        subtle::NoBarrier_Load(&buffer->total.count) + count);
+#else
+  buffer->sum += static_cast<int64_t>(count) * value;
+  subtle::Release_Store(&buffer->total.count,
+                        subtle::NoBarrier_Load(&buffer->total.count) + count);
+#endif
+
+  buffer->unfolded += count;
+  if (buffer->unfolded < kMaxBufferedSamples)
+    return;
+  buffer->unfolded = 0;
+
+  SampleDelta delta;
+  {
+    AutoLock lock(thread_buffers->lock);
+    delta.TakeFrom(buffer);
+  }
+  if (!delta.empty())
+    histogram->AddSamples(delta);
+}
+
+// static
+void ThreadSampleBuffers::Fold(const HistogramBase* histogram,
+                               HistogramSamples* samples) {
+  std::vector<std::unique_ptr<SampleDelta>> taken;
+  Registry* registry = g_registry.Pointer();
+  {
+    AutoLock registry_lock(registry->lock);
+    for (ThreadBuffers* thread_buffers : registry->threads) {
+      AutoLock lock(thread_buffers->lock);
+      auto it = thread_buffers->buffers.find(histogram);
+      if (it == thread_buffers->buffers.end() ||
+          subtle::NoBarrier_Load(&it->second->forgotten)) {
+        continue;
+      }
+      std::unique_ptr<SampleDelta> delta(new SampleDelta);
+      delta->TakeFrom(it->second.get());
+      if (!delta->empty())
+        taken.push_back(std::move(delta));
+    }
+  }
+
+  for (const auto& delta : taken)
+    samples->Add(*delta);
+}
+
+// static
+void ThreadSampleBuffers::FoldAll() {
+  TakenDeltas taken;
+  Registry* registry = g_registry.Pointer();
+  {
+    AutoLock registry_lock(registry->lock);
+    for (ThreadBuffers* thread_buffers : registry->threads) {
+      AutoLock lock(thread_buffers->lock);
+      TakeAllDeltas(thread_buffers, &taken);
+    }
+  }
+  AddToHistograms(taken);
+}
+
+// static
+void ThreadSampleBuffers::Forget(const HistogramBase* histogram) {
+  Registry* registry = g_registry.Pointer();
+  AutoLock registry_lock(registry->lock);
+  for (ThreadBuffers* thread_buffers : registry->threads) {
+    AutoLock lock(thread_buffers->lock);
+    auto it = thread_buffers->buffers.find(histogram);
+    if (it != thread_buffers->buffers.end())
+      subtle::NoBarrier_Store(&it->second->forgotten, 1);
+  }
+}
+
+}  // namespace base
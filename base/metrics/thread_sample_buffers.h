@@ -0,0 +1,65 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// ThreadSampleBuffers keeps the samples of histograms created with
+// HistogramBase::kThreadBufferedFlag in per-thread buffers. Threads adding to
+// the same hot histogram then update only memory of their own instead of
+// bouncing the cache lines of the shared counts between cores.
+//
+// Buffered samples are moved into the histogram's own samples when:
+//   - the histogram takes a snapshot, which folds the buffers of all threads;
+//   - a thread has buffered kMaxBufferedSamples samples for the histogram;
+//   - a thread exits;
+//   - FoldAll() is called, e.g. before persistent memory is written out.
+// Readers that look at a histogram's memory directly, such as another process
+// mapping a persistent allocator, therefore see the samples of each thread
+// with a bounded delay.
+
+#ifndef BASE_METRICS_THREAD_SAMPLE_BUFFERS_H_
+#define BASE_METRICS_THREAD_SAMPLE_BUFFERS_H_
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/metrics/histogram_base.h"
+
+namespace base {
+
+class BucketRanges;
+class HistogramSamples;
+
+class BASE_EXPORT ThreadSampleBuffers {
+ public:
+  // A thread folds its buffer of a histogram once it holds this many samples.
+  static const HistogramBase::Count kMaxBufferedSamples;
+
+  // Adds |count| samples of |value| to the calling thread's buffer for
+  // |histogram|, creating the buffer if needed. |bucket_ranges| are the
+  // buckets of |histogram|, or null if every value is its own bucket, as in a
+  // SparseHistogram. The buffer is only written by its thread, with plain
+  // loads and stores.
+  static void Accumulate(HistogramBase* histogram,
+                         const BucketRanges* bucket_ranges,
+                         HistogramBase::Sample value,
+                         HistogramBase::Count count);
+
+  // Moves the samples that all threads buffered for |histogram| into
+  // |samples|, which must be the histogram's own samples. The caller must
+  // hold any lock guarding |samples|.
+  static void Fold(const HistogramBase* histogram, HistogramSamples* samples);
+
+  // Moves the samples buffered for every histogram into the histograms, using
+  // HistogramBase::AddSamples().
+  static void FoldAll();
+
+  // Drops the buffers of |histogram|, which is being destroyed. Histograms
+  // must not be destroyed while other threads add to them.
+  static void Forget(const HistogramBase* histogram);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ThreadSampleBuffers);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_THREAD_SAMPLE_BUFFERS_H_
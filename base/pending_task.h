@@ -5,18 +5,20 @@
 #ifndef BASE_PENDING_TASK_H_
 #define BASE_PENDING_TASK_H_
 
+#include <deque>
 #include <queue>
 
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/location.h"
+#include "base/memory/small_object_pool.h"
 #include "base/time/time.h"
 #include "base/tracking_info.h"
 
 namespace base {
 
-// Contains data about a pending task. Stored in TaskQueue and DelayedTaskQueue
-// for use by classes that queue and execute tasks.
+// Contains data about a pending task. Stored in TaskQueue and TimingWheel for
+// use by classes that queue and execute tasks.
 struct BASE_EXPORT PendingTask : public TrackingInfo {
   PendingTask(const tracked_objects::Location& posted_from,
               Closure task);
@@ -48,10 +50,11 @@ struct BASE_EXPORT PendingTask : public TrackingInfo {
   bool is_high_res;
 };
 
-using TaskQueue = std::queue<PendingTask>;
-
-// PendingTasks are sorted by their |delayed_run_time| property.
-using DelayedTaskQueue = std::priority_queue<base::PendingTask>;
+// The blocks of task queues are allocated and freed as tasks flow through
+// them, so they come from SmallObjectPool.
+using TaskQueue = std::queue<
+    PendingTask,
+    std::deque<PendingTask, SmallObjectPoolAllocator<PendingTask>>>;
 
 }  // namespace base
 
@@ -8,6 +8,7 @@
 
 #include <algorithm>  // for max()
 #include <limits>
+#include <utility>
 
 #include "base/bits.h"
 #include "base/macros.h"
@@ -19,12 +20,24 @@ namespace base {
 // static
 const int Pickle::kPayloadUnit = 64;
 
+// static
+const size_t Pickle::kMinExternalDataSize = 4096;
+
 static const size_t kCapacityReadOnly = static_cast<size_t>(-1);
 
+// static
+const size_t PickleIterator::kNoExternalData = static_cast<size_t>(-1);
+
 PickleIterator::PickleIterator(const Pickle& pickle)
     : payload_(pickle.payload()),
       read_index_(0),
-      end_index_(pickle.payload_size()) {
+      end_index_(pickle.payload_size()),
+      pickle_(&pickle),
+      next_external_index_(0),
+      next_external_offset_(pickle.external_data_.empty()
+                                ? kNoExternalData
+                                : pickle.external_data_[0].offset),
+      external_read_offset_(0) {
 }
 
 template <typename Type>
@@ -50,6 +63,8 @@ inline void PickleIterator::Advance(size_t size) {
 
 template<typename Type>
 inline const char* PickleIterator::GetReadPointerAndAdvance() {
+  if (read_index_ == next_external_offset_)
+    return ReadExternalData(sizeof(Type));
   if (sizeof(Type) > end_index_ - read_index_) {
     read_index_ = end_index_;
     return NULL;
@@ -60,6 +75,8 @@ inline const char* PickleIterator::GetReadPointerAndAdvance() {
 }
 
 const char* PickleIterator::GetReadPointerAndAdvance(int num_bytes) {
+  if (read_index_ == next_external_offset_)
+    return ReadExternalData(num_bytes);
   if (num_bytes < 0 ||
       end_index_ - read_index_ < static_cast<size_t>(num_bytes)) {
     read_index_ = end_index_;
@@ -70,6 +87,32 @@ const char* PickleIterator::GetReadPointerAndAdvance(int num_bytes) {
   return current_read_ptr;
 }
 
+const char* PickleIterator::ReadExternalData(int num_bytes) {
+  const Pickle::ExternalData& external =
+      pickle_->external_data_[next_external_index_];
+  const size_t size = external.data->size();
+  if (num_bytes < 0 ||
+      size - external_read_offset_ < static_cast<size_t>(num_bytes)) {
+    read_index_ = end_index_;
+    next_external_offset_ = kNoExternalData;
+    return NULL;
+  }
+  const char* current_read_ptr =
+      external.data->front_as<char>() + external_read_offset_;
+  // Skip padding like Advance() does, so that reads see the same bytes as in
+  // the flattened pickle.
+  external_read_offset_ += bits::Align(num_bytes, sizeof(uint32_t));
+  if (external_read_offset_ >= size) {
+    external_read_offset_ = 0;
+    ++next_external_index_;
+    next_external_offset_ =
+        next_external_index_ < pickle_->external_data_.size()
+            ? pickle_->external_data_[next_external_index_].offset
+            : kNoExternalData;
+  }
+  return current_read_ptr;
+}
+
 inline const char* PickleIterator::GetReadPointerAndAdvance(
     int num_elements,
     size_t size_element) {
@@ -250,13 +293,22 @@ Pickle::Attachment::Attachment() {}
 
 Pickle::Attachment::~Attachment() {}
 
+Pickle::ExternalData::ExternalData(size_t offset,
+                                   scoped_refptr<RefCountedMemory> data)
+    : offset(offset), data(std::move(data)) {}
+
+Pickle::ExternalData::ExternalData(const ExternalData& other) = default;
+
+Pickle::ExternalData::~ExternalData() {}
+
 // Payload is uint32_t aligned.
 
 Pickle::Pickle()
     : header_(NULL),
       header_size_(sizeof(Header)),
       capacity_after_header_(0),
-      write_offset_(0) {
+      write_offset_(0),
+      external_data_size_(0) {
   static_assert((Pickle::kPayloadUnit & (Pickle::kPayloadUnit - 1)) == 0,
                 "Pickle::kPayloadUnit must be a power of two");
   Resize(kPayloadUnit);
@@ -267,7 +319,8 @@ Pickle::Pickle(int header_size)
     : header_(NULL),
       header_size_(bits::Align(header_size, sizeof(uint32_t))),
       capacity_after_header_(0),
-      write_offset_(0) {
+      write_offset_(0),
+      external_data_size_(0) {
   DCHECK_GE(static_cast<size_t>(header_size), sizeof(Header));
   DCHECK_LE(header_size, kPayloadUnit);
   Resize(kPayloadUnit);
@@ -278,7 +331,8 @@ Pickle::Pickle(const char* data, int data_len)
     : header_(reinterpret_cast<Header*>(const_cast<char*>(data))),
       header_size_(0),
       capacity_after_header_(kCapacityReadOnly),
-      write_offset_(0) {
+      write_offset_(0),
+      external_data_size_(0) {
   if (data_len >= static_cast<int>(sizeof(Header)))
     header_size_ = data_len - header_->payload_size;
 
@@ -297,7 +351,9 @@ Pickle::Pickle(const Pickle& other)
     : header_(NULL),
       header_size_(other.header_size_),
       capacity_after_header_(0),
-      write_offset_(other.write_offset_) {
+      write_offset_(other.write_offset_),
+      external_data_(other.external_data_),
+      external_data_size_(other.external_data_size_) {
   Resize(other.header_->payload_size);
   memcpy(header_, other.header_, header_size_ + other.header_->payload_size);
 }
@@ -325,6 +381,8 @@ Pickle& Pickle::operator=(const Pickle& other) {
   memcpy(header_, other.header_,
          other.header_size_ + other.header_->payload_size);
   write_offset_ = other.write_offset_;
+  external_data_ = other.external_data_;
+  external_data_size_ = other.external_data_size_;
   return *this;
 }
 
@@ -352,6 +410,82 @@ bool Pickle::WriteBytes(const void* data, int length) {
   return true;
 }
 
+bool Pickle::WriteExternalData(scoped_refptr<RefCountedMemory> data) {
+  const size_t length = data->size();
+  if (length > static_cast<size_t>(std::numeric_limits<int>::max()))
+    return false;
+  if (length < kMinExternalDataSize)
+    return WriteData(data->front_as<char>(), static_cast<int>(length));
+
+  WriteInt(static_cast<int>(length));
+  external_data_size_ += bits::Align(length, sizeof(uint32_t));
+  external_data_.push_back(ExternalData(write_offset_, std::move(data)));
+  return true;
+}
+
+void Pickle::GetSerializedSegments(std::vector<Segment>* segments) {
+  segments->clear();
+  if (external_data_.empty()) {
+    segments->push_back({static_cast<const char*>(data()), size()});
+    return;
+  }
+
+  // Padding never exceeds three bytes.
+  static const char kPadding[sizeof(uint32_t)] = {};
+
+  serialized_header_.reset(new char[header_size_]);
+  memcpy(serialized_header_.get(), header_, header_size_);
+  reinterpret_cast<Header*>(serialized_header_.get())->payload_size =
+      static_cast<uint32_t>(header_->payload_size + external_data_size_);
+  segments->push_back({serialized_header_.get(), header_size_});
+
+  size_t inline_offset = 0;
+  for (const ExternalData& external : external_data_) {
+    if (external.offset > inline_offset) {
+      segments->push_back(
+          {payload() + inline_offset, external.offset - inline_offset});
+      inline_offset = external.offset;
+    }
+    const size_t length = external.data->size();
+    segments->push_back({external.data->front_as<char>(), length});
+    const size_t padding = bits::Align(length, sizeof(uint32_t)) - length;
+    if (padding)
+      segments->push_back({kPadding, padding});
+  }
+  if (write_offset_ > inline_offset)
+    segments->push_back(
+        {payload() + inline_offset, write_offset_ - inline_offset});
+}
+
+void Pickle::Flatten() {
+  if (external_data_.empty())
+    return;
+
+  std::vector<ExternalData> external_data;
+  external_data.swap(external_data_);
+  const size_t external_data_size = external_data_size_;
+  external_data_size_ = 0;
+  serialized_header_.reset();
+
+  // Rewrite the payload with the external bytes inline. Only the inline part,
+  // which is small next to the external data, is copied twice.
+  const size_t inline_size = write_offset_;
+  std::unique_ptr<char[]> inline_payload(new char[inline_size]);
+  memcpy(inline_payload.get(), payload(), inline_size);
+  write_offset_ = 0;
+  header_->payload_size = 0;
+  Reserve(inline_size + external_data_size);
+  size_t inline_offset = 0;
+  for (const ExternalData& external : external_data) {
+    WriteBytesCommon(inline_payload.get() + inline_offset,
+                     external.offset - inline_offset);
+    WriteBytesCommon(external.data->front(), external.data->size());
+    inline_offset = external.offset;
+  }
+  WriteBytesCommon(inline_payload.get() + inline_offset,
+                   inline_size - inline_offset);
+}
+
 void Pickle::Reserve(size_t length) {
   size_t data_len = bits::Align(length, sizeof(uint32_t));
   DCHECK_GE(data_len, length);
@@ -8,13 +8,16 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string16.h"
 #include "base/strings/string_piece.h"
 
@@ -30,7 +33,14 @@ class Pickle;
 // while the PickleIterator object is in use.
 class BASE_EXPORT PickleIterator {
  public:
-  PickleIterator() : payload_(NULL), read_index_(0), end_index_(0) {}
+  PickleIterator()
+      : payload_(NULL),
+        read_index_(0),
+        end_index_(0),
+        pickle_(NULL),
+        next_external_index_(0),
+        next_external_offset_(kNoExternalData),
+        external_read_offset_(0) {}
   explicit PickleIterator(const Pickle& pickle);
 
   // Methods for reading the payload of the Pickle. To read from the start of
@@ -101,10 +111,26 @@ class BASE_EXPORT PickleIterator {
   const char* GetReadPointerAndAdvance(int num_elements,
                                        size_t size_element);
 
+  // Returns the next |num_bytes| of the external data that sits at
+  // read_index_, and moves on to the next one once it is all read. Reads must
+  // not run past the end of the external data. See
+  // Pickle::WriteExternalData().
+  const char* ReadExternalData(int num_bytes);
+
+  static const size_t kNoExternalData;
+
   const char* payload_;  // Start of our pickle's payload.
   size_t read_index_;  // Offset of the next readable byte in payload.
   size_t end_index_;  // Payload size.
 
+  // External data of the pickle, which is read without advancing read_index_.
+  const Pickle* pickle_;
+  size_t next_external_index_;
+  // Payload offset of the next external data, or kNoExternalData.
+  size_t next_external_offset_;
+  // Number of bytes of the next external data already read, with padding.
+  size_t external_read_offset_;
+
   FRIEND_TEST_ALL_PREFIXES(PickleTest, GetReadPointerAndAdvance);
 };
 
@@ -206,10 +232,18 @@ class BASE_EXPORT Pickle {
   Pickle& operator=(const Pickle& other);
 
   // Returns the number of bytes written in the Pickle, including the header.
-  size_t size() const { return header_size_ + header_->payload_size; }
+  // Must not be called while the pickle has_external_data().
+  size_t size() const {
+    DCHECK(!has_external_data());
+    return header_size_ + header_->payload_size;
+  }
 
-  // Returns the data for this Pickle.
-  const void* data() const { return header_; }
+  // Returns the data for this Pickle. Must not be called while the pickle
+  // has_external_data().
+  const void* data() const {
+    DCHECK(!has_external_data());
+    return header_;
+  }
 
   // Returns the effective memory capacity of this Pickle, that is, the total
   // number of bytes currently dynamically allocated or 0 in the case of a
@@ -253,6 +287,51 @@ class BASE_EXPORT Pickle {
   // known size. See also WriteData.
   bool WriteBytes(const void* data, int length);
 
+  // Blobs at least this long are referenced by WriteExternalData().
+  static const size_t kMinExternalDataSize;
+
+  // Like WriteData(), but the bytes of |data| are referenced instead of being
+  // copied into the pickle; |data| must not change while the pickle is alive.
+  // Blobs shorter than kMinExternalDataSize are copied anyway. Referenced
+  // bytes are not part of the pickle's buffer, so a pickle that
+  // has_external_data() must be serialized with GetSerializedSegments() or
+  // flattened first; data() and size() DCHECK that it is not. Reading is
+  // unchanged: ReadData() returns a pointer into |data|.
+  //
+  // IPC writes scoped_refptr<RefCountedMemory> parameters this way.
+  // ChannelPosix and ChannelMojo gather the segments when sending, and
+  // ChannelWin and ChannelNacl flatten the message.
+  bool WriteExternalData(scoped_refptr<RefCountedMemory> data);
+
+  // Returns true if WriteExternalData() referenced data that is not part of
+  // data() yet.
+  bool has_external_data() const { return !external_data_.empty(); }
+
+  // Returns the number of bytes of the serialized pickle, including the header
+  // and any external data.
+  size_t serialized_size() const {
+    return header_size_ + header_->payload_size + external_data_size_;
+  }
+
+  // A piece of the serialized pickle.
+  struct Segment {
+    const char* data;
+    size_t size;
+  };
+
+  // Fills |segments| with pieces that, written back to back, are the bytes of
+  // the serialized pickle, i.e. what data() would hold had the external data
+  // been written with WriteData(). This lets scatter/gather I/O such as
+  // sendmsg() send external data without copying it. The segments are valid
+  // until the pickle is modified or destroyed. Not const because the header is
+  // rewritten into a copy with the serialized payload size.
+  void GetSerializedSegments(std::vector<Segment>* segments);
+
+  // Copies external data into the pickle's buffer, so that data() and size()
+  // describe the serialized pickle. For transports that need a contiguous
+  // buffer.
+  void Flatten();
+
   // WriteAttachment appends |attachment| to the pickle. It returns
   // false iff the set is full or if the Pickle implementation does not support
   // attachments.
@@ -350,6 +429,17 @@ class BASE_EXPORT Pickle {
  private:
   friend class PickleIterator;
 
+  // Data referenced by WriteExternalData(). It logically sits at |offset| in
+  // the payload, after its inline length, padded to a multiple of 4 bytes.
+  struct ExternalData {
+    ExternalData(size_t offset, scoped_refptr<RefCountedMemory> data);
+    ExternalData(const ExternalData& other);
+    ~ExternalData();
+
+    size_t offset;
+    scoped_refptr<RefCountedMemory> data;
+  };
+
   Header* header_;
   size_t header_size_;  // Supports extra data between header and payload.
   // Allocation size of payload (or -1 if allocation is const). Note: this
@@ -359,6 +449,12 @@ class BASE_EXPORT Pickle {
   // the header.
   size_t write_offset_;
 
+  // In payload order. |external_data_size_| is their padded total size.
+  std::vector<ExternalData> external_data_;
+  size_t external_data_size_;
+  // The header with the serialized payload size, see GetSerializedSegments().
+  std::unique_ptr<char[]> serialized_header_;
+
   // Just like WriteBytes, but with a compile-time size, for performance.
   template<size_t length> void BASE_EXPORT WriteBytesStatic(const void* data);
 
@@ -7,11 +7,14 @@
 #include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/macros.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string16.h"
 #include "base/strings/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -570,6 +573,149 @@ TEST(PickleTest, ClaimBytes) {
   EXPECT_EQ(42, out_value);
 }
 
+namespace {
+
+// Concatenates the serialized segments of |pickle|.
+std::string SerializeSegments(Pickle* pickle) {
+  std::vector<Pickle::Segment> segments;
+  pickle->GetSerializedSegments(&segments);
+  std::string result;
+  for (const Pickle::Segment& segment : segments)
+    result.append(segment.data, segment.size);
+  return result;
+}
+
+}  // namespace
+
+// Checks that external data is read in place and serializes to the same bytes
+// as WriteData().
+TEST(PickleTest, ExternalData) {
+  // Odd sizes, so that the external data needs padding.
+  scoped_refptr<RefCountedString> first(new RefCountedString);
+  first->data().assign(Pickle::kMinExternalDataSize + 1, 'a');
+  scoped_refptr<RefCountedString> second(new RefCountedString);
+  second->data().assign(Pickle::kMinExternalDataSize * 3 + 3, 'b');
+
+  Pickle pickle;
+  pickle.WriteInt(1);
+  EXPECT_TRUE(pickle.WriteExternalData(first));
+  EXPECT_TRUE(pickle.WriteExternalData(second));
+  pickle.WriteString("tail");
+  EXPECT_TRUE(pickle.has_external_data());
+  EXPECT_LT(pickle.GetTotalAllocatedSize(), first->size() + second->size());
+
+  Pickle expected;
+  expected.WriteInt(1);
+  expected.WriteData(first->front_as<char>(), first->size());
+  expected.WriteData(second->front_as<char>(), second->size());
+  expected.WriteString("tail");
+  EXPECT_EQ(expected.size(), pickle.serialized_size());
+  const std::string expected_bytes(static_cast<const char*>(expected.data()),
+                                   expected.size());
+  EXPECT_EQ(expected_bytes, SerializeSegments(&pickle));
+
+  // Reading is the same as for WriteData(), but without copies.
+  PickleIterator iter(pickle);
+  int value;
+  EXPECT_TRUE(iter.ReadInt(&value));
+  EXPECT_EQ(1, value);
+  const char* data;
+  int length;
+  EXPECT_TRUE(iter.ReadData(&data, &length));
+  EXPECT_EQ(first->front_as<char>(), data);
+  EXPECT_EQ(static_cast<int>(first->size()), length);
+  EXPECT_TRUE(iter.ReadData(&data, &length));
+  EXPECT_EQ(second->front_as<char>(), data);
+  EXPECT_EQ(static_cast<int>(second->size()), length);
+  std::string tail;
+  EXPECT_TRUE(iter.ReadString(&tail));
+  EXPECT_EQ("tail", tail);
+  EXPECT_FALSE(iter.ReadInt(&value));
+
+  // Copies keep referencing the external data.
+  Pickle copy(pickle);
+  EXPECT_TRUE(copy.has_external_data());
+  EXPECT_EQ(expected_bytes, SerializeSegments(&copy));
+
+  // Flattening gives the contiguous form.
+  pickle.Flatten();
+  EXPECT_FALSE(pickle.has_external_data());
+  EXPECT_EQ(expected_bytes, std::string(static_cast<const char*>(pickle.data()),
+                                        pickle.size()));
+  EXPECT_EQ(expected_bytes, SerializeSegments(&pickle));
+}
+
+// Checks that small blobs are copied rather than referenced.
+TEST(PickleTest, ExternalDataSmall) {
+  scoped_refptr<RefCountedString> small(new RefCountedString);
+  small->data() = "small";
+
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteExternalData(small));
+  EXPECT_FALSE(pickle.has_external_data());
+  EXPECT_EQ(pickle.size(), pickle.serialized_size());
+
+  PickleIterator iter(pickle);
+  const char* data;
+  int length;
+  EXPECT_TRUE(iter.ReadData(&data, &length));
+  EXPECT_EQ("small", std::string(data, length));
+}
+
+// Checks that external data can be read in pieces, as in the flattened pickle,
+// but not past its end.
+TEST(PickleTest, ExternalDataPartialReads) {
+  scoped_refptr<RefCountedString> external(new RefCountedString);
+  external->data().assign(Pickle::kMinExternalDataSize + 6, 'x');
+  const int kValue = 42;
+  memcpy(&external->data()[Pickle::kMinExternalDataSize], &kValue,
+         sizeof(kValue));
+
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteExternalData(external));
+  pickle.WriteInt(7);
+  EXPECT_TRUE(pickle.has_external_data());
+  Pickle flattened(pickle);
+  flattened.Flatten();
+
+  for (const Pickle* p : {&pickle, &flattened}) {
+    PickleIterator iter(*p);
+    int length;
+    EXPECT_TRUE(iter.ReadInt(&length));
+    EXPECT_EQ(static_cast<int>(external->size()), length);
+    const char* data;
+    // The padding of an odd-sized read is skipped.
+    EXPECT_TRUE(iter.ReadBytes(&data, Pickle::kMinExternalDataSize - 1));
+    EXPECT_EQ(std::string(Pickle::kMinExternalDataSize - 1, 'x'),
+              std::string(data, Pickle::kMinExternalDataSize - 1));
+    int value;
+    EXPECT_TRUE(iter.ReadInt(&value));
+    EXPECT_EQ(kValue, value);
+    EXPECT_TRUE(iter.ReadBytes(&data, 2));
+    EXPECT_EQ("xx", std::string(data, 2));
+    EXPECT_TRUE(iter.ReadInt(&value));
+    EXPECT_EQ(7, value);
+    EXPECT_FALSE(iter.ReadInt(&value));
+  }
+
+  // Pieces point into the external data.
+  PickleIterator iter(pickle);
+  int length;
+  EXPECT_TRUE(iter.ReadInt(&length));
+  const char* data;
+  EXPECT_TRUE(iter.ReadBytes(&data, 4));
+  EXPECT_EQ(external->front_as<char>(), data);
+  EXPECT_TRUE(iter.ReadBytes(&data, 4));
+  EXPECT_EQ(external->front_as<char>() + 4, data);
+
+  // A read can't run past the end of the external data.
+  PickleIterator past_end_iter(pickle);
+  EXPECT_TRUE(past_end_iter.ReadInt(&length));
+  EXPECT_FALSE(past_end_iter.ReadBytes(&data, length + 1));
+  int value;
+  EXPECT_FALSE(past_end_iter.ReadInt(&value));
+}
+
 // Checks that PickleSizer and Pickle agree on the size of things.
 TEST(PickleTest, PickleSizer) {
   {
@@ -0,0 +1,607 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/profiler/task_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/bits.h"
+#include "base/hash.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/metrics/histogram_base.h"
+#include "base/metrics/sparse_histogram.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+#include "base/timer/timer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_argument.h"
+#include "base/tracking_info.h"
+
+namespace base {
+
+namespace {
+
+std::atomic<bool> g_enabled(false);
+
+// GetSamplingInterval() - 1.
+std::atomic<uint32_t> g_sampling_mask(
+    TaskProfiler::kDefaultSamplingInterval - 1);
+
+// Returns a seed for NextIsSampled().
+uint32_t GetSamplingSeed() {
+  return static_cast<uint32_t>(RandUint64()) | 1;
+}
+
+// Advances the xorshift generator |state|, which is never 0, and returns
+// whether the event it was advanced for is sampled.
+bool NextIsSampled(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return (x & g_sampling_mask.load(std::memory_order_relaxed)) == 0;
+}
+
+// Adds |delta| to |value|, which is only written by the current thread.
+template <typename T>
+void Add(std::atomic<T>* value, T delta) {
+  value->store(value->load(std::memory_order_relaxed) + delta,
+               std::memory_order_relaxed);
+}
+
+// Returns |sampled_total| scaled up to |count| events.
+TimeDelta Estimate(TimeDelta sampled_total,
+                   int64_t num_samples,
+                   int64_t count) {
+  if (!num_samples)
+    return TimeDelta();
+  return TimeDelta::FromMicroseconds(static_cast<int64_t>(
+      static_cast<double>(sampled_total.InMicroseconds()) * count /
+      num_samples));
+}
+
+}  // namespace
+
+namespace internal {
+
+// The stats of the tasks run by a thread. Only the thread which owns the table
+// writes to it, with relaxed loads and stores rather than atomic increments,
+// while GetSnapshot() reads it from other threads. When the thread exits, the
+// table is released and reused by the next thread which runs a task, with the
+// stats it holds.
+class TaskProfilerThreadTable {
+ public:
+  struct Slot {
+    Slot();
+
+    void AddSample(std::atomic<int64_t>* num_samples,
+                   std::atomic<int64_t>* total_us,
+                   std::atomic<uint32_t>* histogram,
+                   TimeDelta duration);
+
+    // Null while the slot is free. Set last, with release semantics, when the
+    // slot is taken by a location.
+    std::atomic<const char*> file_name;
+    const char* function_name;
+    int line_number;
+
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> num_queue_time_samples;
+    std::atomic<int64_t> total_queue_time_us;
+    std::atomic<uint32_t> queue_time_histogram[TaskProfiler::kNumBuckets];
+    std::atomic<int64_t> num_run_time_samples;
+    std::atomic<int64_t> total_run_time_us;
+    std::atomic<uint32_t> run_time_histogram[TaskProfiler::kNumBuckets];
+  };
+
+  TaskProfilerThreadTable();
+
+  // Returns a table for the current thread, from the released ones if any.
+  static TaskProfilerThreadTable* Acquire();
+
+  // Returns the first of the tables of all the threads, past and present.
+  static TaskProfilerThreadTable* GetFirst();
+
+  void Release();
+
+  // Returns the slot where the tasks posted from |location| are recorded.
+  Slot* FindOrTakeSlot(const tracked_objects::Location& location);
+
+  // Returns whether the run time of the next task is sampled. The tasks run
+  // nested within a timed task are all timed, so that their run time can be
+  // excluded from its.
+  bool NextRunIsTimed() {
+    return num_timed_runs_ > 0 || NextIsSampled(&sampling_state_);
+  }
+
+  void BeginTimedRun() { ++num_timed_runs_; }
+
+  // |wall_time| includes the tasks run nested.
+  void EndTimedRun(TimeDelta wall_time) {
+    --num_timed_runs_;
+    nested_run_time_ += wall_time;
+  }
+
+  // The run time of the timed tasks run so far on the thread, including the
+  // ones which ran nested within other tasks.
+  TimeDelta nested_run_time() const { return nested_run_time_; }
+
+  TaskProfilerThreadTable* next() const { return next_; }
+  const Slot* slots() const { return slots_; }
+  const Slot& other_locations() const { return other_locations_; }
+
+ private:
+  static_assert((TaskProfiler::kMaxLocationsPerThread &
+                 (TaskProfiler::kMaxLocationsPerThread - 1)) == 0,
+                "the number of slots must be a power of 2");
+
+  // The number of slots probed for a location before it is recorded with the
+  // other locations.
+  static const size_t kMaxProbes = 16;
+
+  Slot slots_[TaskProfiler::kMaxLocationsPerThread];
+  Slot other_locations_;
+
+  std::atomic<bool> in_use_;
+
+  // The state of the owning thread.
+  uint32_t sampling_state_;
+  int num_timed_runs_;
+  TimeDelta nested_run_time_;
+
+  // Set before the table is published, never changed.
+  TaskProfilerThreadTable* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskProfilerThreadTable);
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::TaskProfilerThreadTable;
+
+// The head of the list of the tables of all threads. Tables are only ever
+// prepended, and never deleted.
+std::atomic<TaskProfilerThreadTable*> g_first_table(nullptr);
+
+// The state of the profiler on a thread which posts or runs tasks.
+struct ThreadState {
+  uint32_t post_sampling_state;
+  // Null until the thread runs a task.
+  TaskProfilerThreadTable* table;
+};
+
+void DeleteThreadState(void* state) {
+  ThreadState* thread_state = static_cast<ThreadState*>(state);
+  if (thread_state->table)
+    thread_state->table->Release();
+  delete thread_state;
+}
+
+struct ThreadStateSlot {
+  ThreadStateSlot() : slot(&DeleteThreadState) {}
+
+  ThreadLocalStorage::Slot slot;
+};
+
+LazyInstance<ThreadStateSlot>::Leaky g_thread_state_slot =
+    LAZY_INSTANCE_INITIALIZER;
+
+ThreadState* GetCurrentThreadState() {
+  ThreadLocalStorage::Slot& slot = g_thread_state_slot.Get().slot;
+  ThreadState* state = static_cast<ThreadState*>(slot.Get());
+  if (!state) {
+    state = new ThreadState;
+    state->post_sampling_state = GetSamplingSeed();
+    state->table = nullptr;
+    slot.Set(state);
+  }
+  return state;
+}
+
+TaskProfilerThreadTable* GetCurrentThreadTable() {
+  ThreadState* state = GetCurrentThreadState();
+  if (!state->table)
+    state->table = TaskProfilerThreadTable::Acquire();
+  return state->table;
+}
+
+// Identifies a location across threads. See tracked_objects::Location's
+// operator==.
+using LocationKey = std::pair<const char*, int>;
+
+LocationKey GetLocationKey(const tracked_objects::Location& location) {
+  return LocationKey(location.file_name(), location.line_number());
+}
+
+// The totals reported to UMA so far, in milliseconds.
+struct ReportedTotals {
+  int64_t queue_time_ms = 0;
+  int64_t run_time_ms = 0;
+};
+
+struct ReportState {
+  Lock lock;
+  std::map<LocationKey, ReportedTotals> reported_totals;
+};
+
+LazyInstance<ReportState>::Leaky g_report_state = LAZY_INSTANCE_INITIALIZER;
+
+// Runs ReportSnapshot() for StartPeriodicReporting().
+LazyInstance<RepeatingTimer>::Leaky g_report_timer = LAZY_INSTANCE_INITIALIZER;
+
+// Adds the milliseconds of |total| not reported yet to |histogram|.
+void ReportTime(HistogramBase* histogram,
+                int32_t sample,
+                TimeDelta total,
+                int64_t* reported_ms) {
+  const int64_t delta_ms = total.InMilliseconds() - *reported_ms;
+  if (delta_ms <= 0)
+    return;
+  *reported_ms += delta_ms;
+  histogram->AddCount(
+      sample, static_cast<int>(std::min<int64_t>(
+                  delta_ms, std::numeric_limits<int>::max())));
+}
+
+void AppendHistogram(const int64_t (&histogram)[TaskProfiler::kNumBuckets],
+                     trace_event::TracedValue* value) {
+  for (int64_t count : histogram)
+    value->AppendDouble(static_cast<double>(count));
+}
+
+std::unique_ptr<trace_event::TracedValue> SnapshotAsTracedValue(
+    const TaskProfiler::Snapshot& snapshot) {
+  std::unique_ptr<trace_event::TracedValue> value(
+      new trace_event::TracedValue);
+  value->BeginArray("locations");
+  for (const TaskProfiler::LocationStats& stats : snapshot) {
+    value->BeginDictionary();
+    value->SetString("function_name", stats.location.function_name());
+    value->SetString("file_name", stats.location.file_name());
+    value->SetInteger("line_number", stats.location.line_number());
+    value->SetDouble("count", static_cast<double>(stats.count));
+    value->SetDouble("total_queue_time_ms",
+                     stats.EstimateTotalQueueTime().InMillisecondsF());
+    value->SetDouble("total_run_time_ms",
+                     stats.EstimateTotalRunTime().InMillisecondsF());
+    value->BeginArray("queue_time_histogram");
+    AppendHistogram(stats.queue_time_histogram, value.get());
+    value->EndArray();
+    value->BeginArray("run_time_histogram");
+    AppendHistogram(stats.run_time_histogram, value.get());
+    value->EndArray();
+    value->EndDictionary();
+  }
+  value->EndArray();
+  return value;
+}
+
+}  // namespace
+
+namespace internal {
+
+TaskProfilerThreadTable::Slot::Slot()
+    : file_name(nullptr),
+      function_name(nullptr),
+      line_number(0),
+      count(0),
+      num_queue_time_samples(0),
+      total_queue_time_us(0),
+      num_run_time_samples(0),
+      total_run_time_us(0) {
+  for (int i = 0; i < TaskProfiler::kNumBuckets; ++i) {
+    queue_time_histogram[i].store(0, std::memory_order_relaxed);
+    run_time_histogram[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void TaskProfilerThreadTable::Slot::AddSample(
+    std::atomic<int64_t>* num_samples,
+    std::atomic<int64_t>* total_us,
+    std::atomic<uint32_t>* histogram,
+    TimeDelta duration) {
+  Add<int64_t>(num_samples, 1);
+  Add(total_us, duration.InMicroseconds());
+  Add<uint32_t>(&histogram[TaskProfiler::GetBucket(duration)], 1);
+}
+
+TaskProfilerThreadTable::TaskProfilerThreadTable()
+    : in_use_(true),
+      sampling_state_(GetSamplingSeed()),
+      num_timed_runs_(0),
+      next_(nullptr) {
+  other_locations_.function_name = TaskProfiler::kOtherLocations;
+  other_locations_.file_name.store(TaskProfiler::kOtherLocations,
+                                   std::memory_order_relaxed);
+}
+
+// static
+TaskProfilerThreadTable* TaskProfilerThreadTable::Acquire() {
+  for (TaskProfilerThreadTable* table = GetFirst(); table;
+       table = table->next_) {
+    bool in_use = false;
+    if (table->in_use_.compare_exchange_strong(in_use, true,
+                                               std::memory_order_acquire)) {
+      table->num_timed_runs_ = 0;
+      table->nested_run_time_ = TimeDelta();
+      return table;
+    }
+  }
+
+  TaskProfilerThreadTable* table = new TaskProfilerThreadTable;
+  table->next_ = g_first_table.load(std::memory_order_relaxed);
+  while (!g_first_table.compare_exchange_weak(table->next_, table,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+  }
+  return table;
+}
+
+// static
+TaskProfilerThreadTable* TaskProfilerThreadTable::GetFirst() {
+  return g_first_table.load(std::memory_order_acquire);
+}
+
+void TaskProfilerThreadTable::Release() {
+  in_use_.store(false, std::memory_order_release);
+}
+
+TaskProfilerThreadTable::Slot* TaskProfilerThreadTable::FindOrTakeSlot(
+    const tracked_objects::Location& location) {
+  const char* const file_name = location.file_name();
+  if (!file_name)
+    return &other_locations_;
+
+  const size_t mask = TaskProfiler::kMaxLocationsPerThread - 1;
+  size_t index = tracked_objects::Location::Hash()(location) & mask;
+  for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+    Slot* slot = &slots_[index];
+    // The slots are only taken by this thread.
+    const char* slot_file_name =
+        slot->file_name.load(std::memory_order_relaxed);
+    if (!slot_file_name) {
+      slot->function_name = location.function_name();
+      slot->line_number = location.line_number();
+      slot->file_name.store(file_name, std::memory_order_release);
+      return slot;
+    }
+    if (slot_file_name == file_name &&
+        slot->line_number == location.line_number()) {
+      return slot;
+    }
+    index = (index + 1) & mask;
+  }
+  return &other_locations_;
+}
+
+}  // namespace internal
+
+// static
+const char TaskProfiler::kOtherLocations[] = "<other>";
+
+TaskProfiler::LocationStats::LocationStats()
+    : count(0),
+      num_queue_time_samples(0),
+      queue_time_histogram(),
+      num_run_time_samples(0),
+      run_time_histogram() {}
+
+TaskProfiler::LocationStats::LocationStats(const LocationStats& other) =
+    default;
+
+TaskProfiler::LocationStats::~LocationStats() {}
+
+TimeDelta TaskProfiler::LocationStats::EstimateTotalQueueTime() const {
+  return Estimate(total_queue_time, num_queue_time_samples, count);
+}
+
+TimeDelta TaskProfiler::LocationStats::EstimateTotalRunTime() const {
+  return Estimate(total_run_time, num_run_time_samples, count);
+}
+
+TaskProfiler::ScopedTaskRun::ScopedTaskRun(
+    const tracked_objects::Location& posted_from,
+    const TrackingInfo& task)
+    : posted_from_(posted_from), table_(nullptr), timed_(false) {
+  if (!IsEnabled())
+    return;
+  table_ = GetCurrentThreadTable();
+  timed_ = table_->NextRunIsTimed();
+  if (!task.queue_time.is_null()) {
+    // Delayed tasks are queued from the time they are due, as in
+    // TrackingInfo::EffectiveTimePosted().
+    queue_time_ = std::max(task.queue_time, task.delayed_run_time);
+  }
+  if (timed_) {
+    table_->BeginTimedRun();
+    nested_run_time_at_start_ = table_->nested_run_time();
+  }
+  if (timed_ || !queue_time_.is_null())
+    start_time_ = TimeTicks::Now();
+}
+
+TaskProfiler::ScopedTaskRun::~ScopedTaskRun() {
+  if (!table_)
+    return;
+  TimeDelta run_time;
+  if (timed_) {
+    const TimeDelta wall_time = TimeTicks::Now() - start_time_;
+    run_time = wall_time - (table_->nested_run_time() -
+                            nested_run_time_at_start_);
+    table_->EndTimedRun(wall_time);
+  }
+
+  TaskProfilerThreadTable::Slot* slot = table_->FindOrTakeSlot(posted_from_);
+  Add<int64_t>(&slot->count, 1);
+  if (!queue_time_.is_null()) {
+    slot->AddSample(&slot->num_queue_time_samples, &slot->total_queue_time_us,
+                    slot->queue_time_histogram, start_time_ - queue_time_);
+  }
+  if (timed_) {
+    slot->AddSample(&slot->num_run_time_samples, &slot->total_run_time_us,
+                    slot->run_time_histogram, run_time);
+  }
+}
+
+// static
+bool TaskProfiler::IsEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+// static
+void TaskProfiler::SetEnabled(bool enabled) {
+  g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+int TaskProfiler::GetSamplingInterval() {
+  return g_sampling_mask.load(std::memory_order_relaxed) + 1;
+}
+
+// static
+void TaskProfiler::SetSamplingInterval(int interval) {
+  DCHECK_GT(interval, 0);
+  DCHECK_EQ(0, interval & (interval - 1));
+  g_sampling_mask.store(interval - 1, std::memory_order_relaxed);
+}
+
+// static
+TimeTicks TaskProfiler::SampleQueueTime() {
+  if (!IsEnabled())
+    return TimeTicks();
+  const bool sampled =
+      NextIsSampled(&GetCurrentThreadState()->post_sampling_state);
+  return sampled ? TimeTicks::Now() : TimeTicks();
+}
+
+// static
+int TaskProfiler::GetBucket(TimeDelta duration) {
+  const int64_t us = duration.InMicroseconds();
+  if (us <= 0)
+    return 0;
+  // Clamped to 2^30 microseconds, beyond the last bucket.
+  const int bucket = bits::Log2Floor(
+      static_cast<uint32_t>(std::min<int64_t>(us, 1 << 30))) + 1;
+  return std::min(bucket, kNumBuckets - 1);
+}
+
+// static
+TaskProfiler::Snapshot TaskProfiler::GetSnapshot() {
+  Snapshot snapshot;
+  std::map<LocationKey, size_t> indices;
+  auto merge = [&snapshot, &indices](
+      const TaskProfilerThreadTable::Slot& slot, const char* file_name) {
+    const tracked_objects::Location location(
+        slot.function_name, file_name, slot.line_number, nullptr);
+    auto inserted =
+        indices.insert(std::make_pair(GetLocationKey(location),
+                                      snapshot.size()));
+    if (inserted.second) {
+      snapshot.push_back(LocationStats());
+      snapshot.back().location = location;
+    }
+    LocationStats* stats = &snapshot[inserted.first->second];
+    stats->count += slot.count.load(std::memory_order_relaxed);
+    stats->num_queue_time_samples +=
+        slot.num_queue_time_samples.load(std::memory_order_relaxed);
+    stats->total_queue_time += TimeDelta::FromMicroseconds(
+        slot.total_queue_time_us.load(std::memory_order_relaxed));
+    stats->num_run_time_samples +=
+        slot.num_run_time_samples.load(std::memory_order_relaxed);
+    stats->total_run_time += TimeDelta::FromMicroseconds(
+        slot.total_run_time_us.load(std::memory_order_relaxed));
+    for (int i = 0; i < kNumBuckets; ++i) {
+      stats->queue_time_histogram[i] +=
+          slot.queue_time_histogram[i].load(std::memory_order_relaxed);
+      stats->run_time_histogram[i] +=
+          slot.run_time_histogram[i].load(std::memory_order_relaxed);
+    }
+  };
+
+  for (const TaskProfilerThreadTable* table =
+           TaskProfilerThreadTable::GetFirst();
+       table; table = table->next()) {
+    for (size_t i = 0; i < kMaxLocationsPerThread; ++i) {
+      const TaskProfilerThreadTable::Slot& slot = table->slots()[i];
+      const char* file_name = slot.file_name.load(std::memory_order_acquire);
+      if (file_name)
+        merge(slot, file_name);
+    }
+    const TaskProfilerThreadTable::Slot& other = table->other_locations();
+    if (other.count.load(std::memory_order_relaxed))
+      merge(other, kOtherLocations);
+  }
+
+  std::sort(snapshot.begin(), snapshot.end(),
+            [](const LocationStats& a, const LocationStats& b) {
+              return a.EstimateTotalRunTime() > b.EstimateTotalRunTime();
+            });
+  return snapshot;
+}
+
+// static
+void TaskProfiler::ReportSnapshot() {
+  const Snapshot snapshot = GetSnapshot();
+
+  HistogramBase* queue_time_histogram = SparseHistogram::FactoryGet(
+      "TaskProfiler.QueueTimeByLocation",
+      HistogramBase::kUmaTargetedHistogramFlag);
+  HistogramBase* run_time_histogram = SparseHistogram::FactoryGet(
+      "TaskProfiler.RunTimeByLocation",
+      HistogramBase::kUmaTargetedHistogramFlag);
+  {
+    ReportState& state = g_report_state.Get();
+    AutoLock auto_lock(state.lock);
+    for (const LocationStats& stats : snapshot) {
+      ReportedTotals& reported =
+          state.reported_totals[GetLocationKey(stats.location)];
+      const int32_t sample = HashLocation(stats.location);
+      ReportTime(queue_time_histogram, sample, stats.EstimateTotalQueueTime(),
+                 &reported.queue_time_ms);
+      ReportTime(run_time_histogram, sample, stats.EstimateTotalRunTime(),
+                 &reported.run_time_ms);
+    }
+  }
+
+  bool tracing_enabled;
+  TRACE_EVENT_CATEGORY_GROUP_ENABLED(TRACE_DISABLED_BY_DEFAULT("task_profiler"),
+                                     &tracing_enabled);
+  if (tracing_enabled) {
+    TRACE_EVENT_INSTANT1(TRACE_DISABLED_BY_DEFAULT("task_profiler"),
+                         "TaskProfiler::Snapshot", TRACE_EVENT_SCOPE_PROCESS,
+                         "snapshot", SnapshotAsTracedValue(snapshot));
+  }
+}
+
+// static
+void TaskProfiler::StartPeriodicReporting(TimeDelta interval) {
+  g_report_timer.Get().Start(FROM_HERE, interval,
+                             Bind(&TaskProfiler::ReportSnapshot));
+}
+
+// static
+void TaskProfiler::StopPeriodicReporting() {
+  g_report_timer.Get().Stop();
+}
+
+// static
+int32_t TaskProfiler::HashLocation(const tracked_objects::Location& location) {
+  return static_cast<int32_t>(Hash(std::string(location.file_name()) + ":" +
+                                   IntToString(location.line_number())));
+}
+
+}  // namespace base
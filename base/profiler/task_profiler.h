@@ -0,0 +1,146 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_PROFILER_TASK_PROFILER_H_
+#define BASE_PROFILER_TASK_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+
+struct TrackingInfo;
+
+namespace internal {
+class TaskProfilerThreadTable;
+}  // namespace internal
+
+// TaskProfiler records, per posting location, how long tasks waited in their
+// queue and how long they ran. It is much cheaper than tracked_objects: each
+// thread records the tasks it runs into a fixed-size table of its own without
+// taking locks, and the tables are merged lock-free when a snapshot is taken.
+// The snapshots can be reported to UMA and to tracing, to find the task-level
+// hot spots in production. The profiler is disabled until SetEnabled(true) is
+// called, and then costs nothing but a flag check per task.
+//
+// All the tasks are counted, but reading the clock costs about as much as
+// the rest of running a trivial task, so only a random sample of the tasks
+// are timed, one in GetSamplingInterval() on average. The queue times are
+// sampled when the tasks are posted, the run times when they run.
+//
+// The tasks run by MessageLoop, TaskScheduler, SequencedWorkerPool and
+// WorkerPool are recorded.
+class BASE_EXPORT TaskProfiler {
+ public:
+  // The number of buckets of the histograms of durations. Bucket 0 counts the
+  // durations below 1 microsecond, bucket i the durations in [2^(i-1), 2^i)
+  // microseconds, and the last bucket everything from about 4 seconds.
+  static const int kNumBuckets = 24;
+
+  // The number of posting locations recorded per thread. The tasks from the
+  // locations which do not fit are recorded together, at a location whose
+  // function and file names are kOtherLocations.
+  static const size_t kMaxLocationsPerThread = 256;
+  static const char kOtherLocations[];
+
+  static const int kDefaultSamplingInterval = 16;
+
+  // The tasks recorded for a posting location.
+  struct BASE_EXPORT LocationStats {
+    LocationStats();
+    LocationStats(const LocationStats& other);
+    ~LocationStats();
+
+    // Estimates of the time spent by all the tasks counted, from the samples.
+    TimeDelta EstimateTotalQueueTime() const;
+    TimeDelta EstimateTotalRunTime() const;
+
+    tracked_objects::Location location;
+    int64_t count;
+
+    int64_t num_queue_time_samples;
+    TimeDelta total_queue_time;
+    int64_t queue_time_histogram[kNumBuckets];
+
+    int64_t num_run_time_samples;
+    TimeDelta total_run_time;
+    int64_t run_time_histogram[kNumBuckets];
+  };
+
+  // The stats of all the locations, by decreasing estimated total run time.
+  using Snapshot = std::vector<LocationStats>;
+
+  // Records the run of a task in its scope. The run time excludes the tasks
+  // run by nested loops within the scope.
+  class BASE_EXPORT ScopedTaskRun {
+   public:
+    // |posted_from| and |task| must outlive this.
+    ScopedTaskRun(const tracked_objects::Location& posted_from,
+                  const TrackingInfo& task);
+    ~ScopedTaskRun();
+
+   private:
+    const tracked_objects::Location& posted_from_;
+    // Null if the task is not recorded.
+    internal::TaskProfilerThreadTable* table_;
+    // Null if the queue time of the task is not sampled.
+    TimeTicks queue_time_;
+    bool timed_;
+    TimeTicks start_time_;
+    TimeDelta nested_run_time_at_start_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedTaskRun);
+  };
+
+  // The profiler is disabled by default.
+  static bool IsEnabled();
+  static void SetEnabled(bool enabled);
+
+  // |interval| must be a power of 2. An interval of 1 times every task.
+  static int GetSamplingInterval();
+  static void SetSamplingInterval(int interval);
+
+  // Returns the time a task posted now is queued from, or a null time if its
+  // queue time is not sampled.
+  static TimeTicks SampleQueueTime();
+
+  // Returns the bucket of the histograms where |duration| is counted.
+  static int GetBucket(TimeDelta duration);
+
+  // Returns the stats recorded so far by all the threads, merged by location.
+  // The threads keep running tasks meanwhile, so the stats of a location may
+  // not all include the same tasks.
+  static Snapshot GetSnapshot();
+
+  // Records the estimated time spent queued and running by the tasks of each
+  // location since the last report into the
+  // "TaskProfiler.QueueTimeByLocation" and "TaskProfiler.RunTimeByLocation"
+  // sparse histograms, in milliseconds, with the hash returned by
+  // HashLocation() as sample. If the "disabled-by-default-task_profiler"
+  // tracing category is enabled, also adds the snapshot to the trace.
+  static void ReportSnapshot();
+
+  // Calls ReportSnapshot() every |interval| from the current thread, which
+  // must run a MessageLoop, until StopPeriodicReporting() is called from the
+  // same thread.
+  static void StartPeriodicReporting(TimeDelta interval);
+  static void StopPeriodicReporting();
+
+  // Returns the sample which identifies |location| in UMA.
+  static int32_t HashLocation(const tracked_objects::Location& location);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(TaskProfiler);
+};
+
+}  // namespace base
+
+#endif  // BASE_PROFILER_TASK_PROFILER_H_
@@ -0,0 +1,295 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/profiler/task_profiler.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/location.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/single_thread_task_runner.h"
+#include "base/test/histogram_tester.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "base/tracking_info.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Returns the stats of |location| in |snapshot|, with a count of 0 if it has
+// none.
+TaskProfiler::LocationStats FindStats(
+    const TaskProfiler::Snapshot& snapshot,
+    const tracked_objects::Location& location) {
+  for (const TaskProfiler::LocationStats& stats : snapshot) {
+    if (stats.location == location)
+      return stats;
+  }
+  return TaskProfiler::LocationStats();
+}
+
+// Returns the run time of |location| reported to |histogram_tester|.
+HistogramBase::Count GetReportedRunTimeMs(
+    const HistogramTester& histogram_tester,
+    const tracked_objects::Location& location) {
+  for (const Bucket& bucket :
+       histogram_tester.GetAllSamples("TaskProfiler.RunTimeByLocation")) {
+    if (bucket.min == TaskProfiler::HashLocation(location))
+      return bucket.count;
+  }
+  return 0;
+}
+
+int64_t SumOfCounts(const int64_t (&histogram)[TaskProfiler::kNumBuckets]) {
+  int64_t sum = 0;
+  for (int64_t count : histogram)
+    sum += count;
+  return sum;
+}
+
+void Sleep(TimeDelta duration) {
+  PlatformThread::Sleep(duration);
+}
+
+void RunNestedLoop(const tracked_objects::Location& location,
+                   TimeDelta duration) {
+  MessageLoop::ScopedNestableTaskAllower allow(MessageLoop::current());
+  MessageLoop::current()->task_runner()->PostTask(location,
+                                                  Bind(&Sleep, duration));
+  RunLoop().RunUntilIdle();
+}
+
+// Records tasks from |num_locations| locations of |file_name|.
+void RecordTasksFromLocations(const char* file_name, int num_locations) {
+  for (int line = 0; line < num_locations; ++line) {
+    const tracked_objects::Location location("RecordTasksFromLocations",
+                                             file_name, line, nullptr);
+    TaskProfiler::ScopedTaskRun task_run(location,
+                                         TrackingInfo(location, TimeTicks()));
+  }
+}
+
+// The stats are never reset, so the tests look at what was recorded since
+// they started.
+class TaskProfilerTest : public testing::Test {
+ public:
+  void SetUp() override {
+    TaskProfiler::SetEnabled(true);
+    // Every task is timed, unless a test says otherwise.
+    TaskProfiler::SetSamplingInterval(1);
+    snapshot_at_start_ = TaskProfiler::GetSnapshot();
+  }
+
+  void TearDown() override {
+    TaskProfiler::SetSamplingInterval(TaskProfiler::kDefaultSamplingInterval);
+    TaskProfiler::SetEnabled(false);
+  }
+
+ protected:
+  // Returns the stats of |location| recorded since the test started.
+  TaskProfiler::LocationStats GetStats(
+      const tracked_objects::Location& location) const {
+    TaskProfiler::LocationStats stats =
+        FindStats(TaskProfiler::GetSnapshot(), location);
+    const TaskProfiler::LocationStats stats_at_start =
+        FindStats(snapshot_at_start_, location);
+    stats.count -= stats_at_start.count;
+    stats.num_queue_time_samples -= stats_at_start.num_queue_time_samples;
+    stats.total_queue_time -= stats_at_start.total_queue_time;
+    stats.num_run_time_samples -= stats_at_start.num_run_time_samples;
+    stats.total_run_time -= stats_at_start.total_run_time;
+    for (int i = 0; i < TaskProfiler::kNumBuckets; ++i) {
+      stats.queue_time_histogram[i] -= stats_at_start.queue_time_histogram[i];
+      stats.run_time_histogram[i] -= stats_at_start.run_time_histogram[i];
+    }
+    return stats;
+  }
+
+ private:
+  TaskProfiler::Snapshot snapshot_at_start_;
+};
+
+}  // namespace
+
+TEST_F(TaskProfilerTest, GetBucket) {
+  EXPECT_EQ(0, TaskProfiler::GetBucket(TimeDelta()));
+  EXPECT_EQ(1, TaskProfiler::GetBucket(TimeDelta::FromMicroseconds(1)));
+  EXPECT_EQ(2, TaskProfiler::GetBucket(TimeDelta::FromMicroseconds(2)));
+  EXPECT_EQ(2, TaskProfiler::GetBucket(TimeDelta::FromMicroseconds(3)));
+  EXPECT_EQ(10, TaskProfiler::GetBucket(TimeDelta::FromMilliseconds(1)));
+  EXPECT_EQ(TaskProfiler::kNumBuckets - 1,
+            TaskProfiler::GetBucket(TimeDelta::FromSeconds(5)));
+  EXPECT_EQ(TaskProfiler::kNumBuckets - 1,
+            TaskProfiler::GetBucket(TimeDelta::FromDays(1)));
+}
+
+TEST_F(TaskProfilerTest, RecordsMessageLoopTasks) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  const TimeDelta kDelay = TimeDelta::FromMilliseconds(2);
+  loop.task_runner()->PostTask(location, Bind(&Sleep, kDelay));
+  loop.task_runner()->PostTask(location, Bind(&Sleep, kDelay));
+  RunLoop().RunUntilIdle();
+
+  const TaskProfiler::LocationStats stats = GetStats(location);
+  EXPECT_EQ(2, stats.count);
+  EXPECT_EQ(2, stats.num_queue_time_samples);
+  EXPECT_EQ(2, stats.num_run_time_samples);
+  EXPECT_GE(stats.total_run_time, 2 * kDelay);
+  // The second task waited for the first one.
+  EXPECT_GE(stats.total_queue_time, kDelay);
+  EXPECT_EQ(2, SumOfCounts(stats.queue_time_histogram));
+  EXPECT_EQ(2, SumOfCounts(stats.run_time_histogram));
+  EXPECT_EQ(0, stats.run_time_histogram[0]);
+}
+
+TEST_F(TaskProfilerTest, QueueTimeOfDelayedTasksStartsWhenDue) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  RunLoop run_loop;
+  loop.task_runner()->PostDelayedTask(location, run_loop.QuitClosure(),
+                                      TimeDelta::FromMilliseconds(50));
+  run_loop.Run();
+
+  const TaskProfiler::LocationStats stats = GetStats(location);
+  EXPECT_EQ(1, stats.count);
+  EXPECT_LT(stats.total_queue_time, TimeDelta::FromMilliseconds(50));
+}
+
+TEST_F(TaskProfilerTest, ExcludesNestedTasksFromRunTime) {
+  MessageLoop loop;
+  const tracked_objects::Location outer_location = FROM_HERE;
+  const tracked_objects::Location inner_location = FROM_HERE;
+  const TimeDelta kDelay = TimeDelta::FromMilliseconds(20);
+  loop.task_runner()->PostTask(
+      outer_location, Bind(&RunNestedLoop, inner_location, kDelay));
+  RunLoop().RunUntilIdle();
+
+  const TaskProfiler::LocationStats outer_stats = GetStats(outer_location);
+  const TaskProfiler::LocationStats inner_stats = GetStats(inner_location);
+  EXPECT_EQ(1, outer_stats.count);
+  EXPECT_EQ(1, inner_stats.count);
+  EXPECT_GE(inner_stats.total_run_time, kDelay);
+  EXPECT_LT(outer_stats.total_run_time, kDelay);
+}
+
+TEST_F(TaskProfilerTest, MergesThreads) {
+  const tracked_objects::Location location = FROM_HERE;
+  Thread thread_a("TaskProfilerTestA");
+  Thread thread_b("TaskProfilerTestB");
+  ASSERT_TRUE(thread_a.Start());
+  ASSERT_TRUE(thread_b.Start());
+  for (int i = 0; i < 3; ++i) {
+    thread_a.task_runner()->PostTask(location, Bind(&DoNothing));
+    thread_b.task_runner()->PostTask(location, Bind(&DoNothing));
+  }
+  thread_a.Stop();
+  thread_b.Stop();
+
+  EXPECT_EQ(6, GetStats(location).count);
+}
+
+TEST_F(TaskProfilerTest, RecordsOtherLocationsWhenFull) {
+  static const char kFileName[] = "task_profiler_unittest_many_locations.cc";
+  const tracked_objects::Location other_locations(
+      TaskProfiler::kOtherLocations, TaskProfiler::kOtherLocations, 0,
+      nullptr);
+
+  const int kNumLocations = TaskProfiler::kMaxLocationsPerThread + 10;
+  Thread thread("TaskProfilerTest");
+  ASSERT_TRUE(thread.Start());
+  // The task which records the others is one more location.
+  thread.task_runner()->PostTask(
+      tracked_objects::Location("RecordsOtherLocationsWhenFull", kFileName,
+                                kNumLocations, nullptr),
+      Bind(&RecordTasksFromLocations, kFileName, kNumLocations));
+  thread.Stop();
+
+  int64_t count = 0;
+  for (int line = 0; line <= kNumLocations; ++line) {
+    const int64_t location_count =
+        GetStats(tracked_objects::Location("", kFileName, line, nullptr))
+            .count;
+    EXPECT_LE(location_count, 1);
+    count += location_count;
+  }
+  EXPECT_LE(count, static_cast<int64_t>(TaskProfiler::kMaxLocationsPerThread));
+  EXPECT_EQ(kNumLocations + 1 - count,
+            GetStats(other_locations).count);
+}
+
+TEST_F(TaskProfilerTest, SamplesTimes) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  TaskProfiler::SetSamplingInterval(4);
+  const int kNumTasks = 1000;
+  for (int i = 0; i < kNumTasks; ++i)
+    loop.task_runner()->PostTask(location, Bind(&DoNothing));
+  RunLoop().RunUntilIdle();
+
+  // All the tasks are counted, about a quarter of them are timed.
+  const TaskProfiler::LocationStats stats = GetStats(location);
+  EXPECT_EQ(kNumTasks, stats.count);
+  EXPECT_GT(stats.num_queue_time_samples, kNumTasks / 8);
+  EXPECT_LT(stats.num_queue_time_samples, kNumTasks / 2);
+  EXPECT_GT(stats.num_run_time_samples, kNumTasks / 8);
+  EXPECT_LT(stats.num_run_time_samples, kNumTasks / 2);
+  EXPECT_GE(stats.EstimateTotalRunTime(), stats.total_run_time);
+}
+
+TEST_F(TaskProfilerTest, DisabledProfilerRecordsNothing) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  TaskProfiler::SetEnabled(false);
+  loop.task_runner()->PostTask(location, Bind(&DoNothing));
+  RunLoop().RunUntilIdle();
+  TaskProfiler::SetEnabled(true);
+
+  EXPECT_EQ(0, GetStats(location).count);
+}
+
+TEST_F(TaskProfilerTest, ReportSnapshot) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  loop.task_runner()->PostTask(
+      location, Bind(&Sleep, TimeDelta::FromMilliseconds(5)));
+  RunLoop().RunUntilIdle();
+
+  HistogramTester histogram_tester;
+  TaskProfiler::ReportSnapshot();
+  const HistogramBase::Count run_time_ms =
+      GetReportedRunTimeMs(histogram_tester, location);
+  EXPECT_GE(run_time_ms, 5);
+
+  // Only the time since the last report is reported.
+  TaskProfiler::ReportSnapshot();
+  EXPECT_EQ(run_time_ms, GetReportedRunTimeMs(histogram_tester, location));
+}
+
+TEST_F(TaskProfilerTest, PeriodicReporting) {
+  MessageLoop loop;
+  const tracked_objects::Location location = FROM_HERE;
+  loop.task_runner()->PostTask(
+      location, Bind(&Sleep, TimeDelta::FromMilliseconds(5)));
+
+  HistogramTester histogram_tester;
+  TaskProfiler::StartPeriodicReporting(TimeDelta::FromMilliseconds(1));
+  RunLoop run_loop;
+  loop.task_runner()->PostDelayedTask(FROM_HERE, run_loop.QuitClosure(),
+                                      TimeDelta::FromMilliseconds(20));
+  run_loop.Run();
+  TaskProfiler::StopPeriodicReporting();
+
+  EXPECT_GE(GetReportedRunTimeMs(histogram_tester, location), 5);
+}
+
+}  // namespace base
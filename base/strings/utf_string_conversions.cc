@@ -6,11 +6,19 @@
 
 #include <stdint.h>
 
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
+#include "base/macros.h"
 #include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversion_utils.h"
+#include "base/third_party/icu/icu_utf.h"
 #include "build/build_config.h"
 
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#endif
+
 namespace base {
 
 namespace {
@@ -41,10 +49,176 @@ bool ConvertUnicode(const SRC_CHAR* src,
   return success;
 }
 
+// ASCII runs ------------------------------------------------------------------
+
+inline bool IsASCIIUnit(char c) {
+  return static_cast<unsigned char>(c) < 0x80;
+}
+
+inline bool IsASCIIUnit(char16 c) {
+  return c < 0x80;
+}
+
+// Copies the ASCII characters at the start of [src, src + src_len) to |dest|,
+// which must have room for |src_len| code units, and returns how many were
+// copied.
+size_t WidenASCIIScalar(const char* src, size_t src_len, char16* dest) {
+  size_t i = 0;
+  for (; i < src_len && IsASCIIUnit(src[i]); ++i)
+    dest[i] = static_cast<unsigned char>(src[i]);
+  return i;
+}
+
+size_t NarrowASCIIScalar(const char16* src, size_t src_len, char* dest) {
+  size_t i = 0;
+  for (; i < src_len && IsASCIIUnit(src[i]); ++i)
+    dest[i] = static_cast<char>(src[i]);
+  return i;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY)
+// Same as above, but convert 16 characters per iteration.
+size_t WidenASCIISSE2(const char* src, size_t src_len, char16* dest) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; src_len - i >= 16; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    // Non-ASCII bytes have their top bit set.
+    if (_mm_movemask_epi8(chunk))
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8),
+                     _mm_unpackhi_epi8(chunk, zero));
+  }
+  // Finish the tail, or the ASCII part of the last chunk.
+  return i + WidenASCIIScalar(src + i, src_len - i, dest + i);
+}
+
+size_t NarrowASCIISSE2(const char16* src, size_t src_len, char* dest) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<int16_t>(0xFF80));
+  size_t i = 0;
+  for (; src_len - i >= 16; i += 16) {
+    const __m128i low =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i high =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+    const __m128i non_ascii =
+        _mm_and_si128(_mm_or_si128(low, high), non_ascii_bits);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(non_ascii, zero)) != 0xFFFF)
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packus_epi16(low, high));
+  }
+  return i + NarrowASCIIScalar(src + i, src_len - i, dest + i);
+}
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
+// Picks the fastest ASCII copiers supported by the current CPU once per
+// process.
+class ASCIICopiers {
+ public:
+  using WidenFunction = size_t (*)(const char* src,
+                                   size_t src_len,
+                                   char16* dest);
+  using NarrowFunction = size_t (*)(const char16* src,
+                                    size_t src_len,
+                                    char* dest);
+
+  ASCIICopiers() : widen_(&WidenASCIIScalar), narrow_(&NarrowASCIIScalar) {
+#if defined(ARCH_CPU_X86_FAMILY)
+    if (CPU().has_sse2()) {
+      widen_ = &WidenASCIISSE2;
+      narrow_ = &NarrowASCIISSE2;
+    }
+#endif
+  }
+
+  WidenFunction widen() const { return widen_; }
+  NarrowFunction narrow() const { return narrow_; }
+
+ private:
+  WidenFunction widen_;
+  NarrowFunction narrow_;
+
+  DISALLOW_COPY_AND_ASSIGN(ASCIICopiers);
+};
+
+LazyInstance<ASCIICopiers>::Leaky g_ascii_copiers = LAZY_INSTANCE_INITIALIZER;
+
+// Writes |code_point| to |dest| and returns the number of code units written.
+inline size_t WriteCodePoint(uint32_t code_point, char* dest) {
+  size_t length = 0;
+  CBU8_APPEND_UNSAFE(dest, length, code_point);
+  return length;
+}
+
+inline size_t WriteCodePoint(uint32_t code_point, char16* dest) {
+  size_t length = 0;
+  CBU16_APPEND_UNSAFE(dest, length, code_point);
+  return length;
+}
+
+// Converts [src, src + src_len) like ConvertUnicode(), but into |dest|, which
+// must have room for the longest possible result, and returns the number of
+// code units written. Runs of ASCII are handed to |copy_ascii|; only the
+// characters in between are decoded one code point at a time. Sets |*success|
+// to false if invalid input was replaced with U+FFFD.
+template <typename SRC_CHAR, typename DEST_CHAR>
+size_t ConvertWithASCIIRuns(const SRC_CHAR* src,
+                            size_t src_len,
+                            DEST_CHAR* dest,
+                            size_t (*copy_ascii)(const SRC_CHAR*,
+                                                 size_t,
+                                                 DEST_CHAR*),
+                            bool* success) {
+  int32_t src_len32 = static_cast<int32_t>(src_len);
+  size_t dest_len = 0;
+  int32_t i = 0;
+  while (i < src_len32) {
+    size_t ascii_len = copy_ascii(src + i, src_len32 - i, dest + dest_len);
+    i += static_cast<int32_t>(ascii_len);
+    dest_len += ascii_len;
+
+    for (; i < src_len32 && !IsASCIIUnit(src[i]); i++) {
+      uint32_t code_point;
+      if (!ReadUnicodeCharacter(src, src_len32, &i, &code_point)) {
+        code_point = 0xFFFD;
+        *success = false;
+      }
+      dest_len += WriteCodePoint(code_point, dest + dest_len);
+    }
+  }
+  return dest_len;
+}
+
 }  // namespace
 
 // UTF-8 <-> Wide --------------------------------------------------------------
 
+#if defined(WCHAR_T_IS_UTF16)
+// Easy case since the UTF-16 versions below apply to wide strings as well.
+
+bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
+  return UTF16ToUTF8(src, src_len, output);
+}
+
+std::string WideToUTF8(const std::wstring& wide) {
+  return UTF16ToUTF8(wide);
+}
+
+bool UTF8ToWide(const char* src, size_t src_len, std::wstring* output) {
+  return UTF8ToUTF16(src, src_len, output);
+}
+
+std::wstring UTF8ToWide(StringPiece utf8) {
+  return UTF8ToUTF16(utf8);
+}
+
+#elif defined(WCHAR_T_IS_UTF32)
+
 bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
   if (IsStringASCII(std::wstring(src, src_len))) {
     output->assign(src, src + src_len);
@@ -87,6 +261,8 @@ std::wstring UTF8ToWide(StringPiece utf8) {
   return ret;
 }
 
+#endif  // defined(WCHAR_T_IS_UTF32)
+
 // UTF-16 <-> Wide -------------------------------------------------------------
 
 #if defined(WCHAR_T_IS_UTF16)
@@ -144,46 +320,45 @@ std::wstring UTF16ToWide(const string16& utf16) {
 
 // UTF16 <-> UTF8 --------------------------------------------------------------
 
-#if defined(WCHAR_T_IS_UTF32)
-
 bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
-  if (IsStringASCII(StringPiece(src, src_len))) {
-    output->assign(src, src + src_len);
-    return true;
-  } else {
-    PrepareForUTF16Or32Output(src, src_len, output);
-    return ConvertUnicode(src, src_len, output);
-  }
+  // Every UTF-8 sequence is at least as long as its UTF-16 equivalent, so
+  // |src_len| code units are always enough.
+  output->resize(src_len);
+  bool success = true;
+  output->resize(ConvertWithASCIIRuns(src, src_len, &(*output)[0],
+                                      g_ascii_copiers.Get().widen(),
+                                      &success));
+  return success;
 }
 
 string16 UTF8ToUTF16(StringPiece utf8) {
-  if (IsStringASCII(utf8)) {
-    return string16(utf8.begin(), utf8.end());
-  }
-
   string16 ret;
-  PrepareForUTF16Or32Output(utf8.data(), utf8.length(), &ret);
   // Ignore the success flag of this call, it will do the best it can for
   // invalid input, which is what we want here.
-  ConvertUnicode(utf8.data(), utf8.length(), &ret);
+  UTF8ToUTF16(utf8.data(), utf8.length(), &ret);
   return ret;
 }
 
 bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
-  if (IsStringASCII(StringPiece16(src, src_len))) {
-    output->assign(src, src + src_len);
+  const ASCIICopiers& ascii_copiers = g_ascii_copiers.Get();
+
+  // Assume that the entire input is ASCII.
+  output->resize(src_len);
+  size_t ascii_len = ascii_copiers.narrow()(src, src_len, &(*output)[0]);
+  if (ascii_len == src_len)
     return true;
-  } else {
-    PrepareForUTF8Output(src, src_len, output);
-    return ConvertUnicode(src, src_len, output);
-  }
+
+  // The rest takes at most 3 bytes per UTF-16 code unit.
+  output->resize(ascii_len + (src_len - ascii_len) * 3);
+  bool success = true;
+  output->resize(ascii_len +
+                 ConvertWithASCIIRuns(src + ascii_len, src_len - ascii_len,
+                                      &(*output)[ascii_len],
+                                      ascii_copiers.narrow(), &success));
+  return success;
 }
 
 std::string UTF16ToUTF8(StringPiece16 utf16) {
-  if (IsStringASCII(utf16)) {
-    return std::string(utf16.begin(), utf16.end());
-  }
-
   std::string ret;
   // Ignore the success flag of this call, it will do the best it can for
   // invalid input, which is what we want here.
@@ -191,33 +366,6 @@ std::string UTF16ToUTF8(StringPiece16 utf16) {
   return ret;
 }
 
-#elif defined(WCHAR_T_IS_UTF16)
-// Easy case since we can use the "wide" versions we already wrote above.
-
-bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
-  return UTF8ToWide(src, src_len, output);
-}
-
-string16 UTF8ToUTF16(StringPiece utf8) {
-  return UTF8ToWide(utf8);
-}
-
-bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
-  return WideToUTF8(src, src_len, output);
-}
-
-std::string UTF16ToUTF8(StringPiece16 utf16) {
-  if (IsStringASCII(utf16))
-    return std::string(utf16.data(), utf16.data() + utf16.length());
-
-  std::string ret;
-  PrepareForUTF8Output(utf16.data(), utf16.length(), &ret);
-  ConvertUnicode(utf16.data(), utf16.length(), &ret);
-  return ret;
-}
-
-#endif
-
 string16 ASCIIToUTF16(StringPiece ascii) {
   DCHECK(IsStringASCII(ascii)) << ascii;
   return string16(ascii.begin(), ascii.end());
@@ -0,0 +1,102 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <string>
+
+#include "base/format_macros.h"
+#include "base/strings/string16.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Each conversion is repeated until this many bytes of UTF-8 have been
+// converted, so that short strings are not dominated by timer resolution.
+const size_t kMinBytes = 64 * 1024 * 1024;
+
+const struct {
+  const char* name;
+  const char* utf8;
+} kCorpora[] = {
+    {"ascii", "The quick brown fox jumps over the lazy dog. "},
+    // "Voilà l'été : où déjeuner près du château ? "
+    {"latin1",
+     "Voil\xc3\xa0 l'\xc3\xa9t\xc3\xa9 : o\xc3\xb9 d\xc3\xa9jeuner "
+     "pr\xc3\xa8s du ch\xc3\xa2teau ? "},
+    // "Поиск страниц на русском "
+    {"cyrillic",
+     "\xd0\x9f\xd0\xbe\xd0\xb8\xd1\x81\xd0\xba \xd1\x81\xd1\x82\xd1\x80\xd0"
+     "\xb0\xd0\xbd\xd0\xb8\xd1\x86 \xd0\xbd\xd0\xb0 \xd1\x80\xd1\x83\xd1\x81"
+     "\xd1\x81\xd0\xba\xd0\xbe\xd0\xbc "},
+    // "网页图片资讯更多"
+    {"cjk",
+     "\xe7\xbd\x91\xe9\xa1\xb5\xe5\x9b\xbe\xe7\x89\x87\xe8\xb5\x84\xe8\xae"
+     "\xaf\xe6\x9b\xb4\xe5\xa4\x9a"},
+    // A URL with a Cyrillic path and query, as shown in the omnibox.
+    {"url",
+     "https://ru.wikipedia.org/wiki/\xd0\x9f\xd0\xbe\xd0\xb8\xd1\x81\xd0\xba"
+     "?search=\xd1\x81\xd1\x82\xd1\x80\xd0\xb0\xd0\xbd\xd0\xb8\xd1\x86&"
+     "title=Special:Search&go=Go "},
+};
+
+// Repeats |seed| until the result is at least |length| bytes long.
+std::string MakeText(const char* seed, size_t length) {
+  std::string text;
+  while (text.length() < length)
+    text += seed;
+  return text;
+}
+
+void RunConversionPerfTests(size_t length) {
+  for (const auto& corpus : kCorpora) {
+    const std::string utf8 = MakeText(corpus.utf8, length);
+    const string16 utf16 = UTF8ToUTF16(utf8);
+    const size_t rounds = kMinBytes / utf8.length() + 1;
+    const std::string trace =
+        StringPrintf("%s_%" PRIuS "_bytes", corpus.name, length);
+
+    string16 utf16_out;
+    TimeTicks start = TimeTicks::Now();
+    for (size_t round = 0; round < rounds; ++round)
+      UTF8ToUTF16(utf8.data(), utf8.length(), &utf16_out);
+    TimeDelta elapsed = TimeTicks::Now() - start;
+    EXPECT_EQ(utf16, utf16_out);
+    perf_test::PrintResult(
+        "utf8_to_utf16", "", trace,
+        elapsed.InMicroseconds() * 1000.0 / (rounds * utf8.length()),
+        "ns/byte", true);
+
+    std::string utf8_out;
+    start = TimeTicks::Now();
+    for (size_t round = 0; round < rounds; ++round)
+      UTF16ToUTF8(utf16.data(), utf16.length(), &utf8_out);
+    elapsed = TimeTicks::Now() - start;
+    EXPECT_EQ(utf8, utf8_out);
+    perf_test::PrintResult(
+        "utf16_to_utf8", "", trace,
+        elapsed.InMicroseconds() * 1000.0 / (rounds * utf8.length()),
+        "ns/byte", true);
+  }
+}
+
+}  // namespace
+
+// Strings the size of a title or URL.
+TEST(UTFStringConversionsPerfTest, Short) {
+  RunConversionPerfTests(64);
+}
+
+// Strings the size of a page of text.
+TEST(UTFStringConversionsPerfTest, Long) {
+  RunConversionPerfTests(16 * 1024);
+}
+
+}  // namespace base
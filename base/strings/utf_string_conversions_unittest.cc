@@ -183,6 +183,71 @@ TEST(UTFStringConversionsTest, ConvertUTF32ToUTF8) {
 }
 #endif  // defined(WCHAR_T_IS_UTF32)
 
+// ASCII is converted in runs of 16 characters where the CPU allows it, so put
+// a non-ASCII character at every offset of ASCII strings on both sides of
+// those run boundaries.
+TEST(UTFStringConversionsTest, ConvertASCIIRunBoundaries) {
+  const struct {
+    const char* utf8;
+    const char16 utf16[3];
+  } kNonASCII[] = {
+    // "é"
+    {"\xc3\xa9", {0x00e9, 0}},
+    // "中"
+    {"\xe4\xb8\xad", {0x4e2d, 0}},
+    // U+1F600, outside the Basic Multilingual Plane.
+    {"\xf0\x9f\x98\x80", {0xd83d, 0xde00, 0}},
+  };
+
+  for (size_t length = 0; length <= 40; ++length) {
+    std::string ascii8;
+    for (size_t i = 0; i < length; ++i)
+      ascii8.push_back(static_cast<char>(' ' + i % 95));
+    const string16 ascii16(ascii8.begin(), ascii8.end());
+
+    std::string utf8;
+    string16 utf16;
+    EXPECT_TRUE(UTF8ToUTF16(ascii8.data(), ascii8.length(), &utf16));
+    EXPECT_EQ(ascii16, utf16);
+    EXPECT_TRUE(UTF16ToUTF8(ascii16.data(), ascii16.length(), &utf8));
+    EXPECT_EQ(ascii8, utf8);
+
+    for (const auto& non_ascii : kNonASCII) {
+      for (size_t offset = 0; offset <= length; ++offset) {
+        std::string expected8 = ascii8;
+        expected8.insert(offset, non_ascii.utf8);
+        string16 expected16 = ascii16;
+        expected16.insert(offset, non_ascii.utf16);
+
+        EXPECT_TRUE(UTF8ToUTF16(expected8.data(), expected8.length(), &utf16));
+        EXPECT_EQ(expected16, utf16) << length << " " << offset;
+        EXPECT_TRUE(
+            UTF16ToUTF8(expected16.data(), expected16.length(), &utf8));
+        EXPECT_EQ(expected8, utf8) << length << " " << offset;
+      }
+    }
+  }
+}
+
+// Invalid input next to ASCII runs is replaced, and the runs are kept.
+TEST(UTFStringConversionsTest, ConvertInvalidAfterASCIIRun) {
+  const std::string ascii(20, 'a');
+
+  std::string invalid8 = ascii + "\xff" + ascii;
+  string16 utf16;
+  EXPECT_FALSE(UTF8ToUTF16(invalid8.data(), invalid8.length(), &utf16));
+  EXPECT_EQ(ASCIIToUTF16(ascii) + static_cast<char16>(0xfffd) +
+                ASCIIToUTF16(ascii),
+            utf16);
+
+  // A lone lead surrogate.
+  string16 invalid16 =
+      ASCIIToUTF16(ascii) + static_cast<char16>(0xd800) + ASCIIToUTF16(ascii);
+  std::string utf8;
+  EXPECT_FALSE(UTF16ToUTF8(invalid16.data(), invalid16.length(), &utf8));
+  EXPECT_EQ(ascii + "\xef\xbf\xbd" + ascii, utf8);
+}
+
 TEST(UTFStringConversionsTest, ConvertMultiString) {
   static char16 multi16[] = {
     'f', 'o', 'o', '\0',
@@ -67,6 +67,10 @@ void PriorityQueue::Transaction::Push(
     scoped_refptr<Sequence> sequence,
     const SequenceSortKey& sequence_sort_key) {
   outer_queue_->container_.emplace(std::move(sequence), sequence_sort_key);
+  subtle::NoBarrier_AtomicIncrement(
+      &outer_queue_->num_sequences_per_priority_[static_cast<int>(
+          sequence_sort_key.priority())],
+      1);
 }
 
 const SequenceSortKey& PriorityQueue::Transaction::PeekSortKey() const {
@@ -85,6 +89,10 @@ scoped_refptr<Sequence> PriorityQueue::Transaction::PopSequence() {
       const_cast<PriorityQueue::SequenceAndSortKey&>(
           outer_queue_->container_.top())
           .take_sequence();
+  subtle::NoBarrier_AtomicIncrement(
+      &outer_queue_->num_sequences_per_priority_[static_cast<int>(
+          outer_queue_->container_.top().sort_key().priority())],
+      -1);
   outer_queue_->container_.pop();
   return sequence;
 }
@@ -102,6 +110,16 @@ PriorityQueue::PriorityQueue(const PriorityQueue* predecessor_priority_queue)
 
 PriorityQueue::~PriorityQueue() = default;
 
+bool PriorityQueue::HasSequenceWithPriorityHigherThanHint(
+    TaskPriority priority) const {
+  for (int i = static_cast<int>(TaskPriority::HIGHEST);
+       i > static_cast<int>(priority); --i) {
+    if (subtle::NoBarrier_Load(&num_sequences_per_priority_[i]) > 0)
+      return true;
+  }
+  return false;
+}
+
 std::unique_ptr<PriorityQueue::Transaction> PriorityQueue::BeginTransaction() {
   return WrapUnique(new Transaction(this));
 }
@@ -9,12 +9,14 @@
 #include <queue>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
 #include "base/task_scheduler/scheduler_lock.h"
 #include "base/task_scheduler/sequence.h"
 #include "base/task_scheduler/sequence_sort_key.h"
+#include "base/task_scheduler/task_traits.h"
 
 namespace base {
 namespace internal {
@@ -83,6 +85,12 @@ class BASE_EXPORT PriorityQueue {
   // PriorityQueue.
   std::unique_ptr<Transaction> BeginTransaction();
 
+  // Returns true if this PriorityQueue contains a Sequence inserted with a
+  // SequenceSortKey whose priority is higher than |priority|. Doesn't begin a
+  // Transaction: the result can be stale by the time it is returned and should
+  // only be used to decide whether beginning a Transaction is worthwhile.
+  bool HasSequenceWithPriorityHigherThanHint(TaskPriority priority) const;
+
   const SchedulerLock* container_lock() const { return &container_lock_; }
 
  private:
@@ -97,6 +105,13 @@ class BASE_EXPORT PriorityQueue {
 
   ContainerType container_;
 
+  // Number of Sequences in |container_| for each priority. Only modified while
+  // |container_lock_| is held, but read without it by
+  // HasSequenceWithPriorityHigherThanHint().
+  subtle::Atomic32
+      num_sequences_per_priority_[static_cast<int>(TaskPriority::HIGHEST) + 1] =
+          {};
+
   DISALLOW_COPY_AND_ASSIGN(PriorityQueue);
 };
 
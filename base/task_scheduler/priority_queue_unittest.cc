@@ -126,6 +126,36 @@ TEST(TaskSchedulerPriorityQueueTest, PushPopPeek) {
   EXPECT_TRUE(transaction->IsEmpty());
 }
 
+TEST(TaskSchedulerPriorityQueueTest, HasSequenceWithPriorityHigherThanHint) {
+  scoped_refptr<Sequence> background_sequence(new Sequence);
+  background_sequence->PushTask(WrapUnique(new Task(
+      FROM_HERE, Closure(), TaskTraits().WithPriority(TaskPriority::BACKGROUND),
+      TimeDelta())));
+  scoped_refptr<Sequence> user_visible_sequence(new Sequence);
+  user_visible_sequence->PushTask(WrapUnique(new Task(
+      FROM_HERE, Closure(),
+      TaskTraits().WithPriority(TaskPriority::USER_VISIBLE), TimeDelta())));
+
+  PriorityQueue pq;
+  EXPECT_FALSE(pq.HasSequenceWithPriorityHigherThanHint(TaskPriority::LOWEST));
+
+  pq.BeginTransaction()->Push(background_sequence,
+                              background_sequence->GetSortKey());
+  EXPECT_FALSE(
+      pq.HasSequenceWithPriorityHigherThanHint(TaskPriority::BACKGROUND));
+
+  pq.BeginTransaction()->Push(user_visible_sequence,
+                              user_visible_sequence->GetSortKey());
+  EXPECT_TRUE(
+      pq.HasSequenceWithPriorityHigherThanHint(TaskPriority::BACKGROUND));
+  EXPECT_FALSE(
+      pq.HasSequenceWithPriorityHigherThanHint(TaskPriority::USER_VISIBLE));
+
+  EXPECT_EQ(user_visible_sequence, pq.BeginTransaction()->PopSequence());
+  EXPECT_FALSE(
+      pq.HasSequenceWithPriorityHigherThanHint(TaskPriority::BACKGROUND));
+}
+
 // Check that creating Transactions on the same thread for 2 unrelated
 // PriorityQueues causes a crash.
 TEST(TaskSchedulerPriorityQueueTest, IllegalTwoTransactionsSameThread) {
@@ -0,0 +1,57 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task_scheduler/scheduler_worker_deque.h"
+
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+SchedulerWorkerDeque::SchedulerWorkerDeque() = default;
+
+SchedulerWorkerDeque::~SchedulerWorkerDeque() = default;
+
+void SchedulerWorkerDeque::Push(scoped_refptr<Sequence> sequence,
+                                const SequenceSortKey& sequence_sort_key) {
+  DCHECK(sequence);
+  AutoSchedulerLock auto_lock(lock_);
+  deque_.emplace_back(std::move(sequence), sequence_sort_key);
+  subtle::Release_Store(&size_, static_cast<subtle::Atomic32>(deque_.size()));
+}
+
+scoped_refptr<Sequence> SchedulerWorkerDeque::Pop(
+    SequenceSortKey* sequence_sort_key) {
+  DCHECK(sequence_sort_key);
+  if (IsEmptyHint())
+    return nullptr;
+
+  AutoSchedulerLock auto_lock(lock_);
+  if (deque_.empty())
+    return nullptr;
+  scoped_refptr<Sequence> sequence = std::move(deque_.front().first);
+  *sequence_sort_key = deque_.front().second;
+  deque_.pop_front();
+  subtle::Release_Store(&size_, static_cast<subtle::Atomic32>(deque_.size()));
+  return sequence;
+}
+
+scoped_refptr<Sequence> SchedulerWorkerDeque::Steal(
+    SequenceSortKey* sequence_sort_key) {
+  DCHECK(sequence_sort_key);
+  if (IsEmptyHint())
+    return nullptr;
+
+  AutoSchedulerLock auto_lock(lock_);
+  if (deque_.empty())
+    return nullptr;
+  scoped_refptr<Sequence> sequence = std::move(deque_.back().first);
+  *sequence_sort_key = deque_.back().second;
+  deque_.pop_back();
+  subtle::Release_Store(&size_, static_cast<subtle::Atomic32>(deque_.size()));
+  return sequence;
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,77 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_SCHEDULER_SCHEDULER_WORKER_DEQUE_H_
+#define BASE_TASK_SCHEDULER_SCHEDULER_WORKER_DEQUE_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <utility>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/task_scheduler/scheduler_lock.h"
+#include "base/task_scheduler/sequence.h"
+#include "base/task_scheduler/sequence_sort_key.h"
+
+namespace base {
+namespace internal {
+
+// A double-ended queue of Sequences owned by a single SchedulerWorker. The
+// owner pushes Sequences at the back and pops them from the front, so that it
+// runs its Sequences in FIFO order. Other workers of the same pool steal from
+// the back when they run out of work. Push(), Pop() and Steal() are O(1).
+//
+// The lock of a SchedulerWorkerDeque is only contended when a worker steals
+// from it, which makes it much cheaper for the owner than a PriorityQueue
+// shared by all workers of a pool.
+//
+// This class is thread-safe.
+class BASE_EXPORT SchedulerWorkerDeque {
+ public:
+  SchedulerWorkerDeque();
+  ~SchedulerWorkerDeque();
+
+  // Inserts |sequence| with |sequence_sort_key| at the back of the deque.
+  void Push(scoped_refptr<Sequence> sequence,
+            const SequenceSortKey& sequence_sort_key);
+
+  // Removes the Sequence at the front of the deque and returns it. Its sort
+  // key is copied to |sequence_sort_key|. Returns nullptr and leaves
+  // |sequence_sort_key| untouched if the deque is empty. Should only be called
+  // by the owner of the deque.
+  scoped_refptr<Sequence> Pop(SequenceSortKey* sequence_sort_key);
+
+  // Same as Pop(), but removes the Sequence at the back of the deque. Should
+  // be called by workers other than the owner of the deque.
+  scoped_refptr<Sequence> Steal(SequenceSortKey* sequence_sort_key);
+
+  // Returns true if the deque is empty. Doesn't acquire |lock_|: the result
+  // can be stale by the time it is returned, unless the caller is the owner of
+  // the deque and gets false.
+  bool IsEmptyHint() const { return subtle::Acquire_Load(&size_) == 0; }
+
+ private:
+  using SequenceAndSortKey = std::pair<scoped_refptr<Sequence>,
+                                       SequenceSortKey>;
+
+  // Synchronizes access to |deque_|.
+  SchedulerLock lock_;
+
+  std::deque<SequenceAndSortKey> deque_;
+
+  // Number of Sequences in |deque_|. Only modified while |lock_| is held, but
+  // read without it by IsEmptyHint().
+  subtle::Atomic32 size_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(SchedulerWorkerDeque);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TASK_SCHEDULER_SCHEDULER_WORKER_DEQUE_H_
@@ -0,0 +1,57 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task_scheduler/scheduler_worker_deque.h"
+
+#include "base/memory/ref_counted.h"
+#include "base/task_scheduler/sequence.h"
+#include "base/task_scheduler/sequence_sort_key.h"
+#include "base/task_scheduler/task_traits.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace internal {
+
+TEST(TaskSchedulerWorkerDequeTest, PushPopSteal) {
+  scoped_refptr<Sequence> sequence_a(new Sequence);
+  const SequenceSortKey sort_key_a(TaskPriority::USER_VISIBLE,
+                                   TimeTicks::FromInternalValue(1000));
+  scoped_refptr<Sequence> sequence_b(new Sequence);
+  const SequenceSortKey sort_key_b(TaskPriority::USER_BLOCKING,
+                                   TimeTicks::FromInternalValue(2000));
+  scoped_refptr<Sequence> sequence_c(new Sequence);
+  const SequenceSortKey sort_key_c(TaskPriority::BACKGROUND,
+                                   TimeTicks::FromInternalValue(3000));
+
+  SchedulerWorkerDeque deque;
+  SequenceSortKey sort_key(TaskPriority::LOWEST, TimeTicks());
+  EXPECT_TRUE(deque.IsEmptyHint());
+  EXPECT_FALSE(deque.Pop(&sort_key));
+  EXPECT_FALSE(deque.Steal(&sort_key));
+
+  deque.Push(sequence_a, sort_key_a);
+  deque.Push(sequence_b, sort_key_b);
+  deque.Push(sequence_c, sort_key_c);
+  EXPECT_FALSE(deque.IsEmptyHint());
+
+  // The owner gets Sequences in the order in which they were pushed.
+  EXPECT_EQ(sequence_a, deque.Pop(&sort_key));
+  EXPECT_EQ(sort_key_a, sort_key);
+
+  // Thieves get the most recently pushed Sequence.
+  EXPECT_EQ(sequence_c, deque.Steal(&sort_key));
+  EXPECT_EQ(sort_key_c, sort_key);
+
+  EXPECT_EQ(sequence_b, deque.Steal(&sort_key));
+  EXPECT_EQ(sort_key_b, sort_key);
+
+  EXPECT_TRUE(deque.IsEmptyHint());
+  EXPECT_FALSE(deque.Pop(&sort_key));
+  EXPECT_FALSE(deque.Steal(&sort_key));
+  EXPECT_EQ(sort_key_b, sort_key);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -37,6 +37,17 @@ LazyInstance<ThreadLocalPointer<const SchedulerWorker>>::Leaky
 LazyInstance<ThreadLocalPointer<const SchedulerWorkerPool>>::Leaky
     tls_current_worker_pool = LAZY_INSTANCE_INITIALIZER;
 
+// SchedulerWorkerDeque of the SchedulerWorker that owns the current thread, if
+// any.
+LazyInstance<ThreadLocalPointer<SchedulerWorkerDeque>>::Leaky
+    tls_current_worker_deque = LAZY_INSTANCE_INITIALIZER;
+
+// A worker looks at the PriorityQueues before its own deque once every
+// |kPriorityQueuesPollInterval| calls to GetWork(). This prevents Sequences in
+// the shared PriorityQueue from being starved by workers that keep refilling
+// their own deque with Sequences of the same priority.
+constexpr size_t kPriorityQueuesPollInterval = 61;
+
 // A task runner that runs tasks with the PARALLEL ExecutionMode.
 class SchedulerParallelTaskRunner : public TaskRunner {
  public:
@@ -200,6 +211,11 @@ class SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl
     return &single_threaded_priority_queue_;
   }
 
+  SchedulerWorkerDeque* worker_deque() { return &worker_deque_; }
+
+  // Index of the worker in |outer_->workers_|.
+  int index() const { return index_; }
+
   // SchedulerWorker::Delegate:
   void OnMainEntry(SchedulerWorker* worker) override;
   scoped_refptr<Sequence> GetWork(SchedulerWorker* worker) override;
@@ -216,12 +232,26 @@ class SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl
   }
 
  private:
+  // Pops a Sequence from |worker_deque_|. Returns it if neither PriorityQueue
+  // holds a more important Sequence. Otherwise, moves it to the shared
+  // PriorityQueue, where it will be ordered with the other Sequences, and
+  // returns nullptr.
+  scoped_refptr<Sequence> GetWorkFromWorkerDeque();
+
   SchedulerWorkerPoolImpl* outer_;
   const ReEnqueueSequenceCallback re_enqueue_sequence_callback_;
 
   // Single-threaded PriorityQueue for the worker.
   PriorityQueue single_threaded_priority_queue_;
 
+  // Sequences that the worker runs in priority and that other workers of the
+  // pool can steal.
+  SchedulerWorkerDeque worker_deque_;
+
+  // Number of calls to GetWork(). Used to poll the PriorityQueues before
+  // |worker_deque_| every |kPriorityQueuesPollInterval| calls.
+  size_t num_get_work_calls_ = 0;
+
   // True if the last Sequence returned by GetWork() was extracted from
   // |single_threaded_priority_queue_|.
   bool last_sequence_is_single_threaded_ = false;
@@ -314,19 +344,23 @@ scoped_refptr<TaskRunner> SchedulerWorkerPoolImpl::CreateTaskRunnerWithTraits(
 void SchedulerWorkerPoolImpl::ReEnqueueSequence(
     scoped_refptr<Sequence> sequence,
     const SequenceSortKey& sequence_sort_key) {
-  shared_priority_queue_.BeginTransaction()->Push(std::move(sequence),
-                                                  sequence_sort_key);
-
   // The thread calling this method just ran a Task from |sequence| and will
   // soon try to get another Sequence from which to run a Task. If the thread
-  // belongs to this pool, it will get that Sequence from
+  // belongs to this pool, |sequence| is inserted in its deque, from which it
+  // will get a Sequence without acquiring the lock of
   // |shared_priority_queue_|. When that's the case, there is no need to wake up
-  // another worker after |sequence| is inserted in |shared_priority_queue_|. If
-  // we did wake up another worker, we would waste resources by having more
-  // workers trying to get a Sequence from |shared_priority_queue_| than the
-  // number of Sequences in it.
-  if (tls_current_worker_pool.Get().Get() != this)
-    WakeUpOneWorker();
+  // another worker. If we did wake up another worker, we would waste resources
+  // by having more workers trying to get a Sequence than the number of
+  // Sequences available.
+  SchedulerWorkerDeque* const current_worker_deque = GetCurrentWorkerDeque();
+  if (current_worker_deque) {
+    current_worker_deque->Push(std::move(sequence), sequence_sort_key);
+    return;
+  }
+
+  shared_priority_queue_.BeginTransaction()->Push(std::move(sequence),
+                                                  sequence_sort_key);
+  WakeUpOneWorker();
 }
 
 bool SchedulerWorkerPoolImpl::PostTaskWithSequence(
@@ -362,33 +396,42 @@ void SchedulerWorkerPoolImpl::PostTaskWithSequenceNow(
   // in the past).
   DCHECK_LE(task->delayed_run_time, delayed_task_manager_->Now());
 
-  // Because |worker| belongs to this worker pool, we know that the type
-  // of its delegate is SchedulerWorkerDelegateImpl.
-  PriorityQueue* const priority_queue =
-      worker
-          ? static_cast<SchedulerWorkerDelegateImpl*>(worker->delegate())
-                ->single_threaded_priority_queue()
-          : &shared_priority_queue_;
-  DCHECK(priority_queue);
-
   const bool sequence_was_empty = sequence->PushTask(std::move(task));
-  if (sequence_was_empty) {
-    // Insert |sequence| in |priority_queue| if it was empty before |task| was
-    // inserted into it. Otherwise, one of these must be true:
-    // - |sequence| is already in a PriorityQueue (not necessarily
-    //   |shared_priority_queue_|), or,
-    // - A worker is running a Task from |sequence|. It will insert |sequence|
-    //   in a PriorityQueue once it's done running the Task.
-    const auto sequence_sort_key = sequence->GetSortKey();
-    priority_queue->BeginTransaction()->Push(std::move(sequence),
-                                             sequence_sort_key);
-
-    // Wake up a worker to process |sequence|.
-    if (worker)
-      worker->WakeUp();
-    else
-      WakeUpOneWorker();
+  if (!sequence_was_empty) {
+    // |sequence| wasn't empty before |task| was inserted into it. One of these
+    // must be true:
+    // - |sequence| is already in a PriorityQueue or in a SchedulerWorkerDeque
+    //   (not necessarily one of this worker pool), or,
+    // - A worker is running a Task from |sequence|. It will re-enqueue
+    //   |sequence| once it's done running the Task.
+    return;
+  }
+
+  const auto sequence_sort_key = sequence->GetSortKey();
+
+  if (worker) {
+    // Because |worker| belongs to this worker pool, we know that the type
+    // of its delegate is SchedulerWorkerDelegateImpl.
+    static_cast<SchedulerWorkerDelegateImpl*>(worker->delegate())
+        ->single_threaded_priority_queue()
+        ->BeginTransaction()
+        ->Push(std::move(sequence), sequence_sort_key);
+    worker->WakeUp();
+    return;
   }
+
+  // When posting from a worker of this pool, |sequence| goes in the deque of
+  // that worker, where an idle worker woken up below can steal it.
+  SchedulerWorkerDeque* const current_worker_deque = GetCurrentWorkerDeque();
+  if (current_worker_deque) {
+    current_worker_deque->Push(std::move(sequence), sequence_sort_key);
+  } else {
+    shared_priority_queue_.BeginTransaction()->Push(std::move(sequence),
+                                                    sequence_sort_key);
+  }
+
+  // Wake up a worker to process |sequence|.
+  WakeUpOneWorker();
 }
 
 SchedulerWorkerPoolImpl::SchedulerSingleThreadTaskRunner::
@@ -440,6 +483,7 @@ void SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl::OnMainEntry(
   DCHECK(!tls_current_worker_pool.Get().Get());
   tls_current_worker.Get().Set(worker);
   tls_current_worker_pool.Get().Set(outer_);
+  tls_current_worker_deque.Get().Set(&worker_deque_);
 
   // New threads haven't run GetWork() yet, so reset the idle_start_time_.
   idle_start_time_ = TimeTicks();
@@ -454,52 +498,90 @@ SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl::GetWork(
     SchedulerWorker* worker) {
   DCHECK(ContainsWorker(outer_->workers_, worker));
 
-  scoped_refptr<Sequence> sequence;
-  {
-    std::unique_ptr<PriorityQueue::Transaction> shared_transaction(
-        outer_->shared_priority_queue_.BeginTransaction());
-    std::unique_ptr<PriorityQueue::Transaction> single_threaded_transaction(
-        single_threaded_priority_queue_.BeginTransaction());
-
-    if (shared_transaction->IsEmpty() &&
-        single_threaded_transaction->IsEmpty()) {
-      single_threaded_transaction.reset();
-
-      // |shared_transaction| is kept alive while |worker| is added to
-      // |idle_workers_stack_| to avoid this race:
-      // 1. This thread creates a Transaction, finds |shared_priority_queue_|
-      //    empty and ends the Transaction.
-      // 2. Other thread creates a Transaction, inserts a Sequence into
-      //    |shared_priority_queue_| and ends the Transaction. This can't happen
-      //    if the Transaction of step 1 is still active because because there
-      //    can only be one active Transaction per PriorityQueue at a time.
-      // 3. Other thread calls WakeUpOneWorker(). No thread is woken up because
-      //    |idle_workers_stack_| is empty.
-      // 4. This thread adds itself to |idle_workers_stack_| and goes to sleep.
-      //    No thread runs the Sequence inserted in step 2.
-      outer_->AddToIdleWorkersStack(worker);
-      if (idle_start_time_.is_null())
-        idle_start_time_ = TimeTicks::Now();
-      return nullptr;
+  ++num_get_work_calls_;
+  if (num_get_work_calls_ % kPriorityQueuesPollInterval != 0) {
+    scoped_refptr<Sequence> sequence = GetWorkFromWorkerDeque();
+    if (sequence) {
+      // |worker| can't be on |idle_workers_stack_| here: it only adds itself
+      // to the stack when all deques are empty, and only |worker| pushes
+      // Sequences to |worker_deque_|, while running a Task from a Sequence
+      // whose retrieval removed it from the stack.
+      last_sequence_is_single_threaded_ = false;
+      idle_start_time_ = TimeTicks();
+      return sequence;
     }
+  }
 
-    // True if both PriorityQueues have Sequences and the Sequence at the top of
-    // the shared PriorityQueue is more important.
-    const bool shared_sequence_is_more_important =
-        !shared_transaction->IsEmpty() &&
-        !single_threaded_transaction->IsEmpty() &&
-        shared_transaction->PeekSortKey() >
-            single_threaded_transaction->PeekSortKey();
-
-    if (single_threaded_transaction->IsEmpty() ||
-        shared_sequence_is_more_important) {
-      sequence = shared_transaction->PopSequence();
-      last_sequence_is_single_threaded_ = false;
-    } else {
-      DCHECK(!single_threaded_transaction->IsEmpty());
-      sequence = single_threaded_transaction->PopSequence();
-      last_sequence_is_single_threaded_ = true;
+  scoped_refptr<Sequence> sequence;
+  bool steal_attempted = false;
+  while (!sequence) {
+    {
+      std::unique_ptr<PriorityQueue::Transaction> shared_transaction(
+          outer_->shared_priority_queue_.BeginTransaction());
+      std::unique_ptr<PriorityQueue::Transaction> single_threaded_transaction(
+          single_threaded_priority_queue_.BeginTransaction());
+
+      if (!shared_transaction->IsEmpty() ||
+          !single_threaded_transaction->IsEmpty()) {
+        // True if both PriorityQueues have Sequences and the Sequence at the
+        // top of the shared PriorityQueue is more important.
+        const bool shared_sequence_is_more_important =
+            !shared_transaction->IsEmpty() &&
+            !single_threaded_transaction->IsEmpty() &&
+            shared_transaction->PeekSortKey() >
+                single_threaded_transaction->PeekSortKey();
+
+        if (single_threaded_transaction->IsEmpty() ||
+            shared_sequence_is_more_important) {
+          sequence = shared_transaction->PopSequence();
+          last_sequence_is_single_threaded_ = false;
+        } else {
+          DCHECK(!single_threaded_transaction->IsEmpty());
+          sequence = single_threaded_transaction->PopSequence();
+          last_sequence_is_single_threaded_ = true;
+        }
+        break;
+      }
+
+      if (steal_attempted) {
+        single_threaded_transaction.reset();
+
+        // |shared_transaction| is kept alive while |worker| is added to
+        // |idle_workers_stack_| to avoid this race:
+        // 1. This thread creates a Transaction, finds |shared_priority_queue_|
+        //    empty and ends the Transaction.
+        // 2. Other thread creates a Transaction, inserts a Sequence into
+        //    |shared_priority_queue_| and ends the Transaction. This can't
+        //    happen if the Transaction of step 1 is still active because
+        //    because there can only be one active Transaction per
+        //    PriorityQueue at a time.
+        // 3. Other thread calls WakeUpOneWorker(). No thread is woken up
+        //    because |idle_workers_stack_| is empty.
+        // 4. This thread adds itself to |idle_workers_stack_| and goes to
+        //    sleep. No thread runs the Sequence inserted in step 2.
+        // The same race with a Sequence pushed to the deque of another worker
+        // is avoided by checking the deques under the lock of
+        // |idle_workers_stack_|, which WakeUpOneWorker() acquires after the
+        // push.
+        if (outer_->AddToIdleWorkersStackIfNoStealableWork(worker)) {
+          if (idle_start_time_.is_null())
+            idle_start_time_ = TimeTicks::Now();
+          return nullptr;
+        }
+      }
     }
+
+    // Both PriorityQueues are empty. Fall back to |worker_deque_|, which may
+    // not have been looked at if this call polls the PriorityQueues first, and
+    // then to the deques of the other workers. A SchedulerWorkerDeque can't be
+    // accessed while a Transaction is active because its lock isn't a
+    // successor of the PriorityQueue locks.
+    SequenceSortKey sequence_sort_key(TaskPriority::LOWEST, TimeTicks());
+    sequence = worker_deque_.Pop(&sequence_sort_key);
+    if (!sequence)
+      sequence = outer_->StealSequence(this);
+    last_sequence_is_single_threaded_ = false;
+    steal_attempted = true;
   }
   DCHECK(sequence);
 
@@ -529,6 +611,26 @@ TimeDelta SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl::
   return outer_->suggested_reclaim_time_;
 }
 
+scoped_refptr<Sequence>
+SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl::GetWorkFromWorkerDeque() {
+  SequenceSortKey sequence_sort_key(TaskPriority::LOWEST, TimeTicks());
+  scoped_refptr<Sequence> sequence = worker_deque_.Pop(&sequence_sort_key);
+  if (!sequence)
+    return nullptr;
+
+  const TaskPriority priority = sequence_sort_key.priority();
+  if (!outer_->shared_priority_queue_.HasSequenceWithPriorityHigherThanHint(
+          priority) &&
+      !single_threaded_priority_queue_.HasSequenceWithPriorityHigherThanHint(
+          priority)) {
+    return sequence;
+  }
+
+  outer_->shared_priority_queue_.BeginTransaction()->Push(std::move(sequence),
+                                                          sequence_sort_key);
+  return nullptr;
+}
+
 bool SchedulerWorkerPoolImpl::SchedulerWorkerDelegateImpl::CanDetach(
     SchedulerWorker* worker) {
   // It's not an issue if |num_single_threaded_runners_| is incremented after
@@ -576,6 +678,9 @@ bool SchedulerWorkerPoolImpl::Initialize(
 
   DCHECK(workers_.empty());
 
+  // Workers can't get work (and therefore can't traverse |workers_| to steal
+  // Sequences) before this returns, because waking them up requires
+  // |idle_workers_stack_lock_|.
   for (size_t i = 0; i < max_threads; ++i) {
     std::unique_ptr<SchedulerWorker> worker =
         SchedulerWorker::Create(
@@ -609,9 +714,45 @@ void SchedulerWorkerPoolImpl::WakeUpOneWorker() {
     worker->WakeUp();
 }
 
-void SchedulerWorkerPoolImpl::AddToIdleWorkersStack(
+SchedulerWorkerDeque* SchedulerWorkerPoolImpl::GetCurrentWorkerDeque() const {
+  if (tls_current_worker_pool.Get().Get() != this)
+    return nullptr;
+  return tls_current_worker_deque.Get().Get();
+}
+
+scoped_refptr<Sequence> SchedulerWorkerPoolImpl::StealSequence(
+    SchedulerWorkerDelegateImpl* thief) {
+  // Start with the worker that follows |thief| in |workers_| to spread steals
+  // across victims.
+  const size_t num_workers = workers_.size();
+  const size_t thief_index = static_cast<size_t>(thief->index());
+  DCHECK_EQ(thief, workers_[thief_index]->delegate());
+
+  for (size_t i = 1; i < num_workers; ++i) {
+    SchedulerWorkerDelegateImpl* const victim =
+        static_cast<SchedulerWorkerDelegateImpl*>(
+            workers_[(thief_index + i) % num_workers]->delegate());
+    SequenceSortKey sequence_sort_key(TaskPriority::LOWEST, TimeTicks());
+    scoped_refptr<Sequence> sequence =
+        victim->worker_deque()->Steal(&sequence_sort_key);
+    if (sequence)
+      return sequence;
+  }
+  return nullptr;
+}
+
+bool SchedulerWorkerPoolImpl::AddToIdleWorkersStackIfNoStealableWork(
     SchedulerWorker* worker) {
   AutoSchedulerLock auto_lock(idle_workers_stack_lock_);
+
+  for (const auto& other_worker : workers_) {
+    if (!static_cast<SchedulerWorkerDelegateImpl*>(other_worker->delegate())
+             ->worker_deque()
+             ->IsEmptyHint()) {
+      return false;
+    }
+  }
+
   // Detachment may cause multiple attempts to add because the delegate cannot
   // determine who woke it up. As a result, when it wakes up, it may conclude
   // there's no work to be done and attempt to add itself to the idle stack
@@ -623,6 +764,7 @@ void SchedulerWorkerPoolImpl::AddToIdleWorkersStack(
 
   if (idle_workers_stack_.Size() == workers_.size())
     idle_workers_stack_cv_for_testing_->Broadcast();
+  return true;
 }
 
 const SchedulerWorker* SchedulerWorkerPoolImpl::PeekAtIdleWorkersStack() const {
@@ -23,6 +23,7 @@
 #include "base/task_scheduler/priority_queue.h"
 #include "base/task_scheduler/scheduler_lock.h"
 #include "base/task_scheduler/scheduler_worker.h"
+#include "base/task_scheduler/scheduler_worker_deque.h"
 #include "base/task_scheduler/scheduler_worker_pool.h"
 #include "base/task_scheduler/scheduler_worker_pool_params.h"
 #include "base/task_scheduler/scheduler_worker_stack.h"
@@ -41,6 +42,15 @@ class DelayedTaskManager;
 class TaskTracker;
 
 // A pool of workers that run Tasks. This class is thread-safe.
+//
+// Each worker owns a SchedulerWorkerDeque in which it keeps the Sequences that
+// become non-empty or are re-enqueued while it runs a Task. A worker gets work
+// from its own deque first and steals from the deques of the other workers
+// when it runs out of work. A PriorityQueue shared by all workers receives the
+// Sequences posted from threads that don't belong to the pool and the
+// Sequences that are less important than work pending elsewhere, which keeps
+// priority ordering across TaskTraits without having all workers contend on
+// its lock for every Task.
 class BASE_EXPORT SchedulerWorkerPoolImpl : public SchedulerWorkerPool {
  public:
   // Callback invoked when a Sequence isn't empty after a worker pops a Task
@@ -111,8 +121,18 @@ class BASE_EXPORT SchedulerWorkerPoolImpl : public SchedulerWorkerPool {
   // Wakes up the last worker from this worker pool to go idle, if any.
   void WakeUpOneWorker();
 
-  // Adds |worker| to |idle_workers_stack_|.
-  void AddToIdleWorkersStack(SchedulerWorker* worker);
+  // Returns the SchedulerWorkerDeque of the worker running on the current
+  // thread if it belongs to this worker pool, nullptr otherwise.
+  SchedulerWorkerDeque* GetCurrentWorkerDeque() const;
+
+  // Tries to steal a Sequence from the deque of a worker other than |thief|.
+  // Returns nullptr if all deques are empty.
+  scoped_refptr<Sequence> StealSequence(SchedulerWorkerDelegateImpl* thief);
+
+  // Adds |worker| to |idle_workers_stack_| and returns true, unless the deque
+  // of a worker of this pool has a Sequence that |worker| could steal, in
+  // which case this returns false.
+  bool AddToIdleWorkersStackIfNoStealableWork(SchedulerWorker* worker);
 
   // Peeks from |idle_workers_stack_|.
   const SchedulerWorker* PeekAtIdleWorkersStack() const;
@@ -137,7 +157,8 @@ class BASE_EXPORT SchedulerWorkerPoolImpl : public SchedulerWorkerPool {
   // TaskRunner returned by this pool.
   size_t next_worker_index_ = 0;
 
-  // PriorityQueue from which all threads of this worker pool get work.
+  // PriorityQueue from which all threads of this worker pool get work that
+  // isn't in their own deque.
   PriorityQueue shared_priority_queue_;
 
   // Indicates whether Tasks on this worker pool are allowed to make I/O calls.
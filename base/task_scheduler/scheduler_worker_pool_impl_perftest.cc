@@ -0,0 +1,147 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/callback.h"
+#include "base/format_macros.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/task_runner.h"
+#include "base/task_scheduler/delayed_task_manager.h"
+#include "base/task_scheduler/scheduler_worker_pool_impl.h"
+#include "base/task_scheduler/scheduler_worker_pool_params.h"
+#include "base/task_scheduler/sequence.h"
+#include "base/task_scheduler/sequence_sort_key.h"
+#include "base/task_scheduler/task_tracker.h"
+#include "base/task_scheduler/task_traits.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Number of tasks run by each measurement.
+const size_t kNumTasks = 200000;
+
+// Number of workers in the measured worker pools.
+const size_t kNumWorkers[] = {1, 2, 4, 8, 16, 32};
+
+void DecrementAndSignalIfZero(subtle::Atomic32* num_tasks_remaining,
+                              WaitableEvent* all_tasks_ran) {
+  if (subtle::Barrier_AtomicIncrement(num_tasks_remaining, -1) == 0)
+    all_tasks_ran->Signal();
+}
+
+void PostTasks(scoped_refptr<TaskRunner> task_runner,
+               size_t num_tasks,
+               const Closure& task) {
+  for (size_t i = 0; i < num_tasks; ++i)
+    task_runner->PostTask(FROM_HERE, task);
+}
+
+class TaskSchedulerWorkerPoolImplPerfTest : public testing::Test {
+ protected:
+  enum class PostFrom {
+    // Tasks are posted from the main thread, which doesn't belong to the
+    // worker pool.
+    EXTERNAL_THREAD,
+    // Tasks are posted from tasks running in the worker pool, one per worker.
+    WORKERS,
+  };
+
+  TaskSchedulerWorkerPoolImplPerfTest()
+      : delayed_task_manager_(Bind(&DoNothing)) {}
+
+  // Measures the throughput of |kNumTasks| trivial PARALLEL tasks posted as
+  // described by |post_from| to a worker pool with |num_workers| workers.
+  void RunPostToRunTest(const std::string& trace,
+                        size_t num_workers,
+                        PostFrom post_from) {
+    worker_pool_ = SchedulerWorkerPoolImpl::Create(
+        SchedulerWorkerPoolParams("PerfTestWorkerPool", ThreadPriority::NORMAL,
+                                  SchedulerWorkerPoolParams::IORestriction::
+                                      DISALLOWED,
+                                  static_cast<int>(num_workers),
+                                  TimeDelta::Max()),
+        Bind(&TaskSchedulerWorkerPoolImplPerfTest::ReEnqueueSequenceCallback,
+             Unretained(this)),
+        &task_tracker_, &delayed_task_manager_);
+    ASSERT_TRUE(worker_pool_);
+
+    const scoped_refptr<TaskRunner> task_runner =
+        worker_pool_->CreateTaskRunnerWithTraits(TaskTraits(),
+                                                 ExecutionMode::PARALLEL);
+    subtle::Atomic32 num_tasks_remaining = static_cast<subtle::Atomic32>(
+        kNumTasks);
+    WaitableEvent all_tasks_ran(WaitableEvent::ResetPolicy::MANUAL,
+                                WaitableEvent::InitialState::NOT_SIGNALED);
+    const Closure task = Bind(&DecrementAndSignalIfZero,
+                              Unretained(&num_tasks_remaining),
+                              Unretained(&all_tasks_ran));
+
+    const TimeTicks start = TimeTicks::Now();
+    if (post_from == PostFrom::EXTERNAL_THREAD) {
+      PostTasks(task_runner, kNumTasks, task);
+    } else {
+      for (size_t i = 0; i < num_workers; ++i) {
+        task_runner->PostTask(
+            FROM_HERE,
+            Bind(&PostTasks, task_runner, kNumTasks / num_workers, task));
+      }
+    }
+    all_tasks_ran.Wait();
+    const TimeDelta elapsed = TimeTicks::Now() - start;
+
+    worker_pool_->WaitForAllWorkersIdleForTesting();
+    worker_pool_->JoinForTesting();
+    worker_pool_.reset();
+
+    perf_test::PrintResult(
+        "post_to_run", StringPrintf("_%" PRIuS "_workers", num_workers), trace,
+        kNumTasks / elapsed.InSecondsF(), "tasks/s", true);
+  }
+
+ private:
+  void ReEnqueueSequenceCallback(scoped_refptr<Sequence> sequence) {
+    const SequenceSortKey sort_key(sequence->GetSortKey());
+    worker_pool_->ReEnqueueSequence(std::move(sequence), sort_key);
+  }
+
+  std::unique_ptr<SchedulerWorkerPoolImpl> worker_pool_;
+  TaskTracker task_tracker_;
+  DelayedTaskManager delayed_task_manager_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskSchedulerWorkerPoolImplPerfTest);
+};
+
+}  // namespace
+
+TEST_F(TaskSchedulerWorkerPoolImplPerfTest, PostFromExternalThread) {
+  for (size_t num_workers : kNumWorkers)
+    RunPostToRunTest("external_thread", num_workers, PostFrom::EXTERNAL_THREAD);
+}
+
+TEST_F(TaskSchedulerWorkerPoolImplPerfTest, PostFromWorkers) {
+  for (size_t num_workers : kNumWorkers) {
+    // The number of tasks must be divisible by the number of posting workers.
+    ASSERT_EQ(0U, kNumTasks % num_workers);
+    RunPostToRunTest("workers", num_workers, PostFrom::WORKERS);
+  }
+}
+
+}  // namespace internal
+}  // namespace base
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "base/atomicops.h"
+#include "base/barrier_closure.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/callback.h"
@@ -165,6 +166,29 @@ void ShouldNotRunCallback() {
   ADD_FAILURE() << "Ran a task that shouldn't run.";
 }
 
+void RunClosureAndWait(const Closure& closure, WaitableEvent* event) {
+  closure.Run();
+  event->Wait();
+}
+
+// Posts |num_tasks| tasks to |task_runner| and waits until they have all
+// started. Must run on a worker: the posted tasks go to the deque of that
+// worker and can only start if other workers steal them.
+void PostTasksAndWaitForThemToStart(scoped_refptr<TaskRunner> task_runner,
+                                    size_t num_tasks,
+                                    WaitableEvent* tasks_can_exit,
+                                    WaitableEvent* tasks_started) {
+  const Closure barrier = BarrierClosure(
+      static_cast<int>(num_tasks),
+      Bind(&WaitableEvent::Signal, Unretained(tasks_started)));
+  for (size_t i = 0; i < num_tasks; ++i) {
+    EXPECT_TRUE(task_runner->PostTask(
+        FROM_HERE,
+        Bind(&RunClosureAndWait, barrier, Unretained(tasks_can_exit))));
+  }
+  tasks_started->Wait();
+}
+
 }  // namespace
 
 TEST_P(TaskSchedulerWorkerPoolImplTest, PostTasks) {
@@ -291,6 +315,33 @@ TEST_P(TaskSchedulerWorkerPoolImplTest, Saturate) {
   worker_pool_->WaitForAllWorkersIdleForTesting();
 }
 
+// Verify that Tasks posted from a worker that stays busy are stolen by the
+// other workers.
+TEST_P(TaskSchedulerWorkerPoolImplTest, StealTasksPostedFromWorker) {
+  WaitableEvent tasks_can_exit(WaitableEvent::ResetPolicy::MANUAL,
+                               WaitableEvent::InitialState::NOT_SIGNALED);
+  WaitableEvent tasks_started(WaitableEvent::ResetPolicy::MANUAL,
+                              WaitableEvent::InitialState::NOT_SIGNALED);
+  EXPECT_TRUE(
+      worker_pool_->CreateTaskRunnerWithTraits(TaskTraits(), GetParam())
+          ->PostTask(FROM_HERE,
+                     Bind(&PostTasksAndWaitForThemToStart,
+                          worker_pool_->CreateTaskRunnerWithTraits(
+                              TaskTraits(), ExecutionMode::PARALLEL),
+                          kNumWorkersInWorkerPool - 1,
+                          Unretained(&tasks_can_exit),
+                          Unretained(&tasks_started))));
+
+  // The tasks can only start if they were stolen, since the worker on which
+  // they were posted blocks until they have all started.
+  tasks_started.Wait();
+  tasks_can_exit.Signal();
+
+  // Wait until all workers are idle to be sure that no task accesses the
+  // events after they are destroyed.
+  worker_pool_->WaitForAllWorkersIdleForTesting();
+}
+
 // Verify that a Task can't be posted after shutdown.
 TEST_P(TaskSchedulerWorkerPoolImplTest, PostTaskAfterShutdown) {
   auto task_runner =
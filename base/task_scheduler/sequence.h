@@ -7,12 +7,14 @@
 
 #include <stddef.h>
 
+#include <deque>
 #include <memory>
 #include <queue>
 
 #include "base/base_export.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/small_object_pool.h"
 #include "base/sequence_token.h"
 #include "base/task_scheduler/scheduler_lock.h"
 #include "base/task_scheduler/sequence_sort_key.h"
@@ -70,7 +72,10 @@ class BASE_EXPORT Sequence : public RefCountedThreadSafe<Sequence> {
   mutable SchedulerLock lock_;
 
   // Queue of tasks to execute.
-  std::queue<std::unique_ptr<Task>> queue_;
+  std::queue<std::unique_ptr<Task>,
+             std::deque<std::unique_ptr<Task>,
+                        SmallObjectPoolAllocator<std::unique_ptr<Task>>>>
+      queue_;
 
   // Number of tasks contained in the sequence for each priority.
   size_t num_tasks_per_priority_[static_cast<int>(TaskPriority::HIGHEST) + 1] =
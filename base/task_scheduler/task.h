@@ -10,6 +10,7 @@
 #include "base/location.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/small_object_pool.h"
 #include "base/pending_task.h"
 #include "base/sequenced_task_runner.h"
 #include "base/single_thread_task_runner.h"
@@ -20,8 +21,9 @@ namespace base {
 namespace internal {
 
 // A task is a unit of work inside the task scheduler. Support for tracing and
-// profiling inherited from PendingTask.
-struct BASE_EXPORT Task : public PendingTask {
+// profiling inherited from PendingTask. Tasks are allocated from
+// SmallObjectPool.
+struct BASE_EXPORT Task : public PendingTask, public SmallObjectPoolAllocated {
   // |posted_from| is the site the task was posted from. |task| is the closure
   // to run. |traits| is metadata about the task. |delay| is a delay that must
   // expire before the Task runs.
@@ -9,6 +9,7 @@
 #include "base/command_line.h"
 #include "base/location.h"
 #include "base/memory/scoped_vector.h"
+#include "base/memory/small_object_pool.h"
 #include "base/single_thread_task_runner.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/condition_variable.h"
@@ -150,6 +151,14 @@ TEST_F(TaskPerfTest, TaskPingPong) {
   RunPingPongTest("4_Task_Threads", 4);
 }
 
+// Same as above, but with tasks and callbacks allocated by operator new instead
+// of SmallObjectPool, as a baseline.
+TEST_F(TaskPerfTest, TaskPingPongWithoutPool) {
+  const bool pool_was_enabled = SmallObjectPool::SetEnabled(false);
+  RunPingPongTest("1_Task_Threads_Without_Pool", 1);
+  RunPingPongTest("4_Task_Threads_Without_Pool", 4);
+  SmallObjectPool::SetEnabled(pool_was_enabled);
+}
 
 // Same as above, but add observers to test their perf impact.
 class MessageLoopObserver : public base::MessageLoop::TaskObserver {
@@ -174,6 +183,59 @@ TEST_F(TaskObserverPerfTest, TaskPingPong) {
   RunPingPongTest("4_Task_Threads_With_Observer", 4);
 }
 
+// Class to test contended task posting: every thread but the first one posts
+// empty tasks to the first one as fast as it can.
+class TaskFanInPerfTest : public ThreadPerfTest {
+ public:
+  TaskFanInPerfTest() : remaining_tasks_(0) {}
+
+  void PostTasksToTarget(int num_tasks) {
+    for (int i = 0; i < num_tasks; ++i) {
+      threads_[0]->task_runner()->PostTask(
+          FROM_HERE, base::Bind(&TaskFanInPerfTest::RunTaskOnTarget,
+                                base::Unretained(this)));
+    }
+  }
+
+  void RunTaskOnTarget() {
+    if (--remaining_tasks_ == 0)
+      FinishMeasurement();
+  }
+
+  void PingPong(int hops) override {
+    const int num_posting_threads = static_cast<int>(threads_.size()) - 1;
+    const int tasks_per_thread = hops / num_posting_threads;
+    remaining_tasks_ = tasks_per_thread * num_posting_threads;
+    for (int i = 1; i <= num_posting_threads; ++i) {
+      threads_[i]->task_runner()->PostTask(
+          FROM_HERE, base::Bind(&TaskFanInPerfTest::PostTasksToTarget,
+                                base::Unretained(this), tasks_per_thread));
+    }
+  }
+
+ private:
+  // Only accessed on the first thread once the measurement has started.
+  int remaining_tasks_;
+};
+
+// This measures the cost of posting to a thread that receives tasks from
+// several threads at once, as an IO thread does.
+TEST_F(TaskFanInPerfTest, TaskFanIn) {
+  RunPingPongTest("1_Posting_Thread", 2);
+  RunPingPongTest("4_Posting_Threads", 5);
+  RunPingPongTest("8_Posting_Threads", 9);
+}
+
+// Tasks posted to another thread are freed on a different thread from the one
+// that allocated them, which is the worst case for SmallObjectPool.
+TEST_F(TaskFanInPerfTest, TaskFanInWithoutPool) {
+  const bool pool_was_enabled = SmallObjectPool::SetEnabled(false);
+  RunPingPongTest("1_Posting_Thread_Without_Pool", 2);
+  RunPingPongTest("4_Posting_Threads_Without_Pool", 5);
+  RunPingPongTest("8_Posting_Threads_Without_Pool", 9);
+  SmallObjectPool::SetEnabled(pool_was_enabled);
+}
+
 // Class to test our WaitableEvent performance by signaling back and fort.
 // WaitableEvent is templated so we can also compare with other versions.
 template <typename WaitableEventType>
@@ -12,6 +12,7 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/profiler/task_profiler.h"
 #include "base/strings/stringprintf.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread_local.h"
@@ -90,7 +91,11 @@ void WorkerThread::ThreadMain() {
 
     tracked_objects::TaskStopwatch stopwatch;
     stopwatch.Start();
-    pending_task.task.Run();
+    {
+      TaskProfiler::ScopedTaskRun task_run(pending_task.posted_from,
+                                           pending_task);
+      pending_task.task.Run();
+    }
     stopwatch.Stop();
 
     tracked_objects::ThreadData::TallyRunOnWorkerThreadIfTracking(
@@ -27,7 +27,7 @@ class PosixDynamicThreadPool::PosixDynamicThreadPoolPeer {
   ConditionVariable* pending_tasks_available_cv() {
     return &pool_->pending_tasks_available_cv_;
   }
-  const std::queue<PendingTask>& pending_tasks() const {
+  const TaskQueue& pending_tasks() const {
     return pool_->pending_tasks_;
   }
   int num_idle_threads() const { return pool_->num_idle_threads_; }
@@ -8,6 +8,7 @@
 #include "base/callback.h"
 #include "base/logging.h"
 #include "base/pending_task.h"
+#include "base/profiler/task_profiler.h"
 #include "base/threading/thread_local.h"
 #include "base/trace_event/trace_event.h"
 #include "base/tracked_objects.h"
@@ -27,7 +28,11 @@ DWORD CALLBACK WorkItemCallback(void* param) {
 
   tracked_objects::TaskStopwatch stopwatch;
   stopwatch.Start();
-  pending_task->task.Run();
+  {
+    TaskProfiler::ScopedTaskRun task_run(pending_task->posted_from,
+                                         *pending_task);
+    pending_task->task.Run();
+  }
   stopwatch.Stop();
 
   g_worker_pool_running_on_this_thread.Get().Set(false);
@@ -8,6 +8,8 @@
 
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/pending_task.h"
 #include "base/single_thread_task_runner.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread_task_runner_handle.h"
@@ -59,8 +61,21 @@ class BaseTimerTaskInternal {
   Timer* timer_;
 };
 
+Timer::ScheduledEntry::ScheduledEntry(Timer* timer) : timer_(timer) {}
+
+Timer::ScheduledEntry::~ScheduledEntry() {}
+
+PendingTask Timer::ScheduledEntry::TakeTask() {
+  DCHECK(!timer_->scheduled_task_);
+  timer_->scheduled_task_ = new BaseTimerTaskInternal(timer_);
+  return PendingTask(timer_->posted_from_,
+                     base::Bind(&BaseTimerTaskInternal::Run,
+                                base::Owned(timer_->scheduled_task_)));
+}
+
 Timer::Timer(bool retain_user_task, bool is_repeating)
     : scheduled_task_(NULL),
+      scheduled_entry_(this),
       thread_id_(0),
       is_repeating_(is_repeating),
       retain_user_task_(retain_user_task),
@@ -72,6 +87,7 @@ Timer::Timer(const tracked_objects::Location& posted_from,
              const base::Closure& user_task,
              bool is_repeating)
     : scheduled_task_(NULL),
+      scheduled_entry_(this),
       posted_from_(posted_from),
       delay_(delay),
       user_task_(user_task),
@@ -116,7 +132,7 @@ void Timer::Reset() {
   DCHECK(!user_task_.is_null());
 
   // If there's no pending task, start one up and return.
-  if (!scheduled_task_) {
+  if (!IsScheduled()) {
     PostNewScheduledTask(delay_);
     return;
   }
@@ -134,7 +150,8 @@ void Timer::Reset() {
     return;
   }
 
-  // We can't reuse the scheduled_task_, so abandon it and post a new one.
+  // We can't reuse the scheduled_task_, so abandon it and post a new one. A
+  // scheduled_entry_ is just moved.
   AbandonScheduledTask();
   PostNewScheduledTask(delay_);
 }
@@ -148,15 +165,19 @@ void Timer::SetTaskInfo(const tracked_objects::Location& posted_from,
 }
 
 void Timer::PostNewScheduledTask(TimeDelta delay) {
-  DCHECK(scheduled_task_ == NULL);
+  DCHECK(!IsScheduled());
   is_running_ = true;
-  scheduled_task_ = new BaseTimerTaskInternal(this);
   if (delay > TimeDelta::FromMicroseconds(0)) {
-    GetTaskRunner()->PostDelayedTask(posted_from_,
-        base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)),
-        delay);
     scheduled_run_time_ = desired_run_time_ = TimeTicks::Now() + delay;
+    if (!ScheduleEntry(scheduled_run_time_)) {
+      scheduled_task_ = new BaseTimerTaskInternal(this);
+      GetTaskRunner()->PostDelayedTask(posted_from_,
+          base::Bind(&BaseTimerTaskInternal::Run,
+                     base::Owned(scheduled_task_)),
+          delay);
+    }
   } else {
+    scheduled_task_ = new BaseTimerTaskInternal(this);
     GetTaskRunner()->PostTask(posted_from_,
         base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)));
     scheduled_run_time_ = desired_run_time_ = TimeTicks();
@@ -169,6 +190,19 @@ void Timer::PostNewScheduledTask(TimeDelta delay) {
   }
 }
 
+bool Timer::ScheduleEntry(TimeTicks run_time) {
+  if (task_runner_)
+    return false;
+  MessageLoop* message_loop = MessageLoop::current();
+  if (!message_loop)
+    return false;
+  return message_loop->ScheduleDelayedWorkEntry(&scheduled_entry_, run_time);
+}
+
+bool Timer::IsScheduled() const {
+  return scheduled_task_ || scheduled_entry_.is_scheduled();
+}
+
 scoped_refptr<SingleThreadTaskRunner> Timer::GetTaskRunner() {
   return task_runner_.get() ? task_runner_ : ThreadTaskRunnerHandle::Get();
 }
@@ -180,6 +214,8 @@ void Timer::AbandonScheduledTask() {
     scheduled_task_->Abandon();
     scheduled_task_ = NULL;
   }
+  if (scheduled_entry_.is_scheduled())
+    scheduled_entry_.Cancel();
 }
 
 void Timer::RunScheduledTask() {
@@ -55,6 +55,7 @@
 #include "base/callback.h"
 #include "base/location.h"
 #include "base/macros.h"
+#include "base/message_loop/timing_wheel.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -129,18 +130,45 @@ class BASE_EXPORT Timer {
  private:
   friend class BaseTimerTaskInternal;
 
-  // Allocates a new scheduled_task_ and posts it on the current MessageLoop
-  // with the given |delay|. scheduled_task_ must be NULL. scheduled_run_time_
-  // and desired_run_time_ are reset to Now() + delay.
+  // Schedules the timer in the delayed work queue of the thread's MessageLoop,
+  // which lets the timer cancel or move it at no cost. When it is due, it
+  // hands a BaseTimerTaskInternal to the MessageLoop.
+  class ScheduledEntry : public TimingWheel::Entry {
+   public:
+    explicit ScheduledEntry(Timer* timer);
+    ~ScheduledEntry() override;
+
+    // TimingWheel::Entry:
+    PendingTask TakeTask() override;
+
+   private:
+    Timer* const timer_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScheduledEntry);
+  };
+
+  // Schedules scheduled_entry_ or allocates a new scheduled_task_ and posts it
+  // on the current MessageLoop with the given |delay|. Neither must be
+  // pending. scheduled_run_time_ and desired_run_time_ are reset to
+  // Now() + delay.
   void PostNewScheduledTask(TimeDelta delay);
 
+  // Schedules scheduled_entry_ to run at |run_time| in the current
+  // MessageLoop. Returns false if the timer must post a task instead, because
+  // it has its own task runner or the current thread's tasks are not run by a
+  // MessageLoop.
+  bool ScheduleEntry(TimeTicks run_time);
+
+  // Returns true if scheduled_task_ or scheduled_entry_ is pending.
+  bool IsScheduled() const;
+
   // Returns the task runner on which the task should be scheduled. If the
   // corresponding task_runner_ field is null, the task runner for the current
   // thread is returned.
   scoped_refptr<SingleThreadTaskRunner> GetTaskRunner();
 
   // Disable scheduled_task_ and abandon it so that it no longer refers back to
-  // this object.
+  // this object, and cancel scheduled_entry_.
   void AbandonScheduledTask();
 
   // Called by BaseTimerTaskInternal when the MessageLoop runs it.
@@ -156,6 +184,11 @@ class BASE_EXPORT Timer {
   // RunScheduledTask() at scheduled_run_time_.
   BaseTimerTaskInternal* scheduled_task_;
 
+  // Used instead of scheduled_task_ when the timer is scheduled directly in
+  // the MessageLoop's queue of delayed tasks, where rescheduling it does not
+  // abandon anything. Becomes a scheduled_task_ when it is due.
+  ScheduledEntry scheduled_entry_;
+
   // The task runner on which the task should be scheduled. If it is null, the
   // task runner for the current thread should be used.
   scoped_refptr<SingleThreadTaskRunner> task_runner_;
@@ -167,9 +200,9 @@ class BASE_EXPORT Timer {
   // user_task_ is what the user wants to be run at desired_run_time_.
   base::Closure user_task_;
 
-  // The estimated time that the MessageLoop will run the scheduled_task_ that
-  // will call RunScheduledTask(). This time can be a "zero" TimeTicks if the
-  // task must be run immediately.
+  // The estimated time that the MessageLoop will run the scheduled_task_ or
+  // scheduled_entry_ that will call RunScheduledTask(). This time can be a
+  // "zero" TimeTicks if the task must be run immediately.
   TimeTicks scheduled_run_time_;
 
   // The desired run time of user_task_. The user may update this at any time,
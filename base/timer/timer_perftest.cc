@@ -0,0 +1,127 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/memory/ptr_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Like the idle and keepalive timers of a network stack: many timers with
+// long delays, which are reset much more often than they fire.
+const int kNumTimers = 100000;
+const int kNumResets = 2000000;
+// The loop runs in between batches of resets, which lets it sort the tasks
+// posted by the timers that do not use the delayed work queue directly.
+const int kResetsPerBatch = 10000;
+
+class TimerPerfTest : public testing::Test {
+ public:
+  TimerPerfTest() : random_state_(0x2545F4914F6CDD1DULL) {}
+
+  enum ResetMode {
+    // Reset() with the same delay, which always moves the timer later.
+    SAME_DELAY,
+    // Start() with a random delay, which moves the timer earlier half of the
+    // time.
+    RANDOM_DELAY,
+  };
+
+  // With |post_tasks|, the timers are given the loop's task runner, which
+  // makes them post tasks as they do on threads without a MessageLoop.
+  void Run(ResetMode mode, bool post_tasks) {
+    MessageLoop loop;
+    const Closure task = Bind(&DoNothing);
+    std::vector<std::unique_ptr<OneShotTimer>> timers;
+    for (int i = 0; i < kNumTimers; ++i) {
+      timers.push_back(WrapUnique(new OneShotTimer));
+      if (post_tasks)
+        timers.back()->SetTaskRunner(loop.task_runner());
+    }
+
+    TimeTicks start = TimeTicks::Now();
+    for (const auto& timer : timers)
+      timer->Start(FROM_HERE, RandomDelay(), task);
+    RunLoop().RunUntilIdle();
+    TimeDelta elapsed = TimeTicks::Now() - start;
+    const std::string trace = post_tasks ? "posted_tasks" : "timing_wheel";
+    perf_test::PrintResult("start", "", trace,
+                           elapsed.InMicroseconds() * 1000.0 / kNumTimers,
+                           "ns/timer", true);
+
+    start = TimeTicks::Now();
+    for (int i = 0; i < kNumResets; i += kResetsPerBatch) {
+      for (int j = 0; j < kResetsPerBatch; ++j) {
+        OneShotTimer* timer = timers[Random(kNumTimers)].get();
+        if (mode == SAME_DELAY)
+          timer->Reset();
+        else
+          timer->Start(FROM_HERE, RandomDelay(), task);
+      }
+      RunLoop().RunUntilIdle();
+    }
+    elapsed = TimeTicks::Now() - start;
+    perf_test::PrintResult(
+        mode == SAME_DELAY ? "reset_same_delay" : "reset_random_delay", "",
+        trace, elapsed.InMicroseconds() * 1000.0 / kNumResets, "ns/reset",
+        true);
+
+    start = TimeTicks::Now();
+    timers.clear();
+    elapsed = TimeTicks::Now() - start;
+    perf_test::PrintResult("stop", "", trace,
+                           elapsed.InMicroseconds() * 1000.0 / kNumTimers,
+                           "ns/timer", true);
+  }
+
+ private:
+  uint64_t Random(uint64_t range) {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 7;
+    random_state_ ^= random_state_ << 17;
+    return random_state_ % range;
+  }
+
+  // Between 10 seconds and 2 minutes, so that no timer fires.
+  TimeDelta RandomDelay() {
+    return TimeDelta::FromMilliseconds(10000 + Random(110000));
+  }
+
+  uint64_t random_state_;
+};
+
+}  // namespace
+
+TEST_F(TimerPerfTest, ResetSameDelay) {
+  Run(SAME_DELAY, false);
+}
+
+TEST_F(TimerPerfTest, ResetSameDelayPostedTasks) {
+  Run(SAME_DELAY, true);
+}
+
+TEST_F(TimerPerfTest, ResetRandomDelay) {
+  Run(RANDOM_DELAY, false);
+}
+
+TEST_F(TimerPerfTest, ResetRandomDelayPostedTasks) {
+  Run(RANDOM_DELAY, true);
+}
+
+}  // namespace base
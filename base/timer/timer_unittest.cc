@@ -7,6 +7,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <vector>
 
 #include "base/macros.h"
 #include "base/message_loop/message_loop.h"
@@ -536,4 +537,36 @@ TEST(TimerTest, ContinuationReset) {
   }
 }
 
+void AppendToOrder(std::vector<int>* order, int id) {
+  order->push_back(id);
+}
+
+// Timers are scheduled in the delayed work queue of the MessageLoop, along
+// with the tasks posted with a delay.
+TEST(TimerTest, TimersAndDelayedTasksRunInOrder) {
+  base::MessageLoop loop;
+  std::vector<int> order;
+  base::OneShotTimer moved_earlier;
+  base::OneShotTimer stopped;
+  base::RunLoop run_loop;
+  loop.task_runner()->PostDelayedTask(
+      FROM_HERE, base::Bind(&AppendToOrder, &order, 1),
+      TimeDelta::FromMilliseconds(10));
+  moved_earlier.Start(FROM_HERE, TimeDelta::FromDays(1),
+                      base::Bind(&AppendToOrder, &order, 2));
+  stopped.Start(FROM_HERE, TimeDelta::FromMilliseconds(5),
+                base::Bind(&AppendToOrder, &order, 0));
+  loop.task_runner()->PostDelayedTask(
+      FROM_HERE, base::Bind(&AppendToOrder, &order, 3),
+      TimeDelta::FromMilliseconds(40));
+  moved_earlier.Start(FROM_HERE, TimeDelta::FromMilliseconds(20),
+                      base::Bind(&AppendToOrder, &order, 2));
+  stopped.Stop();
+  loop.task_runner()->PostDelayedTask(FROM_HERE, run_loop.QuitClosure(),
+                                      TimeDelta::FromMilliseconds(60));
+  run_loop.Run();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+  EXPECT_FALSE(moved_earlier.IsRunning());
+}
+
 }  // namespace
@@ -0,0 +1,481 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/compact_trace_buffer.h"
+
+#include <string.h>
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/trace_event/heap_profiler.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_impl.h"
+#include "base/trace_event/trace_event_memory_overhead.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// A new block is started once the current one has less room than an average
+// event with short arguments needs.
+const size_t kBlockSize = 64 * 1024;
+const size_t kBlockSlack = 256;
+
+// Returned chunks that are kept for reuse by GetChunk().
+const size_t kMaxSpareChunks = 8;
+
+// Used by Capacity() until the first events are encoded.
+const size_t kAssumedBytesPerEvent = 24;
+
+// Encoding --------------------------------------------------------------------
+//
+// Each event is encoded as:
+//   phase               1 byte
+//   flags               varint
+//   category group      varint, interned id
+//   name                string
+//   timestamp           zigzag varint, delta from the previous event of the
+//                       block
+//   thread id           zigzag varint
+//   thread timestamp    zigzag varint
+//   [duration]          2 zigzag varints, for COMPLETE events
+//   [scope, id]         string and varint, with TRACE_EVENT_FLAG_HAS_ID
+//   [bind id]           varint, for flow events and BIND_IDS
+//   argument count      1 byte
+//   arguments           name string, type byte and value each
+//
+// A string is a varint: 0 for null, (id + 1) << 1 for an interned pointer, or
+// (length << 1) | 1 followed by the characters and a terminating NUL, so that
+// decoded events can point into the block.
+
+void WriteVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+uint64_t ReadVarint(const char** pos) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(*(*pos)++);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+bool HasBindId(char phase, unsigned int flags) {
+  return (flags & (TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT)) ||
+         phase == TRACE_EVENT_PHASE_BIND_IDS;
+}
+
+// Returns true if |chunk| holds a COMPLETE event whose duration is not known
+// yet.
+bool HasUnfinishedEvents(const TraceBufferChunk& chunk) {
+  for (size_t i = 0; i < chunk.size(); ++i) {
+    const TraceEvent* event = chunk.GetEventAt(i);
+    if (event->phase() == TRACE_EVENT_PHASE_COMPLETE &&
+        event->duration().ToInternalValue() == -1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Replays the JSON that a convertable argument produced when its event was
+// encoded.
+class EncodedConvertable : public ConvertableToTraceFormat {
+ public:
+  explicit EncodedConvertable(const char* json) : json_(json) {}
+  ~EncodedConvertable() override {}
+
+  // ConvertableToTraceFormat:
+  void AppendAsTraceFormat(std::string* out) const override { *out += json_; }
+
+ private:
+  const char* const json_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncodedConvertable);
+};
+
+}  // namespace
+
+CompactTraceBuffer::Block::Block() : event_count(0), last_timestamp(0) {}
+
+CompactTraceBuffer::Block::~Block() {}
+
+CompactTraceBuffer::CompactTraceBuffer(size_t max_bytes, Mode mode)
+    : max_bytes_(max_bytes),
+      mode_(mode),
+      next_chunk_seq_(1),
+      encoded_size_(0),
+      encoded_event_count_(0),
+      iterating_(false),
+      next_block_(0),
+      next_offset_(0),
+      decoded_timestamp_(0) {}
+
+CompactTraceBuffer::~CompactTraceBuffer() {}
+
+std::unique_ptr<TraceBufferChunk> CompactTraceBuffer::GetChunk(size_t* index) {
+  HEAP_PROFILER_SCOPED_IGNORE;
+
+  if (free_slots_.empty()) {
+    *index = slots_.size();
+    slots_.push_back(nullptr);
+  } else {
+    *index = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  DCHECK(*index <= TraceBufferChunk::kMaxChunkIndex);
+
+  // Zero chunk_seq is not allowed.
+  if (!next_chunk_seq_)
+    ++next_chunk_seq_;
+  if (spare_chunks_.empty())
+    return WrapUnique(new TraceBufferChunk(next_chunk_seq_++));
+  std::unique_ptr<TraceBufferChunk> chunk = std::move(spare_chunks_.back());
+  spare_chunks_.pop_back();
+  chunk->Reset(next_chunk_seq_++);
+  return chunk;
+}
+
+void CompactTraceBuffer::ReturnChunk(size_t index,
+                                     std::unique_ptr<TraceBufferChunk> chunk) {
+  HEAP_PROFILER_SCOPED_IGNORE;
+  DCHECK(chunk);
+  DCHECK_LT(index, slots_.size());
+  DCHECK(!slots_[index]);
+
+  EncodeKeptChunks(false);
+  if (HasUnfinishedEvents(*chunk)) {
+    slots_[index] = std::move(chunk);
+    kept_slots_.push_back(index);
+  } else {
+    EncodeChunk(index, std::move(chunk));
+  }
+}
+
+bool CompactTraceBuffer::IsFull() const {
+  return mode_ == RECORD_UNTIL_FULL && encoded_size_ >= max_bytes_;
+}
+
+size_t CompactTraceBuffer::Size() const {
+  // This is approximate because not all of the kept chunks are full.
+  return encoded_event_count_ +
+         kept_slots_.size() * TraceBufferChunk::kTraceBufferChunkSize;
+}
+
+size_t CompactTraceBuffer::Capacity() const {
+  if (!encoded_event_count_)
+    return max_bytes_ / kAssumedBytesPerEvent;
+  // Extrapolates from the average size of the events so far.
+  return static_cast<size_t>(static_cast<double>(max_bytes_) *
+                             encoded_event_count_ / encoded_size_);
+}
+
+TraceEvent* CompactTraceBuffer::GetEventByHandle(TraceEventHandle handle) {
+  if (handle.chunk_index >= slots_.size())
+    return nullptr;
+  TraceBufferChunk* chunk = slots_[handle.chunk_index].get();
+  if (!chunk || chunk->seq() != handle.chunk_seq)
+    return nullptr;
+  return chunk->GetEventAt(handle.event_index);
+}
+
+const TraceBufferChunk* CompactTraceBuffer::NextChunk() {
+  if (!iterating_) {
+    // Events that have not ended by now are output without a duration, as
+    // the other buffers do.
+    EncodeKeptChunks(true);
+    iterating_ = true;
+    decoded_chunk_.reset(new TraceBufferChunk(0));
+  }
+
+  decoded_chunk_->Reset(0);
+  while (!decoded_chunk_->IsFull() && next_block_ < blocks_.size()) {
+    if (next_offset_ == blocks_[next_block_].data.size()) {
+      ++next_block_;
+      next_offset_ = 0;
+      decoded_timestamp_ = 0;
+      continue;
+    }
+    DecodeEvent();
+  }
+  return decoded_chunk_->size() ? decoded_chunk_.get() : nullptr;
+}
+
+void CompactTraceBuffer::EstimateTraceMemoryOverhead(
+    TraceEventMemoryOverhead* overhead) {
+  size_t allocated_size = sizeof(*this) +
+                          slots_.capacity() * sizeof(slots_[0]) +
+                          interned_.capacity() * sizeof(interned_[0]) +
+                          intern_ids_.size() * 2 * sizeof(interned_[0]);
+  size_t resident_size = allocated_size;
+  for (const Block& block : blocks_) {
+    allocated_size += block.data.capacity();
+    resident_size += block.data.size();
+  }
+  overhead->Add("CompactTraceBuffer", allocated_size, resident_size);
+
+  // Chunks in flight are accounted by the thread-local buffers.
+  for (size_t index : kept_slots_)
+    slots_[index]->EstimateTraceMemoryOverhead(overhead);
+  for (const auto& chunk : spare_chunks_)
+    chunk->EstimateTraceMemoryOverhead(overhead);
+}
+
+void CompactTraceBuffer::EncodeChunk(size_t index,
+                                     std::unique_ptr<TraceBufferChunk> chunk) {
+  DCHECK(!iterating_);
+  for (size_t i = 0; i < chunk->size(); ++i) {
+    if (blocks_.empty() ||
+        blocks_.back().data.size() + kBlockSlack > kBlockSize) {
+      blocks_.emplace_back();
+      blocks_.back().data.reserve(kBlockSize);
+    }
+    Block* block = &blocks_.back();
+    const size_t old_size = block->data.size();
+    EncodeEvent(*chunk->GetEventAt(i), block);
+    ++block->event_count;
+    encoded_size_ += block->data.size() - old_size;
+    ++encoded_event_count_;
+  }
+
+  free_slots_.push_back(index);
+  if (spare_chunks_.size() < kMaxSpareChunks)
+    spare_chunks_.push_back(std::move(chunk));
+
+  if (mode_ == RECORD_CONTINUOUSLY) {
+    // Never drop the block being written.
+    while (encoded_size_ > max_bytes_ && blocks_.size() > 1) {
+      encoded_size_ -= blocks_.front().data.size();
+      encoded_event_count_ -= blocks_.front().event_count;
+      blocks_.pop_front();
+    }
+  }
+}
+
+void CompactTraceBuffer::EncodeKeptChunks(bool all) {
+  for (size_t i = 0; i < kept_slots_.size();) {
+    const size_t index = kept_slots_[i];
+    if (!all && HasUnfinishedEvents(*slots_[index])) {
+      ++i;
+      continue;
+    }
+    kept_slots_[i] = kept_slots_.back();
+    kept_slots_.pop_back();
+    EncodeChunk(index, std::move(slots_[index]));
+  }
+}
+
+void CompactTraceBuffer::EncodeEvent(const TraceEvent& event, Block* block) {
+  std::string* out = &block->data;
+  const unsigned int flags = event.flags();
+  const bool copy = !!(flags & TRACE_EVENT_FLAG_COPY);
+
+  out->push_back(event.phase());
+  WriteVarint(flags, out);
+  WriteVarint(Intern(event.category_group_enabled()), out);
+  EncodeString(event.name(), copy, out);
+
+  const int64_t timestamp = event.timestamp().ToInternalValue();
+  WriteVarint(ZigZagEncode(timestamp - block->last_timestamp), out);
+  block->last_timestamp = timestamp;
+  WriteVarint(ZigZagEncode(event.thread_id()), out);
+  WriteVarint(ZigZagEncode(event.thread_timestamp().ToInternalValue()), out);
+  if (event.phase() == TRACE_EVENT_PHASE_COMPLETE) {
+    WriteVarint(ZigZagEncode(event.duration().ToInternalValue()), out);
+    WriteVarint(ZigZagEncode(event.thread_duration().ToInternalValue()), out);
+  }
+
+  if (flags & TRACE_EVENT_FLAG_HAS_ID) {
+    EncodeString(event.scope(), copy, out);
+    WriteVarint(event.id(), out);
+  }
+  if (HasBindId(event.phase(), flags))
+    WriteVarint(event.bind_id(), out);
+
+  int num_args = 0;
+  while (num_args < kTraceMaxNumArgs && event.arg_name(num_args))
+    ++num_args;
+  out->push_back(static_cast<char>(num_args));
+  for (int i = 0; i < num_args; ++i) {
+    EncodeString(event.arg_name(i), copy, out);
+    const unsigned char type = event.arg_type(i);
+    const TraceEvent::TraceValue value = event.arg_value(i);
+    out->push_back(static_cast<char>(type));
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL:
+        out->push_back(value.as_bool ? 1 : 0);
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+      case TRACE_VALUE_TYPE_POINTER:
+        WriteVarint(value.as_uint, out);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        WriteVarint(ZigZagEncode(value.as_int), out);
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE:
+        out->append(reinterpret_cast<const char*>(&value.as_double),
+                    sizeof(value.as_double));
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+        EncodeString(value.as_string, false, out);
+        break;
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        EncodeString(value.as_string, true, out);
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE: {
+        std::string json;
+        event.arg_convertable_value(i)->AppendAsTraceFormat(&json);
+        EncodeString(json.c_str(), true, out);
+        break;
+      }
+      default:
+        NOTREACHED() << "Don't know how to encode this value";
+        break;
+    }
+  }
+}
+
+void CompactTraceBuffer::EncodeString(const char* str,
+                                      bool copy,
+                                      std::string* out) {
+  if (!str) {
+    WriteVarint(0, out);
+  } else if (copy) {
+    const size_t length = strlen(str);
+    WriteVarint((static_cast<uint64_t>(length) << 1) | 1, out);
+    out->append(str, length + 1);
+  } else {
+    WriteVarint((static_cast<uint64_t>(Intern(str)) + 1) << 1, out);
+  }
+}
+
+uint32_t CompactTraceBuffer::Intern(const void* pointer) {
+  auto inserted = intern_ids_.insert(
+      std::make_pair(pointer, static_cast<uint32_t>(interned_.size())));
+  if (inserted.second)
+    interned_.push_back(pointer);
+  return inserted.first->second;
+}
+
+void CompactTraceBuffer::DecodeEvent() {
+  const Block& block = blocks_[next_block_];
+  const char* pos = block.data.data() + next_offset_;
+
+  auto read_string = [this, &pos]() -> const char* {
+    const uint64_t tag = ReadVarint(&pos);
+    if (!tag)
+      return nullptr;
+    if (!(tag & 1))
+      return static_cast<const char*>(interned_[(tag >> 1) - 1]);
+    const char* str = pos;
+    pos += (tag >> 1) + 1;
+    return str;
+  };
+
+  const char phase = *pos++;
+  // Copied strings point into the block, so the decoded event need not copy
+  // them again.
+  const unsigned int flags =
+      static_cast<unsigned int>(ReadVarint(&pos)) & ~TRACE_EVENT_FLAG_COPY;
+  const unsigned char* category_group_enabled =
+      static_cast<const unsigned char*>(interned_[ReadVarint(&pos)]);
+  const char* name = read_string();
+
+  decoded_timestamp_ += ZigZagDecode(ReadVarint(&pos));
+  const TimeTicks timestamp = TimeTicks::FromInternalValue(decoded_timestamp_);
+  const int thread_id = static_cast<int>(ZigZagDecode(ReadVarint(&pos)));
+  const ThreadTicks thread_timestamp =
+      ThreadTicks::FromInternalValue(ZigZagDecode(ReadVarint(&pos)));
+  int64_t duration = -1;
+  int64_t thread_duration = -1;
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    duration = ZigZagDecode(ReadVarint(&pos));
+    thread_duration = ZigZagDecode(ReadVarint(&pos));
+  }
+
+  const char* scope = trace_event_internal::kGlobalScope;
+  unsigned long long id = trace_event_internal::kNoId;
+  if (flags & TRACE_EVENT_FLAG_HAS_ID) {
+    scope = read_string();
+    id = ReadVarint(&pos);
+  }
+  unsigned long long bind_id = trace_event_internal::kNoId;
+  if (HasBindId(phase, flags))
+    bind_id = ReadVarint(&pos);
+
+  const int num_args = *pos++;
+  DCHECK_LE(num_args, kTraceMaxNumArgs);
+  const char* arg_names[kTraceMaxNumArgs];
+  unsigned char arg_types[kTraceMaxNumArgs];
+  unsigned long long arg_values[kTraceMaxNumArgs];
+  std::unique_ptr<ConvertableToTraceFormat>
+      convertable_values[kTraceMaxNumArgs];
+  for (int i = 0; i < num_args; ++i) {
+    arg_names[i] = read_string();
+    arg_types[i] = static_cast<unsigned char>(*pos++);
+    TraceEvent::TraceValue value;
+    value.as_uint = 0;
+    switch (arg_types[i]) {
+      case TRACE_VALUE_TYPE_BOOL:
+        value.as_bool = !!*pos++;
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+      case TRACE_VALUE_TYPE_POINTER:
+        value.as_uint = ReadVarint(&pos);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        value.as_int = ZigZagDecode(ReadVarint(&pos));
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE:
+        memcpy(&value.as_double, pos, sizeof(value.as_double));
+        pos += sizeof(value.as_double);
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        value.as_string = read_string();
+        arg_types[i] = TRACE_VALUE_TYPE_STRING;
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE:
+        convertable_values[i].reset(new EncodedConvertable(read_string()));
+        break;
+    }
+    arg_values[i] = value.as_uint;
+  }
+
+  next_offset_ = pos - block.data.data();
+  DCHECK_LE(next_offset_, block.data.size());
+
+  size_t event_index;
+  TraceEvent* event = decoded_chunk_->AddTraceEvent(&event_index);
+  event->Initialize(thread_id, timestamp, thread_timestamp, phase,
+                    category_group_enabled, name, scope, id, bind_id,
+                    num_args, arg_names, arg_types, arg_values,
+                    convertable_values, flags);
+  if (duration != -1) {
+    event->UpdateDuration(
+        timestamp + TimeDelta::FromInternalValue(duration),
+        thread_timestamp + TimeDelta::FromInternalValue(thread_duration));
+  }
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,128 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_COMPACT_TRACE_BUFFER_H_
+#define BASE_TRACE_EVENT_COMPACT_TRACE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/hash_tables.h"
+#include "base/macros.h"
+#include "base/trace_event/trace_buffer.h"
+
+namespace base {
+namespace trace_event {
+
+// CompactTraceBuffer is a TraceBuffer that keeps the events of returned chunks
+// in a compact binary encoding instead of as TraceEvent objects:
+//   - category groups, and the names, scopes, argument names and string
+//     arguments that are not copied, are interned and stored as small ids;
+//   - timestamps are stored as varint deltas from the previous event;
+//   - copied strings and the JSON of convertable arguments are stored inline.
+// A TraceEvent takes about 200 bytes plus its copied strings, while a typical
+// encoded event takes 10 to 20.
+//
+// Threads still write TraceEvents into TraceBufferChunks, which are encoded
+// and recycled when they are returned. A chunk holding a COMPLETE event that
+// has not ended yet is kept until the event ends, so that its duration can
+// still be updated through GetEventByHandle().
+//
+// NextChunk() decodes the events into a single reused chunk, so the JSON
+// conversion during TraceLog::Flush() streams through the buffer without
+// materializing its events.
+class BASE_EXPORT CompactTraceBuffer : public TraceBuffer {
+ public:
+  enum Mode {
+    // IsFull() once |max_bytes| of events are stored.
+    RECORD_UNTIL_FULL,
+    // Drops the oldest events to stay within |max_bytes|.
+    RECORD_CONTINUOUSLY,
+  };
+
+  CompactTraceBuffer(size_t max_bytes, Mode mode);
+  ~CompactTraceBuffer() override;
+
+  // TraceBuffer:
+  std::unique_ptr<TraceBufferChunk> GetChunk(size_t* index) override;
+  void ReturnChunk(size_t index,
+                   std::unique_ptr<TraceBufferChunk> chunk) override;
+  bool IsFull() const override;
+  size_t Size() const override;
+  size_t Capacity() const override;
+  TraceEvent* GetEventByHandle(TraceEventHandle handle) override;
+  const TraceBufferChunk* NextChunk() override;
+  void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead) override;
+
+  // Returns the number of bytes taken by the encoded events.
+  size_t encoded_size() const { return encoded_size_; }
+
+ private:
+  // Encoded events are appended to blocks of about kBlockSize bytes, which
+  // can be dropped or decoded independently of each other.
+  struct Block {
+    Block();
+    ~Block();
+
+    std::string data;
+    size_t event_count;
+    // Timestamp of the last event, for the delta of the next one.
+    int64_t last_timestamp;
+  };
+
+  // Encodes the events of |chunk| and recycles it and its slot.
+  void EncodeChunk(size_t index, std::unique_ptr<TraceBufferChunk> chunk);
+
+  // Encodes the kept chunks whose events have all ended, or all of them if
+  // |all| is true.
+  void EncodeKeptChunks(bool all);
+
+  void EncodeEvent(const TraceEvent& event, Block* block);
+  void EncodeString(const char* str, bool copy, std::string* out);
+  uint32_t Intern(const void* pointer);
+
+  // Decodes the next event at |next_block_| and |next_offset_| into
+  // |decoded_chunk_|.
+  void DecodeEvent();
+
+  const size_t max_bytes_;
+  const Mode mode_;
+
+  // Chunks handed out by GetChunk() or kept for their unfinished events,
+  // indexed by the |index| of GetChunk(). In-flight chunks and free slots are
+  // null.
+  std::vector<std::unique_ptr<TraceBufferChunk>> slots_;
+  std::vector<size_t> free_slots_;
+  std::vector<size_t> kept_slots_;
+  std::vector<std::unique_ptr<TraceBufferChunk>> spare_chunks_;
+  uint32_t next_chunk_seq_;
+
+  std::deque<Block> blocks_;
+  size_t encoded_size_;
+  size_t encoded_event_count_;
+
+  // Interned pointers: category group enabled flags and long-lived strings.
+  hash_map<const void*, uint32_t> intern_ids_;
+  std::vector<const void*> interned_;
+
+  // Iteration state of NextChunk().
+  bool iterating_;
+  size_t next_block_;
+  size_t next_offset_;
+  int64_t decoded_timestamp_;
+  std::unique_ptr<TraceBufferChunk> decoded_chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactTraceBuffer);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_COMPACT_TRACE_BUFFER_H_
@@ -13,6 +13,7 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/trace_event/heap_profiler_allocation_context.h"
+#include "base/trace_event/heap_profiler_allocation_sampler.h"
 
 namespace base {
 namespace trace_event {
@@ -82,6 +83,9 @@ class BASE_EXPORT AllocationContextTracker {
   // Returns a snapshot of the current thread-local context.
   AllocationContext GetContextSnapshot();
 
+  // Returns the sampler for the allocations of the current thread.
+  AllocationSampler* sampler() { return &sampler_; }
+
   ~AllocationContextTracker();
 
  private:
@@ -101,6 +105,8 @@ class BASE_EXPORT AllocationContextTracker {
 
   uint32_t ignore_scope_depth_;
 
+  AllocationSampler sampler_;
+
   DISALLOW_COPY_AND_ASSIGN(AllocationContextTracker);
 };
 
@@ -0,0 +1,95 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/heap_profiler_allocation_sampler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/rand_util.h"
+
+namespace base {
+namespace trace_event {
+
+subtle::AtomicWord AllocationSampler::sampling_interval_ = 0;
+
+AllocationSampler::AllocationSampler()
+    : bytes_until_sample_(0), random_state_(0) {}
+
+AllocationSampler::~AllocationSampler() {}
+
+// static
+void AllocationSampler::SetSamplingInterval(size_t sampling_interval) {
+  subtle::NoBarrier_Store(&sampling_interval_,
+                          static_cast<subtle::AtomicWord>(sampling_interval));
+}
+
+// static
+double AllocationSampler::GetSamplingProbability(size_t size,
+                                                 size_t sampling_interval) {
+  if (!sampling_interval)
+    return 1.0;
+  // The probability that at least one of |size| bytes is sampled.
+  return -expm1(-static_cast<double>(size) / sampling_interval);
+}
+
+bool AllocationSampler::ShouldSampleAllocationSlow(size_t size) {
+  const size_t sampling_interval = AllocationSampler::sampling_interval();
+  if (!sampling_interval)
+    return true;
+
+  if (!random_state_) {
+    // The xorshift state must not be zero.
+    random_state_ = RandUint64() | 1;
+    bytes_until_sample_ = NextSampleInterval(sampling_interval);
+    if (static_cast<int64_t>(size) < bytes_until_sample_) {
+      bytes_until_sample_ -= size;
+      return false;
+    }
+  }
+
+  // The allocation covers the next sample point. Since the distance between
+  // sample points is memoryless, the next one is drawn from the end of the
+  // allocation, ignoring any further points within it.
+  bytes_until_sample_ = NextSampleInterval(sampling_interval);
+  return true;
+}
+
+int64_t AllocationSampler::NextSampleInterval(size_t sampling_interval) {
+  // xorshift64*, see http://vigna.di.unimi.it/ftp/papers/xorshift.pdf.
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  const uint64_t bits = random_state_ * UINT64_C(2685821657736338717);
+
+  // A uniformly distributed value in (0, 1], from the 53 high bits.
+  const double uniform = ((bits >> 11) + 1) * (1.0 / (UINT64_C(1) << 53));
+  return static_cast<int64_t>(-log(uniform) * sampling_interval) + 1;
+}
+
+SampledAddressSet::SampledAddressSet() {
+  memset(counts_, 0, sizeof(counts_));
+}
+
+SampledAddressSet::~SampledAddressSet() {}
+
+void SampledAddressSet::Add(const void* address) {
+  subtle::Atomic32* count = &counts_[Hash(address)];
+  subtle::NoBarrier_Store(count, subtle::NoBarrier_Load(count) + 1);
+}
+
+void SampledAddressSet::Remove(const void* address) {
+  subtle::Atomic32* count = &counts_[Hash(address)];
+  DCHECK_GT(subtle::NoBarrier_Load(count), 0);
+  subtle::NoBarrier_Store(count, subtle::NoBarrier_Load(count) - 1);
+}
+
+void SampledAddressSet::Clear() {
+  for (subtle::Atomic32& count : counts_)
+    subtle::NoBarrier_Store(&count, 0);
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,121 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_HEAP_PROFILER_ALLOCATION_SAMPLER_H_
+#define BASE_TRACE_EVENT_HEAP_PROFILER_ALLOCATION_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/macros.h"
+
+namespace base {
+namespace trace_event {
+
+// The allocation sampler decides which allocations the heap profiler records
+// when it runs in sampling mode. Every allocated byte is sampled with the same
+// probability, so that on average one sample is taken per sampling interval
+// of allocated bytes (Poisson sampling). An allocation is sampled if any of its
+// bytes is, which makes the probability of sampling it depend only on its
+// size. Metrics of the sampled allocations can then be scaled by the inverse
+// of that probability to estimate the metrics of all allocations.
+//
+// There is one sampler per thread, so that deciding whether to sample an
+// allocation is a subtraction in the common case.
+class BASE_EXPORT AllocationSampler {
+ public:
+  // The default mean number of bytes between samples.
+  static const size_t kDefaultSamplingInterval = 128 * 1024;
+
+  AllocationSampler();
+  ~AllocationSampler();
+
+  // Globally sets the mean number of bytes between samples. Zero disables
+  // sampling, which means every allocation is recorded.
+  static void SetSamplingInterval(size_t sampling_interval);
+
+  // Returns the global sampling interval.
+  static size_t sampling_interval() {
+    return static_cast<size_t>(subtle::NoBarrier_Load(&sampling_interval_));
+  }
+
+  // Returns the probability that an allocation of |size| bytes is sampled
+  // with the given sampling interval.
+  static double GetSamplingProbability(size_t size, size_t sampling_interval);
+
+  // Returns whether an allocation of |size| bytes is sampled. Must only be
+  // called when the sampling interval is not zero.
+  bool ShouldSampleAllocation(size_t size) {
+    if (static_cast<int64_t>(size) < bytes_until_sample_) {
+      bytes_until_sample_ -= size;
+      return false;
+    }
+    return ShouldSampleAllocationSlow(size);
+  }
+
+ private:
+  // Called when the allocation crosses the next sample point, or when the
+  // sampler is used for the first time.
+  bool ShouldSampleAllocationSlow(size_t size);
+
+  // Draws the number of bytes until the next sample, which is exponentially
+  // distributed with the sampling interval as mean.
+  int64_t NextSampleInterval(size_t sampling_interval);
+
+  static subtle::AtomicWord sampling_interval_;
+
+  // The number of bytes left to allocate until the next sample. Not positive
+  // until the first allocation, so that it is drawn then.
+  int64_t bytes_until_sample_;
+
+  // State of the xorshift generator which draws the sample intervals.
+  uint64_t random_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationSampler);
+};
+
+// A set of addresses of sampled allocations which can be queried without a
+// lock. It is used to skip the lookup in the allocation register when an
+// unsampled allocation is freed, which is the common case. MayContain() may
+// return false positives, but never false negatives. Add(), Remove() and
+// Clear() must be serialized by the caller.
+class BASE_EXPORT SampledAddressSet {
+ public:
+  SampledAddressSet();
+  ~SampledAddressSet();
+
+  void Add(const void* address);
+  void Remove(const void* address);
+
+  // Removes all the addresses. Unlike deleting the set, this is safe while
+  // MayContain() is called concurrently.
+  void Clear();
+
+  bool MayContain(const void* address) const {
+    return subtle::NoBarrier_Load(&counts_[Hash(address)]) != 0;
+  }
+
+ private:
+  // 256 KB of counters keep the false positive rate low for the ~10K live
+  // allocations that are sampled in a typical process.
+  static const size_t kNumBuckets = 1 << 16;
+
+  static size_t Hash(const void* address) {
+    // Multiplicative hashing, taking the high bits of the product. The low
+    // bits of addresses are mostly zero because of alignment.
+    const uint64_t key = reinterpret_cast<uintptr_t>(address);
+    return static_cast<size_t>((key * UINT64_C(0x9E3779B97F4A7C15)) >> 48);
+  }
+
+  subtle::Atomic32 counts_[kNumBuckets];
+
+  DISALLOW_COPY_AND_ASSIGN(SampledAddressSet);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_HEAP_PROFILER_ALLOCATION_SAMPLER_H_
@@ -0,0 +1,115 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/heap_profiler_allocation_sampler.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+const size_t kSamplingInterval = 4096;
+
+}  // namespace
+
+class AllocationSamplerTest : public testing::Test {
+ public:
+  void SetUp() override {
+    AllocationSampler::SetSamplingInterval(kSamplingInterval);
+  }
+
+  void TearDown() override { AllocationSampler::SetSamplingInterval(0); }
+};
+
+TEST_F(AllocationSamplerTest, SamplingProbability) {
+  EXPECT_EQ(1.0, AllocationSampler::GetSamplingProbability(16, 0));
+  EXPECT_EQ(0.0, AllocationSampler::GetSamplingProbability(0, 1024));
+  EXPECT_NEAR(1 - exp(-1.0),
+              AllocationSampler::GetSamplingProbability(1024, 1024), 1e-9);
+  EXPECT_NEAR(1.0, AllocationSampler::GetSamplingProbability(1 << 20, 1024),
+              1e-9);
+}
+
+// The number of samples and the estimates scaled from them should be close to
+// the expected values. The tolerances are several standard deviations wide.
+TEST_F(AllocationSamplerTest, ScaledEstimates) {
+  const size_t kAllocationCount = 200000;
+  const size_t kSizes[] = {16, 256, 4096};
+  AllocationSampler sampler;
+
+  for (size_t size : kSizes) {
+    const double probability =
+        AllocationSampler::GetSamplingProbability(size, kSamplingInterval);
+    size_t sample_count = 0;
+    for (size_t i = 0; i < kAllocationCount; i++) {
+      if (sampler.ShouldSampleAllocation(size))
+        sample_count++;
+    }
+
+    const double expected_samples = kAllocationCount * probability;
+    EXPECT_NEAR(expected_samples, sample_count, 0.15 * expected_samples)
+        << "size " << size;
+    EXPECT_NEAR(kAllocationCount * size, sample_count / probability * size,
+                0.15 * kAllocationCount * size)
+        << "size " << size;
+  }
+}
+
+TEST_F(AllocationSamplerTest, LargeAllocationsAreAlwaysSampled) {
+  AllocationSampler sampler;
+  for (size_t i = 0; i < 1000; i++) {
+    EXPECT_TRUE(sampler.ShouldSampleAllocation(100 * kSamplingInterval));
+  }
+}
+
+TEST_F(AllocationSamplerTest, SmallAllocationsAreMostlySkipped) {
+  AllocationSampler sampler;
+  size_t sample_count = 0;
+  for (size_t i = 0; i < 1000; i++) {
+    if (sampler.ShouldSampleAllocation(8))
+      sample_count++;
+  }
+  // 8000 bytes are about two sampling intervals.
+  EXPECT_LT(sample_count, 20u);
+}
+
+TEST(SampledAddressSetTest, AddAndRemove) {
+  SampledAddressSet addresses;
+  int objects[3];
+
+  EXPECT_FALSE(addresses.MayContain(&objects[0]));
+  addresses.Add(&objects[0]);
+  addresses.Add(&objects[1]);
+  EXPECT_TRUE(addresses.MayContain(&objects[0]));
+  EXPECT_TRUE(addresses.MayContain(&objects[1]));
+
+  addresses.Remove(&objects[0]);
+  EXPECT_TRUE(addresses.MayContain(&objects[1]));
+
+  // |objects[0]| and |objects[1]| are adjacent, so they do not collide.
+  EXPECT_FALSE(addresses.MayContain(&objects[0]));
+  addresses.Remove(&objects[1]);
+  EXPECT_FALSE(addresses.MayContain(&objects[1]));
+  EXPECT_FALSE(addresses.MayContain(&objects[2]));
+}
+
+TEST(SampledAddressSetTest, Clear) {
+  SampledAddressSet addresses;
+  int objects[2];
+
+  addresses.Add(&objects[0]);
+  addresses.Add(&objects[0]);
+  addresses.Add(&objects[1]);
+  addresses.Clear();
+  EXPECT_FALSE(addresses.MayContain(&objects[0]));
+  EXPECT_FALSE(addresses.MayContain(&objects[1]));
+}
+
+}  // namespace trace_event
+}  // namespace base
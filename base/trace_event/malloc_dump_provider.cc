@@ -12,6 +12,7 @@
 #include "base/trace_event/heap_profiler_allocation_context.h"
 #include "base/trace_event/heap_profiler_allocation_context_tracker.h"
 #include "base/trace_event/heap_profiler_allocation_register.h"
+#include "base/trace_event/heap_profiler_allocation_sampler.h"
 #include "base/trace_event/heap_profiler_heap_dump_writer.h"
 #include "base/trace_event/process_memory_dump.h"
 #include "base/trace_event/trace_event_argument.h"
@@ -95,7 +96,9 @@ MallocDumpProvider* MallocDumpProvider::GetInstance() {
 }
 
 MallocDumpProvider::MallocDumpProvider()
-    : heap_profiler_enabled_(false), tid_dumping_heap_(kInvalidThreadId) {}
+    : heap_profiler_enabled_(false),
+      sampling_interval_(0),
+      tid_dumping_heap_(kInvalidThreadId) {}
 
 MallocDumpProvider::~MallocDumpProvider() {}
 
@@ -185,8 +188,17 @@ bool MallocDumpProvider::OnMemoryDump(const MemoryDumpArgs& args,
         if (args.level_of_detail == MemoryDumpLevelOfDetail::DETAILED) {
           for (const auto& alloc_size : *allocation_register_) {
             AllocationMetrics& metrics = metrics_by_context[alloc_size.context];
-            metrics.size += alloc_size.size;
-            metrics.count++;
+            if (!sampling_interval_) {
+              metrics.size += alloc_size.size;
+              metrics.count++;
+              continue;
+            }
+            // Each sampled allocation stands for the 1 / probability
+            // allocations of its size that it was sampled from on average.
+            double scale = 1 / AllocationSampler::GetSamplingProbability(
+                                   alloc_size.size, sampling_interval_);
+            metrics.size += static_cast<size_t>(alloc_size.size * scale + 0.5);
+            metrics.count += static_cast<size_t>(scale + 0.5);
           }
         }
         allocation_register_->EstimateTraceMemoryOverhead(&overhead);
@@ -202,9 +214,16 @@ bool MallocDumpProvider::OnMemoryDump(const MemoryDumpArgs& args,
 void MallocDumpProvider::OnHeapProfilingEnabled(bool enabled) {
 #if BUILDFLAG(USE_EXPERIMENTAL_ALLOCATOR_SHIM)
   if (enabled) {
+    sampling_interval_ = AllocationSampler::sampling_interval();
     {
       AutoLock lock(allocation_register_lock_);
       allocation_register_.reset(new AllocationRegister());
+      // The allocator hooks may still read a set created by a previous
+      // session, so it is cleared rather than replaced.
+      if (sampled_addresses_)
+        sampled_addresses_->Clear();
+      else if (sampling_interval_)
+        sampled_addresses_.reset(new SampledAddressSet());
     }
     allocator::InsertAllocatorDispatch(&g_allocator_hooks);
   } else {
@@ -232,6 +251,11 @@ void MallocDumpProvider::InsertAllocation(void* address, size_t size) {
   auto* tracker = AllocationContextTracker::GetInstanceForCurrentThread();
   if (!tracker)
     return;
+
+  // When sampling, the context (possibly a native stack) is only captured for
+  // the sampled allocations.
+  if (sampled_addresses_ && !tracker->sampler()->ShouldSampleAllocation(size))
+    return;
   AllocationContext context = tracker->GetContextSnapshot();
 
   AutoLock lock(allocation_register_lock_);
@@ -239,9 +263,17 @@ void MallocDumpProvider::InsertAllocation(void* address, size_t size) {
     return;
 
   allocation_register_->Insert(address, size, context);
+  // The register ignores empty allocations.
+  if (sampled_addresses_ && size)
+    sampled_addresses_->Add(address);
 }
 
 void MallocDumpProvider::RemoveAllocation(void* address) {
+  // Most freed allocations were not sampled, and are skipped without taking
+  // the lock.
+  if (sampled_addresses_ && !sampled_addresses_->MayContain(address))
+    return;
+
   // No re-entrancy is expected here as none of the calls below should
   // cause a free()-s (|allocation_register_| does its own heap management).
   if (tid_dumping_heap_ != kInvalidThreadId &&
@@ -250,6 +282,11 @@ void MallocDumpProvider::RemoveAllocation(void* address) {
   AutoLock lock(allocation_register_lock_);
   if (!allocation_register_)
     return;
+  if (sampled_addresses_) {
+    if (!allocation_register_->Get(address, nullptr))
+      return;
+    sampled_addresses_->Remove(address);
+  }
   allocation_register_->Remove(address);
 }
 
@@ -24,6 +24,7 @@ namespace base {
 namespace trace_event {
 
 class AllocationRegister;
+class SampledAddressSet;
 
 // Dump provider which collects process-wide memory stats.
 class BASE_EXPORT MallocDumpProvider : public MemoryDumpProvider {
@@ -55,6 +56,12 @@ class BASE_EXPORT MallocDumpProvider : public MemoryDumpProvider {
   std::unique_ptr<AllocationRegister> allocation_register_;
   Lock allocation_register_lock_;
 
+  // When sampling allocations, the mean number of bytes between samples and
+  // the addresses of the sampled allocations in |allocation_register_|. The
+  // set is read without the lock, so it is never deleted once created.
+  size_t sampling_interval_;
+  std::unique_ptr<SampledAddressSet> sampled_addresses_;
+
   // When in OnMemoryDump(), this contains the current thread ID.
   // This is to prevent re-entrancy in the heap profiler when the heap dump
   // generation is malloc/new-ing for its own bookeeping data structures.
@@ -14,10 +14,12 @@
 #include "base/debug/debugging_flags.h"
 #include "base/debug/stack_trace.h"
 #include "base/memory/ptr_util.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/threading/thread.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/trace_event/heap_profiler.h"
 #include "base/trace_event/heap_profiler_allocation_context_tracker.h"
+#include "base/trace_event/heap_profiler_allocation_sampler.h"
 #include "base/trace_event/heap_profiler_stack_frame_deduplicator.h"
 #include "base/trace_event/heap_profiler_type_name_deduplicator.h"
 #include "base/trace_event/malloc_dump_provider.h"
@@ -174,6 +176,26 @@ void MemoryDumpManager::EnableHeapProfilingIfNeeded() {
     CHECK(false) << "'" << profiling_mode << "' mode for "
                  << switches::kEnableHeapProfiling << " flag is not supported "
                  << "for this platform / build type.";
+#endif
+  } else if (profiling_mode == switches::kEnableHeapProfilingModeSampled) {
+    size_t sampling_interval = AllocationSampler::kDefaultSamplingInterval;
+    if (CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kHeapProfilingSamplingInterval)) {
+      std::string interval = CommandLine::ForCurrentProcess()
+          ->GetSwitchValueASCII(switches::kHeapProfilingSamplingInterval);
+      CHECK(StringToSizeT(interval, &sampling_interval) && sampling_interval)
+          << "Invalid value '" << interval << "' for "
+          << switches::kHeapProfilingSamplingInterval << " flag.";
+    }
+    AllocationSampler::SetSamplingInterval(sampling_interval);
+#if HAVE_TRACE_STACK_FRAME_POINTERS && \
+    (BUILDFLAG(ENABLE_PROFILING) || !defined(NDEBUG))
+    AllocationContextTracker::SetCaptureMode(
+        AllocationContextTracker::CaptureMode::NATIVE_STACK);
+#else
+    // Without frame pointers, sample pseudo stacks instead.
+    AllocationContextTracker::SetCaptureMode(
+        AllocationContextTracker::CaptureMode::PSEUDO_STACK);
 #endif
   } else {
     CHECK(false) << "Invalid mode '" << profiling_mode << "' for "
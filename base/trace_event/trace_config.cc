@@ -33,12 +33,14 @@ const char kTraceToConsole[] = "trace-to-console";
 const char kEnableSampling[] = "enable-sampling";
 const char kEnableSystrace[] = "enable-systrace";
 const char kEnableArgumentFilter[] = "enable-argument-filter";
+const char kEnableCompactBuffer[] = "enable-compact-buffer";
 
 // String parameters that can be used to parse the trace config string.
 const char kRecordModeParam[] = "record_mode";
 const char kEnableSamplingParam[] = "enable_sampling";
 const char kEnableSystraceParam[] = "enable_systrace";
 const char kEnableArgumentFilterParam[] = "enable_argument_filter";
+const char kEnableCompactBufferParam[] = "enable_compact_buffer";
 const char kIncludedCategoriesParam[] = "included_categories";
 const char kExcludedCategoriesParam[] = "excluded_categories";
 const char kSyntheticDelaysParam[] = "synthetic_delays";
@@ -162,6 +164,7 @@ TraceConfig::TraceConfig(const TraceConfig& tc)
       enable_sampling_(tc.enable_sampling_),
       enable_systrace_(tc.enable_systrace_),
       enable_argument_filter_(tc.enable_argument_filter_),
+      enable_compact_buffer_(tc.enable_compact_buffer_),
       memory_dump_config_(tc.memory_dump_config_),
       included_categories_(tc.included_categories_),
       disabled_categories_(tc.disabled_categories_),
@@ -179,6 +182,7 @@ TraceConfig& TraceConfig::operator=(const TraceConfig& rhs) {
   enable_sampling_ = rhs.enable_sampling_;
   enable_systrace_ = rhs.enable_systrace_;
   enable_argument_filter_ = rhs.enable_argument_filter_;
+  enable_compact_buffer_ = rhs.enable_compact_buffer_;
   memory_dump_config_ = rhs.memory_dump_config_;
   included_categories_ = rhs.included_categories_;
   disabled_categories_ = rhs.disabled_categories_;
@@ -273,7 +277,8 @@ void TraceConfig::Merge(const TraceConfig& config) {
   if (record_mode_ != config.record_mode_
       || enable_sampling_ != config.enable_sampling_
       || enable_systrace_ != config.enable_systrace_
-      || enable_argument_filter_ != config.enable_argument_filter_) {
+      || enable_argument_filter_ != config.enable_argument_filter_
+      || enable_compact_buffer_ != config.enable_compact_buffer_) {
     DLOG(ERROR) << "Attempting to merge trace config with a different "
                 << "set of options.";
   }
@@ -309,6 +314,7 @@ void TraceConfig::Clear() {
   enable_sampling_ = false;
   enable_systrace_ = false;
   enable_argument_filter_ = false;
+  enable_compact_buffer_ = false;
   included_categories_.clear();
   disabled_categories_.clear();
   excluded_categories_.clear();
@@ -321,6 +327,7 @@ void TraceConfig::InitializeDefault() {
   enable_sampling_ = false;
   enable_systrace_ = false;
   enable_argument_filter_ = false;
+  enable_compact_buffer_ = false;
 }
 
 void TraceConfig::InitializeFromConfigDict(const DictionaryValue& dict) {
@@ -343,6 +350,8 @@ void TraceConfig::InitializeFromConfigDict(const DictionaryValue& dict) {
   enable_systrace_ = dict.GetBoolean(kEnableSystraceParam, &val) ? val : false;
   enable_argument_filter_ =
       dict.GetBoolean(kEnableArgumentFilterParam, &val) ? val : false;
+  enable_compact_buffer_ =
+      dict.GetBoolean(kEnableCompactBufferParam, &val) ? val : false;
 
   const ListValue* category_list = nullptr;
   if (dict.GetList(kIncludedCategoriesParam, &category_list))
@@ -409,6 +418,7 @@ void TraceConfig::InitializeFromStrings(StringPiece category_filter_string,
   enable_sampling_ = false;
   enable_systrace_ = false;
   enable_argument_filter_ = false;
+  enable_compact_buffer_ = false;
   if (!trace_options_string.empty()) {
     std::vector<std::string> split =
         SplitString(trace_options_string, ",", TRIM_WHITESPACE, SPLIT_WANT_ALL);
@@ -427,6 +437,8 @@ void TraceConfig::InitializeFromStrings(StringPiece category_filter_string,
         enable_systrace_ = true;
       } else if (token == kEnableArgumentFilter) {
         enable_argument_filter_ = true;
+      } else if (token == kEnableCompactBuffer) {
+        enable_compact_buffer_ = true;
       }
     }
   }
@@ -577,6 +589,10 @@ std::unique_ptr<DictionaryValue> TraceConfig::ToDict() const {
   dict->SetBoolean(kEnableSamplingParam, enable_sampling_);
   dict->SetBoolean(kEnableSystraceParam, enable_systrace_);
   dict->SetBoolean(kEnableArgumentFilterParam, enable_argument_filter_);
+  // Only written when set, so that the serialization of configs that do not
+  // use the compact buffer stays the same.
+  if (enable_compact_buffer_)
+    dict->SetBoolean(kEnableCompactBufferParam, true);
 
   StringList categories(included_categories_);
   categories.insert(categories.end(),
@@ -645,6 +661,8 @@ std::string TraceConfig::ToTraceOptionsString() const {
     ret = ret + "," + kEnableSystrace;
   if (enable_argument_filter_)
     ret = ret + "," + kEnableArgumentFilter;
+  if (enable_compact_buffer_)
+    ret = ret + "," + kEnableCompactBuffer;
   return ret;
 }
 
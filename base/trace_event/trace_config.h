@@ -94,7 +94,7 @@ class BASE_EXPORT TraceConfig {
   // |trace_options_string| is a comma-delimited list of trace options.
   // Possible options are: "record-until-full", "record-continuously",
   // "record-as-much-as-possible", "trace-to-console", "enable-sampling",
-  // "enable-systrace" and "enable-argument-filter".
+  // "enable-systrace", "enable-argument-filter" and "enable-compact-buffer".
   // The first 4 options are trace recoding modes and hence
   // mutually exclusive. If more than one trace recording modes appear in the
   // options_string, the last one takes precedence. If none of the trace
@@ -102,9 +102,10 @@ class BASE_EXPORT TraceConfig {
   //
   // The trace option will first be reset to the default option
   // (record_mode set to RECORD_UNTIL_FULL, enable_sampling, enable_systrace,
-  // and enable_argument_filter set to false) before options parsed from
-  // |trace_options_string| are applied on it. If |trace_options_string| is
-  // invalid, the final state of trace options is undefined.
+  // enable_argument_filter and enable_compact_buffer set to false) before
+  // options parsed from |trace_options_string| are applied on it. If
+  // |trace_options_string| is invalid, the final state of trace options is
+  // undefined.
   //
   // Example: TraceConfig("test_MyTest*", "record-until-full");
   // Example: TraceConfig("test_MyTest*,test_OtherStuff",
@@ -141,6 +142,7 @@ class BASE_EXPORT TraceConfig {
   //     "enable_sampling": true,
   //     "enable_systrace": true,
   //     "enable_argument_filter": true,
+  //     "enable_compact_buffer": true,
   //     "included_categories": ["included",
   //                             "inc_pattern*",
   //                             "disabled-by-default-memory-infra"],
@@ -177,11 +179,13 @@ class BASE_EXPORT TraceConfig {
   bool IsSamplingEnabled() const { return enable_sampling_; }
   bool IsSystraceEnabled() const { return enable_systrace_; }
   bool IsArgumentFilterEnabled() const { return enable_argument_filter_; }
+  bool IsCompactBufferEnabled() const { return enable_compact_buffer_; }
 
   void SetTraceRecordMode(TraceRecordMode mode) { record_mode_ = mode; }
   void EnableSampling() { enable_sampling_ = true; }
   void EnableSystrace() { enable_systrace_ = true; }
   void EnableArgumentFilter() { enable_argument_filter_ = true; }
+  void EnableCompactBuffer() { enable_compact_buffer_ = true; }
 
   // Writes the string representation of the TraceConfig. The string is JSON
   // formatted.
@@ -274,6 +278,7 @@ class BASE_EXPORT TraceConfig {
   bool enable_sampling_ : 1;
   bool enable_systrace_ : 1;
   bool enable_argument_filter_ : 1;
+  bool enable_compact_buffer_ : 1;
 
   MemoryDumpConfig memory_dump_config_;
 
@@ -123,6 +123,13 @@ TEST(TraceConfigTest, TraceConfigFromValidLegacyFormat) {
   EXPECT_STREQ("record-as-much-as-possible,enable-argument-filter",
                config.ToTraceOptionsString().c_str());
 
+  config = TraceConfig("", "enable-compact-buffer,record-continuously");
+  EXPECT_EQ(RECORD_CONTINUOUSLY, config.GetTraceRecordMode());
+  EXPECT_FALSE(config.IsArgumentFilterEnabled());
+  EXPECT_TRUE(config.IsCompactBufferEnabled());
+  EXPECT_STREQ("record-continuously,enable-compact-buffer",
+               config.ToTraceOptionsString().c_str());
+
   config = TraceConfig(
     "",
     "enable-systrace,trace-to-console,enable-sampling,enable-argument-filter");
@@ -384,6 +391,29 @@ TEST(TraceConfigTest, TraceConfigFromDict) {
                custom_tc.ToCategoryFilterString().c_str());
 }
 
+TEST(TraceConfigTest, TraceConfigCompactBuffer) {
+  const char config_string[] =
+    "{"
+      "\"enable_argument_filter\":false,"
+      "\"enable_compact_buffer\":true,"
+      "\"enable_sampling\":false,"
+      "\"enable_systrace\":false,"
+      "\"record_mode\":\"record-until-full\""
+    "}";
+  TraceConfig tc(config_string);
+  EXPECT_TRUE(tc.IsCompactBufferEnabled());
+  EXPECT_STREQ(config_string, tc.ToString().c_str());
+
+  // The option is only written out when it is set.
+  TraceConfig default_tc;
+  EXPECT_FALSE(default_tc.IsCompactBufferEnabled());
+  EXPECT_EQ(std::string::npos,
+            default_tc.ToString().find("enable_compact_buffer"));
+
+  tc.Clear();
+  EXPECT_FALSE(tc.IsCompactBufferEnabled());
+}
+
 TEST(TraceConfigTest, TraceConfigFromValidString) {
   // Using some non-empty config string.
   const char config_string[] =
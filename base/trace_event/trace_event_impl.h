@@ -134,8 +134,18 @@ class BASE_EXPORT TraceEvent {
   TimeDelta thread_duration() const { return thread_duration_; }
   const char* scope() const { return scope_; }
   unsigned long long id() const { return id_; }
+  unsigned long long bind_id() const { return bind_id_; }
   unsigned int flags() const { return flags_; }
 
+  // Arguments, for |index| < kTraceMaxNumArgs. Unused arguments have a null
+  // name.
+  const char* arg_name(int index) const { return arg_names_[index]; }
+  unsigned char arg_type(int index) const { return arg_types_[index]; }
+  TraceValue arg_value(int index) const { return arg_values_[index]; }
+  const ConvertableToTraceFormat* arg_convertable_value(int index) const {
+    return convertable_values_[index].get();
+  }
+
   // Exposed for unittesting:
 
   const std::string* parameter_copy_storage() const {
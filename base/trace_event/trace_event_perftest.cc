@@ -0,0 +1,196 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "base/trace_event/compact_trace_buffer.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+const size_t kEventCount = 200 * 1000;
+
+void AppendOutput(size_t* total_size,
+                  const scoped_refptr<RefCountedString>& json,
+                  bool has_more_events) {
+  *total_size += json->data().size();
+}
+
+// Records kEventCount events, then flushes them to JSON, with the given trace
+// options. The events are a mix of scoped events, instant events with copied
+// strings and counters, like in a typical trace.
+void RunTracePerfTest(const char* trace, const char* trace_options) {
+  TraceLog* trace_log = TraceLog::GetInstance();
+  trace_log->SetEnabled(TraceConfig("perftest", trace_options),
+                        TraceLog::RECORDING_MODE);
+
+  const std::string copied_name = "copied name";
+  TimeTicks start = TimeTicks::Now();
+  for (size_t i = 0; i < kEventCount / 4; ++i) {
+    {
+      TRACE_EVENT1("perftest", "ScopedEvent", "index", i);
+      TRACE_EVENT_INSTANT2("perftest", "InstantEvent",
+                           TRACE_EVENT_SCOPE_THREAD, "a", 1, "b", "static");
+    }
+    TRACE_EVENT_COPY_INSTANT1("perftest", copied_name.c_str(),
+                              TRACE_EVENT_SCOPE_THREAD, "name",
+                              copied_name);
+    TRACE_COUNTER1("perftest", "Counter", i);
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  perf_test::PrintResult("record", "", trace,
+                         elapsed.InMicroseconds() * 1000.0 / kEventCount,
+                         "ns/event", true);
+
+  trace_log->SetDisabled();
+
+  size_t json_size = 0;
+  start = TimeTicks::Now();
+  trace_log->Flush(Bind(&AppendOutput, Unretained(&json_size)));
+  elapsed = TimeTicks::Now() - start;
+  EXPECT_GT(json_size, 0u);
+  perf_test::PrintResult("flush", "", trace,
+                         elapsed.InMicroseconds() * 1000.0 / kEventCount,
+                         "ns/event", true);
+}
+
+// Fills |buffer| with chunks of typical events and returns the number of
+// events added.
+size_t FillTraceBuffer(TraceBuffer* buffer) {
+  const unsigned char* category = TraceLog::GetCategoryGroupEnabled("perftest");
+  const char* arg_names[] = {"index", "name"};
+  const unsigned char arg_types[] = {TRACE_VALUE_TYPE_UINT,
+                                     TRACE_VALUE_TYPE_STRING};
+  size_t event_count = 0;
+  while (!buffer->IsFull() && event_count < kEventCount) {
+    size_t chunk_index;
+    std::unique_ptr<TraceBufferChunk> chunk = buffer->GetChunk(&chunk_index);
+    while (!chunk->IsFull()) {
+      const unsigned long long arg_values[] = {
+          event_count, reinterpret_cast<uintptr_t>("static")};
+      size_t event_index;
+      chunk->AddTraceEvent(&event_index)
+          ->Initialize(1, TimeTicks::Now(), ThreadTicks(),
+                       TRACE_EVENT_PHASE_INSTANT, category, "Event", nullptr,
+                       0, 0, 2, arg_names, arg_types, arg_values, nullptr,
+                       TRACE_EVENT_FLAG_NONE);
+      ++event_count;
+    }
+    buffer->ReturnChunk(chunk_index, std::move(chunk));
+  }
+  return event_count;
+}
+
+// Adds scoped events on a thread without a message loop, so that every event
+// goes through the per-thread buffer of the thread.
+class TracingThread : public DelegateSimpleThread::Delegate {
+ public:
+  TracingThread() {}
+
+  void Run() override {
+    for (size_t i = 0; i < kEventCount; ++i) {
+      TRACE_EVENT1("perftest", "ThreadEvent", "index", i);
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TracingThread);
+};
+
+// Returns the time it takes |thread_count| threads to each add kEventCount
+// events, in nanoseconds of wall time per event of a single thread.
+double RunTracingThreads(int thread_count) {
+  TracingThread delegate;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    threads.push_back(WrapUnique(new DelegateSimpleThread(
+        &delegate, StringPrintf("TracingThread%d", i))));
+  }
+  TimeTicks start = TimeTicks::Now();
+  for (const auto& thread : threads)
+    thread->Start();
+  for (const auto& thread : threads)
+    thread->Join();
+  return (TimeTicks::Now() - start).InMicroseconds() * 1000.0 / kEventCount;
+}
+
+void RunMultiThreadedPerfTest(int thread_count) {
+  const std::string trace = StringPrintf("%d_threads", thread_count);
+  const double disabled = RunTracingThreads(thread_count);
+
+  TraceLog* trace_log = TraceLog::GetInstance();
+  trace_log->SetEnabled(TraceConfig("perftest", "record-continuously"),
+                        TraceLog::RECORDING_MODE);
+  const double enabled = RunTracingThreads(thread_count);
+  trace_log->SetDisabled();
+  size_t json_size = 0;
+  trace_log->Flush(Bind(&AppendOutput, Unretained(&json_size)));
+  EXPECT_GT(json_size, 0u);
+
+  perf_test::PrintResult("record_disabled", "", trace, disabled, "ns/event",
+                         true);
+  perf_test::PrintResult("record_enabled", "", trace, enabled, "ns/event",
+                         true);
+  perf_test::PrintResult("record_overhead", "", trace, enabled - disabled,
+                         "ns/event", true);
+}
+
+}  // namespace
+
+TEST(TraceEventPerfTest, Record) {
+  RunTracePerfTest("default", "record-as-much-as-possible");
+}
+
+TEST(TraceEventPerfTest, RecordCompactBuffer) {
+  RunTracePerfTest("compact",
+                   "record-as-much-as-possible,enable-compact-buffer");
+}
+
+// Measures the overhead of tracing on threads without a message loop, which
+// add their events concurrently to their own chunks.
+TEST(TraceEventPerfTest, RecordMultiThreaded) {
+  RunMultiThreadedPerfTest(1);
+  RunMultiThreadedPerfTest(4);
+  RunMultiThreadedPerfTest(SysInfo::NumberOfProcessors());
+}
+
+// Compares the memory taken by each stored event. Events in the default
+// buffers are TraceEvent objects of a fixed size.
+TEST(TraceEventPerfTest, BytesPerEvent) {
+  TraceLog::GetInstance()->SetEnabled(TraceConfig("perftest", ""),
+                                      TraceLog::RECORDING_MODE);
+  CompactTraceBuffer buffer(1024 * 1024 * 1024,
+                            CompactTraceBuffer::RECORD_UNTIL_FULL);
+  const size_t event_count = FillTraceBuffer(&buffer);
+  TraceLog::GetInstance()->SetDisabled();
+  EXPECT_EQ(event_count, buffer.Size());
+
+  perf_test::PrintResult("bytes_per_event", "", "default",
+                         sizeof(TraceEvent), "bytes", true);
+  perf_test::PrintResult(
+      "bytes_per_event", "", "compact",
+      static_cast<double>(buffer.encoded_size()) / event_count, "bytes", true);
+}
+
+}  // namespace trace_event
+}  // namespace base
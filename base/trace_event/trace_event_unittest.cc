@@ -11,6 +11,7 @@
 #include <cstdlib>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/command_line.h"
@@ -18,6 +19,7 @@
 #include "base/json/json_writer.h"
 #include "base/location.h"
 #include "base/macros.h"
+#include "base/memory/ptr_util.h"
 #include "base/memory/ref_counted_memory.h"
 #include "base/memory/singleton.h"
 #include "base/process/process_handle.h"
@@ -27,8 +29,10 @@
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
 #include "base/threading/thread.h"
 #include "base/time/time.h"
+#include "base/trace_event/compact_trace_buffer.h"
 #include "base/trace_event/trace_buffer.h"
 #include "base/trace_event/trace_event_synthetic_delay.h"
 #include "base/values.h"
@@ -1726,6 +1730,127 @@ TEST_F(TraceEventTestFixture, DataCapturedManyThreads) {
   }
 }
 
+namespace {
+
+// Adds |num_events| instant events on a thread without a message loop. If
+// |keep_tracing| is given, signals |events_added| and keeps adding events
+// until |keep_tracing| is cleared.
+class InstantEventsDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  InstantEventsDelegate(int thread_id,
+                        int num_events,
+                        WaitableEvent* events_added,
+                        subtle::Atomic32* keep_tracing)
+      : thread_id_(thread_id),
+        num_events_(num_events),
+        events_added_(events_added),
+        keep_tracing_(keep_tracing) {}
+
+  void Run() override {
+    TraceManyInstantEvents(thread_id_, num_events_, events_added_);
+    if (!keep_tracing_)
+      return;
+    for (int i = num_events_; subtle::Acquire_Load(keep_tracing_); ++i) {
+      TRACE_EVENT_INSTANT2("all", "multi thread event",
+                           TRACE_EVENT_SCOPE_THREAD,
+                           "thread", thread_id_,
+                           "event", i);
+    }
+  }
+
+ private:
+  const int thread_id_;
+  const int num_events_;
+  WaitableEvent* events_added_;
+  subtle::Atomic32* keep_tracing_;
+
+  DISALLOW_COPY_AND_ASSIGN(InstantEventsDelegate);
+};
+
+}  // namespace
+
+// Test that data from threads without a message loop is gathered, both from
+// threads which ended before the flush and from threads which are still alive.
+TEST_F(TraceEventTestFixture, DataCapturedOnThreadsWithoutMessageLoop) {
+  BeginTrace();
+
+  const int num_threads = 4;
+  const int num_events = 4000;
+  std::vector<std::unique_ptr<InstantEventsDelegate>> delegates;
+  std::vector<std::unique_ptr<DelegateSimpleThread>> threads;
+  std::vector<std::unique_ptr<WaitableEvent>> events_added;
+  subtle::Atomic32 keep_tracing = 1;
+  for (int i = 0; i < num_threads; i++) {
+    // Let half of the threads end before flush.
+    bool ends_before_flush = i < num_threads / 2;
+    if (!ends_before_flush) {
+      events_added.push_back(WrapUnique(
+          new WaitableEvent(WaitableEvent::ResetPolicy::MANUAL,
+                            WaitableEvent::InitialState::NOT_SIGNALED)));
+    }
+    delegates.push_back(WrapUnique(new InstantEventsDelegate(
+        i, num_events,
+        ends_before_flush ? nullptr : events_added.back().get(),
+        ends_before_flush ? nullptr : &keep_tracing)));
+    threads.push_back(WrapUnique(new DelegateSimpleThread(
+        delegates.back().get(), StringPrintf("Thread %d", i))));
+    threads.back()->Start();
+  }
+
+  for (int i = 0; i < num_threads / 2; i++)
+    threads[i]->Join();
+  for (const auto& event : events_added)
+    event->Wait();
+
+  // The other half of the threads keep adding events during the flush.
+  EndTraceAndFlush();
+  subtle::Release_Store(&keep_tracing, 0);
+  for (int i = num_threads / 2; i < num_threads; i++)
+    threads[i]->Join();
+
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_,
+                                           num_threads, num_events);
+}
+
+namespace {
+
+// Adds a scoped event around enough instant events that the chunk of the
+// scoped event is handed back to the trace buffer before the scope ends.
+class LongScopeDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  LongScopeDelegate() {}
+
+  void Run() override {
+    TRACE_EVENT0("all", "long scope");
+    TraceManyInstantEvents(0, 10 * TraceBufferChunk::kTraceBufferChunkSize,
+                           nullptr);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LongScopeDelegate);
+};
+
+}  // namespace
+
+// Test that the duration of a complete event is recorded on a thread without
+// a message loop after the chunk of the event left the thread.
+TEST_F(TraceEventTestFixture, CompleteEventDurationOnThreadWithoutMessageLoop) {
+  BeginTrace();
+
+  LongScopeDelegate delegate;
+  DelegateSimpleThread thread(&delegate, "long scope");
+  thread.Start();
+  thread.Join();
+
+  EndTraceAndFlush();
+
+  DictionaryValue* item = FindNamePhase("long scope", "X");
+  ASSERT_TRUE(item);
+  double duration;
+  EXPECT_TRUE(item->GetDouble("dur", &duration));
+  EXPECT_GE(duration, 0);
+}
+
 // Test that thread and process names show up in the trace
 TEST_F(TraceEventTestFixture, ThreadNames) {
   // Create threads before we enable tracing to make sure
@@ -2922,6 +3047,188 @@ TEST_F(TraceEventTestFixture, TraceRecordAsMuchAsPossibleMode) {
   TraceLog::GetInstance()->SetDisabled();
 }
 
+TEST_F(TraceEventTestFixture, DataCapturedCompactBuffer) {
+  TraceLog::GetInstance()->SetEnabled(
+      TraceConfig(kRecordAllCategoryFilter, "enable-compact-buffer"),
+      TraceLog::RECORDING_MODE);
+
+  TraceWithAllMacroVariants(NULL);
+
+  EndTraceAndFlush();
+
+  ValidateAllTraceMacrosCreatedData(trace_parsed_);
+}
+
+// Adds an event to |chunk| with the given fields and returns its JSON.
+std::string AddEventToChunk(TraceBufferChunk* chunk,
+                            char phase,
+                            const char* name,
+                            const char* scope,
+                            unsigned long long id,
+                            unsigned long long bind_id,
+                            int num_args,
+                            const char** arg_names,
+                            const unsigned char* arg_types,
+                            const unsigned long long* arg_values,
+                            unsigned int flags) {
+  static int64_t now = 1000;
+  now += 7;
+  std::unique_ptr<ConvertableToTraceFormat> convertable_values[2];
+  for (int i = 0; i < num_args; ++i) {
+    if (arg_types[i] == TRACE_VALUE_TYPE_CONVERTABLE)
+      convertable_values[i].reset(new MyData);
+  }
+  size_t event_index;
+  TraceEvent* event = chunk->AddTraceEvent(&event_index);
+  event->Initialize(42, TimeTicks::FromInternalValue(now),
+                    ThreadTicks::FromInternalValue(now), phase,
+                    TraceLog::GetCategoryGroupEnabled("cat"), name, scope, id,
+                    bind_id, num_args, arg_names, arg_types, arg_values,
+                    convertable_values, flags);
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    event->UpdateDuration(TimeTicks::FromInternalValue(now + 100),
+                          ThreadTicks::FromInternalValue(now + 50));
+  }
+  std::string json;
+  event->AppendAsJSON(&json, ArgumentFilterPredicate());
+  return json;
+}
+
+TEST_F(TraceEventTestFixture, CompactTraceBufferRoundTrip) {
+  BeginTrace();
+  CompactTraceBuffer buffer(1024 * 1024, CompactTraceBuffer::RECORD_UNTIL_FULL);
+  size_t chunk_index;
+  std::unique_ptr<TraceBufferChunk> chunk = buffer.GetChunk(&chunk_index);
+  std::vector<std::string> expected;
+
+  const char* names[] = {"a", "b"};
+  const double kDouble = -12.5;
+  TraceEvent::TraceValue double_value;
+  double_value.as_double = kDouble;
+  const struct {
+    unsigned char types[2];
+    unsigned long long values[2];
+  } kArgs[] = {
+      {{TRACE_VALUE_TYPE_BOOL, TRACE_VALUE_TYPE_UINT}, {1, 1ull << 40}},
+      {{TRACE_VALUE_TYPE_INT, TRACE_VALUE_TYPE_DOUBLE},
+       {static_cast<unsigned long long>(-3), double_value.as_uint}},
+      {{TRACE_VALUE_TYPE_POINTER, TRACE_VALUE_TYPE_STRING},
+       {0x1234, reinterpret_cast<uintptr_t>("static \"string\"")}},
+      {{TRACE_VALUE_TYPE_COPY_STRING, TRACE_VALUE_TYPE_CONVERTABLE},
+       {reinterpret_cast<uintptr_t>("copied"), 0}},
+  };
+  for (const auto& args : kArgs) {
+    for (unsigned int flags : {TRACE_EVENT_FLAG_NONE, TRACE_EVENT_FLAG_COPY}) {
+      expected.push_back(AddEventToChunk(
+          chunk.get(), TRACE_EVENT_PHASE_INSTANT, "instant", nullptr, 0, 0, 2,
+          names, args.types, args.values, flags | TRACE_EVENT_SCOPE_THREAD));
+    }
+  }
+  expected.push_back(AddEventToChunk(
+      chunk.get(), TRACE_EVENT_PHASE_COMPLETE, "complete", nullptr, 0, 0, 0,
+      nullptr, nullptr, nullptr, TRACE_EVENT_FLAG_NONE));
+  expected.push_back(AddEventToChunk(
+      chunk.get(), TRACE_EVENT_PHASE_ASYNC_BEGIN, "async", "scope", 0xABCDEF,
+      0, 0, nullptr, nullptr, nullptr, TRACE_EVENT_FLAG_HAS_ID));
+  expected.push_back(AddEventToChunk(
+      chunk.get(), TRACE_EVENT_PHASE_COMPLETE, "flow", nullptr, 0, 77, 0,
+      nullptr, nullptr, nullptr,
+      TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT));
+  buffer.ReturnChunk(chunk_index, std::move(chunk));
+  EXPECT_EQ(expected.size(), buffer.Size());
+  EXPECT_GT(buffer.encoded_size(), 0u);
+
+  std::vector<std::string> actual;
+  while (const TraceBufferChunk* decoded = buffer.NextChunk()) {
+    for (size_t i = 0; i < decoded->size(); ++i) {
+      std::string json;
+      decoded->GetEventAt(i)->AppendAsJSON(&json, ArgumentFilterPredicate());
+      actual.push_back(json);
+    }
+  }
+  EXPECT_EQ(expected, actual);
+  EndTraceAndFlush();
+}
+
+TEST_F(TraceEventTestFixture, CompactTraceBufferKeepsUnfinishedEvents) {
+  BeginTrace();
+  CompactTraceBuffer buffer(1024 * 1024, CompactTraceBuffer::RECORD_UNTIL_FULL);
+  size_t chunk_index;
+  std::unique_ptr<TraceBufferChunk> chunk = buffer.GetChunk(&chunk_index);
+  size_t event_index;
+  TraceEvent* event = chunk->AddTraceEvent(&event_index);
+  event->Initialize(1, TimeTicks::FromInternalValue(10), ThreadTicks(),
+                    TRACE_EVENT_PHASE_COMPLETE,
+                    TraceLog::GetCategoryGroupEnabled("cat"), "long", nullptr,
+                    0, 0, 0, nullptr, nullptr, nullptr, nullptr,
+                    TRACE_EVENT_FLAG_NONE);
+  TraceEventHandle handle = {chunk->seq(), static_cast<unsigned>(chunk_index),
+                             static_cast<unsigned>(event_index)};
+  buffer.ReturnChunk(chunk_index, std::move(chunk));
+
+  // The event has not ended, so its chunk is still reachable.
+  event = buffer.GetEventByHandle(handle);
+  ASSERT_TRUE(event);
+  EXPECT_EQ(0u, buffer.encoded_size());
+  event->UpdateDuration(TimeTicks::FromInternalValue(30), ThreadTicks());
+
+  // Returning another chunk encodes the finished one.
+  std::unique_ptr<TraceBufferChunk> other = buffer.GetChunk(&chunk_index);
+  buffer.ReturnChunk(chunk_index, std::move(other));
+  EXPECT_FALSE(buffer.GetEventByHandle(handle));
+  EXPECT_GT(buffer.encoded_size(), 0u);
+
+  const TraceBufferChunk* decoded = buffer.NextChunk();
+  ASSERT_TRUE(decoded);
+  ASSERT_EQ(1u, decoded->size());
+  EXPECT_STREQ("long", decoded->GetEventAt(0)->name());
+  EXPECT_EQ(20, decoded->GetEventAt(0)->duration().ToInternalValue());
+  EXPECT_FALSE(buffer.NextChunk());
+  EndTraceAndFlush();
+}
+
+TEST_F(TraceEventTestFixture, CompactTraceBufferRecordContinuously) {
+  BeginTrace();
+  const size_t kMaxBytes = 256 * 1024;
+  CompactTraceBuffer buffer(kMaxBytes, CompactTraceBuffer::RECORD_CONTINUOUSLY);
+  const unsigned char* category = TraceLog::GetCategoryGroupEnabled("cat");
+  const char* arg_names[] = {"i"};
+  const unsigned char arg_types[] = {TRACE_VALUE_TYPE_UINT};
+  const size_t kEventCount = 2000 * TraceBufferChunk::kTraceBufferChunkSize;
+  for (size_t i = 0; i < kEventCount;) {
+    size_t chunk_index;
+    std::unique_ptr<TraceBufferChunk> chunk = buffer.GetChunk(&chunk_index);
+    for (; !chunk->IsFull(); ++i) {
+      size_t event_index;
+      const unsigned long long arg_values[] = {i};
+      chunk->AddTraceEvent(&event_index)
+          ->Initialize(1, TimeTicks::FromInternalValue(i), ThreadTicks(),
+                       TRACE_EVENT_PHASE_INSTANT, category, "event", nullptr,
+                       0, 0, 1, arg_names, arg_types, arg_values, nullptr,
+                       TRACE_EVENT_FLAG_NONE);
+    }
+    buffer.ReturnChunk(chunk_index, std::move(chunk));
+    EXPECT_FALSE(buffer.IsFull());
+  }
+  EXPECT_LE(buffer.encoded_size(), kMaxBytes);
+  EXPECT_LT(buffer.Size(), kEventCount);
+
+  // The newest events are kept, in order.
+  size_t count = 0;
+  int64_t last_timestamp = -1;
+  while (const TraceBufferChunk* decoded = buffer.NextChunk()) {
+    for (size_t i = 0; i < decoded->size(); ++i, ++count) {
+      int64_t timestamp = decoded->GetEventAt(i)->timestamp().ToInternalValue();
+      EXPECT_EQ(last_timestamp == -1 ? timestamp : last_timestamp + 1,
+                timestamp);
+      last_timestamp = timestamp;
+    }
+  }
+  EXPECT_EQ(buffer.Size(), count);
+  EXPECT_EQ(static_cast<int64_t>(kEventCount) - 1, last_timestamp);
+  EndTraceAndFlush();
+}
+
 void BlockUntilStopped(WaitableEvent* task_start_event,
                        WaitableEvent* task_stop_event) {
   task_start_event->Signal();
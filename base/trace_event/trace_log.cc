@@ -27,9 +27,11 @@
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread_id_name_manager.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/threading/worker_pool.h"
 #include "base/time/time.h"
+#include "base/trace_event/compact_trace_buffer.h"
 #include "base/trace_event/heap_profiler.h"
 #include "base/trace_event/heap_profiler_allocation_context_tracker.h"
 #include "base/trace_event/memory_dump_manager.h"
@@ -83,6 +85,12 @@ const size_t kTraceEventRingBufferChunks = kTraceEventVectorBufferChunks / 4;
 // ECHO_TO_CONSOLE needs a small buffer to hold the unfinished COMPLETE events.
 const size_t kEchoToConsoleTraceEventBufferChunks = 256;
 
+// Sizes of the encoded events of CompactTraceBuffer, which hold several times
+// as many events as the buffers above in a fraction of their memory.
+const size_t kCompactTraceBufferBytes = 16 * 1024 * 1024;
+const size_t kCompactTraceRingBufferBytes = kCompactTraceBufferBytes / 4;
+const size_t kCompactTraceBigBufferBytes = 256 * 1024 * 1024;
+
 const size_t kTraceEventBufferSizeInBytes = 100 * 1024;
 const int kThreadFlushTimeoutMs = 3000;
 
@@ -116,6 +124,69 @@ base::subtle::AtomicWord g_category_index = kNumBuiltinCategories;
 LazyInstance<ThreadLocalPointer<const char>>::Leaky g_current_thread_name =
     LAZY_INSTANCE_INITIALIZER;
 
+// The number of empty chunks that a thread takes from the trace buffer at a
+// time.
+const size_t kChunkBatchSize = 4;
+
+// Marks the chunk of a ThreadLocalEventBuffer that its thread is writing to.
+const subtle::AtomicWord kClaimedChunk = 1;
+
+// Deletes the ThreadLocalEventBuffer of a thread when it exits. Unlike
+// TraceLog::thread_local_event_buffer_, it is not reset with TraceLog.
+ThreadLocalStorage::StaticSlot g_thread_exit_slot = TLS_INITIALIZER;
+
+// A bounded single-producer single-consumer queue of chunks. The producer is
+// the thread of a ThreadLocalEventBuffer and the consumer is the thread that
+// holds TraceLog::lock_, so that full chunks are handed off without the lock.
+class ChunkQueue {
+ public:
+  ChunkQueue() : head_(0), tail_(0) {}
+
+  // Only called by the producer.
+  bool IsFull() const {
+    return Next(subtle::NoBarrier_Load(&tail_)) == subtle::Acquire_Load(&head_);
+  }
+
+  // Only called by the producer, when the queue is not full.
+  void Push(std::unique_ptr<TraceBufferChunk> chunk, size_t index) {
+    DCHECK(!IsFull());
+    subtle::Atomic32 tail = subtle::NoBarrier_Load(&tail_);
+    entries_[tail].chunk = std::move(chunk);
+    entries_[tail].index = index;
+    subtle::Release_Store(&tail_, Next(tail));
+  }
+
+  // Only called by the consumer. Returns null if the queue is empty.
+  std::unique_ptr<TraceBufferChunk> Pop(size_t* index) {
+    subtle::Atomic32 head = subtle::NoBarrier_Load(&head_);
+    if (head == subtle::Acquire_Load(&tail_))
+      return nullptr;
+    *index = entries_[head].index;
+    std::unique_ptr<TraceBufferChunk> chunk = std::move(entries_[head].chunk);
+    subtle::Release_Store(&head_, Next(head));
+    return chunk;
+  }
+
+ private:
+  // One entry is left unused to tell a full queue from an empty one.
+  static const subtle::Atomic32 kCapacity = 2 * kChunkBatchSize + 1;
+
+  struct Entry {
+    std::unique_ptr<TraceBufferChunk> chunk;
+    size_t index;
+  };
+
+  static subtle::Atomic32 Next(subtle::Atomic32 position) {
+    return (position + 1) % kCapacity;
+  }
+
+  Entry entries_[kCapacity];
+  subtle::Atomic32 head_;
+  subtle::Atomic32 tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkQueue);
+};
+
 ThreadTicks ThreadNow() {
   return ThreadTicks::IsSupported() ? ThreadTicks::Now() : ThreadTicks();
 }
@@ -205,27 +276,54 @@ class TraceLog::OptionalAutoLock {
   DISALLOW_COPY_AND_ASSIGN(OptionalAutoLock);
 };
 
+// A per-thread event buffer. Events are added to its current chunk without
+// taking lock_. Full chunks are handed off to the trace buffer through
+// |full_chunks_|, and empty chunks are taken from it kChunkBatchSize at a time,
+// so lock_ is only taken once every few chunks.
+//
+// The buffer of a thread with a message loop is flushed on that thread by
+// FlushCurrentThread(). The buffer of a thread without one is flushed from the
+// flushing thread by FlushInternal(), which takes the current chunk from the
+// thread once it is not writing to it, and at the latest when the thread exits.
 class TraceLog::ThreadLocalEventBuffer
     : public MessageLoop::DestructionObserver,
       public MemoryDumpProvider {
  public:
-  explicit ThreadLocalEventBuffer(TraceLog* trace_log);
+  ThreadLocalEventBuffer(TraceLog* trace_log, bool has_message_loop);
   ~ThreadLocalEventBuffer() override;
 
+  // Adds an event to the current chunk. The chunk stays claimed by the thread
+  // until ReleaseChunk(), so that the caller can initialize the event.
   TraceEvent* AddTraceEvent(TraceEventHandle* handle);
 
-  TraceEvent* GetEventByHandle(TraceEventHandle handle) {
-    if (!chunk_ || handle.chunk_seq != chunk_->seq() ||
-        handle.chunk_index != chunk_index_) {
-      return nullptr;
-    }
+  // Returns the event of |handle| if it is in the current chunk, which then
+  // stays claimed until ReleaseChunk().
+  TraceEvent* GetEventByHandle(TraceEventHandle handle);
 
-    return chunk_->GetEventAt(handle.event_index);
-  }
+  void ReleaseChunk();
+
+  // Returns the full chunks handed off by the thread to the trace buffer.
+  void ReturnFullChunksWhileLocked();
 
+  // Returns the events of the buffer to the trace buffer. Unlike the other
+  // methods, this may be called from another thread.
+  void FlushWhileLocked();
+
+  // Detaches the buffer from its TraceLog, which is being deleted.
+  void OrphanWhileLocked() { trace_log_ = nullptr; }
+
+  bool has_message_loop() const { return has_message_loop_; }
   int generation() const { return generation_; }
 
+  // Deletes the buffer of a thread that exits.
+  static void OnThreadExit(void* buffer);
+
  private:
+  struct EmptyChunk {
+    std::unique_ptr<TraceBufferChunk> chunk;
+    size_t index;
+  };
+
   // MessageLoop::DestructionObserver
   void WillDestroyCurrentMessageLoop() override;
 
@@ -233,104 +331,275 @@ class TraceLog::ThreadLocalEventBuffer
   bool OnMemoryDump(const MemoryDumpArgs& args,
                     ProcessMemoryDump* pmd) override;
 
-  void FlushWhileLocked();
+  // Claims the current chunk, if any, into |claimed_chunk_|. FlushWhileLocked()
+  // waits until the chunk is released, so lock_ must not be taken meanwhile.
+  void ClaimChunk();
+
+  // Takes the next empty chunk, refilling |empty_chunks_| if needed. Returns
+  // null if the trace buffer is full.
+  std::unique_ptr<TraceBufferChunk> TakeEmptyChunk(size_t* index);
+
+  void ReturnChunkWhileLocked(size_t index,
+                              std::unique_ptr<TraceBufferChunk> chunk);
 
   void CheckThisIsCurrentBuffer() const {
-    DCHECK(trace_log_->thread_local_event_buffer_.Get() == this);
+    DCHECK(!trace_log_ || trace_log_->thread_local_event_buffer_.Get() == this);
   }
 
   // Since TraceLog is a leaky singleton, trace_log_ will always be valid
-  // as long as the thread exists.
+  // as long as the thread exists, except in tests which delete it.
   TraceLog* trace_log_;
-  std::unique_ptr<TraceBufferChunk> chunk_;
+  const bool has_message_loop_;
+
+  // The current TraceBufferChunk*, kClaimedChunk while the thread uses it, or
+  // null. Only the thread sets it to a chunk; FlushWhileLocked() may take the
+  // chunk from another thread when it is not claimed.
+  subtle::AtomicWord chunk_;
   size_t chunk_index_;
+  // Whether the thread has claimed |chunk_|, and the chunk it then holds.
+  bool claimed_;
+  TraceBufferChunk* claimed_chunk_;
+
+  ChunkQueue full_chunks_;
+
+  // Only accessed by the thread, in the order the chunks were taken.
+  std::vector<EmptyChunk> empty_chunks_;
+  size_t next_empty_chunk_;
+
   int generation_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadLocalEventBuffer);
 };
 
-TraceLog::ThreadLocalEventBuffer::ThreadLocalEventBuffer(TraceLog* trace_log)
+TraceLog::ThreadLocalEventBuffer::ThreadLocalEventBuffer(TraceLog* trace_log,
+                                                         bool has_message_loop)
     : trace_log_(trace_log),
+      has_message_loop_(has_message_loop),
+      chunk_(0),
       chunk_index_(0),
+      claimed_(false),
+      claimed_chunk_(nullptr),
+      next_empty_chunk_(0),
       generation_(trace_log->generation()) {
-  // ThreadLocalEventBuffer is created only if the thread has a message loop, so
-  // the following message_loop won't be NULL.
-  MessageLoop* message_loop = MessageLoop::current();
-  message_loop->AddDestructionObserver(this);
+  // The buffer of a deleted TraceLog may still be attached to the thread.
+  auto* orphaned_buffer =
+      static_cast<ThreadLocalEventBuffer*>(g_thread_exit_slot.Get());
+  DCHECK(!orphaned_buffer || !orphaned_buffer->trace_log_);
+  delete orphaned_buffer;
+  g_thread_exit_slot.Set(this);
 
-  // This is to report the local memory usage when memory-infra is enabled.
-  MemoryDumpManager::GetInstance()->RegisterDumpProvider(
-      this, "ThreadLocalEventBuffer", ThreadTaskRunnerHandle::Get());
+  MessageLoop* message_loop = nullptr;
+  if (has_message_loop_) {
+    message_loop = MessageLoop::current();
+    message_loop->AddDestructionObserver(this);
+
+    // This is to report the local memory usage when memory-infra is enabled.
+    MemoryDumpManager::GetInstance()->RegisterDumpProvider(
+        this, "ThreadLocalEventBuffer", ThreadTaskRunnerHandle::Get());
+  }
 
   AutoLock lock(trace_log->lock_);
-  trace_log->thread_message_loops_.insert(message_loop);
+  trace_log->thread_local_event_buffers_.insert(this);
+  if (message_loop)
+    trace_log->thread_message_loops_.insert(message_loop);
 }
 
 TraceLog::ThreadLocalEventBuffer::~ThreadLocalEventBuffer() {
   CheckThisIsCurrentBuffer();
-  MessageLoop::current()->RemoveDestructionObserver(this);
-  MemoryDumpManager::GetInstance()->UnregisterDumpProvider(this);
+  DCHECK(!claimed_);
+  if (has_message_loop_) {
+    MessageLoop::current()->RemoveDestructionObserver(this);
+    MemoryDumpManager::GetInstance()->UnregisterDumpProvider(this);
+  }
+  g_thread_exit_slot.Set(nullptr);
 
-  {
-    AutoLock lock(trace_log_->lock_);
-    FlushWhileLocked();
-    trace_log_->thread_message_loops_.erase(MessageLoop::current());
+  if (trace_log_) {
+    {
+      AutoLock lock(trace_log_->lock_);
+      FlushWhileLocked();
+      for (; next_empty_chunk_ < empty_chunks_.size(); ++next_empty_chunk_) {
+        EmptyChunk& empty_chunk = empty_chunks_[next_empty_chunk_];
+        ReturnChunkWhileLocked(empty_chunk.index,
+                               std::move(empty_chunk.chunk));
+      }
+      trace_log_->thread_local_event_buffers_.erase(this);
+      if (has_message_loop_)
+        trace_log_->thread_message_loops_.erase(MessageLoop::current());
+    }
+    trace_log_->thread_local_event_buffer_.Set(NULL);
   }
-  trace_log_->thread_local_event_buffer_.Set(NULL);
+  // Only left if the buffer is orphaned.
+  delete reinterpret_cast<TraceBufferChunk*>(subtle::NoBarrier_Load(&chunk_));
+}
+
+// static
+void TraceLog::ThreadLocalEventBuffer::OnThreadExit(void* buffer) {
+  auto* event_buffer = static_cast<ThreadLocalEventBuffer*>(buffer);
+  // The other thread local values of the thread may have been cleared already.
+  if (event_buffer->trace_log_)
+    event_buffer->trace_log_->thread_local_event_buffer_.Set(event_buffer);
+  delete event_buffer;
 }
 
 TraceEvent* TraceLog::ThreadLocalEventBuffer::AddTraceEvent(
     TraceEventHandle* handle) {
   CheckThisIsCurrentBuffer();
 
-  if (chunk_ && chunk_->IsFull()) {
-    AutoLock lock(trace_log_->lock_);
-    FlushWhileLocked();
-    chunk_.reset();
+  ClaimChunk();
+  if (claimed_chunk_ && claimed_chunk_->IsFull() && full_chunks_.IsFull()) {
+    // lock_ must not be taken while the chunk is claimed. The full chunk stays
+    // in |chunk_| meanwhile, so a flush may take it.
+    ReleaseChunk();
+    {
+      AutoLock lock(trace_log_->lock_);
+      ReturnFullChunksWhileLocked();
+    }
+    ClaimChunk();
   }
-  if (!chunk_) {
-    AutoLock lock(trace_log_->lock_);
-    chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
-    trace_log_->CheckIfBufferIsFullWhileLocked();
+  if (claimed_chunk_ && claimed_chunk_->IsFull()) {
+    // Keep the chunk claimed until it is queued, so that FlushWhileLocked(),
+    // which drains |full_chunks_| after taking the claim, finds it in either.
+    full_chunks_.Push(std::unique_ptr<TraceBufferChunk>(claimed_chunk_),
+                      chunk_index_);
+    claimed_chunk_ = nullptr;
+  }
+  if (!claimed_chunk_) {
+    ReleaseChunk();
+    std::unique_ptr<TraceBufferChunk> chunk = TakeEmptyChunk(&chunk_index_);
+    if (!chunk)
+      return NULL;
+    ClaimChunk();
+    DCHECK(!claimed_chunk_);
+    claimed_chunk_ = chunk.release();
   }
-  if (!chunk_)
-    return NULL;
 
   size_t event_index;
-  TraceEvent* trace_event = chunk_->AddTraceEvent(&event_index);
+  TraceEvent* trace_event = claimed_chunk_->AddTraceEvent(&event_index);
   if (trace_event && handle)
-    MakeHandle(chunk_->seq(), chunk_index_, event_index, handle);
+    MakeHandle(claimed_chunk_->seq(), chunk_index_, event_index, handle);
 
   return trace_event;
 }
 
+TraceEvent* TraceLog::ThreadLocalEventBuffer::GetEventByHandle(
+    TraceEventHandle handle) {
+  ClaimChunk();
+  if (!claimed_chunk_ || handle.chunk_seq != claimed_chunk_->seq() ||
+      handle.chunk_index != chunk_index_) {
+    ReleaseChunk();
+    return nullptr;
+  }
+
+  return claimed_chunk_->GetEventAt(handle.event_index);
+}
+
+void TraceLog::ThreadLocalEventBuffer::ClaimChunk() {
+  DCHECK(!claimed_);
+  claimed_ = true;
+  claimed_chunk_ = reinterpret_cast<TraceBufferChunk*>(
+      subtle::NoBarrier_AtomicExchange(&chunk_, kClaimedChunk));
+  DCHECK_NE(kClaimedChunk,
+            reinterpret_cast<subtle::AtomicWord>(claimed_chunk_));
+}
+
+void TraceLog::ThreadLocalEventBuffer::ReleaseChunk() {
+  if (!claimed_)
+    return;
+  claimed_ = false;
+  subtle::Release_Store(&chunk_,
+                        reinterpret_cast<subtle::AtomicWord>(claimed_chunk_));
+  claimed_chunk_ = nullptr;
+}
+
+std::unique_ptr<TraceBufferChunk>
+TraceLog::ThreadLocalEventBuffer::TakeEmptyChunk(size_t* index) {
+  if (next_empty_chunk_ == empty_chunks_.size()) {
+    HEAP_PROFILER_SCOPED_IGNORE;
+    empty_chunks_.clear();
+    next_empty_chunk_ = 0;
+
+    AutoLock lock(trace_log_->lock_);
+    ReturnFullChunksWhileLocked();
+    TraceBuffer* logged_events = trace_log_->logged_events_.get();
+    do {
+      EmptyChunk empty_chunk;
+      empty_chunk.chunk = logged_events->GetChunk(&empty_chunk.index);
+      if (!empty_chunk.chunk)
+        break;
+      empty_chunks_.push_back(std::move(empty_chunk));
+    } while (empty_chunks_.size() < kChunkBatchSize &&
+             !logged_events->IsFull());
+    trace_log_->CheckIfBufferIsFullWhileLocked();
+    if (empty_chunks_.empty())
+      return nullptr;
+  }
+
+  EmptyChunk& empty_chunk = empty_chunks_[next_empty_chunk_++];
+  *index = empty_chunk.index;
+  return std::move(empty_chunk.chunk);
+}
+
 void TraceLog::ThreadLocalEventBuffer::WillDestroyCurrentMessageLoop() {
   delete this;
 }
 
 bool TraceLog::ThreadLocalEventBuffer::OnMemoryDump(const MemoryDumpArgs& args,
                                                     ProcessMemoryDump* pmd) {
-  if (!chunk_)
+  // This runs on the thread, which doesn't hold a claim on the chunk.
+  auto* chunk =
+      reinterpret_cast<TraceBufferChunk*>(subtle::NoBarrier_Load(&chunk_));
+  if (!chunk)
     return true;
   std::string dump_base_name = StringPrintf(
       "tracing/thread_%d", static_cast<int>(PlatformThread::CurrentId()));
   TraceEventMemoryOverhead overhead;
-  chunk_->EstimateTraceMemoryOverhead(&overhead);
+  chunk->EstimateTraceMemoryOverhead(&overhead);
+  for (size_t i = next_empty_chunk_; i < empty_chunks_.size(); ++i)
+    empty_chunks_[i].chunk->EstimateTraceMemoryOverhead(&overhead);
   overhead.DumpInto(dump_base_name.c_str(), pmd);
   return true;
 }
 
-void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
-  if (!chunk_)
-    return;
+void TraceLog::ThreadLocalEventBuffer::ReturnFullChunksWhileLocked() {
+  trace_log_->lock_.AssertAcquired();
+  size_t index;
+  while (std::unique_ptr<TraceBufferChunk> chunk = full_chunks_.Pop(&index))
+    ReturnChunkWhileLocked(index, std::move(chunk));
+}
 
+void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
   trace_log_->lock_.AssertAcquired();
-  if (trace_log_->CheckGeneration(generation_)) {
-    // Return the chunk to the buffer only if the generation matches.
-    trace_log_->logged_events_->ReturnChunk(chunk_index_, std::move(chunk_));
+
+  // The thread claims the chunk only while it adds an event or updates the
+  // duration of one, without taking lock_, so this doesn't wait for long.
+  subtle::AtomicWord chunk;
+  for (;;) {
+    chunk = subtle::Acquire_Load(&chunk_);
+    if (chunk == kClaimedChunk) {
+      PlatformThread::YieldCurrentThread();
+      continue;
+    }
+    if (subtle::Acquire_CompareAndSwap(&chunk_, chunk, 0) == chunk)
+      break;
+  }
+  // A chunk that the thread filled is queued before it is released, so the
+  // queue is drained only now.
+  ReturnFullChunksWhileLocked();
+  if (chunk) {
+    ReturnChunkWhileLocked(
+        chunk_index_,
+        std::unique_ptr<TraceBufferChunk>(
+            reinterpret_cast<TraceBufferChunk*>(chunk)));
   }
-  // Otherwise this method may be called from the destructor, or TraceLog will
-  // find the generation mismatch and delete this buffer soon.
+}
+
+void TraceLog::ThreadLocalEventBuffer::ReturnChunkWhileLocked(
+    size_t index,
+    std::unique_ptr<TraceBufferChunk> chunk) {
+  // Return the chunk to the buffer only if the generation matches. Otherwise
+  // the chunk was taken from a buffer that has been flushed already.
+  if (trace_log_->CheckGeneration(generation_))
+    trace_log_->logged_events_->ReturnChunk(index, std::move(chunk));
 }
 
 struct TraceLog::RegisteredAsyncObserver {
@@ -387,29 +656,39 @@ TraceLog::TraceLog()
 
   logged_events_.reset(CreateTraceBuffer());
 
+  if (!g_thread_exit_slot.initialized())
+    g_thread_exit_slot.Initialize(&ThreadLocalEventBuffer::OnThreadExit);
+
   MemoryDumpManager::GetInstance()->RegisterDumpProvider(this, "TraceLog",
                                                          nullptr);
 }
 
-TraceLog::~TraceLog() {}
+TraceLog::~TraceLog() {
+  // Only happens in tests. The buffers are deleted by their threads.
+  AutoLock lock(lock_);
+  for (ThreadLocalEventBuffer* buffer : thread_local_event_buffers_)
+    buffer->OrphanWhileLocked();
+}
 
 void TraceLog::InitializeThreadLocalEventBufferIfSupported() {
-  // A ThreadLocalEventBuffer needs the message loop
+  // A ThreadLocalEventBuffer uses the message loop, if any,
   // - to know when the thread exits;
   // - to handle the final flush.
-  // For a thread without a message loop or the message loop may be blocked, the
-  // trace events will be added into the main buffer directly.
-  if (thread_blocks_message_loop_.Get() || !MessageLoop::current())
-    return;
+  // The buffer of a thread without a message loop, or whose message loop may be
+  // blocked, is flushed from the flushing thread instead.
+  const bool has_message_loop =
+      !thread_blocks_message_loop_.Get() && MessageLoop::current();
   HEAP_PROFILER_SCOPED_IGNORE;
   auto* thread_local_event_buffer = thread_local_event_buffer_.Get();
   if (thread_local_event_buffer &&
-      !CheckGeneration(thread_local_event_buffer->generation())) {
+      (!CheckGeneration(thread_local_event_buffer->generation()) ||
+       thread_local_event_buffer->has_message_loop() != has_message_loop)) {
     delete thread_local_event_buffer;
     thread_local_event_buffer = NULL;
   }
   if (!thread_local_event_buffer) {
-    thread_local_event_buffer = new ThreadLocalEventBuffer(this);
+    thread_local_event_buffer =
+        new ThreadLocalEventBuffer(this, has_message_loop);
     thread_local_event_buffer_.Set(thread_local_event_buffer);
   }
 }
@@ -681,6 +960,8 @@ TraceLog::InternalTraceOptions TraceLog::GetInternalOptionsFromTraceConfig(
       config.IsSamplingEnabled() ? kInternalEnableSampling : kInternalNone;
   if (config.IsArgumentFilterEnabled())
     ret |= kInternalEnableArgumentFilter;
+  if (config.IsCompactBufferEnabled())
+    ret |= kInternalEnableCompactBuffer;
   switch (config.GetTraceRecordMode()) {
     case RECORD_UNTIL_FULL:
       return ret | kInternalRecordUntilFull;
@@ -905,6 +1186,12 @@ void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
                                   std::move(thread_shared_chunk_));
     }
 
+    // Threads without a message loop can't flush their own buffers.
+    for (ThreadLocalEventBuffer* buffer : thread_local_event_buffers_) {
+      if (!buffer->has_message_loop())
+        buffer->FlushWhileLocked();
+    }
+
     for (MessageLoop* loop : thread_message_loops_)
       thread_message_loop_task_runners.push_back(loop->task_runner());
   }
@@ -1219,8 +1506,6 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
   TimeTicks offset_event_timestamp = OffsetTimestamp(timestamp);
   ThreadTicks thread_now = ThreadNow();
 
-  // |thread_local_event_buffer_| can be null if the current thread doesn't have
-  // a message loop or the message loop is blocked.
   InitializeThreadLocalEventBufferIfSupported();
   auto* thread_local_event_buffer = thread_local_event_buffer_.Get();
 
@@ -1272,16 +1557,7 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
 
   std::string console_message;
   if (*category_group_enabled & ENABLED_FOR_RECORDING) {
-    OptionalAutoLock lock(&lock_);
-
-    TraceEvent* trace_event = NULL;
-    if (thread_local_event_buffer) {
-      trace_event = thread_local_event_buffer->AddTraceEvent(&handle);
-    } else {
-      lock.EnsureAcquired();
-      trace_event = AddEventToThreadSharedChunkWhileLocked(&handle, true);
-    }
-
+    TraceEvent* trace_event = thread_local_event_buffer->AddTraceEvent(&handle);
     if (trace_event) {
       trace_event->Initialize(thread_id,
                               offset_event_timestamp,
@@ -1309,6 +1585,7 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
           phase == TRACE_EVENT_PHASE_COMPLETE ? TRACE_EVENT_PHASE_BEGIN : phase,
           timestamp, trace_event);
     }
+    thread_local_event_buffer->ReleaseChunk();
   }
 
   if (!console_message.empty())
@@ -1477,6 +1754,8 @@ void TraceLog::UpdateTraceEventDuration(
       console_message =
           EventToConsoleMessage(TRACE_EVENT_PHASE_END, now, trace_event);
     }
+    if (thread_local_event_buffer_.Get())
+      thread_local_event_buffer_.Get()->ReleaseChunk();
 
     if (AllocationContextTracker::capture_mode() ==
         AllocationContextTracker::CaptureMode::PSEUDO_STACK) {
@@ -1600,7 +1879,11 @@ void TraceLog::DeleteForTesting() {
 }
 
 TraceEvent* TraceLog::GetEventByHandle(TraceEventHandle handle) {
-  return GetEventByHandleInternal(handle, NULL);
+  TraceEvent* trace_event = GetEventByHandleInternal(handle, NULL);
+  // The chunk can be released right away since this is only used by tests.
+  if (thread_local_event_buffer_.Get())
+    thread_local_event_buffer_.Get()->ReleaseChunk();
+  return trace_event;
 }
 
 TraceEvent* TraceLog::GetEventByHandleInternal(TraceEventHandle handle,
@@ -1608,17 +1891,23 @@ TraceEvent* TraceLog::GetEventByHandleInternal(TraceEventHandle handle,
   if (!handle.chunk_seq)
     return NULL;
 
-  if (thread_local_event_buffer_.Get()) {
+  // This claims the chunk of the thread local buffer if the event is in it.
+  auto* thread_local_event_buffer = thread_local_event_buffer_.Get();
+  if (thread_local_event_buffer) {
     TraceEvent* trace_event =
-        thread_local_event_buffer_.Get()->GetEventByHandle(handle);
+        thread_local_event_buffer->GetEventByHandle(handle);
     if (trace_event)
       return trace_event;
   }
 
   // The event has been out-of-control of the thread local buffer.
   // Try to get the event from the main buffer with a lock.
-  if (lock)
+  if (lock) {
     lock->EnsureAcquired();
+    // The event may be in a full chunk that is not in the main buffer yet.
+    if (thread_local_event_buffer)
+      thread_local_event_buffer->ReturnFullChunksWhileLocked();
+  }
 
   if (thread_shared_chunk_ &&
       handle.chunk_index == thread_shared_chunk_index_) {
@@ -1686,6 +1975,17 @@ void TraceLog::SetCurrentThreadBlocksMessageLoop() {
 TraceBuffer* TraceLog::CreateTraceBuffer() {
   HEAP_PROFILER_SCOPED_IGNORE;
   InternalTraceOptions options = trace_options();
+  if ((options & kInternalEnableCompactBuffer) &&
+      !(options & kInternalEchoToConsole)) {
+    if (options & kInternalRecordContinuously) {
+      return new CompactTraceBuffer(kCompactTraceRingBufferBytes,
+                                    CompactTraceBuffer::RECORD_CONTINUOUSLY);
+    }
+    return new CompactTraceBuffer((options & kInternalRecordAsMuchAsPossible)
+                                      ? kCompactTraceBigBufferBytes
+                                      : kCompactTraceBufferBytes,
+                                  CompactTraceBuffer::RECORD_UNTIL_FULL);
+  }
   if (options & kInternalRecordContinuously) {
     return TraceBuffer::CreateTraceBufferRingBuffer(
         kTraceEventRingBufferChunks);
@@ -72,8 +72,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   // Retrieves a copy (for thread-safety) of the current TraceConfig.
   TraceConfig GetCurrentTraceConfig() const;
 
-  // Initializes the thread-local event buffer, if not already initialized and
-  // if the current thread supports that (has a message loop).
+  // Initializes the thread-local event buffer, if not already initialized.
   void InitializeThreadLocalEventBufferIfSupported();
 
   // Enables normal tracing (recording trace events in the trace buffer).
@@ -451,6 +450,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   static const InternalTraceOptions kInternalEnableSampling;
   static const InternalTraceOptions kInternalRecordAsMuchAsPossible;
   static const InternalTraceOptions kInternalEnableArgumentFilter;
+  static const InternalTraceOptions kInternalEnableCompactBuffer;
 
   // This lock protects TraceLog member accesses (except for members protected
   // by thread_info_lock_) from arbitrary threads.
@@ -505,13 +505,16 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   ThreadLocalBoolean thread_blocks_message_loop_;
   ThreadLocalBoolean thread_is_in_trace_event_;
 
+  // Contains the thread local event buffers of all threads, so that Flush() can
+  // take the events of threads without a message loop.
+  hash_set<ThreadLocalEventBuffer*> thread_local_event_buffers_;
+
   // Contains the message loops of threads that have had at least one event
   // added into the local event buffer. Not using SingleThreadTaskRunner
   // because we need to know the life time of the message loops.
   hash_set<MessageLoop*> thread_message_loops_;
 
-  // For events which can't be added into the thread local buffer, e.g. events
-  // from threads without a message loop.
+  // For events which are added while lock_ is held, e.g. metadata events.
   std::unique_ptr<TraceBufferChunk> thread_shared_chunk_;
   size_t thread_shared_chunk_index_;
 
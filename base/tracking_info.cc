@@ -5,6 +5,8 @@
 #include "base/tracking_info.h"
 
 #include <stddef.h>
+
+#include "base/profiler/task_profiler.h"
 #include "base/tracked_objects.h"
 
 namespace base {
@@ -19,6 +21,7 @@ TrackingInfo::TrackingInfo(
     : birth_tally(
           tracked_objects::ThreadData::TallyABirthIfActive(posted_from)),
       time_posted(tracked_objects::ThreadData::Now()),
+      queue_time(TaskProfiler::SampleQueueTime()),
       delayed_run_time(delayed_run_time) {
 }
 
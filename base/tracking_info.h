@@ -49,6 +49,10 @@ struct BASE_EXPORT TrackingInfo {
   // profiling-related reporting.
   tracked_objects::TrackedTime time_posted;
 
+  // Time when the related task was posted, for the TaskProfiler. Null if the
+  // queue time of the task is not sampled.
+  base::TimeTicks queue_time;
+
   // The time when the task should be run.
   base::TimeTicks delayed_run_time;
 };
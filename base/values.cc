@@ -28,6 +28,17 @@ static_assert(arraysize(kTypeNames) == Value::TYPE_LIST + 1,
 
 std::unique_ptr<Value> CopyWithoutEmptyChildren(const Value& node);
 
+// Returns the first entry of the key-sorted |storage| whose key is not less
+// than |key|. Works on both const and non-const FlatStorage.
+template <typename FlatStorageType>
+auto FlatLowerBound(FlatStorageType& storage, const std::string& key)
+    -> decltype(storage.begin()) {
+  return std::lower_bound(
+      storage.begin(), storage.end(), key,
+      [](const DictionaryValue::FlatStorage::value_type& entry,
+         const std::string& target) { return entry.first < target; });
+}
+
 // Make a deep copy of |node|, but don't include empty lists or dictionaries
 // in the copy. It's possible for this function to return NULL and it
 // expects |node| to always be non-NULL.
@@ -356,8 +367,38 @@ std::unique_ptr<DictionaryValue> DictionaryValue::From(
   return nullptr;
 }
 
+// static
+std::unique_ptr<DictionaryValue> DictionaryValue::CreateFlat(
+    FlatStorage entries) {
+  // A stable sort keeps duplicate keys in insertion order so that the last
+  // one can be kept below.
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const FlatStorage::value_type& a,
+                      const FlatStorage::value_type& b) {
+                     return a.first < b.first;
+                   });
+
+  std::unique_ptr<DictionaryValue> dictionary(
+      new DictionaryValue(StorageMode::FLAT));
+  FlatStorage& storage = dictionary->flat_dictionary_;
+  storage.reserve(entries.size());
+  for (auto& entry : entries) {
+    DCHECK(IsStringUTF8(entry.first));
+    DCHECK(entry.second);
+    if (!storage.empty() && storage.back().first == entry.first)
+      storage.back().second = std::move(entry.second);
+    else
+      storage.push_back(std::move(entry));
+  }
+  return dictionary;
+}
+
 DictionaryValue::DictionaryValue()
-    : Value(TYPE_DICTIONARY) {
+    : DictionaryValue(StorageMode::MAP) {
+}
+
+DictionaryValue::DictionaryValue(StorageMode storage_mode)
+    : Value(TYPE_DICTIONARY), storage_mode_(storage_mode) {
 }
 
 DictionaryValue::~DictionaryValue() {
@@ -378,13 +419,12 @@ bool DictionaryValue::GetAsDictionary(const DictionaryValue** out_value) const {
 
 bool DictionaryValue::HasKey(const std::string& key) const {
   DCHECK(IsStringUTF8(key));
-  auto current_entry = dictionary_.find(key);
-  DCHECK((current_entry == dictionary_.end()) || current_entry->second);
-  return current_entry != dictionary_.end();
+  return GetWithoutPathExpansion(key, static_cast<const Value**>(nullptr));
 }
 
 void DictionaryValue::Clear() {
   dictionary_.clear();
+  flat_dictionary_.clear();
 }
 
 void DictionaryValue::Set(const std::string& path,
@@ -441,7 +481,18 @@ void DictionaryValue::SetString(const std::string& path,
 
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
                                               std::unique_ptr<Value> in_value) {
-  dictionary_[key] = std::move(in_value);
+  if (storage_mode_ == StorageMode::MAP) {
+    dictionary_[key] = std::move(in_value);
+    return;
+  }
+
+  auto entry_iterator = FlatLowerBound(flat_dictionary_, key);
+  if (entry_iterator != flat_dictionary_.end() &&
+      entry_iterator->first == key) {
+    entry_iterator->second = std::move(in_value);
+  } else {
+    flat_dictionary_.emplace(entry_iterator, key, std::move(in_value));
+  }
 }
 
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
@@ -625,12 +676,24 @@ bool DictionaryValue::GetList(const std::string& path, ListValue** out_value) {
 bool DictionaryValue::GetWithoutPathExpansion(const std::string& key,
                                               const Value** out_value) const {
   DCHECK(IsStringUTF8(key));
-  auto entry_iterator = dictionary_.find(key);
-  if (entry_iterator == dictionary_.end())
-    return false;
+  const Value* value = nullptr;
+  if (storage_mode_ == StorageMode::MAP) {
+    auto entry_iterator = dictionary_.find(key);
+    if (entry_iterator == dictionary_.end())
+      return false;
+    value = entry_iterator->second.get();
+  } else {
+    auto entry_iterator = FlatLowerBound(flat_dictionary_, key);
+    if (entry_iterator == flat_dictionary_.end() ||
+        entry_iterator->first != key) {
+      return false;
+    }
+    value = entry_iterator->second.get();
+  }
+  DCHECK(value);
 
   if (out_value)
-    *out_value = entry_iterator->second.get();
+    *out_value = value;
   return true;
 }
 
@@ -754,6 +817,19 @@ bool DictionaryValue::RemoveWithoutPathExpansion(
     const std::string& key,
     std::unique_ptr<Value>* out_value) {
   DCHECK(IsStringUTF8(key));
+  if (storage_mode_ == StorageMode::FLAT) {
+    auto entry_iterator = FlatLowerBound(flat_dictionary_, key);
+    if (entry_iterator == flat_dictionary_.end() ||
+        entry_iterator->first != key) {
+      return false;
+    }
+
+    if (out_value)
+      *out_value = std::move(entry_iterator->second);
+    flat_dictionary_.erase(entry_iterator);
+    return true;
+  }
+
   auto entry_iterator = dictionary_.find(key);
   if (entry_iterator == dictionary_.end())
     return false;
@@ -811,19 +887,32 @@ void DictionaryValue::MergeDictionary(const DictionaryValue* dictionary) {
 }
 
 void DictionaryValue::Swap(DictionaryValue* other) {
+  std::swap(storage_mode_, other->storage_mode_);
   dictionary_.swap(other->dictionary_);
+  flat_dictionary_.swap(other->flat_dictionary_);
 }
 
 DictionaryValue::Iterator::Iterator(const DictionaryValue& target)
     : target_(target),
-      it_(target.dictionary_.begin()) {}
+      it_(target.dictionary_.begin()),
+      flat_it_(target.flat_dictionary_.begin()) {}
 
 DictionaryValue::Iterator::Iterator(const Iterator& other) = default;
 
 DictionaryValue::Iterator::~Iterator() {}
 
 DictionaryValue* DictionaryValue::DeepCopy() const {
-  DictionaryValue* result = new DictionaryValue;
+  DictionaryValue* result = new DictionaryValue(storage_mode_);
+
+  if (storage_mode_ == StorageMode::FLAT) {
+    // The source is already sorted, so the copy can be built in order.
+    result->flat_dictionary_.reserve(flat_dictionary_.size());
+    for (const auto& current_entry : flat_dictionary_) {
+      result->flat_dictionary_.emplace_back(
+          current_entry.first, current_entry.second->CreateDeepCopy());
+    }
+    return result;
+  }
 
   for (const auto& current_entry : dictionary_) {
     result->SetWithoutPathExpansion(current_entry.first,
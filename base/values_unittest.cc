@@ -868,6 +868,88 @@ TEST(ValuesTest, DictionaryIterator) {
   EXPECT_TRUE(seen2);
 }
 
+TEST(ValuesTest, FlatDictionary) {
+  DictionaryValue dict(DictionaryValue::StorageMode::FLAT);
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, dict.storage_mode());
+  EXPECT_TRUE(dict.empty());
+
+  // Insert out of order and through paths; nested dictionaries created by
+  // path expansion use the default mode.
+  dict.SetInteger("c", 3);
+  dict.SetInteger("a", 1);
+  dict.SetString("b.x", "bx");
+  dict.SetInteger("a", 10);
+  EXPECT_EQ(3U, dict.size());
+
+  int int_value = 0;
+  EXPECT_TRUE(dict.GetInteger("a", &int_value));
+  EXPECT_EQ(10, int_value);
+  std::string string_value;
+  EXPECT_TRUE(dict.GetString("b.x", &string_value));
+  EXPECT_EQ("bx", string_value);
+  EXPECT_TRUE(dict.HasKey("c"));
+  EXPECT_FALSE(dict.HasKey("d"));
+
+  const char* const kExpectedKeys[] = {"a", "b", "c"};
+  size_t i = 0;
+  for (DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance()) {
+    ASSERT_LT(i, arraysize(kExpectedKeys));
+    EXPECT_EQ(kExpectedKeys[i++], it.key());
+  }
+  EXPECT_EQ(arraysize(kExpectedKeys), i);
+
+  // Copies keep the mode and compare equal to a map-backed dictionary with
+  // the same contents.
+  std::unique_ptr<DictionaryValue> copy = dict.CreateDeepCopy();
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, copy->storage_mode());
+  DictionaryValue map_dict;
+  map_dict.MergeDictionary(&dict);
+  EXPECT_TRUE(copy->Equals(&map_dict));
+  EXPECT_TRUE(map_dict.Equals(copy.get()));
+
+  std::unique_ptr<Value> removed;
+  EXPECT_TRUE(dict.Remove("c", &removed));
+  EXPECT_TRUE(FundamentalValue(3).Equals(removed.get()));
+  EXPECT_FALSE(dict.Remove("c", nullptr));
+  EXPECT_TRUE(dict.RemovePath("b.x", nullptr));
+  EXPECT_EQ(1U, dict.size());
+
+  // Swapping exchanges the storage mode too.
+  dict.Swap(&map_dict);
+  EXPECT_EQ(DictionaryValue::StorageMode::MAP, dict.storage_mode());
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, map_dict.storage_mode());
+  EXPECT_EQ(3U, dict.size());
+  EXPECT_EQ(1U, map_dict.size());
+
+  dict.Clear();
+  EXPECT_TRUE(dict.empty());
+}
+
+TEST(ValuesTest, CreateFlatDictionary) {
+  DictionaryValue::FlatStorage entries;
+  entries.emplace_back("b", MakeUnique<FundamentalValue>(2));
+  entries.emplace_back("a", MakeUnique<FundamentalValue>(1));
+  entries.emplace_back("b", MakeUnique<FundamentalValue>(20));
+  std::unique_ptr<DictionaryValue> dict =
+      DictionaryValue::CreateFlat(std::move(entries));
+
+  EXPECT_EQ(DictionaryValue::StorageMode::FLAT, dict->storage_mode());
+  EXPECT_EQ(2U, dict->size());
+  int value = 0;
+  EXPECT_TRUE(dict->GetInteger("a", &value));
+  EXPECT_EQ(1, value);
+  // The last duplicate wins.
+  EXPECT_TRUE(dict->GetInteger("b", &value));
+  EXPECT_EQ(20, value);
+
+  DictionaryValue::Iterator it(*dict);
+  EXPECT_EQ("a", it.key());
+  it.Advance();
+  EXPECT_EQ("b", it.key());
+  it.Advance();
+  EXPECT_TRUE(it.IsAtEnd());
+}
+
 // DictionaryValue/ListValue's Get*() methods should accept NULL as an out-value
 // and still return true/false based on success.
 TEST(ValuesTest, GetWithNullOutValue) {
@@ -26,6 +26,7 @@
 #include "base/metrics/histogram_macros.h"
 #include "base/path_service.h"
 #include "base/profiler/scoped_tracker.h"
+#include "base/profiler/task_profiler.h"
 #include "base/run_loop.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_piece.h"
@@ -798,6 +799,13 @@ void ChromeBrowserMainParts::SetupMetricsAndFieldTrials() {
       break;
   }
 
+  // The task profiler reports the time spent by the tasks of each posting
+  // location to UMA.
+  if (base::FeatureList::IsEnabled(features::kTaskProfiler)) {
+    base::TaskProfiler::SetEnabled(true);
+    base::TaskProfiler::StartPeriodicReporting(base::TimeDelta::FromMinutes(5));
+  }
+
   // Register a synthetic field trial for the sampling profiler configuration
   // that was already chosen.
   sampling_profiler_config_.RegisterSyntheticFieldTrial();
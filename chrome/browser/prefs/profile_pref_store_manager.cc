@@ -9,10 +9,12 @@
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/files/file_util.h"
+#include "base/files/important_file_write_batcher.h"
 #include "base/json/json_file_value_serializer.h"
 #include "base/logging.h"
 #include "base/metrics/histogram.h"
 #include "base/sequenced_task_runner.h"
+#include "base/time/time.h"
 #include "build/build_config.h"
 #include "chrome/common/chrome_constants.h"
 #include "components/pref_registry/pref_registry_syncable.h"
@@ -25,6 +27,10 @@
 
 namespace {
 
+// How long a write of Preferences or Secure Preferences waits for one of the
+// other file, so that they are committed together.
+const int kPrefWriteFlushWindowMs = 1000;
+
 void RemoveValueSilently(const base::WeakPtr<JsonPrefStore> pref_store,
                          const std::string& key) {
   if (pref_store) {
@@ -120,15 +126,20 @@ PersistentPrefStore* ProfilePrefStoreManager::CreateProfilePrefStore(
   PrefHashFilter* raw_protected_pref_hash_filter =
       protected_pref_hash_filter.get();
 
+  // The writes of the two files are committed together.
+  scoped_refptr<base::ImportantFileWriteBatcher> batcher(
+      new base::ImportantFileWriteBatcher(
+          io_task_runner,
+          base::TimeDelta::FromMilliseconds(kPrefWriteFlushWindowMs)));
   scoped_refptr<JsonPrefStore> unprotected_pref_store(new JsonPrefStore(
-      profile_path_.Append(chrome::kPreferencesFilename), io_task_runner.get(),
-      std::move(unprotected_pref_hash_filter)));
+      profile_path_.Append(chrome::kPreferencesFilename), base::FilePath(),
+      batcher, std::move(unprotected_pref_hash_filter)));
   // TODO(gab): Remove kDeprecatedProtectedPreferencesFilename as an alternate
   // file in M40+.
   scoped_refptr<JsonPrefStore> protected_pref_store(new JsonPrefStore(
       profile_path_.Append(chrome::kSecurePreferencesFilename),
       profile_path_.Append(chrome::kProtectedPreferencesFilenameDeprecated),
-      io_task_runner.get(), std::move(protected_pref_hash_filter)));
+      batcher, std::move(protected_pref_hash_filter)));
 
   SetupTrackedPreferencesMigration(
       unprotected_pref_names, protected_pref_names,
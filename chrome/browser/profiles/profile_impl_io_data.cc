@@ -81,6 +81,8 @@ net::BackendType ChooseCacheBackendType() {
       return net::CACHE_BACKEND_BLOCKFILE;
     if (opt_value.empty() || base::LowerCaseEqualsASCII(opt_value, "on"))
       return net::CACHE_BACKEND_SIMPLE;
+    if (base::LowerCaseEqualsASCII(opt_value, "hybrid"))
+      return net::CACHE_BACKEND_HYBRID;
   }
   const std::string experiment_name =
       base::FieldTrialList::FindFullName("SimpleCacheTrial");
@@ -985,7 +985,8 @@ const char kUserAgent[]                     = "user-agent";
 // all of its state.
 const char kUserDataDir[]                   = "user-data-dir";
 
-// Uses experimental simple cache backend if possible.
+// Uses experimental simple cache backend if possible. With the value "hybrid",
+// the simple cache backend also keeps recently used entries in memory.
 const char kUseSimpleCacheBackend[]         = "use-simple-cache-backend";
 
 // Enables using an in-process Mojo service for the v8 proxy resolver.
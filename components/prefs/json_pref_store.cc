@@ -13,6 +13,7 @@
 #include "base/callback.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/files/important_file_write_batcher.h"
 #include "base/json/json_file_value_serializer.h"
 #include "base/json/json_string_value_serializer.h"
 #include "base/macros.h"
@@ -133,6 +134,18 @@ std::unique_ptr<JsonPrefStore::ReadResult> ReadPrefsFromDisk(
   return read_result;
 }
 
+// Serializes |prefs|, a snapshot of the prefs of a JsonPrefStore, on the task
+// runner of its writer.
+bool SerializePrefs(std::unique_ptr<base::DictionaryValue> prefs,
+                    std::string* output) {
+  JSONStringValueSerializer serializer(output);
+  // Not pretty-printing prefs shrinks pref file size by ~30%. To obtain
+  // readable prefs for debugging purposes, you can dump your prefs into any
+  // command-line or online JSON pretty printing tool.
+  serializer.set_pretty_print(false);
+  return serializer.Serialize(*prefs);
+}
+
 }  // namespace
 
 // static
@@ -175,6 +188,26 @@ JsonPrefStore::JsonPrefStore(
   DCHECK(!path_.empty());
 }
 
+JsonPrefStore::JsonPrefStore(
+    const base::FilePath& pref_filename,
+    const base::FilePath& pref_alternate_filename,
+    scoped_refptr<base::ImportantFileWriteBatcher> batcher,
+    std::unique_ptr<PrefFilter> pref_filter)
+    : path_(pref_filename),
+      alternate_path_(pref_alternate_filename),
+      sequenced_task_runner_(batcher->task_runner()),
+      prefs_(new base::DictionaryValue()),
+      read_only_(false),
+      writer_(pref_filename, std::move(batcher)),
+      pref_filter_(std::move(pref_filter)),
+      initialized_(false),
+      filtering_in_progress_(false),
+      pending_lossy_write_(false),
+      read_error_(PREF_READ_ERROR_NONE),
+      write_count_histogram_(writer_.commit_interval(), path_) {
+  DCHECK(!path_.empty());
+}
+
 bool JsonPrefStore::GetValue(const std::string& key,
                              const base::Value** result) const {
   DCHECK(CalledOnValidThread());
@@ -309,7 +342,7 @@ void JsonPrefStore::CommitPendingWrite() {
 
 void JsonPrefStore::SchedulePendingLossyWrites() {
   if (pending_lossy_write_)
-    writer_.ScheduleWrite(this);
+    writer_.ScheduleWriteWithBackgroundDataSerializer(this);
 }
 
 void JsonPrefStore::ReportValueChanged(const std::string& key, uint32_t flags) {
@@ -394,7 +427,8 @@ JsonPrefStore::~JsonPrefStore() {
   CommitPendingWrite();
 }
 
-bool JsonPrefStore::SerializeData(std::string* output) {
+base::ImportantFileWriter::DataProducer
+JsonPrefStore::GetSerializedDataProducerForBackgroundSequence() {
   DCHECK(CalledOnValidThread());
 
   pending_lossy_write_ = false;
@@ -404,12 +438,9 @@ bool JsonPrefStore::SerializeData(std::string* output) {
   if (pref_filter_)
     pref_filter_->FilterSerializeData(prefs_.get());
 
-  JSONStringValueSerializer serializer(output);
-  // Not pretty-printing prefs shrinks pref file size by ~30%. To obtain
-  // readable prefs for debugging purposes, you can dump your prefs into any
-  // command-line or online JSON pretty printing tool.
-  serializer.set_pretty_print(false);
-  return serializer.Serialize(*prefs_);
+  // Copying the prefs is much cheaper than serializing them, which is left to
+  // the task runner of |writer_|.
+  return base::Bind(&SerializePrefs, base::Passed(prefs_->CreateDeepCopy()));
 }
 
 void JsonPrefStore::FinalizeFileRead(
@@ -451,7 +482,7 @@ void JsonPrefStore::ScheduleWrite(uint32_t flags) {
   if (flags & LOSSY_PREF_WRITE_FLAG)
     pending_lossy_write_ = true;
   else
-    writer_.ScheduleWrite(this);
+    writer_.ScheduleWriteWithBackgroundDataSerializer(this);
 }
 
 // NOTE: This value should NOT be changed without renaming the histogram
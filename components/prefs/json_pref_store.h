@@ -30,6 +30,7 @@ class Clock;
 class DictionaryValue;
 class FilePath;
 class HistogramBase;
+class ImportantFileWriteBatcher;
 class JsonPrefStoreLossyWriteTest;
 class SequencedTaskRunner;
 class SequencedWorkerPool;
@@ -43,7 +44,7 @@ FORWARD_DECLARE_TEST(JsonPrefStoreTest, WriteCountHistogramTestPeriodWithGaps);
 // A writable PrefStore implementation that is used for user preferences.
 class COMPONENTS_PREFS_EXPORT JsonPrefStore
     : public PersistentPrefStore,
-      public base::ImportantFileWriter::DataSerializer,
+      public base::ImportantFileWriter::BackgroundDataSerializer,
       public base::SupportsWeakPtr<JsonPrefStore>,
       public base::NonThreadSafe {
  public:
@@ -74,6 +75,14 @@ class COMPONENTS_PREFS_EXPORT JsonPrefStore
       const scoped_refptr<base::SequencedTaskRunner>& sequenced_task_runner,
       std::unique_ptr<PrefFilter> pref_filter);
 
+  // Same as above, but the prefs are read on the task runner of |batcher|,
+  // which commits their writes together with those of the other files which
+  // share it.
+  JsonPrefStore(const base::FilePath& pref_filename,
+                const base::FilePath& pref_alternate_filename,
+                scoped_refptr<base::ImportantFileWriteBatcher> batcher,
+                std::unique_ptr<PrefFilter> pref_filter);
+
   // PrefStore overrides:
   bool GetValue(const std::string& key,
                 const base::Value** result) const override;
@@ -182,8 +191,9 @@ class COMPONENTS_PREFS_EXPORT JsonPrefStore
   // is invoked directly.
   void OnFileRead(std::unique_ptr<ReadResult> read_result);
 
-  // ImportantFileWriter::DataSerializer overrides:
-  bool SerializeData(std::string* output) override;
+  // ImportantFileWriter::BackgroundDataSerializer overrides:
+  base::ImportantFileWriter::DataProducer
+  GetSerializedDataProducerForBackgroundSequence() override;
 
   // This method is called after the JSON file has been read and the result has
   // potentially been intercepted and modified by |pref_filter_|.
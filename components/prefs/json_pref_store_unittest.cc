@@ -11,6 +11,7 @@
 
 #include "base/bind.h"
 #include "base/files/file_util.h"
+#include "base/files/important_file_write_batcher.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/location.h"
 #include "base/macros.h"
@@ -26,6 +27,7 @@
 #include "base/strings/utf_string_conversions.h"
 #include "base/test/histogram_tester.h"
 #include "base/test/simple_test_clock.h"
+#include "base/test/test_mock_time_task_runner.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "base/threading/thread.h"
 #include "base/values.h"
@@ -668,6 +670,31 @@ TEST_F(JsonPrefStoreTest, BasicAsyncWithAlternateFile) {
   RunBasicJsonPrefStoreTest(pref_store.get(), input_file);
 }
 
+// Test that the writes handed off to a batcher are committed by
+// CommitPendingWrite() without waiting for the end of its flush window.
+TEST_F(JsonPrefStoreTest, CommitPendingWriteWithBatcher) {
+  scoped_refptr<TestMockTimeTaskRunner> file_task_runner(
+      new TestMockTimeTaskRunner);
+  scoped_refptr<ImportantFileWriteBatcher> batcher(
+      new ImportantFileWriteBatcher(file_task_runner, TimeDelta::FromHours(1)));
+  base::FilePath pref_file = temp_dir_.path().AppendASCII("write.json");
+  scoped_refptr<JsonPrefStore> pref_store = new JsonPrefStore(
+      pref_file, base::FilePath(), batcher, std::unique_ptr<PrefFilter>());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NO_FILE,
+            pref_store->ReadPrefs());
+
+  pref_store->SetValue(kHomePage,
+                       base::WrapUnique(new StringValue("http://www.cnn.com")),
+                       WriteablePrefStore::DEFAULT_PREF_WRITE_FLAGS);
+  pref_store->CommitPendingWrite();
+  file_task_runner->RunUntilIdle();
+  RunLoop().RunUntilIdle();
+
+  std::string output_contents;
+  ASSERT_TRUE(base::ReadFileToString(pref_file, &output_contents));
+  EXPECT_EQ("{\"homepage\":\"http://www.cnn.com\"}", output_contents);
+}
+
 TEST_F(JsonPrefStoreTest, WriteCountHistogramTestBasic) {
   base::HistogramTester histogram_tester;
 
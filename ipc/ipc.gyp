@@ -175,9 +175,11 @@
       'sources': [
         'ipc_mojo_perftest.cc',
         'ipc_perftests.cc',
+        'ipc_send_perftest_posix.cc',
         'ipc_test_base.cc',
         'ipc_test_base.h',
         'run_all_perftests.cc',
+        '../testing/perf/perf_test.cc',
       ],
       'conditions': [
         ['OS == "android"', {
@@ -317,7 +317,11 @@ class IPC_EXPORT Channel : public Endpoint {
     // must be malloced.
     OutputElement(void* buffer, size_t length);
     ~OutputElement();
-    size_t size() const { return message_ ? message_->size() : length_; }
+    // The size of the serialized message, which includes external data that
+    // data() does not hold. See base::Pickle::WriteExternalData().
+    size_t size() const {
+      return message_ ? message_->serialized_size() : length_;
+    }
     const void* data() const { return message_ ? message_->data() : buffer_; }
     Message* get_message() const { return message_.get(); }
 
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/socket.h>
@@ -29,6 +30,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/command_line.h"
 #include "base/files/file_path.h"
@@ -171,6 +173,27 @@ bool SocketWriteErrorIsRecoverable() {
 #endif  // OS_MACOSX
 }
 
+// Fills |iovecs| with the bytes of |message| that follow the first
+// |bytes_written|, pointing into its serialized segments so that external data
+// is sent without being copied. See base::Pickle::WriteExternalData().
+void GetUnsentIOVecs(Message* message,
+                     size_t bytes_written,
+                     std::vector<struct iovec>* iovecs) {
+  std::vector<base::Pickle::Segment> segments;
+  message->GetSerializedSegments(&segments);
+  iovecs->clear();
+  for (const base::Pickle::Segment& segment : segments) {
+    if (bytes_written >= segment.size) {
+      bytes_written -= segment.size;
+      continue;
+    }
+    struct iovec iov = {const_cast<char*>(segment.data) + bytes_written,
+                        segment.size - bytes_written};
+    iovecs->push_back(iov);
+    bytes_written = 0;
+  }
+}
+
 }  // namespace
 
 #if defined(OS_ANDROID)
@@ -407,13 +430,10 @@ bool ChannelPosix::ProcessOutgoingMessages() {
 
     size_t amt_to_write = element->size() - message_send_bytes_written_;
     DCHECK_NE(0U, amt_to_write);
-    const char* out_bytes = reinterpret_cast<const char*>(element->data()) +
-        message_send_bytes_written_;
 
     struct msghdr msgh = {0};
-    struct iovec iov = {const_cast<char*>(out_bytes), amt_to_write};
-    msgh.msg_iov = &iov;
-    msgh.msg_iovlen = 1;
+    struct iovec iov;
+    std::vector<struct iovec> iovecs;
     char buf[CMSG_SPACE(sizeof(int) *
                         MessageAttachmentSet::kMaxDescriptorsPerMessage)];
 
@@ -454,6 +474,20 @@ bool ChannelPosix::ProcessOutgoingMessages() {
       msg->header()->num_fds = static_cast<uint16_t>(num_fds);
     }
 
+    // Gathered after num_fds is set, since the segments copy the header.
+    if (msg) {
+      GetUnsentIOVecs(msg, message_send_bytes_written_, &iovecs);
+      msgh.msg_iov = iovecs.data();
+      msgh.msg_iovlen = iovecs.size();
+    } else {
+      const char* out_bytes = reinterpret_cast<const char*>(element->data()) +
+          message_send_bytes_written_;
+      iov.iov_base = const_cast<char*>(out_bytes);
+      iov.iov_len = amt_to_write;
+      msgh.msg_iov = &iov;
+      msgh.msg_iovlen = 1;
+    }
+
     if (bytes_written == 1) {
       fd_written = pipe_.get();
       bytes_written = HANDLE_EINTR(sendmsg(pipe_.get(), &msgh, MSG_DONTWAIT));
@@ -725,6 +759,15 @@ bool ChannelPosix::ProcessMessageForDelivery(Message* message) {
                          message->flags(),
                          TRACE_EVENT_FLAG_FLOW_OUT);
 
+  // Messages with more segments than one sendmsg() accepts are sent
+  // contiguously instead.
+  if (message->has_external_data()) {
+    std::vector<base::Pickle::Segment> segments;
+    message->GetSerializedSegments(&segments);
+    if (segments.size() > static_cast<size_t>(IOV_MAX))
+      message->Flatten();
+  }
+
   // |output_queue_| takes ownership of |message|.
   OutputElement* element = new OutputElement(message);
   output_queue_.push(element);
@@ -123,6 +123,9 @@ bool ChannelWin::ProcessMessageForDelivery(Message* message) {
                          message->flags(),
                          TRACE_EVENT_FLAG_FLOW_OUT);
 
+  // Overlapped writes need the message in one buffer.
+  message->Flatten();
+
   // |output_queue_| takes ownership of |message|.
   OutputElement* element = new OutputElement(message);
   output_queue_.push(element);
@@ -5,8 +5,10 @@
 #include "ipc/ipc_message_pipe_reader.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include <utility>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
@@ -92,10 +94,16 @@ bool MessagePipeReader::Send(std::unique_ptr<Message> message) {
   if (result != MOJO_RESULT_OK)
     return false;
 
-  mojo::Array<uint8_t> data(message->size());
-  std::copy(reinterpret_cast<const uint8_t*>(message->data()),
-            reinterpret_cast<const uint8_t*>(message->data()) + message->size(),
-            &data[0]);
+  // Gathers external data straight into the mojo array, rather than
+  // flattening the message first and copying it twice.
+  mojo::Array<uint8_t> data(message->serialized_size());
+  std::vector<base::Pickle::Segment> segments;
+  message->GetSerializedSegments(&segments);
+  uint8_t* out = &data[0];
+  for (const base::Pickle::Segment& segment : segments) {
+    memcpy(out, segment.data, segment.size);
+    out += segment.size;
+  }
 
   MessageSerializer serializer;
   mojom::ChannelProxy proxy(&serializer);
@@ -109,7 +117,8 @@ bool MessagePipeReader::Send(std::unique_ptr<Message> message) {
   result = mojo::WriteMessageNew(sender_pipe_, mojo_message->TakeMojoMessage(),
                                  MOJO_WRITE_MESSAGE_FLAG_NONE);
 
-  DVLOG(4) << "Send " << message->type() << ": " << message->size();
+  DVLOG(4) << "Send " << message->type() << ": "
+           << message->serialized_size();
   return result == MOJO_RESULT_OK;
 }
 
@@ -9,6 +9,7 @@
 
 #include "base/files/file_path.h"
 #include "base/json/json_writer.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/nullable_string16.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/utf_string_conversions.h"
@@ -998,6 +999,52 @@ void ParamTraits<base::TimeTicks>::Log(const param_type& p, std::string* l) {
   ParamTraits<int64_t>::Log(p.ToInternalValue(), l);
 }
 
+void ParamTraits<scoped_refptr<base::RefCountedMemory>>::GetSize(
+    base::PickleSizer* sizer,
+    const param_type& p) {
+  sizer->AddBool();
+  if (p)
+    sizer->AddData(static_cast<int>(p->size()));
+}
+
+void ParamTraits<scoped_refptr<base::RefCountedMemory>>::Write(
+    base::Pickle* m,
+    const param_type& p) {
+  m->WriteBool(!!p);
+  if (p)
+    m->WriteExternalData(p);
+}
+
+bool ParamTraits<scoped_refptr<base::RefCountedMemory>>::Read(
+    const base::Pickle* m,
+    base::PickleIterator* iter,
+    param_type* r) {
+  bool valid;
+  if (!iter->ReadBool(&valid))
+    return false;
+  if (!valid) {
+    *r = nullptr;
+    return true;
+  }
+  const char* data;
+  int data_size = 0;
+  if (!iter->ReadData(&data, &data_size) || data_size < 0)
+    return false;
+  *r = new base::RefCountedBytes(reinterpret_cast<const unsigned char*>(data),
+                                 data_size);
+  return true;
+}
+
+void ParamTraits<scoped_refptr<base::RefCountedMemory>>::Log(
+    const param_type& p,
+    std::string* l) {
+  if (!p) {
+    l->append("NULL");
+    return;
+  }
+  l->append(base::StringPrintf("<%" PRIuS " bytes>", p->size()));
+}
+
 void ParamTraits<IPC::ChannelHandle>::GetSize(base::PickleSizer* sizer,
                                               const param_type& p) {
   GetParamSize(sizer, p.name);
@@ -1092,6 +1139,8 @@ void ParamTraits<Message>::Write(base::Pickle* m, const Message& p) {
   // better not be any.
   DCHECK(!p.HasAttachments());
 #endif
+  // Only the message's buffer is written, which lacks external data.
+  DCHECK(!p.has_external_data());
 
   // Don't just write out the message. This is used to send messages between
   // NaCl (Posix environment) and the browser (could be on Windows). The message
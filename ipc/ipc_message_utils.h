@@ -21,6 +21,7 @@
 #include "base/containers/stack_container.h"
 #include "base/files/file.h"
 #include "base/format_macros.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_vector.h"
 #include "base/optional.h"
 #include "base/strings/string16.h"
@@ -37,6 +38,7 @@ class DictionaryValue;
 class FilePath;
 class ListValue;
 class NullableString16;
+class RefCountedMemory;
 class Time;
 class TimeDelta;
 class TimeTicks;
@@ -666,6 +668,19 @@ struct IPC_EXPORT ParamTraits<base::TimeTicks> {
   static void Log(const param_type& p, std::string* l);
 };
 
+// Large blobs are referenced by the message rather than copied into it; see
+// base::Pickle::WriteExternalData(). The reader gets a copy.
+template <>
+struct IPC_EXPORT ParamTraits<scoped_refptr<base::RefCountedMemory>> {
+  typedef scoped_refptr<base::RefCountedMemory> param_type;
+  static void GetSize(base::PickleSizer* sizer, const param_type& p);
+  static void Write(base::Pickle* m, const param_type& p);
+  static bool Read(const base::Pickle* m,
+                   base::PickleIterator* iter,
+                   param_type* r);
+  static void Log(const param_type& p, std::string* l);
+};
+
 template <>
 struct ParamTraits<std::tuple<>> {
   typedef std::tuple<> param_type;
@@ -10,6 +10,7 @@
 
 #include "base/files/file_path.h"
 #include "base/json/json_reader.h"
+#include "base/memory/ref_counted_memory.h"
 #include "ipc/ipc_channel_handle.h"
 #include "ipc/ipc_message.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -199,5 +200,50 @@ TEST(IPCMessageUtilsTest, OptionalSet) {
   EXPECT_EQ(opt.value(), unserialized_opt.value());
 }
 
+// Tests that large blobs are referenced by the message, and that the reader
+// gets the same bytes back.
+TEST(IPCMessageUtilsTest, RefCountedMemory) {
+  scoped_refptr<base::RefCountedString> large(new base::RefCountedString);
+  large->data().assign(base::Pickle::kMinExternalDataSize + 1, 'x');
+  std::string small_string("small");
+  scoped_refptr<base::RefCountedMemory> small(
+      base::RefCountedString::TakeString(&small_string));
+  scoped_refptr<base::RefCountedMemory> null;
+
+  Message message(0, 0, Message::PRIORITY_NORMAL);
+  base::PickleSizer sizer;
+  for (const scoped_refptr<base::RefCountedMemory>& p :
+       {scoped_refptr<base::RefCountedMemory>(large), small, null}) {
+    IPC::WriteParam(&message, p);
+    IPC::GetParamSize(&sizer, p);
+  }
+  EXPECT_TRUE(message.has_external_data());
+  const size_t serialized_size = message.serialized_size();
+
+  std::string log;
+  IPC::LogParam(small, &log);
+  EXPECT_EQ("<5 bytes>", log);
+
+  // Reading works the same before and after flattening.
+  for (bool flatten : {false, true}) {
+    if (flatten) {
+      message.Flatten();
+      EXPECT_EQ(serialized_size, message.size());
+      EXPECT_EQ(sizer.payload_size(), message.payload_size());
+    }
+    base::PickleIterator iter(message);
+    scoped_refptr<base::RefCountedMemory> result;
+    ASSERT_TRUE(IPC::ReadParam(&message, &iter, &result));
+    ASSERT_TRUE(result);
+    EXPECT_TRUE(large->Equals(result));
+    ASSERT_TRUE(IPC::ReadParam(&message, &iter, &result));
+    ASSERT_TRUE(result);
+    EXPECT_TRUE(small->Equals(result));
+    ASSERT_TRUE(IPC::ReadParam(&message, &iter, &result));
+    EXPECT_FALSE(result);
+    EXPECT_FALSE(IPC::ReadParam(&message, &iter, &result));
+  }
+}
+
 }  // namespace
 }  // namespace IPC
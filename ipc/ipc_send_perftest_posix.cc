@@ -0,0 +1,171 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "base/bind.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "ipc/ipc_channel_posix.h"
+#include "ipc/ipc_listener.h"
+#include "ipc/ipc_message.h"
+#include "ipc/ipc_message_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+// Measures large messages sent through a pair of connected ChannelPosix. The
+// payload is either copied into each message with WriteData() or written as a
+// scoped_refptr<RefCountedMemory> parameter, which references it with
+// WriteExternalData() so that ChannelPosix gathers it straight from the payload
+// with sendmsg(). The receiving channel reassembles each message either way.
+
+namespace IPC {
+namespace {
+
+// Each payload size is sent until at least this much data has been written.
+const size_t kMinBytesSent = 512 * 1024 * 1024;
+
+// The number of messages queued in the sending channel at any time, which
+// keeps the copies of the payload made with WriteData() bounded.
+const size_t kMessagesInFlight = 4;
+
+// Sends |num_messages| carrying |payload| through |sender|, keeping
+// kMessagesInFlight of them in flight, and quits the run loop once the peer
+// channel, which this listens to, has received them all.
+class PayloadStream : public Listener {
+ public:
+  PayloadStream(const scoped_refptr<base::RefCountedMemory>& payload,
+                bool external,
+                size_t num_messages,
+                const base::Closure& quit_closure)
+      : payload_(payload),
+        external_(external),
+        messages_to_send_(num_messages),
+        messages_to_receive_(num_messages),
+        quit_closure_(quit_closure),
+        sender_(nullptr) {}
+
+  void Start(Sender* sender) {
+    sender_ = sender;
+    for (size_t i = 0; i < kMessagesInFlight; ++i)
+      SendNextMessage();
+  }
+
+  // Listener:
+  bool OnMessageReceived(const Message& message) override {
+    if (!--messages_to_receive_)
+      quit_closure_.Run();
+    else
+      SendNextMessage();
+    return true;
+  }
+
+  void OnChannelError() override {
+    ADD_FAILURE() << "Channel error";
+    quit_closure_.Run();
+  }
+
+ private:
+  void SendNextMessage() {
+    if (!messages_to_send_)
+      return;
+    --messages_to_send_;
+    Message* message = new Message(0, 1, Message::PRIORITY_NORMAL);
+    if (external_) {
+      WriteParam(message, payload_);
+    } else {
+      CHECK(message->WriteData(payload_->front_as<char>(),
+                               static_cast<int>(payload_->size())));
+    }
+    CHECK(sender_->Send(message));
+  }
+
+  scoped_refptr<base::RefCountedMemory> payload_;
+  const bool external_;
+  size_t messages_to_send_;
+  size_t messages_to_receive_;
+  base::Closure quit_closure_;
+  Sender* sender_;
+
+  DISALLOW_COPY_AND_ASSIGN(PayloadStream);
+};
+
+// The sending channel only gets the hello message of its peer.
+class NullListener : public Listener {
+ public:
+  NullListener() {}
+
+  // Listener:
+  bool OnMessageReceived(const Message& message) override { return false; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NullListener);
+};
+
+void RunSendPerfTest(size_t payload_size) {
+  scoped_refptr<base::RefCountedString> payload(new base::RefCountedString);
+  payload->data().assign(payload_size, 'x');
+  const size_t num_messages = kMinBytesSent / payload_size;
+
+  const struct {
+    bool external;
+    const char* name;
+  } kConfigurations[] = {
+      {false, "copy"},
+      {true, "external"},
+  };
+
+  for (const auto& configuration : kConfigurations) {
+    base::MessageLoopForIO message_loop;
+    base::RunLoop run_loop;
+    PayloadStream stream(payload, configuration.external, num_messages,
+                         run_loop.QuitClosure());
+    NullListener sender_listener;
+
+    ChannelHandle receiver_handle(
+        base::StringPrintf("IPCSendPerfTest_%s", configuration.name));
+    std::unique_ptr<ChannelPosix> receiver_channel(new ChannelPosix(
+        receiver_handle, Channel::MODE_SERVER, &stream));
+    ChannelHandle sender_handle(
+        receiver_handle.name,
+        base::FileDescriptor(receiver_channel->TakeClientFileDescriptor()));
+    std::unique_ptr<ChannelPosix> sender_channel(new ChannelPosix(
+        sender_handle, Channel::MODE_CLIENT, &sender_listener));
+    ASSERT_TRUE(receiver_channel->Connect());
+    ASSERT_TRUE(sender_channel->Connect());
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    stream.Start(sender_channel.get());
+    run_loop.Run();
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    sender_channel->Close();
+    receiver_channel->Close();
+
+    const double megabytes =
+        static_cast<double>(payload_size) * num_messages / (1024 * 1024);
+    perf_test::PrintResult(
+        "ipc_send", base::StringPrintf("_%" PRIuS "KB", payload_size / 1024),
+        configuration.name, megabytes / elapsed.InSecondsF(), "MB/s", true);
+  }
+}
+
+}  // namespace
+
+TEST(IPCSendPerfTest, LargePayloads) {
+  for (size_t payload_size = 64 * 1024; payload_size <= 4 * 1024 * 1024;
+       payload_size *= 4) {
+    RunSendPerfTest(payload_size);
+  }
+}
+
+}  // namespace IPC
@@ -131,8 +131,6 @@ bool ContainsControlCharacter(const std::string& s) {
   return false;
 }
 
-typedef std::vector<CanonicalCookie*> CanonicalCookieVector;
-
 // Default minimum delay after updating a cookie's LastAccessDate before we
 // will update it again.
 const int kDefaultAccessUpdateThresholdSeconds = 60;
@@ -140,9 +138,8 @@ const int kDefaultAccessUpdateThresholdSeconds = 60;
 // Comparator to sort cookies from highest creation date to lowest
 // creation date.
 struct OrderByCreationTimeDesc {
-  bool operator()(const CookieMonster::CookieMap::iterator& a,
-                  const CookieMonster::CookieMap::iterator& b) const {
-    return a->second->CreationDate() > b->second->CreationDate();
+  bool operator()(const CanonicalCookie* a, const CanonicalCookie* b) const {
+    return a->CreationDate() > b->CreationDate();
   }
 };
 
@@ -155,19 +152,18 @@ const int kVlogGetCookies = 9;
 // Mozilla sorts on the path length (longest first), and then it
 // sorts by creation time (oldest first).
 // The RFC says the sort order for the domain attribute is undefined.
-bool CookieSorter(CanonicalCookie* cc1, CanonicalCookie* cc2) {
+bool CookieSorter(const CanonicalCookie* cc1, const CanonicalCookie* cc2) {
   if (cc1->Path().length() == cc2->Path().length())
     return cc1->CreationDate() < cc2->CreationDate();
   return cc1->Path().length() > cc2->Path().length();
 }
 
-bool LRACookieSorter(const CookieMonster::CookieMap::iterator& it1,
-                     const CookieMonster::CookieMap::iterator& it2) {
-  if (it1->second->LastAccessDate() != it2->second->LastAccessDate())
-    return it1->second->LastAccessDate() < it2->second->LastAccessDate();
+bool LRACookieSorter(const CanonicalCookie* cc1, const CanonicalCookie* cc2) {
+  if (cc1->LastAccessDate() != cc2->LastAccessDate())
+    return cc1->LastAccessDate() < cc2->LastAccessDate();
 
   // Ensure stability for == last access times by falling back to creation.
-  return it1->second->CreationDate() < it2->second->CreationDate();
+  return cc1->CreationDate() < cc2->CreationDate();
 }
 
 // Compare cookies using name, domain and path, so that "equivalent" cookies
@@ -220,51 +216,6 @@ struct CookieSignature {
   std::string path;
 };
 
-// For a CookieItVector iterator range [|it_begin|, |it_end|),
-// sorts the first |num_sort| + 1 elements by LastAccessDate().
-// The + 1 element exists so for any interval of length <= |num_sort| starting
-// from |cookies_its_begin|, a LastAccessDate() bound can be found.
-void SortLeastRecentlyAccessed(CookieMonster::CookieItVector::iterator it_begin,
-                               CookieMonster::CookieItVector::iterator it_end,
-                               size_t num_sort) {
-  DCHECK_LT(static_cast<int>(num_sort), it_end - it_begin);
-  std::partial_sort(it_begin, it_begin + num_sort + 1, it_end, LRACookieSorter);
-}
-
-// Given a single cookie vector |cookie_its|, pushs all of the secure cookies in
-// |cookie_its| into |secure_cookie_its| and all of the non-secure cookies into
-// |non_secure_cookie_its|. Both |secure_cookie_its| and |non_secure_cookie_its|
-// must be non-NULL.
-void SplitCookieVectorIntoSecureAndNonSecure(
-    const CookieMonster::CookieItVector& cookie_its,
-    CookieMonster::CookieItVector* secure_cookie_its,
-    CookieMonster::CookieItVector* non_secure_cookie_its) {
-  DCHECK(secure_cookie_its && non_secure_cookie_its);
-  for (const auto& curit : cookie_its) {
-    if (curit->second->IsSecure())
-      secure_cookie_its->push_back(curit);
-    else
-      non_secure_cookie_its->push_back(curit);
-  }
-}
-
-bool LowerBoundAccessDateComparator(const CookieMonster::CookieMap::iterator it,
-                                    const Time& access_date) {
-  return it->second->LastAccessDate() < access_date;
-}
-
-// For a CookieItVector iterator range [|it_begin|, |it_end|)
-// from a CookieItVector sorted by LastAccessDate(), returns the
-// first iterator with access date >= |access_date|, or cookie_its_end if this
-// holds for all.
-CookieMonster::CookieItVector::iterator LowerBoundAccessDate(
-    const CookieMonster::CookieItVector::iterator its_begin,
-    const CookieMonster::CookieItVector::iterator its_end,
-    const Time& access_date) {
-  return std::lower_bound(its_begin, its_end, access_date,
-                          LowerBoundAccessDateComparator);
-}
-
 // Mapping between DeletionCause and CookieMonsterDelegate::ChangeCause; the
 // mapping also provides a boolean that specifies whether or not an
 // OnCookieChanged notification ought to be generated.
@@ -320,12 +271,12 @@ bool IsCookieEligibleForEviction(CookiePriority current_priority_level,
 
 size_t CountCookiesForPossibleDeletion(
     CookiePriority priority,
-    const CookieMonster::CookieItVector* cookies,
+    const CookieMonster::CanonicalCookieVector* cookies,
     bool protect_secure_cookies) {
   size_t cookies_count = 0U;
-  for (const auto& cookie : *cookies) {
-    if (cookie->second->Priority() == priority) {
-      if (!protect_secure_cookies || cookie->second->IsSecure())
+  for (const auto* cookie : *cookies) {
+    if (cookie->Priority() == priority) {
+      if (!protect_secure_cookies || cookie->IsSecure())
         cookies_count++;
     }
   }
@@ -334,6 +285,17 @@ size_t CountCookiesForPossibleDeletion(
 
 }  // namespace
 
+bool CookieMonster::LRACookieLess::operator()(
+    const CanonicalCookie* cc1,
+    const CanonicalCookie* cc2) const {
+  if (LRACookieSorter(cc1, cc2))
+    return true;
+  if (LRACookieSorter(cc2, cc1))
+    return false;
+  // Creation dates are not unique when the caller sets them.
+  return std::less<const CanonicalCookie*>()(cc1, cc2);
+}
+
 CookieMonster::CookieMonster(PersistentCookieStore* store,
                              CookieMonsterDelegate* delegate)
     : CookieMonster(
@@ -1024,12 +986,12 @@ CookieMonster::~CookieMonster() {
 
   // TODO(mmenke): Does it really make sense to run |delegate_| and
   // CookieChanged callbacks when the CookieStore is destroyed?
-  for (CookieMap::iterator cookie_it = cookies_.begin();
-       cookie_it != cookies_.end();) {
-    CookieMap::iterator current_cookie_it = cookie_it;
-    ++cookie_it;
-    InternalDeleteCookie(current_cookie_it, false /* sync_to_store */,
-                         DELETE_COOKIE_DONT_RECORD);
+  for (CookieDomain& domain : cookies_) {
+    while (!domain.second.empty()) {
+      InternalDeleteCookie(&domain, domain.second.back(),
+                           false /* sync_to_store */,
+                           DELETE_COOKIE_DONT_RECORD);
+    }
   }
 }
 
@@ -1091,15 +1053,16 @@ CookieList CookieMonster::GetAllCookies() {
   //
   // Note that this does not prune cookies to be below our limits (if we've
   // exceeded them) the way that calling GarbageCollect() would.
-  GarbageCollectExpired(
-      Time::Now(), CookieMapItPair(cookies_.begin(), cookies_.end()), NULL);
+  GarbageCollectAllExpired(Time::Now());
 
   // Copy the CanonicalCookie pointers from the map so that we can use the same
   // sorter as elsewhere, then copy the result out.
   std::vector<CanonicalCookie*> cookie_ptrs;
-  cookie_ptrs.reserve(cookies_.size());
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end(); ++it)
-    cookie_ptrs.push_back(it->second);
+  cookie_ptrs.reserve(lra_cookies_.size());
+  for (const CookieDomain& domain : cookies_) {
+    cookie_ptrs.insert(cookie_ptrs.end(), domain.second.begin(),
+                       domain.second.end());
+  }
   std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSorter);
 
   CookieList cookie_list;
@@ -1120,9 +1083,9 @@ CookieList CookieMonster::GetCookieListWithOptions(
   if (!HasCookieableScheme(url))
     return cookies;
 
+  // The cookies are found already sorted by CookieSorter.
   std::vector<CanonicalCookie*> cookie_ptrs;
   FindCookiesForHostAndDomain(url, options, &cookie_ptrs);
-  std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSorter);
 
   cookies.reserve(cookie_ptrs.size());
   for (std::vector<CanonicalCookie*>::const_iterator it = cookie_ptrs.begin();
@@ -1138,16 +1101,19 @@ int CookieMonster::DeleteAllCreatedBetween(const Time& delete_begin,
 
   int num_deleted = 0;
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
-
-    if (cc->CreationDate() >= delete_begin &&
-        (delete_end.is_null() || cc->CreationDate() < delete_end)) {
-      InternalDeleteCookie(curit, true, /*sync_to_store*/
-                           DELETE_COOKIE_EXPLICIT);
-      ++num_deleted;
+    CanonicalCookieVector& cookies = it->second;
+    for (size_t i = 0; i < cookies.size();) {
+      CanonicalCookie* cc = cookies[i];
+      if (cc->CreationDate() >= delete_begin &&
+          (delete_end.is_null() || cc->CreationDate() < delete_end)) {
+        InternalDeleteCookie(&*it, cc, true, /*sync_to_store*/
+                             DELETE_COOKIE_EXPLICIT);
+        ++num_deleted;
+      } else {
+        ++i;
+      }
     }
+    it = cookies.empty() ? cookies_.erase(it) : std::next(it);
   }
 
   return num_deleted;
@@ -1159,19 +1125,22 @@ int CookieMonster::DeleteAllCreatedBetweenWithPredicate(
     const base::Callback<bool(const CanonicalCookie&)>& predicate) {
   int num_deleted = 0;
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
-
-    if (cc->CreationDate() >= delete_begin &&
-        // The assumption that null |delete_end| is equivalent to
-        // Time::Max() is confusing.
-        (delete_end.is_null() || cc->CreationDate() < delete_end) &&
-        predicate.Run(*cc)) {
-      InternalDeleteCookie(curit, true, /*sync_to_store*/
-                           DELETE_COOKIE_EXPLICIT);
-      ++num_deleted;
+    CanonicalCookieVector& cookies = it->second;
+    for (size_t i = 0; i < cookies.size();) {
+      CanonicalCookie* cc = cookies[i];
+      if (cc->CreationDate() >= delete_begin &&
+          // The assumption that null |delete_end| is equivalent to
+          // Time::Max() is confusing.
+          (delete_end.is_null() || cc->CreationDate() < delete_end) &&
+          predicate.Run(*cc)) {
+        InternalDeleteCookie(&*it, cc, true, /*sync_to_store*/
+                             DELETE_COOKIE_EXPLICIT);
+        ++num_deleted;
+      } else {
+        ++i;
+      }
     }
+    it = cookies.empty() ? cookies_.erase(it) : std::next(it);
   }
 
   return num_deleted;
@@ -1196,9 +1165,9 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
   if (!HasCookieableScheme(url))
     return std::string();
 
+  // The cookies are found already sorted by CookieSorter.
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line = BuildCookieLine(cookies);
 
@@ -1221,33 +1190,37 @@ void CookieMonster::DeleteCookie(const GURL& url,
   // Get the cookies for this host and its domain(s).
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, &cookies);
-  std::set<CanonicalCookie*> matching_cookies;
+  std::vector<CanonicalCookie*> matching_cookies;
 
   for (auto* cookie : cookies) {
     if (cookie->Name() != cookie_name)
       continue;
     if (!cookie->IsOnPath(url.path()))
       continue;
-    matching_cookies.insert(cookie);
+    matching_cookies.push_back(cookie);
   }
+  if (matching_cookies.empty())
+    return;
 
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    ++it;
-    if (matching_cookies.find(curit->second) != matching_cookies.end()) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPLICIT);
-    }
-  }
+  // The cookies found all have the key of the host.
+  CookieDomain* domain = &*cookies_.find(GetKey(url.host()));
+  for (auto* cookie : matching_cookies)
+    InternalDeleteCookie(domain, cookie, true, DELETE_COOKIE_EXPLICIT);
+  EraseDomainIfEmpty(domain);
 }
 
 int CookieMonster::DeleteCanonicalCookie(const CanonicalCookie& cookie) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
-  for (CookieMapItPair its = cookies_.equal_range(GetKey(cookie.Domain()));
-       its.first != its.second; ++its.first) {
+  CookieMap::iterator it = cookies_.find(GetKey(cookie.Domain()));
+  if (it == cookies_.end())
+    return 0;
+
+  for (CanonicalCookie* cc : it->second) {
     // The creation date acts as the unique index...
-    if (its.first->second->CreationDate() == cookie.CreationDate()) {
-      InternalDeleteCookie(its.first, true, DELETE_COOKIE_EXPLICIT);
+    if (cc->CreationDate() == cookie.CreationDate()) {
+      InternalDeleteCookie(&*it, cc, true, DELETE_COOKIE_EXPLICIT);
+      EraseDomainIfEmpty(&*it);
       return 1;
     }
   }
@@ -1277,15 +1250,18 @@ int CookieMonster::DeleteSessionCookies() {
 
   int num_deleted = 0;
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
-
-    if (!cc->IsPersistent()) {
-      InternalDeleteCookie(curit, true, /*sync_to_store*/
-                           DELETE_COOKIE_EXPIRED);
-      ++num_deleted;
+    CanonicalCookieVector& cookies = it->second;
+    for (size_t i = 0; i < cookies.size();) {
+      CanonicalCookie* cc = cookies[i];
+      if (!cc->IsPersistent()) {
+        InternalDeleteCookie(&*it, cc, true, /*sync_to_store*/
+                             DELETE_COOKIE_EXPIRED);
+        ++num_deleted;
+      } else {
+        ++i;
+      }
     }
+    it = cookies.empty() ? cookies_.erase(it) : std::next(it);
   }
 
   return num_deleted;
@@ -1387,23 +1363,20 @@ void CookieMonster::StoreLoadedCookies(
 
   // Even if a key is expired, insert it so it can be garbage collected,
   // removed, and sync'd.
-  CookieItVector cookies_with_control_chars;
+  std::vector<std::pair<CookieDomain*, CanonicalCookie*>>
+      cookies_with_control_chars;
 
   for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it) {
     int64_t cookie_creation_time = (*it)->CreationDate().ToInternalValue();
 
     if (creation_times_.insert(cookie_creation_time).second) {
-      CookieMap::iterator inserted =
+      CookieDomain* domain =
           InternalInsertCookie(GetKey((*it)->Domain()), *it, GURL(), false);
-      const Time cookie_access_time((*it)->LastAccessDate());
-      if (earliest_access_time_.is_null() ||
-          cookie_access_time < earliest_access_time_)
-        earliest_access_time_ = cookie_access_time;
 
       if (ContainsControlCharacter((*it)->Name()) ||
           ContainsControlCharacter((*it)->Value())) {
-        cookies_with_control_chars.push_back(inserted);
+        cookies_with_control_chars.push_back(std::make_pair(domain, *it));
       }
     } else {
       LOG(ERROR) << base::StringPrintf(
@@ -1420,12 +1393,10 @@ void CookieMonster::StoreLoadedCookies(
 
   // Any cookies that contain control characters that we have loaded from the
   // persistent store should be deleted. See http://crbug.com/238041.
-  for (CookieItVector::iterator it = cookies_with_control_chars.begin();
-       it != cookies_with_control_chars.end();) {
-    CookieItVector::iterator curit = it;
-    ++it;
-
-    InternalDeleteCookie(*curit, true, DELETE_COOKIE_CONTROL_CHAR);
+  for (const auto& cookie : cookies_with_control_chars) {
+    InternalDeleteCookie(cookie.first, cookie.second, true,
+                         DELETE_COOKIE_CONTROL_CHAR);
+    EraseDomainIfEmpty(cookie.first);
   }
 
   // After importing cookies from the PersistentCookieStore, verify that
@@ -1471,25 +1442,17 @@ void CookieMonster::EnsureCookiesMapIsValid() {
   DCHECK(thread_checker_.CalledOnValidThread());
 
   // Iterate through all the of the cookies, grouped by host.
-  CookieMap::iterator prev_range_end = cookies_.begin();
-  while (prev_range_end != cookies_.end()) {
-    CookieMap::iterator cur_range_begin = prev_range_end;
-    const std::string key = cur_range_begin->first;  // Keep a copy.
-    CookieMap::iterator cur_range_end = cookies_.upper_bound(key);
-    prev_range_end = cur_range_end;
-
+  for (CookieDomain& domain : cookies_) {
     // Ensure no equivalent cookies for this host.
-    TrimDuplicateCookiesForKey(key, cur_range_begin, cur_range_end);
+    TrimDuplicateCookiesForKey(&domain);
   }
 }
 
-void CookieMonster::TrimDuplicateCookiesForKey(const std::string& key,
-                                               CookieMap::iterator begin,
-                                               CookieMap::iterator end) {
+void CookieMonster::TrimDuplicateCookiesForKey(CookieDomain* domain) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
   // Set of cookies ordered by creation time.
-  typedef std::set<CookieMap::iterator, OrderByCreationTimeDesc> CookieSet;
+  typedef std::set<CanonicalCookie*, OrderByCreationTimeDesc> CookieSet;
 
   // Helper map we populate to find the duplicates.
   typedef std::map<CookieSignature, CookieSet> EquivalenceMap;
@@ -1498,12 +1461,9 @@ void CookieMonster::TrimDuplicateCookiesForKey(const std::string& key,
   // The number of duplicate cookies that have been found.
   int num_duplicates = 0;
 
-  // Iterate through all of the cookies in our range, and insert them into
+  // Iterate through all of the cookies of the domain, and insert them into
   // the equivalence map.
-  for (CookieMap::iterator it = begin; it != end; ++it) {
-    DCHECK_EQ(key, it->first);
-    CanonicalCookie* cookie = it->second;
-
+  for (CanonicalCookie* cookie : domain->second) {
     CookieSignature signature(cookie->Name(), cookie->Domain(), cookie->Path());
     CookieSet& set = equivalent_cookies[signature];
 
@@ -1511,9 +1471,7 @@ void CookieMonster::TrimDuplicateCookiesForKey(const std::string& key,
     if (!set.empty())
       num_duplicates++;
 
-    // We save the iterator into |cookies_| rather than the actual cookie
-    // pointer, since we may need to delete it later.
-    bool insert_success = set.insert(it).second;
+    bool insert_success = set.insert(cookie).second;
     DCHECK(insert_success)
         << "Duplicate creation times found in duplicate cookie name scan.";
   }
@@ -1543,15 +1501,15 @@ void CookieMonster::TrimDuplicateCookiesForKey(const std::string& key,
     LOG(ERROR) << base::StringPrintf(
         "Found %d duplicate cookies for host='%s', "
         "with {name='%s', domain='%s', path='%s'}",
-        static_cast<int>(dupes.size()), key.c_str(), signature.name.c_str(),
-        signature.domain.c_str(), signature.path.c_str());
+        static_cast<int>(dupes.size()), domain->first.c_str(),
+        signature.name.c_str(), signature.domain.c_str(),
+        signature.path.c_str());
 
-    // Remove all the cookies identified by |dupes|. It is valid to delete our
-    // list of iterators one at a time, since |cookies_| is a multimap (they
-    // don't invalidate existing iterators following deletion).
+    // Remove all the cookies identified by |dupes|. The most recent one is
+    // kept, so |domain| is never left empty.
     for (CookieSet::iterator dupes_it = dupes.begin(); dupes_it != dupes.end();
          ++dupes_it) {
-      InternalDeleteCookie(*dupes_it, true,
+      InternalDeleteCookie(domain, *dupes_it, true,
                            DELETE_COOKIE_DUPLICATE_IN_BACKING_STORE);
     }
   }
@@ -1583,17 +1541,22 @@ void CookieMonster::FindCookiesForKey(const std::string& key,
                                       std::vector<CanonicalCookie*>* cookies) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
-       its.first != its.second;) {
-    CookieMap::iterator curit = its.first;
-    CanonicalCookie* cc = curit->second;
-    ++its.first;
+  CookieMap::iterator it = cookies_.find(key);
+  if (it == cookies_.end())
+    return;
+
+  // The cookies of the key are already sorted by CookieSorter, so the matching
+  // ones are found in the order in which they are sent.
+  CookieDomain* domain = &*it;
+  for (size_t i = 0; i < domain->second.size();) {
+    CanonicalCookie* cc = domain->second[i];
 
     // If the cookie is expired, delete it.
     if (cc->IsExpired(current)) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPIRED);
+      InternalDeleteCookie(domain, cc, true, DELETE_COOKIE_EXPIRED);
       continue;
     }
+    ++i;
 
     // Filter out cookies that should not be included for a request to the
     // given |url|. HTTP only cookies are filtered depending on the passed
@@ -1608,6 +1571,7 @@ void CookieMonster::FindCookiesForKey(const std::string& key,
     }
     cookies->push_back(cc);
   }
+  EraseDomainIfEmpty(domain);
 }
 
 bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
@@ -1624,12 +1588,13 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
 
   histogram_cookie_delete_equivalent_->Add(COOKIE_DELETE_EQUIVALENT_ATTEMPT);
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
-       its.first != its.second;) {
-    CookieMap::iterator curit = its.first;
-    CanonicalCookie* cc = curit->second;
-    ++its.first;
+  CookieMap::iterator it = cookies_.find(key);
+  if (it == cookies_.end())
+    return false;
 
+  // The equivalent cookie is deleted once the others have been checked.
+  CanonicalCookie* cookie_to_delete = nullptr;
+  for (CanonicalCookie* cc : it->second) {
     // If strict secure cookies is being enforced, then the equivalency
     // requirements are looser. If the cookie is being set from an insecure
     // scheme, then if a cookie already exists with the same name and it is
@@ -1666,17 +1631,23 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
       } else {
         histogram_cookie_delete_equivalent_->Add(
             COOKIE_DELETE_EQUIVALENT_FOUND);
-        InternalDeleteCookie(curit, true, already_expired
-                                              ? DELETE_COOKIE_EXPIRED_OVERWRITE
-                                              : DELETE_COOKIE_OVERWRITE);
+        cookie_to_delete = cc;
       }
       found_equivalent_cookie = true;
     }
   }
+
+  // |it| may be left empty, for SetCanonicalCookie() to fill it again. It is
+  // removed by GarbageCollect() otherwise.
+  if (cookie_to_delete) {
+    InternalDeleteCookie(&*it, cookie_to_delete, true,
+                         already_expired ? DELETE_COOKIE_EXPIRED_OVERWRITE
+                                         : DELETE_COOKIE_OVERWRITE);
+  }
   return skipped_httponly || skipped_secure_cookie;
 }
 
-CookieMonster::CookieMap::iterator CookieMonster::InternalInsertCookie(
+CookieMonster::CookieDomain* CookieMonster::InternalInsertCookie(
     const std::string& key,
     CanonicalCookie* cc,
     const GURL& source_url,
@@ -1691,8 +1662,18 @@ CookieMonster::CookieMap::iterator CookieMonster::InternalInsertCookie(
   if ((cc->IsPersistent() || persist_session_cookies_) && store_.get() &&
       sync_to_store)
     store_->AddCookie(*cc);
-  CookieMap::iterator inserted =
-      cookies_.insert(CookieMap::value_type(key, cc));
+  CookieMap::iterator it = cookies_.find(key);
+  if (it == cookies_.end())
+    it = cookies_.insert(CookieMap::value_type(key, CanonicalCookieVector()))
+             .first;
+  CookieDomain* domain = &*it;
+  domain->second.insert(std::upper_bound(domain->second.begin(),
+                                         domain->second.end(), cc,
+                                         CookieSorter),
+                        cc);
+  lra_cookies_.insert(std::make_pair(cc, domain));
+  if (cc->IsPersistent() && cc->ExpiryDate() < earliest_expiry_time_)
+    earliest_expiry_time_ = cc->ExpiryDate();
   if (delegate_.get()) {
     delegate_->OnCookieChanged(*cc, false,
                                CookieMonsterDelegate::CHANGE_COOKIE_EXPLICIT);
@@ -1728,7 +1709,7 @@ CookieMonster::CookieMap::iterator CookieMonster::InternalInsertCookie(
 
   RunCookieChangedCallbacks(*cc, false);
 
-  return inserted;
+  return domain;
 }
 
 bool CookieMonster::SetCookieWithCreationTimeAndOptions(
@@ -1836,14 +1817,19 @@ void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc,
   if ((current - cc->LastAccessDate()) < last_access_threshold_)
     return;
 
+  // Move the cookie to its new place in |lra_cookies_|.
+  LRACookieMap::iterator it = lra_cookies_.find(cc);
+  DCHECK(it != lra_cookies_.end());
+  CookieDomain* domain = it->second;
+  lra_cookies_.erase(it);
   cc->SetLastAccessDate(current);
+  lra_cookies_.insert(std::make_pair(cc, domain));
   if ((cc->IsPersistent() || persist_session_cookies_) && store_.get())
     store_->UpdateCookieAccessTime(*cc);
 }
 
-// InternalDeleteCookies must not invalidate iterators other than the one being
-// deleted.
-void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
+void CookieMonster::InternalDeleteCookie(CookieDomain* domain,
+                                         CanonicalCookie* cc,
                                          bool sync_to_store,
                                          DeletionCause deletion_cause) {
   DCHECK(thread_checker_.CalledOnValidThread());
@@ -1858,7 +1844,6 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
   if (deletion_cause != DELETE_COOKIE_DONT_RECORD)
     histogram_cookie_deletion_cause_->Add(deletion_cause);
 
-  CanonicalCookie* cc = it->second;
   VLOG(kVlogSetCookies) << "InternalDeleteCookie()"
                         << ", cause:" << deletion_cause
                         << ", cc: " << cc->DebugString();
@@ -1873,10 +1858,28 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
       delegate_->OnCookieChanged(*cc, true, mapping.cause);
   }
   RunCookieChangedCallbacks(*cc, true);
-  cookies_.erase(it);
+
+  // The cookies of |domain| are sorted by CookieSorter, so |cc| is among the
+  // few with its path length and creation date.
+  CanonicalCookieVector& cookies = domain->second;
+  std::pair<CanonicalCookieVector::iterator, CanonicalCookieVector::iterator>
+      range = std::equal_range(cookies.begin(), cookies.end(), cc,
+                               CookieSorter);
+  CanonicalCookieVector::iterator it =
+      std::find(range.first, range.second, cc);
+  DCHECK(it != range.second);
+  cookies.erase(it);
+  lra_cookies_.erase(cc);
   delete cc;
 }
 
+void CookieMonster::EraseDomainIfEmpty(CookieDomain* domain) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+
+  if (domain->second.empty())
+    cookies_.erase(cookies_.find(domain->first));
+}
+
 // Domain expiry behavior is unchanged by key/expiry scheme (the
 // meaning of the key is different, but that's not visible to this routine).
 size_t CookieMonster::GarbageCollect(const Time& current,
@@ -1887,16 +1890,18 @@ size_t CookieMonster::GarbageCollect(const Time& current,
   size_t num_deleted = 0;
   Time safe_date(Time::Now() - TimeDelta::FromDays(kSafeFromGlobalPurgeDays));
 
+  CookieMap::iterator it = cookies_.find(key);
+  CookieDomain* domain = it != cookies_.end() ? &*it : nullptr;
+
   // Collect garbage for this key, minding cookie priorities.
-  if (cookies_.count(key) > kDomainMaxCookies) {
+  if (domain && domain->second.size() > kDomainMaxCookies) {
     VLOG(kVlogGarbageCollection) << "GarbageCollect() key: " << key;
 
-    CookieItVector* cookie_its;
+    CanonicalCookieVector* cookie_its;
 
-    CookieItVector non_expired_cookie_its;
+    CanonicalCookieVector non_expired_cookie_its;
     cookie_its = &non_expired_cookie_its;
-    num_deleted +=
-        GarbageCollectExpired(current, cookies_.equal_range(key), cookie_its);
+    num_deleted += GarbageCollectExpired(current, domain, cookie_its);
 
     if (cookie_its->size() > kDomainMaxCookies) {
       VLOG(kVlogGarbageCollection) << "Deep Garbage Collect domain.";
@@ -1969,7 +1974,7 @@ size_t CookieMonster::GarbageCollect(const Time& current,
         // initial non-secure purge did not evict enough cookies.
         if (purge_goal > 0) {
           just_deleted = PurgeLeastRecentMatches(
-              cookie_its, purge_round.priority, quota, purge_goal,
+              domain, cookie_its, purge_round.priority, quota, purge_goal,
               purge_round.protect_secure_cookies);
           DCHECK_LE(just_deleted, purge_goal);
           purge_goal -= just_deleted;
@@ -1981,42 +1986,38 @@ size_t CookieMonster::GarbageCollect(const Time& current,
     }
   }
 
+  // The key may have been emptied by the setting of an expired cookie, or by
+  // the collection of expired cookies.
+  if (domain)
+    EraseDomainIfEmpty(domain);
+
   // Collect garbage for everything. With firefox style we want to preserve
   // cookies accessed in kSafeFromGlobalPurgeDays, otherwise evict.
-  if (cookies_.size() > kMaxCookies && earliest_access_time_ < safe_date) {
+  if (lra_cookies_.size() > kMaxCookies &&
+      lra_cookies_.begin()->first->LastAccessDate() < safe_date) {
     VLOG(kVlogGarbageCollection) << "GarbageCollect() everything";
-    CookieItVector cookie_its;
 
-    num_deleted += GarbageCollectExpired(
-        current, CookieMapItPair(cookies_.begin(), cookies_.end()),
-        &cookie_its);
+    num_deleted += GarbageCollectAllExpired(current);
 
-    if (cookie_its.size() > kMaxCookies) {
+    if (lra_cookies_.size() > kMaxCookies) {
       VLOG(kVlogGarbageCollection) << "Deep Garbage Collect everything.";
-      size_t purge_goal = cookie_its.size() - (kMaxCookies - kPurgeCookies);
+      size_t purge_goal = lra_cookies_.size() - (kMaxCookies - kPurgeCookies);
       DCHECK(purge_goal > kPurgeCookies);
 
       if (enforce_strict_secure) {
-        CookieItVector secure_cookie_its;
-        CookieItVector non_secure_cookie_its;
-        SplitCookieVectorIntoSecureAndNonSecure(cookie_its, &secure_cookie_its,
-                                                &non_secure_cookie_its);
-        size_t non_secure_purge_goal =
-            std::min<size_t>(purge_goal, non_secure_cookie_its.size() - 1);
-
         size_t just_deleted = GarbageCollectLeastRecentlyAccessed(
-            current, safe_date, non_secure_purge_goal, non_secure_cookie_its);
+            current, safe_date, purge_goal, true /* skip_secure_cookies */);
         num_deleted += just_deleted;
 
+        // Only the secure cookies are left to delete.
         if (just_deleted < purge_goal) {
-          size_t secure_purge_goal = std::min<size_t>(
-              purge_goal - just_deleted, secure_cookie_its.size() - 1);
           num_deleted += GarbageCollectLeastRecentlyAccessed(
-              current, safe_date, secure_purge_goal, secure_cookie_its);
+              current, safe_date, purge_goal - just_deleted,
+              false /* skip_secure_cookies */);
         }
       } else {
         num_deleted += GarbageCollectLeastRecentlyAccessed(
-            current, safe_date, purge_goal, cookie_its);
+            current, safe_date, purge_goal, false /* skip_secure_cookies */);
       }
     }
   }
@@ -2024,7 +2025,8 @@ size_t CookieMonster::GarbageCollect(const Time& current,
   return num_deleted;
 }
 
-size_t CookieMonster::PurgeLeastRecentMatches(CookieItVector* cookies,
+size_t CookieMonster::PurgeLeastRecentMatches(CookieDomain* domain,
+                                              CanonicalCookieVector* cookies,
                                               CookiePriority priority,
                                               size_t to_protect,
                                               size_t purge_goal,
@@ -2059,12 +2061,12 @@ size_t CookieMonster::PurgeLeastRecentMatches(CookieItVector* cookies,
   size_t current = 0u;
   while ((removed < purge_goal && current < cookies->size()) &&
          cookies_count_possibly_to_be_deleted > 0) {
-    const CanonicalCookie* current_cookie = cookies->at(current)->second;
+    CanonicalCookie* current_cookie = cookies->at(current);
     // Only delete the current cookie if the priority is equal to
     // the current level.
     if (IsCookieEligibleForEviction(priority, protect_secure_cookies,
                                     current_cookie)) {
-      InternalDeleteCookie(cookies->at(current), true,
+      InternalDeleteCookie(domain, current_cookie, true,
                            DELETE_COOKIE_EVICTED_DOMAIN);
       cookies->erase(cookies->begin() + current);
       removed++;
@@ -2077,62 +2079,71 @@ size_t CookieMonster::PurgeLeastRecentMatches(CookieItVector* cookies,
 }
 
 size_t CookieMonster::GarbageCollectExpired(const Time& current,
-                                            const CookieMapItPair& itpair,
-                                            CookieItVector* cookie_its) {
+                                            CookieDomain* domain,
+                                            CanonicalCookieVector* cookies) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = itpair.first, end = itpair.second; it != end;) {
-    CookieMap::iterator curit = it;
-    ++it;
+  for (size_t i = 0; i < domain->second.size();) {
+    CanonicalCookie* cc = domain->second[i];
 
-    if (curit->second->IsExpired(current)) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPIRED);
+    if (cc->IsExpired(current)) {
+      InternalDeleteCookie(domain, cc, true, DELETE_COOKIE_EXPIRED);
       ++num_deleted;
-    } else if (cookie_its) {
-      cookie_its->push_back(curit);
+    } else {
+      if (cookies)
+        cookies->push_back(cc);
+      ++i;
     }
   }
 
   return num_deleted;
 }
 
-size_t CookieMonster::GarbageCollectDeleteRange(
-    const Time& current,
-    DeletionCause cause,
-    CookieItVector::iterator it_begin,
-    CookieItVector::iterator it_end) {
+size_t CookieMonster::GarbageCollectAllExpired(const Time& current) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
-  for (CookieItVector::iterator it = it_begin; it != it_end; it++) {
-    histogram_evicted_last_access_minutes_->Add(
-        (current - (*it)->second->LastAccessDate()).InMinutes());
-    InternalDeleteCookie((*it), true, cause);
+  if (current < earliest_expiry_time_)
+    return 0;
+
+  size_t num_deleted = 0;
+  Time earliest_expiry_time = Time::Max();
+  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
+    num_deleted += GarbageCollectExpired(current, &*it, nullptr);
+    for (const CanonicalCookie* cc : it->second) {
+      if (cc->IsPersistent() && cc->ExpiryDate() < earliest_expiry_time)
+        earliest_expiry_time = cc->ExpiryDate();
+    }
+    it = it->second.empty() ? cookies_.erase(it) : std::next(it);
   }
-  return it_end - it_begin;
+  earliest_expiry_time_ = earliest_expiry_time;
+
+  return num_deleted;
 }
 
 size_t CookieMonster::GarbageCollectLeastRecentlyAccessed(
     const base::Time& current,
     const base::Time& safe_date,
     size_t purge_goal,
-    CookieItVector cookie_its) {
+    bool skip_secure_cookies) {
   DCHECK(thread_checker_.CalledOnValidThread());
 
-  // Sorts up to *and including* |cookie_its[purge_goal]|, so
-  // |earliest_access_time| will be properly assigned even if
-  // |global_purge_it| == |cookie_its.begin() + purge_goal|.
-  SortLeastRecentlyAccessed(cookie_its.begin(), cookie_its.end(), purge_goal);
-  // Find boundary to cookies older than safe_date.
-  CookieItVector::iterator global_purge_it = LowerBoundAccessDate(
-      cookie_its.begin(), cookie_its.begin() + purge_goal, safe_date);
-  // Only delete the old cookies, and if strict secure is enabled, delete
-  // non-secure ones first.
-  size_t num_deleted =
-      GarbageCollectDeleteRange(current, DELETE_COOKIE_EVICTED_GLOBAL,
-                                cookie_its.begin(), global_purge_it);
-  // Set access day to the oldest cookie that wasn't deleted.
-  earliest_access_time_ = (*global_purge_it)->second->LastAccessDate();
+  size_t num_deleted = 0;
+  LRACookieMap::iterator it = lra_cookies_.begin();
+  while (num_deleted < purge_goal && it != lra_cookies_.end() &&
+         it->first->LastAccessDate() < safe_date) {
+    CanonicalCookie* cc = it->first;
+    CookieDomain* domain = it->second;
+    ++it;
+    if (skip_secure_cookies && cc->IsSecure())
+      continue;
+
+    histogram_evicted_last_access_minutes_->Add(
+        (current - cc->LastAccessDate()).InMinutes());
+    InternalDeleteCookie(domain, cc, true, DELETE_COOKIE_EVICTED_GLOBAL);
+    EraseDomainIfEmpty(domain);
+    ++num_deleted;
+  }
   return num_deleted;
 }
 
@@ -2212,7 +2223,7 @@ void CookieMonster::RecordPeriodicStats(const base::Time& current_time) {
   }
 
   // See InitializeHistograms() for details.
-  histogram_count_->Add(cookies_.size());
+  histogram_count_->Add(lra_cookies_.size());
 
   // More detailed statistics on cookie counts at different granularities.
   last_statistic_record_time_ = current_time;
@@ -16,6 +16,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -79,7 +80,7 @@ class NET_EXPORT CookieMonster : public CookieStore {
   //      administrative control.
 
   // CookieMap is the central data structure of the CookieMonster.  It
-  // is a map whose values are pointers to CanonicalCookie data
+  // is a map whose values are vectors of pointers to CanonicalCookie data
   // structures (the data structures are owned by the CookieMonster
   // and must be destroyed when removed from the map).  The key is based on the
   // effective domain of the cookies.  If the domain of the cookie has an
@@ -88,19 +89,28 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // not legal to have domain cookies without an eTLD+1).  This rule
   // excludes cookies for, e.g, ".com", ".co.uk", or ".internalnetwork".
   // This behavior is the same as the behavior in Firefox v 3.6.10.
+  //
+  // The cookies of a key are kept in the order in which they are sent to
+  // servers: longest path first, then oldest first (see CookieSorter() in
+  // cookie_monster.cc). A request only looks up the cookies of its key, and
+  // gets them already sorted. Keys without cookies are removed from the map.
+  typedef std::vector<CanonicalCookie*> CanonicalCookieVector;
+  typedef std::unordered_map<std::string, CanonicalCookieVector> CookieMap;
+
+  // An entry of CookieMap. Pointers to entries remain valid until they are
+  // removed from the map.
+  typedef CookieMap::value_type CookieDomain;
+
+  // Orders cookies from least to most recently accessed.
+  struct LRACookieLess {
+    bool operator()(const CanonicalCookie* cc1,
+                    const CanonicalCookie* cc2) const;
+  };
 
-  // NOTE(deanm):
-  // I benchmarked hash_multimap vs multimap.  We're going to be query-heavy
-  // so it would seem like hashing would help.  However they were very
-  // close, with multimap being a tiny bit faster.  I think this is because
-  // our map is at max around 1000 entries, and the additional complexity
-  // for the hashing might not overcome the O(log(1000)) for querying
-  // a multimap.  Also, multimap is standard, another reason to use it.
-  // TODO(rdsmith): This benchmark should be re-done now that we're allowing
-  // subtantially more entries in the map.
-  typedef std::multimap<std::string, CanonicalCookie*> CookieMap;
-  typedef std::pair<CookieMap::iterator, CookieMap::iterator> CookieMapItPair;
-  typedef std::vector<CookieMap::iterator> CookieItVector;
+  // All the cookies, from least to most recently accessed, with their entry in
+  // the CookieMap. Global garbage collection evicts cookies from the front.
+  typedef std::map<CanonicalCookie*, CookieDomain*, LRACookieLess>
+      LRACookieMap;
 
   // Cookie garbage collection thresholds.  Based off of the Mozilla defaults.
   // When the number of cookies gets to k{Domain,}MaxCookies
@@ -471,11 +481,9 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // inconsistencies. (In other words, it does not have duplicate cookies).
   void EnsureCookiesMapIsValid();
 
-  // Checks for any duplicate cookies for CookieMap key |key| which lie between
-  // |begin| and |end|. If any are found, all but the most recent are deleted.
-  void TrimDuplicateCookiesForKey(const std::string& key,
-                                  CookieMap::iterator begin,
-                                  CookieMap::iterator end);
+  // Checks for any duplicate cookies in |domain|. If any are found, all but
+  // the most recent are deleted.
+  void TrimDuplicateCookiesForKey(CookieDomain* domain);
 
   void SetDefaultCookieableSchemes();
 
@@ -505,12 +513,12 @@ class NET_EXPORT CookieMonster : public CookieStore {
                                  bool already_expired,
                                  bool enforce_strict_secure);
 
-  // Takes ownership of *cc. Returns an iterator that points to the inserted
-  // cookie in cookies_. Guarantee: all iterators to cookies_ remain valid.
-  CookieMap::iterator InternalInsertCookie(const std::string& key,
-                                           CanonicalCookie* cc,
-                                           const GURL& source_url,
-                                           bool sync_to_store);
+  // Takes ownership of *cc. Returns the entry of cookies_ where the cookie was
+  // inserted.
+  CookieDomain* InternalInsertCookie(const std::string& key,
+                                     CanonicalCookie* cc,
+                                     const GURL& source_url,
+                                     bool sync_to_store);
 
   // Helper function that sets cookies with more control.
   // Not exposed as we don't want callers to have the ability
@@ -533,14 +541,20 @@ class NET_EXPORT CookieMonster : public CookieStore {
   void InternalUpdateCookieAccessTime(CanonicalCookie* cc,
                                       const base::Time& current_time);
 
+  // Deletes |cc|, which must be one of the cookies of |domain|. The cookies of
+  // |domain| which followed |cc| move down by one. |domain| is left in
+  // cookies_, even if it has no cookies left; see EraseDomainIfEmpty().
   // |deletion_cause| argument is used for collecting statistics and choosing
   // the correct CookieMonsterDelegate::ChangeCause for OnCookieChanged
-  // notifications.  Guarantee: All iterators to cookies_ except to the
-  // deleted entry remain vaild.
-  void InternalDeleteCookie(CookieMap::iterator it,
+  // notifications.
+  void InternalDeleteCookie(CookieDomain* domain,
+                            CanonicalCookie* cc,
                             bool sync_to_store,
                             DeletionCause deletion_cause);
 
+  // Removes |domain| from cookies_ if it has no cookies left.
+  void EraseDomainIfEmpty(CookieDomain* domain);
+
   // If the number of cookies for CookieMap key |key|, or globally, are
   // over the preset maximums above, garbage collect, first for the host and
   // then globally.  See comments above garbage collection threshold
@@ -557,38 +571,40 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // |protected_secure_cookies| specifies whether or not secure cookies should
   // be protected from deletion.
   //
-  // |cookies| must be sorted from least-recent to most-recent.
+  // |cookies| must be cookies of |domain|, sorted from least-recent to
+  // most-recent.
   //
   // Returns the number of cookies deleted.
-  size_t PurgeLeastRecentMatches(CookieItVector* cookies,
+  size_t PurgeLeastRecentMatches(CookieDomain* domain,
+                                 CanonicalCookieVector* cookies,
                                  CookiePriority priority,
                                  size_t to_protect,
                                  size_t purge_goal,
                                  bool protect_secure_cookies);
 
-  // Helper for GarbageCollect(); can be called directly as well.  Deletes all
-  // expired cookies in |itpair|.  If |cookie_its| is non-NULL, all the
-  // non-expired cookies from |itpair| are appended to |cookie_its|.
+  // Helper for GarbageCollect(). Deletes all expired cookies of |domain|.  If
+  // |cookies| is non-NULL, all the non-expired cookies of |domain| are
+  // appended to |cookies|.
   //
   // Returns the number of cookies deleted.
   size_t GarbageCollectExpired(const base::Time& current,
-                               const CookieMapItPair& itpair,
-                               CookieItVector* cookie_its);
-
-  // Helper for GarbageCollect(). Deletes all cookies in the range specified by
-  // [|it_begin|, |it_end|). Returns the number of cookies deleted.
-  size_t GarbageCollectDeleteRange(const base::Time& current,
-                                   DeletionCause cause,
-                                   CookieItVector::iterator cookie_its_begin,
-                                   CookieItVector::iterator cookie_its_end);
-
-  // Helper for GarbageCollect(). Deletes cookies in |cookie_its| from least to
-  // most recently used, but only before |safe_date|. Also will stop deleting
-  // when the number of remaining cookies hits |purge_goal|.
+                               CookieDomain* domain,
+                               CanonicalCookieVector* cookies);
+
+  // Helper for GarbageCollect(); can be called directly as well.  Deletes all
+  // expired cookies, unless |earliest_expiry_time_| shows there are none.
+  //
+  // Returns the number of cookies deleted.
+  size_t GarbageCollectAllExpired(const base::Time& current);
+
+  // Helper for GarbageCollect(). Deletes cookies from least to most recently
+  // used, but only before |safe_date|. Also will stop deleting when
+  // |purge_goal| cookies have been deleted. If |skip_secure_cookies| is true,
+  // only non-secure cookies are deleted.
   size_t GarbageCollectLeastRecentlyAccessed(const base::Time& current,
                                              const base::Time& safe_date,
                                              size_t purge_goal,
-                                             CookieItVector cookie_its);
+                                             bool skip_secure_cookies);
 
   // Find the key (for lookup in cookies_) based on the given domain.
   // See comment on keys before the CookieMap typedef.
@@ -688,16 +704,18 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // update it again.
   const base::TimeDelta last_access_threshold_;
 
-  // Approximate date of access time of least recently accessed cookie
-  // in |cookies_|.  Note that this is not guaranteed to be accurate, only a)
-  // to be before or equal to the actual time, and b) to be accurate
-  // immediately after a garbage collection that scans through all the cookies.
-  // This value is used to determine whether global garbage collection might
-  // find cookies to purge.
+  // All the cookies of |cookies_|, by access date.
+  LRACookieMap lra_cookies_;
+
+  // Approximate expiry date of the first cookie of |cookies_| to expire.  Note
+  // that this is not guaranteed to be accurate, only a) to be before or equal
+  // to the actual time, and b) to be accurate immediately after
+  // GarbageCollectAllExpired() scans through all the cookies.  This value is
+  // used to skip the scan when it cannot find expired cookies.
   // Note: The default Time() constructor will create a value that compares
   // earlier than any other time value, which is wanted.  Thus this
   // value is not initialized.
-  base::Time earliest_access_time_;
+  base::Time earliest_expiry_time_;
 
   // During loading, holds the set of all loaded cookie creation times. Used to
   // avoid ever letting cookies with duplicate creation times into the store;
@@ -98,6 +98,48 @@ class GetCookiesCallback : public BaseCallback {
   CookieOptions options_;
 };
 
+// Sets, queries and deletes |num_cookies| cookies spread over domains of 50
+// cookies each, about the size of the biggest cookie stores seen in the wild.
+// Each domain has cookies on several paths, so the queries have to filter and
+// order them by path.
+void RunLargeStoreTest(const std::string& name, int num_cookies) {
+  const int kCookiesPerDomain = 50;
+  std::unique_ptr<CookieMonster> cm(new CookieMonster(nullptr, nullptr));
+  SetCookieCallback setCookieCallback;
+  GetCookiesCallback getCookiesCallback;
+  std::vector<GURL> gurls;
+  for (int i = 0; i < num_cookies / kCookiesPerDomain; ++i) {
+    gurls.push_back(
+        GURL(base::StringPrintf("https://www.domain%06d.izzle/a/b/c", i)));
+  }
+
+  base::PerfTimeLogger timer(("Cookie_monster_add_" + name).c_str());
+  for (int cookie_num = 0; cookie_num < kCookiesPerDomain; ++cookie_num) {
+    const std::string cookie_line = base::StringPrintf(
+        "c%02d=1; path=/%s", cookie_num,
+        cookie_num % 3 == 0 ? "" : cookie_num % 3 == 1 ? "a" : "a/b");
+    for (std::vector<GURL>::const_iterator it = gurls.begin();
+         it != gurls.end(); ++it) {
+      setCookieCallback.SetCookie(cm.get(), *it, cookie_line);
+    }
+  }
+  timer.Done();
+
+  const std::string cookie_line =
+      getCookiesCallback.GetCookies(cm.get(), gurls[0]);
+  EXPECT_EQ(kCookiesPerDomain, CountInString(cookie_line, '='));
+
+  base::PerfTimeLogger timer2(("Cookie_monster_query_" + name).c_str());
+  for (int i = 0; i < kNumCookies; ++i)
+    getCookiesCallback.GetCookies(cm.get(), gurls[i % gurls.size()]);
+  timer2.Done();
+
+  base::PerfTimeLogger timer3(("Cookie_monster_deleteall_" + name).c_str());
+  cm->DeleteAllAsync(CookieMonster::DeleteCallback());
+  base::RunLoop().RunUntilIdle();
+  timer3.Done();
+}
+
 }  // namespace
 
 TEST(ParsedCookieTest, TestParseCookies) {
@@ -323,6 +365,14 @@ TEST_F(CookieMonsterTest, TestGetKey) {
   timer.Done();
 }
 
+TEST_F(CookieMonsterTest, TestLargeStore10K) {
+  RunLargeStoreTest("10K", 10000);
+}
+
+TEST_F(CookieMonsterTest, TestLargeStore100K) {
+  RunLargeStoreTest("100K", 100000);
+}
+
 // This test is probing for whether garbage collection happens when it
 // shouldn't.  This will not in general be visible functionally, since
 // if GC runs twice in a row without any change to the store, the second
@@ -363,6 +413,17 @@ TEST_F(CookieMonsterTest, TestGCTimes) {
        CookieMonster::kMaxCookies * 2,
        CookieMonster::kMaxCookies * 3 / 4,
       },
+      {
+       // A large store with enough old cookies to be purged.
+       "10K_mostly_old",
+       10000,
+       8000,
+      },
+      {
+       "100K_mostly_old",
+       100000,
+       80000,
+      },
       {
        "less_than_gc_thresh",
        // Few enough cookies that gc shouldn't happen at all.
@@ -29,6 +29,7 @@
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
@@ -772,6 +773,47 @@ TEST_F(DiskCacheTest, TruncatedIndex) {
 }
 #endif
 
+// Tests that the cache creator wraps the simple cache backend in a hybrid one.
+TEST_F(DiskCacheTest, CreateHybridBackend) {
+  ASSERT_TRUE(CleanupCacheDir());
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+  net::TestCompletionCallback cb;
+
+  std::unique_ptr<disk_cache::Backend> backend;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                          net::CACHE_BACKEND_HYBRID,
+                                          cache_path_,
+                                          0,
+                                          false,
+                                          cache_thread.task_runner(),
+                                          NULL,
+                                          &backend,
+                                          cb.callback());
+  ASSERT_THAT(cb.GetResult(rv), IsOk());
+  ASSERT_TRUE(backend);
+
+  base::StringPairs stats;
+  backend->GetStats(&stats);
+  bool has_memory_tier = false;
+  for (const auto& stat : stats)
+    has_memory_tier |= stat.first == "Memory tier size";
+  EXPECT_TRUE(has_memory_tier);
+
+  disk_cache::Entry* entry;
+  rv = backend->CreateEntry("key", &entry, cb.callback());
+  ASSERT_THAT(cb.GetResult(rv), IsOk());
+  entry->Close();
+  rv = backend->OpenEntry("key", &entry, cb.callback());
+  ASSERT_THAT(cb.GetResult(rv), IsOk());
+  entry->Close();
+
+  backend.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+}
+
 void DiskCacheBackendTest::BackendSetSize() {
   const int cache_size = 0x10000;  // 64 kB
   SetMaxSize(cache_size);
@@ -3813,3 +3855,240 @@ TEST_F(DiskCacheBackendTest, SimpleCacheLateDoom) {
   EXPECT_EQ(disk_cache::SimpleIndex::INITIALIZE_METHOD_LOADED,
             simple_cache_impl_->index()->init_method());
 }
+
+// Tests that a sharded Simple Cache routes every entry to the directory of its
+// shard, and finds all of them again after a restart.
+TEST_F(DiskCacheBackendTest, SimpleCacheShardedBasics) {
+  const int kNumShards = 4;
+  SetSimpleCacheMode();
+  SetSimpleCacheShards(kNumShards);
+  InitCache();
+  std::set<std::string> key_pool;
+  ASSERT_TRUE(CreateSetOfRandomEntries(&key_pool));
+  EXPECT_EQ(static_cast<int>(key_pool.size()), cache_->GetEntryCount());
+
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  for (const std::string& key : key_pool) {
+    const int shard = static_cast<int>(
+        disk_cache::simple_util::GetEntryHashKey(key) % kNumShards);
+    const base::FilePath shard_path =
+        cache_path_.AppendASCII(base::StringPrintf("shard-%d", shard));
+    EXPECT_TRUE(base::PathExists(shard_path.AppendASCII(
+        disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0))));
+  }
+  EXPECT_FALSE(base::PathExists(cache_path_.AppendASCII("index")));
+
+  // Let the shutdown index writes land before loading the indexes again.
+  cache_.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(static_cast<int>(key_pool.size()), cache_->GetEntryCount());
+
+  std::set<std::string> keys_to_match(key_pool);
+  std::unique_ptr<TestIterator> iter = CreateIterator();
+  size_t count = 0;
+  ASSERT_TRUE(EnumerateAndMatchKeys(-1, iter.get(), &keys_to_match, &count));
+  iter.reset();
+  EXPECT_EQ(key_pool.size(), count);
+  EXPECT_TRUE(keys_to_match.empty());
+
+  ASSERT_THAT(DoomAllEntries(), IsOk());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  disk_cache::Entry* entry;
+  for (const std::string& key : key_pool)
+    EXPECT_THAT(OpenEntry(key, &entry), IsError(net::ERR_FAILED));
+}
+
+// Tests that the Simple Cache refuses to open a cache directory created with
+// a different number of shards.
+TEST_F(DiskCacheBackendTest, SimpleCacheShardCountMismatch) {
+  SetSimpleCacheMode();
+  SetSimpleCacheShards(4);
+  InitCache();
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("key", &entry), IsOk());
+  entry->Close();
+  cache_.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+  const int kOtherShardCounts[] = {1, 2, 8};
+  for (int num_shards : kOtherShardCounts) {
+    std::unique_ptr<disk_cache::SimpleBackendImpl> simple_cache(
+        new disk_cache::SimpleBackendImpl(cache_path_, 0, net::DISK_CACHE,
+                                          cache_thread.task_runner(), NULL));
+    ASSERT_TRUE(simple_cache->SetNumShards(num_shards));
+    net::TestCompletionCallback cb;
+    int rv = simple_cache->Init(cb.callback());
+    EXPECT_NE(net::OK, cb.GetResult(rv)) << num_shards;
+  }
+
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(1, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCacheBackendTest, HybridBasics) {
+  SetHybridMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridBasics) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridKeying) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  BackendKeying();
+}
+
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridDoomAll) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  BackendDoomAll();
+}
+
+// Tests that an entry kept in the memory tier of the hybrid backend is opened
+// and read without waiting for the disk backend.
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridMemoryHit) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  InitCache();
+
+  const int kSize = 200;
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("key", &entry), IsOk());
+  EXPECT_EQ(kSize, entry->WriteData(0, 0, buffer1.get(), kSize,
+                                    net::CompletionCallback(), false));
+  entry->Close();
+
+  // No callback is given, so anything but a synchronous result would fail.
+  entry = nullptr;
+  ASSERT_THAT(
+      cache_->OpenEntry("key", &entry, net::CompletionCallback()), IsOk());
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(kSize, entry->GetDataSize(0));
+  EXPECT_EQ(kSize, entry->ReadData(0, 0, buffer2.get(), kSize,
+                                   net::CompletionCallback()));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+
+  EXPECT_LT(0, hybrid_cache_impl_->memory_size());
+  base::StringPairs stats;
+  cache_->GetStats(&stats);
+  bool found_hits = false;
+  for (const auto& stat : stats) {
+    if (stat.first == "Memory tier hits") {
+      EXPECT_EQ("1", stat.second);
+      found_hits = true;
+    }
+  }
+  EXPECT_TRUE(found_hits);
+}
+
+// Tests that the data written through the hybrid backend reaches the disk
+// backend, both for the entries evicted from the memory tier and for those
+// still in it when the backend is destroyed.
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridWriteBack) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  InitCache();
+
+  const int kSize = 1000;
+  const int kNumEntries = 20;
+  // Room for a few entries only.
+  ASSERT_TRUE(hybrid_cache_impl_->SetMaxSize(8 * kSize));
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("key %d", i);
+    ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+    CacheTestFillBuffer(buffer->data(), kSize, false);
+    base::strlcpy(buffer->data(), key.c_str(), kSize);
+    EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer.get(), kSize, false));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+  }
+  EXPECT_GE(8 * kSize, hybrid_cache_impl_->memory_size());
+
+  cache_.reset();
+  hybrid_cache_impl_ = nullptr;
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  SetHybridMode();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("key %d", i);
+    ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+    for (int index = 0; index < 2; ++index) {
+      ASSERT_EQ(kSize, entry->GetDataSize(index));
+      EXPECT_EQ(kSize, ReadData(entry, index, 0, buffer.get(), kSize));
+      EXPECT_STREQ(key.c_str(), buffer->data());
+    }
+    entry->Close();
+  }
+}
+
+// Tests that an entry evicted by the disk backend while still in the memory
+// tier of the hybrid backend is not opened if a stream of it is on disk only,
+// and that a write to it fails rather than being lost.
+TEST_F(DiskCacheBackendTest, SimpleCacheHybridDiskEviction) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  InitCache();
+
+  const int kSize = 1000;
+  // Streams larger than kSize are not kept in memory.
+  ASSERT_TRUE(hybrid_cache_impl_->SetMaxSize(8 * kSize));
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(2 * kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), 2 * kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("in memory", &entry), IsOk());
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer1.get(), kSize, false));
+  entry->Close();
+  ASSERT_THAT(CreateEntry("on disk", &entry), IsOk());
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer1.get(), kSize, false));
+  EXPECT_EQ(2 * kSize,
+            WriteData(entry, 1, 0, buffer1.get(), 2 * kSize, false));
+  entry->Close();
+
+  // Evict both entries from the disk backend only.
+  net::TestCompletionCallback cb;
+  disk_cache::Backend* disk_backend = hybrid_cache_impl_->disk_backend();
+  EXPECT_THAT(cb.GetResult(disk_backend->DoomEntry("in memory", cb.callback())),
+              IsOk());
+  EXPECT_THAT(cb.GetResult(disk_backend->DoomEntry("on disk", cb.callback())),
+              IsOk());
+
+  EXPECT_THAT(OpenEntry("on disk", &entry), IsError(net::ERR_FAILED));
+
+  // The streams in memory can still be read, but the data written is not
+  // reported as written.
+  ASSERT_THAT(OpenEntry("in memory", &entry), IsOk());
+  EXPECT_EQ(kSize, ReadData(entry, 0, 0, buffer2.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  EXPECT_GT(0, WriteData(entry, 0, 0, buffer1.get(), kSize, false));
+  entry->Close();
+
+  EXPECT_THAT(OpenEntry("in memory", &entry), IsError(net::ERR_FAILED));
+  EXPECT_EQ(0, hybrid_cache_impl_->memory_size());
+}
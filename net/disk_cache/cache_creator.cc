@@ -14,6 +14,7 @@
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 
@@ -99,6 +100,7 @@ int CacheCreator::Run() {
   static const bool kSimpleBackendIsDefault = false;
 #endif
   if (backend_type_ == net::CACHE_BACKEND_SIMPLE ||
+      backend_type_ == net::CACHE_BACKEND_HYBRID ||
       (backend_type_ == net::CACHE_BACKEND_DEFAULT &&
        kSimpleBackendIsDefault)) {
     disk_cache::SimpleBackendImpl* simple_cache =
@@ -129,6 +131,11 @@ int CacheCreator::Run() {
 void CacheCreator::DoCallback(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
   if (result == net::OK) {
+    // The memory tier of a hybrid cache gets its default size.
+    if (backend_type_ == net::CACHE_BACKEND_HYBRID) {
+      created_cache_.reset(
+          new disk_cache::HybridBackendImpl(std::move(created_cache_), 0));
+    }
     *backend_ = std::move(created_cache_);
   } else {
     LOG(ERROR) << "Unable to create cache";
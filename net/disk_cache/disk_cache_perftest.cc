@@ -12,10 +12,13 @@
 #include "base/hash.h"
 #include "base/process/process_metrics.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
+#include "base/test/perf_log.h"
 #include "base/test/perf_time_logger.h"
 #include "base/test/test_file_util.h"
 #include "base/threading/thread.h"
+#include "base/threading/thread_task_runner_handle.h"
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
@@ -25,7 +28,11 @@
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -73,10 +80,12 @@ class DiskCachePerfTest : public DiskCacheTestWithCache {
   // Helper methods for constructing tests.
   bool TimeWrite();
   bool TimeRead(WhatToRead what_to_read, const char* timer_message);
+  bool TimeHotSetRead();
   void ResetAndEvictSystemDiskCache();
 
   // Complete perf tests.
   void CacheBackendPerformance();
+  void HotSetPerformance();
 
   const size_t kFdLimitForCacheTests = 8192;
 
@@ -84,6 +93,10 @@ class DiskCachePerfTest : public DiskCacheTestWithCache {
   const int kHeadersSize = 800;
   const int kBodySize = 256 * 1024 - 1;
 
+  // The first kHotSetSize entries are read kHotSetRounds times over.
+  const int kHotSetSize = 100;
+  const int kHotSetRounds = 20;
+
   std::vector<TestEntry> entries_;
 
  private:
@@ -195,6 +208,42 @@ bool DiskCachePerfTest::TimeRead(WhatToRead what_to_read,
   return (expected == helper.callbacks_called());
 }
 
+// Reads the metadata of the hot set of entries over and over, the way the
+// headers of the resources of a page are read each time it is loaded.
+bool DiskCachePerfTest::TimeHotSetRead() {
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kHeadersSize));
+
+  int expected = 0;
+
+  MessageLoopHelper helper;
+  CallbackTest callback(&helper, true);
+
+  base::PerfTimeLogger timer("Read hot set of disk cache headers");
+
+  for (int round = 0; round < kHotSetRounds; round++) {
+    for (int i = 0; i < kHotSetSize; i++) {
+      disk_cache::Entry* cache_entry;
+      net::TestCompletionCallback cb;
+      int rv = cache_->OpenEntry(entries_[i].key, &cache_entry, cb.callback());
+      if (net::OK != cb.GetResult(rv))
+        return false;
+      int ret = cache_entry->ReadData(
+          0, 0, buffer.get(), kHeadersSize,
+          base::Bind(&CallbackTest::Run, base::Unretained(&callback)));
+      cache_entry->Close();
+      if (net::ERR_IO_PENDING == ret)
+        expected++;
+      else if (kHeadersSize != ret)
+        return false;
+    }
+  }
+
+  helper.WaitUntilCacheIoFinished(expected);
+  timer.Done();
+
+  return (expected == helper.callbacks_called());
+}
+
 TEST_F(DiskCachePerfTest, BlockfileHashes) {
   int seed = static_cast<int>(Time::Now().ToInternalValue());
   srand(seed);
@@ -222,9 +271,11 @@ void DiskCachePerfTest::ResetAndEvictSystemDiskCache() {
 #if defined(OS_LINUX)
   // And, cache directories, on platforms where the eviction utility supports
   // this (currently Linux only).
-  if (simple_cache_mode_) {
-    ASSERT_TRUE(
-        base::EvictFileFromSystemCache(cache_path_.AppendASCII("index-dir")));
+  base::FileEnumerator dir_enumerator(cache_path_, true /* recursive */,
+                                      base::FileEnumerator::DIRECTORIES);
+  for (base::FilePath dir_path = dir_enumerator.Next(); !dir_path.empty();
+       dir_path = dir_enumerator.Next()) {
+    ASSERT_TRUE(base::EvictFileFromSystemCache(dir_path));
   }
   ASSERT_TRUE(base::EvictFileFromSystemCache(cache_path_));
 #endif
@@ -268,6 +319,132 @@ TEST_F(DiskCachePerfTest, SimpleCacheBackendPerformance) {
   CacheBackendPerformance();
 }
 
+// Compares the latency of reading the hot set from the disk backends alone and
+// through the memory tier of the hybrid backend, and what the latter costs in
+// resident memory.
+void DiskCachePerfTest::HotSetPerformance() {
+  std::unique_ptr<base::ProcessMetrics> metrics =
+      base::ProcessMetrics::CreateCurrentProcessMetrics();
+  const size_t initial_working_set = metrics->GetWorkingSetSize();
+
+  InitCache();
+  EXPECT_TRUE(TimeWrite());
+
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  ResetAndEvictSystemDiskCache();
+  EXPECT_TRUE(TimeHotSetRead());
+
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  const size_t working_set = metrics->GetWorkingSetSize();
+  base::LogPerfResult(
+      "Disk cache working set growth",
+      working_set > initial_working_set
+          ? static_cast<double>(working_set - initial_working_set) / 1024
+          : 0,
+      "KB");
+  if (hybrid_cache_impl_) {
+    base::LogPerfResult("Hybrid disk cache memory tier",
+                        hybrid_cache_impl_->memory_size() / 1024.0, "KB");
+  }
+}
+
+TEST_F(DiskCachePerfTest, CacheHotSetPerformance) {
+  HotSetPerformance();
+}
+
+TEST_F(DiskCachePerfTest, HybridCacheHotSetPerformance) {
+  SetHybridMode();
+  HotSetPerformance();
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheHotSetPerformance) {
+  SetSimpleCacheMode();
+  HotSetPerformance();
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheHybridHotSetPerformance) {
+  SetSimpleCacheMode();
+  SetHybridMode();
+  HotSetPerformance();
+}
+
+// TimeWrite() keeps all of its writes in flight at once, which a sharded
+// cache spreads over the worker pools of its shards.
+TEST_F(DiskCachePerfTest, SimpleCacheShardedBackendPerformance) {
+  SetSimpleCacheMode();
+  SetSimpleCacheShards(4);
+  CacheBackendPerformance();
+}
+
+// Measures writing and loading the index of a simple cache of a million
+// entries, and appending a tenth of them to the journal of the index.
+TEST_F(DiskCachePerfTest, SimpleCacheIndexLoad) {
+  const int kNumIndexEntries = 1000000;
+  const int kNumChangedEntries = kNumIndexEntries / 10;
+  ASSERT_TRUE(CleanupCacheDir());
+
+  disk_cache::SimpleIndexFile index_file(base::ThreadTaskRunnerHandle::Get(),
+                                         base::ThreadTaskRunnerHandle::Get(),
+                                         net::DISK_CACHE, cache_path_);
+  disk_cache::SimpleIndex::EntrySet entries;
+  disk_cache::SimpleIndex::EntrySet changed_entries;
+  const Time now = Time::Now();
+  for (int i = 0; i < kNumIndexEntries; ++i) {
+    const uint64_t entry_hash =
+        disk_cache::simple_util::GetEntryHashKey(base::IntToString(i));
+    disk_cache::SimpleIndex::InsertInEntrySet(
+        entry_hash, disk_cache::EntryMetadata(now, 16384u), &entries);
+    if (i % (kNumIndexEntries / kNumChangedEntries) == 0) {
+      disk_cache::SimpleIndex::InsertInEntrySet(
+          entry_hash, disk_cache::EntryMetadata(now, 32768u),
+          &changed_entries);
+    }
+  }
+
+  net::TestClosure closure;
+  base::PerfTimeLogger timer1("Write simple cache index (1M entries)");
+  index_file.WriteToDisk(disk_cache::SimpleIndex::INDEX_WRITE_REASON_IDLE,
+                         entries, 0, base::TimeTicks(), false,
+                         closure.closure());
+  closure.WaitForResult();
+  timer1.Done();
+
+  Time cache_mtime;
+  ASSERT_TRUE(disk_cache::simple_util::GetMTime(cache_path_, &cache_mtime));
+  disk_cache::SimpleIndexLoadResult load_result;
+  base::PerfTimeLogger timer2("Load simple cache index (1M entries)");
+  index_file.LoadIndexEntries(cache_mtime, closure.closure(), &load_result);
+  closure.WaitForResult();
+  timer2.Done();
+  EXPECT_EQ(disk_cache::SimpleIndex::INITIALIZE_METHOD_LOADED,
+            load_result.init_method);
+  EXPECT_EQ(entries.size(), load_result.entries.size());
+
+  base::PerfTimeLogger timer3(
+      "Append to simple cache index journal (100K entries)");
+  index_file.AppendToJournal(disk_cache::SimpleIndex::INDEX_WRITE_REASON_IDLE,
+                             changed_entries,
+                             disk_cache::SimpleIndex::HashList(),
+                             base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+  timer3.Done();
+
+  load_result.Reset();
+  base::PerfTimeLogger timer4(
+      "Load simple cache index and journal (1M + 100K entries)");
+  index_file.LoadIndexEntries(cache_mtime, closure.closure(), &load_result);
+  closure.WaitForResult();
+  timer4.Done();
+  EXPECT_EQ(disk_cache::SimpleIndex::INITIALIZE_METHOD_LOADED,
+            load_result.init_method);
+  EXPECT_TRUE(load_result.journal_valid);
+  EXPECT_EQ(entries.size(), load_result.entries.size());
+}
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
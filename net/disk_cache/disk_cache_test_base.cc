@@ -19,6 +19,7 @@
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_index.h"
@@ -76,11 +77,14 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
     : cache_impl_(NULL),
       simple_cache_impl_(NULL),
       mem_cache_(NULL),
+      hybrid_cache_impl_(NULL),
       mask_(0),
       size_(0),
       type_(net::DISK_CACHE),
       memory_only_(false),
       simple_cache_mode_(false),
+      simple_cache_shards_(1),
+      hybrid_mode_(false),
       simple_cache_wait_for_index_(true),
       force_creation_(false),
       new_eviction_(false),
@@ -306,6 +310,11 @@ void DiskCacheTestWithCache::InitDiskCache() {
   ASSERT_TRUE(cache_thread_.message_loop() != NULL);
 
   CreateBackend(disk_cache::kNoRandom, &cache_thread_);
+  if (hybrid_mode_) {
+    hybrid_cache_impl_ =
+        new disk_cache::HybridBackendImpl(std::move(cache_), 0);
+    cache_.reset(hybrid_cache_impl_);
+  }
 }
 
 void DiskCacheTestWithCache::CreateBackend(uint32_t flags,
@@ -321,13 +330,14 @@ void DiskCacheTestWithCache::CreateBackend(uint32_t flags,
     std::unique_ptr<disk_cache::SimpleBackendImpl> simple_backend(
         new disk_cache::SimpleBackendImpl(cache_path_, size_, type_, runner,
                                           NULL));
+    ASSERT_TRUE(simple_backend->SetNumShards(simple_cache_shards_));
     int rv = simple_backend->Init(cb.callback());
     ASSERT_THAT(cb.GetResult(rv), IsOk());
     simple_cache_impl_ = simple_backend.get();
     cache_ = std::move(simple_backend);
     if (simple_cache_wait_for_index_) {
       net::TestCompletionCallback wait_for_index_cb;
-      rv = simple_cache_impl_->index()->ExecuteWhenReady(
+      rv = simple_cache_impl_->ExecuteWhenIndexReady(
           wait_for_index_cb.callback());
       ASSERT_THAT(wait_for_index_cb.GetResult(rv), IsOk());
     }
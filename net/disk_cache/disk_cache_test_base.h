@@ -29,6 +29,7 @@ namespace disk_cache {
 class Backend;
 class BackendImpl;
 class Entry;
+class HybridBackendImpl;
 class MemBackendImpl;
 class SimpleBackendImpl;
 
@@ -90,6 +91,15 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     simple_cache_mode_ = true;
   }
 
+  void SetSimpleCacheShards(int num_shards) {
+    simple_cache_shards_ = num_shards;
+  }
+
+  // Puts a HybridBackendImpl in front of the disk cache.
+  void SetHybridMode() {
+    hybrid_mode_ = true;
+  }
+
   void SetMask(uint32_t mask) { mask_ = mask; }
 
   void SetMaxSize(int size);
@@ -169,12 +179,15 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   disk_cache::BackendImpl* cache_impl_;
   disk_cache::SimpleBackendImpl* simple_cache_impl_;
   disk_cache::MemBackendImpl* mem_cache_;
+  disk_cache::HybridBackendImpl* hybrid_cache_impl_;
 
   uint32_t mask_;
   int size_;
   net::CacheType type_;
   bool memory_only_;
   bool simple_cache_mode_;
+  int simple_cache_shards_;
+  bool hybrid_mode_;
   bool simple_cache_wait_for_index_;
   bool force_creation_;
   bool new_eviction_;
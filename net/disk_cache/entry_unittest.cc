@@ -2646,6 +2646,11 @@ bool DiskCacheEntryTest::SimpleCacheMakeBadChecksumEntry(const std::string& key,
   entry->Close();
   entry = NULL;
 
+  // Let the close write the entry out before corrupting it.
+  base::RunLoop().RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
   // Corrupt the last byte of the data.
   base::FilePath entry_file0_path = cache_path_.AppendASCII(
       disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
@@ -3692,6 +3697,62 @@ TEST_F(DiskCacheEntryTest, SimpleCacheNonSequentialWrite) {
   }
 }
 
+// Test that the writes to a newly created entry, which are kept in memory until
+// it is closed or grows too large, can be read back and end up on disk.
+TEST_F(DiskCacheEntryTest, SimpleCacheCoalescedWrites) {
+  SetSimpleCacheMode();
+  InitCache();
+  const int kSmallSize = 1000;
+  const int kLargeSize = 20 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kLargeSize));
+  scoped_refptr<net::IOBuffer> buffer_read(new net::IOBuffer(kLargeSize));
+  CacheTestFillBuffer(buffer->data(), kLargeSize, false);
+
+  // The first entry stays small enough to be written in one go on close, the
+  // second one grows past the coalescing limit while stream 1 is written.
+  const char* const kKeys[] = {"the small key", "the large key"};
+  const int kStream1Sizes[] = {kSmallSize, 2 * kLargeSize};
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    const std::string key(kKeys[i]);
+    disk_cache::Entry* entry = NULL;
+    ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+    EXPECT_EQ(kSmallSize,
+              WriteData(entry, 0, 0, buffer.get(), kSmallSize, false));
+    const int kChunkSize = kStream1Sizes[i] / 2;
+    EXPECT_EQ(kChunkSize,
+              WriteData(entry, 1, 0, buffer.get(), kChunkSize, false));
+    EXPECT_EQ(kChunkSize, ReadData(entry, 1, 0, buffer_read.get(), kChunkSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), buffer_read->data(), kChunkSize));
+    EXPECT_EQ(kChunkSize, WriteData(entry, 1, kChunkSize, buffer.get(),
+                                    kChunkSize, false));
+    EXPECT_EQ(kStream1Sizes[i], entry->GetDataSize(1));
+    entry->Close();
+
+    // Opening the entry waits for the previous close to finish.
+    ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+    int data_size[disk_cache::kSimpleEntryStreamCount] = {
+        kSmallSize, kStream1Sizes[i], 0};
+    disk_cache::SimpleEntryStat entry_stat(base::Time::Now(), base::Time::Now(),
+                                           data_size, 0);
+    int64_t file_size = 0;
+    EXPECT_TRUE(base::GetFileSize(
+        cache_path_.AppendASCII(
+            disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0)),
+        &file_size));
+    EXPECT_EQ(entry_stat.GetFileSize(key.size(), 0), file_size);
+
+    EXPECT_EQ(kSmallSize,
+              ReadData(entry, 0, 0, buffer_read.get(), kSmallSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), buffer_read->data(), kSmallSize));
+    for (int offset = 0; offset < kStream1Sizes[i]; offset += kChunkSize) {
+      EXPECT_EQ(kChunkSize,
+                ReadData(entry, 1, offset, buffer_read.get(), kChunkSize));
+      EXPECT_EQ(0, memcmp(buffer->data(), buffer_read->data(), kChunkSize));
+    }
+    entry->Close();
+  }
+}
+
 // Test that changing stream1 size does not affect stream0 (stream0 and stream1
 // are stored in the same file in Simple Cache).
 TEST_F(DiskCacheEntryTest, SimpleCacheStream1SizeChanges) {
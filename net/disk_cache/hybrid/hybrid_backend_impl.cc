@@ -0,0 +1,349 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/net_errors.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+namespace {
+
+const int kDefaultMemoryTierSize = 10 * 1024 * 1024;
+
+}  // namespace
+
+class HybridBackendImpl::HybridIterator final : public Backend::Iterator {
+ public:
+  explicit HybridIterator(base::WeakPtr<HybridBackendImpl> backend)
+      : backend_(backend),
+        disk_iterator_(backend->disk_backend_->CreateIterator()) {}
+
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    if (!backend_)
+      return net::ERR_FAILED;
+
+    // The disk backend decides the order of the iteration, which thus covers
+    // the entries evicted from the memory tier too.
+    Entry** disk_entry = new Entry*(nullptr);
+    CompletionCallback disk_callback =
+        base::Bind(&HybridBackendImpl::OnDiskEntryOpenedOrCreated, backend_,
+                   false, base::Owned(disk_entry), next_entry, callback);
+    int rv = disk_iterator_->OpenNextEntry(disk_entry, disk_callback);
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    return backend_->FinishOpenOrCreate(false, disk_entry, next_entry, rv);
+  }
+
+ private:
+  base::WeakPtr<HybridBackendImpl> backend_;
+  std::unique_ptr<Backend::Iterator> disk_iterator_;
+};
+
+HybridBackendImpl::HybridBackendImpl(std::unique_ptr<Backend> disk_backend,
+                                     int max_bytes)
+    : disk_backend_(std::move(disk_backend)),
+      max_size_(kDefaultMemoryTierSize),
+      current_size_(0),
+      write_back_size_(0),
+      memory_hits_(0),
+      memory_misses_(0),
+      weak_factory_(this) {
+  DCHECK(disk_backend_);
+  SetMaxSize(max_bytes);
+}
+
+HybridBackendImpl::~HybridBackendImpl() {
+  // The entries still in use outlive the backend, and keep working against
+  // the disk backend for as long as it lets them.
+  while (!lru_list_.empty())
+    lru_list_.head()->value()->RemoveFromBackend();
+  DCHECK(entries_.empty());
+  DCHECK(!current_size_);
+}
+
+bool HybridBackendImpl::SetMaxSize(int max_bytes) {
+  static_assert(sizeof(max_bytes) == sizeof(max_size_),
+                "unsupported int model");
+  if (max_bytes < 0)
+    return false;
+
+  // Zero size means use the default.
+  if (!max_bytes)
+    return true;
+
+  max_size_ = max_bytes;
+  EvictIfNeeded();
+  return true;
+}
+
+int HybridBackendImpl::MaxStreamSize() const {
+  return max_size_ / 8;
+}
+
+void HybridBackendImpl::OnEntryUpdated(HybridEntryImpl* entry) {
+  DCHECK(entry->in_backend());
+  // LinkedList<>::RemoveFromList() removes |entry| from |lru_list_|.
+  entry->RemoveFromList();
+  lru_list_.Append(entry);
+}
+
+void HybridBackendImpl::OnEntryRemoved(HybridEntryImpl* entry) {
+  DCHECK(!entry->in_backend());
+  current_size_ -= entry->GetStorageSize();
+  entry->RemoveFromList();
+
+  // This may delete |entry|.
+  EntryMap::iterator it = entries_.find(entry->key());
+  DCHECK(it != entries_.end());
+  DCHECK_EQ(entry, it->second.get());
+  entries_.erase(it);
+}
+
+void HybridBackendImpl::ModifyStorageSize(int32_t delta) {
+  current_size_ += delta;
+  if (delta > 0)
+    EvictIfNeeded();
+}
+
+bool HybridBackendImpl::StartWriteBack(int32_t size) {
+  if (size > max_size_ - write_back_size_)
+    return false;
+  write_back_size_ += size;
+  return true;
+}
+
+void HybridBackendImpl::FinishWriteBack(int32_t size) {
+  write_back_size_ -= size;
+  DCHECK_GE(write_back_size_, 0);
+}
+
+net::CacheType HybridBackendImpl::GetCacheType() const {
+  return disk_backend_->GetCacheType();
+}
+
+int32_t HybridBackendImpl::GetEntryCount() const {
+  return disk_backend_->GetEntryCount();
+}
+
+int HybridBackendImpl::OpenEntry(const std::string& key,
+                                 Entry** entry,
+                                 const CompletionCallback& callback) {
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end() && it->second->CanOpenWithoutDiskEntry()) {
+    ++memory_hits_;
+    // The disk backend evicts the entries it sees the least use of, so tell it
+    // about this one.
+    disk_backend_->OnExternalCacheHit(key);
+    it->second->Open(nullptr);
+    *entry = it->second.get();
+    return net::OK;
+  }
+
+  // The streams not kept in memory need the disk entry, which the disk backend
+  // may have evicted.
+  ++memory_misses_;
+  Entry** disk_entry = new Entry*(nullptr);
+  CompletionCallback disk_callback = base::Bind(
+      &HybridBackendImpl::OnDiskEntryOpened, weak_factory_.GetWeakPtr(), key,
+      base::Owned(disk_entry), entry, callback);
+  int rv = disk_backend_->OpenEntry(key, disk_entry, disk_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return FinishOpen(key, disk_entry, entry, rv);
+}
+
+int HybridBackendImpl::CreateEntry(const std::string& key,
+                                   Entry** entry,
+                                   const CompletionCallback& callback) {
+  if (entries_.find(key) != entries_.end())
+    return net::ERR_FAILED;
+
+  Entry** disk_entry = new Entry*(nullptr);
+  CompletionCallback disk_callback = base::Bind(
+      &HybridBackendImpl::OnDiskEntryOpenedOrCreated,
+      weak_factory_.GetWeakPtr(), true, base::Owned(disk_entry), entry,
+      callback);
+  int rv = disk_backend_->CreateEntry(key, disk_entry, disk_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return FinishOpenOrCreate(true, disk_entry, entry, rv);
+}
+
+int HybridBackendImpl::DoomEntry(const std::string& key,
+                                 const CompletionCallback& callback) {
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end())
+    it->second->MarkDoomed();
+  return disk_backend_->DoomEntry(key, callback);
+}
+
+int HybridBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  std::vector<scoped_refptr<HybridEntryImpl>> to_doom;
+  to_doom.reserve(entries_.size());
+  for (const auto& key_and_entry : entries_)
+    to_doom.push_back(key_and_entry.second);
+  for (const auto& entry : to_doom)
+    entry->MarkDoomed();
+  DCHECK(entries_.empty());
+  return disk_backend_->DoomAllEntries(callback);
+}
+
+int HybridBackendImpl::DoomEntriesBetween(Time initial_time,
+                                          Time end_time,
+                                          const CompletionCallback& callback) {
+  RemoveEntriesUsedSince(initial_time);
+  return disk_backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int HybridBackendImpl::DoomEntriesSince(Time initial_time,
+                                        const CompletionCallback& callback) {
+  RemoveEntriesUsedSince(initial_time);
+  return disk_backend_->DoomEntriesSince(initial_time, callback);
+}
+
+int HybridBackendImpl::CalculateSizeOfAllEntries(
+    const CompletionCallback& callback) {
+  return disk_backend_->CalculateSizeOfAllEntries(callback);
+}
+
+std::unique_ptr<Backend::Iterator> HybridBackendImpl::CreateIterator() {
+  return std::unique_ptr<Backend::Iterator>(
+      new HybridIterator(weak_factory_.GetWeakPtr()));
+}
+
+void HybridBackendImpl::GetStats(base::StringPairs* stats) {
+  disk_backend_->GetStats(stats);
+  stats->push_back(
+      std::make_pair("Memory tier size", base::IntToString(current_size_)));
+  stats->push_back(std::make_pair("Memory tier entries",
+                                  base::SizeTToString(entries_.size())));
+  stats->push_back(
+      std::make_pair("Memory tier hits", base::Int64ToString(memory_hits_)));
+  stats->push_back(std::make_pair("Memory tier misses",
+                                  base::Int64ToString(memory_misses_)));
+}
+
+void HybridBackendImpl::OnExternalCacheHit(const std::string& key) {
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end())
+    OnEntryUpdated(it->second.get());
+  disk_backend_->OnExternalCacheHit(key);
+}
+
+int HybridBackendImpl::FinishOpenOrCreate(bool created,
+                                          Entry** disk_entry,
+                                          Entry** entry,
+                                          int result) {
+  if (result != net::OK)
+    return result;
+
+  const std::string key = (*disk_entry)->GetKey();
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    if (!created) {
+      // Another open of the same entry completed first.
+      it->second->Open(*disk_entry);
+      *entry = it->second.get();
+      return net::OK;
+    }
+    // The disk backend replaced the entry, which must have been doomed
+    // underneath us.
+    it->second->RemoveFromBackend();
+  }
+
+  scoped_refptr<HybridEntryImpl> hybrid_entry(
+      new HybridEntryImpl(weak_factory_.GetWeakPtr(), *disk_entry, created));
+  entries_[key] = hybrid_entry;
+  lru_list_.Append(hybrid_entry.get());
+  hybrid_entry->Open(nullptr);
+  // The entry is in use, so this cannot evict it.
+  ModifyStorageSize(hybrid_entry->GetStorageSize());
+  *entry = hybrid_entry.get();
+  return net::OK;
+}
+
+int HybridBackendImpl::FinishOpen(const std::string& key,
+                                  Entry** disk_entry,
+                                  Entry** entry,
+                                  int result) {
+  if (result != net::OK) {
+    EntryMap::iterator it = entries_.find(key);
+    if (it != entries_.end())
+      it->second->MarkDoomed();
+    return result;
+  }
+  return FinishOpenOrCreate(false, disk_entry, entry, result);
+}
+
+// static
+void HybridBackendImpl::OnDiskEntryOpened(
+    const base::WeakPtr<HybridBackendImpl>& backend,
+    const std::string& key,
+    Entry** disk_entry,
+    Entry** entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (!backend) {
+    if (result == net::OK)
+      (*disk_entry)->Close();
+    return;
+  }
+  callback.Run(backend->FinishOpen(key, disk_entry, entry, result));
+}
+
+// static
+void HybridBackendImpl::OnDiskEntryOpenedOrCreated(
+    const base::WeakPtr<HybridBackendImpl>& backend,
+    bool created,
+    Entry** disk_entry,
+    Entry** entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (!backend) {
+    if (result == net::OK)
+      (*disk_entry)->Close();
+    return;
+  }
+  callback.Run(
+      backend->FinishOpenOrCreate(created, disk_entry, entry, result));
+}
+
+void HybridBackendImpl::RemoveEntriesUsedSince(Time initial_time) {
+  // The entries used since |initial_time| are at the end of |lru_list_|.
+  base::LinkNode<HybridEntryImpl>* node = lru_list_.tail();
+  while (node != lru_list_.end() &&
+         node->value()->GetLastUsed() >= initial_time) {
+    HybridEntryImpl* to_remove = node->value();
+    node = node->previous();
+    to_remove->RemoveFromBackend();
+  }
+}
+
+void HybridBackendImpl::EvictIfNeeded() {
+  if (current_size_ <= max_size_)
+    return;
+
+  int target_size = max_size_ - max_size_ / 10;
+
+  base::LinkNode<HybridEntryImpl>* node = lru_list_.head();
+  while (current_size_ > target_size && node != lru_list_.end()) {
+    HybridEntryImpl* to_evict = node->value();
+    node = node->next();
+    if (!to_evict->InUse())
+      to_evict->RemoveFromBackend();
+  }
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,167 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_HYBRID_HYBRID_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_HYBRID_HYBRID_BACKEND_IMPL_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "base/containers/linked_list.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/strings/string_split.h"
+#include "base/time/time.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/hybrid/hybrid_entry_impl.h"
+
+namespace disk_cache {
+
+// This class implements the Backend interface on top of another, on-disk,
+// Backend. The most recently used entries, and the streams of theirs that were
+// read or written whole, are kept in a memory tier of bounded size, from which
+// they are served without waiting for the disk backend. Writes to the streams
+// held in memory are written back to the disk backend in the background, see
+// HybridEntryImpl.
+//
+// Entries are evicted from the memory tier in LRU order once it grows past its
+// maximum size, only to be opened from the disk backend again the next time
+// they are used. The disk backend keeps evicting entries on its own, so it is
+// told about the entries opened from memory. An entry evicted from the disk
+// while still in memory is dropped from the memory tier the next time it needs
+// the disk entry, and in particular is no longer opened if some of its streams
+// are not in memory.
+class NET_EXPORT_PRIVATE HybridBackendImpl final : public Backend {
+ public:
+  // |disk_backend| must be initialized. |max_bytes| is the maximum size of the
+  // memory tier; zero means the default size.
+  HybridBackendImpl(std::unique_ptr<Backend> disk_backend, int max_bytes);
+  ~HybridBackendImpl() override;
+
+  // Sets the maximum size for the data kept in memory by this instance.
+  bool SetMaxSize(int max_bytes);
+
+  // Returns the maximum size of a stream to keep in memory.
+  int MaxStreamSize() const;
+
+  Backend* disk_backend() const { return disk_backend_.get(); }
+
+  // Returns the size of the data currently kept in memory.
+  int32_t memory_size() const { return current_size_; }
+
+  // These next methods (before the implementation of the Backend interface) are
+  // called by HybridEntryImpl to update the state of the backend during the
+  // entry lifecycle.
+
+  // Signals that an entry has been used, and thus should be moved to the end
+  // of |lru_list_|.
+  void OnEntryUpdated(HybridEntryImpl* entry);
+
+  // Signals that an entry has been removed from the memory tier, because it
+  // was evicted, doomed or lost by the disk backend. This drops the reference
+  // the backend holds on |entry|.
+  void OnEntryRemoved(HybridEntryImpl* entry);
+
+  // Adjust the current size of the memory tier by |delta|. This is used to
+  // determine if eviction is neccessary and when eviction is finished.
+  void ModifyStorageSize(int32_t delta);
+
+  // Accounts for the copies of the data being written back to the disk
+  // backend, which are limited to the maximum size of the memory tier as well.
+  // Returns false if a write back of |size| bytes would go over that limit.
+  bool StartWriteBack(int32_t size);
+  void FinishWriteBack(int32_t size);
+
+  // Backend interface.
+  net::CacheType GetCacheType() const override;
+  int32_t GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  int CalculateSizeOfAllEntries(const CompletionCallback& callback) override;
+  std::unique_ptr<Iterator> CreateIterator() override;
+  void GetStats(base::StringPairs* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+
+ private:
+  class HybridIterator;
+  friend class HybridIterator;
+
+  using EntryMap =
+      std::unordered_map<std::string, scoped_refptr<HybridEntryImpl>>;
+
+  // Completes the opening or creation of |*disk_entry| for the caller, whose
+  // out pointer is |entry|, and returns the result.
+  int FinishOpenOrCreate(bool created,
+                         Entry** disk_entry,
+                         Entry** entry,
+                         int result);
+  // Like FinishOpenOrCreate() for OpenEntry() of |key|, which is dropped from
+  // the memory tier if the disk backend no longer has it.
+  int FinishOpen(const std::string& key,
+                 Entry** disk_entry,
+                 Entry** entry,
+                 int result);
+  static void OnDiskEntryOpened(const base::WeakPtr<HybridBackendImpl>& backend,
+                                const std::string& key,
+                                Entry** disk_entry,
+                                Entry** entry,
+                                const CompletionCallback& callback,
+                                int result);
+  static void OnDiskEntryOpenedOrCreated(
+      const base::WeakPtr<HybridBackendImpl>& backend,
+      bool created,
+      Entry** disk_entry,
+      Entry** entry,
+      const CompletionCallback& callback,
+      int result);
+
+  // Removes from the memory tier the entries which were used at or after
+  // |initial_time|, which the disk backend may be about to doom.
+  void RemoveEntriesUsedSince(base::Time initial_time);
+
+  // Removes entries from the memory tier until its size is below the limit.
+  void EvictIfNeeded();
+
+  std::unique_ptr<Backend> disk_backend_;
+
+  EntryMap entries_;
+
+  // Stored in increasing order of last use time, from least recently used to
+  // most recently used.
+  base::LinkedList<HybridEntryImpl> lru_list_;
+
+  int32_t max_size_;      // Maximum size of the memory tier.
+  int32_t current_size_;
+  int32_t write_back_size_;
+
+  // Opens served from the memory tier, and from the disk backend.
+  int64_t memory_hits_;
+  int64_t memory_misses_;
+
+  base::WeakPtrFactory<HybridBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(HybridBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_HYBRID_HYBRID_BACKEND_IMPL_H_
@@ -0,0 +1,474 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/hybrid/hybrid_entry_impl.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/hybrid/hybrid_backend_impl.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+namespace {
+
+// Used for the disk operations nobody waits for.
+void IgnoreDiskResult(int result) {}
+
+}  // namespace
+
+HybridEntryImpl::HybridEntryImpl(
+    const base::WeakPtr<HybridBackendImpl>& backend,
+    Entry* disk_entry,
+    bool created)
+    : backend_(backend),
+      key_(disk_entry->GetKey()),
+      could_be_sparse_(!created && disk_entry->CouldBeSparse()),
+      open_count_(0),
+      in_backend_(true),
+      doomed_(false),
+      disk_entry_(disk_entry),
+      opening_(false),
+      opening_disk_entry_(nullptr) {
+  // The times of a created entry are set by its first Open().
+  if (!created) {
+    last_modified_ = disk_entry->GetLastModified();
+    last_used_ = disk_entry->GetLastUsed();
+  }
+  for (int i = 0; i < kNumStreams; ++i) {
+    data_size_[i] = created ? 0 : disk_entry->GetDataSize(i);
+    // Empty streams are trivially kept in memory.
+    in_memory_[i] = !data_size_[i] && (i == 0 || !could_be_sparse_);
+    write_count_[i] = 0;
+  }
+}
+
+void HybridEntryImpl::Open(Entry* disk_entry) {
+  ++open_count_;
+  AddRef();  // Balanced in Close().
+  if (disk_entry) {
+    if (disk_entry_ || opening_)
+      disk_entry->Close();
+    else
+      disk_entry_ = disk_entry;
+  }
+  UpdateStateOnUse(last_modified_.is_null());
+}
+
+bool HybridEntryImpl::CanOpenWithoutDiskEntry() const {
+  return disk_entry_ || std::find(in_memory_, in_memory_ + kNumStreams,
+                                  false) == in_memory_ + kNumStreams;
+}
+
+void HybridEntryImpl::RemoveFromBackend() {
+  if (!in_backend_)
+    return;
+  in_backend_ = false;
+  if (backend_)
+    backend_->OnEntryRemoved(this);
+}
+
+void HybridEntryImpl::MarkDoomed() {
+  doomed_ = true;
+  RemoveFromBackend();
+}
+
+int HybridEntryImpl::GetStorageSize() const {
+  int storage_size = static_cast<int32_t>(key_.size());
+  for (const auto& i : data_)
+    storage_size += i.size();
+  return storage_size;
+}
+
+void HybridEntryImpl::Doom() {
+  if (doomed_)
+    return;
+  if (disk_entry_) {
+    disk_entry_->Doom();
+  } else if (backend_) {
+    // If the disk entry is being opened, this is queued after it.
+    backend_->disk_backend()->DoomEntry(key_, base::Bind(&IgnoreDiskResult));
+  }
+  MarkDoomed();
+}
+
+void HybridEntryImpl::Close() {
+  DCHECK_GT(open_count_, 0);
+  --open_count_;
+  if (!open_count_ && disk_entry_)
+    CloseDiskEntry();
+  Release();  // Balanced in Open().
+}
+
+std::string HybridEntryImpl::GetKey() const {
+  return key_;
+}
+
+Time HybridEntryImpl::GetLastUsed() const {
+  return last_used_;
+}
+
+Time HybridEntryImpl::GetLastModified() const {
+  return last_modified_;
+}
+
+int32_t HybridEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= kNumStreams)
+    return 0;
+  if (in_memory_[index])
+    return data_[index].size();
+  if (disk_entry_)
+    return disk_entry_->GetDataSize(index);
+  return data_size_[index];
+}
+
+int HybridEntryImpl::ReadData(int index,
+                              int offset,
+                              IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback) {
+  // Invalid arguments are left for the disk entry to report.
+  const bool valid_stream = index >= 0 && index < kNumStreams;
+  UpdateStateOnUse(false);
+  if (valid_stream && in_memory_[index] && offset >= 0 && buf_len >= 0) {
+    int entry_size = data_[index].size();
+    if (offset >= entry_size || !buf_len)
+      return 0;
+
+    if (offset + buf_len > entry_size)
+      buf_len = entry_size - offset;
+    std::copy(data_[index].begin() + offset,
+              data_[index].begin() + offset + buf_len, buf->data());
+    return buf_len;
+  }
+
+  DiskOperation operation =
+      base::Bind(&HybridEntryImpl::DiskReadData, this, index, offset,
+                 make_scoped_refptr(buf), buf_len);
+  if (!valid_stream || offset != 0)
+    return RunDiskOperation(operation, callback);
+
+  // A read of the whole stream may let it be kept in memory.
+  const uint64_t write_count = write_count_[index];
+  int rv = RunDiskOperation(
+      operation, base::Bind(&HybridEntryImpl::OnDiskReadComplete, this, index,
+                            make_scoped_refptr(buf), write_count, callback));
+  if (rv != net::ERR_IO_PENDING)
+    MaybeKeepStream(index, buf, write_count, rv);
+  return rv;
+}
+
+int HybridEntryImpl::WriteData(int index,
+                               int offset,
+                               IOBuffer* buf,
+                               int buf_len,
+                               const CompletionCallback& callback,
+                               bool truncate) {
+  const bool valid_stream = index >= 0 && index < kNumStreams;
+  const bool valid_range = offset >= 0 && buf_len >= 0;
+  UpdateStateOnUse(true);
+  if (!valid_stream) {
+    return RunDiskOperation(
+        base::Bind(&HybridEntryImpl::DiskWriteData, this, index, offset,
+                   make_scoped_refptr(buf), buf_len, truncate),
+        callback);
+  }
+  ++write_count_[index];
+
+  if (in_memory_[index] && valid_range) {
+    const int max_stream_size = backend_ ? backend_->MaxStreamSize() : 0;
+    // offset or buf_len could be large enough to overflow their sum. Once the
+    // disk backend falls behind on write backs, writes go straight to it.
+    if (!in_backend_ || !backend_ || offset > max_stream_size ||
+        buf_len > max_stream_size || offset + buf_len > max_stream_size ||
+        !backend_->StartWriteBack(buf_len)) {
+      DropStream(index);
+    }
+  }
+
+  if (!in_memory_[index] || !valid_range) {
+    if (valid_range && !disk_entry_) {
+      // Keep GetDataSize() right until the disk entry is open.
+      data_size_[index] = truncate ? offset + buf_len
+                                   : std::max(data_size_[index],
+                                              offset + buf_len);
+    }
+    return RunDiskOperation(
+        base::Bind(&HybridEntryImpl::DiskWriteData, this, index, offset,
+                   make_scoped_refptr(buf), buf_len, truncate),
+        callback);
+  }
+
+  int old_data_size = data_[index].size();
+  if (truncate || old_data_size < offset + buf_len) {
+    // Any hole is zero filled.
+    data_[index].resize(offset + buf_len);
+    ModifyStorageSize(data_[index].size() - old_data_size);
+  }
+  std::copy(buf->data(), buf->data() + buf_len,
+            data_[index].begin() + offset);
+
+  // Until the disk entry is open again, the disk backend may have evicted it,
+  // so the caller waits for the write back rather than lose the data.
+  const bool wait_for_write_back = !disk_entry_;
+
+  // |buf| can be reused by the caller as soon as this returns, so the write
+  // back needs its own copy.
+  scoped_refptr<IOBuffer> write_back_buf(new IOBuffer(buf_len));
+  std::copy(buf->data(), buf->data() + buf_len, write_back_buf->data());
+  int rv = RunDiskOperation(
+      base::Bind(&HybridEntryImpl::DiskWriteData, this, index, offset,
+                 write_back_buf, buf_len, truncate),
+      base::Bind(&HybridEntryImpl::OnWriteBackComplete, this, buf_len,
+                 wait_for_write_back ? callback : CompletionCallback()));
+  if (rv != net::ERR_IO_PENDING)
+    OnWriteBackComplete(buf_len, CompletionCallback(), rv);
+  return wait_for_write_back ? rv : buf_len;
+}
+
+int HybridEntryImpl::ReadSparseData(int64_t offset,
+                                    IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback) {
+  PrepareForSparseIO();
+  UpdateStateOnUse(false);
+  return RunDiskOperation(
+      base::Bind(&HybridEntryImpl::DiskReadSparseData, this, offset,
+                 make_scoped_refptr(buf), buf_len),
+      callback);
+}
+
+int HybridEntryImpl::WriteSparseData(int64_t offset,
+                                     IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  PrepareForSparseIO();
+  UpdateStateOnUse(true);
+  return RunDiskOperation(
+      base::Bind(&HybridEntryImpl::DiskWriteSparseData, this, offset,
+                 make_scoped_refptr(buf), buf_len),
+      callback);
+}
+
+int HybridEntryImpl::GetAvailableRange(int64_t offset,
+                                       int len,
+                                       int64_t* start,
+                                       const CompletionCallback& callback) {
+  PrepareForSparseIO();
+  return RunDiskOperation(base::Bind(&HybridEntryImpl::DiskGetAvailableRange,
+                                     this, offset, len, start),
+                          callback);
+}
+
+bool HybridEntryImpl::CouldBeSparse() const {
+  if (disk_entry_)
+    return disk_entry_->CouldBeSparse();
+  return could_be_sparse_;
+}
+
+void HybridEntryImpl::CancelSparseIO() {
+  if (disk_entry_)
+    disk_entry_->CancelSparseIO();
+}
+
+int HybridEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  if (!disk_entry_ && !opening_)
+    return net::OK;
+  return RunDiskOperation(
+      base::Bind(&HybridEntryImpl::DiskReadyForSparseIO, this), callback);
+}
+
+HybridEntryImpl::~HybridEntryImpl() {
+  DCHECK(!open_count_);
+  if (disk_entry_)
+    disk_entry_->Close();
+}
+
+int HybridEntryImpl::RunDiskOperation(const DiskOperation& operation,
+                                      const CompletionCallback& callback) {
+  if (!disk_entry_ && !opening_)
+    OpenDiskEntry();
+  if (disk_entry_)
+    return operation.Run(callback);
+  if (!opening_)
+    return net::ERR_FAILED;
+
+  queued_operations_.push_back(
+      base::Bind(&HybridEntryImpl::RunQueuedDiskOperation, this, operation,
+                 callback));
+  return net::ERR_IO_PENDING;
+}
+
+void HybridEntryImpl::OpenDiskEntry() {
+  DCHECK(!disk_entry_);
+  DCHECK(!opening_);
+  if (doomed_ || !backend_)
+    return;
+
+  opening_ = true;
+  int rv = backend_->disk_backend()->OpenEntry(
+      key_, &opening_disk_entry_,
+      base::Bind(&HybridEntryImpl::OnDiskEntryOpened, this));
+  if (rv != net::ERR_IO_PENDING)
+    OnDiskEntryOpened(rv);
+}
+
+void HybridEntryImpl::OnDiskEntryOpened(int result) {
+  DCHECK(opening_);
+  opening_ = false;
+  if (result == net::OK) {
+    disk_entry_ = opening_disk_entry_;
+  } else {
+    // The disk backend evicted the entry, so it cannot be served from memory
+    // either.
+    DVLOG(1) << "Could not open the disk entry of " << key_;
+    MarkDoomed();
+  }
+  opening_disk_entry_ = nullptr;
+
+  std::vector<base::Closure> operations;
+  operations.swap(queued_operations_);
+  for (const base::Closure& operation : operations)
+    operation.Run();
+
+  if (!open_count_ && disk_entry_)
+    CloseDiskEntry();
+}
+
+void HybridEntryImpl::RunQueuedDiskOperation(
+    const DiskOperation& operation,
+    const CompletionCallback& callback) {
+  int rv = RunDiskOperation(operation, callback);
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+void HybridEntryImpl::CloseDiskEntry() {
+  DCHECK(disk_entry_);
+  for (int i = 0; i < kNumStreams; ++i) {
+    if (!in_memory_[i])
+      data_size_[i] = disk_entry_->GetDataSize(i);
+  }
+  could_be_sparse_ = disk_entry_->CouldBeSparse();
+  disk_entry_->Close();
+  disk_entry_ = nullptr;
+}
+
+int HybridEntryImpl::DiskReadData(int index,
+                                  int offset,
+                                  const scoped_refptr<IOBuffer>& buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  return disk_entry_->ReadData(index, offset, buf.get(), buf_len, callback);
+}
+
+int HybridEntryImpl::DiskWriteData(int index,
+                                   int offset,
+                                   const scoped_refptr<IOBuffer>& buf,
+                                   int buf_len,
+                                   bool truncate,
+                                   const CompletionCallback& callback) {
+  return disk_entry_->WriteData(index, offset, buf.get(), buf_len, callback,
+                                truncate);
+}
+
+int HybridEntryImpl::DiskReadSparseData(int64_t offset,
+                                        const scoped_refptr<IOBuffer>& buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  return disk_entry_->ReadSparseData(offset, buf.get(), buf_len, callback);
+}
+
+int HybridEntryImpl::DiskWriteSparseData(int64_t offset,
+                                         const scoped_refptr<IOBuffer>& buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback) {
+  return disk_entry_->WriteSparseData(offset, buf.get(), buf_len, callback);
+}
+
+int HybridEntryImpl::DiskGetAvailableRange(int64_t offset,
+                                           int len,
+                                           int64_t* start,
+                                           const CompletionCallback& callback) {
+  return disk_entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+int HybridEntryImpl::DiskReadyForSparseIO(const CompletionCallback& callback) {
+  return disk_entry_->ReadyForSparseIO(callback);
+}
+
+void HybridEntryImpl::MaybeKeepStream(int index,
+                                      IOBuffer* buf,
+                                      uint64_t write_count,
+                                      int result) {
+  if (result <= 0 || in_memory_[index] || write_count != write_count_[index])
+    return;
+  if (!in_backend_ || !backend_ || result > backend_->MaxStreamSize() ||
+      result != GetDataSize(index) || (index != 0 && could_be_sparse_)) {
+    return;
+  }
+
+  data_[index].assign(buf->data(), buf->data() + result);
+  in_memory_[index] = true;
+  ModifyStorageSize(result);
+}
+
+void HybridEntryImpl::OnDiskReadComplete(int index,
+                                         const scoped_refptr<IOBuffer>& buf,
+                                         uint64_t write_count,
+                                         const CompletionCallback& callback,
+                                         int result) {
+  MaybeKeepStream(index, buf.get(), write_count, result);
+  callback.Run(result);
+}
+
+void HybridEntryImpl::OnWriteBackComplete(int buf_len,
+                                          const CompletionCallback& callback,
+                                          int result) {
+  if (backend_)
+    backend_->FinishWriteBack(buf_len);
+  if (result != buf_len) {
+    // The data on disk no longer matches the data in memory.
+    DVLOG(1) << "Could not write back to the disk entry of " << key_;
+    Doom();
+  }
+  if (!callback.is_null())
+    callback.Run(result);
+}
+
+void HybridEntryImpl::DropStream(int index) {
+  if (!in_memory_[index])
+    return;
+  int32_t data_size = data_[index].size();
+  data_size_[index] = data_size;
+  std::vector<char>().swap(data_[index]);
+  in_memory_[index] = false;
+  ModifyStorageSize(-data_size);
+}
+
+void HybridEntryImpl::PrepareForSparseIO() {
+  could_be_sparse_ = true;
+  for (int i = 1; i < kNumStreams; ++i)
+    DropStream(i);
+}
+
+void HybridEntryImpl::UpdateStateOnUse(bool modified) {
+  last_used_ = Time::Now();
+  if (modified)
+    last_modified_ = last_used_;
+  if (in_backend_ && backend_)
+    backend_->OnEntryUpdated(this);
+}
+
+void HybridEntryImpl::ModifyStorageSize(int32_t delta) {
+  if (in_backend_ && backend_)
+    backend_->ModifyStorageSize(delta);
+}
+
+}  // namespace disk_cache
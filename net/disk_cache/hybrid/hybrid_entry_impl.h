@@ -0,0 +1,232 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_HYBRID_HYBRID_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_HYBRID_HYBRID_ENTRY_IMPL_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/containers/linked_list.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+class HybridBackendImpl;
+
+// This class implements the Entry interface for the hybrid cache. An object of
+// this class represents a single entry of the disk backend, some of whose
+// streams are also kept in memory.
+//
+// Reads of a stream held in memory complete synchronously, without touching
+// the disk entry. Writes to such a stream are applied in memory and written
+// back to the disk entry; if a write back fails the entry is doomed. They
+// complete synchronously while the disk entry is open, and otherwise with the
+// write back, since the disk backend may have evicted the entry meanwhile. A
+// stream read whole from the disk is kept in memory from then on, as long as
+// it is no larger than the backend's HybridBackendImpl::MaxStreamSize().
+// Everything else, including the sparse API, goes to the disk entry.
+//
+// The entry stays in the backend after it is closed, until it is evicted or
+// doomed, so that opening it again can be served from memory. The disk entry
+// is only opened when an operation needs it, and is closed with the entry.
+class NET_EXPORT_PRIVATE HybridEntryImpl
+    : public Entry,
+      public base::LinkNode<HybridEntryImpl>,
+      public base::RefCounted<HybridEntryImpl> {
+ public:
+  // |disk_entry| is the open disk entry for |key|, which was created rather
+  // than opened if |created| is true.
+  HybridEntryImpl(const base::WeakPtr<HybridBackendImpl>& backend,
+                  Entry* disk_entry,
+                  bool created);
+
+  // Hands the entry to a caller, who must Close() it. |disk_entry|, if not
+  // null, is an open disk entry for the same key, which the entry takes over.
+  void Open(Entry* disk_entry);
+  bool InUse() const { return open_count_ > 0; }
+
+  // Whether the entry can be opened without opening its disk entry, which is
+  // the case if the disk entry is open already or every stream is in memory.
+  bool CanOpenWithoutDiskEntry() const;
+
+  // Removes the entry from its backend, which then no longer serves it from
+  // memory. The disk entry is left alone. This may delete the entry if it is
+  // not in use.
+  void RemoveFromBackend();
+
+  // Like RemoveFromBackend(), for an entry whose disk entry the caller is
+  // dooming. The disk entry is no longer opened from then on.
+  void MarkDoomed();
+
+  const std::string& key() const { return key_; }
+  bool in_backend() const { return in_backend_; }
+
+  // The in-memory size of this entry to use for the purposes of eviction.
+  int GetStorageSize() const;
+
+  // From disk_cache::Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32_t GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64_t offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64_t offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64_t offset,
+                        int len,
+                        int64_t* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  friend class base::RefCounted<HybridEntryImpl>;
+
+  // An operation on |disk_entry_|, returning a net error code or the number
+  // of bytes transferred. The callback is invoked if it returns
+  // ERR_IO_PENDING.
+  using DiskOperation = base::Callback<int(const CompletionCallback&)>;
+
+  static const int kNumStreams = 3;
+
+  ~HybridEntryImpl() override;
+
+  // Runs |operation| on |disk_entry_|, opening it first if needed. Returns
+  // ERR_FAILED if the disk entry cannot be opened, as happens once the entry
+  // is doomed.
+  int RunDiskOperation(const DiskOperation& operation,
+                       const CompletionCallback& callback);
+
+  // Starts opening |disk_entry_|, unless the entry is doomed.
+  void OpenDiskEntry();
+  void OnDiskEntryOpened(int result);
+  void RunQueuedDiskOperation(const DiskOperation& operation,
+                              const CompletionCallback& callback);
+
+  // Closes |disk_entry_|, keeping what is needed to answer GetDataSize() and
+  // CouldBeSparse() without it.
+  void CloseDiskEntry();
+
+  // The operations run on |disk_entry_| on behalf of the Entry methods.
+  int DiskReadData(int index,
+                   int offset,
+                   const scoped_refptr<IOBuffer>& buf,
+                   int buf_len,
+                   const CompletionCallback& callback);
+  int DiskWriteData(int index,
+                    int offset,
+                    const scoped_refptr<IOBuffer>& buf,
+                    int buf_len,
+                    bool truncate,
+                    const CompletionCallback& callback);
+  int DiskReadSparseData(int64_t offset,
+                         const scoped_refptr<IOBuffer>& buf,
+                         int buf_len,
+                         const CompletionCallback& callback);
+  int DiskWriteSparseData(int64_t offset,
+                          const scoped_refptr<IOBuffer>& buf,
+                          int buf_len,
+                          const CompletionCallback& callback);
+  int DiskGetAvailableRange(int64_t offset,
+                            int len,
+                            int64_t* start,
+                            const CompletionCallback& callback);
+  int DiskReadyForSparseIO(const CompletionCallback& callback);
+
+  // Keeps stream |index| in memory if |result|, the result of a read from its
+  // start into |buf|, is the whole stream, and the stream was not written to
+  // since |write_count| was sampled.
+  void MaybeKeepStream(int index,
+                       IOBuffer* buf,
+                       uint64_t write_count,
+                       int result);
+  void OnDiskReadComplete(int index,
+                          const scoped_refptr<IOBuffer>& buf,
+                          uint64_t write_count,
+                          const CompletionCallback& callback,
+                          int result);
+  // Runs |callback|, if not null, with |result| once the write back is
+  // accounted for.
+  void OnWriteBackComplete(int buf_len,
+                           const CompletionCallback& callback,
+                           int result);
+
+  // Stops keeping stream |index| in memory.
+  void DropStream(int index);
+
+  // Some disk backends keep the sparse data of an entry in its regular streams,
+  // which thus are no longer served from memory once the sparse API is used.
+  void PrepareForSparseIO();
+
+  // Updates the times of the entry, and its place in the backend's LRU list.
+  void UpdateStateOnUse(bool modified);
+
+  void ModifyStorageSize(int32_t delta);
+
+  base::WeakPtr<HybridBackendImpl> backend_;
+  const std::string key_;
+
+  // The streams kept in memory, as flagged by |in_memory_|. |data_size_| holds
+  // the size of the other streams as of the last disk operation on them.
+  std::vector<char> data_[kNumStreams];
+  bool in_memory_[kNumStreams];
+  int32_t data_size_[kNumStreams];
+
+  // Counts the writes to each stream, so that a read from the disk which
+  // raced with a write is not kept in memory.
+  uint64_t write_count_[kNumStreams];
+
+  base::Time last_used_;
+  base::Time last_modified_;
+  bool could_be_sparse_;
+
+  // The number of callers holding the entry open.
+  int open_count_;
+
+  // Whether the entry is in its backend's map and LRU list.
+  bool in_backend_;
+  bool doomed_;
+
+  Entry* disk_entry_;
+
+  // While the disk entry is being opened, |opening_disk_entry_| receives it
+  // and the operations needing it wait in |queued_operations_|.
+  bool opening_;
+  Entry* opening_disk_entry_;
+  std::vector<base::Closure> queued_operations_;
+
+  DISALLOW_COPY_AND_ASSIGN(HybridEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_HYBRID_HYBRID_ENTRY_IMPL_H_
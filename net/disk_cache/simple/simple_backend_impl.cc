@@ -24,6 +24,9 @@
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/sparse_histogram.h"
 #include "base/single_thread_task_runner.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
 #include "base/sys_info.h"
 #include "base/task_runner_util.h"
 #include "base/threading/sequenced_worker_pool.h"
@@ -58,26 +61,67 @@ const size_t kMaxWorkerThreads = 5U;
 
 const char kThreadNamePrefix[] = "SimpleCache";
 
+// Name of the file the simple cache keeps at the top of an unsharded cache
+// directory, see simple_version_upgrade.cc.
+const char kFakeIndexFileName[] = "index";
+
+// Shard |i| of a sharded cache lives in the subdirectory "shard-i".
+const char kShardDirectoryFormat[] = "shard-%d";
+
 // Maximum fraction of the cache that one entry can consume.
 const int kMaxFileRatio = 8;
 
+// Holds one pool per shard, so that a slow disk or a long index flush in one
+// shard cannot take the threads the other shards need. Pools are created the
+// first time a backend with that many shards is initialized.
 class LeakySequencedWorkerPool {
  public:
-  LeakySequencedWorkerPool()
-      : sequenced_worker_pool_(
-            new SequencedWorkerPool(kMaxWorkerThreads,
-                                    kThreadNamePrefix,
-                                    base::TaskPriority::USER_BLOCKING)) {}
-
-  void FlushForTesting() { sequenced_worker_pool_->FlushForTesting(); }
+  LeakySequencedWorkerPool() {}
+
+  void FlushForTesting() {
+    std::vector<scoped_refptr<SequencedWorkerPool>> pools;
+    {
+      base::AutoLock auto_lock(lock_);
+      for (const auto& pool : sequenced_worker_pools_) {
+        if (pool)
+          pools.push_back(pool);
+      }
+    }
+    for (const auto& pool : pools)
+      pool->FlushForTesting();
+  }
 
-  scoped_refptr<base::TaskRunner> GetTaskRunner() {
-    return sequenced_worker_pool_->GetTaskRunnerWithShutdownBehavior(
+  scoped_refptr<base::TaskRunner> GetTaskRunner(int shard) {
+    return GetPool(shard)->GetTaskRunnerWithShutdownBehavior(
         SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
   }
 
+  // Returns a new sequence on the pool of |shard|; used for index writes.
+  scoped_refptr<base::SequencedTaskRunner> GetSequencedTaskRunner(int shard) {
+    SequencedWorkerPool* pool = GetPool(shard);
+    return pool->GetSequencedTaskRunnerWithShutdownBehavior(
+        pool->GetSequenceToken(), SequencedWorkerPool::BLOCK_SHUTDOWN);
+  }
+
  private:
-  scoped_refptr<SequencedWorkerPool> sequenced_worker_pool_;
+  SequencedWorkerPool* GetPool(int shard) {
+    DCHECK_LE(0, shard);
+    DCHECK_GT(SimpleBackendImpl::kMaxShards, shard);
+    base::AutoLock auto_lock(lock_);
+    scoped_refptr<SequencedWorkerPool>& pool = sequenced_worker_pools_[shard];
+    if (!pool) {
+      std::string thread_name_prefix = kThreadNamePrefix;
+      if (shard > 0)
+        thread_name_prefix += base::IntToString(shard);
+      pool = new SequencedWorkerPool(kMaxWorkerThreads, thread_name_prefix,
+                                     base::TaskPriority::USER_BLOCKING);
+    }
+    return pool.get();
+  }
+
+  base::Lock lock_;
+  scoped_refptr<SequencedWorkerPool>
+      sequenced_worker_pools_[SimpleBackendImpl::kMaxShards];
 
   DISALLOW_COPY_AND_ASSIGN(LeakySequencedWorkerPool);
 };
@@ -137,6 +181,32 @@ bool FileStructureConsistent(const base::FilePath& path) {
   return disk_cache::UpgradeSimpleCacheOnDisk(path);
 }
 
+// Returns the directory of shard |shard| out of |num_shards| in |path|.
+base::FilePath GetShardPath(const base::FilePath& path,
+                            int num_shards,
+                            int shard) {
+  if (num_shards == 1)
+    return path;
+  return path.AppendASCII(base::StringPrintf(kShardDirectoryFormat, shard));
+}
+
+// Returns true if |path| holds no cache yet, or a cache split into exactly
+// |num_shards| shards. Entries are routed by hash modulo the shard count, so
+// a cache created with a different count would silently lose most entries.
+bool ShardLayoutConsistent(const base::FilePath& path, int num_shards) {
+  int existing_shards = 0;
+  while (existing_shards <= SimpleBackendImpl::kMaxShards &&
+         base::DirectoryExists(path.AppendASCII(base::StringPrintf(
+             kShardDirectoryFormat, existing_shards)))) {
+    ++existing_shards;
+  }
+  if (num_shards == 1)
+    return existing_shards == 0;
+  if (base::PathExists(path.AppendASCII(kFakeIndexFileName)))
+    return false;
+  return existing_shards == 0 || existing_shards == num_shards;
+}
+
 // A context used by a BarrierCompletionCallback to track state.
 struct BarrierContext {
   BarrierContext(int expected)
@@ -229,6 +299,20 @@ class SimpleBackendImpl::ActiveEntryProxy
   base::WeakPtr<SimpleBackendImpl> backend_;
 };
 
+SimpleBackendImpl::Shard::Shard(const base::FilePath& path) : path(path) {}
+
+SimpleBackendImpl::Shard::~Shard() {}
+
+SimpleBackendImpl::DiskStatResult::DiskStatResult() {}
+
+SimpleBackendImpl::DiskStatResult::DiskStatResult(
+    const DiskStatResult& other) = default;
+
+SimpleBackendImpl::DiskStatResult::~DiskStatResult() {}
+
+// static
+const int SimpleBackendImpl::kMaxShards;
+
 SimpleBackendImpl::SimpleBackendImpl(
     const FilePath& path,
     int max_bytes,
@@ -238,6 +322,7 @@ SimpleBackendImpl::SimpleBackendImpl(
     : path_(path),
       cache_type_(cache_type),
       cache_thread_(cache_thread),
+      num_shards_(1),
       orig_max_size_(max_bytes),
       entry_operations_mode_(cache_type == net::DISK_CACHE ?
                                  SimpleEntryImpl::OPTIMISTIC_OPERATIONS :
@@ -247,24 +332,54 @@ SimpleBackendImpl::SimpleBackendImpl(
 }
 
 SimpleBackendImpl::~SimpleBackendImpl() {
-  index_->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN);
+  for (const auto& shard : shards_)
+    shard->index->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN);
 }
 
-int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
-  worker_pool_ = g_sequenced_worker_pool.Get().GetTaskRunner();
+SimpleIndex* SimpleBackendImpl::GetIndexForHash(uint64_t entry_hash) {
+  return GetShardForHash(entry_hash)->index.get();
+}
 
-  index_.reset(new SimpleIndex(
-      base::ThreadTaskRunnerHandle::Get(), this, cache_type_,
-      base::WrapUnique(new SimpleIndexFile(cache_thread_, worker_pool_.get(),
-                                           cache_type_, path_))));
-  index_->ExecuteWhenReady(
-      base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
+base::TaskRunner* SimpleBackendImpl::GetWorkerPoolForHash(
+    uint64_t entry_hash) {
+  return GetShardForHash(entry_hash)->worker_pool.get();
+}
+
+bool SimpleBackendImpl::SetNumShards(int num_shards) {
+  DCHECK(shards_.empty());
+  if (num_shards < 1 || num_shards > kMaxShards)
+    return false;
+  num_shards_ = num_shards;
+  return true;
+}
+
+int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
+  const base::TimeTicks init_start = base::TimeTicks::Now();
+  for (int i = 0; i < num_shards_; ++i) {
+    std::unique_ptr<Shard> shard(
+        new Shard(GetShardPath(path_, num_shards_, i)));
+    shard->worker_pool = g_sequenced_worker_pool.Get().GetTaskRunner(i);
+
+    // With several shards every index gets its own sequence for writes, so
+    // that flushing a large index does not hold back the others.
+    scoped_refptr<base::SequencedTaskRunner> index_runner = cache_thread_;
+    if (num_shards_ > 1)
+      index_runner = g_sequenced_worker_pool.Get().GetSequencedTaskRunner(i);
+    shard->index.reset(new SimpleIndex(
+        base::ThreadTaskRunnerHandle::Get(), this, cache_type_,
+        base::WrapUnique(new SimpleIndexFile(index_runner,
+                                             shard->worker_pool.get(),
+                                             cache_type_, shard->path))));
+    shards_.push_back(std::move(shard));
+  }
+  ExecuteWhenIndexReady(
+      base::Bind(&RecordIndexLoad, cache_type_, init_start));
 
   PostTaskAndReplyWithResult(
       cache_thread_.get(),
       FROM_HERE,
-      base::Bind(
-          &SimpleBackendImpl::InitCacheStructureOnDisk, path_, orig_max_size_),
+      base::Bind(&SimpleBackendImpl::InitCacheStructureOnDisk, path_,
+                 num_shards_, orig_max_size_),
       base::Bind(&SimpleBackendImpl::InitializeIndex,
                  AsWeakPtr(),
                  completion_callback));
@@ -275,12 +390,26 @@ bool SimpleBackendImpl::SetMaxSize(int max_bytes) {
   if (max_bytes < 0)
     return false;
   orig_max_size_ = max_bytes;
-  index_->SetMaxSize(max_bytes);
+  for (const auto& shard : shards_)
+    shard->index->SetMaxSize(max_bytes / shards_.size());
   return true;
 }
 
 int SimpleBackendImpl::GetMaxFileSize() const {
-  return static_cast<int>(index_->max_size() / kMaxFileRatio);
+  // All shards get the same share of the cache, and an entry has to fit in
+  // the share of its own shard.
+  return static_cast<int>(shards_[0]->index->max_size() / kMaxFileRatio);
+}
+
+int SimpleBackendImpl::ExecuteWhenIndexReady(
+    const CompletionCallback& callback) {
+  if (shards_.size() == 1)
+    return shards_[0]->index->ExecuteWhenReady(callback);
+  net::CompletionCallback barrier_callback =
+      MakeBarrierCompletionCallback(shards_.size(), callback);
+  for (const auto& shard : shards_)
+    shard->index->ExecuteWhenReady(barrier_callback);
+  return net::ERR_IO_PENDING;
 }
 
 void SimpleBackendImpl::OnDoomStart(uint64_t entry_hash) {
@@ -329,39 +458,60 @@ void SimpleBackendImpl::DoomEntries(std::vector<uint64_t>* entry_hashes,
     mass_doom_entry_hashes->resize(mass_doom_entry_hashes->size() - 1);
   }
 
-  net::CompletionCallback barrier_callback =
-      MakeBarrierCompletionCallback(to_doom_individually_hashes.size() + 1,
-                                    callback);
+  // The files of each shard are deleted by a DoomEntrySet() on that shard's
+  // own worker pool. Shard 0 gets one even when there is nothing to delete,
+  // so that |callback| always runs asynchronously.
+  std::vector<std::unique_ptr<std::vector<uint64_t>>> shard_doom_entry_hashes(
+      shards_.size());
+  if (shards_.size() == 1) {
+    shard_doom_entry_hashes[0] = std::move(mass_doom_entry_hashes);
+  } else {
+    shard_doom_entry_hashes[0].reset(new std::vector<uint64_t>());
+    for (const uint64_t entry_hash : *mass_doom_entry_hashes) {
+      std::unique_ptr<std::vector<uint64_t>>& shard_hashes =
+          shard_doom_entry_hashes[entry_hash % shards_.size()];
+      if (!shard_hashes)
+        shard_hashes.reset(new std::vector<uint64_t>());
+      shard_hashes->push_back(entry_hash);
+    }
+  }
+  int mass_doom_count = 0;
+  for (const auto& shard_hashes : shard_doom_entry_hashes) {
+    if (shard_hashes)
+      ++mass_doom_count;
+  }
+
+  net::CompletionCallback barrier_callback = MakeBarrierCompletionCallback(
+      to_doom_individually_hashes.size() + mass_doom_count, callback);
   for (std::vector<uint64_t>::const_iterator
            it = to_doom_individually_hashes.begin(),
            end = to_doom_individually_hashes.end();
        it != end; ++it) {
     const int doom_result = DoomEntryFromHash(*it, barrier_callback);
     DCHECK_EQ(net::ERR_IO_PENDING, doom_result);
-    index_->Remove(*it);
+    GetIndexForHash(*it)->Remove(*it);
   }
 
-  for (std::vector<uint64_t>::const_iterator
-           it = mass_doom_entry_hashes->begin(),
-           end = mass_doom_entry_hashes->end();
-       it != end; ++it) {
-    index_->Remove(*it);
-    OnDoomStart(*it);
-  }
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (!shard_doom_entry_hashes[i])
+      continue;
+    for (const uint64_t entry_hash : *shard_doom_entry_hashes[i]) {
+      shards_[i]->index->Remove(entry_hash);
+      OnDoomStart(entry_hash);
+    }
 
-  // Taking this pointer here avoids undefined behaviour from calling
-  // base::Passed before mass_doom_entry_hashes.get().
-  std::vector<uint64_t>* mass_doom_entry_hashes_ptr =
-      mass_doom_entry_hashes.get();
-  PostTaskAndReplyWithResult(worker_pool_.get(),
-                             FROM_HERE,
-                             base::Bind(&SimpleSynchronousEntry::DoomEntrySet,
-                                        mass_doom_entry_hashes_ptr,
-                                        path_),
-                             base::Bind(&SimpleBackendImpl::DoomEntriesComplete,
-                                        AsWeakPtr(),
-                                        base::Passed(&mass_doom_entry_hashes),
-                                        barrier_callback));
+    // Taking this pointer here avoids undefined behaviour from calling
+    // base::Passed before shard_doom_entry_hashes[i].get().
+    std::vector<uint64_t>* mass_doom_entry_hashes_ptr =
+        shard_doom_entry_hashes[i].get();
+    PostTaskAndReplyWithResult(
+        shards_[i]->worker_pool.get(), FROM_HERE,
+        base::Bind(&SimpleSynchronousEntry::DoomEntrySet,
+                   mass_doom_entry_hashes_ptr, shards_[i]->path),
+        base::Bind(&SimpleBackendImpl::DoomEntriesComplete, AsWeakPtr(),
+                   base::Passed(&shard_doom_entry_hashes[i]),
+                   barrier_callback));
+  }
 }
 
 net::CacheType SimpleBackendImpl::GetCacheType() const {
@@ -370,7 +520,10 @@ net::CacheType SimpleBackendImpl::GetCacheType() const {
 
 int32_t SimpleBackendImpl::GetEntryCount() const {
   // TODO(pasko): Use directory file count when index is not ready.
-  return index_->GetEntryCount();
+  int32_t entry_count = 0;
+  for (const auto& shard : shards_)
+    entry_count += shard->index->GetEntryCount();
+  return entry_count;
 }
 
 int SimpleBackendImpl::OpenEntry(const std::string& key,
@@ -442,7 +595,7 @@ int SimpleBackendImpl::DoomEntriesBetween(
     const Time initial_time,
     const Time end_time,
     const CompletionCallback& callback) {
-  return index_->ExecuteWhenReady(
+  return ExecuteWhenIndexReady(
       base::Bind(&SimpleBackendImpl::IndexReadyForDoom, AsWeakPtr(),
                  initial_time, end_time, callback));
 }
@@ -455,7 +608,7 @@ int SimpleBackendImpl::DoomEntriesSince(
 
 int SimpleBackendImpl::CalculateSizeOfAllEntries(
     const CompletionCallback& callback) {
-  return index_->ExecuteWhenReady(base::Bind(
+  return ExecuteWhenIndexReady(base::Bind(
       &SimpleBackendImpl::IndexReadyForSizeCalculation, AsWeakPtr(), callback));
 }
 
@@ -472,7 +625,7 @@ class SimpleBackendImpl::SimpleIterator final : public Iterator {
     CompletionCallback open_next_entry_impl =
         base::Bind(&SimpleIterator::OpenNextEntryImpl,
                    weak_factory_.GetWeakPtr(), next_entry, callback);
-    return backend_->index_->ExecuteWhenReady(open_next_entry_impl);
+    return backend_->ExecuteWhenIndexReady(open_next_entry_impl);
   }
 
   void OpenNextEntryImpl(Entry** next_entry,
@@ -486,13 +639,21 @@ class SimpleBackendImpl::SimpleIterator final : public Iterator {
       callback.Run(index_initialization_error_code);
       return;
     }
-    if (!hashes_to_enumerate_)
-      hashes_to_enumerate_ = backend_->index()->GetAllHashes();
+    if (!hashes_to_enumerate_) {
+      hashes_to_enumerate_.reset(new std::vector<uint64_t>());
+      for (const auto& shard : backend_->shards_) {
+        std::unique_ptr<std::vector<uint64_t>> shard_hashes =
+            shard->index->GetAllHashes();
+        hashes_to_enumerate_->insert(hashes_to_enumerate_->end(),
+                                     shard_hashes->begin(),
+                                     shard_hashes->end());
+      }
+    }
 
     while (!hashes_to_enumerate_->empty()) {
       uint64_t entry_hash = hashes_to_enumerate_->back();
       hashes_to_enumerate_->pop_back();
-      if (backend_->index()->Has(entry_hash)) {
+      if (backend_->GetIndexForHash(entry_hash)->Has(entry_hash)) {
         *next_entry = NULL;
         CompletionCallback continue_iteration = base::Bind(
             &SimpleIterator::CheckIterationReturnValue,
@@ -541,14 +702,18 @@ void SimpleBackendImpl::GetStats(base::StringPairs* stats) {
 }
 
 void SimpleBackendImpl::OnExternalCacheHit(const std::string& key) {
-  index_->UseIfExists(simple_util::GetEntryHashKey(key));
+  const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  GetIndexForHash(entry_hash)->UseIfExists(entry_hash);
 }
 
 void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
                                         const DiskStatResult& result) {
   if (result.net_error == net::OK) {
-    index_->SetMaxSize(result.max_size);
-    index_->Initialize(result.cache_dir_mtime);
+    DCHECK_EQ(shards_.size(), result.cache_dir_mtimes.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      shards_[i]->index->SetMaxSize(result.max_size / shards_.size());
+      shards_[i]->index->Initialize(result.cache_dir_mtimes[i]);
+    }
   }
   callback.Run(result.net_error);
 }
@@ -561,39 +726,65 @@ void SimpleBackendImpl::IndexReadyForDoom(Time initial_time,
     callback.Run(result);
     return;
   }
-  std::unique_ptr<std::vector<uint64_t>> removed_key_hashes(
-      index_->GetEntriesBetween(initial_time, end_time).release());
-  DoomEntries(removed_key_hashes.get(), callback);
+  std::vector<uint64_t> removed_key_hashes;
+  for (const auto& shard : shards_) {
+    std::unique_ptr<std::vector<uint64_t>> shard_hashes =
+        shard->index->GetEntriesBetween(initial_time, end_time);
+    removed_key_hashes.insert(removed_key_hashes.end(), shard_hashes->begin(),
+                              shard_hashes->end());
+  }
+  DoomEntries(&removed_key_hashes, callback);
 }
 
 void SimpleBackendImpl::IndexReadyForSizeCalculation(
     const CompletionCallback& callback,
     int result) {
-  if (result == net::OK)
-    result = static_cast<int>(index_->GetCacheSize());
+  if (result == net::OK) {
+    uint64_t cache_size = 0;
+    for (const auto& shard : shards_)
+      cache_size += shard->index->GetCacheSize();
+    result = static_cast<int>(cache_size);
+  }
   callback.Run(result);
 }
 
 SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     const base::FilePath& path,
+    int num_shards,
     uint64_t suggested_max_size) {
   DiskStatResult result;
   result.max_size = suggested_max_size;
   result.net_error = net::OK;
-  if (!FileStructureConsistent(path)) {
-    LOG(ERROR) << "Simple Cache Backend: wrong file structure on disk: "
-               << path.LossyDisplayName();
+  if (!base::PathExists(path) && !base::CreateDirectory(path)) {
+    LOG(ERROR) << "Failed to create directory: " << path.LossyDisplayName();
     result.net_error = net::ERR_FAILED;
-  } else {
+    return result;
+  }
+  if (!ShardLayoutConsistent(path, num_shards)) {
+    LOG(ERROR) << "Simple Cache Backend: cache was not created with "
+               << num_shards << " shards: " << path.LossyDisplayName();
+    result.net_error = net::ERR_FAILED;
+    return result;
+  }
+  for (int i = 0; i < num_shards; ++i) {
+    const base::FilePath shard_path = GetShardPath(path, num_shards, i);
+    base::Time shard_mtime;
+    if (!FileStructureConsistent(shard_path)) {
+      LOG(ERROR) << "Simple Cache Backend: wrong file structure on disk: "
+                 << shard_path.LossyDisplayName();
+      result.net_error = net::ERR_FAILED;
+      return result;
+    }
     bool mtime_result =
-        disk_cache::simple_util::GetMTime(path, &result.cache_dir_mtime);
+        disk_cache::simple_util::GetMTime(shard_path, &shard_mtime);
     DCHECK(mtime_result);
-    if (!result.max_size) {
-      int64_t available = base::SysInfo::AmountOfFreeDiskSpace(path);
-      result.max_size = disk_cache::PreferredCacheSize(available);
-    }
-    DCHECK(result.max_size);
+    result.cache_dir_mtimes.push_back(shard_mtime);
   }
+  if (!result.max_size) {
+    int64_t available = base::SysInfo::AmountOfFreeDiskSpace(path);
+    result.max_size = disk_cache::PreferredCacheSize(available);
+  }
+  DCHECK(result.max_size);
   return result;
 }
 
@@ -607,8 +798,8 @@ scoped_refptr<SimpleEntryImpl> SimpleBackendImpl::CreateOrFindActiveEntry(
   const bool did_insert = insert_result.second;
   if (did_insert) {
     SimpleEntryImpl* entry = it->second =
-        new SimpleEntryImpl(cache_type_, path_, entry_hash,
-                            entry_operations_mode_,this, net_log_);
+        new SimpleEntryImpl(cache_type_, GetShardForHash(entry_hash)->path,
+                            entry_hash, entry_operations_mode_, this, net_log_);
     entry->SetKey(key);
     entry->SetActiveEntryProxy(ActiveEntryProxy::Create(entry_hash, this));
   }
@@ -642,8 +833,9 @@ int SimpleBackendImpl::OpenEntryFromHash(uint64_t entry_hash,
     return OpenEntry(has_active->second->key(), entry, callback);
   }
 
-  scoped_refptr<SimpleEntryImpl> simple_entry = new SimpleEntryImpl(
-      cache_type_, path_, entry_hash, entry_operations_mode_, this, net_log_);
+  scoped_refptr<SimpleEntryImpl> simple_entry =
+      new SimpleEntryImpl(cache_type_, GetShardForHash(entry_hash)->path,
+                          entry_hash, entry_operations_mode_, this, net_log_);
   CompletionCallback backend_callback =
       base::Bind(&SimpleBackendImpl::OnEntryOpenedFromHash,
                  AsWeakPtr(), entry_hash, entry, simple_entry, callback);
@@ -717,6 +909,12 @@ void SimpleBackendImpl::DoomEntriesComplete(
   callback.Run(result);
 }
 
+SimpleBackendImpl::Shard* SimpleBackendImpl::GetShardForHash(
+    uint64_t entry_hash) {
+  DCHECK(!shards_.empty());
+  return shards_[entry_hash % shards_.size()].get();
+}
+
 // static
 void SimpleBackendImpl::FlushWorkerPoolForTesting() {
   // We only need to do this if we there is an active task runner.
@@ -61,10 +61,26 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   ~SimpleBackendImpl() override;
 
+  // Upper bound for SetNumShards().
+  static const int kMaxShards = 16;
+
   net::CacheType cache_type() const { return cache_type_; }
-  SimpleIndex* index() { return index_.get(); }
 
-  base::TaskRunner* worker_pool() { return worker_pool_.get(); }
+  // Returns the index of the first shard, which is the only index unless
+  // SetNumShards() was called.
+  SimpleIndex* index() {
+    return shards_.empty() ? nullptr : shards_[0]->index.get();
+  }
+
+  // Returns the index and the worker pool of the shard holding |entry_hash|.
+  SimpleIndex* GetIndexForHash(uint64_t entry_hash);
+  base::TaskRunner* GetWorkerPoolForHash(uint64_t entry_hash);
+
+  // Splits the cache into |num_shards| subdirectories of |path|, each with its
+  // own index and its own worker pool, and routes entries between them by
+  // hash. Must be called before Init(). A cache directory only ever opens
+  // with the shard count it was created with; Init() fails otherwise.
+  bool SetNumShards(int num_shards);
 
   int Init(const CompletionCallback& completion_callback);
 
@@ -74,7 +90,10 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   // Returns the maximum file size permitted in this backend.
   int GetMaxFileSize() const;
 
-  // Flush our SequencedWorkerPool.
+  // Runs |callback| once the indexes of all shards are initialized.
+  int ExecuteWhenIndexReady(const CompletionCallback& callback);
+
+  // Flush our SequencedWorkerPools.
   static void FlushWorkerPoolForTesting();
 
   // The entry for |entry_hash| is being doomed; the backend will not attempt
@@ -124,9 +143,25 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   class ActiveEntryProxy;
   friend class ActiveEntryProxy;
 
+  // The directory, index and worker pool serving one slice of the entry hash
+  // space.
+  struct Shard {
+    explicit Shard(const base::FilePath& path);
+    ~Shard();
+
+    const base::FilePath path;
+    std::unique_ptr<SimpleIndex> index;
+    scoped_refptr<base::TaskRunner> worker_pool;
+  };
+
   // Return value of InitCacheStructureOnDisk().
   struct DiskStatResult {
-    base::Time cache_dir_mtime;
+    DiskStatResult();
+    DiskStatResult(const DiskStatResult& other);
+    ~DiskStatResult();
+
+    // One modification time per shard directory.
+    std::vector<base::Time> cache_dir_mtimes;
     uint64_t max_size;
     bool detected_magic_number_mismatch;
     int net_error;
@@ -146,11 +181,15 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   void IndexReadyForSizeCalculation(const CompletionCallback& callback,
                                     int result);
 
-  // Try to create the directory if it doesn't exist. This must run on the IO
-  // thread.
+  // Try to create the directory, and the directories of its |num_shards|
+  // shards, if they don't exist. This must run on the IO thread.
   static DiskStatResult InitCacheStructureOnDisk(const base::FilePath& path,
+                                                 int num_shards,
                                                  uint64_t suggested_max_size);
 
+  // Returns the shard holding |entry_hash|.
+  Shard* GetShardForHash(uint64_t entry_hash);
+
   // Searches |active_entries_| for the entry corresponding to |key|. If found,
   // returns the found entry. Otherwise, creates a new entry and returns that.
   scoped_refptr<SimpleEntryImpl> CreateOrFindActiveEntry(
@@ -197,9 +236,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   const base::FilePath path_;
   const net::CacheType cache_type_;
-  std::unique_ptr<SimpleIndex> index_;
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
-  scoped_refptr<base::TaskRunner> worker_pool_;
+
+  // |shards_| is populated by Init(); a single shard lives directly in
+  // |path_|.
+  int num_shards_;
+  std::vector<std::unique_ptr<Shard>> shards_;
 
   int orig_max_size_;
   const SimpleEntryImpl::OperationsMode entry_operations_mode_;
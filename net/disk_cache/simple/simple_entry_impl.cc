@@ -172,7 +172,7 @@ SimpleEntryImpl::SimpleEntryImpl(net::CacheType cache_type,
                                  net::NetLog* net_log)
     : backend_(backend->AsWeakPtr()),
       cache_type_(cache_type),
-      worker_pool_(backend->worker_pool()),
+      worker_pool_(backend->GetWorkerPoolForHash(entry_hash)),
       path_(path),
       entry_hash_(entry_hash),
       use_optimistic_operations_(operations_mode == OPTIMISTIC_OPERATIONS),
@@ -211,7 +211,7 @@ int SimpleEntryImpl::OpenEntry(Entry** out_entry,
 
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_CALL);
 
-  bool have_index = backend_->index()->initialized();
+  bool have_index = backend_->GetIndexForHash(entry_hash_)->initialized();
   // This enumeration is used in histograms, add entries only at end.
   enum OpenEntryIndexEnum {
     INDEX_NOEXIST = 0,
@@ -221,7 +221,7 @@ int SimpleEntryImpl::OpenEntry(Entry** out_entry,
   };
   OpenEntryIndexEnum open_entry_index_enum = INDEX_NOEXIST;
   if (have_index) {
-    if (backend_->index()->Has(entry_hash_))
+    if (backend_->GetIndexForHash(entry_hash_)->Has(entry_hash_))
       open_entry_index_enum = INDEX_HIT;
     else
       open_entry_index_enum = INDEX_MISS;
@@ -251,7 +251,7 @@ int SimpleEntryImpl::CreateEntry(Entry** out_entry,
 
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_CREATE_CALL);
 
-  bool have_index = backend_->index()->initialized();
+  bool have_index = backend_->GetIndexForHash(entry_hash_)->initialized();
   int ret_value = net::ERR_FAILED;
   if (use_optimistic_operations_ &&
       state_ == STATE_UNINITIALIZED && pending_operations_.size() == 0) {
@@ -272,7 +272,7 @@ int SimpleEntryImpl::CreateEntry(Entry** out_entry,
   // have the entry in the index but we don't have the created files yet, this
   // way we never leak files. CreationOperationComplete will remove the entry
   // from the index if the creation fails.
-  backend_->index()->Insert(entry_hash_);
+  backend_->GetIndexForHash(entry_hash_)->Insert(entry_hash_);
 
   RunNextOperationIfNeeded();
   return ret_value;
@@ -590,7 +590,7 @@ void SimpleEntryImpl::MarkAsDoomed() {
   doomed_ = true;
   if (!backend_.get())
     return;
-  backend_->index()->Remove(entry_hash_);
+  backend_->GetIndexForHash(entry_hash_)->Remove(entry_hash_);
   active_entry_proxy_.reset();
 }
 
@@ -858,7 +858,7 @@ void SimpleEntryImpl::ReadDataInternal(int stream_index,
 
   state_ = STATE_IO_PENDING;
   if (!doomed_ && backend_.get())
-    backend_->index()->UseIfExists(entry_hash_);
+    backend_->GetIndexForHash(entry_hash_)->UseIfExists(entry_hash_);
 
   std::unique_ptr<uint32_t> read_crc32(new uint32_t());
   std::unique_ptr<int> result(new int());
@@ -936,7 +936,7 @@ void SimpleEntryImpl::WriteDataInternal(int stream_index,
   }
   state_ = STATE_IO_PENDING;
   if (!doomed_ && backend_.get())
-    backend_->index()->UseIfExists(entry_hash_);
+    backend_->GetIndexForHash(entry_hash_)->UseIfExists(entry_hash_);
 
   AdvanceCrc(buf, offset, buf_len, stream_index);
 
@@ -1026,7 +1026,8 @@ void SimpleEntryImpl::WriteSparseDataInternal(
 
   uint64_t max_sparse_data_size = std::numeric_limits<int64_t>::max();
   if (backend_.get()) {
-    uint64_t max_cache_size = backend_->index()->max_size();
+    uint64_t max_cache_size =
+        backend_->GetIndexForHash(entry_hash_)->max_size();
     max_sparse_data_size = max_cache_size / kMaxSparseDataSizeDivisor;
   }
 
@@ -1393,7 +1394,7 @@ void SimpleEntryImpl::UpdateDataFromEntryStat(
   }
   sparse_data_size_ = entry_stat.sparse_data_size();
   if (!doomed_ && backend_.get()) {
-    backend_->index()->UpdateEntrySize(
+    backend_->GetIndexForHash(entry_hash_)->UpdateEntrySize(
         entry_hash_, base::checked_cast<uint32_t>(GetDiskUsage()));
   }
 }
@@ -49,6 +49,12 @@ const uint32_t kEvictionMarginDivisor = 20;
 
 const uint32_t kBytesInKb = 1024;
 
+// The index file is rewritten, rather than appended to its journal, once the
+// journal holds more changes than the larger of these two: a minimum, and a
+// fraction of the entries in the index.
+const uint64_t kMinJournalEntriesBeforeCompaction = 1000;
+const uint64_t kJournalCompactionDivisor = 2;
+
 // Utility class used for timestamp comparisons in entry metadata while sorting.
 class CompareHashesForTimestamp {
   typedef disk_cache::SimpleIndex SimpleIndex;
@@ -151,6 +157,8 @@ SimpleIndex::SimpleIndex(
       high_watermark_(0),
       low_watermark_(0),
       eviction_in_progress_(false),
+      journal_valid_(false),
+      journal_entry_count_(0),
       initialized_(false),
       init_method_(INITIALIZE_METHOD_MAX),
       index_file_(std::move(index_file)),
@@ -255,6 +263,7 @@ void SimpleIndex::Insert(uint64_t entry_hash) {
   // creating the new entry, and then UpdateEntrySize will be called.
   InsertInEntrySet(entry_hash, EntryMetadata(base::Time::Now(), 0u),
                    &entries_set_);
+  changed_entries_.insert(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
   PostponeWritingToDisk();
@@ -267,6 +276,7 @@ void SimpleIndex::Remove(uint64_t entry_hash) {
     UpdateEntryIteratorSize(&it, 0u);
     entries_set_.erase(it);
   }
+  changed_entries_.insert(entry_hash);
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
@@ -288,6 +298,7 @@ bool SimpleIndex::UseIfExists(uint64_t entry_hash) {
     // If not initialized, always return true, forcing it to go to the disk.
     return !initialized_;
   it->second.SetLastUsedTime(base::Time::Now());
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
@@ -349,6 +360,7 @@ bool SimpleIndex::UpdateEntrySize(uint64_t entry_hash,
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -432,6 +444,8 @@ void SimpleIndex::MergeInitializingSet(
   cache_size_ = merged_cache_size;
   initialized_ = true;
   init_method_ = load_result->init_method;
+  journal_valid_ = load_result->journal_valid;
+  journal_entry_count_ = load_result->journal_entry_count;
 
   // The actual IO is asynchronous, so calling WriteToDisk() shouldn't slow the
   // merge down much.
@@ -486,8 +500,33 @@ void SimpleIndex::WriteToDisk(IndexWriteToDiskReason reason) {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(reason, entries_set_, cache_size_, start,
-                           app_on_background_, base::Closure());
+  const uint64_t max_journal_entries =
+      std::max<uint64_t>(kMinJournalEntriesBeforeCompaction,
+                         entries_set_.size() / kJournalCompactionDivisor);
+  if (journal_valid_ &&
+      journal_entry_count_ + changed_entries_.size() <= max_journal_entries) {
+    EntrySet updated_entries;
+    HashList removed_entries;
+    for (uint64_t entry_hash : changed_entries_) {
+      EntrySet::const_iterator it = entries_set_.find(entry_hash);
+      if (it == entries_set_.end())
+        removed_entries.push_back(entry_hash);
+      else
+        updated_entries.insert(*it);
+    }
+    SIMPLE_CACHE_UMA(CUSTOM_COUNTS,
+                     "IndexNumChangesOnJournalWrite", cache_type_,
+                     changed_entries_.size(), 0, 100000, 50);
+    index_file_->AppendToJournal(reason, updated_entries, removed_entries,
+                                 start, app_on_background_, base::Closure());
+    journal_entry_count_ += changed_entries_.size();
+  } else {
+    index_file_->WriteToDisk(reason, entries_set_, cache_size_, start,
+                             app_on_background_, base::Closure());
+    journal_valid_ = true;
+    journal_entry_count_ = 0;
+  }
+  changed_entries_.clear();
 }
 
 }  // namespace disk_cache
@@ -121,6 +121,8 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // iff the entry exist in the index.
   bool UseIfExists(uint64_t entry_hash);
 
+  // Appends the changes since the last write to the journal of the index
+  // file, or rewrites the index file when the journal has grown too long.
   void WriteToDisk(IndexWriteToDiskReason reason);
 
   // Update the size (in bytes) of an entry, in the metadata stored in the
@@ -166,6 +168,8 @@ class NET_EXPORT_PRIVATE SimpleIndex
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteQueued);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteExecuted);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWritePostponed);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteJournaled);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteCompactsJournal);
 
   void StartEvictionIfNeeded();
   void EvictionDone(int result);
@@ -201,6 +205,16 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // This stores all the entry_hash of entries that are removed during
   // initialization.
   std::unordered_set<uint64_t> removed_entries_;
+
+  // The entry_hash of the entries inserted, updated or removed since the index
+  // was last written to disk.
+  std::unordered_set<uint64_t> changed_entries_;
+
+  // Whether the index file on disk has a journal to append the changes to, and
+  // how many changes the journal holds.
+  bool journal_valid_;
+  uint64_t journal_entry_count_;
+
   bool initialized_;
   IndexInitMethod init_method_;
 
@@ -4,6 +4,7 @@
 
 #include "net/disk_cache/simple/simple_index_file.h"
 
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -14,7 +15,7 @@
 #include "base/logging.h"
 #include "base/numerics/safe_conversions.h"
 #include "base/pickle.h"
-#include "base/single_thread_task_runner.h"
+#include "base/sequenced_task_runner.h"
 #include "base/task_runner_util.h"
 #include "base/threading/thread_restrictions.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
@@ -35,6 +36,10 @@ const int kEntryFilesSuffixLength = 2;
 
 const uint64_t kMaxEntriesInIndex = 100000000;
 
+// A journal longer than this is not worth replaying, and is most likely
+// corrupt.
+const int64_t kMaxJournalSize = 256 * 1024 * 1024;
+
 uint32_t CalculatePickleCRC(const base::Pickle& pickle) {
   return crc32(crc32(0, Z_NULL, 0),
                reinterpret_cast<const Bytef*>(pickle.payload()),
@@ -118,6 +123,21 @@ bool WritePickleFile(base::Pickle* pickle, const base::FilePath& file_name) {
   return true;
 }
 
+// Returns the end of the pickle with a header of |header_size| bytes which
+// starts at |start|, or NULL if it does not end before |end|.
+const char* FindPickleEnd(size_t header_size,
+                          const char* start,
+                          const char* end) {
+  DCHECK_GE(header_size, sizeof(base::Pickle::Header));
+  if (static_cast<size_t>(end - start) < header_size)
+    return NULL;
+  const base::Pickle::Header* header =
+      reinterpret_cast<const base::Pickle::Header*>(start);
+  if (header->payload_size > static_cast<size_t>(end - start) - header_size)
+    return NULL;
+  return start + header_size + header->payload_size;
+}
+
 // Called for each cache directory traversal iteration.
 void ProcessEntryFile(SimpleIndex::EntrySet* entries,
                       const base::FilePath& file_path) {
@@ -171,7 +191,9 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
 SimpleIndexLoadResult::SimpleIndexLoadResult()
     : did_load(false),
       index_write_reason(SimpleIndex::INDEX_WRITE_REASON_MAX),
-      flush_required(false) {}
+      flush_required(false),
+      journal_valid(false),
+      journal_entry_count(0) {}
 
 SimpleIndexLoadResult::~SimpleIndexLoadResult() {
 }
@@ -180,6 +202,8 @@ void SimpleIndexLoadResult::Reset() {
   did_load = false;
   index_write_reason = SimpleIndex::INDEX_WRITE_REASON_MAX;
   flush_required = false;
+  journal_valid = false;
+  journal_entry_count = 0;
   entries.clear();
 }
 
@@ -189,6 +213,8 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
+// static
+const char SimpleIndexFile::kJournalFileName[] = "the-real-index-journal";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
     : magic_number_(kSimpleIndexMagicNumber),
@@ -247,11 +273,17 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
                                       const base::FilePath& cache_directory,
                                       const base::FilePath& index_filename,
                                       const base::FilePath& temp_index_filename,
+                                      const base::FilePath& journal_filename,
                                       std::unique_ptr<base::Pickle> pickle,
                                       const base::TimeTicks& start_time,
                                       bool app_on_background) {
   DCHECK_EQ(index_filename.DirName().value(),
             temp_index_filename.DirName().value());
+  // The journal applies to the previous index file, and the records appended
+  // from now on apply to this one, so the journal must not outlive a failure
+  // to replace the index file.
+  simple_util::SimpleCacheDeleteFile(journal_filename);
+
   base::FilePath index_file_directory = temp_index_filename.DirName();
   if (!base::DirectoryExists(index_file_directory) &&
       !base::CreateDirectory(index_file_directory)) {
@@ -282,6 +314,17 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   if (!base::ReplaceFile(temp_index_filename, index_filename, NULL))
     return;
 
+  // Start the journal of the new index file. A journal which cannot be
+  // started is removed; its header would not match the index anyway.
+  base::Pickle journal_header(sizeof(PickleHeader));
+  journal_header.WriteUInt64(kSimpleIndexJournalMagicNumber);
+  journal_header.WriteUInt32(kSimpleVersion);
+  journal_header.WriteUInt32(pickle->headerT<PickleHeader>()->crc);
+  journal_header.headerT<PickleHeader>()->crc =
+      CalculatePickleCRC(journal_header);
+  if (!WritePickleFile(&journal_header, journal_filename))
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+
   if (app_on_background) {
     SIMPLE_CACHE_UMA(TIMES,
                      "IndexWriteToDiskTime.Background", cache_type,
@@ -293,6 +336,47 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   }
 }
 
+// static
+void SimpleIndexFile::SyncAppendToJournal(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& journal_filename,
+    std::unique_ptr<base::Pickle> pickle,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  // Without a journal for the current index file, the record would apply to
+  // the wrong entries. The next write of the index file starts a new one.
+  File file(journal_filename,
+            File::FLAG_OPEN | File::FLAG_APPEND | File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return;
+
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return;
+  }
+  SerializeFinalData(cache_dir_mtime, pickle.get());
+  int bytes_written = file.WriteAtCurrentPos(
+      static_cast<const char*>(pickle->data()), pickle->size());
+  if (bytes_written != base::checked_cast<int>(pickle->size())) {
+    LOG(ERROR) << "Failed to append to the index journal";
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+    return;
+  }
+
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexJournalWriteTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexJournalWriteTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+}
+
 bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
   if (entry_count_ > kMaxEntriesInIndex ||
       magic_number_ != kSimpleIndexMagicNumber) {
@@ -307,7 +391,7 @@ bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
 }
 
 SimpleIndexFile::SimpleIndexFile(
-    const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
+    const scoped_refptr<base::SequencedTaskRunner>& cache_thread,
     const scoped_refptr<base::TaskRunner>& worker_pool,
     net::CacheType cache_type,
     const base::FilePath& cache_directory)
@@ -318,7 +402,9 @@ SimpleIndexFile::SimpleIndexFile(
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
                       .AppendASCII(kIndexFileName)),
       temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+                           .AppendASCII(kTempIndexFileName)),
+      journal_file_(cache_directory_.AppendASCII(kIndexDirectory)
+                        .AppendASCII(kJournalFileName)) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
@@ -329,7 +415,7 @@ void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
                                   cache_type_,
                                   cache_last_modified, cache_directory_,
-                                  index_file_, out_result);
+                                  index_file_, journal_file_, out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
@@ -345,7 +431,28 @@ void SimpleIndexFile::WriteToDisk(SimpleIndex::IndexWriteToDiskReason reason,
   base::Closure task =
       base::Bind(&SimpleIndexFile::SyncWriteToDisk,
                  cache_type_, cache_directory_, index_file_, temp_index_file_,
-                 base::Passed(&pickle), start, app_on_background);
+                 journal_file_, base::Passed(&pickle), start,
+                 app_on_background);
+  if (callback.is_null())
+    cache_thread_->PostTask(FROM_HERE, task);
+  else
+    cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
+}
+
+void SimpleIndexFile::AppendToJournal(
+    SimpleIndex::IndexWriteToDiskReason reason,
+    const SimpleIndex::EntrySet& updated_entries,
+    const SimpleIndex::HashList& removed_entries,
+    const base::TimeTicks& start,
+    bool app_on_background,
+    const base::Closure& callback) {
+  UmaRecordIndexWriteReason(reason, cache_type_);
+  std::unique_ptr<base::Pickle> pickle =
+      SerializeJournalRecord(reason, updated_entries, removed_entries);
+  base::Closure task =
+      base::Bind(&SimpleIndexFile::SyncAppendToJournal, cache_type_,
+                 cache_directory_, journal_file_, base::Passed(&pickle), start,
+                 app_on_background);
   if (callback.is_null())
     cache_thread_->PostTask(FROM_HERE, task);
   else
@@ -358,10 +465,12 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    const base::FilePath& journal_file_path,
     SimpleIndexLoadResult* out_result) {
   // Load the index and find its age.
   base::Time last_cache_seen_by_index;
-  SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  SyncLoadFromDisk(index_file_path, journal_file_path,
+                   &last_cache_seen_by_index, out_result);
 
   // Consider the index loaded if it is fresh.
   const bool index_file_existed = base::PathExists(index_file_path);
@@ -424,9 +533,11 @@ void SimpleIndexFile::SyncLoadIndexEntries(
 }
 
 // static
-void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
-                                       base::Time* out_last_cache_seen_by_index,
-                                       SimpleIndexLoadResult* out_result) {
+void SimpleIndexFile::SyncLoadFromDisk(
+    const base::FilePath& index_filename,
+    const base::FilePath& journal_filename,
+    base::Time* out_last_cache_seen_by_index,
+    SimpleIndexLoadResult* out_result) {
   out_result->Reset();
 
   File file(index_filename,
@@ -446,8 +557,90 @@ void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
       out_last_cache_seen_by_index,
       out_result);
 
-  if (!out_result->did_load)
+  if (!out_result->did_load) {
     simple_util::SimpleCacheDeleteFile(index_filename);
+    return;
+  }
+
+  const uint32_t index_crc =
+      reinterpret_cast<const PickleHeader*>(index_file_map.data())->crc;
+  SyncReplayJournal(journal_filename, index_crc, out_last_cache_seen_by_index,
+                    out_result);
+}
+
+// static
+void SimpleIndexFile::SyncReplayJournal(
+    const base::FilePath& journal_filename,
+    uint32_t index_crc,
+    base::Time* out_last_cache_seen_by_index,
+    SimpleIndexLoadResult* out_result) {
+  File file(journal_filename, File::FLAG_OPEN | File::FLAG_READ |
+                                  File::FLAG_WRITE | File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return;
+  const int64_t file_length = file.GetLength();
+  if (file_length <= 0 || file_length > kMaxJournalSize) {
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+    return;
+  }
+  std::unique_ptr<char[]> data(new char[file_length]);
+  if (file.Read(0, data.get(), static_cast<int>(file_length)) != file_length)
+    return;
+  const char* const data_end = data.get() + file_length;
+
+  // Check that the journal applies to the loaded index file.
+  const char* record_end =
+      FindPickleEnd(sizeof(PickleHeader), data.get(), data_end);
+  if (!record_end) {
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+    return;
+  }
+  base::Pickle header(data.get(), record_end - data.get());
+  base::PickleIterator header_it(header);
+  uint64_t magic_number;
+  uint32_t version;
+  uint32_t journal_index_crc;
+  if (!header.data() ||
+      header.headerT<PickleHeader>()->crc != CalculatePickleCRC(header) ||
+      !header_it.ReadUInt64(&magic_number) ||
+      !header_it.ReadUInt32(&version) ||
+      !header_it.ReadUInt32(&journal_index_crc) ||
+      magic_number != kSimpleIndexJournalMagicNumber ||
+      version != kSimpleVersion || journal_index_crc != index_crc) {
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+    return;
+  }
+
+  // Replay the records in order. A crash while appending leaves a torn record
+  // at the end, which is dropped.
+  const char* replayed_end = record_end;
+  uint64_t replayed_entry_count = 0;
+  while (replayed_end != data_end) {
+    record_end = FindPickleEnd(sizeof(PickleHeader), replayed_end, data_end);
+    if (!record_end)
+      break;
+    base::Pickle record(replayed_end, record_end - replayed_end);
+    if (!DeserializeJournalRecord(record, out_last_cache_seen_by_index,
+                                  &out_result->index_write_reason,
+                                  &out_result->entries,
+                                  &replayed_entry_count)) {
+      break;
+    }
+    replayed_end = record_end;
+  }
+
+  if (replayed_end != data_end &&
+      !file.SetLength(replayed_end - data.get())) {
+    // Records appended after the torn one would never be replayed.
+    file.Close();
+    simple_util::SimpleCacheDeleteFile(journal_filename);
+  } else {
+    out_result->journal_valid = true;
+  }
+  out_result->journal_entry_count = replayed_entry_count;
 }
 
 // static
@@ -466,6 +659,86 @@ std::unique_ptr<base::Pickle> SimpleIndexFile::Serialize(
   return pickle;
 }
 
+// static
+std::unique_ptr<base::Pickle> SimpleIndexFile::SerializeJournalRecord(
+    SimpleIndex::IndexWriteToDiskReason reason,
+    const SimpleIndex::EntrySet& updated_entries,
+    const SimpleIndex::HashList& removed_entries) {
+  std::unique_ptr<base::Pickle> pickle(
+      new base::Pickle(sizeof(SimpleIndexFile::PickleHeader)));
+
+  pickle->WriteUInt32(static_cast<uint32_t>(reason));
+  pickle->WriteUInt64(updated_entries.size());
+  for (const auto& entry : updated_entries) {
+    pickle->WriteUInt64(entry.first);
+    entry.second.Serialize(pickle.get());
+  }
+  pickle->WriteUInt64(removed_entries.size());
+  for (uint64_t entry_hash : removed_entries)
+    pickle->WriteUInt64(entry_hash);
+  return pickle;
+}
+
+// static
+bool SimpleIndexFile::DeserializeJournalRecord(
+    const base::Pickle& pickle,
+    base::Time* out_cache_last_modified,
+    SimpleIndex::IndexWriteToDiskReason* out_reason,
+    SimpleIndex::EntrySet* entries,
+    uint64_t* entry_count) {
+  if (!pickle.data() ||
+      pickle.headerT<PickleHeader>()->crc != CalculatePickleCRC(pickle)) {
+    LOG(WARNING) << "Invalid record in Simple Index journal.";
+    return false;
+  }
+
+  // Parse the whole record before applying it, so a bad record changes
+  // nothing.
+  base::PickleIterator pickle_it(pickle);
+  uint32_t reason;
+  uint64_t updated_count;
+  if (!pickle_it.ReadUInt32(&reason) ||
+      reason >= SimpleIndex::INDEX_WRITE_REASON_MAX ||
+      !pickle_it.ReadUInt64(&updated_count) ||
+      updated_count > kMaxEntriesInIndex) {
+    return false;
+  }
+  std::vector<std::pair<uint64_t, EntryMetadata>> updated_entries;
+  while (updated_entries.size() < updated_count) {
+    uint64_t entry_hash;
+    EntryMetadata entry_metadata;
+    if (!pickle_it.ReadUInt64(&entry_hash) ||
+        !entry_metadata.Deserialize(&pickle_it)) {
+      return false;
+    }
+    updated_entries.push_back(std::make_pair(entry_hash, entry_metadata));
+  }
+  uint64_t removed_count;
+  if (!pickle_it.ReadUInt64(&removed_count) ||
+      removed_count > kMaxEntriesInIndex) {
+    return false;
+  }
+  SimpleIndex::HashList removed_entries;
+  while (removed_entries.size() < removed_count) {
+    uint64_t entry_hash;
+    if (!pickle_it.ReadUInt64(&entry_hash))
+      return false;
+    removed_entries.push_back(entry_hash);
+  }
+  int64_t cache_last_modified;
+  if (!pickle_it.ReadInt64(&cache_last_modified))
+    return false;
+
+  for (const auto& entry : updated_entries)
+    (*entries)[entry.first] = entry.second;
+  for (uint64_t entry_hash : removed_entries)
+    entries->erase(entry_hash);
+  *out_cache_last_modified = base::Time::FromInternalValue(cache_last_modified);
+  *out_reason = static_cast<SimpleIndex::IndexWriteToDiskReason>(reason);
+  *entry_count += updated_count + removed_count;
+  return true;
+}
+
 // static
 void SimpleIndexFile::Deserialize(const char* data, int data_len,
                                   base::Time* out_cache_last_modified,
@@ -21,13 +21,14 @@
 #include "net/disk_cache/simple/simple_index.h"
 
 namespace base {
-class SingleThreadTaskRunner;
+class SequencedTaskRunner;
 class TaskRunner;
 }
 
 namespace disk_cache {
 
 const uint64_t kSimpleIndexMagicNumber = UINT64_C(0x656e74657220796f);
+const uint64_t kSimpleIndexJournalMagicNumber = UINT64_C(0x6a6f75726e616c21);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   SimpleIndexLoadResult();
@@ -39,6 +40,11 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   SimpleIndex::IndexWriteToDiskReason index_write_reason;
   SimpleIndex::IndexInitMethod init_method;
   bool flush_required;
+
+  // Whether the journal of the loaded index file can be appended to, and how
+  // many changes were replayed from it.
+  bool journal_valid;
+  uint64_t journal_entry_count;
 };
 
 // Simple Index File format is a pickle of IndexMetadata and EntryMetadata
@@ -47,6 +53,14 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 // the format see |SimpleIndexFile::Serialize()| and
 // |SimpleIndexFile::LoadFromDisk()|.
 //
+// The changes made to the index between two writes of the index file are
+// appended to a journal next to it, so most flushes only write what changed.
+// The journal starts with a header holding the CRC of the index file it
+// applies to, followed by one record per flush, each a pickle of the updated
+// and removed entries. Writing the index file starts a new, empty journal.
+// When loading, the records are replayed on top of the index file, up to the
+// first one which is torn or corrupt.
+//
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
 // or in worker threads. Synchronization between methods is the
@@ -81,8 +95,10 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
     uint64_t cache_size_;  // Total cache storage size in bytes.
   };
 
+  // Index writes run in order on |cache_thread|, which may be any sequenced
+  // task runner rather than a dedicated thread.
   SimpleIndexFile(
-      const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
+      const scoped_refptr<base::SequencedTaskRunner>& cache_thread,
       const scoped_refptr<base::TaskRunner>& worker_pool,
       net::CacheType cache_type,
       const base::FilePath& cache_directory);
@@ -101,6 +117,17 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                            bool app_on_background,
                            const base::Closure& callback);
 
+  // Append the changes made since the last write of the index or of the
+  // journal to the journal. |updated_entries| were inserted or modified,
+  // |removed_entries| removed. Does nothing if there is no journal on disk for
+  // the current index file.
+  virtual void AppendToJournal(SimpleIndex::IndexWriteToDiskReason reason,
+                               const SimpleIndex::EntrySet& updated_entries,
+                               const SimpleIndex::HashList& removed_entries,
+                               const base::TimeTicks& start,
+                               bool app_on_background,
+                               const base::Closure& callback);
+
  private:
   friend class WrappedSimpleIndexFile;
 
@@ -116,13 +143,23 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                                    base::Time cache_last_modified,
                                    const base::FilePath& cache_directory,
                                    const base::FilePath& index_file_path,
+                                   const base::FilePath& journal_file_path,
                                    SimpleIndexLoadResult* out_result);
 
-  // Load the index file from disk returning an EntrySet.
+  // Load the index file from disk returning an EntrySet, and replay its
+  // journal on it.
   static void SyncLoadFromDisk(const base::FilePath& index_filename,
+                               const base::FilePath& journal_filename,
                                base::Time* out_last_cache_seen_by_index,
                                SimpleIndexLoadResult* out_result);
 
+  // Replay the journal on the entries loaded from the index file whose CRC is
+  // |index_crc|, and truncate any torn record at its end.
+  static void SyncReplayJournal(const base::FilePath& journal_filename,
+                                uint32_t index_crc,
+                                base::Time* out_last_cache_seen_by_index,
+                                SimpleIndexLoadResult* out_result);
+
   // Returns a scoped_ptr for a newly allocated base::Pickle containing the
   // serialized
   // data to be written to a file. Note: the pickle is not in a consistent state
@@ -132,6 +169,22 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const SimpleIndexFile::IndexMetadata& index_metadata,
       const SimpleIndex::EntrySet& entries);
 
+  // Like Serialize(), for a journal record. SerializeFinalData() must be
+  // called on the result as well.
+  static std::unique_ptr<base::Pickle> SerializeJournalRecord(
+      SimpleIndex::IndexWriteToDiskReason reason,
+      const SimpleIndex::EntrySet& updated_entries,
+      const SimpleIndex::HashList& removed_entries);
+
+  // Given a journal record |pickle|, applies it to |entries| and adds the
+  // number of changes it holds to |entry_count|. Returns false on error.
+  static bool DeserializeJournalRecord(
+      const base::Pickle& pickle,
+      base::Time* out_cache_last_modified,
+      SimpleIndex::IndexWriteToDiskReason* out_reason,
+      SimpleIndex::EntrySet* entries,
+      uint64_t* entry_count);
+
   // Appends cache modification time data to the serialized format. This is
   // performed on a thread accessing the disk. It is not combined with the main
   // serialization path to avoid extra thread hops or copying the pickle to the
@@ -154,15 +207,25 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_path,
       const EntryFileCallback& entry_file_callback);
 
-  // Writes the index file to disk atomically.
+  // Writes the index file to disk atomically, followed by an empty journal.
   static void SyncWriteToDisk(net::CacheType cache_type,
                               const base::FilePath& cache_directory,
                               const base::FilePath& index_filename,
                               const base::FilePath& temp_index_filename,
+                              const base::FilePath& journal_filename,
                               std::unique_ptr<base::Pickle> pickle,
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Appends a record to the journal. The journal is deleted if the record
+  // cannot be written whole, so that no later record is replayed without it.
+  static void SyncAppendToJournal(net::CacheType cache_type,
+                                  const base::FilePath& cache_directory,
+                                  const base::FilePath& journal_filename,
+                                  std::unique_ptr<base::Pickle> pickle,
+                                  const base::TimeTicks& start_time,
+                                  bool app_on_background);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
@@ -180,16 +243,18 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
     uint32_t crc;
   };
 
-  const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
+  const scoped_refptr<base::SequencedTaskRunner> cache_thread_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
   const net::CacheType cache_type_;
   const base::FilePath cache_directory_;
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
+  const base::FilePath journal_file_;
 
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
   static const char kTempIndexFileName[];
+  static const char kJournalFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
 };
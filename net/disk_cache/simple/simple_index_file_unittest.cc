@@ -144,6 +144,10 @@ class WrappedSimpleIndexFile : public SimpleIndexFile {
     return temp_index_file_;
   }
 
+  const base::FilePath& GetJournalFilePath() const {
+    return journal_file_;
+  }
+
   bool CreateIndexFileDirectory() const {
     return base::CreateDirectory(index_file_.DirName());
   }
@@ -274,6 +278,197 @@ TEST_F(SimpleIndexFileTest, WriteThenLoadIndex) {
     EXPECT_EQ(1U, load_index_result.entries.count(kHashes[i]));
 }
 
+TEST_F(SimpleIndexFileTest, WriteThenAppendToJournalThenLoad) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22u), &entries);
+  SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 33u), &entries);
+  net::TestClosure closure;
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 66U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  EXPECT_TRUE(base::PathExists(simple_index_file.GetJournalFilePath()));
+
+  // Update an entry, insert one and remove one.
+  SimpleIndex::EntrySet updated_entries;
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 222u),
+                                &updated_entries);
+  SimpleIndex::InsertInEntrySet(44, EntryMetadata(Time(), 44u),
+                                &updated_entries);
+  simple_index_file.AppendToJournal(
+      SimpleIndex::INDEX_WRITE_REASON_IDLE, updated_entries,
+      SimpleIndex::HashList(1, 11), base::TimeTicks(), false,
+      closure.closure());
+  closure.WaitForResult();
+
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.flush_required);
+  EXPECT_EQ(SimpleIndex::INITIALIZE_METHOD_LOADED,
+            load_index_result.init_method);
+  EXPECT_EQ(SimpleIndex::INDEX_WRITE_REASON_IDLE,
+            load_index_result.index_write_reason);
+  EXPECT_TRUE(load_index_result.journal_valid);
+  EXPECT_EQ(3U, load_index_result.journal_entry_count);
+
+  const SimpleIndex::EntrySet& loaded_entries = load_index_result.entries;
+  EXPECT_EQ(3U, loaded_entries.size());
+  EXPECT_EQ(0U, loaded_entries.count(11));
+  ASSERT_EQ(1U, loaded_entries.count(22));
+  EXPECT_EQ(222U, loaded_entries.find(22)->second.GetEntrySize());
+  EXPECT_EQ(1U, loaded_entries.count(33));
+  EXPECT_EQ(1U, loaded_entries.count(44));
+}
+
+TEST_F(SimpleIndexFileTest, LoadTruncatesTornJournalRecord) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  net::TestClosure closure;
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 11U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  SimpleIndex::EntrySet updated_entries;
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22u),
+                                &updated_entries);
+  simple_index_file.AppendToJournal(
+      SimpleIndex::INDEX_WRITE_REASON_IDLE, updated_entries,
+      SimpleIndex::HashList(), base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+
+  // Simulate a crash in the middle of appending a record.
+  const base::FilePath& journal_path = simple_index_file.GetJournalFilePath();
+  int64_t journal_size;
+  ASSERT_TRUE(base::GetFileSize(journal_path, &journal_size));
+  const std::string kTornRecord = "torn";
+  ASSERT_TRUE(
+      base::AppendToFile(journal_path, kTornRecord.data(), kTornRecord.size()));
+
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_TRUE(load_index_result.journal_valid);
+  EXPECT_EQ(2U, load_index_result.entries.size());
+  int64_t truncated_journal_size;
+  ASSERT_TRUE(base::GetFileSize(journal_path, &truncated_journal_size));
+  EXPECT_EQ(journal_size, truncated_journal_size);
+}
+
+TEST_F(SimpleIndexFileTest, LoadIgnoresJournalOfOtherIndex) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  net::TestClosure closure;
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 11U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  SimpleIndex::EntrySet updated_entries;
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22u),
+                                &updated_entries);
+  simple_index_file.AppendToJournal(
+      SimpleIndex::INDEX_WRITE_REASON_IDLE, updated_entries,
+      SimpleIndex::HashList(), base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+  std::string old_journal;
+  ASSERT_TRUE(base::ReadFileToString(simple_index_file.GetJournalFilePath(),
+                                     &old_journal));
+
+  // Write a different index, then put the journal of the first one back.
+  SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 33u), &entries);
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 44U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  ASSERT_EQ(static_cast<int>(old_journal.size()),
+            base::WriteFile(simple_index_file.GetJournalFilePath(),
+                            old_journal.data(), old_journal.size()));
+
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.journal_valid);
+  EXPECT_EQ(2U, load_index_result.entries.size());
+  EXPECT_EQ(1U, load_index_result.entries.count(11));
+  EXPECT_EQ(1U, load_index_result.entries.count(33));
+  EXPECT_FALSE(base::PathExists(simple_index_file.GetJournalFilePath()));
+}
+
+TEST_F(SimpleIndexFileTest, FailedWriteRemovesJournal) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  net::TestClosure closure;
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 11U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  ASSERT_TRUE(base::PathExists(simple_index_file.GetJournalFilePath()));
+
+  // Make the next write of the index file fail, as if the disk was full.
+  ASSERT_TRUE(base::CreateDirectory(simple_index_file.GetTempIndexFilePath()));
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22u), &entries);
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_IDLE, entries,
+                                33U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+  EXPECT_FALSE(base::PathExists(simple_index_file.GetJournalFilePath()));
+
+  // The records appended from then on are for the index which was not
+  // written, and must not be replayed on the previous one.
+  SimpleIndex::EntrySet updated_entries;
+  SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 33u),
+                                &updated_entries);
+  simple_index_file.AppendToJournal(
+      SimpleIndex::INDEX_WRITE_REASON_IDLE, updated_entries,
+      SimpleIndex::HashList(), base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+  EXPECT_FALSE(base::PathExists(simple_index_file.GetJournalFilePath()));
+
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.journal_valid);
+  EXPECT_EQ(1U, load_index_result.entries.size());
+  EXPECT_EQ(1U, load_index_result.entries.count(11));
+}
+
 TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
   base::ScopedTempDir cache_dir;
   ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
@@ -56,7 +56,8 @@ class MockSimpleIndexFile : public SimpleIndexFile,
       : SimpleIndexFile(NULL, NULL, net::DISK_CACHE, base::FilePath()),
         load_result_(NULL),
         load_index_entries_calls_(0),
-        disk_writes_(0) {}
+        disk_writes_(0),
+        journal_writes_(0) {}
 
   void LoadIndexEntries(base::Time cache_last_modified,
                         const base::Closure& callback,
@@ -76,6 +77,17 @@ class MockSimpleIndexFile : public SimpleIndexFile,
     disk_write_entry_set_ = entry_set;
   }
 
+  void AppendToJournal(SimpleIndex::IndexWriteToDiskReason reason,
+                       const SimpleIndex::EntrySet& updated_entries,
+                       const SimpleIndex::HashList& removed_entries,
+                       const base::TimeTicks& start,
+                       bool app_on_background,
+                       const base::Closure& callback) override {
+    journal_writes_++;
+    journal_updated_entries_ = updated_entries;
+    journal_removed_entries_ = removed_entries;
+  }
+
   void GetAndResetDiskWriteEntrySet(SimpleIndex::EntrySet* entry_set) {
     entry_set->swap(disk_write_entry_set_);
   }
@@ -84,6 +96,13 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
   int disk_writes() const { return disk_writes_; }
+  int journal_writes() const { return journal_writes_; }
+  const SimpleIndex::EntrySet& journal_updated_entries() const {
+    return journal_updated_entries_;
+  }
+  const SimpleIndex::HashList& journal_removed_entries() const {
+    return journal_removed_entries_;
+  }
 
  private:
   base::Closure load_callback_;
@@ -91,6 +110,9 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   int load_index_entries_calls_;
   int disk_writes_;
   SimpleIndex::EntrySet disk_write_entry_set_;
+  int journal_writes_;
+  SimpleIndex::EntrySet journal_updated_entries_;
+  SimpleIndex::HashList journal_removed_entries_;
 };
 
 class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
@@ -152,6 +174,12 @@ class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
     index_file_->load_callback().Run();
   }
 
+  void ReturnIndexFileWithJournal(uint64_t journal_entry_count) {
+    index_file_->load_result()->journal_valid = true;
+    index_file_->load_result()->journal_entry_count = journal_entry_count;
+    ReturnIndexFile();
+  }
+
   // Non-const for timer manipulation.
   SimpleIndex* index() { return index_.get(); }
   const MockSimpleIndexFile* index_file() const { return index_file_.get(); }
@@ -645,4 +673,59 @@ TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->write_to_disk_timer_.Stop();
 }
 
+// Confirm that the changes only are written when the index file has a journal.
+TEST_F(SimpleIndexTest, DiskWriteJournaled) {
+  index()->SetMaxSize(1000);
+  InsertIntoIndexFileReturn(hashes_.at<1>(), base::Time::Now(), 10u);
+  InsertIntoIndexFileReturn(hashes_.at<2>(), base::Time::Now(), 10u);
+  ReturnIndexFileWithJournal(0);
+
+  index()->Insert(hashes_.at<3>());
+  index()->UpdateEntrySize(hashes_.at<3>(), 20u);
+  index()->Remove(hashes_.at<1>());
+  EXPECT_TRUE(index()->write_to_disk_timer_.IsRunning());
+  base::Closure user_task(index()->write_to_disk_timer_.user_task());
+  index()->write_to_disk_timer_.Stop();
+  user_task.Run();
+
+  EXPECT_EQ(0, index_file_->disk_writes());
+  EXPECT_EQ(1, index_file_->journal_writes());
+  const SimpleIndex::EntrySet& updated_entries =
+      index_file_->journal_updated_entries();
+  ASSERT_EQ(1U, updated_entries.size());
+  EXPECT_EQ(hashes_.at<3>(), updated_entries.begin()->first);
+  EXPECT_EQ(20U, updated_entries.begin()->second.GetEntrySize());
+  ASSERT_EQ(1U, index_file_->journal_removed_entries().size());
+  EXPECT_EQ(hashes_.at<1>(), index_file_->journal_removed_entries()[0]);
+  EXPECT_EQ(2U, index()->journal_entry_count_);
+
+  // The next write only holds what changed since.
+  index()->UseIfExists(hashes_.at<2>());
+  index()->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_IDLE);
+  EXPECT_EQ(0, index_file_->disk_writes());
+  EXPECT_EQ(2, index_file_->journal_writes());
+  ASSERT_EQ(1U, index_file_->journal_updated_entries().size());
+  EXPECT_EQ(hashes_.at<2>(),
+            index_file_->journal_updated_entries().begin()->first);
+  EXPECT_TRUE(index_file_->journal_removed_entries().empty());
+}
+
+// Confirm that a long journal is compacted into the index file.
+TEST_F(SimpleIndexTest, DiskWriteCompactsJournal) {
+  index()->SetMaxSize(1000);
+  ReturnIndexFileWithJournal(1000);
+
+  index()->Insert(hashes_.at<1>());
+  index()->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_IDLE);
+  EXPECT_EQ(1, index_file_->disk_writes());
+  EXPECT_EQ(0, index_file_->journal_writes());
+  EXPECT_EQ(0U, index()->journal_entry_count_);
+
+  index()->Insert(hashes_.at<2>());
+  index()->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_IDLE);
+  EXPECT_EQ(1, index_file_->disk_writes());
+  EXPECT_EQ(1, index_file_->journal_writes());
+  EXPECT_EQ(1U, index()->journal_entry_count_);
+}
+
 }  // namespace disk_cache
@@ -143,6 +143,37 @@ void CalculateSHA256OfKey(const std::string& key,
   hash->Finish(out_hash_value, sizeof(*out_hash_value));
 }
 
+disk_cache::SimpleFileHeader MakeFileHeader(const std::string& key) {
+  disk_cache::SimpleFileHeader header;
+  header.initial_magic_number = disk_cache::kSimpleInitialMagicNumber;
+  header.version = disk_cache::kSimpleEntryVersionOnDisk;
+  header.key_length = key.size();
+  header.key_hash = base::Hash(key);
+  return header;
+}
+
+// Returns the EOF record of the stream |crc_record| is for.
+disk_cache::SimpleFileEOF MakeEOFRecord(
+    const disk_cache::SimpleSynchronousEntry::CRCRecord& crc_record,
+    int32_t stream_size) {
+  disk_cache::SimpleFileEOF eof_record;
+  eof_record.stream_size = stream_size;
+  eof_record.final_magic_number = disk_cache::kSimpleFinalMagicNumber;
+  eof_record.flags = 0;
+  if (crc_record.has_crc32)
+    eof_record.flags |= disk_cache::SimpleFileEOF::FLAG_HAS_CRC32;
+  if (crc_record.index == 0)
+    eof_record.flags |= disk_cache::SimpleFileEOF::FLAG_HAS_KEY_SHA256;
+  eof_record.data_crc32 = crc_record.data_crc32;
+  return eof_record;
+}
+
+// Appends the raw bytes of |data| to |buffer|.
+void AppendToBuffer(const void* data, size_t size, std::vector<char>* buffer) {
+  const char* bytes = static_cast<const char*>(data);
+  buffer->insert(buffer->end(), bytes, bytes + size);
+}
+
 }  // namespace
 
 namespace disk_cache {
@@ -345,8 +376,20 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
   // be handled in the SimpleEntryImpl.
   DCHECK_GT(in_entry_op.buf_len, 0);
   DCHECK(!empty_file_omitted_[file_index]);
-  int bytes_read = files_[file_index].Read(file_offset, out_buf->data(),
-                                           in_entry_op.buf_len);
+  int bytes_read;
+  if (file_index == 0 && coalescing_file_0_writes_) {
+    const int64_t buffered_size = file_0_write_buffer_.size();
+    bytes_read = static_cast<int>(std::max<int64_t>(
+        0, std::min<int64_t>(in_entry_op.buf_len,
+                             buffered_size - file_offset)));
+    if (bytes_read > 0) {
+      std::memcpy(out_buf->data(), &file_0_write_buffer_[file_offset],
+                  bytes_read);
+    }
+  } else {
+    bytes_read = files_[file_index].Read(file_offset, out_buf->data(),
+                                         in_entry_op.buf_len);
+  }
   if (bytes_read > 0) {
     entry_stat->set_last_used(Time::Now());
     *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
@@ -410,6 +453,37 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   }
   DCHECK(!empty_file_omitted_[file_index]);
 
+  if (file_index == 0 && coalescing_file_0_writes_) {
+    const int new_data_size =
+        truncate || (buf_len == 0 && extending_by_write)
+            ? offset + buf_len
+            : std::max(out_entry_stat->data_size(index), offset + buf_len);
+    const size_t header_size = GetHeaderSize(key_.size());
+    if (header_size + new_data_size <= kMaxCoalescedFile0Size) {
+      // Growing the buffer zero-fills, like extending the file would.
+      DCHECK_EQ(header_size + out_entry_stat->data_size(index),
+                file_0_write_buffer_.size());
+      file_0_write_buffer_.resize(header_size + new_data_size);
+      if (buf_len > 0) {
+        std::memcpy(&file_0_write_buffer_[header_size + offset],
+                    in_buf->data(), buf_len);
+      }
+      out_entry_stat->set_data_size(index, new_data_size);
+      RecordWriteResult(cache_type_, WRITE_RESULT_SUCCESS);
+      base::Time modification_time = Time::Now();
+      out_entry_stat->set_last_used(modification_time);
+      out_entry_stat->set_last_modified(modification_time);
+      *out_result = buf_len;
+      return;
+    }
+    if (!FlushFile0WriteBuffer()) {
+      RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
+      Doom();
+      *out_result = net::ERR_CACHE_WRITE_FAILURE;
+      return;
+    }
+  }
+
   if (extending_by_write) {
     // The EOF record and the eventual stream afterward need to be zeroed out.
     const int64_t file_eof_offset =
@@ -688,12 +762,40 @@ void SimpleSynchronousEntry::Close(
     net::GrowableIOBuffer* stream_0_data) {
   DCHECK(stream_0_data);
 
+  // A newly created entry gets its whole first file written in one go, as
+  // long as both of its streams need their EOF records written.
+  bool file_0_written = false;
+  if (coalescing_file_0_writes_) {
+    const CRCRecord* stream_crc32s[2] = {nullptr, nullptr};
+    for (const CRCRecord& crc_record : *crc32s_to_write) {
+      if (crc_record.index < 2)
+        stream_crc32s[crc_record.index] = &crc_record;
+    }
+    if (stream_crc32s[0] && stream_crc32s[1] &&
+        file_0_write_buffer_.size() ==
+            GetHeaderSize(key_.size()) + entry_stat.data_size(1)) {
+      file_0_written = true;
+      if (!WriteCoalescedFile0(entry_stat, *stream_crc32s[0],
+                               *stream_crc32s[1], stream_0_data)) {
+        RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+        DVLOG(1) << "Could not write coalesced entry file.";
+        Doom();
+      }
+    } else if (!FlushFile0WriteBuffer()) {
+      RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+      DVLOG(1) << "Could not write coalesced stream 1 data.";
+      Doom();
+    }
+  }
+
   for (std::vector<CRCRecord>::const_iterator it = crc32s_to_write->begin();
        it != crc32s_to_write->end(); ++it) {
     const int stream_index = it->index;
     const int file_index = GetFileIndexFromStreamIndex(stream_index);
     if (empty_file_omitted_[file_index])
       continue;
+    if (file_index == 0 && file_0_written)
+      continue;
 
     if (stream_index == 0) {
       // Write stream 0 data.
@@ -715,15 +817,8 @@ void SimpleSynchronousEntry::Close(
       }
     }
 
-    SimpleFileEOF eof_record;
-    eof_record.stream_size = entry_stat.data_size(stream_index);
-    eof_record.final_magic_number = kSimpleFinalMagicNumber;
-    eof_record.flags = 0;
-    if (it->has_crc32)
-      eof_record.flags |= SimpleFileEOF::FLAG_HAS_CRC32;
-    if (stream_index == 0)
-      eof_record.flags |= SimpleFileEOF::FLAG_HAS_KEY_SHA256;
-    eof_record.data_crc32 = it->data_crc32;
+    SimpleFileEOF eof_record =
+        MakeEOFRecord(*it, entry_stat.data_size(stream_index));
     int eof_offset = entry_stat.GetEOFOffsetInFile(key_.size(), stream_index);
     // If stream 0 changed size, the file needs to be resized, otherwise the
     // next open will yield wrong stream sizes. On stream 1 and stream 2 proper
@@ -788,7 +883,8 @@ SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
       had_index_(had_index),
       key_(key),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      coalescing_file_0_writes_(false) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -1114,13 +1210,7 @@ int SimpleSynchronousEntry::InitializeForOpen(
 bool SimpleSynchronousEntry::InitializeCreatedFile(
     int file_index,
     CreateEntryResult* out_result) {
-  SimpleFileHeader header;
-  header.initial_magic_number = kSimpleInitialMagicNumber;
-  header.version = kSimpleEntryVersionOnDisk;
-
-  header.key_length = key_.size();
-  header.key_hash = base::Hash(key_);
-
+  SimpleFileHeader header = MakeFileHeader(key_);
   int bytes_written = files_[file_index].Write(
       0, reinterpret_cast<char*>(&header), sizeof(header));
   if (bytes_written != sizeof(header)) {
@@ -1138,6 +1228,44 @@ bool SimpleSynchronousEntry::InitializeCreatedFile(
   return true;
 }
 
+bool SimpleSynchronousEntry::FlushFile0WriteBuffer() {
+  if (!coalescing_file_0_writes_)
+    return true;
+  coalescing_file_0_writes_ = false;
+  std::vector<char> buffer;
+  buffer.swap(file_0_write_buffer_);
+  const int size = base::checked_cast<int>(buffer.size());
+  return files_[0].Write(0, buffer.data(), size) == size;
+}
+
+bool SimpleSynchronousEntry::WriteCoalescedFile0(
+    const SimpleEntryStat& entry_stat,
+    const CRCRecord& stream_0_crc32,
+    const CRCRecord& stream_1_crc32,
+    net::GrowableIOBuffer* stream_0_data) {
+  DCHECK(coalescing_file_0_writes_);
+  DCHECK_EQ(entry_stat.GetEOFOffsetInFile(key_.size(), 1),
+            static_cast<int>(file_0_write_buffer_.size()));
+  SimpleFileEOF eof_record =
+      MakeEOFRecord(stream_1_crc32, entry_stat.data_size(1));
+  AppendToBuffer(&eof_record, sizeof(eof_record), &file_0_write_buffer_);
+
+  DCHECK_EQ(entry_stat.GetOffsetInFile(key_.size(), 0, 0),
+            static_cast<int>(file_0_write_buffer_.size()));
+  AppendToBuffer(stream_0_data->data(), entry_stat.data_size(0),
+                 &file_0_write_buffer_);
+  net::SHA256HashValue hash_value;
+  CalculateSHA256OfKey(key_, &hash_value);
+  AppendToBuffer(hash_value.data, sizeof(hash_value.data),
+                 &file_0_write_buffer_);
+
+  DCHECK_EQ(entry_stat.GetEOFOffsetInFile(key_.size(), 0),
+            static_cast<int>(file_0_write_buffer_.size()));
+  eof_record = MakeEOFRecord(stream_0_crc32, entry_stat.data_size(0));
+  AppendToBuffer(&eof_record, sizeof(eof_record), &file_0_write_buffer_);
+  return FlushFile0WriteBuffer();
+}
+
 int SimpleSynchronousEntry::InitializeForCreate(
     SimpleEntryStat* out_entry_stat) {
   DCHECK(!initialized_);
@@ -1149,6 +1277,17 @@ int SimpleSynchronousEntry::InitializeForCreate(
     if (empty_file_omitted_[i])
       continue;
 
+    // The header of the first file is written together with the rest of the
+    // file, see |file_0_write_buffer_|.
+    if (i == 0 &&
+        GetHeaderSize(key_.size()) <= kMaxCoalescedFile0Size) {
+      SimpleFileHeader header = MakeFileHeader(key_);
+      AppendToBuffer(&header, sizeof(header), &file_0_write_buffer_);
+      AppendToBuffer(key_.data(), key_.size(), &file_0_write_buffer_);
+      coalescing_file_0_writes_ = true;
+      continue;
+    }
+
     CreateEntryResult result;
     if (!InitializeCreatedFile(i, &result)) {
       RecordSyncCreateResult(result, had_index_);
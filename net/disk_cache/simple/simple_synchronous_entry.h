@@ -220,6 +220,10 @@ class SimpleSynchronousEntry {
   // make it likely the entire key is read.
   static const size_t kInitialHeaderRead = 64 * 1024;
 
+  // Newly created entries keep the first file in memory until it grows past
+  // this size, see |file_0_write_buffer_|.
+  static const size_t kMaxCoalescedFile0Size = 32 * 1024;
+
   SimpleSynchronousEntry(net::CacheType cache_type,
                          const base::FilePath& path,
                          const std::string& key,
@@ -262,6 +266,18 @@ class SimpleSynchronousEntry {
   // |*out_result| on failure.
   bool InitializeCreatedFile(int index, CreateEntryResult* out_result);
 
+  // Writes out |file_0_write_buffer_| and stops coalescing writes to the
+  // first file. Returns false on IO error.
+  bool FlushFile0WriteBuffer();
+
+  // Appends the EOF record of stream 1, stream 0, the key SHA256 and the EOF
+  // record of stream 0 to |file_0_write_buffer_|, and writes the whole first
+  // file at once. Returns false on IO error.
+  bool WriteCoalescedFile0(const SimpleEntryStat& entry_stat,
+                           const CRCRecord& stream_0_crc32,
+                           const CRCRecord& stream_1_crc32,
+                           net::GrowableIOBuffer* stream_0_data);
+
   // Returns a net error, including net::OK on success and net::FILE_EXISTS
   // when the entry already exists.
   int InitializeForCreate(SimpleEntryStat* out_entry_stat);
@@ -364,6 +380,14 @@ class SimpleSynchronousEntry {
   // True if the entry was created, or false if it was opened. Used to log
   // SimpleCache.*.EntryCreatedWithStream2Omitted only for created entries.
   bool files_created_;
+
+  // A newly created entry is usually written sequentially and closed soon
+  // after, so the header, key and stream 1 data of its first file are kept in
+  // this buffer rather than written one by one. Close() then appends the EOF
+  // records and stream 0 and writes the file with a single call. While
+  // |coalescing_file_0_writes_| is true the file on disk is still empty.
+  bool coalescing_file_0_writes_;
+  std::vector<char> file_0_write_buffer_;
 };
 
 }  // namespace disk_cache
@@ -14,6 +14,9 @@
 // To test that the disk cache doesn't generate critical errors with regular
 // application level crashes, edit stress_support.h.
 
+// Passing --simple-cache-shards=N stresses a simple cache split into N shards
+// instead of the blockfile cache.
+
 #include <string>
 #include <vector>
 
@@ -37,6 +40,7 @@
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread.h"
 #include "base/threading/thread_task_runner_handle.h"
+#include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
@@ -45,6 +49,7 @@
 #include "net/disk_cache/blockfile/trace.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 
 #if defined(OS_WIN)
 #include "base/logging_win.h"
@@ -55,6 +60,8 @@ using base::Time;
 const int kError = -1;
 const int kExpectedCrash = 100;
 
+const char kSimpleCacheShards[] = "simple-cache-shards";
+
 // Starts a new process.
 int RunSlave(int iteration) {
   base::FilePath exe;
@@ -62,6 +69,13 @@ int RunSlave(int iteration) {
 
   base::CommandLine cmdline(exe);
   cmdline.AppendArg(base::IntToString(iteration));
+  const base::CommandLine& master_cmdline =
+      *base::CommandLine::ForCurrentProcess();
+  if (master_cmdline.HasSwitch(kSimpleCacheShards)) {
+    cmdline.AppendSwitchASCII(
+        kSimpleCacheShards,
+        master_cmdline.GetSwitchValueASCII(kSimpleCacheShards));
+  }
 
   base::Process process = base::LaunchProcess(cmdline, base::LaunchOptions());
   if (!process.IsValid()) {
@@ -153,7 +167,7 @@ struct Data {
   int pendig_operations;  // Counter of simultaneous operations.
   int writes;             // How many writes since this iteration started.
   int iteration;          // The iteration (number of crashes).
-  disk_cache::BackendImpl* cache;
+  disk_cache::Backend* cache;
   std::string keys[kNumKeys];
   EntryWrapper entries[kNumEntries];
 };
@@ -310,13 +324,32 @@ void StressTheCache(int iteration) {
 
   g_data = new Data();
   g_data->iteration = iteration;
-  g_data->cache = new disk_cache::BackendImpl(
-      path, mask, cache_thread.task_runner().get(), NULL);
-  g_data->cache->SetMaxSize(cache_size);
-  g_data->cache->SetFlags(disk_cache::kNoLoadProtection);
 
   net::TestCompletionCallback cb;
-  int rv = g_data->cache->Init(cb.callback());
+  int rv;
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+  if (command_line.HasSwitch(kSimpleCacheShards)) {
+    int num_shards = 0;
+    base::StringToInt(command_line.GetSwitchValueASCII(kSimpleCacheShards),
+                      &num_shards);
+    disk_cache::SimpleBackendImpl* cache = new disk_cache::SimpleBackendImpl(
+        path.AddExtension(FILE_PATH_LITERAL("simple")), cache_size,
+        net::DISK_CACHE, cache_thread.task_runner(), NULL);
+    g_data->cache = cache;
+    if (!cache->SetNumShards(num_shards)) {
+      printf("Invalid number of shards.\n");
+      return;
+    }
+    rv = cache->Init(cb.callback());
+  } else {
+    disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(
+        path, mask, cache_thread.task_runner().get(), NULL);
+    g_data->cache = cache;
+    cache->SetMaxSize(cache_size);
+    cache->SetFlags(disk_cache::kNoLoadProtection);
+    rv = cache->Init(cb.callback());
+  }
 
   if (cb.GetResult(rv) != net::OK) {
     printf("Unable to initialize cache.\n");
@@ -411,7 +444,10 @@ int main(int argc, const char* argv[]) {
   // Setup an AtExitManager so Singleton objects will be destructed.
   base::AtExitManager at_exit_manager;
 
-  if (argc < 2)
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine::StringVector& args =
+      base::CommandLine::ForCurrentProcess()->GetArgs();
+  if (args.empty())
     return MasterCode();
 
   logging::SetLogAssertHandler(CrashHandler);
@@ -420,7 +456,6 @@ int main(int argc, const char* argv[]) {
 #if defined(OS_WIN)
   logging::LogEventProvider::Initialize(kStressCacheTraceProviderName);
 #else
-  base::CommandLine::Init(argc, argv);
   logging::LoggingSettings settings;
   settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
   logging::InitLogging(settings);
@@ -430,8 +465,8 @@ int main(int argc, const char* argv[]) {
   base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(3));
   base::MessageLoopForIO message_loop;
 
-  char* end;
-  long int iteration = strtol(argv[1], &end, 0);
+  int iteration = 0;
+  base::StringToInt(args[0], &iteration);
 
   if (!StartCrashThread()) {
     printf("failed to start thread\n");